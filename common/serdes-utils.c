@@ -4434,6 +4434,7 @@ static void * allocate_irati_msg(irati_msg_t msg_t)
 	case RINA_C_IPCP_DEALLOCATE_PORT_RESPONSE:
 	case RINA_C_IPCM_DEALLOCATE_FLOW_REQUEST:
 	case RINA_C_IPCM_FLOW_DEALLOCATED_NOTIFICATION:
+	case RINA_C_IPCP_N1_PORT_LIVENESS_NOTIF:
 	case RINA_C_IPCM_ALLOCATE_FLOW_REQUEST_RESULT: {
 		struct irati_kmsg_multi_msg * result;
 		result = COMMON_ALLOC(sizeof(struct irati_kmsg_multi_msg), 1);
@@ -254,7 +254,10 @@ typedef enum {
 	/* 73, IPC Manager -> IPC Process */
 	RINA_C_IPCM_SCAN_MEDIA_REQUEST,
 
-	/* 74 */
+	/* 74, Kernel -> IPC Process */
+	RINA_C_IPCP_N1_PORT_LIVENESS_NOTIF,
+
+	/* 75 */
         RINA_C_MAX,
 } msg_type_t;
 
@@ -577,6 +580,7 @@ struct irati_kmsg_ipcp_allocate_port {
 /* 41 RINA_C_IPCP_ALLOCATE_PORT_RESPONSE */
 /* 42 RINA_C_IPCP_DEALLOCATE_PORT_REQUEST */
 /* 43 RINA_C_IPCP_DEALLOCATE_PORT_RESPONSE */
+/* 74 RINA_C_IPCP_N1_PORT_LIVENESS_NOTIF */
 struct irati_kmsg_multi_msg {
 	irati_msg_t msg_type;
 	irati_msg_port_t src_port;
@@ -19,7 +19,7 @@
  * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
  */
 
-#include <linux/bitmap.h>
+#include <linux/ktime.h>
 
 #define RINA_PREFIX "cidm"
 
@@ -28,17 +28,13 @@
 #include "utils.h"
 #include "cidm.h"
 #include "common.h"
+#include "rds/rbmp.h"
 
-#define MAX_CEP_ID (((2 << BITS_PER_BYTE) * sizeof(cep_id_t)) - 1)
+/* The cep-ids fit a 2 bytes CEP-id field of the PCI */
+#define MAX_CEP_ID 65535
 
 struct cidm {
-	struct list_head allocated_cep_ids;
-	cep_id_t last_allocated;
-};
-
-struct alloc_cepid {
-        struct list_head       list;
-        cep_id_t cep_id;
+	struct rbmp * bitmap;
 };
 
 struct cidm * cidm_create(void)
@@ -49,10 +45,14 @@ struct cidm * cidm_create(void)
 	if (!instance)
 		return NULL;
 
-	INIT_LIST_HEAD(&(instance->allocated_cep_ids));
-	instance->last_allocated = 0;
+	/* cep-id 0 is not used */
+	instance->bitmap = rbmp_create(MAX_CEP_ID, 1);
+	if (!instance->bitmap) {
+		rkfree(instance);
+		return NULL;
+	}
 
-	LOG_INFO("Instance initialized successfully (%zd cep-ids)",
+	LOG_INFO("Instance initialized successfully (%d cep-ids)",
 			MAX_CEP_ID);
 
 	return instance;
@@ -60,85 +60,41 @@ struct cidm * cidm_create(void)
 
 int cidm_destroy(struct cidm * instance)
 {
-	struct alloc_cepid * pos, * next;
-
         if (!instance) {
                 LOG_ERR("Bogus instance passed, bailing out");
                 return -1;
         }
 
-        list_for_each_entry_safe(pos, next, &instance->allocated_cep_ids, list) {
-                rkfree(pos);
-        }
-
+        rbmp_destroy(instance->bitmap);
         rkfree(instance);
 
         return 0;
 }
 
-int cidm_allocated(struct cidm * instance, cep_id_t cep_id)
-{
-	struct alloc_cepid * pos, * next;
-
-        if (!instance) {
-                LOG_ERR("Bogus instance passed, bailing out");
-                return -1;
-        }
-
-        list_for_each_entry_safe(pos, next, &instance->allocated_cep_ids, list) {
-                if (pos->cep_id == cep_id) {
-                	return 1;
-                }
-        }
-
-        return 0;
-}
-
 cep_id_t cidm_allocate(struct cidm * instance)
 {
-	struct alloc_cepid * new_cep_id;
-        cep_id_t cep_id;
+        ssize_t cep_id;
 
         if (!instance) {
                 LOG_ERR("Bogus instance passed, bailing out");
-                return port_id_bad();
-        }
-
-        if (instance->last_allocated == MAX_CEP_ID) {
-        	cep_id = 1;
-        } else {
-        	cep_id = instance->last_allocated + 1;
+                return cep_id_bad();
         }
 
-        while (cidm_allocated(instance, cep_id)) {
-        	if (cep_id == MAX_CEP_ID) {
-        		cep_id = 1;
-        	} else {
-        		cep_id ++;
-        	}
+        cep_id = rbmp_allocate(instance->bitmap);
+        if (!rbmp_is_id_ok(instance->bitmap, cep_id)) {
+                LOG_ERR("No cep-ids left");
+                return cep_id_bad();
         }
 
-        new_cep_id = rkmalloc(sizeof(*new_cep_id), GFP_ATOMIC);
-        if (!new_cep_id)
-        	return cep_id_bad();
-
-        INIT_LIST_HEAD(&(new_cep_id->list));
-        new_cep_id->cep_id = cep_id;
-        list_add(&(new_cep_id->list), &(instance->allocated_cep_ids));
-
-        instance->last_allocated = cep_id;
+        LOG_DBG("Cep-id allocation completed successfully (id = %zd)", cep_id);
 
-        LOG_DBG("Cep-id allocation completed successfully (id = %d)", cep_id);
-
-        return cep_id;
+        return (cep_id_t) cep_id;
 }
 
 int cidm_release(struct cidm * instance,
                  cep_id_t      id)
 {
-	struct alloc_cepid * pos, * next;
-
-       if (!is_port_id_ok(id)) {
+       if (!is_cep_id_ok(id)) {
                LOG_ERR("Bad cep-id passed, bailing out");
                return -1;
        }
@@ -147,17 +103,77 @@ int cidm_release(struct cidm * instance,
                return -1;
        }
 
-       list_for_each_entry_safe(pos, next, &instance->allocated_cep_ids, list) {
-               if (pos->cep_id == id) {
-               	list_del(&pos->list);
-               	rkfree(pos);
-               	LOG_DBG("Cep-id release completed successfully (cep_id: %d)", id);
-
-               	return 0;
-               }
+       if (rbmp_release(instance->bitmap, id)) {
+               LOG_ERR("Didn't find cep-id %d, returning error", id);
+               return 0;
        }
 
-       LOG_ERR("Didn't find cep-id %d, returning error", id);
+       LOG_DBG("Cep-id release completed successfully (cep_id: %d)", id);
 
        return 0;
 }
+
+#ifdef CONFIG_RINA_CIDM_REGRESSION_TESTS
+#define CIDM_BENCH_IDS 60000
+
+bool regression_tests_cidm(void)
+{
+        struct cidm * instance;
+        cep_id_t *    ids;
+        ktime_t       start;
+        s64           alloc_ns, free_ns, churn_ns;
+        int           i;
+        bool          ret = false;
+
+        LOG_DBG("CIDM regression tests");
+
+        instance = cidm_create();
+        if (!instance)
+                return false;
+
+        ids = rkmalloc(CIDM_BENCH_IDS * sizeof(*ids), GFP_KERNEL);
+        if (!ids) {
+                cidm_destroy(instance);
+                return false;
+        }
+
+        LOG_DBG("Regression test #1: allocate %d cep-ids", CIDM_BENCH_IDS);
+        start = ktime_get();
+        for (i = 0; i < CIDM_BENCH_IDS; i++) {
+                ids[i] = cidm_allocate(instance);
+                if (!is_cep_id_ok(ids[i]))
+                        goto out;
+        }
+        alloc_ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+        LOG_DBG("Regression test #2: release and allocate every other one");
+        start = ktime_get();
+        for (i = 0; i < CIDM_BENCH_IDS; i += 2) {
+                if (cidm_release(instance, ids[i]))
+                        goto out;
+                ids[i] = cidm_allocate(instance);
+                if (!is_cep_id_ok(ids[i]))
+                        goto out;
+        }
+        churn_ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+        LOG_DBG("Regression test #3: release all of them");
+        start = ktime_get();
+        for (i = 0; i < CIDM_BENCH_IDS; i++) {
+                if (cidm_release(instance, ids[i]))
+                        goto out;
+        }
+        free_ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+        LOG_INFO("%d cep-ids: allocate %lld ns, release+allocate %lld ns, "
+                 "release %lld ns", CIDM_BENCH_IDS, alloc_ns, churn_ns,
+                 free_ns);
+
+        ret = true;
+ out:
+        rkfree(ids);
+        cidm_destroy(instance);
+
+        return ret;
+}
+#endif
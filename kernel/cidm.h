@@ -33,4 +33,8 @@ cep_id_t      cidm_allocate(struct cidm * instance);
 int           cidm_release(struct cidm * instance,
                            cep_id_t      cep_id);
 
+#ifdef CONFIG_RINA_CIDM_REGRESSION_TESTS
+bool          regression_tests_cidm(void);
+#endif
+
 #endif
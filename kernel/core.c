@@ -30,6 +30,8 @@
 #include "rds/robjects.h"
 #include "iodev.h"
 #include "ctrldev.h"
+#include "cidm.h"
+#include "kipcm-utils.h"
 
 #define MK_RINA_VERSION(MAJOR, MINOR, MICRO)                            \
         (((MAJOR & 0xFF) << 24) | ((MINOR & 0xFF) << 16) | (MICRO & 0xFFFF))
@@ -65,6 +67,21 @@ static int __init mod_init(void)
 {
         LOG_DBG("IRATI RINA implementation initializing");
 
+#ifdef CONFIG_RINA_CIDM_REGRESSION_TESTS
+        if (!regression_tests_cidm()) {
+                LOG_ERR("CIDM regression tests failed, bailing out");
+                return -1;
+        }
+#endif
+
+#ifdef CONFIG_RINA_KIPCM_REGRESSION_TESTS
+        if (!regression_tests_imap()) {
+                LOG_ERR("KIPCM instances map regression tests failed, "
+                        "bailing out");
+                return -1;
+        }
+#endif
+
         LOG_DBG("Creating root rset");
         if (robject_init_and_add(&core_object, &core_rtype, NULL, "rina")) {
                 LOG_ERR("Cannot initialize root rset, bailing out");
@@ -329,6 +329,7 @@ int default_rtt_estimator(struct dtcp_ps * ps, seq_num_t sn)
 
 	return 0;
 }
+EXPORT_SYMBOL(default_rtt_estimator);
 
 int default_rtt_estimator_nortx(struct dtcp_ps * ps, seq_num_t sn)
 {
@@ -352,6 +353,7 @@ int default_rtt_estimator_nortx(struct dtcp_ps * ps, seq_num_t sn)
 
 	return 0;
 }
+EXPORT_SYMBOL(default_rtt_estimator_nortx);
 
 int default_rcvr_rendezvous(struct dtcp_ps * ps, const struct pci * pci)
 {
@@ -454,6 +456,7 @@ struct ps_base * dtcp_ps_default_create(struct rina_component * component)
         ps->rcvr_ack                    = default_rcvr_ack_atimer,
 #endif
         ps->rcvr_flow_control           = default_rcvr_flow_control;
+        ps->sndr_flow_control           = NULL;
         ps->rate_reduction              = default_rate_reduction;
         ps->rcvr_control_ack            = NULL;
         ps->no_rate_slow_down           = NULL;
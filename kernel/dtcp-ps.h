@@ -36,6 +36,10 @@ struct dtcp_flowctrl_window_params {
 struct dtcp_flowctrl_rate_params {
         unsigned int sending_rate;
         unsigned int time_period;
+        /* Bytes per second, 0 to derive it from sending_rate/time_period */
+        unsigned int pacing_rate;
+        /* Bytes released at once, 0 disables pacing */
+        unsigned int pacing_burst;
 };
 
 struct dtcp_flowctrl_params {
@@ -76,6 +80,9 @@ struct dtcp_ps {
         int (* update_credit)(struct dtcp_ps * instance);
         int (* rcvr_flow_control)(struct dtcp_ps * instance,
                                   const struct pci * pci);
+        /* Optional, runs once the sender applied the peer's window/rate */
+        int (* sndr_flow_control)(struct dtcp_ps * instance,
+                                  const struct pci * pci);
         int (* rate_reduction)(struct dtcp_ps * instance,
         			const struct pci * pci);
         int (* rcvr_control_ack)(struct dtcp_ps * instance);
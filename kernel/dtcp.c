@@ -470,6 +470,7 @@ static int rcv_ack(struct dtcp * dtcp,
 static int update_window_and_rate(struct dtcp * dtcp,
                 		  struct du *   du)
 {
+        struct dtcp_ps * ps;
         uint_t 	     rt;
         uint_t       tf;
         bool         cancel_rv_timer;
@@ -508,6 +509,13 @@ static int update_window_and_rate(struct dtcp * dtcp,
         if (cancel_rv_timer)
         	rtimer_stop(&dtcp->parent->timers.rendezvous);
 
+        rcu_read_lock();
+        ps = container_of(rcu_dereference(dtcp->base.ps),
+                          struct dtcp_ps, base);
+        if (ps->sndr_flow_control && ps->sndr_flow_control(ps, &du->pci))
+                LOG_ERR("Failed Sender Flow Control policy");
+        rcu_read_unlock();
+
         push_pdus_rmt(dtcp);
 
         du_destroy(du);
@@ -968,6 +976,8 @@ int dtcp_select_policy_set(struct dtcp * dtcp,
                                                 = dtcp_initial_credit(cfg);
                 ps->flowctrl.rate.sending_rate  = dtcp_sending_rate(cfg);
                 ps->flowctrl.rate.time_period   = dtcp_time_period(cfg);
+                ps->flowctrl.rate.pacing_rate   = 0;
+                ps->flowctrl.rate.pacing_burst  = 0;
 
                 /* Fill in default policies. */
                 if (!ps->lost_control_pdu) {
@@ -1104,6 +1114,12 @@ int dtcp_set_policy_set_param(struct dtcp * dtcp,
                 } else if (strcmp(name, "flowctrl.rate.time_period") == 0) {
                         ret = kstrtouint(value, 10,
                                          &ps->flowctrl.rate.time_period);
+                } else if (strcmp(name, "flowctrl.rate.pacing_rate") == 0) {
+                        ret = kstrtouint(value, 10,
+                                         &ps->flowctrl.rate.pacing_rate);
+                } else if (strcmp(name, "flowctrl.rate.pacing_burst") == 0) {
+                        ret = kstrtouint(value, 10,
+                                         &ps->flowctrl.rate.pacing_burst);
                 } else {
                         LOG_ERR("Unknown DTP parameter policy '%s'", name);
                 }
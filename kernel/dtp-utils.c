@@ -199,7 +199,8 @@ static bool can_deliver(struct dtp * dtp, struct dtcp * dtcp)
                 w_ret = (dtp->sv->max_seq_nr_sent < dtcp->sv->snd_rt_wind_edge);
 
 	if (is_rb)
-                r_ret = !dtcp_rate_exceeded(dtcp, 0);
+                r_ret = !dtcp_rate_exceeded(dtcp, 0) &&
+                        dtp_pacing_allows(dtp);
 
         LOG_DBG("Can cwq still deliver something, win: %d, rate: %d",
         	w_ret, r_ret);
@@ -282,6 +283,7 @@ void cwq_deliver(struct cwq * queue,
 				} else {
 					dtcp->sv->pdus_sent_in_time_unit += sz;
 				}
+				dtp_pacing_consume(dtp, sz);
 			}
                 }
                 dtp->sv->max_seq_nr_sent = pci_sequence_number_get(&du->pci);
@@ -24,6 +24,7 @@
 #include <linux/random.h>
 #include <linux/uaccess.h>
 #include <linux/version.h>
+#include <linux/math64.h>
 
 #define RINA_PREFIX "dtp"
 
@@ -828,6 +829,128 @@ static void tf_rate_window(struct timer_list * tl)
         return;
 }
 
+/* Reads the pacing configuration, returns false if pacing is disabled */
+static bool dtp_pacing_conf(struct dtp *   dtp,
+			    unsigned int * burst,
+			    u64 *          interval_ns)
+{
+	struct dtcp * dtcp = dtp->dtcp;
+	u64           rate;
+
+	if (!dtcp)
+		return false;
+
+	rcu_read_lock();
+	*burst = dtcp_ps_get(dtcp)->flowctrl.rate.pacing_burst;
+	rate   = dtcp_ps_get(dtcp)->flowctrl.rate.pacing_rate;
+	rcu_read_unlock();
+
+	if (!*burst)
+		return false;
+
+	/* By default spread sndr_rate bytes over each time_unit (ms) */
+	if (!rate && dtcp->sv->time_unit)
+		rate = div_u64((u64) dtcp->sv->sndr_rate * MSEC_PER_SEC,
+			       dtcp->sv->time_unit);
+	if (!rate)
+		return false;
+
+	*interval_ns = div64_u64((u64) *burst * NSEC_PER_SEC, rate);
+
+	return true;
+}
+
+bool dtp_pacing_allows(struct dtp * dtp)
+{
+	unsigned long flags;
+	bool          ret;
+
+	spin_lock_irqsave(&dtp->pacing.lock, flags);
+	ret = !dtp->pacing.armed || dtp->pacing.credit > 0;
+	spin_unlock_irqrestore(&dtp->pacing.lock, flags);
+
+	return ret;
+}
+
+void dtp_pacing_consume(struct dtp * dtp, int bytes)
+{
+	struct dtp_pacing * p = &dtp->pacing;
+	unsigned int        burst;
+	u64                 interval_ns;
+	unsigned long       flags;
+
+	if (bytes <= 0 || !dtp_pacing_conf(dtp, &burst, &interval_ns))
+		return;
+
+	spin_lock_irqsave(&p->lock, flags);
+	if (p->shutdown) {
+		spin_unlock_irqrestore(&p->lock, flags);
+		return;
+	}
+	if (!p->armed) {
+		/* The bucket is full, start refilling it */
+		p->armed       = true;
+		p->credit      = burst;
+		p->burst       = burst;
+		p->interval_ns = interval_ns;
+		hrtimer_start(&p->timer, ns_to_ktime(interval_ns),
+			      HRTIMER_MODE_REL);
+	}
+	p->credit -= bytes;
+	spin_unlock_irqrestore(&p->lock, flags);
+}
+
+/* PDUs also wait if older ones are still held, to keep them in order */
+static bool dtp_pacing_holds(struct dtp * dtp)
+{
+	if (!dtp_pacing_allows(dtp))
+		return true;
+
+	return dtp->pacing.armed && dtp->cwq && cwq_size(dtp->cwq) > 0;
+}
+
+static enum hrtimer_restart dtp_pacing_timer_fn(struct hrtimer * timer)
+{
+	struct dtp_pacing *  p = container_of(timer, struct dtp_pacing, timer);
+	enum hrtimer_restart ret = HRTIMER_RESTART;
+
+	spin_lock(&p->lock);
+	if (p->shutdown) {
+		spin_unlock(&p->lock);
+		return HRTIMER_NORESTART;
+	}
+	p->credit += p->burst;
+	if (p->credit >= (int) p->burst) {
+		p->credit = p->burst;
+		p->armed  = false;
+		ret       = HRTIMER_NORESTART;
+	} else {
+		hrtimer_forward_now(timer, ns_to_ktime(p->interval_ns));
+	}
+	/* Scheduled under the lock, so dtp_destroy() can kill it */
+	tasklet_hi_schedule(&p->tasklet);
+	spin_unlock(&p->lock);
+
+	return ret;
+}
+
+/* Releases the next burst of PDUs held in the cwq by the pacing */
+static void dtp_pacing_worker(unsigned long data)
+{
+	struct dtp *  dtp = (struct dtp *) data;
+	unsigned long flags;
+	bool          shutdown;
+
+	spin_lock_irqsave(&dtp->pacing.lock, flags);
+	shutdown = dtp->pacing.shutdown;
+	spin_unlock_irqrestore(&dtp->pacing.lock, flags);
+	if (shutdown)
+		return;
+
+	if (dtp->cwq && cwq_size(dtp->cwq) > 0)
+		cwq_deliver(dtp->cwq, dtp, dtp->rmt);
+}
+
 int dtp_sv_init(struct dtp * dtp,
                 bool         rexmsn_ctrl,
                 bool         window_based,
@@ -1037,6 +1160,12 @@ struct dtp * dtp_create(struct efcp *       efcp,
 
         dtp->efcp = efcp;
 
+        spin_lock_init(&dtp->pacing.lock);
+        hrtimer_init(&dtp->pacing.timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+        dtp->pacing.timer.function = dtp_pacing_timer_fn;
+        tasklet_init(&dtp->pacing.tasklet, dtp_pacing_worker,
+                     (unsigned long) dtp);
+
 	if (robject_init_and_add(&dtp->robj,
 				 &dtp_rtype,
 				 parent,
@@ -1116,11 +1245,22 @@ int dtp_destroy(struct dtp * instance)
 	struct cwq * cwq = NULL;
 	struct rtxq * rtxq = NULL;
 	struct rttq * rttq = NULL;
+	unsigned long flags;
 	int ret = 0;
 
         if (!instance)
                 return -1;
 
+        /*
+         * Once shutdown is set neither the timer nor the worker re-arm
+         * each other, so the worker is killed first and then the timer
+         */
+        spin_lock_irqsave(&instance->pacing.lock, flags);
+        instance->pacing.shutdown = true;
+        spin_unlock_irqrestore(&instance->pacing.lock, flags);
+        tasklet_kill(&instance->pacing.tasklet);
+        hrtimer_cancel(&instance->pacing.timer);
+
 	spin_lock_bh(&instance->lock);
 
         if (instance->dtcp) {
@@ -1339,6 +1479,15 @@ int dtp_write(struct dtp * instance,
                 rcu_read_lock();
                 ps = container_of(rcu_dereference(instance->base.ps),
                                   struct dtp_ps, base);
+                if (instance->sv->rate_based && dtp_pacing_holds(instance)) {
+			/* The pacing timer releases it from the cwq */
+			if (ps->closed_window(ps, du)) {
+				LOG_ERR("Problems with the closed window policy");
+				goto stats_err_exit;
+			}
+			rcu_read_unlock();
+			return 0;
+		}
                 if (instance->sv->window_based || instance->sv->rate_based) {
 			/* NOTE: Might close window */
 			if (window_is_closed(instance,
@@ -1402,6 +1551,7 @@ int dtp_write(struct dtp * instance,
 								dtcp->sv->pdus_sent_in_time_unit + sbytes;
 				}
 				spin_unlock_bh(&instance->sv_lock);
+				dtp_pacing_consume(instance, sbytes);
 			}
                 }
                 if (instance->sv->rexmsn_ctrl) {
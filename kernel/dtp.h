@@ -66,6 +66,10 @@ void         dtp_squeue_flush(struct dtp * dtp);
 // be processed.
 void         dtp_start_rate_timer(struct dtp * dtp, struct dtcp * dtcp);
 
+/* Pacing of rate-based flow control, no-ops if it is not configured */
+bool         dtp_pacing_allows(struct dtp * dtp);
+void         dtp_pacing_consume(struct dtp * dtp, int bytes);
+
 /* FIXME: temporal addition so that DTCP's sending ack can call this function
  * that was originally static */
 struct pci * process_A_expiration(struct dtp * dtp, struct dtcp * dtcp);
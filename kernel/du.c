@@ -96,6 +96,7 @@ struct du *du_create_gfp(size_t data_len, gfp_t flags)
 	tmp->cfg = NULL;
 	tmp->sdup_head = NULL;
 	tmp->sdup_tail = NULL;
+	INIT_LIST_HEAD(&tmp->list);
 	skb_reserve(tmp->skb, MAX_PCIS_LEN);
 	skb_put(tmp->skb, data_len);
 	tmp->skb->ip_summed = CHECKSUM_UNNECESSARY;
@@ -203,6 +204,7 @@ static struct du *du_dup_gfp(gfp_t flags,
 	tmp->pci.h = du->pci.h;
 	tmp->pci.len = du->pci.len;
 	tmp->cfg = du->cfg;
+	INIT_LIST_HEAD(&tmp->list);
 
 	return tmp;
 }
@@ -241,6 +243,7 @@ struct du * du_create_from_skb(struct sk_buff* skb)
 	tmp->cfg = NULL;
 	tmp->sdup_head = NULL;
 	tmp->sdup_tail = NULL;
+	INIT_LIST_HEAD(&tmp->list);
 
 	LOG_DBG("DU allocated at %pk, with skb %pk", tmp, tmp->skb);
 
@@ -378,6 +381,7 @@ struct du * du_create_gfp_efcp(pdu_type_t type, struct efcp_config *cfg,
 	tmp->sdup_head = NULL;
 	tmp->sdup_tail = NULL;
 	tmp->cfg = cfg;
+	INIT_LIST_HEAD(&tmp->list);
 
 	return tmp;
 }
@@ -32,6 +32,8 @@ struct du {
 	void *sdup_head; /* opaque used by SDU protection policy (TTL)*/
 	void *sdup_tail; /* opaque used by SDU protection policy (error check) */
 	struct sk_buff *skb;
+	struct list_head list; /* linkage for the RMT PS scheduling queues */
+	ktime_t enqueue_time; /* set by the RMT PSs that track sojourn time */
 };
 
 struct du_list {
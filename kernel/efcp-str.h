@@ -22,6 +22,8 @@
 #define RINA_EFCP_STR_H
 
 #include <linux/list.h>
+#include <linux/hrtimer.h>
+#include <linux/interrupt.h>
 
 #include "common.h"
 #include "delim.h"
@@ -156,6 +158,21 @@ struct dtp_sv {
         bool       rate_fulfiled;
 };
 
+/*
+ * Rate-based flow control pacing: a token bucket of burst bytes, refilled
+ * every interval_ns while it is not full
+ */
+struct dtp_pacing {
+        struct hrtimer        timer;
+        struct tasklet_struct tasklet;
+        spinlock_t            lock;
+        bool                  armed; /* false while the bucket is full */
+        bool                  shutdown; /* the DTP is being destroyed */
+        int                   credit; /* bytes */
+        unsigned int          burst;
+        u64                   interval_ns;
+};
+
 struct dtp {
         struct dtcp *       dtcp;
         struct efcp *       efcp;
@@ -185,6 +202,7 @@ struct dtp {
                 struct timer_list rtx;
                 struct timer_list rendezvous;
         } timers;
+        struct dtp_pacing   pacing;
         struct robject	robj;
 
         spinlock_t		lock;
@@ -132,6 +132,11 @@ struct ipcp_instance_ops {
                              port_id_t                   port_id,
                              struct du *                 du);
 
+        /* Reports a liveness change detected by the RMT on an N-1 port */
+        int (* nm1_port_liveness_notify)(struct ipcp_instance_data * data,
+                                         port_id_t                   port_id,
+                                         bool                        alive);
+
         int (* pff_add)(struct ipcp_instance_data * data,
 			struct mod_pff_entry	  * entry);
 
@@ -146,6 +151,9 @@ struct ipcp_instance_ops {
         int (* pff_modify)(struct ipcp_instance_data * data,
                            struct list_head * entries);
 
+        int (* pff_update)(struct ipcp_instance_data * data,
+                           struct list_head * entries);
+
         int (* query_rib)(struct ipcp_instance_data * data,
                           struct list_head *          entries,
                           const string_t *            object_class,
@@ -61,6 +61,13 @@ struct mgmt_du_work_data {
         irati_msg_port_t  irati_port_id;
 };
 
+struct liveness_work_data {
+        ipc_process_id_t  ipcp_id;
+        port_id_t	  port_id;
+        irati_msg_port_t  irati_port_id;
+        bool              alive;
+};
+
 enum mgmt_state {
         MGMT_DATA_READY,
         MGMT_DATA_DESTROYED
@@ -274,6 +281,7 @@ cep_id_t connection_create_request(struct ipcp_instance_data * data,
         struct normal_flow *   flow;
         struct cep_ids_entry * cep_entry;
         struct ipcp_instance * ipcp;
+        struct ipcp_imap_entry * ref;
 
         if (!user_ipcp)
                 return cep_id_bad();
@@ -296,7 +304,7 @@ cep_id_t connection_create_request(struct ipcp_instance_data * data,
         INIT_LIST_HEAD(&cep_entry->list);
         cep_entry->cep_id = cep_id;
 
-        ipcp = kipcm_find_ipcp(default_kipcm, data->id);
+        ipcp = kipcm_find_ipcp(default_kipcm, data->id, &ref);
         if (!ipcp) {
                 LOG_ERR("KIPCM could not retrieve this IPCP");
                 efcp_connection_destroy(data->efcpc, cep_id);
@@ -309,6 +317,7 @@ cep_id_t connection_create_request(struct ipcp_instance_data * data,
         flow = find_flow(data, port_id);
         if (!flow) {
                 spin_unlock_bh(&data->lock);
+                kipcm_put_ipcp(ref);
                 LOG_ERR("Could not retrieve normal flow to create connection");
                 efcp_connection_destroy(data->efcpc, cep_id);
                 return cep_id_bad();
@@ -318,6 +327,7 @@ cep_id_t connection_create_request(struct ipcp_instance_data * data,
                                               port_id,
                                               ipcp)) {
                 spin_unlock_bh(&data->lock);
+                kipcm_put_ipcp(ref);
                 LOG_ERR("Could not bind flow with user_ipcp");
                 efcp_connection_destroy(data->efcpc, cep_id);
                 return cep_id_bad();
@@ -328,6 +338,7 @@ cep_id_t connection_create_request(struct ipcp_instance_data * data,
         flow->state = PORT_STATE_PENDING;
 
         spin_unlock_bh(&data->lock);
+        kipcm_put_ipcp(ref);
 
         return cep_id;
 }
@@ -339,13 +350,15 @@ static int connection_update_request(struct ipcp_instance_data * data,
 {
         struct normal_flow *   flow;
         struct ipcp_instance * n1_ipcp;
+        struct ipcp_imap_entry * ref;
 
-        n1_ipcp = kipcm_find_ipcp(default_kipcm, data->id);
+        n1_ipcp = kipcm_find_ipcp(default_kipcm, data->id, &ref);
         if (!n1_ipcp) {
                 LOG_ERR("KIPCM cannot retrieve this IPCP");
                 efcp_connection_destroy(data->efcpc, src_cep_id);
                 return -1;
         }
+        kipcm_put_ipcp(ref);
         if (efcp_connection_update(data->efcpc,
                                    src_cep_id,
                                    dst_cep_id))
@@ -522,6 +535,7 @@ connection_create_arrived(struct ipcp_instance_data * data,
         struct normal_flow *   flow;
         struct cep_ids_entry * cep_entry;
         struct ipcp_instance * ipcp;
+        struct ipcp_imap_entry * ref;
 
         if (!user_ipcp)
                 return cep_id_bad();
@@ -546,7 +560,7 @@ connection_create_arrived(struct ipcp_instance_data * data,
         INIT_LIST_HEAD(&cep_entry->list);
         cep_entry->cep_id = cep_id;
 
-        ipcp = kipcm_find_ipcp(default_kipcm, data->id);
+        ipcp = kipcm_find_ipcp(default_kipcm, data->id, &ref);
         if (!ipcp) {
                 LOG_ERR("KIPCM could not retrieve this IPCP");
                 efcp_connection_destroy(data->efcpc, cep_id);
@@ -559,6 +573,7 @@ connection_create_arrived(struct ipcp_instance_data * data,
         flow = find_flow(data, port_id);
         if (!flow) {
                 spin_unlock_bh(&data->lock);
+                kipcm_put_ipcp(ref);
                 LOG_ERR("Could not create a flow in normal-ipcp");
                 efcp_connection_destroy(data->efcpc, cep_id);
                 return cep_id_bad();
@@ -567,6 +582,7 @@ connection_create_arrived(struct ipcp_instance_data * data,
                                               port_id,
                                               ipcp)) {
                 spin_unlock_bh(&data->lock);
+                kipcm_put_ipcp(ref);
                 LOG_ERR("Could not bind flow with user_ipcp");
                 efcp_connection_destroy(data->efcpc, cep_id);
                 return cep_id_bad();
@@ -575,6 +591,7 @@ connection_create_arrived(struct ipcp_instance_data * data,
         flow->active = cep_id;
         flow->state = PORT_STATE_ALLOCATED;
         spin_unlock_bh(&data->lock);
+        kipcm_put_ipcp(ref);
 
         return cep_id;
 }
@@ -866,6 +883,65 @@ static int normal_mgmt_du_post(struct ipcp_instance_data * data,
         return 0;
 }
 
+static int liveness_notif_worker(void * o)
+{
+        struct liveness_work_data * data;
+        struct irati_kmsg_multi_msg msg;
+
+	ASSERT(o);
+
+        data = (struct liveness_work_data *) o;
+
+	msg.msg_type = RINA_C_IPCP_N1_PORT_LIVENESS_NOTIF;
+	msg.src_ipcp_id = data->ipcp_id;
+	msg.dest_ipcp_id = data->ipcp_id;
+	msg.event_id = 0;
+	msg.result = data->alive ? 1 : 0;
+	msg.port_id = data->port_id;
+	msg.cep_id = 0;
+
+	if (irati_ctrl_dev_snd_resp_msg(data->irati_port_id,
+					(struct irati_msg_base *) &msg)) {
+		LOG_ERR("Could not send N-1 port liveness notification");
+	}
+
+	rkfree(data);
+
+        return 0;
+}
+
+static int normal_nm1_port_liveness_notify(struct ipcp_instance_data * data,
+					   port_id_t                   port_id,
+					   bool                        alive)
+{
+        struct liveness_work_data * wdata;
+        struct rwq_work_item      * item;
+
+	if (!data) {
+		LOG_ERR("Bogus instance passed");
+		return -1;
+	}
+
+	LOG_INFO("N-1 port %d declared %s by the keepalive monitor",
+		 port_id, (alive ? "alive" : "dead"));
+
+        wdata = rkzalloc(sizeof(* wdata), GFP_ATOMIC);
+        if (!wdata)
+        	return -1;
+
+        wdata->port_id = port_id;
+        wdata->irati_port_id = data->irati_port;
+        wdata->ipcp_id = data->id;
+        wdata->alive = alive;
+        item  = rwq_work_create_ni(liveness_notif_worker, wdata);
+        if (!item) {
+        	rkfree(wdata);
+        	return -1;
+        }
+
+        return rwq_work_post(mgmt_sdu_wq, item);
+}
+
 static int normal_pff_add(struct ipcp_instance_data * data,
 			  struct mod_pff_entry *      entry)
 
@@ -908,6 +984,15 @@ static int normal_pff_modify(struct ipcp_instance_data * data,
 			      entries);
 }
 
+static int normal_pff_update(struct ipcp_instance_data * data,
+                   	     struct list_head * entries)
+{
+	ASSERT(data);
+
+	return rmt_pff_update(data->rmt,
+			      entries);
+}
+
 static const struct name * normal_ipcp_name(struct ipcp_instance_data * data)
 {
         ASSERT(data);
@@ -1243,12 +1328,14 @@ static struct ipcp_instance_ops normal_instance_ops = {
 
         .mgmt_du_write            = normal_mgmt_du_write,
         .mgmt_du_post             = normal_mgmt_du_post,
+        .nm1_port_liveness_notify = normal_nm1_port_liveness_notify,
 
         .pff_add                   = normal_pff_add,
         .pff_remove                = normal_pff_remove,
         .pff_dump                  = normal_pff_dump,
         .pff_flush                 = normal_pff_flush,
 	.pff_modify		   = normal_pff_modify,
+	.pff_update		   = normal_pff_update,
 
         .query_rib		   = NULL,
 
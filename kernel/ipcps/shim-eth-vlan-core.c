@@ -448,13 +448,13 @@ static void rinarp_resolve_handler(void *             opaque,
         struct ipcp_instance_data * data;
         struct ipcp_instance *      user_ipcp;
         struct ipcp_instance *      ipcp;
+        struct ipcp_imap_entry *    ref;
         struct shim_eth_flow *      flow;
 
         LOG_DBG("Entered the ARP resolve handler of the shim-eth");
 
 	ASSERT(opaque);
 	ASSERT(dest_pa);
-	ASSERT(dest_ha);
 
         data = (struct ipcp_instance_data *) opaque;
 
@@ -466,6 +466,25 @@ static void rinarp_resolve_handler(void *             opaque,
                 return;
         }
 
+        /* The ARP request could not be sent, the allocation fails */
+        if (!dest_ha) {
+                if (flow->port_id_state != PORT_STATE_PENDING) {
+                        spin_unlock_bh(&data->lock);
+                        return;
+                }
+                flow->port_id_state = PORT_STATE_NULL;
+                spin_unlock_bh(&data->lock);
+
+                LOG_ERR("Could not resolve the destination address");
+                if (kipcm_notify_flow_alloc_req_result(default_kipcm,
+                                                       data->id,
+                                                       flow->port_id,
+                                                       -1))
+                        LOG_ERR("Couldn't tell KIPCM the allocation failed");
+                unbind_and_destroy_flow(data, flow);
+                return;
+        }
+
         if (flow->port_id_state == PORT_STATE_PENDING) {
                 flow->port_id_state = PORT_STATE_ALLOCATED;
                 spin_unlock_bh(&data->lock);
@@ -475,7 +494,7 @@ static void rinarp_resolve_handler(void *             opaque,
                 user_ipcp = flow->user_ipcp;
                 ASSERT(user_ipcp);
 
-                ipcp = kipcm_find_ipcp(default_kipcm, data->id);
+                ipcp = kipcm_find_ipcp(default_kipcm, data->id, &ref);
                 if (!ipcp) {
                         LOG_ERR("KIPCM could not retrieve this IPCP");
                         unbind_and_destroy_flow(data, flow);
@@ -488,10 +507,12 @@ static void rinarp_resolve_handler(void *             opaque,
                 if (user_ipcp->ops->flow_binding_ipcp(user_ipcp->data,
                                                       flow->port_id,
                                                       ipcp)) {
+                        kipcm_put_ipcp(ref);
                         LOG_ERR("Could not bind flow with user_ipcp");
                         unbind_and_destroy_flow(data, flow);
                         return;
                 }
+                kipcm_put_ipcp(ref);
 
                 ASSERT(flow->sdu_queue);
 
@@ -622,6 +643,7 @@ eth_vlan_flow_allocate_response(struct ipcp_instance_data * data,
 {
         struct shim_eth_flow * flow;
         struct ipcp_instance * ipcp;
+        struct ipcp_imap_entry * ref;
 
        	if (!data) {
 		LOG_ERR("Bogus data passed, bailing out");
@@ -656,7 +678,7 @@ eth_vlan_flow_allocate_response(struct ipcp_instance_data * data,
 
         /* On positive response, flow should transition to allocated state */
         if (!result) {
-                ipcp = kipcm_find_ipcp(default_kipcm, data->id);
+                ipcp = kipcm_find_ipcp(default_kipcm, data->id, &ref);
                 if (!ipcp) {
                         LOG_ERR("KIPCM could not retrieve this IPCP");
                         kfa_port_id_release(data->kfa, port_id);
@@ -668,11 +690,13 @@ eth_vlan_flow_allocate_response(struct ipcp_instance_data * data,
                 if (user_ipcp->ops->flow_binding_ipcp(user_ipcp->data,
                                                       port_id,
                                                       ipcp)) {
+                        kipcm_put_ipcp(ref);
                         LOG_ERR("Could not bind flow with user_ipcp");
                         kfa_port_id_release(data->kfa, port_id);
                         unbind_and_destroy_flow(data, flow);
                         return -1;
                 }
+                kipcm_put_ipcp(ref);
 
                 spin_lock(&data->lock);
                 flow->port_id_state = PORT_STATE_ALLOCATED;
@@ -1057,9 +1081,10 @@ static int eth_vlan_du_write(struct ipcp_instance_data * data,
 static int eth_vlan_rcv_worker(void * o)
 {
         struct ipcp_instance_data *     data;
-        const struct gpa *              gpaddr;
+        struct gpa *                    gpaddr;
         struct name *                   sname;
         struct ipcp_instance           *ipcp;
+        struct ipcp_imap_entry         *ref;
 	struct ipcp_instance           *user_ipcp;
 
         struct shim_eth_flow *          flow;
@@ -1088,9 +1113,10 @@ static int eth_vlan_rcv_worker(void * o)
         if (!user_ipcp)
                 user_ipcp = kfa_ipcp_instance(data->kfa);
 
-        ipcp = kipcm_find_ipcp(default_kipcm, data->id);
+        ipcp = kipcm_find_ipcp(default_kipcm, data->id, &ref);
         if (!user_ipcp || !ipcp) {
                 LOG_ERR("Could not find required ipcps");
+                kipcm_put_ipcp(ref);
                 if (flow_destroy(data, flow))
                         LOG_ERR("Problems destroying shim-eth-vlan "
                                 "flow");
@@ -1103,6 +1129,7 @@ static int eth_vlan_rcv_worker(void * o)
 
         if (!is_port_id_ok(flow->port_id)) {
                 LOG_DBG("Port id is not ok");
+                kipcm_put_ipcp(ref);
                 if (flow_destroy(data, flow))
                         LOG_ERR("Problems destroying shim-eth-vlan "
                                 "flow");
@@ -1114,6 +1141,7 @@ static int eth_vlan_rcv_worker(void * o)
                 if (kfa_flow_create(data->kfa, flow->port_id, ipcp, data->id,
                 		    NULL, false)) {
                         LOG_ERR("Could not create flow in KFA");
+                        kipcm_put_ipcp(ref);
                         kfa_port_id_release(data->kfa, flow->port_id);
                         if (flow_destroy(data, flow))
                                 LOG_ERR("Problems destroying shim-eth-vlan "
@@ -1121,18 +1149,18 @@ static int eth_vlan_rcv_worker(void * o)
                         return -1;
                 }
         }
+        kipcm_put_ipcp(ref);
         LOG_DBG("Added flow to the list");
 
         sname  = NULL;
         gpaddr = rinarp_find_gpa(data->app_handle, flow->dest_ha);
-        if (gpaddr && gpa_is_ok(gpaddr)) {
-                flow->dest_pa = gpa_dup_gfp(GFP_KERNEL, gpaddr);
-                if (!flow->dest_pa) {
-                        LOG_ERR("Failed to duplicate gpa");
-                        kfa_port_id_release(data->kfa, flow->port_id);
-                        unbind_and_destroy_flow(data, flow);
-                        return -1;
-                }
+        if (gpaddr && !gpa_is_ok(gpaddr)) {
+                gpa_destroy(gpaddr);
+                gpaddr = NULL;
+        }
+        if (gpaddr) {
+                /* Takes the ownership of the copy returned by ARP */
+                flow->dest_pa = gpaddr;
 
                 gpastr = gpa_address_to_string_gfp(GFP_KERNEL, gpaddr);
                 if (!gpastr) {
@@ -1732,6 +1760,7 @@ static struct ipcp_instance_ops eth_vlan_instance_ops = {
 
         .mgmt_du_write            = NULL,
         .mgmt_du_post             = NULL,
+        .nm1_port_liveness_notify = NULL,
 
         .pff_add                   = NULL,
         .pff_remove                = NULL,
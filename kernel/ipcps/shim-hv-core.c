@@ -414,6 +414,7 @@ shim_hv_flow_allocate_response(struct ipcp_instance_data *priv,
         unsigned int ch;
         int response = RESP_KO;
         struct ipcp_instance * ipcp;
+        struct ipcp_imap_entry * ref;
 
         ASSERT(priv);
         ASSERT(is_port_id_ok(port_id));
@@ -449,7 +450,7 @@ shim_hv_flow_allocate_response(struct ipcp_instance_data *priv,
 
         if (result == 0) {
                 /* Positive response */
-                ipcp = kipcm_find_ipcp(default_kipcm, priv->id);
+                ipcp = kipcm_find_ipcp(default_kipcm, priv->id, &ref);
                 if (!ipcp) {
                         LOG_ERR("KIPCM could not retrieve this IPCP");
                         goto resp;
@@ -461,9 +462,11 @@ shim_hv_flow_allocate_response(struct ipcp_instance_data *priv,
                 if (user_ipcp->ops->flow_binding_ipcp(user_ipcp->data,
                                                       port_id,
                                                       ipcp)) {
+                        kipcm_put_ipcp(ref);
                         LOG_ERR("Could not bind flow with user_ipcp");
                         goto resp;
                 }
+                kipcm_put_ipcp(ref);
                 /* Let's do the transition to the ALLOCATED state. */
                 priv->vmpi.channels[ch].state = CHANNEL_STATE_ALLOCATED;
                 response = RESP_OK;
@@ -599,6 +602,7 @@ static void shim_hv_handle_allocate_req(struct ipcp_instance_data *priv,
         uint32_t ch;
         int err = -1;
         struct ipcp_instance * ipcp, * user_ipcp;
+        struct ipcp_imap_entry * ref;
 
         if (des_uint32(&msg, &ch, &len)) {
                 LOG_ERR("%s: truncated msg: while reading channel", __func__);
@@ -649,15 +653,17 @@ static void shim_hv_handle_allocate_req(struct ipcp_instance_data *priv,
                                             dst_application);
         if (!user_ipcp)
                 user_ipcp = kfa_ipcp_instance(priv->kfa);
-        ipcp = kipcm_find_ipcp(default_kipcm, priv->id);
+        ipcp = kipcm_find_ipcp(default_kipcm, priv->id, &ref);
         if (!user_ipcp || !ipcp) {
                 LOG_ERR("Could not find required ipcps");
+                kipcm_put_ipcp(ref);
                 goto port_alloc;
         }
 
         port_id = kfa_port_id_reserve(priv->kfa, priv->id);
         if (!is_port_id_ok(port_id)) {
                 LOG_ERR("%s: kfa_port_id_reserve() failed", __func__);
+                kipcm_put_ipcp(ref);
                 goto port_alloc;
         }
 
@@ -665,9 +671,11 @@ static void shim_hv_handle_allocate_req(struct ipcp_instance_data *priv,
                 LOG_DBG("This flow goes for an app");
                 if (kfa_flow_create(priv->kfa, port_id, ipcp)) {
                         LOG_ERR("Could not create flow in KFA");
+                        kipcm_put_ipcp(ref);
                         goto flow_arrived;
                 }
         }
+        kipcm_put_ipcp(ref);
 
         err = kipcm_flow_arrived(default_kipcm, priv->id, port_id,
                                  &priv->dif_name, dst_application,
@@ -714,6 +722,7 @@ static void shim_hv_handle_allocate_resp(struct ipcp_instance_data *priv,
         port_id_t port_id;
         int ret = -1;
         struct ipcp_instance * ipcp;
+        struct ipcp_imap_entry * ref;
         struct ipcp_instance * user_ipcp;
 
         if (des_uint32(&msg, &ch, &len)) {
@@ -758,7 +767,7 @@ static void shim_hv_handle_allocate_resp(struct ipcp_instance_data *priv,
                 wmb();
         }
 
-        ipcp = kipcm_find_ipcp(default_kipcm, priv->id);
+        ipcp = kipcm_find_ipcp(default_kipcm, priv->id, &ref);
         if (!ipcp) {
                 LOG_ERR("KIPCM could not retrieve this IPCP");
                 response = RESP_KO;
@@ -769,10 +778,12 @@ static void shim_hv_handle_allocate_resp(struct ipcp_instance_data *priv,
         if (user_ipcp->ops->flow_binding_ipcp(user_ipcp->data,
                                               port_id,
                                               ipcp)) {
+                kipcm_put_ipcp(ref);
                 LOG_ERR("Could not bind flow with user_ipcp");
                 response = RESP_KO;
                 goto resp_ko;
         }
+        kipcm_put_ipcp(ref);
 
         ret = kipcm_notify_flow_alloc_req_result(default_kipcm, priv->id,
                                                  port_id,
@@ -1203,6 +1214,7 @@ static struct ipcp_instance_ops shim_hv_ipcp_ops = {
 
         .mgmt_sdu_write            = NULL,
         .mgmt_sdu_post             = NULL,
+        .nm1_port_liveness_notify = NULL,
 
         .pff_add                   = NULL,
         .pff_remove                = NULL,
@@ -677,6 +677,7 @@ tcp_udp_flow_allocate_request(struct ipcp_instance_data * data,
         struct dir_entry *         entry;
         int                        err;
         struct ipcp_instance *     ipcp;
+        struct ipcp_imap_entry *   ref;
         unsigned                   len;
 
         ASSERT(data);
@@ -783,7 +784,7 @@ tcp_udp_flow_allocate_request(struct ipcp_instance_data * data,
                 }
 
                 flow->port_id_state = PORT_STATE_ALLOCATED;
-                ipcp = kipcm_find_ipcp(default_kipcm, data->id);
+                ipcp = kipcm_find_ipcp(default_kipcm, data->id, &ref);
                 if (!ipcp) {
                         LOG_ERR("KIPCM could not retrieve this IPCP");
                         if (fspec->ordered_delivery) {
@@ -801,6 +802,7 @@ tcp_udp_flow_allocate_request(struct ipcp_instance_data * data,
                 if (user_ipcp->ops->flow_binding_ipcp(user_ipcp->data,
                                                       flow->port_id,
                                                       ipcp)) {
+                        kipcm_put_ipcp(ref);
                         LOG_ERR("Could not bind flow with user_ipcp");
                         if (fspec->ordered_delivery) {
                                 kernel_sock_shutdown(flow->sock, SHUT_RDWR);
@@ -809,6 +811,7 @@ tcp_udp_flow_allocate_request(struct ipcp_instance_data * data,
                         unbind_and_destroy_flow(data, flow);
                         return -1;
                 }
+                kipcm_put_ipcp(ref);
 
                 if (flow->sdu_queue)
                         if (!rfifo_is_empty(flow->sdu_queue)) {
@@ -845,6 +848,7 @@ tcp_udp_flow_allocate_response(struct ipcp_instance_data * data,
         struct shim_tcp_udp_flow * flow;
         struct reg_app_data *      app;
         struct ipcp_instance *     ipcp;
+        struct ipcp_imap_entry *   ref;
 
         ASSERT(data);
         ASSERT(is_port_id_ok(port_id));
@@ -877,7 +881,7 @@ tcp_udp_flow_allocate_response(struct ipcp_instance_data * data,
                 flow->user_ipcp     = user_ipcp;
                 spin_unlock(&data->lock);
 
-                ipcp = kipcm_find_ipcp(default_kipcm, data->id);
+                ipcp = kipcm_find_ipcp(default_kipcm, data->id, &ref);
                 if (!ipcp) {
                         LOG_ERR("KIPCM could not retrieve this IPCP");
                         kfa_port_id_release(data->kfa, port_id);
@@ -892,11 +896,13 @@ tcp_udp_flow_allocate_response(struct ipcp_instance_data * data,
                 if (user_ipcp->ops->flow_binding_ipcp(user_ipcp->data,
                                                       flow->port_id,
                                                       ipcp)) {
+                        kipcm_put_ipcp(ref);
                         LOG_ERR("Could not bind flow with user_ipcp");
                         kfa_port_id_release(data->kfa, port_id);
                         unbind_and_destroy_flow(data, flow);
                         return -1;
                 }
+                kipcm_put_ipcp(ref);
 
                 LOG_DBG("Moving SDUs from sdu-queue to user-IPCP");
 
@@ -1088,6 +1094,7 @@ static int udp_process_msg(struct ipcp_instance_data * data,
         struct du *                 du;
         int                         size;
         struct ipcp_instance      * ipcp, * user_ipcp;
+        struct ipcp_imap_entry    * ref;
         char			    api_string[12];
 
 	/* Create SDU with max allowable size removing PCI and TAIL room */
@@ -1134,9 +1141,10 @@ static int udp_process_msg(struct ipcp_instance_data * data,
 
                 if (!user_ipcp)
                         user_ipcp = kfa_ipcp_instance(data->kfa);
-                ipcp = kipcm_find_ipcp(default_kipcm, data->id);
+                ipcp = kipcm_find_ipcp(default_kipcm, data->id, &ref);
                 if (!user_ipcp || !ipcp) {
                         LOG_ERR("Could not find required ipcps");
+                        kipcm_put_ipcp(ref);
                         du_destroy(du);
                         return -1;
                 }
@@ -1144,6 +1152,7 @@ static int udp_process_msg(struct ipcp_instance_data * data,
                 flow = rkzalloc(sizeof(*flow), GFP_ATOMIC);
                 if (!flow) {
                         LOG_ERR("Could not allocate flow");
+                        kipcm_put_ipcp(ref);
                         du_destroy(du);
                         return -1;
                 }
@@ -1158,6 +1167,7 @@ static int udp_process_msg(struct ipcp_instance_data * data,
 
                 if (!is_port_id_ok(flow->port_id)) {
                         LOG_ERR("Port id is not ok");
+                        kipcm_put_ipcp(ref);
                         du_destroy(du);
                         if (flow_destroy(data, flow))
                                 LOG_ERR("Problems destroying flow");
@@ -1175,6 +1185,7 @@ static int udp_process_msg(struct ipcp_instance_data * data,
                         if (kfa_flow_create(data->kfa, flow->port_id, ipcp,
                         		    data->id, NULL, false)) {
                                 LOG_ERR("Could not create flow in KFA");
+                                kipcm_put_ipcp(ref);
                                 du_destroy(du);
                                 kfa_port_id_release(data->kfa, flow->port_id);
                                 if (flow_destroy(data, flow))
@@ -1182,6 +1193,7 @@ static int udp_process_msg(struct ipcp_instance_data * data,
                                 return -1;
                         }
                 }
+                kipcm_put_ipcp(ref);
 
                 flow->sdu_queue = rfifo_create();
                 if (!flow->sdu_queue) {
@@ -1551,6 +1563,7 @@ static int tcp_process(struct ipcp_instance_data * data, struct socket * sock)
         struct name *              sname;
         int                        err;
         struct ipcp_instance     * ipcp, * user_ipcp;
+        struct ipcp_imap_entry   * ref;
         char	   		   api_string[12];
 
         ASSERT(sock);
@@ -1592,7 +1605,7 @@ static int tcp_process(struct ipcp_instance_data * data, struct socket * sock)
                         user_ipcp = kfa_ipcp_instance(data->kfa);
                 ASSERT(user_ipcp);
 
-                ipcp = kipcm_find_ipcp(default_kipcm, data->id);
+                ipcp = kipcm_find_ipcp(default_kipcm, data->id, &ref);
 
                 flow->port_id_state = PORT_STATE_PENDING;
                 flow->fspec_id      = 1;
@@ -1609,6 +1622,7 @@ static int tcp_process(struct ipcp_instance_data * data, struct socket * sock)
                         flow->port_id_state = PORT_STATE_NULL;
                         LOG_ERR("Port id is not ok");
 
+                        kipcm_put_ipcp(ref);
                         sock_release(acsock);
                         if (flow_destroy(data, flow))
                                 LOG_ERR("Problems destroying flow");
@@ -1622,12 +1636,14 @@ static int tcp_process(struct ipcp_instance_data * data, struct socket * sock)
                         if (kfa_flow_create(data->kfa, flow->port_id, ipcp,
                         		    data->id, NULL, false)) {
                                 LOG_ERR("Could not create flow in KFA");
+                                kipcm_put_ipcp(ref);
                                 kfa_port_id_release(data->kfa, flow->port_id);
                                 if (flow_destroy(data, flow))
                                         LOG_ERR("Problems destroying flow");
                                 return -1;
                         }
                 }
+                kipcm_put_ipcp(ref);
 
                 flow->sdu_queue = rfifo_create_ni();
                 if (!flow->sdu_queue) {
@@ -2650,6 +2666,7 @@ static struct ipcp_instance_ops tcp_udp_instance_ops = {
 
         .mgmt_du_write            = NULL,
         .mgmt_du_post             = NULL,
+        .nm1_port_liveness_notify = NULL,
 
         .pff_add                   = NULL,
         .pff_remove                = NULL,
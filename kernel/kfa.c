@@ -401,6 +401,8 @@ static int disable_write(struct ipcp_instance_data *data, port_id_t id)
 
 	flow->state = PORT_STATE_DISABLED;
 	LOG_DBG("Disabled write in port id %d", id);
+	if (flow->ip_dev)
+		rina_dev_tx_stop(flow->ip_dev);
 	spin_unlock_bh(&instance->lock);
 
 	LOG_DBG("IPCP notified CWQ exhausted");
@@ -446,6 +448,8 @@ static int enable_write(struct ipcp_instance_data *data, port_id_t id)
 	}
 	if (flow->state == PORT_STATE_DISABLED) {
 		flow->state = PORT_STATE_ALLOCATED;
+		if (flow->ip_dev)
+			rina_dev_tx_wake(flow->ip_dev);
 		if (flow->wqs) {
 			wq = &flow->wqs->write_wqueue;
 			spin_unlock_bh(&instance->lock);
@@ -473,6 +477,28 @@ int kfa_flow_skb_write(struct ipcp_instance_data * data,
 				 size, blocking);
 }
 
+size_t kfa_flow_skb_max_sdu_size(struct ipcp_instance_data * data,
+				 port_id_t   id)
+{
+	return kfa_flow_max_sdu_size(data->kfa, id);
+}
+
+bool kfa_flow_skb_writable(struct ipcp_instance_data * data,
+			   port_id_t   id)
+{
+	struct ipcp_flow *flow;
+	bool   writable;
+
+	spin_lock_bh(&data->kfa->lock);
+	flow = kfa_pmap_find(data->kfa->flows, id);
+	/* Other errors are reported by the write itself */
+	writable = !flow || (flow->state != PORT_STATE_PENDING &&
+			     flow->state != PORT_STATE_DISABLED);
+	spin_unlock_bh(&data->kfa->lock);
+
+	return writable;
+}
+
 int kfa_flow_ub_write(struct kfa * instance,
 		      port_id_t    id,
 		      const char __user * buffer,
@@ -649,12 +675,14 @@ int kfa_flow_ub_write(struct kfa * instance,
 					|| flow->state == PORT_STATE_DISABLED) {
 				LOG_DBG("Flow %d is not ready for writing", id);
 				retval = -EAGAIN;
+				du_destroy(du);
 				goto finish;
 			}
 
 			if (flow->state == PORT_STATE_DEALLOCATED) {
 				LOG_ERR("Flow %d has been deallocated", id);
 				retval = -ESHUTDOWN;
+				du_destroy(du);
 				goto finish;
 			}
 
@@ -1195,6 +1223,9 @@ static int kfa_flow_ipcp_bind(struct ipcp_instance_data *data,
 		spin_unlock_bh(&instance->lock);
 		return -1;
 	}
+	/* The device stops its queue while the flow is pending */
+	if (flow->ip_dev)
+		rina_dev_tx_wake(flow->ip_dev);
 
 	spin_unlock_bh(&instance->lock);
 
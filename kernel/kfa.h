@@ -47,6 +47,13 @@ int	    kfa_flow_skb_write(struct ipcp_instance_data * data,
 			       size_t size,
                                bool blocking);
 
+size_t	    kfa_flow_skb_max_sdu_size(struct ipcp_instance_data * data,
+				      port_id_t   id);
+
+/* False if a non-blocking write to the flow would return -EAGAIN */
+bool	    kfa_flow_skb_writable(struct ipcp_instance_data * data,
+				  port_id_t   id);
+
 int	    kfa_flow_ub_write(struct kfa * kfa,
 			      port_id_t   id,
 			      const char __user *buffer,
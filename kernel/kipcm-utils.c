@@ -22,6 +22,9 @@
 #include <linux/export.h>
 #include <linux/hashtable.h>
 #include <linux/list.h>
+#include <linux/rculist.h>
+#include <linux/rwsem.h>
+#include <linux/kref.h>
 
 #define RINA_PREFIX "kipcm-utils"
 
@@ -31,9 +34,19 @@
 #include "common.h"
 #include "kipcm-utils.h"
 #include "ipcp-utils.h"
+#ifdef CONFIG_RINA_KIPCM_REGRESSION_TESTS
+#include <linux/kthread.h>
+#include <linux/completion.h>
+#include "pidm.h"
+#endif
 
 /*
  * IMAPs
+ *
+ * NOTE: Lookups are lockless (RCU), additions and removals have to be
+ *       serialized by the user. Each entry carries a rw-semaphore that the
+ *       handlers working on the instance hold (read) while they run, so that
+ *       the instance can be destroyed only once they are all done.
  */
 
 #define IMAP_HASH_BITS 7
@@ -46,6 +59,11 @@ struct ipcp_imap_entry {
         ipc_process_id_t       key;
         struct ipcp_instance * value;
         struct hlist_node      hlist;
+
+        struct rw_semaphore    sem;   /* Held (read) by the users */
+        bool                   dead;  /* Protected by sem */
+        struct kref            refs;
+        struct rcu_head        rcu;
 };
 
 struct ipcp_imap * ipcp_imap_create(void)
@@ -61,6 +79,18 @@ struct ipcp_imap * ipcp_imap_create(void)
         return tmp;
 }
 
+static void imap_entry_free_rcu(struct rcu_head * head)
+{ rkfree(container_of(head, struct ipcp_imap_entry, rcu)); }
+
+/* Lockless readers may still be walking through it */
+static void imap_entry_release(struct kref * kref)
+{
+        struct ipcp_imap_entry * entry;
+
+        entry = container_of(kref, struct ipcp_imap_entry, refs);
+        call_rcu(&entry->rcu, imap_entry_free_rcu);
+}
+
 int ipcp_imap_destroy(struct ipcp_imap * map)
 {
         struct ipcp_imap_entry * entry;
@@ -70,10 +100,11 @@ int ipcp_imap_destroy(struct ipcp_imap * map)
         ASSERT(map);
 
         hash_for_each_safe(map->table, bucket, tmp, entry, hlist) {
-                hash_del(&entry->hlist);
-                rkfree(entry);
+                hash_del_rcu(&entry->hlist);
+                kref_put(&entry->refs, imap_entry_release);
         }
 
+        rcu_barrier();
         rkfree(map);
 
         return 0;
@@ -87,6 +118,10 @@ int ipcp_imap_empty(struct ipcp_imap * map)
 
 #define imap_hash(T, K) hash_min(K, HASH_BITS(T))
 
+/*
+ * The entry returned is valid as long as the caller is in a RCU read-side
+ * critical section or it serializes the writers
+ */
 static struct ipcp_imap_entry * imap_entry_find(struct ipcp_imap * map,
                                                 ipc_process_id_t   key)
 {
@@ -95,15 +130,20 @@ static struct ipcp_imap_entry * imap_entry_find(struct ipcp_imap * map,
 
         ASSERT(map);
 
+        rcu_read_lock();
         head = &map->table[imap_hash(map->table, key)];
-        hlist_for_each_entry(entry, head, hlist) {
-                if (entry->key == key)
+        hlist_for_each_entry_rcu(entry, head, hlist) {
+                if (entry->key == key) {
+                        rcu_read_unlock();
                         return entry;
+                }
         }
+        rcu_read_unlock();
 
         return NULL;
 }
 
+/* The writers have to be serialized, the ipcp_name() hooks can sleep */
 static struct ipcp_imap_entry *
 imap_entry_find_by_name(struct ipcp_imap *  map,
                         const struct name * name)
@@ -140,14 +180,16 @@ struct ipcp_instance * ipcp_imap_find(struct ipcp_imap * map,
                                       ipc_process_id_t   key)
 {
         struct ipcp_imap_entry * entry;
+        struct ipcp_instance *   value;
 
         ASSERT(map);
 
+        rcu_read_lock();
         entry = imap_entry_find(map, key);
-        if (!entry)
-                return NULL;
+        value = entry ? entry->value : NULL;
+        rcu_read_unlock();
 
-        return entry->value;
+        return value;
 }
 
 struct ipcp_instance * ipcp_imap_find_by_name(struct ipcp_imap *  map,
@@ -213,30 +255,283 @@ int ipcp_imap_add(struct ipcp_imap *     map,
 
         tmp->key   = key;
         tmp->value = value;
+        tmp->dead  = false;
+        init_rwsem(&tmp->sem);
+        kref_init(&tmp->refs); /* The map reference */
         INIT_HLIST_NODE(&tmp->hlist);
 
-        hash_add(map->table, &tmp->hlist, key);
+        hash_add_rcu(map->table, &tmp->hlist, key);
 
         return 0;
 }
 
-int ipcp_imap_remove(struct ipcp_imap * map,
-                     ipc_process_id_t   key)
+static struct ipcp_imap_entry * imap_entry_pin(struct ipcp_imap * map,
+                                               ipc_process_id_t   key,
+                                               bool               wait)
+{
+        struct ipcp_imap_entry * entry;
+
+        ASSERT(map);
+
+        rcu_read_lock();
+        entry = imap_entry_find(map, key);
+        if (entry && !kref_get_unless_zero(&entry->refs))
+                entry = NULL;
+        rcu_read_unlock();
+
+        if (!entry)
+                return NULL;
+
+        if (wait) {
+                down_read(&entry->sem);
+        } else if (!down_read_trylock(&entry->sem)) {
+                /* The instance is being destroyed */
+                kref_put(&entry->refs, imap_entry_release);
+                return NULL;
+        }
+        if (entry->dead) {
+                up_read(&entry->sem);
+                kref_put(&entry->refs, imap_entry_release);
+                return NULL;
+        }
+
+        return entry;
+}
+
+struct ipcp_imap_entry * ipcp_imap_get(struct ipcp_imap * map,
+                                       ipc_process_id_t   key)
+{ return imap_entry_pin(map, key, true); }
+
+struct ipcp_imap_entry * ipcp_imap_tryget(struct ipcp_imap * map,
+                                          ipc_process_id_t   key)
+{ return imap_entry_pin(map, key, false); }
+
+struct ipcp_instance * ipcp_imap_entry_value(struct ipcp_imap_entry * entry)
+{
+        ASSERT(entry);
+
+        return entry->value;
+}
+
+void ipcp_imap_put(struct ipcp_imap_entry * entry)
+{
+        if (!entry)
+                return;
+
+        up_read(&entry->sem);
+        kref_put(&entry->refs, imap_entry_release);
+}
+
+struct ipcp_imap_entry * ipcp_imap_unlink(struct ipcp_imap * map,
+                                          ipc_process_id_t   key)
 {
         struct ipcp_imap_entry * cur;
 
         ASSERT(map);
 
         cur = imap_entry_find(map, key);
+        if (!cur)
+                return NULL;
+
+        hash_del_rcu(&cur->hlist);
+
+        return cur;
+}
+
+void ipcp_imap_entry_kill(struct ipcp_imap_entry * entry)
+{
+        if (!entry)
+                return;
+
+        /* Waits for the users still working on the instance */
+        down_write(&entry->sem);
+        entry->dead = true;
+        up_write(&entry->sem);
+
+        kref_put(&entry->refs, imap_entry_release);
+}
+
+int ipcp_imap_remove(struct ipcp_imap * map,
+                     ipc_process_id_t   key)
+{
+        struct ipcp_imap_entry * cur;
+
+        cur = ipcp_imap_unlink(map, key);
         if (!cur)
                 return -1;
 
-        hash_del(&cur->hlist);
-        rkfree(cur);
+        ipcp_imap_entry_kill(cur);
+
+        return 0;
+}
+
+#ifdef CONFIG_RINA_KIPCM_REGRESSION_TESTS
+#define IMAP_STRESS_IPCPS   8
+#define IMAP_STRESS_THREADS 8
+#define IMAP_STRESS_LOOPS   20000
+
+struct imap_stress {
+        struct ipcp_imap *     map;
+        struct ipcp_instance * instances[IMAP_STRESS_IPCPS];
+        atomic_t               users[IMAP_STRESS_IPCPS];
+        struct pidm *          pidm;
+        spinlock_t             pidm_lock;
+        atomic_t               errors;
+};
+
+struct imap_stress_worker {
+        struct imap_stress * stress;
+        int                  id;
+        struct completion    done;
+};
+
+/* Allocates and releases flows (port-ids) on all the IPCPs, pinning them */
+static int imap_stress_worker(void * data)
+{
+        struct imap_stress_worker * w = data;
+        struct imap_stress *        st = w->stress;
+        struct ipcp_imap_entry *    entry;
+        port_id_t                   pid;
+        int                         i, k;
+
+        for (i = 0; i < IMAP_STRESS_LOOPS; i++) {
+                k = (i + w->id) % IMAP_STRESS_IPCPS;
+
+                entry = ipcp_imap_get(st->map, k + 1);
+                if (!entry) /* Being destroyed */
+                        continue;
+
+                atomic_inc(&st->users[k]);
+                if (ipcp_imap_entry_value(entry) != st->instances[k])
+                        atomic_inc(&st->errors);
+
+                spin_lock_bh(&st->pidm_lock);
+                pid = pidm_allocate(st->pidm);
+                spin_unlock_bh(&st->pidm_lock);
+                if (!is_port_id_ok(pid)) {
+                        atomic_inc(&st->errors);
+                } else {
+                        spin_lock_bh(&st->pidm_lock);
+                        if (pidm_release(st->pidm, pid))
+                                atomic_inc(&st->errors);
+                        spin_unlock_bh(&st->pidm_lock);
+                }
+
+                atomic_dec(&st->users[k]);
+                ipcp_imap_put(entry);
+
+                if (!(i % 256))
+                        cond_resched();
+        }
+
+        complete(&w->done);
 
         return 0;
 }
 
+bool regression_tests_imap(void)
+{
+        struct imap_stress *        st;
+        struct imap_stress_worker * workers;
+        struct ipcp_imap_entry *    entry;
+        struct task_struct *        task;
+        int                         i, k, started;
+        bool                        ret = false;
+
+        LOG_DBG("IMAP regression tests");
+
+        st = rkzalloc(sizeof(*st), GFP_KERNEL);
+        if (!st)
+                return false;
+        workers = rkzalloc(IMAP_STRESS_THREADS * sizeof(*workers),
+                           GFP_KERNEL);
+        if (!workers) {
+                rkfree(st);
+                return false;
+        }
+
+        spin_lock_init(&st->pidm_lock);
+        atomic_set(&st->errors, 0);
+        st->pidm = pidm_create();
+        st->map  = ipcp_imap_create();
+        if (!st->pidm || !st->map)
+                goto out;
+
+        LOG_DBG("Regression test #1: create %d instances", IMAP_STRESS_IPCPS);
+        for (k = 0; k < IMAP_STRESS_IPCPS; k++) {
+                atomic_set(&st->users[k], 0);
+                st->instances[k] = rkzalloc(sizeof(struct ipcp_instance),
+                                            GFP_KERNEL);
+                if (!st->instances[k] ||
+                    ipcp_imap_add(st->map, k + 1, st->instances[k]))
+                        goto out;
+        }
+
+        LOG_DBG("Regression test #2: %d parallel workers",
+                IMAP_STRESS_THREADS);
+        for (started = 0; started < IMAP_STRESS_THREADS; started++) {
+                workers[started].stress = st;
+                workers[started].id     = started;
+                init_completion(&workers[started].done);
+                task = kthread_run(imap_stress_worker, &workers[started],
+                                   "imap-stress/%d", started);
+                if (IS_ERR(task))
+                        break;
+        }
+
+        LOG_DBG("Regression test #3: destroy and re-create while in use");
+        for (i = 0; i < 4 * IMAP_STRESS_IPCPS; i++) {
+                k = i % IMAP_STRESS_IPCPS;
+
+                /* The instances map writers are serialized by this thread */
+                entry = ipcp_imap_unlink(st->map, k + 1);
+                if (!entry) {
+                        atomic_inc(&st->errors);
+                        break;
+                }
+                ipcp_imap_entry_kill(entry);
+
+                /* Nobody can be using it anymore */
+                if (atomic_read(&st->users[k]))
+                        atomic_inc(&st->errors);
+
+                if (ipcp_imap_add(st->map, k + 1, st->instances[k])) {
+                        atomic_inc(&st->errors);
+                        break;
+                }
+                cond_resched();
+        }
+
+        for (i = 0; i < started; i++)
+                wait_for_completion(&workers[i].done);
+
+        if (started != IMAP_STRESS_THREADS) {
+                LOG_ERR("Could only start %d workers", started);
+                goto out;
+        }
+
+        if (atomic_read(&st->errors)) {
+                LOG_ERR("IMAP stress test got %d errors",
+                        atomic_read(&st->errors));
+                goto out;
+        }
+
+        ret = true;
+ out:
+        if (st->map)
+                ipcp_imap_destroy(st->map);
+        for (k = 0; k < IMAP_STRESS_IPCPS; k++)
+                if (st->instances[k])
+                        rkfree(st->instances[k]);
+        if (st->pidm)
+                pidm_destroy(st->pidm);
+        rkfree(workers);
+        rkfree(st);
+
+        return ret;
+}
+#endif
+
 /*
  * FMAPs
  */
@@ -350,15 +645,16 @@ int kipcm_pmap_update(struct kipcm_pmap * map,
         return 0;
 }
 
-int kipcm_pmap_add(struct kipcm_pmap * map,
-                   port_id_t           key,
-		   uint32_t            value)
+static int kipcm_pmap_add_gfp(gfp_t               flags,
+                              struct kipcm_pmap * map,
+                              port_id_t           key,
+                              uint32_t            value)
 {
         struct kipcm_pmap_entry * tmp;
 
         ASSERT(map);
 
-        tmp = rkzalloc(sizeof(*tmp), GFP_KERNEL);
+        tmp = rkzalloc(sizeof(*tmp), flags);
         if (!tmp)
                 return -1;
 
@@ -371,6 +667,16 @@ int kipcm_pmap_add(struct kipcm_pmap * map,
         return 0;
 }
 
+int kipcm_pmap_add(struct kipcm_pmap * map,
+                   port_id_t           key,
+                   uint32_t            value)
+{ return kipcm_pmap_add_gfp(GFP_KERNEL, map, key, value); }
+
+int kipcm_pmap_add_ni(struct kipcm_pmap * map,
+                      port_id_t           key,
+                      uint32_t            value)
+{ return kipcm_pmap_add_gfp(GFP_ATOMIC, map, key, value); }
+
 int kipcm_pmap_remove(struct kipcm_pmap * map,
                       port_id_t           key)
 {
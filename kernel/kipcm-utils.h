@@ -25,6 +25,7 @@
 #include "kipcm.h"
 
 struct ipcp_imap;
+struct ipcp_imap_entry;
 struct kipcm_pmap;
 struct kipcm_smap;
 
@@ -44,6 +45,28 @@ int                    ipcp_imap_update(struct ipcp_imap *     map,
                                         struct ipcp_instance * value);
 int                    ipcp_imap_remove(struct ipcp_imap * map,
                                         ipc_process_id_t   key);
+
+/*
+ * Pins an instance: it cannot be destroyed until ipcp_imap_put() is called.
+ * Returns NULL if the instance does not exist or it is being destroyed
+ */
+struct ipcp_imap_entry * ipcp_imap_get(struct ipcp_imap * map,
+                                       ipc_process_id_t   key);
+/*
+ * Same, but it does not wait for a destroy in progress, so that it can be
+ * used while other instances (or the same one) are already pinned, and
+ * from atomic context
+ */
+struct ipcp_imap_entry * ipcp_imap_tryget(struct ipcp_imap * map,
+                                          ipc_process_id_t   key);
+struct ipcp_instance *   ipcp_imap_entry_value(struct ipcp_imap_entry * entry);
+void                     ipcp_imap_put(struct ipcp_imap_entry * entry);
+
+/* Removes the entry from the map, it is still alive */
+struct ipcp_imap_entry * ipcp_imap_unlink(struct ipcp_imap * map,
+                                          ipc_process_id_t   key);
+/* Waits for all the users of the entry, then drops it */
+void                     ipcp_imap_entry_kill(struct ipcp_imap_entry * entry);
 ipc_process_id_t       ipcp_imap_find_factory(struct ipcp_imap *    map,
                                               struct ipcp_factory * factory);
 
@@ -58,6 +81,9 @@ int                    kipcm_pmap_update(struct kipcm_pmap * map,
 int                    kipcm_pmap_add(struct kipcm_pmap * map,
                                       port_id_t           key,
 				      uint32_t            value);
+int                    kipcm_pmap_add_ni(struct kipcm_pmap * map,
+                                         port_id_t           key,
+                                         uint32_t            value);
 int                    kipcm_pmap_remove(struct kipcm_pmap * map,
                                          port_id_t           key);
 struct kipcm_smap *    kipcm_smap_create(void);
@@ -78,5 +104,8 @@ int                    kipcm_smap_remove(struct kipcm_smap * map,
                                          uint32_t            key);
 bool                   is_rnl_seq_num_ok(uint32_t sn);
 
+#ifdef CONFIG_RINA_KIPCM_REGRESSION_TESTS
+bool                   regression_tests_imap(void);
+#endif
 
 #endif
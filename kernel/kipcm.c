@@ -43,6 +43,7 @@
 #define DEFAULT_FACTORY "normal-ipc"
 
 struct flow_messages {
+        spinlock_t          lock; /* Protects both the maps */
         struct kipcm_pmap * ingress;
         struct kipcm_smap * egress;
 };
@@ -52,6 +53,11 @@ struct kipcm {
 	 * ipcps), instances could be probably removed if we stay with robjs
 	 */
 	struct rset *           rset;
+        /*
+         * Serializes the factories and the changes to the instances map.
+         * The handlers working on an IPCP pin it in the map instead (see
+         * kipcm_ipcp_msg_handler), so that unrelated IPCPs do not contend.
+         */
         struct mutex            lock;
         struct ipcp_factories * factories;
         struct ipcp_imap *      instances;
@@ -139,6 +145,7 @@ static int notify_ipcp_allocate_flow_request(irati_msg_port_t ctrl_port,
 	struct irati_kmsg_ipcm_allocate_flow * msg;
         struct ipcp_instance * ipc_process;
         struct ipcp_instance * user_ipcp;
+        struct ipcp_imap_entry * user_entry = NULL;
         ipc_process_id_t       ipc_id;
         ipc_process_id_t       user_ipc_id;
         struct kipcm *         kipcm;
@@ -159,7 +166,7 @@ static int notify_ipcp_allocate_flow_request(irati_msg_port_t ctrl_port,
         ipc_id = 0;
         user_ipc_id  = msg->src_ipcp_id;
         ipc_id       = msg->dest_ipcp_id;
-        /* FIXME: Here we should take the lock */
+        /* The instance is pinned by kipcm_ipcp_msg_handler */
         ipc_process  = ipcp_imap_find(kipcm->instances, ipc_id);
         if (!ipc_process) {
                 LOG_ERR("IPC process %d not found", ipc_id);
@@ -169,20 +176,25 @@ static int notify_ipcp_allocate_flow_request(irati_msg_port_t ctrl_port,
         pid = kfa_port_id_reserve(kipcm->kfa, ipc_id);
         ASSERT(is_port_id_ok(pid));
 
-        if (kipcm_pmap_add(kipcm->messages->ingress, pid, msg->event_id)) {
+        spin_lock_bh(&kipcm->messages->lock);
+        if (kipcm_pmap_add_ni(kipcm->messages->ingress, pid, msg->event_id)) {
+                spin_unlock_bh(&kipcm->messages->lock);
                 LOG_ERR("Could not add map [pid, seq_num]: [%d, %u]",
                         pid, msg->event_id);
                 kfa_port_id_release(kipcm->kfa, pid);
                 goto fail;
         }
+        spin_unlock_bh(&kipcm->messages->lock);
 
         if (user_ipc_id) {
-                user_ipcp = ipcp_imap_find(kipcm->instances, user_ipc_id);
-                if (!user_ipcp) {
+                /* Pinned while the request is handed to the IPCP */
+                user_entry = ipcp_imap_tryget(kipcm->instances, user_ipc_id);
+                if (!user_entry) {
                         LOG_ERR("Could not find the user ipcp of the flow...");
                         kfa_port_id_release(kipcm->kfa, pid);
                         goto fail;
                 }
+                user_ipcp = ipcp_imap_entry_value(user_entry);
         } else {
                 user_ipcp = kfa_ipcp_instance(kipcm->kfa);
 		/* NOTE: original function called non-blocking I/O?? */
@@ -208,9 +220,12 @@ static int notify_ipcp_allocate_flow_request(irati_msg_port_t ctrl_port,
                 goto fail;
         }
 
+        ipcp_imap_put(user_entry);
+
         return 0;
 
  fail:
+        ipcp_imap_put(user_entry);
         return alloc_flow_req_reply(ctrl_port, ipc_id, -1, msg->event_id,
         			    port_id_bad());
 }
@@ -223,9 +238,11 @@ static int notify_ipcp_allocate_flow_response(irati_msg_port_t ctrl_port,
         struct kipcm *         kipcm;
         struct ipcp_instance * ipc_process;
         struct ipcp_instance * user_ipcp;
+        struct ipcp_imap_entry * user_entry = NULL;
         ipc_process_id_t       ipc_id;
         ipc_process_id_t       user_ipc_id;
         port_id_t              pid;
+        int                    retval;
 
         if (!data) {
                 LOG_ERR("Bogus kipcm instance passed, cannot parse NL msg");
@@ -242,7 +259,9 @@ static int notify_ipcp_allocate_flow_response(irati_msg_port_t ctrl_port,
         user_ipc_id  = msg->src_ipcp_id;
         ipc_id       = msg->dest_ipcp_id;
         ipc_process  = ipcp_imap_find(kipcm->instances, ipc_id);
+        spin_lock_bh(&kipcm->messages->lock);
         pid = kipcm_smap_find(kipcm->messages->egress, msg->event_id);
+        spin_unlock_bh(&kipcm->messages->lock);
         if (!ipc_process) {
                 LOG_ERR("IPC process %d not found", ipc_id);
                 kfa_port_id_release(kipcm->kfa, pid);
@@ -254,15 +273,21 @@ static int notify_ipcp_allocate_flow_response(irati_msg_port_t ctrl_port,
                 kfa_port_id_release(kipcm->kfa, pid);
                 goto fail;
         }
-        if (kipcm_smap_remove(kipcm->messages->egress, msg->event_id)) {
+        spin_lock_bh(&kipcm->messages->lock);
+        retval = kipcm_smap_remove(kipcm->messages->egress, msg->event_id);
+        spin_unlock_bh(&kipcm->messages->lock);
+        if (retval) {
                 LOG_ERR("Could not destroy egress messages map entry");
                 kfa_port_id_release(kipcm->kfa, pid);
                 goto fail;
         }
 
         user_ipcp = kfa_ipcp_instance(kipcm->kfa);
-        if (user_ipc_id)
-                user_ipcp = ipcp_imap_find(kipcm->instances, user_ipc_id);
+        if (user_ipc_id) {
+                user_entry = ipcp_imap_tryget(kipcm->instances, user_ipc_id);
+                user_ipcp  = user_entry ?
+                        ipcp_imap_entry_value(user_entry) : NULL;
+        }
 
         ASSERT(ipc_process->ops);
         ASSERT(ipc_process->ops->flow_allocate_response);
@@ -274,6 +299,8 @@ static int notify_ipcp_allocate_flow_response(irati_msg_port_t ctrl_port,
                 LOG_ERR("Failed allocate flow response for port id: %d",
                         pid);
         }
+
+        ipcp_imap_put(user_entry);
 fail:
         return 0;
 }
@@ -618,6 +645,7 @@ static int notify_ipcp_conn_create_req(irati_msg_port_t ctrl_port,
         port_id_t              port_id;
         cep_id_t               src_cep;
         struct ipcp_instance * user_ipcp;
+        struct ipcp_imap_entry * user_entry = NULL;
 
         ipc_id  = 0;
         port_id = 0;
@@ -644,9 +672,10 @@ static int notify_ipcp_conn_create_req(irati_msg_port_t ctrl_port,
         user_ipc_id = msg->flow_user_ipc_process_id;
         user_ipcp = kfa_ipcp_instance(kipcm->kfa);
         if (user_ipc_id) {
-                user_ipcp = ipcp_imap_find(kipcm->instances, user_ipc_id);
-                if (!user_ipcp)
+                user_entry = ipcp_imap_tryget(kipcm->instances, user_ipc_id);
+                if (!user_entry)
                         goto fail;
+                user_ipcp = ipcp_imap_entry_value(user_entry);
         }
 
         /* IPCP takes ownership of the dtp and dtcp cfg params */
@@ -663,6 +692,9 @@ static int notify_ipcp_conn_create_req(irati_msg_port_t ctrl_port,
         msg->dtp_cfg = NULL;
         msg->dtcp_cfg = NULL;
 
+        ipcp_imap_put(user_entry);
+        user_entry = NULL;
+
         if (!is_cep_id_ok(src_cep)) {
                 LOG_ERR("IPC process could not create connection");
                 goto fail;
@@ -672,6 +704,7 @@ static int notify_ipcp_conn_create_req(irati_msg_port_t ctrl_port,
                                       msg->event_id);
 
  fail:
+        ipcp_imap_put(user_entry);
  	return conn_create_resp_reply(ctrl_port, ipc_id, port_id, cep_id_bad(),
                                	      msg->event_id);
 }
@@ -719,6 +752,7 @@ static int notify_ipcp_conn_create_arrived(irati_msg_port_t ctrl_port,
         port_id_t port_id;
         cep_id_t src_cep;
         struct ipcp_instance * user_ipcp;
+        struct ipcp_imap_entry * user_entry = NULL;
 
         ipc_id  = 0;
         port_id = 0;
@@ -746,9 +780,10 @@ static int notify_ipcp_conn_create_arrived(irati_msg_port_t ctrl_port,
 
         user_ipcp = kfa_ipcp_instance(kipcm->kfa);
         if (user_ipc_id) {
-                user_ipcp = ipcp_imap_find(kipcm->instances, user_ipc_id);
-                if (!user_ipcp)
+                user_entry = ipcp_imap_tryget(kipcm->instances, user_ipc_id);
+                if (!user_entry)
                         goto fail;
+                user_ipcp = ipcp_imap_entry_value(user_entry);
         }
 
         src_cep = ipcp->ops->connection_create_arrived(ipcp->data,
@@ -765,6 +800,9 @@ static int notify_ipcp_conn_create_arrived(irati_msg_port_t ctrl_port,
         msg->dtp_cfg = NULL;
         msg->dtcp_cfg = NULL;
 
+        ipcp_imap_put(user_entry);
+        user_entry = NULL;
+
         if (!is_cep_id_ok(src_cep)) {
                 LOG_ERR("IPC process could not create connection");
                 goto fail;
@@ -774,6 +812,7 @@ static int notify_ipcp_conn_create_arrived(irati_msg_port_t ctrl_port,
         			        msg->dst_cep, msg->event_id);
 
  fail:
+        ipcp_imap_put(user_entry);
  	return conn_create_result_reply(ctrl_port, ipc_id, port_id,
  					cep_id_bad(), cep_id_bad(),
 					msg->event_id);
@@ -983,6 +1022,18 @@ static int notify_ipcp_modify_pffe(irati_msg_port_t ctrl_port,
         }
 
         switch(msg->mode) {
+        case 3:
+        	if (!ipc_process->ops->pff_update) {
+        		LOG_ERR("IPC process %d can't update its PFF", ipc_id);
+        		return -1;
+        	}
+
+        	result = ipc_process->ops->pff_update(ipc_process->data,
+        					      &msg->pft_entries->pff_entries);
+        	if (result)
+                        LOG_ERR("Problems updating PFF");
+
+        	return result;
         case 2:
         	result = ipc_process->ops->pff_modify(ipc_process->data,
         					      &msg->pft_entries->pff_entries);
@@ -1643,6 +1694,49 @@ static int notify_destroy_ipcp(irati_msg_port_t ctrl_port,
 	return 0;
 }
 
+/* The IPCP a message is about */
+static ipc_process_id_t msg_target_ipcp(const struct irati_msg_base * bmsg)
+{
+        switch (bmsg->msg_type) {
+        case RINA_C_IPCP_ALLOCATE_PORT_REQUEST:
+        case RINA_C_IPCP_DEALLOCATE_PORT_REQUEST:
+        case RINA_C_IPCP_MANAGEMENT_SDU_WRITE_REQUEST:
+                /* Sent by the IPCP daemons */
+                return bmsg->src_ipcp_id;
+        default:
+                return bmsg->dest_ipcp_id;
+        }
+}
+
+/*
+ * Runs the handler of a message with its target IPCP pinned, so that it
+ * cannot be destroyed meanwhile. Handlers for different IPCPs (and for
+ * different flows of the same IPCP) run concurrently.
+ */
+static int kipcm_ipcp_msg_handler(irati_msg_port_t ctrl_port,
+				  struct irati_msg_base *bmsg,
+				  void * data)
+{
+        struct kipcm *           kipcm;
+        struct ipcp_imap_entry * entry;
+        int                      retval;
+
+        if (!data || !bmsg) {
+                LOG_ERR("Bogus parameters passed, cannot handle msg");
+                return -1;
+        }
+        kipcm = (struct kipcm *) data;
+
+        /* If it does not exist the handler will complain and reply */
+        entry = ipcp_imap_get(kipcm->instances, msg_target_ipcp(bmsg));
+
+        retval = kipcm_handlers[bmsg->msg_type](ctrl_port, bmsg, data);
+
+        ipcp_imap_put(entry);
+
+        return retval;
+}
+
 static int ctrldev_handlers_unregister(void)
 {
         int retval = 0;
@@ -1705,6 +1799,7 @@ static int ctrldev_handlers_unregister(void)
 static int ctrldev_handlers_register(struct kipcm * kipcm)
 {
         int i,j;
+        irati_msg_handler_t handler;
 
         kipcm_handlers[RINA_C_IPCM_ASSIGN_TO_DIF_REQUEST]          =
                 notify_ipcp_assign_dif_request;
@@ -1757,9 +1852,13 @@ static int ctrldev_handlers_register(struct kipcm * kipcm)
 
         for (i = 1; i < RINA_C_MAX; i++) {
                 if (kipcm_handlers[i] != NULL) {
-                        if (irati_handler_register(i,
-                        			   kipcm_handlers[i],
-                                                   kipcm)) {
+                        handler = kipcm_ipcp_msg_handler;
+                        /* They change the instances map */
+                        if (i == RINA_C_IPCM_CREATE_IPCP_REQUEST ||
+                            i == RINA_C_IPCM_DESTROY_IPCP_REQUEST)
+                                handler = kipcm_handlers[i];
+
+                        if (irati_handler_register(i, handler, kipcm)) {
                                 for (j = i - 1; j > 0; j--) {
                                         if (kipcm_handlers[j] != NULL) {
                                                 if (irati_handler_unregister(j)) {
@@ -1816,6 +1915,7 @@ int kipcm_init(struct robject * parent)
                 return -1;
         }
 
+        spin_lock_init(&tmp->messages->lock);
         tmp->messages->ingress = kipcm_pmap_create();
         tmp->messages->egress  = kipcm_smap_create();
         if (!tmp->messages->ingress || !tmp->messages->egress) {
@@ -1972,12 +2072,35 @@ kipcm_ipcp_factory_register(struct kipcm *             kipcm,
 }
 EXPORT_SYMBOL(kipcm_ipcp_factory_register);
 
+/*
+ * Puts back an instance its factory could not destroy, so that it can still
+ * be used (and destroyed again). Must be called with the kipcm lock held
+ */
+static int ipcp_instance_relink(struct kipcm *         kipcm,
+                                ipc_process_id_t       id,
+                                struct ipcp_instance * instance)
+{
+        if (ipcp_imap_find(kipcm->instances, id)) {
+                LOG_ERR("IPC process %d was created again, "
+                        "cannot put the old instance back", id);
+                return -1;
+        }
+
+        if (ipcp_imap_add(kipcm->instances, id, instance)) {
+                LOG_ERR("Cannot put IPC process %d instance back", id);
+                return -1;
+        }
+
+        return 0;
+}
+
 int kipcm_ipcp_factory_unregister(struct kipcm *        kipcm,
                                   struct ipcp_factory * factory)
 {
-        ipc_process_id_t       id;
-        struct ipcp_instance * instance;
-        int                    retval;
+        ipc_process_id_t         id;
+        struct ipcp_instance *   instance;
+        struct ipcp_imap_entry * entry;
+        int                      retval;
 
         IRQ_BARRIER;
 
@@ -2004,22 +2127,26 @@ int kipcm_ipcp_factory_unregister(struct kipcm *        kipcm,
 
         id = ipcp_imap_find_factory(kipcm->instances, factory);
         while (id != 0) {
-                instance = ipcp_imap_find(kipcm->instances, id);
-                if (!instance) {
+                entry = ipcp_imap_unlink(kipcm->instances, id);
+                if (!entry) {
                         LOG_ERR("IPC process %d instance does not exist", id);
                         KIPCM_UNLOCK(kipcm);
                         return -1;
                 }
+                instance = ipcp_imap_entry_value(entry);
+
+                /* The handlers may need the lock to complete */
+                KIPCM_UNLOCK(kipcm);
+                ipcp_imap_entry_kill(entry);
+                KIPCM_LOCK(kipcm);
 
                 if (factory->ops->destroy(factory->data, instance)) {
+                        LOG_ERR("Could not destroy IPC process %d", id);
+                        ipcp_instance_relink(kipcm, id, instance);
                         KIPCM_UNLOCK(kipcm);
                         return -1;
                 }
 
-                if (ipcp_imap_remove(kipcm->instances, id)) {
-                        KIPCM_UNLOCK(kipcm);
-                        return -1;
-                }
                 id = ipcp_imap_find_factory(kipcm->instances, factory);
         }
         retval = ipcpf_unregister(kipcm->factories, factory);
@@ -2107,8 +2234,9 @@ int kipcm_ipc_create(struct kipcm *      kipcm,
 int kipcm_ipc_destroy(struct kipcm *   kipcm,
                       ipc_process_id_t id)
 {
-        struct ipcp_instance * instance;
-        struct ipcp_factory *  factory;
+        struct ipcp_instance *   instance;
+        struct ipcp_factory *    factory;
+        struct ipcp_imap_entry * entry;
 
         IRQ_BARRIER;
 
@@ -2119,22 +2247,25 @@ int kipcm_ipc_destroy(struct kipcm *   kipcm,
 
         KIPCM_LOCK(kipcm);
 
-        instance = ipcp_imap_find(kipcm->instances, id);
-        if (!instance) {
+        entry = ipcp_imap_unlink(kipcm->instances, id);
+        if (!entry) {
                 LOG_ERR("IPC process %d instance does not exist", id);
                 KIPCM_UNLOCK(kipcm);
                 return -1;
         }
+        instance = ipcp_imap_entry_value(entry);
+
+        /* No new handler can find it, wait for the ones in progress */
+        KIPCM_UNLOCK(kipcm);
+        ipcp_imap_entry_kill(entry);
+        KIPCM_LOCK(kipcm);
 
         factory = instance->factory;
         ASSERT(factory);
 
         if (factory->ops->destroy(factory->data, instance)) {
-                KIPCM_UNLOCK(kipcm);
-                return -1;
-        }
-
-        if (ipcp_imap_remove(kipcm->instances, id)) {
+                LOG_ERR("Could not destroy IPC process %d", id);
+                ipcp_instance_relink(kipcm, id, instance);
                 KIPCM_UNLOCK(kipcm);
                 return -1;
         }
@@ -2153,22 +2284,28 @@ int kipcm_flow_arrived(struct kipcm *         kipcm,
                        struct flow_spec *     fspec)
 {
         uint32_t           seq_num;
-        struct ipcp_instance * ipc_process;
+        struct ipcp_imap_entry * entry;
         struct irati_kmsg_ipcm_allocate_flow msg;
+        int                retval;
 
         IRQ_BARRIER;
 
-        ipc_process  = ipcp_imap_find(kipcm->instances, ipc_id);
-        if (!ipc_process) {
+        /* Pinned until the request is on its way to the IPC Manager */
+        entry = ipcp_imap_tryget(kipcm->instances, ipc_id);
+        if (!entry) {
                 LOG_ERR("IPC process %d not found", ipc_id);
                 return -1;
         }
 
         seq_num = ctrl_dev_get_next_seqn();
+        spin_lock_bh(&kipcm->messages->lock);
         if (kipcm_smap_add_ni(kipcm->messages->egress, seq_num, port_id)) {
+                spin_unlock_bh(&kipcm->messages->lock);
+                ipcp_imap_put(entry);
                 LOG_DBG("Could not get next sequence number");
                 return -1;
         }
+        spin_unlock_bh(&kipcm->messages->lock);
 
 	msg.msg_type = RINA_C_IPCM_ALLOCATE_FLOW_REQUEST_ARRIVED;
 	msg.src_ipcp_id = ipc_id;
@@ -2180,8 +2317,10 @@ int kipcm_flow_arrived(struct kipcm *         kipcm,
 	msg.remote = remote;
 	msg.dif_name = dif_name;
 
-	if (irati_ctrl_dev_snd_resp_msg(IPCM_CTRLDEV_PORT,
-					(struct irati_msg_base *) &msg)) {
+	retval = irati_ctrl_dev_snd_resp_msg(IPCM_CTRLDEV_PORT,
+					     (struct irati_msg_base *) &msg);
+	ipcp_imap_put(entry);
+	if (retval) {
 		LOG_ERR("Could not send allocate flow req arrived msg");
 		return -1;
 	}
@@ -2190,25 +2329,31 @@ int kipcm_flow_arrived(struct kipcm *         kipcm,
 }
 EXPORT_SYMBOL(kipcm_flow_arrived);
 
-struct ipcp_instance * kipcm_find_ipcp(struct kipcm *   kipcm,
-                                       ipc_process_id_t ipc_id)
+struct ipcp_instance * kipcm_find_ipcp(struct kipcm *            kipcm,
+                                       ipc_process_id_t          ipc_id,
+                                       struct ipcp_imap_entry ** ref)
 {
-        struct ipcp_instance * ipcp;
+        struct ipcp_imap_entry * entry;
 
-        KIPCM_LOCK(kipcm);
+        ASSERT(ref);
 
-        ipcp = ipcp_imap_find(kipcm->instances, ipc_id);
-        if (!ipcp) {
+        *ref  = NULL;
+        entry = ipcp_imap_tryget(kipcm->instances, ipc_id);
+        if (!entry) {
                 LOG_ERR("Couldn't find the ipc process %d", ipc_id);
-                KIPCM_UNLOCK(kipcm);
                 return NULL;
         }
-        KIPCM_UNLOCK(kipcm);
 
-        return ipcp;
+        *ref = entry;
+
+        return ipcp_imap_entry_value(entry);
 }
 EXPORT_SYMBOL(kipcm_find_ipcp);
 
+void kipcm_put_ipcp(struct ipcp_imap_entry * ref)
+{ ipcp_imap_put(ref); }
+EXPORT_SYMBOL(kipcm_put_ipcp);
+
 /* ONLY USED BY APPS */
 int kipcm_du_write(struct kipcm * kipcm,
                    port_id_t      port_id,
@@ -2259,18 +2404,16 @@ int kipcm_mgmt_du_write(struct kipcm *   kipcm,
                 return -1;
         }
 
-        KIPCM_LOCK(kipcm);
+        /* The instance is pinned by kipcm_ipcp_msg_handler */
         ipcp = ipcp_imap_find(kipcm->instances, id);
         if (!ipcp) {
                 LOG_ERR("Could not find IPC Process with id %d", id);
-                KIPCM_UNLOCK(kipcm);
                 du_destroy(du);
                 return -1;
         }
 
         if (!ipcp->ops) {
                 LOG_ERR("Bogus IPCP ops, bailing out");
-                KIPCM_UNLOCK(kipcm);
                 du_destroy(du);
                 return -1;
         }
@@ -2278,11 +2421,9 @@ int kipcm_mgmt_du_write(struct kipcm *   kipcm,
         if (!ipcp->ops->mgmt_du_write) {
                 LOG_ERR("The IPC Process %d doesn't support this operation",
                         id);
-                KIPCM_UNLOCK(kipcm);
                 du_destroy(du);
                 return -1;
         }
-        KIPCM_UNLOCK(kipcm);
 
         if (ipcp->ops->mgmt_du_write(ipcp->data,
                                      port_id,
@@ -2310,24 +2451,23 @@ port_id_t kipcm_flow_create(struct kipcm     *kipcm,
                 return port_id_bad();
         }
 
-        KIPCM_LOCK(kipcm);
-
+        /* The instance is pinned by kipcm_ipcp_msg_handler */
         ipc_process = ipcp_imap_find(kipcm->instances, ipc_id);
 
         if (!ipc_process) {
                 LOG_ERR("Couldn't find the ipc process %d", ipc_id);
-                KIPCM_UNLOCK(kipcm);
                 return port_id_bad();
         }
 
         pid = kfa_port_id_reserve(kipcm->kfa, ipc_id);
-        if (!is_port_id_ok(pid)) {
-                KIPCM_UNLOCK(kipcm);
+        if (!is_port_id_ok(pid))
                 return port_id_bad();
-        }
 
         ASSERT(ipc_process->ops);
 
+        /* The user IPCP cannot go away while we hold the lock */
+        KIPCM_LOCK(kipcm);
+
         user_ipc_process = ipcp_imap_find_by_name(kipcm->instances,
                                                   process_name);
 
@@ -2337,19 +2477,18 @@ port_id_t kipcm_flow_create(struct kipcm     *kipcm,
 					       pid);
         }
 
+        KIPCM_UNLOCK(kipcm);
+
         if (user_ipc_process) {
-                KIPCM_UNLOCK(kipcm);
                 LOG_DBG("This flow is for an ipcp");
                 return pid;
         }
 	/* creates a flow, default flow_opts */
         if (kfa_flow_create(kipcm->kfa, pid, ipc_process, ipc_id,
         		    process_name, msg_boundaries)) {
-                KIPCM_UNLOCK(kipcm);
                 kfa_port_id_release(kipcm->kfa, pid);
                 return port_id_bad();
         }
-        KIPCM_UNLOCK(kipcm);
         return pid;
 }
 EXPORT_SYMBOL(kipcm_flow_create);
@@ -2399,12 +2538,14 @@ int kipcm_notify_flow_alloc_req_result(struct kipcm    *kipcm,
                 return -1;
         }
 
+        spin_lock_bh(&kipcm->messages->lock);
         seq_num = kipcm_pmap_find(kipcm->messages->ingress, pid);
-
         if (kipcm_pmap_remove(kipcm->messages->ingress, pid)) {
+                spin_unlock_bh(&kipcm->messages->lock);
                 LOG_ERR("Could not destroy ingress messages map entry");
                 return -1;
         }
+        spin_unlock_bh(&kipcm->messages->lock);
 
         if (res)
                 kfa_port_id_release(kipcm->kfa, pid);
@@ -100,8 +100,18 @@ int            kipcm_flow_destroy(struct kipcm *   kipcm,
  *       ASAP
  */
 struct kfa *           kipcm_kfa(struct kipcm * kipcm);
-struct ipcp_instance * kipcm_find_ipcp(struct kipcm *   kipcm,
-                                       ipc_process_id_t ipc_id);
+
+struct ipcp_imap_entry;
+
+/*
+ * Returns the IPCP pinned: it cannot be destroyed until kipcm_put_ipcp() is
+ * called on the reference returned in ref. It does not sleep, and returns
+ * NULL if the IPCP is being destroyed
+ */
+struct ipcp_instance * kipcm_find_ipcp(struct kipcm *            kipcm,
+                                       ipc_process_id_t          ipc_id,
+                                       struct ipcp_imap_entry ** ref);
+void                   kipcm_put_ipcp(struct ipcp_imap_entry * ref);
 
 struct ipcp_factory *
 kipcm_ipcp_factory_register(struct kipcm *             kipcm,
@@ -458,6 +458,7 @@ ssize_t pci_calculate_size(struct efcp_config *cfg, pdu_type_t type)
 	switch (type) {
 		case PDU_TYPE_DT:
 		case PDU_TYPE_MGMT:
+		case PDU_TYPE_KEEPALIVE:
 			return cfg->pci_offset_table[PCI_DT_MGMT_SIZE];
 		case PDU_TYPE_FC:
 			return cfg->pci_offset_table[PCI_FC_SIZE];
@@ -481,6 +482,7 @@ seq_num_t pci_sequence_number_get(const struct pci *pci)
 	switch (pci_type(pci)) {
 	case PDU_TYPE_DT:
 	case PDU_TYPE_MGMT:
+	case PDU_TYPE_KEEPALIVE:
 		PCI_GETTER(pci, PCI_DT_MGMT_SN, seq_num_length, seq_num_t);
 	/* FIXME: we need to make sure the type exists, maybe redefine
 	 * pdu_type_t as union
@@ -55,8 +55,10 @@ typedef uint8_t pdu_flags_t;
 #define PDU_TYPE_RENDEZVOUS    0xCF /* Rendezvous */
 /* Management PDUs */
 #define PDU_TYPE_MGMT          0x40 /* Management */
+/* N-1 port liveness PDUs, never relayed beyond the neighbor */
+#define PDU_TYPE_KEEPALIVE     0x41 /* Keepalive */
 /* Number of different PDU types */
-#define PDU_TYPES              12
+#define PDU_TYPES              13
 
 typedef uint8_t pdu_type_t;
 
@@ -72,7 +74,8 @@ typedef uint8_t pdu_type_t;
 		((X == PDU_TYPE_SNACK_AND_FC) ? true :   \
 		 ((X == PDU_TYPE_RENDEZVOUS)   ? true :  \
 		  ((X == PDU_TYPE_MGMT)         ? true : \
-		   false)))))))))))
+		   ((X == PDU_TYPE_KEEPALIVE)   ? true : \
+		    false))))))))))))
 
 #define pdu_type_is_control(X)                           \
 	((X == PDU_TYPE_CACK)       ? true :             \
@@ -86,6 +89,12 @@ typedef uint8_t pdu_type_t;
 	        ((X == PDU_TYPE_SNACK_AND_FC) ? true :   \
 		 false)))))))))
 
+/* Layer management traffic, kept out of the data queues of RMT policies */
+#define pdu_type_is_mgmt(X)                              \
+	((X == PDU_TYPE_MGMT)       ? true :             \
+	 ((X == PDU_TYPE_KEEPALIVE)  ? true :            \
+	  false))
+
 struct pci {
 	unsigned char *h; /* do not move from 1st position */
 	size_t len;
@@ -327,46 +327,77 @@ static struct pft_entry * pft_find(struct pff_ps_priv * priv,
                                    qos_id_t             qos_id)
 {
         struct pft_entry * pos;
+        struct pft_entry * any = NULL;
 
         ASSERT(priv_is_ok(priv));
         ASSERT(is_address_ok(destination));
 
+        /*
+         * Entries for qos-id 0 apply to all the QoS cubes, unless the
+         * cube has an entry of its own (i.e. its own routing table)
+         */
         list_for_each_entry(pos, &priv->entries, next) {
-                if ((pos->destination == destination) &&
-                    ((pos->qos_id == 0) || (pos->qos_id == qos_id))) {
+                if (pos->destination != destination)
+                        continue;
+
+                if (pos->qos_id == qos_id)
+                        return pos;
+
+                if (pos->qos_id == 0 && !any)
+                        any = pos;
+        }
+
+        return any;
+}
+
+static struct pft_entry * pft_find_exact(struct pff_ps_priv * priv,
+                                         address_t            destination,
+                                         qos_id_t             qos_id)
+{
+        struct pft_entry * pos;
+
+        ASSERT(priv_is_ok(priv));
+
+        list_for_each_entry(pos, &priv->entries, next) {
+                if (pos->destination == destination && pos->qos_id == qos_id)
                         return pos;
-                }
         }
 
         return NULL;
 }
 
-static int __pff_add(struct pff_ps *        ps,
-		     struct pff_ps_priv * priv,
-		     struct mod_pff_entry * entry)
+static struct pft_entry * pfte_insert(struct pff_ps *      ps,
+                                      struct pff_ps_priv * priv,
+                                      address_t            destination,
+                                      qos_id_t             qos_id)
 {
-        struct pft_entry *       tmp;
-	struct port_id_altlist * alts;
+        struct pft_entry *           tmp;
         struct pff_sysfs_work_data * wdata;
         struct rwq_work_item       * item;
 
-	tmp = pft_find(priv, entry->fwd_info, entry->qos_id);
+	tmp = pfte_create_ni(destination, qos_id);
 	if (!tmp) {
-		tmp = pfte_create_ni(entry->fwd_info, entry->qos_id);
-		if (!tmp) {
-			return -1;
-		}
-		list_add(&tmp->next, &priv->entries);
+		return NULL;
+	}
+	list_add(&tmp->next, &priv->entries);
 
-		/* Defer sysfs entry creation to workqueue, since it may sleep */
-	        wdata = rkzalloc(sizeof(* wdata), GFP_ATOMIC);
-	        wdata->entry = tmp;
-	        wdata->rset = pff_rset(ps->dm);
-	        wdata->add = true;
-	        item  = rwq_work_create_ni(pff_sysfs_worker, wdata);
+	/* Defer sysfs entry creation to workqueue, since it may sleep */
+        wdata = rkzalloc(sizeof(* wdata), GFP_ATOMIC);
+        wdata->entry = tmp;
+        wdata->rset = pff_rset(ps->dm);
+        wdata->add = true;
+        item  = rwq_work_create_ni(pff_sysfs_worker, wdata);
 
-	        rwq_work_post(priv->sysfs_wq, item);
-	}
+        rwq_work_post(priv->sysfs_wq, item);
+
+	return tmp;
+}
+
+static int pfte_ports_add(struct pft_entry *     tmp,
+			  struct pff_ps_priv *   priv,
+			  struct mod_pff_entry * entry)
+{
+	struct port_id_altlist * alts;
 
 	list_for_each_entry(alts, &entry->port_id_altlists, next) {
 		if (alts->num_ports < 1) {
@@ -384,6 +415,23 @@ static int __pff_add(struct pff_ps *        ps,
 	return 0;
 }
 
+static int __pff_add(struct pff_ps *        ps,
+		     struct pff_ps_priv * priv,
+		     struct mod_pff_entry * entry)
+{
+        struct pft_entry *       tmp;
+
+	tmp = pft_find_exact(priv, entry->fwd_info, entry->qos_id);
+	if (!tmp) {
+		tmp = pfte_insert(ps, priv, entry->fwd_info, entry->qos_id);
+		if (!tmp) {
+			return -1;
+		}
+	}
+
+	return pfte_ports_add(tmp, priv, entry);
+}
+
 int default_add(struct pff_ps *        ps,
                 struct mod_pff_entry * entry)
 {
@@ -442,7 +490,7 @@ int default_remove(struct pff_ps *        ps,
 
         spin_lock_bh(&priv->lock);
 
-        tmp = pft_find(priv, entry->fwd_info, entry->qos_id);
+        tmp = pft_find_exact(priv, entry->fwd_info, entry->qos_id);
         if (!tmp) {
                 spin_unlock_bh(&priv->lock);
                 return -1;
@@ -544,6 +592,59 @@ int default_modify(struct pff_ps *    ps,
         return 0;
 }
 
+int default_update(struct pff_ps *    ps,
+                   struct list_head * entries)
+{
+        struct pff_ps_priv *    priv;
+        struct mod_pff_entry *  entry;
+        struct pft_entry *      tmp;
+        struct pft_port_entry * pos, * next;
+        int                     result = 0;
+
+        priv = (struct pff_ps_priv *) ps->priv;
+        if (!priv_is_ok(priv))
+                return -1;
+
+        /* The whole delta is applied while nhop lookups are kept out */
+        spin_lock_bh(&priv->lock);
+
+        list_for_each_entry(entry, entries, next) {
+        	if (!is_address_ok(entry->fwd_info))
+        		continue;
+
+        	if (!is_qos_id_ok(entry->qos_id))
+        		continue;
+
+        	tmp = pft_find_exact(priv, entry->fwd_info, entry->qos_id);
+        	if (list_empty(&entry->port_id_altlists)) {
+        		if (tmp)
+        			pfte_destroy(tmp, priv);
+        		continue;
+        	}
+
+        	/* Entries are modified in place, keeping their sysfs object */
+        	if (tmp) {
+        		list_for_each_entry_safe(pos, next, &tmp->ports, next) {
+        			pft_pe_destroy(pos);
+        		}
+        	} else {
+        		tmp = pfte_insert(ps, priv, entry->fwd_info,
+        				  entry->qos_id);
+        		if (!tmp) {
+        			result = -1;
+        			continue;
+        		}
+        	}
+
+        	if (pfte_ports_add(tmp, priv, entry))
+        		result = -1;
+        }
+
+        spin_unlock_bh(&priv->lock);
+
+        return result;
+}
+
 int default_nhop(struct pff_ps * ps,
                  struct pci *    pci,
                  port_id_t **    ports,
@@ -737,6 +838,7 @@ pff_ps_default_create(struct rina_component * component)
         ps->pff_nhop = default_nhop;
         ps->pff_dump = default_dump;
         ps->pff_modify = default_modify;
+        ps->pff_update = default_update;
 
         return &ps->base;
 }
@@ -40,6 +40,8 @@ int              default_dump(struct pff_ps *    ps,
                               struct list_head * entries);
 int              default_modify(struct pff_ps *    ps,
                                 struct list_head * entries);
+int              default_update(struct pff_ps *    ps,
+                                struct list_head * entries);
 struct ps_base * pff_ps_default_create(struct rina_component * component);
 void             pff_ps_default_destroy(struct ps_base * bps);
 
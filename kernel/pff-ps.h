@@ -56,6 +56,15 @@ struct pff_ps {
         int  (* pff_modify)(struct pff_ps *    ps,
                             struct list_head * entries);
 
+        /*
+         * Apply a delta in an atomic operation: each entry replaces the
+         * one with the same destination and qos-id (or is added), entries
+         * without port-ids remove it. Optional, emulated with pff_dump
+         * and pff_modify if missing.
+         */
+        int  (* pff_update)(struct pff_ps *    ps,
+                            struct list_head * entries);
+
         /* Reference used to access the PFF data model. */
         struct pff * dm;
 
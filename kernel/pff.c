@@ -29,6 +29,7 @@
 #include "debug.h"
 #include "pff.h"
 #include "pff-ps.h"
+#include "rmt.h"
 
 static struct policy_set_list policy_sets = {
         .head = LIST_HEAD_INIT(policy_sets.head)
@@ -38,6 +39,7 @@ struct pff {
         struct rina_component base;
         struct rset * rset;
         struct ipcp_instance * ipcp;
+        struct rmt * rmt;
 };
 
 /*
@@ -70,7 +72,8 @@ static bool __pff_is_ok(struct pff * instance)
 { return instance ? true : false; }
 
 static struct pff * pff_create_gfp(struct robject * parent,
-				   struct ipcp_instance * ipcp, gfp_t flags)
+				   struct ipcp_instance * ipcp,
+				   struct rmt * rmt, gfp_t flags)
 {
         struct pff * tmp;
 
@@ -89,6 +92,7 @@ static struct pff * pff_create_gfp(struct robject * parent,
 	}
 
 	tmp->ipcp = ipcp;
+	tmp->rmt = rmt;
 
         /* Try to select the default policy-set. */
         if (pff_select_policy_set(tmp, "", RINA_PS_DEFAULT_NAME)) {
@@ -106,8 +110,9 @@ struct pff * pff_create_ni(void)
 #endif
 
 struct pff * pff_create(struct robject * parent,
-			struct ipcp_instance * ipcp)
-{ return pff_create_gfp(parent, ipcp, GFP_KERNEL); }
+			struct ipcp_instance * ipcp,
+			struct rmt * rmt)
+{ return pff_create_gfp(parent, ipcp, rmt, GFP_KERNEL); }
 
 int pff_destroy(struct pff * instance)
 {
@@ -343,6 +348,97 @@ int pff_modify(struct pff *       instance,
         return 0;
 }
 
+/*
+ * Emulates pff_update on policy sets that can only replace the whole table:
+ * the delta is merged into a dump of the current entries, which are then
+ * installed with pff_modify.
+ */
+static int pff_update_by_modify(struct pff_ps *    ps,
+                                struct list_head * entries)
+{
+        struct mod_pff_entry * pos, * npos, * upd;
+        struct list_head       table, removed, * last;
+        int                    result;
+
+        if (!ps->pff_modify) {
+                LOG_ERR("PFF policy set can't be updated");
+                return -1;
+        }
+
+        INIT_LIST_HEAD(&table);
+        INIT_LIST_HEAD(&removed);
+
+        if (ps->pff_dump(ps, &table)) {
+                result = -1;
+                goto out;
+        }
+
+        list_for_each_entry(upd, entries, next) {
+                list_for_each_entry_safe(pos, npos, &table, next) {
+                        if (pos->fwd_info == upd->fwd_info &&
+                            pos->qos_id == upd->qos_id) {
+                                list_del(&pos->next);
+                                mod_pff_entry_free(pos);
+                        }
+                }
+        }
+
+        /* Lend the entries of the delta that carry port-ids to the table */
+        list_for_each_entry_safe(upd, npos, entries, next) {
+                if (list_empty(&upd->port_id_altlists))
+                        list_move_tail(&upd->next, &removed);
+        }
+        last = table.prev;
+        list_splice_tail_init(entries, &table);
+
+        result = ps->pff_modify(ps, &table);
+
+        /* ... and give them back */
+        if (last != &table) {
+                struct list_head dumped;
+
+                INIT_LIST_HEAD(&dumped);
+                list_cut_position(&dumped, &table, last);
+                list_splice_init(&table, entries);
+                list_splice_init(&dumped, &table);
+        } else {
+                list_splice_init(&table, entries);
+        }
+        list_splice_tail_init(&removed, entries);
+
+ out:
+        list_for_each_entry_safe(pos, npos, &table, next) {
+                list_del(&pos->next);
+                mod_pff_entry_free(pos);
+        }
+
+        return result;
+}
+
+int pff_update(struct pff *       instance,
+               struct list_head * entries)
+{
+        struct pff_ps * ps;
+        int             result;
+
+        if (!__pff_is_ok(instance))
+                return -1;
+
+        rcu_read_lock();
+
+        ps = container_of(rcu_dereference(instance->base.ps),
+                          struct pff_ps, base);
+
+        if (ps->pff_update)
+                result = ps->pff_update(ps, entries);
+        else
+                result = pff_update_by_modify(ps, entries);
+
+        rcu_read_unlock();
+
+        return result ? -1 : 0;
+}
+
 int pff_select_policy_set(struct pff *     pff,
                           const string_t * path,
                           const string_t * name)
@@ -438,6 +534,15 @@ struct ipcp_instance * pff_ipcp_get(struct pff * pff)
 }
 EXPORT_SYMBOL(pff_ipcp_get);
 
+int pff_port_queue_len(struct pff * pff, port_id_t port_id)
+{
+	if (!pff || !pff->rmt)
+		return -1;
+
+	return rmt_n1port_queue_len(pff->rmt, port_id);
+}
+EXPORT_SYMBOL(pff_port_queue_len);
+
 struct pff * pff_from_component(struct rina_component * component)
 { return container_of(component, struct pff, base); }
 EXPORT_SYMBOL(pff_from_component);
@@ -29,9 +29,11 @@
 
 struct pff;
 struct pci;
+struct rmt;
 
 struct pff *    pff_create(struct robject * parent,
-			   struct ipcp_instance * ipcp);
+			   struct ipcp_instance * ipcp,
+			   struct rmt * rmt);
 int             pff_destroy(struct pff * instance);
 
 bool            pff_is_ok(struct pff * instance);
@@ -60,6 +62,10 @@ int             pff_dump(struct pff *       instance,
 int             pff_modify(struct pff *       instance,
                            struct list_head * entries);
 
+/* NOTE: entries without port-ids remove the existing ones */
+int             pff_update(struct pff *       instance,
+                           struct list_head * entries);
+
 int             pff_select_policy_set(struct pff * pff,
                                       const char * path,
                                       const char * name);
@@ -74,4 +80,8 @@ struct rset *   pff_rset(struct pff * pff);
 struct pff *    pff_from_component(struct rina_component * component);
 struct ipcp_instance * pff_ipcp_get(struct pff * pff);
 
+/* PDUs queued in the RMT for the N-1 port, -1 if the port is unknown */
+int             pff_port_queue_len(struct pff * pff,
+				   port_id_t    port_id);
+
 #endif
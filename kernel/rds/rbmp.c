@@ -21,6 +21,7 @@
 #include <linux/export.h>
 #include <linux/types.h>
 #include <linux/bitmap.h>
+#include <linux/bitops.h>
 
 #define RINA_PREFIX "rbmp"
 
@@ -29,13 +30,14 @@
 #include "rmem.h"
 #include "rbmp.h"
 
-#define BITS_IN_BITMAP ((2 << BITS_PER_BYTE) * sizeof(size_t))
-
 struct rbmp {
-        ssize_t offset;
-        size_t  size;
+        ssize_t         offset;
+        size_t          size;
+
+        /* Next-fit hint: the search for a free id starts here */
+        size_t          next;
 
-        DECLARE_BITMAP(bitmap, BITS_IN_BITMAP);
+        unsigned long * bitmap;
 };
 
 static struct rbmp * rbmp_create_gfp(gfp_t flags, size_t bits, ssize_t offset)
@@ -49,9 +51,16 @@ static struct rbmp * rbmp_create_gfp(gfp_t flags, size_t bits, ssize_t offset)
         if (!tmp)
                 return NULL;
 
+        tmp->bitmap = rkzalloc(BITS_TO_LONGS(bits) * sizeof(unsigned long),
+                               flags);
+        if (!tmp->bitmap) {
+                rkfree(tmp);
+                return NULL;
+        }
+
         tmp->size   = bits;
         tmp->offset = offset;
-        bitmap_zero(tmp->bitmap, BITS_IN_BITMAP);
+        tmp->next   = 0;
 
         return tmp;
 }
@@ -69,6 +78,7 @@ int rbmp_destroy(struct rbmp * b)
         if (!b)
                 return -1;
 
+        rkfree(b->bitmap);
         rkfree(b);
 
         return 0;
@@ -84,18 +94,24 @@ static ssize_t bad_id(struct rbmp * b)
 
 ssize_t rbmp_allocate(struct rbmp * b)
 {
-        ssize_t id;
+        size_t id;
 
         if (!b)
-                return bad_id(b);
+                return -1;
 
-        id = (ssize_t) bitmap_find_next_zero_area(b->bitmap,
-                                                  BITS_IN_BITMAP,
-                                                  0, 1, 0);
-        if (id < 0)
-                return bad_id(b);
+        /*
+         * Next fit: ids are not reused right after being released, and
+         * the search skips the allocated ids a word at a time
+         */
+        id = find_next_zero_bit(b->bitmap, b->size, b->next);
+        if (id >= b->size) {
+                id = find_next_zero_bit(b->bitmap, b->next, 0);
+                if (id >= b->next)
+                        return bad_id(b);
+        }
 
-        bitmap_set(b->bitmap, id, 1);
+        __set_bit(id, b->bitmap);
+        b->next = (id + 1 < b->size) ? id + 1 : 0;
 
         return id + b->offset;
 }
@@ -105,7 +121,7 @@ static bool is_id_ok(struct rbmp * b, ssize_t id)
 {
         ASSERT(b);
 
-        if ((id < b->offset) || (id > (b->offset + b->size)))
+        if ((id < b->offset) || (id >= (b->offset + (ssize_t) b->size)))
                 return false;
 
         return true;
@@ -132,8 +148,8 @@ int rbmp_release(struct rbmp * b,
                 return -1;
 
         rid = id - b->offset;
-
-        bitmap_clear(b->bitmap, id, 1);
+        if (!__test_and_clear_bit(rid, b->bitmap))
+                return -1;
 
         return 0;
 }
@@ -23,11 +23,18 @@
 
 struct rbmp;
 
+/*
+ * Ids go from offset to offset + bits - 1. Allocation is next-fit and
+ * release is O(1); neither of them allocates memory, so they can be
+ * used in atomic context. Callers serialize the access.
+ */
 struct rbmp * rbmp_create(size_t bits, ssize_t offset);
 struct rbmp * rbmp_create_ni(size_t bits, ssize_t offset);
 int           rbmp_destroy(struct rbmp * b);
 
+/* Returns offset - 1 if there are no free ids */
 ssize_t       rbmp_allocate(struct rbmp * instance);
+/* Fails if the id is out of range or was not allocated */
 int           rbmp_release(struct rbmp * instance,
                            ssize_t       id);
 bool          rbmp_is_id_ok(struct rbmp * b, ssize_t id);
@@ -24,6 +24,10 @@
 #include <linux/ip.h>
 #include <linux/if.h>
 #include <linux/version.h>
+#include <linux/netdevice.h>
+#include <linux/interrupt.h>
+#include <linux/skbuff.h>
+#include <linux/err.h>
 
 #define RINA_PREFIX "rina-device"
 
@@ -36,15 +40,25 @@
 
 #define RINA_EXTRA_HEADER_LENGTH 50
 
+/* Max number of SDUs waiting to be polled by NAPI */
+#define RINA_DEV_RX_BACKLOG 1000
+
 struct rina_device {
 	struct net_device_stats stats;
 	struct ipcp_instance* kfa_ipcp;
 	port_id_t port;
 	struct net_device* dev;
+	struct napi_struct napi;
+	struct sk_buff_head rx_queue;
+	/* rina_dev_rcv may run on several CPUs at once */
+	atomic_long_t rx_dropped;
 };
 
 static int rina_dev_open(struct net_device *dev)
 {
+	struct rina_device* rina_dev = netdev_priv(dev);
+
+	napi_enable(&rina_dev->napi);
 	netif_tx_start_all_queues(dev);
 	LOG_DBG("RINA IP device %s opened...", dev->name);
 
@@ -53,7 +67,11 @@ static int rina_dev_open(struct net_device *dev)
 
 static int rina_dev_close(struct net_device *dev)
 {
+	struct rina_device* rina_dev = netdev_priv(dev);
+
 	netif_tx_stop_all_queues(dev);
+	napi_disable(&rina_dev->napi);
+	skb_queue_purge(&rina_dev->rx_queue);
 	LOG_DBG("RINA IP device %s closed...", dev->name);
 
 	return 0;
@@ -64,32 +82,72 @@ static struct net_device_stats *rina_dev_get_stats(struct net_device *dev)
 	struct rina_device* rina_dev = netdev_priv(dev);
 	if(!rina_dev)
 		return NULL;
-	
+
+	rina_dev->stats.rx_dropped = atomic_long_read(&rina_dev->rx_dropped);
+
 	return &rina_dev->stats;
 }
 
-int rina_dev_rcv(struct sk_buff *skb, struct rina_device *rina_dev)
+/* Delivers the SDUs queued by rina_dev_rcv to the stack, GRO-ing them */
+static int rina_dev_poll(struct napi_struct *napi, int budget)
 {
-	ssize_t len;
+	struct rina_device* rina_dev;
+	struct sk_buff* skb;
+	int done = 0;
+
+	rina_dev = container_of(napi, struct rina_device, napi);
+
+	while (done < budget) {
+		skb = skb_dequeue(&rina_dev->rx_queue);
+		if (!skb)
+			break;
 
+		rina_dev->stats.rx_packets++;
+		rina_dev->stats.rx_bytes += skb->len;
+		napi_gro_receive(napi, skb);
+		done++;
+	}
+
+	if (done < budget) {
+		napi_complete_done(napi, done);
+		/* Catch the SDUs queued while completing */
+		if (!skb_queue_empty(&rina_dev->rx_queue))
+			napi_schedule(napi);
+	}
+
+	return done;
+}
+
+int rina_dev_rcv(struct sk_buff *skb, struct rina_device *rina_dev)
+{
 	if(!(skb->data[0] & 0xf0)) {
 		LOG_INFO("RINA IP device %s rcv a non IP packet, dropping...",
 			  rina_dev->dev->name);
-		rina_dev->stats.rx_dropped++;
+		atomic_long_inc(&rina_dev->rx_dropped);
 		kfree_skb(skb);
 		return -1;
 	}
 
+	if (skb_queue_len(&rina_dev->rx_queue) >= RINA_DEV_RX_BACKLOG) {
+		atomic_long_inc(&rina_dev->rx_dropped);
+		kfree_skb(skb);
+		return 0;
+	}
+
 	skb->protocol = htons(ETH_P_IP);
 	skb->dev = rina_dev->dev;
-	len = skb->len;
-
-	if(likely(netif_rx(skb) == NET_RX_SUCCESS)) {
-		rina_dev->stats.rx_packets++;
-		rina_dev->stats.rx_bytes += len;
-	} else {
-		rina_dev->stats.rx_dropped++;
-	}
+	skb_reset_network_header(skb);
+	skb_reset_mac_header(skb);
+
+	/*
+	 * May be called in process context: with BHs disabled the NAPI
+	 * softirq raised here runs when they are enabled again, instead of
+	 * waiting for the next interrupt
+	 */
+	local_bh_disable();
+	skb_queue_tail(&rina_dev->rx_queue, skb);
+	napi_schedule(&rina_dev->napi);
+	local_bh_enable();
 
 	LOG_DBG("RINA IP device %s rcv a IP packet...",
 		rina_dev->dev->name);
@@ -97,28 +155,60 @@ int rina_dev_rcv(struct sk_buff *skb, struct rina_device *rina_dev)
 	return 0;
 }
 
-static int rina_dev_start_xmit(struct sk_buff * skb, struct net_device *dev)
+/* The EFCP window closed, let the qdisc hold the packets */
+void rina_dev_tx_stop(struct rina_device *rina_dev)
 {
-	struct iphdr* iph = NULL;
-	struct rina_device* rina_dev = netdev_priv(dev);
-	ssize_t data_sent;
-	ASSERT(rina_dev);
+	if (!rina_dev)
+		return;
 
-	skb_orphan(skb);
-	//skb_dst_force(skb);
+	netif_stop_queue(rina_dev->dev);
+	LOG_DBG("RINA IP device %s stopped its queue",
+		rina_dev->dev->name);
+}
 
-	iph = ip_hdr(skb);
-	ASSERT(iph);
+/* The EFCP window opened again */
+void rina_dev_tx_wake(struct rina_device *rina_dev)
+{
+	if (!rina_dev || !netif_running(rina_dev->dev))
+		return;
+
+	netif_wake_queue(rina_dev->dev);
+	LOG_DBG("RINA IP device %s woke its queue",
+		rina_dev->dev->name);
+}
+
+/* Writes one SDU into the flow, the skb is consumed in any case */
+static void rina_dev_xmit_one(struct rina_device *rina_dev,
+			      struct sk_buff *skb)
+{
+	struct net_device *dev = rina_dev->dev;
+	ssize_t data_sent;
+
+	/*
+	 * DUs only handle linear buffers. Only the scatter-gather skbs are
+	 * copied, once for the whole GSO packet
+	 */
+	if (skb_is_nonlinear(skb) && skb_linearize(skb)) {
+		rina_dev->stats.tx_dropped++;
+		kfree_skb(skb);
+		return;
+	}
 
 	LOG_DBG("Device %s about to send a packet of length %u via port %d",
 		dev->name, skb->len, rina_dev->port);
 
+	/*
+	 * NOTE: The queue is stopped while the flow is not writable, so
+	 *       -EAGAIN is only seen if the EFCP window closes in between
+	 */
 	data_sent = kfa_flow_skb_write(rina_dev->kfa_ipcp->data,
 				       rina_dev->port, skb, skb->len, false);
 	if (data_sent < 0) {
 		rina_dev->stats.tx_dropped++;
-		LOG_ERR("Could not xmit IP packet, unable to send to KFA...");
-		return NET_XMIT_DROP;
+		if (data_sent != -EAGAIN)
+			LOG_ERR("Could not xmit IP packet, "
+				"unable to send to KFA...");
+		return;
 	}
 
 	rina_dev->stats.tx_packets++;
@@ -126,12 +216,90 @@ static int rina_dev_start_xmit(struct sk_buff * skb, struct net_device *dev)
 
 	LOG_DBG("RINA IP device %s sent a packet of %zd bytes via port %d",
 		dev->name, data_sent, rina_dev->port);
+}
+
+/*
+ * A GSO skb that fits in a SDU of the flow is sent as a single SDU (which
+ * delimiting will fragment to the N-1 MTU), otherwise it is segmented here
+ */
+static void rina_dev_xmit_gso(struct rina_device *rina_dev,
+			      struct sk_buff *skb)
+{
+	struct net_device *dev = rina_dev->dev;
+	struct sk_buff *segs, *next;
+	size_t max_sdu_size;
+
+	max_sdu_size = kfa_flow_skb_max_sdu_size(rina_dev->kfa_ipcp->data,
+						 rina_dev->port);
+	if (skb->len <= max_sdu_size) {
+		skb_gso_reset(skb);
+		/* The lower layers cannot fill in the checksum anymore */
+		if (skb->ip_summed == CHECKSUM_PARTIAL &&
+		    skb_checksum_help(skb)) {
+			rina_dev->stats.tx_dropped++;
+			kfree_skb(skb);
+			return;
+		}
+		rina_dev_xmit_one(rina_dev, skb);
+		return;
+	}
+
+	segs = skb_gso_segment(skb, dev->features & ~NETIF_F_GSO_MASK);
+	if (IS_ERR_OR_NULL(segs)) {
+		LOG_ERR("Could not segment a GSO packet of %u bytes",
+			skb->len);
+		rina_dev->stats.tx_dropped++;
+		kfree_skb(skb);
+		return;
+	}
+	consume_skb(skb);
+
+	while (segs) {
+		next = segs->next;
+		segs->next = NULL;
+		rina_dev_xmit_one(rina_dev, segs);
+		segs = next;
+	}
+}
+
+static int rina_dev_start_xmit(struct sk_buff * skb, struct net_device *dev)
+{
+	struct iphdr* iph = NULL;
+	struct rina_device* rina_dev = netdev_priv(dev);
+	ASSERT(rina_dev);
+
+	/* Keep the packet in the qdisc until the KFA wakes the queue */
+	if (!kfa_flow_skb_writable(rina_dev->kfa_ipcp->data, rina_dev->port)) {
+		netif_stop_queue(dev);
+		/* The flow may have become writable before the queue stopped */
+		if (!kfa_flow_skb_writable(rina_dev->kfa_ipcp->data,
+					   rina_dev->port))
+			return NETDEV_TX_BUSY;
+		netif_start_queue(dev);
+	}
+
+	skb_orphan(skb);
+	//skb_dst_force(skb);
+
+	iph = ip_hdr(skb);
+	ASSERT(iph);
+
+	if (skb_is_gso(skb))
+		rina_dev_xmit_gso(rina_dev, skb);
+	else
+		rina_dev_xmit_one(rina_dev, skb);
 
 	return NETDEV_TX_OK;
 }
 
 static void rina_dev_free(struct net_device *dev)
-{ return free_netdev(dev); }
+{
+	struct rina_device* rina_dev = netdev_priv(dev);
+
+	netif_napi_del(&rina_dev->napi);
+	skb_queue_purge(&rina_dev->rx_queue);
+	free_netdev(dev);
+}
 
 static const struct net_device_ops rina_dev_ops = {
 	.ndo_start_xmit	= rina_dev_start_xmit,
@@ -152,18 +320,18 @@ static void rina_dev_setup(struct net_device *dev)
 	dev->addr_len = 0;
 	dev->type = ARPHRD_NONE;
 	dev->flags = IFF_POINTOPOINT | IFF_NOARP | IFF_MULTICAST;
-#if LINUX_VERSION_CODE < KERNEL_VERSION(4,3,0)
+	/* Packets are queued in the qdisc while the EFCP window is closed */
+	dev->tx_queue_len = DEFAULT_TX_QUEUE_LEN;
 	dev->priv_flags |= IFF_LIVE_ADDR_CHANGE
-#else
-	dev->priv_flags	|= IFF_LIVE_ADDR_CHANGE | IFF_NO_QUEUE
-#endif
 #if LINUX_VERSION_CODE < KERNEL_VERSION(4,6,0)
 		| IFF_DONT_BRIDGE;
 #else
 		| IFF_DONT_BRIDGE | IFF_PHONY_HEADROOM;
 #endif
 	netif_keep_dst(dev);
-	dev->features = NETIF_F_HW_CSUM;
+	/* Large packets are segmented by rina_dev_start_xmit, if needed */
+	dev->features = NETIF_F_HW_CSUM | NETIF_F_SG | NETIF_F_GSO_SOFTWARE;
+	dev->hw_features = dev->features;
 #if LINUX_VERSION_CODE < KERNEL_VERSION(4,11,9)
 	dev->destructor	= rina_dev_free;
 #else
@@ -203,10 +371,18 @@ struct rina_device* rina_dev_create(string_t* name,
 	rina_dev->kfa_ipcp = kfa_ipcp;
 	rina_dev->port = port;
 	memset(&rina_dev->stats, 0x00, sizeof(struct net_device_stats));
+	atomic_long_set(&rina_dev->rx_dropped, 0);
+	skb_queue_head_init(&rina_dev->rx_queue);
+#if LINUX_VERSION_CODE < KERNEL_VERSION(6,1,0)
+	netif_napi_add(dev, &rina_dev->napi, rina_dev_poll, NAPI_POLL_WEIGHT);
+#else
+	netif_napi_add(dev, &rina_dev->napi, rina_dev_poll);
+#endif
 
 	rv = register_netdev(dev);
 	if(rv) {
 		LOG_ERR("Could not register RINA IP device %s: %d", name, rv);
+		netif_napi_del(&rina_dev->napi);
 		free_netdev(dev);
 		return NULL;
 	}
@@ -38,5 +38,7 @@ struct rina_device* rina_dev_create(string_t *name,
 int		    rina_dev_destroy(struct rina_device *rina_dev);
 int		    rina_dev_rcv(struct sk_buff *skb,
 			  	 struct rina_device *rina_dev);
+void		    rina_dev_tx_stop(struct rina_device *rina_dev);
+void		    rina_dev_tx_wake(struct rina_device *rina_dev);
 
 #endif
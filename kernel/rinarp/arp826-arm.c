@@ -20,6 +20,8 @@
 
 #include <linux/list.h>
 #include <linux/netdevice.h>
+#include <linux/hashtable.h>
+#include <linux/jhash.h>
 
 /* FIXME: The following dependencies have to be removed */
 #define RINA_PREFIX "arp826-arm"
@@ -41,11 +43,15 @@ struct resolution {
         arp826_notify_t       notify;
         void *                opaque;
 
-        struct list_head      next;
+        struct hlist_node     hlist; /* In the ongoing resolutions */
+        struct list_head      next;  /* In the resolver, once completed */
 };
 
+/* Ongoing resolutions, hashed by the GPA being resolved */
+#define RESOLUTIONS_HASH_BITS 8
+
 static DEFINE_SPINLOCK(resolutions_lock);
-static struct list_head resolutions_ongoing;
+static DEFINE_HASHTABLE(resolutions_ongoing, RESOLUTIONS_HASH_BITS);
 
 struct resolve_data {
         struct net_device * dev;
@@ -91,6 +97,23 @@ static bool is_resolve_data_matching(struct resolve_data * a,
         return true;
 }
 
+/* Tells if two pending resolutions would send the same request */
+static bool is_resolve_data_same_request(const struct resolve_data * a,
+                                         const struct resolve_data * b)
+{
+        ASSERT(a);
+        ASSERT(b);
+
+        return (a->dev   == b->dev              &&
+                a->ptype == b->ptype            &&
+                gpa_is_equal(a->tpa, b->tpa)    &&
+                gpa_is_equal(a->spa, b->spa)    &&
+                gha_is_equal(a->sha, b->sha)) ? true : false;
+}
+
+static u32 resolution_key(const struct gpa * pa)
+{ return jhash(gpa_address_value(pa), gpa_address_length(pa), 0); }
+
 static bool is_resolve_data_complete(const struct resolve_data * data)
 {
         return (!data                    ||
@@ -145,6 +168,8 @@ static int resolver(void * o)
 {
         struct resolve_data * tmp;
         struct resolution *   pos, * nxt;
+        struct hlist_node *   n;
+        LIST_HEAD(completed);
 
         LOG_DBG("In the resolver, looking for handler");
 
@@ -161,31 +186,35 @@ static int resolver(void * o)
 
         spin_lock(&resolutions_lock);
 
-        LOG_DBG("Gonna browse the list of resolutions now");
+        LOG_DBG("Gonna browse the bucket of resolutions now");
 
-        list_for_each_entry_safe(pos, nxt, &resolutions_ongoing, next) {
-                LOG_DBG("Next entry of the resolutions list");
+        /* The replies carry the GPA we asked for as their SPA */
+        hash_for_each_possible_safe(resolutions_ongoing, pos, n, hlist,
+                                    resolution_key(tmp->spa)) {
                 if (is_resolve_data_matching(pos->data, tmp)) {
                         LOG_DBG("Found an equal resolution");
-
-                        ASSERT(pos->notify);
-                        spin_unlock(&resolutions_lock);
-
-                        LOG_DBG("Calling the notifier hook");
-                        pos->notify(pos->opaque,
-                                    tmp->spa,
-                                    tmp->sha);
-
-                        LOG_DBG("Notifier called, disposing the leftovers");
-                        spin_lock(&resolutions_lock);
-                        list_del(&pos->next);
-                        resolve_data_destroy(pos->data);
-                        rkfree(pos);
+                        hash_del(&pos->hlist);
+                        list_add_tail(&pos->next, &completed);
                 }
         }
 
         spin_unlock(&resolutions_lock);
 
+        /* The notifiers are called without holding the lock */
+        list_for_each_entry_safe(pos, nxt, &completed, next) {
+                ASSERT(pos->notify);
+
+                LOG_DBG("Calling the notifier hook");
+                pos->notify(pos->opaque,
+                            tmp->spa,
+                            tmp->sha);
+
+                LOG_DBG("Notifier called, disposing the leftovers");
+                list_del(&pos->next);
+                resolve_data_destroy(pos->data);
+                rkfree(pos);
+        }
+
         /* Finally destroy the data */
         resolve_data_destroy(tmp);
         /* FIXME: A missing free seems to be missing here ... */
@@ -230,6 +259,44 @@ int arm_resolve(struct net_device * dev,
         return rwq_work_post(arm_wq, r);
 }
 
+/*
+ * The request of a resolution could not be sent: drop it together with
+ * the resolutions that joined it meanwhile, notifying the failure to the
+ * latter (the caller of the failed one gets the error returned instead)
+ */
+static void resolutions_fail(struct resolution * resolution)
+{
+        struct resolution * pos, * nxt;
+        struct hlist_node * n;
+        LIST_HEAD(failed);
+
+        spin_lock(&resolutions_lock);
+        hash_del(&resolution->hlist);
+        hash_for_each_possible_safe(resolutions_ongoing, pos, n, hlist,
+                                    resolution_key(resolution->data->tpa)) {
+                if (is_resolve_data_same_request(pos->data,
+                                                 resolution->data)) {
+                        hash_del(&pos->hlist);
+                        list_add_tail(&pos->next, &failed);
+                }
+        }
+        spin_unlock(&resolutions_lock);
+
+        list_for_each_entry_safe(pos, nxt, &failed, next) {
+                ASSERT(pos->notify);
+
+                LOG_DBG("Notifying a waiting resolution of the failure");
+                pos->notify(pos->opaque, pos->data->tpa, NULL);
+
+                list_del(&pos->next);
+                resolve_data_destroy(pos->data);
+                rkfree(pos);
+        }
+
+        resolve_data_destroy(resolution->data);
+        rkfree(resolution);
+}
+
 /* FIXME: Use dev */
 int arp826_resolve_gpa(struct net_device * dev,
                        uint16_t            ptype,
@@ -240,6 +307,9 @@ int arp826_resolve_gpa(struct net_device * dev,
                        void *              opaque)
 {
         struct resolution * resolution;
+        struct resolution * pos;
+        bool                pending;
+        u32                 key;
 
         struct gpa * tmp_spa;
         struct gpa * tmp_tpa;
@@ -298,19 +368,33 @@ int arp826_resolve_gpa(struct net_device * dev,
 
         resolution->notify = notify;
         resolution->opaque = opaque;
+        INIT_HLIST_NODE(&resolution->hlist);
         INIT_LIST_HEAD(&resolution->next);
 
-        LOG_DBG("Adding new resolution to the ongoing list");
+        key     = resolution_key(tmp_tpa);
+        pending = false;
+
+        LOG_DBG("Adding new resolution to the ongoing ones");
         spin_lock(&resolutions_lock);
-        list_add(&resolution->next, &resolutions_ongoing);
+        hash_for_each_possible(resolutions_ongoing, pos, hlist, key) {
+                if (is_resolve_data_same_request(pos->data,
+                                                 resolution->data)) {
+                        pending = true;
+                        break;
+                }
+        }
+        hash_add(resolutions_ongoing, &resolution->hlist, key);
         spin_unlock(&resolutions_lock);
 
+        /* The reply to the ongoing request will notify this one as well */
+        if (pending) {
+                LOG_DBG("Resolution already requested, waiting for it");
+                return 0;
+        }
+
         if (arp_send_request(dev, ptype, spa, sha, tpa)) {
                 LOG_ERR("Cannot send request, cannot resolve GPA");
-
-                resolve_data_destroy(resolution->data);
-                rkfree(resolution);
-
+                resolutions_fail(resolution);
                 return -1;
         }
 
@@ -325,7 +409,7 @@ int arm_init(void)
                 return -1;
 
         spin_lock_init(&resolutions_lock);
-        INIT_LIST_HEAD(&resolutions_ongoing);
+        hash_init(resolutions_ongoing);
 
         LOG_INFO("ARM initialized successfully");
 
@@ -334,10 +418,13 @@ int arm_init(void)
 
 int arm_fini(void)
 {
-        struct resolution * pos, * nxt;
+        struct resolution * pos;
+        struct hlist_node * nxt;
+        int                 bucket;
         int                 ret;
 
-        list_for_each_entry_safe(pos, nxt, &resolutions_ongoing, next) {
+        hash_for_each_safe(resolutions_ongoing, bucket, nxt, pos, hlist) {
+                hash_del(&pos->hlist);
                 resolve_data_destroy(pos->data);
                 rkfree(pos);
         }
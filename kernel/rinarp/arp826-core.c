@@ -328,6 +328,88 @@ static bool regression_tests_multi_dev_table(void)
 
         return true;
 }
+
+static bool regression_tests_table_entries(void)
+{
+        uint8_t              pa_1[]  = { 0x0a, 0x00, 0x00, 0x01 };
+        uint8_t              pa_2[]  = { 0x0a, 0x00, 0x00, 0x02 };
+        uint8_t              mac_1[] = { 0x01, 0x02, 0x03, 0x04, 0x05, 0x06 };
+        uint8_t              mac_2[] = { 0x06, 0x05, 0x04, 0x03, 0x02, 0x01 };
+        struct gpa *         a1;
+        struct gpa *         a2;
+        struct gha *         h1;
+        struct gha *         h2;
+        struct table *       x;
+        struct table_entry * e;
+        struct net_device *  d;
+        bool                 ret;
+
+        d = (struct net_device *) 0x1; /* Fake device pointer */
+
+        LOG_DBG("Table entries regression tests");
+
+        a1 = gpa_create(pa_1, sizeof(pa_1));
+        a2 = gpa_create(pa_2, sizeof(pa_2));
+        h1 = gha_create(MAC_ADDR_802_3, mac_1);
+        h2 = gha_create(MAC_ADDR_802_3, mac_2);
+        if (!a1 || !a2 || !h1 || !h2)
+                return false;
+
+        LOG_DBG("Regression test #1");
+        if (tbls_init())
+                return false;
+
+        ret = false;
+
+        LOG_DBG("Regression test #2");
+        x = tbls_create(d, 10, 6);
+        if (!x)
+                goto out;
+
+        LOG_DBG("Regression test #3");
+        e = tble_create(a1, h1);
+        if (!e || tbl_add(x, e))
+                goto out;
+        e = tble_create(a2, h2);
+        if (!e || tbl_add(x, e))
+                goto out;
+
+        LOG_DBG("Regression test #4");
+        e = tbl_find_by_gpa(x, a2);
+        if (!e || !gha_is_equal(tble_ha(e), h2))
+                goto out;
+        e = tbl_find_by_gha(x, h1);
+        if (!e || !gpa_is_equal(tble_pa(e), a1))
+                goto out;
+
+        LOG_DBG("Regression test #5");
+        if (tbl_update_by_gpa(x, a1, h2, GFP_KERNEL))
+                goto out;
+        e = tbl_find_by_gpa(x, a1);
+        if (!e || !gha_is_equal(tble_ha(e), h2))
+                goto out;
+
+        LOG_DBG("Regression test #6");
+        if (tbl_remove(x, a2, h2))
+                goto out;
+        if (tbl_find_by_gpa(x, a2))
+                goto out;
+        if (!tbl_find(x, a1, h2))
+                goto out;
+
+        ret = true;
+
+ out:
+        tbls_destroy(d, 10);
+        tbls_fini();
+
+        gpa_destroy(a1);
+        gpa_destroy(a2);
+        gha_destroy(h1);
+        gha_destroy(h2);
+
+        return ret;
+}
 #endif
 
 #ifdef CONFIG_ARP826_REGRESSION_TESTS
@@ -345,6 +427,10 @@ static bool regression_tests(void)
                 LOG_ERR("Table regression tests failed, bailing out");
                 return false;
         }
+        if (!regression_tests_table_entries()) {
+                LOG_ERR("Table entries regression tests failed, bailing out");
+                return false;
+        }
         if (!regression_tests_multi_dev_table()) {
                 LOG_ERR("Table regression tests failed, bailing out");
                 return false;
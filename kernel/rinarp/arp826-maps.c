@@ -20,6 +20,8 @@
 
 #include <linux/types.h>
 #include <linux/hashtable.h>
+#include <linux/hash.h>
+#include <linux/rculist.h>
 
 /* FIXME: The following dependencies have to be removed */
 #define RINA_PREFIX "arp826-maps"
@@ -31,15 +33,15 @@
 
 #include "arp826-maps.h"
 
+/* The maps hold one entry per (device, ptype) couple */
+#define TMAP_HASH_BITS 4
+
 /*
- * FIXME: This is the ugliest and shittier implementation we could find, but
- *        ... we had no time to do any better. This code will be replaced
- *        completely with a better implementation once we'be able to find
- *        time to breathe again ...
+ * NOTE: Lookups can be performed under RCU, changes have to be serialized by
+ *       the users of the map
  */
-
 struct tmap {
-        struct list_head head;
+        DECLARE_HASHTABLE(table, TMAP_HASH_BITS);
 };
 
 struct tmap_entry {
@@ -47,20 +49,21 @@ struct tmap_entry {
                 struct net_device * device;
                 uint16_t            ptype;
         } key;
-        struct table *   value;
+        struct table *    value;
 
-        struct list_head next;
+        struct hlist_node hlist;
+        struct rcu_head   rcu;
 };
 
 static struct tmap * tmap_create_gfp(gfp_t flags)
 {
         struct tmap * tmp;
 
-        tmp = rkzalloc(sizeof(*tmp), GFP_KERNEL);
+        tmp = rkzalloc(sizeof(*tmp), flags);
         if (!tmp)
                 return NULL;
 
-        INIT_LIST_HEAD(&tmp->head);
+        hash_init(tmp->table);
 
         return tmp;
 }
@@ -78,20 +81,22 @@ bool tmap_is_empty(struct tmap * map)
 {
         ASSERT(tmap_is_ok(map));
 
-        return list_empty(&map->head);
+        return hash_empty(map->table);
 }
 
 int tmap_destroy(struct tmap * map)
 {
-        struct tmap_entry * pos, * nxt;
+        struct tmap_entry * pos;
+        struct hlist_node * tmp;
+        int                 bucket;
 
         if (!tmap_is_ok(map))
                 return -1;
 
         ASSERT(tmap_is_empty(map)); /* To prevent loosing memory */
 
-        list_for_each_entry_safe(pos, nxt, &map->head, next) {
-                list_del(&pos->next);
+        hash_for_each_safe(map->table, bucket, tmp, pos, hlist) {
+                hash_del(&pos->hlist);
                 rkfree(pos);
         }
 
@@ -100,7 +105,8 @@ int tmap_destroy(struct tmap * map)
         return 0;
 }
 
-#define tmap_hash(T, K) hash_min(K, HASH_BITS(T))
+static u32 tmap_key(struct net_device * device, uint16_t ptype)
+{ return hash_ptr(device, 32) ^ ptype; }
 
 static int tmap_entry_add_gfp(gfp_t               flags,
                               struct tmap *       map,
@@ -120,9 +126,10 @@ static int tmap_entry_add_gfp(gfp_t               flags,
         tmp->key.device = key_device;
         tmp->key.ptype  = key_ptype;
         tmp->value      = value;
-        INIT_LIST_HEAD(&tmp->next);
+        INIT_HLIST_NODE(&tmp->hlist);
 
-        list_add(&tmp->next, &map->head);
+        hash_add_rcu(map->table, &tmp->hlist,
+                     tmap_key(key_device, key_ptype));
 
         return 0;
 }
@@ -148,7 +155,8 @@ struct tmap_entry * tmap_entry_find(struct tmap *       map,
         if (!tmap_is_ok(map))
                 return NULL;
 
-        list_for_each_entry(tmp, &map->head, next) {
+        hash_for_each_possible_rcu(map->table, tmp, hlist,
+                                   tmap_key(key_device, key_ptype)) {
                 if ((tmp->key.device == key_device) &&
                     (tmp->key.ptype  == key_ptype))
                         return tmp;
@@ -165,7 +173,7 @@ int tmap_entry_remove(struct tmap_entry * entry)
         if (!tmap_entry_is_ok(entry))
                 return -1;
 
-        list_del(&entry->next);
+        hash_del_rcu(&entry->hlist);
 
         return 0;
 }
@@ -178,12 +186,16 @@ struct table * tmap_entry_value(struct tmap_entry * entry)
         return entry->value;
 }
 
+static void tmap_entry_free_rcu(struct rcu_head * head)
+{ rkfree(container_of(head, struct tmap_entry, rcu)); }
+
+/* The entry is freed after a grace period, readers may be still using it */
 int tmap_entry_destroy(struct tmap_entry * entry)
 {
         if (!tmap_entry_is_ok(entry))
                 return -1;
 
-        rkfree(entry);
+        call_rcu(&entry->rcu, tmap_entry_free_rcu);
 
         return 0;
 }
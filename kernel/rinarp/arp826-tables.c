@@ -19,14 +19,17 @@
  */
 
 /*
- * NOTE: This cache implementation is far far far away to be a performance-wise
- *       one. Its scope is to server the upper-layers, nothing else. If we will
- *       have the time, a performance-wise implementation will obsolete this
- *       one completely.
+ * NOTE: Each table is indexed both by GPA and by GHA. Lookups run under RCU,
+ *       changes are serialized by the table lock and entries are freed after
+ *       a grace period, so the entries returned by the lookups can be used by
+ *       the callers in RCU read-side critical sections (e.g. softirqs).
  */
 
 #include <linux/types.h>
 #include <linux/netdevice.h>
+#include <linux/hashtable.h>
+#include <linux/rculist.h>
+#include <linux/jhash.h>
 
 /* FIXME: The following dependencies have to be removed */
 #define RINA_PREFIX "arp826-tables"
@@ -42,11 +45,16 @@
 #include "arp826-maps.h"
 #include "arp826-tables.h"
 
+/* Buckets of each index of a table */
+#define TABLE_HASH_BITS 10
+
 struct table_entry {
-        struct gpa *     pa; /* Protocol address */
-        struct gha *     ha; /* Hardware address */
+        struct gpa *      pa; /* Protocol address */
+        struct gha *      ha; /* Hardware address */
 
-        struct list_head next;
+        struct hlist_node by_gpa;
+        struct hlist_node by_gha;
+        struct rcu_head   rcu;
 };
 
 static void tble_fini(struct table_entry * entry)
@@ -78,6 +86,9 @@ int tble_destroy(struct table_entry * entry)
 }
 EXPORT_SYMBOL(tble_destroy);
 
+static void tble_destroy_rcu(struct rcu_head * head)
+{ tble_destroy(container_of(head, struct table_entry, rcu)); }
+
 /* Takes the ownership of the input GPA */
 static int tble_init(struct table_entry * entry,
                      struct gpa *         pa,
@@ -94,7 +105,8 @@ static int tble_init(struct table_entry * entry,
         entry->pa = pa;
         entry->ha = ha;
 
-        INIT_LIST_HEAD(&entry->next);
+        INIT_HLIST_NODE(&entry->by_gpa);
+        INIT_HLIST_NODE(&entry->by_gha);
 
         return 0;
 }
@@ -185,10 +197,20 @@ const struct gha * tble_ha(const struct table_entry * entry)
 
 struct table {
         size_t           hal;     /* Hardware address length */
-        spinlock_t       lock;
-        struct list_head entries;
+        spinlock_t       lock;    /* Serializes the changes */
+
+        DECLARE_HASHTABLE(by_gpa, TABLE_HASH_BITS);
+        DECLARE_HASHTABLE(by_gha, TABLE_HASH_BITS);
+
+        struct rcu_head  rcu;
 };
 
+static u32 gpa_hash(const struct gpa * pa)
+{ return jhash(gpa_address_value(pa), gpa_address_length(pa), 0); }
+
+static u32 gha_hash(const struct gha * ha)
+{ return jhash(gha_address(ha), gha_address_length(ha), 0); }
+
 static struct table * tbl_create_gfp(gfp_t  flags,
                                      size_t ha_length)
 {
@@ -208,7 +230,8 @@ static struct table * tbl_create_gfp(gfp_t  flags,
         LOG_DBG("Got memory, fillin' it up");
 
         instance->hal = ha_length;
-        INIT_LIST_HEAD(&instance->entries);
+        hash_init(instance->by_gpa);
+        hash_init(instance->by_gha);
         spin_lock_init(&instance->lock);
 
         LOG_DBG("Table instance created successfully");
@@ -216,33 +239,82 @@ static struct table * tbl_create_gfp(gfp_t  flags,
         return instance;
 }
 
+/* Nobody can look the table up anymore */
 static void tbl_destroy(struct table * instance)
 {
-        struct table_entry * pos, * q;
+        struct table_entry * pos;
+        struct hlist_node *  q;
+        int                  bkt;
 
         if (!instance) {
                 LOG_ERR("Bogus input parameter, cannot destroy table");
                 return;
         }
 
-        spin_lock(&instance->lock);
-
-        list_for_each_entry_safe(pos, q, &instance->entries, next) {
+        hash_for_each_safe(instance->by_gpa, bkt, q, pos, by_gpa) {
                 ASSERT(pos);
+                hash_del(&pos->by_gpa);
+                hash_del(&pos->by_gha);
                 tble_destroy(pos);
         }
 
-        spin_unlock(&instance->lock);
-
         rkfree(instance);
 }
 
+static void tbl_destroy_rcu(struct rcu_head * head)
+{ tbl_destroy(container_of(head, struct table, rcu)); }
+
+/* Must be called with the table lock held or in a RCU read-side section */
+static struct table_entry * __tbl_find_by_gpa(struct table *     instance,
+                                              const struct gpa * pa)
+{
+        struct table_entry * pos;
+
+        hash_for_each_possible_rcu(instance->by_gpa, pos, by_gpa,
+                                   gpa_hash(pa)) {
+                if (gpa_is_equal(pos->pa, pa))
+                        return pos;
+        }
+
+        return NULL;
+}
+
+static struct table_entry * __tbl_find(struct table *     instance,
+                                       const struct gpa * pa,
+                                       const struct gha * ha)
+{
+        struct table_entry * pos;
+
+        hash_for_each_possible_rcu(instance->by_gpa, pos, by_gpa,
+                                   gpa_hash(pa)) {
+                if (gpa_is_equal(pos->pa, pa) &&
+                    gha_is_equal(pos->ha, ha))
+                        return pos;
+        }
+
+        return NULL;
+}
+
+static void __tbl_link(struct table *       instance,
+                       struct table_entry * entry)
+{
+        hash_add_rcu(instance->by_gpa, &entry->by_gpa, gpa_hash(entry->pa));
+        hash_add_rcu(instance->by_gha, &entry->by_gha, gha_hash(entry->ha));
+}
+
+static void __tbl_unlink(struct table_entry * entry)
+{
+        hash_del_rcu(&entry->by_gpa);
+        hash_del_rcu(&entry->by_gha);
+}
+
 int tbl_update_by_gpa(struct table *     instance,
                       const struct gpa * pa,
                       struct gha *       ha,
                       gfp_t              flags)
 {
-        struct table_entry * pos;
+        struct table_entry * old;
+        struct table_entry * new;
 
         if (!instance) {
                 LOG_ERR("Bogus instance, cannot update GPA");
@@ -257,20 +329,28 @@ int tbl_update_by_gpa(struct table *     instance,
                 return -1;
         }
 
-        spin_lock(&instance->lock);
+        /* Readers may be using the old entry, so it is replaced */
+        new = tble_create_gfp(flags, (struct gpa *) pa, ha);
+        if (!new)
+                return -1;
 
-        list_for_each_entry(pos, &instance->entries, next) {
-                if (gpa_is_equal(pos->pa, pa)) {
-                        gha_destroy(pos->ha);
-                        pos->ha = gha_dup_gfp(flags, ha);
-                        spin_unlock(&instance->lock);
-                        return 0;
-                }
+        spin_lock_bh(&instance->lock);
+
+        old = __tbl_find_by_gpa(instance, pa);
+        if (!old) {
+                spin_unlock_bh(&instance->lock);
+                tble_destroy(new);
+                return -1;
         }
 
-        spin_unlock(&instance->lock);
+        __tbl_unlink(old);
+        __tbl_link(instance, new);
+
+        spin_unlock_bh(&instance->lock);
+
+        call_rcu(&old->rcu, tble_destroy_rcu);
 
-        return -1;
+        return 0;
 }
 
 struct table_entry * tbl_find(struct table *     instance,
@@ -292,19 +372,11 @@ struct table_entry * tbl_find(struct table *     instance,
                 return NULL;
         }
 
-        spin_lock(&instance->lock);
+        rcu_read_lock();
+        pos = __tbl_find(instance, pa, ha);
+        rcu_read_unlock();
 
-        list_for_each_entry(pos, &instance->entries, next) {
-                if (gpa_is_equal(pos->pa, pa) &&
-                    gha_is_equal(pos->ha, ha)) {
-                        spin_unlock(&instance->lock);
-                        return pos;
-                }
-        }
-
-        spin_unlock(&instance->lock);
-
-        return NULL;
+        return pos;
 }
 
 struct table_entry * tbl_find_by_gha(struct table *     instance,
@@ -321,16 +393,15 @@ struct table_entry * tbl_find_by_gha(struct table *     instance,
                 return NULL;
         }
 
-        spin_lock(&instance->lock);
-
-        list_for_each_entry(pos, &instance->entries, next) {
+        rcu_read_lock();
+        hash_for_each_possible_rcu(instance->by_gha, pos, by_gha,
+                                   gha_hash(address)) {
                 if (gha_is_equal(pos->ha, address)) {
-                        spin_unlock(&instance->lock);
+                        rcu_read_unlock();
                         return pos;
                 }
         }
-
-        spin_unlock(&instance->lock);
+        rcu_read_unlock();
 
         return NULL;
 }
@@ -352,22 +423,14 @@ struct table_entry * tbl_find_by_gpa(struct table *     instance,
         LOG_DBG("Looking for the following address in table");
         gpa_dump(address);
 
-        LOG_DBG("Showing addresses in table in the meanwhile");
+        rcu_read_lock();
+        pos = __tbl_find_by_gpa(instance, address);
+        rcu_read_unlock();
 
-        spin_lock(&instance->lock);
-        list_for_each_entry(pos, &instance->entries, next) {
-                gpa_dump(pos->pa);
-                if (gpa_is_equal(pos->pa, address)) {
-                        LOG_DBG("That's the address I need");
-                        spin_unlock(&instance->lock);
-                        return pos;
-                }
-        }
-        spin_unlock(&instance->lock);
+        if (!pos)
+                LOG_DBG("Got no matching address");
 
-        LOG_DBG("Got no matching address");
-
-        return NULL;
+        return pos;
 }
 
 int tbl_add(struct table *       instance,
@@ -386,67 +449,64 @@ int tbl_add(struct table *       instance,
 
         LOG_DBG("Adding entry %pK to the table", entry);
 
-        spin_lock(&instance->lock);
+        spin_lock_bh(&instance->lock);
 
-        list_for_each_entry(pos, &instance->entries, next) {
+        pos = __tbl_find_by_gpa(instance, entry->pa);
+        if (pos) {
                 if (tble_is_equal(pos, entry)) {
                         LOG_WARN("We already have an equal entry ...");
-                        spin_unlock(&instance->lock);
+                        spin_unlock_bh(&instance->lock);
+                        /* Ownership was taken, the duplicate is disposed */
+                        tble_destroy(entry);
                         return 0;
                 }
 
-                /* FIXME: What about the other conditions ??? */
-                if (gha_is_equal(tble_ha(pos), tble_ha(entry))) {
-                        /* FIXME: What should we do here? */
-
-                        /* Remember to: spin_unlock(&instance->lock); */
-                }
-
-                if (gpa_is_equal(tble_pa(pos), tble_pa(entry))) {
-                        LOG_WARN("We already have the same GPA in the cache");
-
-                        /* FIXME: What should we do here? */
-
-                        /* Remember to: spin_unlock(&instance->lock); */
-                }
+                /* The GPA moved to another GHA, replace the old entry */
+                LOG_DBG("Replacing the entry with the same GPA");
+                __tbl_unlink(pos);
         }
 
-        list_add(&entry->next, &instance->entries);
+        __tbl_link(instance, entry);
+
+        spin_unlock_bh(&instance->lock);
 
-        spin_unlock(&instance->lock);
+        if (pos)
+                call_rcu(&pos->rcu, tble_destroy_rcu);
 
         LOG_DBG("Entry %pK added successfully to the table", entry);
 
         return 0;
 }
 
-int tbl_remove(struct table *             instance,
-               const struct table_entry * entry)
+int tbl_remove(struct table *     instance,
+               const struct gpa * pa,
+               const struct gha * ha)
 {
-        struct table_entry * pos, * q;
+        struct table_entry * pos;
 
         if (!instance) {
                 LOG_ERR("Bogus instance, cannot remove entry from table");
                 return -1;
         }
-        if (!entry) {
-                LOG_ERR("Bogus entry, cannot remove entry from table");
+        if (!gpa_is_ok(pa) || !gha_is_ok(ha)) {
+                LOG_ERR("Bogus addresses, cannot remove entry from table");
                 return -1;
         }
 
-        spin_lock(&instance->lock);
+        spin_lock_bh(&instance->lock);
 
-        list_for_each_entry_safe(pos, q, &instance->entries, next) {
-                if (pos == entry) {
-                        list_del(&pos->next);
-                        spin_unlock(&instance->lock);
-                        return 0;
-                }
+        pos = __tbl_find(instance, pa, ha);
+        if (!pos) {
+                spin_unlock_bh(&instance->lock);
+                return -1;
         }
+        __tbl_unlink(pos);
+
+        spin_unlock_bh(&instance->lock);
 
-        spin_unlock(&instance->lock);
+        call_rcu(&pos->rcu, tble_destroy_rcu);
 
-        return -1;
+        return 0;
 }
 
 static DEFINE_SPINLOCK(tables_lock);
@@ -455,21 +515,19 @@ static struct tmap * tables = NULL;
 struct table * tbls_find(struct net_device * device, uint16_t ptype)
 {
         struct tmap_entry * e;
+        struct table *      cl;
 
         if (!device)
                 return NULL;
 
-        spin_lock_bh(&tables_lock);
+        rcu_read_lock();
 
         e = tmap_entry_find(tables, device, ptype);
-        if (!e) {
-                spin_unlock_bh(&tables_lock);
-                return NULL;
-        }
+        cl = e ? tmap_entry_value(e) : NULL;
 
-        spin_unlock_bh(&tables_lock);
+        rcu_read_unlock();
 
-        return tmap_entry_value(e);
+        return cl;
 }
 
 static struct table * tbls_create_gfp(gfp_t               flags,
@@ -479,12 +537,6 @@ static struct table * tbls_create_gfp(gfp_t               flags,
 {
         struct table * cl;
 
-        cl = tbls_find(device, ptype);
-        if (cl) {
-                LOG_ERR("Table for ptype 0x%04X already created", ptype);
-                return NULL;
-        }
-
         cl = tbl_create_gfp(flags, hwlen);
         if (!cl) {
                 LOG_ERR("Cannot create table for ptype 0x%04X, hwlen %zd",
@@ -495,6 +547,12 @@ static struct table * tbls_create_gfp(gfp_t               flags,
         LOG_DBG("Now adding the new table to the tables map");
 
         spin_lock_bh(&tables_lock);
+        if (tmap_entry_find(tables, device, ptype)) {
+                spin_unlock_bh(&tables_lock);
+                LOG_ERR("Table for ptype 0x%04X already created", ptype);
+                tbl_destroy(cl);
+                return NULL;
+        }
         if (tmap_entry_add_ni(tables, device, ptype, cl)) {
                 spin_unlock_bh(&tables_lock);
 
@@ -526,24 +584,25 @@ int tbls_destroy(struct net_device * device, uint16_t ptype)
         struct tmap_entry * e;
         struct table *      cl;
 
-        spin_lock(&tables_lock);
+        spin_lock_bh(&tables_lock);
 
         e = tmap_entry_find(tables, device, ptype);
         if (!e) {
                 LOG_DBG("Table for ptype 0x%04X is missing, cannot destroy",
                          ptype);
-                spin_unlock(&tables_lock);
+                spin_unlock_bh(&tables_lock);
                 return -1;
         }
         tmap_entry_remove(e);
 
-        spin_unlock(&tables_lock); /* No need to hold the lock anymore */
+        spin_unlock_bh(&tables_lock); /* No need to hold the lock anymore */
 
         cl = tmap_entry_value(e);
 
         ASSERT(cl);
 
-        tbl_destroy(cl);
+        /* Readers may still be using them */
+        call_rcu(&cl->rcu, tbl_destroy_rcu);
         tmap_entry_destroy(e);
 
         LOG_DBG("Table for ptype 0x%04X destroyed successfully", ptype);
@@ -578,6 +637,9 @@ void tbls_fini(void)
 
         ASSERT(tmap_is_empty(tables));
 
+        /* Wait for the tables and entries that are being freed */
+        rcu_barrier();
+
         tmap_destroy(tables);
 
         tables = NULL;
@@ -656,7 +718,6 @@ int arp826_remove(struct net_device * device,
                   const struct gha *  ha)
 {
         struct table *       cl;
-        struct table_entry * ce;
 
         if (!gpa_is_ok(pa)) {
                 LOG_ERR("Cannot remove, bad PA");
@@ -671,39 +732,32 @@ int arp826_remove(struct net_device * device,
         if (!cl)
                 return -1;
 
-        ce = tbl_find(cl, pa, ha);
-        if (!ce)
-                return -1;
-
-        if (tbl_remove(cl, ce))
-                return -1;
-
-        tble_destroy(ce);
-
-        return 0;
+        return tbl_remove(cl, pa, ha);
 }
 EXPORT_SYMBOL(arp826_remove);
 
-const struct gpa * arp826_find_gpa(struct net_device * device,
-                                   uint16_t            ptype,
-                                   const struct gha *  ha)
+struct gpa * arp826_find_gpa(struct net_device * device,
+                             uint16_t            ptype,
+                             const struct gha *  ha)
 {
         struct table *             cl;
         const struct table_entry * ce;
+        struct gpa *               pa;
 
         if (!gha_is_ok(ha)) {
                 LOG_ERR("Cannot resolve, bad HA");
                 return NULL;
         }
 
+        /* The entry may be freed once out of the RCU read-side section */
+        rcu_read_lock();
+
         cl = tbls_find(device, ptype);
-        if (!cl)
-                return NULL;
+        ce = cl ? tbl_find_by_gha(cl, ha) : NULL;
+        pa = ce ? gpa_dup_gfp(GFP_ATOMIC, tble_pa(ce)) : NULL;
 
-        ce = tbl_find_by_gha(cl, ha);
-        if (!ce)
-                return NULL;
+        rcu_read_unlock();
 
-        return tble_pa(ce);
+        return pa;
 }
 EXPORT_SYMBOL(arp826_find_gpa);
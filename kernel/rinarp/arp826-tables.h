@@ -54,8 +54,10 @@ struct table;
  */
 int                  tbl_add(struct table *       instance,
                              struct table_entry * entry);
-int                  tbl_remove(struct table *             instance,
-                                const struct table_entry * entry);
+/* The entry is freed after a RCU grace period */
+int                  tbl_remove(struct table *     instance,
+                                const struct gpa * pa,
+                                const struct gha * ha);
 
 /* Replaces the old gha with the new one, takes the ownership */
 int                  tbl_update_by_gpa(struct table *     instance,
@@ -63,6 +65,10 @@ int                  tbl_update_by_gpa(struct table *     instance,
                                        struct gha *       gha,
                                        gfp_t              flags);
 
+/*
+ * The entries returned are valid until the end of the RCU read-side
+ * critical section of the caller
+ */
 struct table_entry * tbl_find(struct table *     instance,
                               const struct gpa * pa,
                               const struct gha * ha);
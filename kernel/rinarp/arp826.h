@@ -39,6 +39,7 @@ int                arp826_remove(struct net_device * dev,
                                  const struct gpa *  pa,
                                  const struct gha *  ha);
 
+/* tha is NULL if the resolution request could not be sent */
 typedef void (* arp826_notify_t)(void *             opaque,
                                  const struct gpa * tpa,
                                  const struct gha * tha);
@@ -50,7 +51,8 @@ int                arp826_resolve_gpa(struct net_device * dev,
                                       const struct gpa *  tpa,
                                       arp826_notify_t     notify,
                                       void *              opaque);
-const struct gpa * arp826_find_gpa(struct net_device * dev,
+/* Returns a copy of the GPA, to be destroyed by the caller */
+struct gpa *       arp826_find_gpa(struct net_device * dev,
                                    uint16_t            ptype,
                                    const struct gha *  ha);
 
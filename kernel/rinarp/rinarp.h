@@ -36,6 +36,7 @@ struct rinarp_handle * rinarp_add(struct net_device * dev,
                                   const struct gha *  ha);
 int                    rinarp_remove(struct rinarp_handle * handle);
 
+/* tha is NULL if the resolution request could not be sent */
 typedef void (* rinarp_notification_t)(void *             opaque,
                                        const struct gpa * tpa,
                                        const struct gha * tha);
@@ -45,8 +46,8 @@ int                    rinarp_resolve_gpa(struct rinarp_handle * handle,
                                           rinarp_notification_t  notify,
                                           void *                 opaque);
 
-/* FIXME: Should return a copy */
-const struct gpa *     rinarp_find_gpa(struct rinarp_handle * handle,
+/* Returns a copy of the GPA, to be destroyed by the caller */
+struct gpa *           rinarp_find_gpa(struct rinarp_handle * handle,
                                        const struct gha *     tha);
 
 #endif
@@ -188,7 +188,7 @@ int default_rmt_enqueue_policy(struct rmt_ps *      ps,
 	}
 
 	pdu_type = pci_type(&du->pci);
-	if (pdu_type == PDU_TYPE_MGMT) {
+	if (pdu_type_is_mgmt(pdu_type)) {
 		if (!must_enqueue && rfifo_is_empty(q->mgt_queue)){
 			return RMT_PS_ENQ_SEND;
 		}
@@ -29,6 +29,8 @@
 #include <linux/sched.h>
 #include <linux/wait.h>
 #include <linux/string.h>
+#include <linux/hrtimer.h>
+#include <linux/ktime.h>
 /* FIXME: to be re-removed after removing tasklets */
 #include <linux/interrupt.h>
 
@@ -51,6 +53,10 @@
 
 #define rmap_hash(T, K) hash_min(K, HASH_BITS(T))
 #define MAX_PDUS_SENT_PER_CYCLE 10
+#define RMT_KA_MIN_INTERVAL_US 100
+#define RMT_KA_DEFAULT_DETECT_MULT 3
+/* Keepalives carry the qos-id normal IPCPs use for management PDUs */
+#define RMT_KA_QOS_ID 1
 
 static struct policy_set_list policy_sets = {
 	.head = LIST_HEAD_INIT(policy_sets.head)
@@ -68,6 +74,18 @@ struct rmt_address {
         struct list_head list;
 };
 
+/*
+ * Liveness detection on the N-1 ports. Every PDU received on a port
+ * proves the neighbor is alive; idle ports are probed with keepalive
+ * PDUs and declared dead after detect_mult intervals of silence.
+ */
+struct rmt_keepalive {
+	unsigned int	      interval_us; /* 0 disables the monitor */
+	unsigned int	      detect_mult;
+	struct hrtimer	      timer;
+	struct tasklet_struct tasklet;
+};
+
 struct rmt {
 	struct rina_component base;
 	spinlock_t	      lock;
@@ -81,6 +99,7 @@ struct rmt {
 	struct pff_cache cache;
 	struct rmt_config *rmt_cfg;
 	struct sdup *sdup;
+	struct rmt_keepalive ka;
 	struct robject robj;
 };
 
@@ -106,6 +125,12 @@ static ssize_t rmt_attr_show(struct robject *        robj,
 	if (strcmp(robject_attr_name(attr), "ps_name") == 0) {
 		return sprintf(buf, "%s\n", rmt->base.ps_factory->name);
 	}
+	if (strcmp(robject_attr_name(attr), "keepalive_interval_us") == 0) {
+		return sprintf(buf, "%u\n", rmt->ka.interval_us);
+	}
+	if (strcmp(robject_attr_name(attr), "keepalive_detect_mult") == 0) {
+		return sprintf(buf, "%u\n", rmt->ka.detect_mult);
+	}
 	return 0;
 }
 
@@ -116,6 +141,7 @@ static ssize_t rmt_n1_port_attr_show(struct robject *        robj,
 	struct rmt_n1_port * n1_port;
 	unsigned int stats_ret;
 	bool wbusy;
+	bool ka_down;
 	enum flow_state state;
 
 	n1_port = container_of(robj, struct rmt_n1_port, robj);
@@ -162,14 +188,29 @@ static ssize_t rmt_n1_port_attr_show(struct robject *        robj,
 		spin_unlock_bh(&n1_port->lock);
 		return sprintf(buf, "%d\n", (int) state);
 	}
+	if (strcmp(robject_attr_name(attr), "keepalive_tx_pdus") == 0) {
+		stats_get(ka_tx_pdus, n1_port, stats_ret);
+		return sprintf(buf, "%u\n", stats_ret);
+	}
+	if (strcmp(robject_attr_name(attr), "keepalive_down_events") == 0) {
+		stats_get(ka_down_events, n1_port, stats_ret);
+		return sprintf(buf, "%u\n", stats_ret);
+	}
+	if (strcmp(robject_attr_name(attr), "alive") == 0) {
+		spin_lock_bh(&n1_port->lock);
+		ka_down = n1_port->ka_down;
+		spin_unlock_bh(&n1_port->lock);
+		return sprintf(buf, "%s\n", ka_down?"false":"true");
+	}
 	return 0;
 }
 RINA_SYSFS_OPS(rmt);
-RINA_ATTRS(rmt, ps_name);
+RINA_ATTRS(rmt, ps_name, keepalive_interval_us, keepalive_detect_mult);
 RINA_KTYPE(rmt);
 RINA_SYSFS_OPS(rmt_n1_port);
 RINA_ATTRS(rmt_n1_port, queued_pdus, drop_pdus, err_pdus, tx_pdus,
-	   tx_bytes, rx_pdus, rx_bytes, wbusy, state);
+	   tx_bytes, rx_pdus, rx_bytes, wbusy, state, keepalive_tx_pdus,
+	   keepalive_down_events, alive);
 RINA_KTYPE(rmt_n1_port);
 
 static struct rmt_n1_port *n1_port_create(port_id_t id,
@@ -199,6 +240,11 @@ static struct rmt_n1_port *n1_port_create(port_id_t id,
 	tmp->stats.tx_bytes = 0;
 	tmp->stats.rx_pdus = 0;
 	tmp->stats.rx_bytes = 0;
+	tmp->stats.ka_tx_pdus = 0;
+	tmp->stats.ka_down_events = 0;
+	tmp->ka_last_rx = ktime_get();
+	tmp->ka_last_tx = tmp->ka_last_rx;
+	tmp->ka_down = false;
 	tmp->sdup_port = 0;
 	spin_lock_init(&tmp->lock);
 
@@ -479,6 +525,260 @@ int rmt_select_policy_set(struct rmt *rmt,
 }
 EXPORT_SYMBOL(rmt_select_policy_set);
 
+struct rmt_ka_action {
+	port_id_t port_id;
+	bool	  send;
+	int	  change; /* -1 went down, 1 came back up, 0 unchanged */
+};
+
+static int rmt_keepalive_send(struct rmt *rmt,
+			      port_id_t port_id)
+{
+	struct rmt_address *addr;
+	address_t src_address;
+	struct du *du;
+
+	if (!rmt->efcpc->config)
+		return -1;
+
+	src_address = 0;
+	spin_lock_bh(&rmt->lock);
+	addr = list_first_entry_or_null(&rmt->addresses,
+					struct rmt_address, list);
+	if (addr)
+		src_address = addr->address;
+	spin_unlock_bh(&rmt->lock);
+
+	du = du_create_efcp_ni(PDU_TYPE_KEEPALIVE, rmt->efcpc->config);
+	if (!du)
+		return -1;
+
+	if (pci_format(&du->pci,
+		       0,
+		       0,
+		       src_address,
+		       0,
+		       0,
+		       RMT_KA_QOS_ID,
+		       du->pci.len,
+		       PDU_TYPE_KEEPALIVE)) {
+		LOG_ERR("Problems formatting keepalive PCI");
+		du_destroy(du);
+		return -1;
+	}
+
+	return rmt_send_port_id(rmt, port_id, du);
+}
+
+/*
+ * Walks the N-1 ports deciding which ones must be probed and which ones
+ * changed liveness; the actions are run after dropping the map lock since
+ * they go through the PFF and the egress path. With flush set every port
+ * still declared dead is brought back, used when the monitor is disabled.
+ */
+static void rmt_keepalive_scan(struct rmt *rmt, bool flush)
+{
+	struct rmt_n1_port *entry;
+	struct rmt_ka_action *acts;
+	struct n1pmap *m;
+	unsigned int interval_us;
+	s64 detect_us;
+	s64 idle_us;
+	ktime_t now;
+	int bucket;
+	int n, i;
+
+	m = rmt->n1_ports;
+	if (!m)
+		return;
+
+	interval_us = rmt->ka.interval_us;
+	if (!interval_us && !flush)
+		return;
+	detect_us = (s64) interval_us * rmt->ka.detect_mult;
+	now = ktime_get();
+
+	spin_lock_bh(&m->lock);
+	n = 0;
+	hash_for_each(m->n1_ports, bucket, entry, hlist)
+		n++;
+	if (!n) {
+		spin_unlock_bh(&m->lock);
+		return;
+	}
+
+	acts = rkzalloc(n * sizeof(*acts), GFP_ATOMIC);
+	if (!acts) {
+		spin_unlock_bh(&m->lock);
+		return;
+	}
+
+	n = 0;
+	hash_for_each(m->n1_ports, bucket, entry, hlist) {
+		spin_lock(&entry->lock);
+		if (entry->state == N1_PORT_STATE_DEALLOCATED) {
+			spin_unlock(&entry->lock);
+			continue;
+		}
+
+		acts[n].port_id = entry->port_id;
+		if (flush) {
+			if (entry->ka_down) {
+				entry->ka_down = false;
+				acts[n].change = 1;
+			}
+			spin_unlock(&entry->lock);
+			n++;
+			continue;
+		}
+
+		/* The timestamps are also updated locklessly on rx/tx */
+		idle_us = ktime_us_delta(now, READ_ONCE(entry->ka_last_rx));
+		if (!entry->ka_down && idle_us > detect_us) {
+			entry->ka_down = true;
+			entry->stats.ka_down_events++;
+			acts[n].change = -1;
+		} else if (entry->ka_down && idle_us <= interval_us) {
+			entry->ka_down = false;
+			acts[n].change = 1;
+		}
+
+		/* Ports carrying traffic need no probes */
+		if (ktime_us_delta(now, READ_ONCE(entry->ka_last_tx)) >=
+		    interval_us) {
+			WRITE_ONCE(entry->ka_last_tx, now);
+			entry->stats.ka_tx_pdus++;
+			acts[n].send = true;
+		}
+		spin_unlock(&entry->lock);
+		n++;
+	}
+	spin_unlock_bh(&m->lock);
+
+	for (i = 0; i < n; i++) {
+		if (acts[i].change) {
+			bool up = acts[i].change > 0;
+
+			LOG_INFO("N-1 port %d is %s", acts[i].port_id,
+				 up ? "alive again" : "dead, no PDUs received");
+			if (rmt_pff_port_state_change(rmt, acts[i].port_id, up))
+				LOG_ERR("Could not change PFF state of port %d",
+					acts[i].port_id);
+			if (rmt->parent->ops->nm1_port_liveness_notify)
+				rmt->parent->ops->nm1_port_liveness_notify(
+					rmt->parent->data, acts[i].port_id, up);
+		}
+
+		if (acts[i].send && rmt_keepalive_send(rmt, acts[i].port_id))
+			LOG_DBG("Could not send keepalive on port %d",
+				acts[i].port_id);
+	}
+
+	rkfree(acts);
+}
+
+static void rmt_keepalive_worker(unsigned long o)
+{ rmt_keepalive_scan((struct rmt *) o, false); }
+
+static enum hrtimer_restart rmt_keepalive_timer_fn(struct hrtimer *timer)
+{
+	struct rmt *rmt;
+	unsigned int interval_us;
+
+	rmt = container_of(timer, struct rmt, ka.timer);
+	interval_us = rmt->ka.interval_us;
+	if (!interval_us)
+		return HRTIMER_NORESTART;
+
+	tasklet_hi_schedule(&rmt->ka.tasklet);
+	hrtimer_forward_now(timer,
+			    ns_to_ktime((u64) interval_us * NSEC_PER_USEC));
+
+	return HRTIMER_RESTART;
+}
+
+static int rmt_keepalive_configure(struct rmt *rmt,
+				   unsigned int interval_us,
+				   unsigned int detect_mult)
+{
+	struct rmt_n1_port *entry;
+	struct n1pmap *m;
+	ktime_t now;
+	int bucket;
+
+	if (interval_us && interval_us < RMT_KA_MIN_INTERVAL_US) {
+		LOG_ERR("Keepalive interval must be at least %d us",
+			RMT_KA_MIN_INTERVAL_US);
+		return -1;
+	}
+	if (!detect_mult) {
+		LOG_ERR("Keepalive detection multiplier must be positive");
+		return -1;
+	}
+
+	hrtimer_cancel(&rmt->ka.timer);
+	tasklet_kill(&rmt->ka.tasklet);
+
+	rmt->ka.interval_us = interval_us;
+	rmt->ka.detect_mult = detect_mult;
+
+	if (!interval_us) {
+		rmt_keepalive_scan(rmt, true);
+		LOG_INFO("N-1 port keepalives disabled");
+		return 0;
+	}
+
+	/* Every port gets a full detection time before being judged */
+	m = rmt->n1_ports;
+	now = ktime_get();
+	spin_lock_bh(&m->lock);
+	hash_for_each(m->n1_ports, bucket, entry, hlist) {
+		spin_lock(&entry->lock);
+		WRITE_ONCE(entry->ka_last_rx, now);
+		spin_unlock(&entry->lock);
+	}
+	spin_unlock_bh(&m->lock);
+
+	hrtimer_start(&rmt->ka.timer,
+		      ns_to_ktime((u64) interval_us * NSEC_PER_USEC),
+		      HRTIMER_MODE_REL);
+
+	LOG_INFO("N-1 port keepalives every %u us, dead after %u misses",
+		 interval_us, detect_mult);
+
+	return 0;
+}
+
+static bool is_keepalive_param(const string_t *name)
+{
+	return (strcmp(name, "keepalive_interval_us") == 0 ||
+		strcmp(name, "keepalive_detect_mult") == 0);
+}
+
+static int rmt_keepalive_set_param(struct rmt *rmt,
+				   const string_t *name,
+				   const string_t *value)
+{
+	unsigned int interval_us;
+	unsigned int detect_mult;
+	unsigned int uval;
+
+	if (kstrtouint(value, 10, &uval)) {
+		LOG_ERR("Invalid value '%s' for RMT parameter '%s'",
+			value, name);
+		return -1;
+	}
+
+	interval_us = rmt->ka.interval_us;
+	detect_mult = rmt->ka.detect_mult;
+	if (strcmp(name, "keepalive_interval_us") == 0)
+		interval_us = uval;
+	else
+		detect_mult = uval;
+
+	return rmt_keepalive_configure(rmt, interval_us, detect_mult);
+}
+
 int rmt_set_policy_set_param(struct rmt *rmt,
 			     const char *path,
 			     const char *name,
@@ -498,7 +798,11 @@ int rmt_set_policy_set_param(struct rmt *rmt,
 
 	LOG_DBG("set-policy-set-param '%s' '%s' '%s'", path, name, value);
 
-	if (strcmp(path, "") == 0) {
+	if (strcmp(path, "") == 0 && is_keepalive_param(name)) {
+		/* The request addresses the keepalive monitor. */
+		ret = rmt_keepalive_set_param(rmt, name, value);
+
+	} else if (strcmp(path, "") == 0) {
 		/* The request addresses this RMT instance. */
 		rcu_read_lock();
 		ps = container_of(rcu_dereference(rmt->base.ps),
@@ -588,6 +892,9 @@ int rmt_destroy(struct rmt *instance)
 		return -1;
 	}
 
+	instance->ka.interval_us = 0;
+	hrtimer_cancel(&instance->ka.timer);
+	tasklet_kill(&instance->ka.tasklet);
 	tasklet_kill(&instance->egress_tasklet);
 	if (instance->n1_ports)
 		n1pmap_destroy(instance);
@@ -639,6 +946,28 @@ struct rmt_config *rmt_config_get(struct rmt *instance)
 }
 EXPORT_SYMBOL(rmt_config_get);
 
+/* The keepalive monitor is configured through the RMT policy parameters */
+static void rmt_keepalive_config_apply(struct rmt *instance,
+				       struct policy *policy)
+{
+	struct policy_parm *param;
+
+	if (!policy)
+		return;
+
+	param = policy_param_find(policy, "keepalive_detect_mult");
+	if (param && rmt_keepalive_set_param(instance,
+					     policy_param_name(param),
+					     policy_param_value(param)))
+		LOG_ERR("Could not set the keepalive detection multiplier");
+
+	param = policy_param_find(policy, "keepalive_interval_us");
+	if (param && rmt_keepalive_set_param(instance,
+					     policy_param_name(param),
+					     policy_param_value(param)))
+		LOG_ERR("Could not set the keepalive interval");
+}
+
 int rmt_config_set(struct rmt *instance,
 		   struct rmt_config *rmt_config)
 {
@@ -669,6 +998,8 @@ int rmt_config_set(struct rmt *instance,
 	if (pff_select_policy_set(instance->pff, "", pff_ps_name))
 		LOG_ERR("Could not set policy set %s for PFF", pff_ps_name);
 
+	rmt_keepalive_config_apply(instance, rmt_config->policy_set);
+
 	rmt_config_free(instance->rmt_cfg);
 	instance->rmt_cfg = NULL;
 	return 0;
@@ -686,8 +1017,11 @@ static int n1_port_write_du(struct rmt *rmt,
 	ret = n1_port->n1_ipcp->ops->du_write(n1_port->n1_ipcp->data,
 					      n1_port->port_id,
 					      du, false);
-	if (!ret)
+	if (!ret) {
+		if (rmt->ka.interval_us)
+			WRITE_ONCE(n1_port->ka_last_tx, ktime_get());
 		return (int) bytes;
+	}
 
 	if (ret == -EAGAIN) {
 		n1_port_lock(n1_port);
@@ -1305,6 +1639,8 @@ int rmt_receive(struct rmt *rmt,
 		return -1;
 	}
 	stats_inc(rx, n1_port, bytes);
+	if (rmt->ka.interval_us)
+		WRITE_ONCE(n1_port->ka_last_rx, ktime_get());
 
 	/* SDU Protection */
 	if (sdup_unprotect_pdu(n1_port->sdup_port, du)) {
@@ -1341,6 +1677,12 @@ int rmt_receive(struct rmt *rmt,
 		return -1;
 	}
 
+	/* Keepalives only refresh the liveness of the port, done above */
+	if (pdu_type == PDU_TYPE_KEEPALIVE) {
+		du_destroy(du);
+		return 0;
+	}
+
 	/* pdu is for me */
 	if (pdu_is_addressed_to_me(rmt, dst_addr)) {
 		/* pdu is for me */
@@ -1413,13 +1755,21 @@ struct rmt *rmt_create(struct kfa *kfa,
 	tmp->sdup = sdup;
 	rina_component_init(&tmp->base);
 
+	tmp->ka.interval_us = 0;
+	tmp->ka.detect_mult = RMT_KA_DEFAULT_DETECT_MULT;
+	hrtimer_init(&tmp->ka.timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	tmp->ka.timer.function = rmt_keepalive_timer_fn;
+	tasklet_init(&tmp->ka.tasklet,
+		     rmt_keepalive_worker,
+		     (unsigned long) tmp);
+
 	if (robject_init_and_add(&tmp->robj, &rmt_rtype, parent, "rmt")) {
                 LOG_ERR("Failed to create RMT sysfs entry");
                 rmt_destroy(tmp);
                 return NULL;
 	}
 
-	tmp->pff = pff_create(&tmp->robj, tmp->parent);
+	tmp->pff = pff_create(&tmp->robj, tmp->parent, tmp);
 	if (!tmp->pff) {
 		rmt_destroy(tmp);
 		return NULL;
@@ -1447,6 +1797,39 @@ struct rmt *rmt_create(struct kfa *kfa,
 }
 EXPORT_SYMBOL(rmt_create);
 
+int rmt_n1port_queue_len(struct rmt *instance,
+			 port_id_t id)
+{
+	struct rmt_n1_port *n1_port;
+	unsigned int plen;
+
+	if (!instance)
+		return -1;
+
+	n1_port = n1pmap_find(instance, id);
+	if (!n1_port)
+		return -1;
+
+	stats_get(plen, n1_port, plen);
+	n1pmap_release(instance, n1_port);
+
+	return plen;
+}
+EXPORT_SYMBOL(rmt_n1port_queue_len);
+
+/*
+ * Lets the PS drop a PDU it had already queued (e.g. from its dequeue
+ * policy), the n1_port lock must be held
+ */
+void rmt_n1port_drop_queued(struct rmt_n1_port *n1_port,
+			    struct du *du)
+{
+	du_destroy(du);
+	n1_port->stats.plen--;
+	n1_port->stats.drop_pdus++;
+}
+EXPORT_SYMBOL(rmt_n1port_drop_queued);
+
 static bool is_rmt_pff_ok(struct rmt *instance)
 { return (instance && instance->pff) ? true : false; }
 
@@ -1483,6 +1866,11 @@ int rmt_pff_modify(struct rmt *instance,
 { return is_rmt_pff_ok(instance) ? pff_modify(instance->pff, entries) : -1; }
 EXPORT_SYMBOL(rmt_pff_modify);
 
+int rmt_pff_update(struct rmt *instance,
+		   struct list_head *entries)
+{ return is_rmt_pff_ok(instance) ? pff_update(instance->pff, entries) : -1; }
+EXPORT_SYMBOL(rmt_pff_update);
+
 int rmt_ps_publish(struct ps_factory *factory)
 {
 	if (factory == NULL) {
@@ -72,6 +72,8 @@ struct n1_port_stats {
 	unsigned int tx_bytes;
 	unsigned int rx_pdus;
 	unsigned int rx_bytes;
+	unsigned int ka_tx_pdus;
+	unsigned int ka_down_events;
 };
 
 struct rmt_n1_port {
@@ -86,6 +88,12 @@ struct rmt_n1_port {
 	struct n1_port_stats	stats;
 	bool			wbusy;
 	void 			*rmt_ps_queues;
+	/* Keepalive monitor state, see rmt_keepalive_scan(). The ka_last_*
+	 * stamps are also written on rx/tx without the lock: use
+	 * READ_ONCE/WRITE_ONCE */
+	ktime_t			ka_last_rx;
+	ktime_t			ka_last_tx;
+	bool			ka_down;
 	struct robject		robj;
 };
 
@@ -102,6 +110,10 @@ int		   rmt_n1port_bind(struct rmt *instance,
 				   struct ipcp_instance *n1_ipcp);
 int		   rmt_n1port_unbind(struct rmt *instance,
 				     port_id_t id);
+int		   rmt_n1port_queue_len(struct rmt *instance,
+					port_id_t id);
+void		   rmt_n1port_drop_queued(struct rmt_n1_port *n1_port,
+					  struct du *du);
 int		   rmt_pff_add(struct rmt *instance,
 			       struct mod_pff_entry *entry);
 int		   rmt_pff_remove(struct rmt *instance,
@@ -114,6 +126,8 @@ int		   rmt_pff_dump(struct rmt *instance,
 int		   rmt_pff_flush(struct rmt *instance);
 int		   rmt_pff_modify(struct rmt *instance,
 				  struct list_head *entries);
+int		   rmt_pff_update(struct rmt *instance,
+				  struct list_head *entries);
 int		   rmt_send(struct rmt *instance,
 			    struct du * du);
 int		   rmt_send_port_id(struct rmt *instance,
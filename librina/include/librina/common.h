@@ -326,6 +326,7 @@ enum IPCEventType {
 	IPCM_DESTROY_IPCP_RESPONSE,
 	IPCM_FINALIZATION_REQUEST_EVENT,
 	IPCP_SCAN_MEDIA_REQUEST_EVENT,
+	IPCP_N1_PORT_LIVENESS_EVENT,
         NO_EVENT
 };
 
@@ -26,6 +26,7 @@
 #ifdef __cplusplus
 
 #include <pthread.h>
+#include <stdint.h>
 
 #include <list>
 #include <map>
@@ -346,10 +347,74 @@ BlockingFIFOQueue():ConditionVariable() { };
                 return result;
         }
 
+        /** Number of elements in the queue */
+        unsigned int size() {
+                unsigned int result;
+
+                lock();
+                result = queue.size();
+                unlock();
+
+                return result;
+        }
+
 private:
         std::list<T*> queue;
 };
 
+/**
+ * A minimal read-copy-update domain. Readers only increment and decrement
+ * a counter when entering and leaving a read section, so they never block
+ * (nor are blocked by) writers. Writers unlink the data they remove and
+ * then either wait for a grace period with synchronize(), after which no
+ * reader can be accessing it anymore, or retire() it, to be reclaimed
+ * by the next synchronize(). Read sections must not call synchronize().
+ */
+class RCUDomain : public NonCopyable {
+public:
+        RCUDomain();
+        ~RCUDomain() throw();
+
+        /// Enter a read section, returns the value to pass to read_unlock
+        int read_lock();
+        void read_unlock(int idx);
+
+        /// Wait until all the read sections in progress finish, and
+        /// reclaim the data retired before the call
+        void synchronize();
+
+        /// Hand ptr to the domain, reclaim(ptr) will be called after a
+        /// grace period
+        void retire(void * ptr, void (*reclaim)(void *));
+
+private:
+        void wait_for_readers(int idx);
+
+        Lockable lock_;
+        Lockable retired_lock_;
+        int epoch_;
+        long readers_[2];
+        std::list<std::pair<void *, void (*)(void *)> > retired_;
+};
+
+/**
+* RCU read section (RAII)
+*/
+class RCUReadScopedLock {
+public:
+RCUReadScopedLock(RCUDomain & rcu) :
+        rcu_(rcu)
+        { idx_ = rcu_.read_lock(); }
+
+        ~RCUReadScopedLock() throw() {
+                rcu_.read_unlock(idx_);
+        }
+
+private:
+        RCUDomain & rcu_;
+        int idx_;
+};
+
 /// Wrapper to sleep a thread
 class Sleep{
 public:
@@ -475,6 +540,260 @@ private:
         rina::Lockable * lock_;
 };
 
+
+/// Hash of the keys of a ConcurrentHashMap (integral keys). The stripe is
+/// selected by the low bits of the hash, so every bit of the key is mixed
+/// into them (finalizer of MurmurHash3)
+template <class K> struct ConcurrentHash {
+        uint32_t operator()(const K& key) const {
+                uint32_t hash = (uint32_t) key;
+
+                hash ^= hash >> 16;
+                hash *= 0x85ebca6bU;
+                hash ^= hash >> 13;
+                hash *= 0xc2b2ae35U;
+                hash ^= hash >> 16;
+
+                return hash;
+        }
+};
+
+/// Hash of the keys of a ConcurrentHashMap (FNV-1a for strings)
+template <> struct ConcurrentHash<std::string> {
+        uint32_t operator()(const std::string& key) const {
+                uint32_t hash = 2166136261U;
+
+                for (std::string::size_type i = 0; i < key.size(); i++) {
+                        hash ^= (unsigned char) key[i];
+                        hash *= 16777619U;
+                }
+
+                return hash;
+        }
+};
+
+/// A map of pointers with the same API as ThreadSafeMapOfPointers, but
+/// split in independently locked stripes (selected by the hash of the
+/// key) with read/write locks, so that lookups never block each other
+/// and writers only block the readers of their own stripe. Entries are
+/// not returned in key order.
+template <class K, class T, class H = ConcurrentHash<K> >
+class ConcurrentHashMap : public NonCopyable {
+public:
+        ConcurrentHashMap(unsigned int num_stripes = 16) {
+                unsigned int size = 1;
+
+                while (size < num_stripes)
+                        size <<= 1;
+
+                mask = size - 1;
+                stripes = new stripe[size];
+        };
+
+        ~ConcurrentHashMap() throw() {
+                delete[] stripes;
+        };
+
+        /// Insert element T* at position K
+        void put(K key, T* element) {
+                stripe & s = get_stripe(key);
+
+                rina::WriteScopedLock g(s.lock);
+                s.map[key] = element;
+        }
+
+        /// Insert element T* at position K, unless there is already an
+        /// element there
+        /// @return the existing element, or 0 if element was inserted
+        T* put_if_absent(K key, T* element) {
+                typename std::map<K, T*>::iterator iterator;
+                stripe & s = get_stripe(key);
+
+                rina::WriteScopedLock g(s.lock);
+                iterator = s.map.find(key);
+                if (iterator != s.map.end())
+                        return iterator->second;
+
+                s.map[key] = element;
+                return 0;
+        }
+
+        /// Get element at position K (returns 0 if k is unknown). The
+        /// element may be erased and deleted concurrently, use find_copy
+        /// if this can happen
+        T* find(K key) {
+                typename std::map<K, T*>::iterator iterator;
+                stripe & s = get_stripe(key);
+
+                rina::ReadScopedLock g(s.lock);
+                iterator = s.map.find(key);
+                if (iterator == s.map.end())
+                        return 0;
+
+                return iterator->second;
+        }
+
+        /// Copy the element at position K while holding the lock of its
+        /// stripe
+        /// @return false if K is unknown
+        bool find_copy(K key, T& result) {
+                typename std::map<K, T*>::iterator iterator;
+                stripe & s = get_stripe(key);
+
+                rina::ReadScopedLock g(s.lock);
+                iterator = s.map.find(key);
+                if (iterator == s.map.end())
+                        return false;
+
+                result = *iterator->second;
+                return true;
+        }
+
+        /// Get element at position K and call its get() method while
+        /// holding the lock of its stripe, so that a concurrent erase
+        /// cannot free it before the caller drops that reference
+        /// @return 0 if K is unknown
+        T* find_get(K key) {
+                typename std::map<K, T*>::iterator iterator;
+                stripe & s = get_stripe(key);
+
+                rina::ReadScopedLock g(s.lock);
+                iterator = s.map.find(key);
+                if (iterator == s.map.end())
+                        return 0;
+
+                iterator->second->get();
+                return iterator->second;
+        }
+
+        /// Remove element at position K (returns 0 if k
+        /// is unknown, or the erased element othewise
+        T* erase(K key) {
+                typename std::map<K, T*>::iterator iterator;
+                stripe & s = get_stripe(key);
+                T* result;
+
+                rina::WriteScopedLock g(s.lock);
+                iterator = s.map.find(key);
+                if (iterator == s.map.end())
+                        return 0;
+
+                result = iterator->second;
+                s.map.erase(iterator);
+
+                return result;
+        }
+
+        /// Remove element at position K only if pred(element) is true,
+        /// checked while holding the lock of its stripe
+        /// @return the erased element, or 0 if K is unknown (found is
+        /// false) or pred is false (found is true)
+        template <class P>
+        T* erase_if(K key, P pred, bool& found) {
+                typename std::map<K, T*>::iterator iterator;
+                stripe & s = get_stripe(key);
+                T* result;
+
+                rina::WriteScopedLock g(s.lock);
+                iterator = s.map.find(key);
+                found = iterator != s.map.end();
+                if (!found || !pred(iterator->second))
+                        return 0;
+
+                result = iterator->second;
+                s.map.erase(iterator);
+
+                return result;
+        }
+
+        /// Returns the list of entries in the map
+        std::list<T*> getEntries() {
+                typename std::map<K, T*>::const_iterator iterator;
+                std::list<T*> result;
+
+                for (unsigned int i = 0; i <= mask; i++) {
+                        rina::ReadScopedLock g(stripes[i].lock);
+                        for (iterator = stripes[i].map.begin();
+                                        iterator != stripes[i].map.end();
+                                        ++iterator)
+                                result.push_back(iterator->second);
+                }
+
+                return result;
+        }
+
+        /// Returns a copy of the entries in the map
+        std::list<T> getCopyofentries() {
+                typename std::map<K, T*>::const_iterator iterator;
+                std::list<T> result;
+
+                for (unsigned int i = 0; i <= mask; i++) {
+                        rina::ReadScopedLock g(stripes[i].lock);
+                        for (iterator = stripes[i].map.begin();
+                                        iterator != stripes[i].map.end();
+                                        ++iterator)
+                                result.push_back(*iterator->second);
+                }
+
+                return result;
+        }
+
+        std::list<K> getKeys() {
+                typename std::map<K, T*>::const_iterator iterator;
+                std::list<K> result;
+
+                for (unsigned int i = 0; i <= mask; i++) {
+                        rina::ReadScopedLock g(stripes[i].lock);
+                        for (iterator = stripes[i].map.begin();
+                                        iterator != stripes[i].map.end();
+                                        ++iterator)
+                                result.push_back(iterator->first);
+                }
+
+                return result;
+        }
+
+        unsigned int size() {
+                unsigned int result = 0;
+
+                for (unsigned int i = 0; i <= mask; i++) {
+                        rina::ReadScopedLock g(stripes[i].lock);
+                        result += stripes[i].map.size();
+                }
+
+                return result;
+        }
+
+        /// Delete all the values of the map and empty it
+        void deleteValues() {
+                typename std::map<K, T*>::const_iterator iterator;
+
+                for (unsigned int i = 0; i <= mask; i++) {
+                        rina::WriteScopedLock g(stripes[i].lock);
+                        for (iterator = stripes[i].map.begin();
+                                        iterator != stripes[i].map.end();
+                                        ++iterator)
+                                if (iterator->second)
+                                        delete iterator->second;
+                        stripes[i].map.clear();
+                }
+        }
+
+private:
+        struct stripe {
+                rina::ReadWriteLockable lock;
+                std::map<K, T*> map;
+        };
+
+        stripe & get_stripe(const K& key) {
+                return stripes[hash(key) & mask];
+        }
+
+        stripe * stripes;
+        uint32_t mask;
+        H hash;
+};
+
 }
 
 #endif
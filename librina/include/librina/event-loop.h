@@ -0,0 +1,132 @@
+/*
+ * Event loop
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA  02110-1301  USA
+ */
+
+#ifndef LIBRINA_EVENT_LOOP_H
+#define LIBRINA_EVENT_LOOP_H
+
+#ifdef __cplusplus
+
+#include <stdint.h>
+#include <sys/epoll.h>
+
+#include <list>
+#include <map>
+#include <string>
+
+#include "librina/concurrency.h"
+
+namespace rina {
+
+/// Interface for the handlers of file descriptors registered in
+/// an EventLoop
+class EventHandler {
+public:
+	virtual ~EventHandler() {};
+
+	/// Invoked by one of the workers of the loop when fd is ready.
+	/// events contains the epoll flags reported (EPOLLIN, EPOLLHUP, ...)
+	/// @return false if fd has to be unregistered from the loop
+	virtual bool handle_event(int fd, uint32_t events) = 0;
+};
+
+class EventLoopWorker;
+
+/// Multiplexes file descriptors (flows, the control fd, timerfds and
+/// eventfds) over a single epoll instance, and dispatches the ready ones
+/// to their handlers using a small pool of worker threads. A file
+/// descriptor is never dispatched to more than one worker at a time, so
+/// handlers of a single fd need no extra serialization.
+class EventLoop : public ConditionVariable {
+public:
+	EventLoop(const std::string& name, unsigned int num_workers);
+	~EventLoop() throw();
+
+	/// Start the workers
+	void start();
+
+	/// Stop the workers and wait for them to finish. Registered file
+	/// descriptors are not closed.
+	void stop();
+
+	/// Start monitoring fd for the requested epoll events
+	void add_fd(int fd, EventHandler * handler, uint32_t events = EPOLLIN);
+
+	/// Stop monitoring fd (the fd is not closed). When this call
+	/// returns the handler is not running and it will not be invoked
+	/// again, so it can be safely deleted. If called from the handler
+	/// of fd itself, it just prevents further invocations.
+	void remove_fd(int fd);
+
+	/// Create a timer that will fire after initial_ms milliseconds and
+	/// then every period_ms milliseconds (0 for a one-shot timer).
+	/// @return the timer file descriptor
+	int add_timer(EventHandler * handler, long initial_ms, long period_ms);
+
+	/// Create an event file descriptor that will invoke the handler
+	/// every time someone calls notify() on it
+	/// @return the event file descriptor
+	int add_notifier(EventHandler * handler);
+
+	/// Wake up the handler of a notifier created with add_notifier()
+	static void notify(int efd);
+
+	/// Unregister a timer or notifier and close its file descriptor
+	void remove_and_close(int fd);
+
+	/// Number of file descriptors currently registered
+	unsigned int get_num_fds();
+
+	/// Main function of each worker thread
+	void run_worker();
+
+private:
+	enum fd_kind {
+		FD_PLAIN,
+		FD_COUNTER,
+	};
+
+	struct fd_entry {
+		EventHandler * handler;
+		uint32_t events;
+		enum fd_kind kind;
+		uint32_t id;
+		bool busy;
+		bool removed;
+		pthread_t worker;
+	};
+
+	void __add_fd(int fd, EventHandler * handler,
+		      uint32_t events, enum fd_kind kind);
+	void dispatch(uint64_t data, uint32_t events);
+
+	std::string name;
+	unsigned int num_workers;
+	int epfd;
+	int stop_fd;
+	bool running;
+	uint32_t next_id;
+	std::map<int, fd_entry *> fds;
+	std::list<EventLoopWorker *> workers;
+};
+
+}
+
+#endif
+
+#endif
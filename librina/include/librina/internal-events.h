@@ -90,7 +90,8 @@ public:
 
 class SimpleInternalEventManager: public InternalEventManager {
 public:
-	SimpleInternalEventManager() { };
+	SimpleInternalEventManager() : deliveries_(0) { };
+	~SimpleInternalEventManager();
 		void set_application_process(ApplicationProcess * ap);
         void subscribeToEvent(const std::string& type,
         		      InternalEventListener * eventListener);
@@ -99,8 +100,24 @@ public:
         void deliverEvent(InternalEvent * event);
 
 private:
-        std::map<std::string, std::list<InternalEventListener *> > event_listeners_;
+        typedef std::list<InternalEventListener *> listeners_t;
+
+        /// Listener lists are never modified once published: subscribers
+        /// replace them with an updated copy, so that deliverEvent can
+        /// iterate them without holding any lock. Replaced lists are
+        /// retired, and freed once no delivery is in progress.
+        ConcurrentHashMap<std::string, listeners_t> event_listeners_;
+        std::list<listeners_t *> retired_listeners_;
+
+        /// Calls to deliverEvent in progress, updated atomically
+        int deliveries_;
+
+        /// Serializes subscribers, and protects retired_listeners_
         rina::Lockable events_lock_;
+
+        /// Free the retired lists if no delivery can be iterating them,
+        /// called with events_lock_ held
+        void reclaimRetiredListeners();
 };
 
 /// Event that signals that an N-1 flow allocation failed
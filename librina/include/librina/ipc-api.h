@@ -212,7 +212,7 @@ public:
 class IPCManager {
 
 	/** The flows that are pending to be allocated or deallocated*/
-	std::map<unsigned int, FlowInformation*> pendingFlows;
+	ConcurrentHashMap<unsigned int, FlowInformation> pendingFlows;
 
 	/** The applications that are pending to be registered or unregistered */
 	std::map<unsigned int, ApplicationRegistrationInformation>
@@ -224,15 +224,15 @@ class IPCManager {
 
 protected:
 	/** The flows that are currently allocated */
-	std::map<int, FlowInformation*> allocatedFlows;
+	ConcurrentHashMap<int, FlowInformation> allocatedFlows;
 
-	ReadWriteLockable flows_rw_lock;
 	ReadWriteLockable regs_rw_lock;
 
-	/** Return the pending flow at sequenceNumber */
-	FlowInformation * getPendingFlow(unsigned int seqNumber);
+	/** Copy the pending flow at sequenceNumber, false if there is none */
+	bool getPendingFlow(unsigned int seqNumber, FlowInformation& flow);
 
-	FlowInformation * getAllocatedFlow(int portId);
+	/** Copy the allocated flow at portId, false if there is none */
+	bool getAllocatedFlow(int portId, FlowInformation& flow);
 
 	/** Return the information of a registration request */
 	ApplicationRegistrationInformation getRegistrationInfo(unsigned int seqNumber);
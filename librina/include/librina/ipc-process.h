@@ -1045,6 +1045,22 @@ public:
         unsigned int port_id;
 };
 
+/**
+ * The kernel keepalive monitor detected that an N-1 port stopped
+ * (or resumed) receiving PDUs from the neighbor
+ */
+class NMinusOnePortLivenessEvent: public IPCEvent {
+public:
+	NMinusOnePortLivenessEvent(unsigned int port_id, bool alive,
+				   unsigned int ctrl_p,
+				   unsigned short ipcp_id);
+
+	unsigned int port_id;
+
+	/// False if the neighbor was declared dead
+	bool alive;
+};
+
 /**
  * FIXME: Quick hack to get multiple parameters back
  */
@@ -1154,7 +1170,10 @@ public:
         /**
          * Modify the entries of the PDU forwarding table
          * @param entries to be modified
-         * @param mode 0 add, 1 remove, 2 flush and add
+         * @param mode 0 add, 1 remove, 2 flush and add, 3 update: each
+         * entry replaces the one with the same address and qos-id (or is
+         * added), entries without port-ids remove it. Modes 2 and 3 are
+         * applied atomically by the kernel
          */
         void modifyPDUForwardingTableEntries(const std::list<PDUForwardingTableEntry *>& entries,
                         int mode);
@@ -220,7 +220,17 @@ public:
 	///
 	RIBObj(const std::string& class_) : delegates(false),
 					  parent_inst_id(-1),
-					  class_name(class_){};
+					  class_name(class_),
+					  rib(NULL),
+					  inst_id(-1),
+					  parent(NULL),
+					  first_child(NULL),
+					  last_child(NULL),
+					  next_sibling(NULL),
+					  prev_sibling(NULL),
+					  num_children(0),
+					  refs(1),
+					  unlinked(false){};
 
 	/// Fully qualified name
 	std::string fqn;
@@ -442,6 +452,23 @@ protected:
 
 	RIB *rib;
 
+	//@internal Tree linkage, owned by the RIB. Readers walk it without
+	//locks (see RIB), writers modify it holding the subtree lock
+	int64_t inst_id;
+	RIBObj *parent;
+	RIBObj *first_child;
+	RIBObj *last_child;
+	RIBObj *next_sibling;
+	RIBObj *prev_sibling;
+	unsigned int num_children;
+
+	//@internal References held by the RIB and by in-flight operations;
+	//the object is deleted when the last one is released
+	int refs;
+
+	//@internal Set when the object is removed from the tree
+	bool unlinked;
+
 	//Them too; promiscuous?
 	friend class RIB;
 };
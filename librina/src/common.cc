@@ -624,6 +624,10 @@ const std::string IPCEvent::eventTypeToString(IPCEventType eventType) {
 		break;
 	case IPCP_SCAN_MEDIA_REQUEST_EVENT:
 		result = "52_IPCP_SCAN_MEDIA_REQUEST_EVENT";
+		break;
+	case IPCP_N1_PORT_LIVENESS_EVENT:
+		result = "53_IPCP_N1_PORT_LIVENESS_EVENT";
+		break;
 	case NO_EVENT:
 		result = "55_NO_EVENT";
 		break;
@@ -22,6 +22,7 @@
 
 #include <cerrno>
 #include <pthread.h>
+#include <sched.h>
 #include <unistd.h>
 
 #define RINA_PREFIX "librina.concurrency"
@@ -469,6 +470,81 @@ void ConditionVariable::timedwait(long seconds, long nanoseconds){
 			ConcurrentException::error_wait_cond);
 }
 
+/* CLASS RCU DOMAIN */
+RCUDomain::RCUDomain() : epoch_(0)
+{
+	readers_[0] = readers_[1] = 0;
+}
+
+RCUDomain::~RCUDomain() throw()
+{
+	std::list<std::pair<void *, void (*)(void *)> >::iterator it;
+
+	for (it = retired_.begin(); it != retired_.end(); ++it)
+		it->second(it->first);
+}
+
+int RCUDomain::read_lock()
+{
+	int idx = __atomic_load_n(&epoch_, __ATOMIC_ACQUIRE) & 1;
+
+	/* The (sequentially consistent) increment orders the reads of the
+	 * section after it */
+	__atomic_add_fetch(&readers_[idx], 1, __ATOMIC_SEQ_CST);
+
+	return idx;
+}
+
+void RCUDomain::read_unlock(int idx)
+{
+	__atomic_sub_fetch(&readers_[idx], 1, __ATOMIC_SEQ_CST);
+}
+
+void RCUDomain::wait_for_readers(int idx)
+{
+	int spins = 0;
+
+	while (__atomic_load_n(&readers_[idx], __ATOMIC_SEQ_CST)) {
+		if (++spins < 100)
+			sched_yield();
+		else
+			usleep(100);
+	}
+}
+
+void RCUDomain::synchronize()
+{
+	std::list<std::pair<void *, void (*)(void *)> > reclaim;
+	std::list<std::pair<void *, void (*)(void *)> >::iterator it;
+	int idx;
+
+	ScopedLock g(lock_);
+
+	retired_lock_.lock();
+	reclaim.swap(retired_);
+	retired_lock_.unlock();
+
+	/* Send new readers to the other counter and wait for the ones in
+	 * the old one, twice, so that both counters are drained once. A
+	 * reader that reads the epoch before a flip but increments the
+	 * counter after the wait started the section after the data was
+	 * unlinked, so it cannot see it */
+	for (int i = 0; i < 2; i++) {
+		idx = __atomic_fetch_add(&epoch_, 1, __ATOMIC_SEQ_CST) & 1;
+		wait_for_readers(idx);
+	}
+
+	for (it = reclaim.begin(); it != reclaim.end(); ++it)
+		it->second(it->first);
+}
+
+void RCUDomain::retire(void * ptr, void (*reclaim)(void *))
+{
+	ScopedLock g(retired_lock_);
+
+	retired_.push_back(std::make_pair(ptr, reclaim));
+}
+
 // Class Sleep
 bool Sleep::sleep(int sec, int milisec) {
 	return usleep(sec * 1000000 + milisec * 1000);
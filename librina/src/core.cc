@@ -415,6 +415,15 @@ IPCEvent * IRATICtrlManager::irati_ctrl_msg_to_ipc_event(struct irati_msg_base *
 						     msg->src_port, msg->src_ipcp_id);
 		break;
 	}
+	case RINA_C_IPCP_N1_PORT_LIVENESS_NOTIF: {
+		struct irati_kmsg_multi_msg * sp_msg =
+				(struct irati_kmsg_multi_msg *) msg;
+		event = new NMinusOnePortLivenessEvent(sp_msg->port_id,
+						       sp_msg->result != 0,
+						       msg->src_port,
+						       msg->src_ipcp_id);
+		break;
+	}
 	case RINA_C_IPCM_CREATE_IPCP_RESPONSE: {
 		struct irati_msg_base_resp * sp_msg =
 				(struct irati_msg_base_resp *) msg;
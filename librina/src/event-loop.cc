@@ -0,0 +1,422 @@
+//
+// Event loop
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+// MA  02110-1301  USA
+//
+
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+
+#define RINA_PREFIX "librina.event-loop"
+
+#include "librina/event-loop.h"
+#include "librina/logs.h"
+
+namespace rina {
+
+#define EVENT_LOOP_MAX_EVENTS 32
+
+/* Epoll user data packs the registration id with the fd, so that stale
+ * events of a closed (and reused) fd are not delivered to a new handler */
+#define EVENT_LOOP_DATA(id, fd) ((((uint64_t) (id)) << 32) | (uint32_t) (fd))
+#define EVENT_LOOP_DATA_FD(data) ((int) ((data) & 0xFFFFFFFF))
+#define EVENT_LOOP_DATA_ID(data) ((uint32_t) ((data) >> 32))
+
+/* Class EventLoopWorker */
+class EventLoopWorker : public SimpleThread {
+public:
+	EventLoopWorker(EventLoop * el, const std::string& name) :
+		SimpleThread(name, false), loop(el) { };
+	~EventLoopWorker() throw() { };
+
+	int run()
+	{
+		loop->run_worker();
+		return 0;
+	}
+
+private:
+	EventLoop * loop;
+};
+
+/* Class EventLoop */
+EventLoop::EventLoop(const std::string& nm, unsigned int nworkers)
+{
+	struct epoll_event ev;
+
+	name = nm;
+	num_workers = nworkers > 0 ? nworkers : 1;
+	running = false;
+	next_id = 0;
+
+	epfd = epoll_create1(EPOLL_CLOEXEC);
+	if (epfd < 0) {
+		LOG_CRIT("Cannot create epoll instance: %s", strerror(errno));
+		throw Exception("Cannot create epoll instance");
+	}
+
+	stop_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (stop_fd < 0) {
+		LOG_CRIT("Cannot create eventfd: %s", strerror(errno));
+		close(epfd);
+		throw Exception("Cannot create eventfd");
+	}
+
+	/* Level triggered, so that once stop() writes to it every worker
+	 * wakes up and exits; stop() drains it when all of them are gone */
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.u64 = EVENT_LOOP_DATA(0, stop_fd);
+	if (epoll_ctl(epfd, EPOLL_CTL_ADD, stop_fd, &ev)) {
+		LOG_CRIT("Cannot add eventfd to epoll: %s", strerror(errno));
+		close(stop_fd);
+		close(epfd);
+		throw Exception("Cannot add eventfd to epoll");
+	}
+}
+
+EventLoop::~EventLoop() throw()
+{
+	std::map<int, fd_entry *>::iterator it;
+
+	stop();
+
+	for (it = fds.begin(); it != fds.end(); ++it)
+		delete it->second;
+	fds.clear();
+
+	close(stop_fd);
+	close(epfd);
+}
+
+void EventLoop::start()
+{
+	EventLoopWorker * worker;
+	std::stringstream ss;
+
+	lock();
+	if (running) {
+		unlock();
+		return;
+	}
+	running = true;
+	unlock();
+
+	for (unsigned int i = 0; i < num_workers; i++) {
+		ss.str("");
+		ss << name << "-" << i;
+		worker = new EventLoopWorker(this, ss.str());
+		worker->start();
+		workers.push_back(worker);
+	}
+
+	LOG_DBG("Event loop %s started with %u workers",
+		name.c_str(), num_workers);
+}
+
+void EventLoop::stop()
+{
+	std::list<EventLoopWorker *>::iterator it;
+	uint64_t val = 1;
+	void * status;
+
+	lock();
+	if (!running) {
+		unlock();
+		return;
+	}
+	running = false;
+	unlock();
+
+	if (write(stop_fd, &val, sizeof(val)) != sizeof(val))
+		LOG_ERR("Problems waking up event loop %s workers: %s",
+			name.c_str(), strerror(errno));
+
+	for (it = workers.begin(); it != workers.end(); ++it) {
+		(*it)->join(&status);
+		delete *it;
+	}
+	workers.clear();
+
+	/* Reset the stop event, so that the loop can be started again */
+	if (read(stop_fd, &val, sizeof(val)) < 0 && errno != EAGAIN)
+		LOG_ERR("Problems draining the stop event of loop %s: %s",
+			name.c_str(), strerror(errno));
+
+	LOG_DBG("Event loop %s stopped", name.c_str());
+}
+
+void EventLoop::__add_fd(int fd, EventHandler * handler,
+			 uint32_t events, enum fd_kind kind)
+{
+	struct epoll_event ev;
+	fd_entry * entry;
+
+	if (fd < 0 || !handler)
+		throw Exception("Bogus file descriptor or handler");
+
+	ScopedLock g(*this);
+
+	if (fds.find(fd) != fds.end()) {
+		LOG_ERR("File descriptor %d already registered in loop %s",
+			fd, name.c_str());
+		throw Exception("File descriptor already registered");
+	}
+
+	entry = new fd_entry();
+	entry->handler = handler;
+	entry->events = events;
+	entry->kind = kind;
+	entry->id = ++next_id;
+	entry->busy = false;
+	entry->removed = false;
+
+	memset(&ev, 0, sizeof(ev));
+	ev.events = events | EPOLLONESHOT;
+	ev.data.u64 = EVENT_LOOP_DATA(entry->id, fd);
+	if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev)) {
+		LOG_ERR("Cannot add fd %d to loop %s: %s",
+			fd, name.c_str(), strerror(errno));
+		delete entry;
+		throw Exception("Cannot add file descriptor to epoll");
+	}
+
+	fds[fd] = entry;
+}
+
+void EventLoop::add_fd(int fd, EventHandler * handler, uint32_t events)
+{
+	__add_fd(fd, handler, events, FD_PLAIN);
+}
+
+void EventLoop::remove_fd(int fd)
+{
+	std::map<int, fd_entry *>::iterator it;
+	fd_entry * entry;
+	uint32_t id;
+
+	ScopedLock g(*this);
+
+	it = fds.find(fd);
+	if (it == fds.end())
+		return;
+
+	entry = it->second;
+	id = entry->id;
+	if (!entry->removed) {
+		epoll_ctl(epfd, EPOLL_CTL_DEL, fd, NULL);
+		entry->removed = true;
+	}
+
+	if (!entry->busy) {
+		fds.erase(it);
+		delete entry;
+		return;
+	}
+
+	/* Called from the handler itself, the worker will free the entry
+	 * when the handler returns */
+	if (pthread_equal(entry->worker, pthread_self()))
+		return;
+
+	/* Wait for the worker running the handler to free the entry */
+	for (;;) {
+		doWait();
+		it = fds.find(fd);
+		if (it == fds.end() || it->second->id != id)
+			break;
+	}
+}
+
+int EventLoop::add_timer(EventHandler * handler, long initial_ms,
+			 long period_ms)
+{
+	struct itimerspec its;
+	int fd;
+
+	fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (fd < 0) {
+		LOG_ERR("Cannot create timerfd: %s", strerror(errno));
+		throw Exception("Cannot create timerfd");
+	}
+
+	/* An all-zero it_value would disarm the timer */
+	if (initial_ms <= 0)
+		initial_ms = 1;
+
+	memset(&its, 0, sizeof(its));
+	its.it_value.tv_sec = initial_ms / 1000;
+	its.it_value.tv_nsec = (initial_ms % 1000) * 1000000;
+	its.it_interval.tv_sec = period_ms / 1000;
+	its.it_interval.tv_nsec = (period_ms % 1000) * 1000000;
+
+	try {
+		__add_fd(fd, handler, EPOLLIN, FD_COUNTER);
+	} catch (Exception &e) {
+		close(fd);
+		throw;
+	}
+
+	if (timerfd_settime(fd, 0, &its, NULL)) {
+		LOG_ERR("Cannot arm timerfd: %s", strerror(errno));
+		remove_and_close(fd);
+		throw Exception("Cannot arm timerfd");
+	}
+
+	return fd;
+}
+
+int EventLoop::add_notifier(EventHandler * handler)
+{
+	int fd;
+
+	fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (fd < 0) {
+		LOG_ERR("Cannot create eventfd: %s", strerror(errno));
+		throw Exception("Cannot create eventfd");
+	}
+
+	try {
+		__add_fd(fd, handler, EPOLLIN, FD_COUNTER);
+	} catch (Exception &e) {
+		close(fd);
+		throw;
+	}
+
+	return fd;
+}
+
+void EventLoop::notify(int efd)
+{
+	uint64_t val = 1;
+
+	if (write(efd, &val, sizeof(val)) != sizeof(val))
+		LOG_ERR("Problems notifying eventfd %d: %s",
+			efd, strerror(errno));
+}
+
+void EventLoop::remove_and_close(int fd)
+{
+	remove_fd(fd);
+	close(fd);
+}
+
+unsigned int EventLoop::get_num_fds()
+{
+	ScopedLock g(*this);
+	return fds.size();
+}
+
+void EventLoop::dispatch(uint64_t data, uint32_t events)
+{
+	std::map<int, fd_entry *>::iterator it;
+	struct epoll_event ev;
+	EventHandler * handler;
+	fd_entry * entry;
+	uint64_t counter;
+	bool keep = true;
+	int fd;
+
+	fd = EVENT_LOOP_DATA_FD(data);
+
+	lock();
+	it = fds.find(fd);
+	if (it == fds.end() || it->second->id != EVENT_LOOP_DATA_ID(data)
+			|| it->second->removed) {
+		unlock();
+		return;
+	}
+
+	entry = it->second;
+	entry->busy = true;
+	entry->worker = pthread_self();
+	handler = entry->handler;
+	unlock();
+
+	/* Timers and notifiers are drained before calling the handler */
+	if (entry->kind == FD_COUNTER &&
+			read(fd, &counter, sizeof(counter)) < 0 &&
+			errno == EAGAIN)
+		events = 0;
+
+	if (events) {
+		try {
+			keep = handler->handle_event(fd, events);
+		} catch (std::exception &e) {
+			LOG_ERR("Handler of fd %d threw an exception: %s",
+				fd, e.what());
+		} catch (...) {
+			LOG_ERR("Handler of fd %d threw an unknown exception",
+				fd);
+		}
+	}
+
+	lock();
+	entry->busy = false;
+	if (!keep && !entry->removed) {
+		epoll_ctl(epfd, EPOLL_CTL_DEL, fd, NULL);
+		entry->removed = true;
+	}
+
+	if (entry->removed) {
+		fds.erase(fd);
+		delete entry;
+		broadcast();
+	} else {
+		memset(&ev, 0, sizeof(ev));
+		ev.events = entry->events | EPOLLONESHOT;
+		ev.data.u64 = data;
+		if (epoll_ctl(epfd, EPOLL_CTL_MOD, fd, &ev))
+			LOG_ERR("Cannot rearm fd %d in loop %s: %s",
+				fd, name.c_str(), strerror(errno));
+	}
+	unlock();
+}
+
+void EventLoop::run_worker()
+{
+	struct epoll_event events[EVENT_LOOP_MAX_EVENTS];
+	bool stopped = false;
+	int n;
+
+	while (!stopped) {
+		n = epoll_wait(epfd, events, EVENT_LOOP_MAX_EVENTS, -1);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+
+			LOG_ERR("Problems waiting for events in loop %s: %s",
+				name.c_str(), strerror(errno));
+			break;
+		}
+
+		for (int i = 0; i < n; i++) {
+			if (EVENT_LOOP_DATA_FD(events[i].data.u64) == stop_fd
+					&& EVENT_LOOP_DATA_ID(events[i].data.u64) == 0) {
+				stopped = true;
+				continue;
+			}
+
+			dispatch(events[i].data.u64, events[i].events);
+		}
+	}
+}
+
+}
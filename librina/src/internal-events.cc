@@ -47,82 +47,123 @@ void SimpleInternalEventManager::set_application_process(ApplicationProcess * ap
 void SimpleInternalEventManager::subscribeToEvent(const std::string& type,
                                      	 	  InternalEventListener * eventListener)
 {
+        listeners_t * current;
+        listeners_t * updated;
+        listeners_t::iterator listIterator;
+
         if (!eventListener)
                 return;
 
-        events_lock_.lock();
+        ScopedLock g(events_lock_);
 
-        std::map<std::string, std::list<InternalEventListener*> >::iterator it =
-        		event_listeners_.find(type);
-        if (it == event_listeners_.end()) {
-                std::list<InternalEventListener *> listenersList;
-                listenersList.push_back(eventListener);
-                event_listeners_[type] = listenersList;
-        } else {
-                std::list<InternalEventListener *>::iterator listIterator;
-                for (listIterator=it->second.begin(); listIterator != it->second.end(); ++listIterator) {
-                        if (*listIterator == eventListener) {
-                                events_lock_.unlock();
+        current = event_listeners_.find(type);
+        if (current) {
+                for (listIterator = current->begin();
+                                listIterator != current->end(); ++listIterator) {
+                        if (*listIterator == eventListener)
                                 return;
-                        }
                 }
 
-                it->second.push_back(eventListener);
+                updated = new listeners_t(*current);
+                retired_listeners_.push_back(current);
+        } else {
+                updated = new listeners_t();
         }
 
+        updated->push_back(eventListener);
+        event_listeners_.put(type, updated);
+        reclaimRetiredListeners();
+
         LOG_INFO("EventListener subscribed to event %s", type.c_str());
-        events_lock_.unlock();
 }
 
 void SimpleInternalEventManager::unsubscribeFromEvent(const std::string& type,
                                          	      InternalEventListener * eventListener)
 {
+        listeners_t * current;
+        listeners_t * updated;
+
         if (!eventListener)
                 return;
 
-        events_lock_.lock();
-        std::map<std::string, std::list<InternalEventListener*> >::iterator it =
-        		event_listeners_.find(type);
-        if (it == event_listeners_.end()) {
-                events_lock_.unlock();
+        ScopedLock g(events_lock_);
+
+        current = event_listeners_.find(type);
+        if (!current)
                 return;
-        }
 
-        it->second.remove(eventListener);
-        if (it->second.size() == 0) {
-                event_listeners_.erase(it);
+        updated = new listeners_t(*current);
+        updated->remove(eventListener);
+        if (updated->size() == 0) {
+                event_listeners_.erase(type);
+                delete updated;
+        } else {
+                event_listeners_.put(type, updated);
         }
+        retired_listeners_.push_back(current);
+        reclaimRetiredListeners();
 
         LOG_INFO("EventListener unsubscribed from event %s", type.c_str());
-        events_lock_.unlock();
 }
 
 void SimpleInternalEventManager::deliverEvent(InternalEvent * event)
 {
+        listeners_t * listeners;
+        listeners_t::iterator listIterator;
+
         if (!event)
                 return;
 
         LOG_INFO("Event %s has just happened. Notifying event listeners.",
                        event->type.c_str());
 
-        events_lock_.lock();
-        std::map<std::string, std::list<InternalEventListener*> >::iterator it =
-        		event_listeners_.find(event->type);
-        if (it == event_listeners_.end()) {
-                events_lock_.unlock();
-                delete event;
-                return;
+        __atomic_add_fetch(&deliveries_, 1, __ATOMIC_SEQ_CST);
+        listeners = event_listeners_.find(event->type);
+        if (listeners) {
+                for (listIterator = listeners->begin();
+                                listIterator != listeners->end(); ++listIterator) {
+                        (*listIterator)->eventHappened(event);
+                }
         }
 
-        events_lock_.unlock();
-        std::list<InternalEventListener *>::iterator listIterator;
-        for (listIterator=it->second.begin(); listIterator != it->second.end(); ++listIterator) {
-                (*listIterator)->eventHappened(event);
+        //The last delivery frees the lists retired while it was running
+        if (__atomic_sub_fetch(&deliveries_, 1, __ATOMIC_SEQ_CST) == 0 &&
+                        events_lock_.trylock()) {
+                reclaimRetiredListeners();
+                events_lock_.unlock();
         }
 
-        if (event) {
-                delete event;
-        }
+        delete event;
+}
+
+void SimpleInternalEventManager::reclaimRetiredListeners()
+{
+        std::list<listeners_t *>::iterator it;
+
+        if (retired_listeners_.empty())
+                return;
+
+        //A delivery that found a list before it was replaced may still
+        //be iterating it
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&deliveries_, __ATOMIC_SEQ_CST) != 0)
+                return;
+
+        for (it = retired_listeners_.begin();
+                        it != retired_listeners_.end(); ++it)
+                delete *it;
+        retired_listeners_.clear();
+}
+
+SimpleInternalEventManager::~SimpleInternalEventManager()
+{
+        std::list<listeners_t *>::iterator it;
+
+        event_listeners_.deleteValues();
+
+        for (it = retired_listeners_.begin();
+                        it != retired_listeners_.end(); ++it)
+                delete *it;
 }
 
 //CLASS NMinusOneFlowAllocationFailedEvent
@@ -83,57 +83,37 @@ const std::string IPCManager::error_getting_dif_properties =
 const std::string IPCManager::wrong_flow_state  =
                 "Wrong flow state";
 
-FlowInformation * IPCManager::getPendingFlow(unsigned int seqNumber)
+bool IPCManager::getPendingFlow(unsigned int seqNumber,
+				FlowInformation& flow)
 {
-        std::map<unsigned int, FlowInformation*>::iterator iterator;
-
-        iterator = pendingFlows.find(seqNumber);
-        if (iterator == pendingFlows.end()) {
-                return 0;
-        }
-
-        return iterator->second;
+        return pendingFlows.find_copy(seqNumber, flow);
 }
 
-FlowInformation * IPCManager::getAllocatedFlow(int portId)
+bool IPCManager::getAllocatedFlow(int portId, FlowInformation& flow)
 {
-        std::map<int, FlowInformation*>::iterator iterator;
-
-        iterator = allocatedFlows.find(portId);
-        if (iterator == allocatedFlows.end()) {
-                return 0;
-        }
-
-        return iterator->second;
+        return allocatedFlows.find_copy(portId, flow);
 }
 
 FlowInformation IPCManager::getFlowInformation(int portId)
 {
-        std::map<int, FlowInformation*>::iterator iterator;
-        FlowInformation * flowInformation;
+        FlowInformation flowInformation;
 
-        ReadScopedLock readLock(flows_rw_lock);
-
-        iterator = allocatedFlows.find(portId);
-        if (iterator == allocatedFlows.end()) {
+        if (!allocatedFlows.find_copy(portId, flowInformation)) {
                 throw UnknownFlowException();
         }
 
-        flowInformation = iterator->second;
-        return *flowInformation;
+        return flowInformation;
 }
 
 int IPCManager::getPortIdToRemoteApp(const ApplicationProcessNamingInformation& remoteAppName)
 {
-        std::map<int, FlowInformation*>::iterator iterator;
-
-        ReadScopedLock readLock(flows_rw_lock);
+        std::list<FlowInformation> flows;
+        std::list<FlowInformation>::iterator iterator;
 
-        for(iterator = allocatedFlows.begin();
-	    iterator != allocatedFlows.end();
-	    ++iterator) {
-                if (iterator->second->remoteAppName == remoteAppName) {
-                        return iterator->second->portId;
+        flows = allocatedFlows.getCopyofentries();
+        for(iterator = flows.begin(); iterator != flows.end(); ++iterator) {
+                if (iterator->remoteAppName == remoteAppName) {
+                        return iterator->portId;
                 }
         }
 
@@ -189,8 +169,6 @@ IPCManager::internalRequestFlowAllocation(const ApplicationProcessNamingInformat
         unsigned int result = 0;
         ApplicationProcessNamingInformation dif_name;
 
-        WriteScopedLock writeLock(flows_rw_lock);
-
 #if STUB_API
 #else
         struct irati_kmsg_ipcm_allocate_flow * msg;
@@ -221,7 +199,7 @@ IPCManager::internalRequestFlowAllocation(const ApplicationProcessNamingInformat
         flow->flowSpecification = flowSpec;
         flow->state = FlowInformation::FLOW_ALLOCATION_REQUESTED;
 
-        pendingFlows[result] = flow;
+        pendingFlows.put(result, flow);
 
         return result;
 }
@@ -236,8 +214,6 @@ unsigned int IPCManager::internalRequestFlowAllocationInDIF(
 	unsigned int result = 0;
 	FlowInformation * flow = 0;
 
-	WriteScopedLock writeLock(flows_rw_lock);
-
 #if STUB_API
 #else
         struct irati_kmsg_ipcm_allocate_flow * msg;
@@ -269,7 +245,7 @@ unsigned int IPCManager::internalRequestFlowAllocationInDIF(
         flow->state = FlowInformation::FLOW_ALLOCATION_REQUESTED;
         flow->user_ipcp_id = sourceIPCProcessId;
 
-        pendingFlows[result] = flow;
+        pendingFlows.put(result, flow);
 
         return result;
 }
@@ -281,8 +257,7 @@ FlowInformation IPCManager::internalAllocateFlowResponse(const FlowRequestEvent&
 							 bool blocking)
 {
 	FlowInformation * flow = 0;
-
-	WriteScopedLock writeLock(flows_rw_lock);
+	FlowInformation flowInformation;
 
 #if STUB_API
 #else
@@ -308,7 +283,6 @@ FlowInformation IPCManager::internalAllocateFlowResponse(const FlowRequestEvent&
 #endif
         if (result != 0) {
                 LOG_WARN("Flow was not accepted, error code: %d", result);
-                FlowInformation flowInformation;
                 return flowInformation;
         }
 
@@ -333,9 +307,10 @@ FlowInformation IPCManager::internalAllocateFlowResponse(const FlowRequestEvent&
         }
 #endif
 
-        allocatedFlows[flowRequestEvent.portId] = flow;
+        flowInformation = *flow;
+        allocatedFlows.put(flowRequestEvent.portId, flow);
 
-        return *flow;
+        return flowInformation;
 }
 
 unsigned int
@@ -587,37 +562,32 @@ FlowInformation IPCManager::commitPendingFlow(unsigned int sequenceNumber,
 				              const ApplicationProcessNamingInformation& DIFName)
 {
         FlowInformation * flow;
-        WriteScopedLock writeLock(flows_rw_lock);
+        FlowInformation result;
 
-        flow = getPendingFlow(sequenceNumber);
+        flow = pendingFlows.erase(sequenceNumber);
         if (flow == 0) {
                 throw FlowAllocationException(IPCManager::unknown_flow_error);
         }
 
-        pendingFlows.erase(sequenceNumber);
-
         flow->portId = portId;
         flow->difName = DIFName;
         flow->state = FlowInformation::FLOW_ALLOCATED;
-        allocatedFlows[portId] = flow;
+        result = *flow;
+        allocatedFlows.put(portId, flow);
 
-        return *flow;
+        return result;
 }
 
 FlowInformation IPCManager::withdrawPendingFlow(unsigned int sequenceNumber)
 {
-        std::map<int, FlowInformation*>::iterator iterator;
         FlowInformation* flow;
         FlowInformation result;
 
-        WriteScopedLock writeLock(flows_rw_lock);
-
-        flow = getPendingFlow(sequenceNumber);
+        flow = pendingFlows.erase(sequenceNumber);
         if (flow == 0) {
                 throw FlowDeallocationException(IPCManager::unknown_flow_error);
         }
 
-        pendingFlows.erase(sequenceNumber);
         result = *flow;
         delete flow;
 
@@ -638,18 +608,23 @@ FlowInformation IPCManager::allocateFlowResponse(
 			blocking);
 }
 
+static bool flow_is_allocated(const FlowInformation * flow)
+{
+        return flow->state == FlowInformation::FLOW_ALLOCATED;
+}
+
 void IPCManager::deallocate_flow(int portId)
 {
         FlowInformation * flow;
+        bool found;
 
-        WriteScopedLock writeLock(flows_rw_lock);
-
-        flow = getAllocatedFlow(portId);
-        if (flow == 0) {
+        //Flows in other states stay in the table
+        flow = allocatedFlows.erase_if(portId, flow_is_allocated, found);
+        if (!found) {
                 throw FlowDeallocationException(IPCManager::unknown_flow_error);
         }
 
-        if (flow->state != FlowInformation::FLOW_ALLOCATED) {
+        if (flow == 0) {
                 throw FlowDeallocationException(IPCManager::wrong_flow_state);
         }
 
@@ -676,7 +651,6 @@ void IPCManager::deallocate_flow(int portId)
 	}
 #endif
 
-	allocatedFlows.erase(portId);
 	delete flow;
 }
 
@@ -684,9 +658,7 @@ void IPCManager::flowDeallocated(int portId)
 {
         FlowInformation * flow;
 
-        WriteScopedLock writeLock(flows_rw_lock);
-
-	flow = getAllocatedFlow(portId);
+	flow = allocatedFlows.erase(portId);
 	if (flow == 0) {
 		throw FlowDeallocationException("Unknown flow");
 	}
@@ -694,22 +666,16 @@ void IPCManager::flowDeallocated(int portId)
 	if (flow->fd > 0) {
 		close(flow->fd);
 	}
-	allocatedFlows.erase(portId);
 	delete flow;
 }
 
 std::vector<FlowInformation> IPCManager::getAllocatedFlows()
 {
-	std::vector<FlowInformation> response;
+	std::list<FlowInformation> flows;
 
-	ReadScopedLock readLock(flows_rw_lock);
+	flows = allocatedFlows.getCopyofentries();
 
-	for (std::map<int, FlowInformation*>::iterator it = allocatedFlows.begin();
-			it != allocatedFlows.end(); ++it) {
-		response.push_back(*(it->second));
-	}
-
-	return response;
+	return std::vector<FlowInformation>(flows.begin(), flows.end());
 }
 
 std::vector<ApplicationRegistration *> IPCManager::getRegisteredApplications()
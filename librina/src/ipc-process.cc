@@ -323,6 +323,17 @@ ReadMgmtSDUResponseEvent::ReadMgmtSDUResponseEvent(int res,
 	}
 }
 
+/* CLASS N-1 PORT LIVENESS EVENT */
+NMinusOnePortLivenessEvent::NMinusOnePortLivenessEvent(unsigned int pid,
+						       bool is_alive,
+						       unsigned int ctrl_p,
+						       unsigned short ipcp_id):
+		IPCEvent(IPCP_N1_PORT_LIVENESS_EVENT, 0, ctrl_p, ipcp_id)
+{
+	port_id = pid;
+	alive = is_alive;
+}
+
 /* CLASS EXTENDED IPC MANAGER */
 const std::string ExtendedIPCManager::error_allocate_flow =
 		"Error allocating flow";
@@ -840,7 +851,7 @@ void ExtendedIPCManager::sendMediaReport(const MediaReport& report)
 int ExtendedIPCManager::internal_flow_allocated(const rina::FlowInformation& flow_info)
 {
 	FlowInformation * flow;
-	WriteScopedLock writeLock(flows_rw_lock);
+	int fd;
 
 	flow = new FlowInformation();
 	flow->portId = flow_info.portId;
@@ -852,25 +863,23 @@ int ExtendedIPCManager::internal_flow_allocated(const rina::FlowInformation& flo
 
 	initIodev(flow, flow->portId);
 
-	allocatedFlows[flow->portId] = flow;
+	fd = flow->fd;
+	allocatedFlows.put(flow->portId, flow);
 
-	return flow->fd;
+	return fd;
 }
 
 void ExtendedIPCManager::internal_flow_deallocated(int port_id)
 {
         FlowInformation * flow;
 
-        WriteScopedLock writeLock(flows_rw_lock);
-
-        flow = getAllocatedFlow(port_id);
+        flow = allocatedFlows.erase(port_id);
         if (flow == 0) {
                 throw FlowDeallocationException(
                                 IPCManager::unknown_flow_error);
         }
 
         close(flow->fd);
-        allocatedFlows.erase(port_id);
         delete flow;
 }
 
@@ -23,12 +23,14 @@
 #include <stdint.h>
 #include <assert.h>
 #include <inttypes.h>
+#include <limits.h>
 #include <stdbool.h>
 #include <unistd.h>
 #include <stdio.h>
 
 #include <algorithm>
 #include <map>
+#include <vector>
 #define RINA_PREFIX "rib"
 #include <librina/logs.h>
 //FIXME iostream is only for debuging purposes
@@ -266,8 +268,224 @@ create_cb_t RIBSchema::get_create_callback(const std::string& class_,
 //fwd decl
 class RIBDaemon;
 
-/// A simple RIB implementation, based on a hashtable of RIB objects
-/// indexed by object name
+/// Initial number of buckets of the RIB indexes
+#define RIB_INDEX_MIN_BUCKETS 64
+
+/// Number of subtree locks of a RIB
+#define RIB_SUBTREE_LOCKS 16
+
+/// Number of removed objects after which a RIB waits for a grace period
+/// and releases them
+#define RIB_RCU_BATCH 64
+
+/// Maximum time (in ms) the objects removed from a RIB wait to be
+/// released when less than RIB_RCU_BATCH of them are pending
+#define RIB_RCU_DELAY_MS 100
+
+/// @internal Waits for grace periods of a RIB in the background, so that
+/// retired objects and index tables are released after RIB_RCU_DELAY_MS
+/// at most, even if no more objects are removed
+class RIBReclaimer : public SimpleThread {
+public:
+	RIBReclaimer(RCUDomain& rcu_) : SimpleThread("RIB reclaimer", false),
+					rcu(rcu_), pending(false),
+					stopped(false) { };
+
+	/// Something was retired, wait for a grace period soon
+	void kick() {
+		ScopedLock g(cond);
+
+		if (pending)
+			return;
+		pending = true;
+		cond.signal();
+	};
+
+	/// Stop the thread, the owner releases what is left
+	void stop() {
+		void* status;
+
+		cond.lock();
+		stopped = true;
+		cond.signal();
+		cond.unlock();
+		join(&status);
+	};
+
+	int run() {
+		ScopedLock g(cond);
+
+		while (!stopped) {
+			if (!pending) {
+				cond.doWait();
+				continue;
+			}
+
+			//Let the removals that follow share the grace period
+			try {
+				cond.timedwait(0, RIB_RCU_DELAY_MS * 1000000L);
+			} catch (ConcurrentException &e) {
+			}
+			if (stopped)
+				break;
+
+			pending = false;
+			cond.unlock();
+			rcu.synchronize();
+			cond.lock();
+		}
+
+		return 0;
+	};
+
+private:
+	RCUDomain& rcu;
+	ConditionVariable cond;
+	bool pending;
+	bool stopped;
+};
+
+/// @internal Hash index over the objects of a RIB. Lookups are done inside
+/// an RCU read section without taking any lock, writers are serialized by
+/// the RIB. Growing the table publishes a new one (so that readers walking
+/// the old chains are not disturbed) and retires the old one.
+template <class K> class RIBIndex {
+public:
+	RIBIndex(RCUDomain& rcu_) : rcu(rcu_), count(0) {
+		tbl = new_table(RIB_INDEX_MIN_BUCKETS);
+	};
+
+	~RIBIndex() {
+		free_table(tbl);
+	};
+
+	//Must be called inside an RCU read section
+	RIBObj* find(const K& key) const {
+		table* t = __atomic_load_n(&tbl, __ATOMIC_ACQUIRE);
+		entry* e = __atomic_load_n(&t->buckets[hash(key) & t->mask],
+					   __ATOMIC_ACQUIRE);
+
+		for (; e; e = __atomic_load_n(&e->next, __ATOMIC_ACQUIRE))
+			if (e->key == key)
+				return e->obj;
+
+		return NULL;
+	};
+
+	//Returns true if the old table was retired to grow the index
+	bool insert(const K& key, RIBObj* obj) {
+		bool grown = count >= tbl->mask + 1;
+
+		if (grown)
+			grow();
+
+		__insert(tbl, key, obj);
+		count++;
+
+		return grown;
+	};
+
+	void erase(const K& key) {
+		entry** prev = &tbl->buckets[hash(key) & tbl->mask];
+		entry* e;
+
+		for (e = *prev; e; prev = &e->next, e = e->next) {
+			if (e->key != key)
+				continue;
+
+			//Readers may still be walking e, free it later
+			__atomic_store_n(prev, e->next, __ATOMIC_RELEASE);
+			rcu.retire(e, free_entry);
+			count--;
+			return;
+		}
+	};
+
+	unsigned int size() const {
+		return count;
+	};
+
+private:
+	struct entry {
+		entry* next;
+		K key;
+		RIBObj* obj;
+	};
+
+	struct table {
+		unsigned int mask;
+		entry** buckets;
+	};
+
+	static table* new_table(unsigned int size) {
+		table* t = new table;
+
+		t->mask = size - 1;
+		t->buckets = new entry*[size];
+		std::fill(t->buckets, t->buckets + size, (entry*) NULL);
+
+		return t;
+	};
+
+	static void free_entry(void* e) {
+		delete (entry*) e;
+	};
+
+	static void free_table(void* p) {
+		table* t = (table*) p;
+		entry *e, *next;
+
+		for (unsigned int i = 0; i <= t->mask; i++) {
+			for (e = t->buckets[i]; e; e = next) {
+				next = e->next;
+				delete e;
+			}
+		}
+		delete[] t->buckets;
+		delete t;
+	};
+
+	static void __insert(table* t, const K& key, RIBObj* obj) {
+		entry** head = &t->buckets[hash(key) & t->mask];
+		entry* e = new entry;
+
+		e->key = key;
+		e->obj = obj;
+		e->next = *head;
+		__atomic_store_n(head, e, __ATOMIC_RELEASE);
+	};
+
+	static uint32_t hash(const K& key) {
+		return ConcurrentHash<K>()(key);
+	};
+
+	void grow(void) {
+		table* t = new_table((tbl->mask + 1) * 2);
+		table* old = tbl;
+		entry* e;
+
+		for (unsigned int i = 0; i <= old->mask; i++)
+			for (e = old->buckets[i]; e; e = e->next)
+				__insert(t, e->key, e->obj);
+
+		__atomic_store_n(&tbl, t, __ATOMIC_RELEASE);
+		rcu.retire(old, free_table);
+	};
+
+	RCUDomain& rcu;
+	table* tbl;
+	unsigned int count;
+};
+
+/// A RIB implementation based on a tree of RIB objects (linked through the
+/// objects themselves), indexed by object name and by instance id.
+///
+/// Readers (lookups, CDAP operations, scoped walks) never lock the RIB:
+/// they look objects up inside RCU read sections and take a reference to
+/// the objects they operate on. Writers lock the subtree below the child
+/// of the root they modify, so that writers of different subtrees do not
+/// serialize each other, and defer freeing removed objects until no reader
+/// can be accessing them.
 class RIB {
 
 public:
@@ -304,7 +522,7 @@ public:
 	// @ret The object instance id or -1 if it does not exist
 	//
 	int64_t get_obj_inst_id(const std::string& fqn) {
-		ReadScopedLock rlock(rwlock);
+		RCUReadScopedLock rlock(rcu);
 		return __get_obj_inst_id(fqn);
 	};
 
@@ -314,7 +532,7 @@ public:
 	// @ret The object fqn or "" if does not exist
 	//
 	std::string get_obj_fqn(const int64_t inst_id) {
-		ReadScopedLock rlock(rwlock);
+		RCUReadScopedLock rlock(rcu);
 		return __get_obj_fqn(inst_id);
 	};
 
@@ -416,20 +634,35 @@ protected:
 			const int invoke_id);
 private:
 
+	// Root of the tree of objects
+	RIBObj* root;
+	std::string root_fqn;
+
+	// Readers of the tree and the indexes use RCU read sections, removed
+	// objects are released after a grace period
+	RCUDomain rcu;
+
+	// Objects retired since the last grace period
+	unsigned int retired_objs;
+
+	// Releases the retired objects when there are not enough of them
+	// to wait for a grace period in place
+	RIBReclaimer reclaimer;
+
 	// fqn <-> obj
-	std::map<std::string, RIBObj*> obj_name_map;
+	RIBIndex<std::string> name_index;
 
 	// instance id <-> obj
-	std::map<int64_t, RIBObj*> obj_inst_map;
-
-	// instance id <-> fqn
-	std::map<int64_t, std::string> inst_name_map;
+	RIBIndex<int64_t> inst_index;
 
-	// fqn <-> instance id
-	std::map<std::string, int64_t> name_inst_map;
+	// Serializes the writers of the indexes
+	Lockable index_lock;
 
-	// Children map instance id <-> std<int64_t> children
-	std::map<int64_t, std::list<int64_t>*> obj_inst_child_map;
+	// Writers of the objects below a child of the root hold the lock of
+	// that subtree (selected by the hash of the child's name); linking or
+	// unlinking the children of the root also takes root_lock
+	Lockable subtree_locks[RIB_SUBTREE_LOCKS];
+	Lockable root_lock;
 
 	// delegation cache: fqn <-> inst id
 	std::map<std::string, int64_t> deleg_cache;
@@ -446,20 +679,32 @@ private:
         //CDAP Provider
         cdap::CDAPProviderInterface *cdap_provider;
 
-        //rwlock
-        ReadWriteLockable rwlock;
-
         //Cache rwlock
         ReadWriteLockable cache_rwlock;
 
         //RIB handle (id)
         const rib_handle_t handle;
 
-	void get_objects_to_operate(const int64_t object_id,
-				    int scope,
-				    char* filter,
-				    std::list<std::pair<int, RIBObj*> >
-	                            &objects);
+	//@internal Reference to an object held by an operation (RAII)
+	class ObjRef {
+	public:
+		ObjRef(RIB* rib_, RIBObj* obj_) : obj(obj_), rib(rib_) {};
+		~ObjRef() {
+			if (obj)
+				rib->put_ref(obj);
+		};
+
+		RIBObj* obj;
+	private:
+		RIB* rib;
+	};
+
+	//@internal Next object of a pre-order walk over the subtree of root,
+	//limited to scope levels below it (depth holds the level of cur). The
+	//object is returned with a reference taken; NULL is returned at the
+	//end of the walk or if cur has been removed meanwhile
+	RIBObj* get_next_in_scope(RIBObj* root_obj, RIBObj* cur, int scope,
+				  int& depth);
 
 	//return 0 if operation is allowed, negative number otherwise
 	void check_operation_allowed(const cdap_rib::auth_policy_t & auth,
@@ -468,26 +713,44 @@ private:
 				     const std::string obj_name,
 				     cdap_rib::res_info_t& res);
 
-	//@internal only; must be called with the rwlock acquired
+	//@internal only; must be called inside an RCU read section
 	RIBObj* get_obj(int64_t inst_id);
 
-	//@internal: must be called with the rwlock acquired
+	//@internal Look up an object by name and take a reference to it, so
+	//that it is not deleted while the caller operates on it
+	RIBObj* get_obj_ref(const std::string& fqn);
+
+	//@internal Take a reference to an object (must be called inside an
+	//RCU read section, or holding another reference) or release it
+	void get_ref(RIBObj* obj);
+	void put_ref(RIBObj* obj);
+
+	//@internal RCU reclaim callback, releases the reference held by the
+	//RIB on a removed object
+	static void release_obj(void* obj);
+
+	//@internal Lock of the subtree fqn belongs to
+	Lockable& get_subtree_lock(const std::string& fqn);
+
+	//@internal Collect obj and all its descendants, children first; must
+	//be called with the subtree lock acquired
+	void collect_subtree(RIBObj* obj, std::vector<RIBObj*>& objs);
+
 	void __remove_obj(int64_t inst_id, bool force = false);
 
-	//@internal: must be called with the rwlock acquired
+	//@internal: must be called inside an RCU read section
 	int64_t __get_obj_inst_id(const std::string& fqn);
 
-	//@internal: must be called with the rwlock acquired
+	//@internal: must be called inside an RCU read section
 	std::string __get_obj_fqn(const int64_t inst_id);
 
 	//@internal: validate an object name
 	void __validate_fqn(const std::string& fqn);
 
-	//@internal must be called with the rwlock acquired
+	//@internal must be called inside an RCU read section
 	std::string __get_obj_class(const int64_t instance_id);
 
-	//@internal Get a new (unused) instance id (strictly > 0);
-	//must be called with the wlock acquired
+	//@internal Get a new (unused) instance id (strictly > 0)
 	int64_t get_new_inst_id(void);
 
 	int compareString(std::string a, std::string b);
@@ -507,70 +770,52 @@ RIB::RIB(const rib_handle_t& handle_,
 	 cdap::CDAPProviderInterface *cdap_provider_,
 	 ISecurityManager * sec_man,
 	 const std::string& file_path) :
+						retired_objs(0),
+						reclaimer(rcu),
+						name_index(rcu),
+						inst_index(rcu),
 						schema(schema_),
 						next_inst_id(1),
 						num_of_deleg(0),
 						cdap_provider(cdap_provider_),
 						handle(handle_){
 
-	std::stringstream root_fqn;
 	std::stringstream ss;
 
 	//Create root object
-	RIBObj* root = new RootObj();
+	root = new RootObj();
+	root->rib = this;
+	root->inst_id = RIB_ROOT_INST_ID;
 
 	// Root fqn
-	root_fqn << schema->get_root_name() << schema->get_separator();
+	ss << schema->get_root_name() << schema->get_separator();
+	root_fqn = ss.str();
 
 	// Fill in the stuf
-	obj_name_map[root_fqn.str()] = root;
-	obj_inst_map[RIB_ROOT_INST_ID] = root;
-	inst_name_map[RIB_ROOT_INST_ID] = root_fqn.str();
-	name_inst_map[root_fqn.str()] = RIB_ROOT_INST_ID;
-	std::list<int64_t>* child_list = new std::list<int64_t>();
-	obj_inst_child_map[RIB_ROOT_INST_ID] = child_list;
+	name_index.insert(root_fqn, root);
+	inst_index.insert(RIB_ROOT_INST_ID, root);
 	security_m = sec_man;
 
 	base_file_path = file_path;
 	if (base_file_path != "") {
 		createdir(base_file_path);
 	}
+
+	reclaimer.start();
 }
 
 RIB::~RIB() {
-	std::list<int64_t> *child_list;
-	int64_t inst_id;
-	RIBObj* obj;
-	std::map<int64_t, RIBObj*>::iterator it;
-	std::stringstream ss;
+	std::vector<RIBObj*> objs;
+	std::vector<RIBObj*>::iterator it;
 
-	//Mutual exclusion
-	WriteScopedLock wlock(rwlock);
+	//Release the objects removed since the last grace period
+	reclaimer.stop();
+	rcu.synchronize();
 
-	//Remove objects
-	for(it = obj_inst_map.begin(); it != obj_inst_map.end(); it++){
-		inst_id = it->first;
-		obj = it->second;
-
-		//If there, remove from the cache
-		if(obj->delegates){
-			//Remove cached delegated objs
-			deleg_cache.clear();
-			num_of_deleg--;
-		}
-		try{
-			child_list = obj_inst_child_map[inst_id];
-		}catch(...){
-			LOG_ERR("Unable to recover the children list/parent"
-				"children list for object '" PRId64 "';"
-				"corrupted internal state!",inst_id);
-			continue;
-		}
-		if (child_list != NULL){
-			delete child_list;
-		}
-		delete obj;
-	}
+	//No operation can be in progress at this point; remove objects
+	collect_subtree(root, objs);
+	for(it = objs.begin(); it != objs.end(); ++it)
+		delete *it;
 
 	//Remove temp file system with exported RIB if it exists
 	if (base_file_path != "") {
@@ -640,24 +885,17 @@ void RIB::create_request(const cdap_rib::con_handle_t &con,
 	}
 
 	RIBObj* rib_obj = NULL;
-	/* RAII scope for RIB scoped lock (read) */
-	{
-		//Mutual exclusion
-		ReadScopedLock rlock(rwlock);
 
-		int64_t id = get_obj_inst_id(obj.name_);
-		if(id)
-			rib_obj = get_obj(id);
+	//Take a reference to the object (make sure it is not deleted while
+	//we process the operation). Objects cannot be created at the root
+	ObjRef ref(this, get_obj_ref(obj.name_));
+	if(ref.obj && ref.obj != root)
+		rib_obj = ref.obj;
 
-		//Acquire the read lock over the object (make sure it is not
-		//deleted while we process the operation)
-		if(rib_obj)
-			rib_obj->rwlock.readlock();
-	} //RAII
 	/* RAII scope for OBJ scoped lock(read) */
 	if(rib_obj) {
 		//Mutual exclusion
-		ReadScopedLock rlock(rib_obj->rwlock, false);
+		ReadScopedLock rlock(rib_obj->rwlock);
 
 		if (!rib_obj->delegates) {
 			//If the object exists invoke the callback over the
@@ -724,7 +962,7 @@ void RIB::delete_request(const cdap_rib::con_handle_t &con,
 	cdap_rib::res_info_t res;
 	RIBObj* rib_obj = NULL;
 	bool delete_flag = false;
-	int64_t id;
+	int64_t id = -1;
 
 	check_operation_allowed(auth,
 			        con,
@@ -747,25 +985,17 @@ void RIB::delete_request(const cdap_rib::con_handle_t &con,
 		return;
 	}
 
-	/* RAII scope for RIB scoped lock (read) */
-	{
-		//Mutual exclusion
-		ReadScopedLock rlock(rwlock);
-
-		id = get_obj_inst_id(obj.name_);
-		rib_obj = get_obj(id);
-
-		//Acquire the read lock over the object (make sure it is not
-		//deleted while we process the operation)
-		if(rib_obj)
-			rib_obj->rwlock.readlock();
-	} //RAII
+	//Take a reference to the object (make sure it is not deleted while
+	//we process the operation)
+	ObjRef ref(this, get_obj_ref(obj.name_));
+	rib_obj = ref.obj;
 
 	/* RAII scope for OBJ scoped lock(read) */
 	if(rib_obj){
 		//Mutual exclusion
-		ReadScopedLock rlock(rib_obj->rwlock, false);
+		ReadScopedLock rlock(rib_obj->rwlock);
 
+		id = rib_obj->inst_id;
 		delete_flag = rib_obj->delete_(con,
 					       obj.name_,
 					       obj.class_,
@@ -830,7 +1060,6 @@ void RIB::read_request(const cdap_rib::con_handle_t &con,
 	obj_reply.value_.message_ = NULL;
 
 	cdap_rib::res_info_t res;
-	std::list<std::pair <int, RIBObj*> > objects;
         RIBObj* rib_obj = NULL;
 
 	check_operation_allowed(auth,
@@ -854,22 +1083,12 @@ void RIB::read_request(const cdap_rib::con_handle_t &con,
 		return;
 	}
 
-	/* RAII scope for RIB scoped lock (read) */
-	{
-		//Mutual exclusion
-		ReadScopedLock rlock(rwlock);
-		int64_t id = get_obj_inst_id(obj.name_);
-		// Check if we have to delegate the call
-		rib_obj = get_obj(id);
-
-		//Get all objects affected by the operation
-		get_objects_to_operate(id,
-				       filt.scope_,
-				       filt.filter_,
-				       objects);
-	} //RAII
+	//Take a reference to the object at the root of the operation; the
+	//objects in its scope are walked one by one, holding a reference to
+	//the current and the next one only
+	ObjRef scope_root(this, get_obj_ref(obj.name_));
 
-	if(objects.size() == 0){
+	if(!scope_root.obj){
 		if (invoke_id != 0) {
 			res.code_ = cdap_rib::CDAP_INVALID_OBJ;
 
@@ -888,15 +1107,24 @@ void RIB::read_request(const cdap_rib::con_handle_t &con,
 		return;
 	}
 
-	std::list<std::pair<int, RIBObj*> >::iterator it;
 	std::list<DelegationObj*> delegated_objs;
-	unsigned int count = 0;
-	for (it = objects.begin(); it != objects.end(); ++it) {
-		rib_obj = it->second;
-		count++;
+	RIBObj* next_obj;
+	int depth = 0, next_depth;
+
+	get_ref(scope_root.obj);
+	for (rib_obj = scope_root.obj; rib_obj; rib_obj = next_obj) {
+		ObjRef ref(this, rib_obj);
+		int left = filt.scope_ - depth;
+
+		//Peek the next object, so that we know when this is the last
+		next_depth = depth;
+		next_obj = get_next_in_scope(scope_root.obj, rib_obj,
+					     filt.scope_, next_depth);
+		depth = next_depth;
+
 		LOG_DBG("Processing read over object %s", rib_obj->fqn.c_str());
 		//Mutual exclusion
-		ReadScopedLock rlock(rib_obj->rwlock, false);
+		ReadScopedLock rlock(rib_obj->rwlock);
 
 		rib_obj->read(con,
 			      obj.name_,
@@ -913,7 +1141,7 @@ void RIB::read_request(const cdap_rib::con_handle_t &con,
 		int delegate = false;
 		if(rib_obj->delegates)
 		{
-		        int rem_scope = filt.scope_ - it->first;
+		        int rem_scope = filt.scope_ - left;
 		        delegate = true;
 		        std::string delegated_name;
 		        //check if the request is for the delegated object or
@@ -940,7 +1168,7 @@ void RIB::read_request(const cdap_rib::con_handle_t &con,
 		                deleg_filt.scope_ = rem_scope;
 		                deleg_filt.filter_ = filt.filter_;
 				DelegationObj *del_obj = (DelegationObj*)rib_obj;
-                                if (count == objects.size())
+                                if (!next_obj)
                                         del_obj->last = true;
 				del_obj->forward_object(con,
 							rina::cdap::cdap_m_t::M_READ,
@@ -956,7 +1184,7 @@ void RIB::read_request(const cdap_rib::con_handle_t &con,
 
 		if(!delegate)
 		{
-			if (count == objects.size())
+			if (!next_obj)
 			{
 				for(std::list<DelegationObj*>::iterator it =
 				                delegated_objs.begin();
@@ -1023,24 +1251,15 @@ void RIB::cancel_read_request(const cdap_rib::con_handle_t &con,
 		return;
 	}
 
-	/* RAII scope for RIB scoped lock (read) */
-	{
-		//Mutual exclusion
-		ReadScopedLock rlock(rwlock);
-
-		int64_t id = get_obj_inst_id(obj.name_);
-		rib_obj = get_obj(id);
-
-		//Acquire the read lock over the object (make sure it is not
-		//deleted while we process the operation)
-		if(rib_obj)
-			rib_obj->rwlock.readlock();
-	} //RAII
+	//Take a reference to the object (make sure it is not deleted while
+	//we process the operation)
+	ObjRef ref(this, get_obj_ref(obj.name_));
+	rib_obj = ref.obj;
 
 	/* RAII scope for OBJ scoped lock(read) */
 	if(rib_obj){
 		//Mutual exclusion
-		ReadScopedLock rlock(rib_obj->rwlock, false);
+		ReadScopedLock rlock(rib_obj->rwlock);
 
 		rib_obj->cancelRead(con, obj.name_, obj.class_, filt,
 							invoke_id, res);
@@ -1102,24 +1321,15 @@ void RIB::write_request(const cdap_rib::con_handle_t &con,
 		return;
 	}
 
-	/* RAII scope for RIB scoped lock (read) */
-	{
-		//Mutual exclusion
-		ReadScopedLock rlock(rwlock);
-
-		int64_t id = get_obj_inst_id(obj.name_);
-		rib_obj = get_obj(id);
-
-		//Acquire the read lock over the object (make sure it is not
-		//deleted while we process the operation)
-		if(rib_obj)
-			rib_obj->rwlock.readlock();
-	} //RAII
+	//Take a reference to the object (make sure it is not deleted while
+	//we process the operation)
+	ObjRef ref(this, get_obj_ref(obj.name_));
+	rib_obj = ref.obj;
 
 	/* RAII scope for OBJ scoped lock(read) */
 	if(rib_obj){
 		//Mutual exclusion
-		ReadScopedLock rlock(rib_obj->rwlock, false);
+		ReadScopedLock rlock(rib_obj->rwlock);
 
 		rib_obj->write(con, obj.name_, obj.class_, filt,
 								invoke_id,
@@ -1186,24 +1396,15 @@ void RIB::start_request(const cdap_rib::con_handle_t &con,
 		return;
 	}
 
-	/* RAII scope for RIB scoped lock (read) */
-	{
-		//Mutual exclusion
-		ReadScopedLock rlock(rwlock);
-
-		int64_t id = get_obj_inst_id(obj.name_);
-		rib_obj = get_obj(id);
-
-		//Acquire the read lock over the object (make sure it is not
-		//deleted while we process the operation)
-		if(rib_obj)
-			rib_obj->rwlock.readlock();
-	} //RAII
+	//Take a reference to the object (make sure it is not deleted while
+	//we process the operation)
+	ObjRef ref(this, get_obj_ref(obj.name_));
+	rib_obj = ref.obj;
 
 	/* RAII scope for OBJ scoped lock(read) */
 	if(rib_obj){
 		//Mutual exclusion
-		ReadScopedLock rlock(rib_obj->rwlock, false);
+		ReadScopedLock rlock(rib_obj->rwlock);
 
 		rib_obj->start(con, obj.name_, obj.class_, filt,
 							invoke_id,
@@ -1269,24 +1470,15 @@ void RIB::stop_request(const cdap_rib::con_handle_t &con,
 		return;
 	}
 
-	/* RAII scope for RIB scoped lock (read) */
-	{
-		//Mutual exclusion
-		ReadScopedLock rlock(rwlock);
-
-		int64_t id = get_obj_inst_id(obj.name_);
-		rib_obj = get_obj(id);
-
-		//Acquire the read lock over the object (make sure it is not
-		//deleted while we process the operation)
-		if(rib_obj)
-			rib_obj->rwlock.readlock();
-	} //RAII
+	//Take a reference to the object (make sure it is not deleted while
+	//we process the operation)
+	ObjRef ref(this, get_obj_ref(obj.name_));
+	rib_obj = ref.obj;
 
 	/* RAII scope for OBJ scoped lock(read) */
 	if(rib_obj){
 		//Mutual exclusion
-		ReadScopedLock rlock(rib_obj->rwlock, false);
+		ReadScopedLock rlock(rib_obj->rwlock);
 
 		rib_obj->stop(con, obj.name_, obj.class_, filt,
 								invoke_id,
@@ -1312,58 +1504,109 @@ void RIB::stop_request(const cdap_rib::con_handle_t &con,
 	}
 }
 
-void RIB::get_objects_to_operate(const int64_t object_id,
-			         int scope,
-			         char * filter,
-			         std::list<std::pair<int, RIBObj*> >
-			         &objects)
+RIBObj* RIB::get_next_in_scope(RIBObj* root_obj, RIBObj* cur, int scope,
+			       int& depth)
 {
-	std::list<int64_t> *child_list = NULL;
-	RIBObj *rib_obj = NULL;
+	RCUReadScopedLock rlock(rcu);
+	RIBObj* next;
+
+	//If cur has been removed its links cannot be followed anymore. While
+	//it is linked, so are its ancestors (they can only be removed along
+	//with it)
+	if (__atomic_load_n(&cur->unlinked, __ATOMIC_ACQUIRE))
+		return NULL;
 
-	rib_obj = get_obj(object_id);
-	if (!rib_obj)
-		return;
 	//TODO apply filter
+	if (depth < scope) {
+		next = __atomic_load_n(&cur->first_child, __ATOMIC_ACQUIRE);
+		if (next) {
+			depth++;
+			get_ref(next);
+			return next;
+		}
+	}
 
-	//Acquire the read lock over the object (make sure it is not
-	//deleted while we process the operation)
-	rib_obj->rwlock.readlock();
-	std::pair<int, RIBObj*> pair (scope, rib_obj);
-	objects.push_back(pair);
+	for (; cur != root_obj; cur = cur->parent, depth--) {
+		next = __atomic_load_n(&cur->next_sibling, __ATOMIC_ACQUIRE);
+		if (next) {
+			get_ref(next);
+			return next;
+		}
+	}
 
-	if (scope == 0)
-		return;
+	return NULL;
+}
 
-	child_list = obj_inst_child_map[object_id];
-	if (!child_list || child_list->size() == 0)
-		return;
+RIBObj* RIB::get_obj(int64_t inst_id){
+	return inst_index.find(inst_id);
+}
+
+RIBObj* RIB::get_obj_ref(const std::string& fqn)
+{
+	RCUReadScopedLock rlock(rcu);
+	RIBObj* obj;
 
-	std::list<int64_t>::const_iterator it;
-	for(it = child_list->begin(); it != child_list->end(); ++it)
-		get_objects_to_operate(*it,
-				       scope - 1,
-				       filter,
-				       objects);
+	obj = get_obj(__get_obj_inst_id(fqn));
+	if (obj)
+		get_ref(obj);
+
+	return obj;
 }
 
-RIBObj* RIB::get_obj(int64_t inst_id){
-	if(obj_inst_map.find(inst_id) != obj_inst_map.end())
-		return obj_inst_map[inst_id];
-	else
-		return NULL;
+void RIB::get_ref(RIBObj* obj)
+{
+	__atomic_add_fetch(&obj->refs, 1, __ATOMIC_RELAXED);
+}
+
+void RIB::put_ref(RIBObj* obj)
+{
+	release_obj(obj);
+}
+
+void RIB::release_obj(void* obj)
+{
+	RIBObj* o = static_cast<RIBObj*>(obj);
+
+	if (__atomic_sub_fetch(&o->refs, 1, __ATOMIC_ACQ_REL) == 0)
+		delete o;
+}
+
+Lockable& RIB::get_subtree_lock(const std::string& fqn)
+{
+	char s = schema->get_separator();
+	std::string::size_type end;
+
+	//The subtree is identified by the first component of the name
+	end = fqn.find(s, 1);
+	if (end == std::string::npos)
+		end = fqn.size();
+
+	return subtree_locks[ConcurrentHash<std::string>()(
+			fqn.substr(0, end)) % RIB_SUBTREE_LOCKS];
+}
+
+void RIB::collect_subtree(RIBObj* obj, std::vector<RIBObj*>& objs)
+{
+	RIBObj* child;
+
+	for (child = obj->first_child; child; child = child->next_sibling)
+		collect_subtree(child, objs);
+
+	objs.push_back(obj);
 }
 
 int64_t RIB::__get_obj_inst_id(const std::string& fqn){
 	int64_t id = -1;
 
-	if(name_inst_map.find(fqn) != name_inst_map.end())
-		id = name_inst_map[fqn];
+	RIBObj* obj = name_index.find(fqn);
+
+	if(obj)
+		id = obj->inst_id;
 
 	//If there are delegated objects
 	//Note: this block of code is specially polluted by RAII
 	//I hate exceptions
-	if(id == -1 && num_of_deleg > 0){
+	if(id == -1 && __atomic_load_n(&num_of_deleg, __ATOMIC_RELAXED) > 0){
 
 		/* rwlock RAII scope */ {
 
@@ -1383,8 +1626,9 @@ int64_t RIB::__get_obj_inst_id(const std::string& fqn){
 		std::string root_name = __get_obj_fqn(0);
 		do{
 			tmp = get_parent_fqn(tmp);
-			if(name_inst_map.find(tmp) != name_inst_map.end())
-				id = name_inst_map[tmp];
+			obj = name_index.find(tmp);
+			if(obj)
+				id = obj->inst_id;
 			if(id >= 0 || tmp == root_name)
 				break;
 		}while(1);
@@ -1394,7 +1638,7 @@ int64_t RIB::__get_obj_inst_id(const std::string& fqn){
 			return id;
 
 		//Check if it is a delegated obj
-		RIBObj *obj = get_obj(id);
+		obj = get_obj(id);
 		if(!obj){
 			assert(0); // neither this one
 			return -1;
@@ -1414,30 +1658,24 @@ int64_t RIB::__get_obj_inst_id(const std::string& fqn){
 
 std::string RIB::__get_obj_fqn(const int64_t inst_id) {
 	std::string fqn("");
+	RIBObj* obj = get_obj(inst_id);
 
-	if(inst_name_map.find(inst_id) != inst_name_map.end())
-		fqn = inst_name_map[inst_id];
+	if(obj)
+		fqn = obj == root ? root_fqn : obj->fqn;
 
 	return fqn;
 }
 
 int64_t RIB::get_new_inst_id(){
 
-	int64_t curr = -1;
-
-	for(;; ++next_inst_id){
-		//Reuse ids; restart at 1
-		if(next_inst_id < 1)
-			next_inst_id = 1;
+	int64_t id;
 
-		//Set stop flag
-		if(curr < 0)
-			curr = next_inst_id;
+	//Ids are not reused; a 64 bit counter does not wrap in practice
+	do {
+		id = __atomic_fetch_add(&next_inst_id, 1, __ATOMIC_RELAXED);
+	} while (id < 1);
 
-		if(obj_inst_map.find(next_inst_id) == obj_inst_map.end())
-			break;
-	}
-	return next_inst_id;
+	return id;
 }
 
 //Checks for fqn sanity.
@@ -1472,10 +1710,10 @@ int64_t RIB::add_obj(const std::string& fqn, RIBObj** obj_) {
 	int64_t id, parent_id;
 	std::string parent_fqn = get_parent_fqn(fqn);
 	std::stringstream ss;
+	RIBObj* parent;
 
 	//Note that obj_ cannot be NULL (checked by RIBDaemon)
 	RIBObj* obj = *obj_;
-	obj->rib = this;
 
 	if(!obj){
 		LOG_ERR("Unable to add object(%p) at '%s'; object is NULL!",
@@ -1483,6 +1721,7 @@ int64_t RIB::add_obj(const std::string& fqn, RIBObj** obj_) {
 								fqn.c_str());
 		throw eObjInvalid();
 	}
+	obj->rib = this;
 	LOG_DBG("Starting add object operation over RIB(%p), of object(%p) with fqn: '%s' (parent '%s')",
 							this,
 							obj,
@@ -1493,62 +1732,81 @@ int64_t RIB::add_obj(const std::string& fqn, RIBObj** obj_) {
 	__validate_fqn(fqn);
 	obj->fqn = fqn;
 
-	//Mutual exclusion
-	WriteScopedLock wlock(rwlock);
-
-	//Check whether the father exists
-	parent_id = __get_obj_inst_id(parent_fqn);
-	if(parent_id == -1){
-		LOG_ERR("Unable to add object(%p) at '%s'; parent does not exist!",
-								obj,
-								fqn.c_str());
-		throw eObjNoParent();
-	}
+	//Mutual exclusion with the writers of the subtree; the parent
+	//cannot be removed while we hold it
+	ScopedLock wlock(get_subtree_lock(fqn));
 
-	//Check if the object already exists
-	id = __get_obj_inst_id(obj->fqn);
-	if(id != -1){
-		LOG_ERR("Unable to add object(%p) at '%s'; an object of class '%s' already exists!",
-							obj,
-							fqn.c_str(),
-							__get_obj_class(id).c_str());
-		throw eObjExists();
-	}
+	/* RAII scope for RCU read section */
+	{
+		RCUReadScopedLock rlock(rcu);
+
+		//Check whether the father exists
+		parent_id = __get_obj_inst_id(parent_fqn);
+		parent = get_obj(parent_id);
+		if(!parent){
+			LOG_ERR("Unable to add object(%p) at '%s'; parent does not exist!",
+									obj,
+									fqn.c_str());
+			throw eObjNoParent();
+		}
 
-	//Allocate space
-	std::list<int64_t>* child_list = new std::list<int64_t>();
+		//Check if the object already exists
+		id = __get_obj_inst_id(obj->fqn);
+		if(id != -1){
+			LOG_ERR("Unable to add object(%p) at '%s'; an object of class '%s' already exists!",
+								obj,
+								fqn.c_str(),
+								__get_obj_class(id).c_str());
+			throw eObjExists();
+		}
+	} //RAII
 
 	//get a (free) instance id
 	id = get_new_inst_id();
+	obj->inst_id = id;
 	obj->parent_inst_id = parent_id;
+	obj->parent = parent;
+	obj->refs = 1;
+	obj->unlinked = false;
 
-	//Add it and return
-	obj_name_map[fqn] = obj;
-	obj_inst_map[id] = obj;
-	inst_name_map[id] = fqn;
-	name_inst_map[fqn] = id;
-	obj_inst_child_map[id] = child_list;
+	//Add it to the indexes
+	/* RAII scope for index lock */
+	{
+		ScopedLock ilock(index_lock);
+		bool grown = name_index.insert(fqn, obj);
+
+		if (inst_index.insert(id, obj) || grown)
+			reclaimer.kick();
+	} //RAII
 
 	if(obj->delegates){
+		WriteScopedLock clock(cache_rwlock);
 		//Increase counter number of num_of_deleg
-		num_of_deleg++;
+		__atomic_add_fetch(&num_of_deleg, 1, __ATOMIC_RELAXED);
 		//For consistency (delegation in delegation); clear cache
 		deleg_cache.clear();
 	}
 
-	//Recover parent's children list  and add ourselves
-	std::list<int64_t>* parent_child_list;
-	try{
-		parent_child_list = obj_inst_child_map[parent_id];
-		if(parent_child_list == NULL)
-			throw Exception();
-	}catch(...){
-		LOG_ERR("Unable to recover the children list for object '" PRId64  "'; corrupted internal state!",
-						parent_id);
-		assert(0);
-		throw Exception("Corrupted internal state");
-	}
-	parent_child_list->push_back(id);
+	//Add ourselves to the parent's children; readers walking the list
+	//must see the object fully initialized
+	if (parent == root)
+		root_lock.lock();
+
+	obj->prev_sibling = parent->last_child;
+	obj->next_sibling = NULL;
+	obj->first_child = obj->last_child = NULL;
+	obj->num_children = 0;
+	if (parent->last_child)
+		__atomic_store_n(&parent->last_child->next_sibling, obj,
+				 __ATOMIC_RELEASE);
+	else
+		__atomic_store_n(&parent->first_child, obj,
+				 __ATOMIC_RELEASE);
+	parent->last_child = obj;
+	parent->num_children++;
+
+	if (parent == root)
+		root_lock.unlock();
 
 	LOG_DBG("Add object operation over RIB(%p), of object(%p) with fqn: '%s', succeeded. Instance id: '%" PRId64 "'",
 								this,
@@ -1571,118 +1829,134 @@ void RIB::__remove_obj(int64_t inst_id, bool force)
 {
 
 	RIBObj* obj;
-	std::list<int64_t> *child_list = NULL, *parent_child_list = NULL;
-	std::list<int64_t> children;
-	std::list<int64_t>::iterator it;
-	int64_t parent_inst_id;
-	std::stringstream ss;
+	std::vector<RIBObj*> objs;
+	std::vector<RIBObj*>::iterator it;
+	bool deleg = false;
 
-	//Mutual exclusion
-	rwlock.writelock();
+	/* RAII scope for RCU read section */
+	{
+		RCUReadScopedLock rlock(rcu);
+
+		obj = get_obj(inst_id);
+		if(obj)
+			get_ref(obj);
+	} //RAII
 
-	obj = get_obj(inst_id);
 	if(!obj){
 		LOG_ERR("Unable to remove with instance id '%" PRId64  "'. Object does not exist!",
 								inst_id);
-		rwlock.unlock();
 		throw eObjDoesNotExist();
 	}
 
-	if(inst_id == RIB_ROOT_INST_ID){
+	ObjRef ref(this, obj);
+
+	if(obj == root){
 		LOG_ERR("Unable to remove object with instance id '%" PRId64  "'; root can never be removed!",
 								inst_id);
-		rwlock.unlock();
 		throw eObjInvalid();
 	}
 
-	parent_inst_id = obj->parent_inst_id;
-
-	//Check first if it has children
-	try{
-		child_list = obj_inst_child_map[inst_id];
-		if(child_list == NULL)
-			throw Exception();
-		parent_child_list = obj_inst_child_map[parent_inst_id];
-		if(parent_child_list == NULL)
-			throw Exception();
-	}catch(...){
-		LOG_ERR("Unable to recover the children list/parent children list for object '" PRId64  "'; corrupted internal state!",
-							inst_id);
-		rwlock.unlock();
-		assert(0);
-		throw Exception("Corrupted internal state");
-	}
-
-	if(child_list->size() > 0 && !force){
-		LOG_ERR("Unable to remove object '" PRId64  "'; the object has children",
-							inst_id);
-		rwlock.unlock();
-		throw eObjHasChildren();
-	} else if (child_list->size() > 0) {
-		//Make a copy of the list of children
-		for(it=child_list->begin(); it != child_list->end(); ++it) {
-			children.push_back(*it);
-		}
+	/* RAII scope for subtree lock */
+	{
+		//Mutual exclusion with the writers of the subtree
+		ScopedLock wlock(get_subtree_lock(obj->fqn));
 
-		//Remove each children recursively
-		for (it = children.begin(); it != children.end(); ++it) {
-			rwlock.unlock();
-			try {
-				__remove_obj(*it, true);
-			} catch (...) {
-			}
-			rwlock.writelock();
+		//Removed by someone else meanwhile
+		if(obj->unlinked){
+			LOG_ERR("Unable to remove with instance id '%" PRId64  "'. Object does not exist!",
+								inst_id);
+			throw eObjDoesNotExist();
 		}
-	}
 
-	//Check if we are in the parent's child list
-	it = std::find(parent_child_list->begin(), parent_child_list->end(),
+		if(obj->num_children > 0 && !force){
+			LOG_ERR("Unable to remove object '%" PRId64  "'; the object has children",
 								inst_id);
-	if(it == parent_child_list->end()){
-		LOG_ERR("Parent's children list does not contain object '" PRId64  "'; corrupted internal state!",
-							inst_id);
-		rwlock.unlock();
-		throw Exception("Corrupted internal state");
-	}
+			throw eObjHasChildren();
+		}
 
-	//Remove from the maps
-	std::string fqn = __get_obj_fqn(inst_id);
+		//Children first; readers walking the subtree stop as soon as
+		//they find an unlinked object
+		collect_subtree(obj, objs);
+		for(it = objs.begin(); it != objs.end(); ++it)
+			__atomic_store_n(&(*it)->unlinked, true,
+					 __ATOMIC_RELEASE);
+
+		//Remove ourselves from the parent's children list (the
+		//object keeps its own links for the readers still walking it)
+		RIBObj* parent = obj->parent;
+		if(parent == root)
+			root_lock.lock();
+
+		if(obj->prev_sibling)
+			__atomic_store_n(&obj->prev_sibling->next_sibling,
+					 obj->next_sibling,
+					 __ATOMIC_RELEASE);
+		else
+			__atomic_store_n(&parent->first_child,
+					 obj->next_sibling,
+					 __ATOMIC_RELEASE);
+		if(obj->next_sibling)
+			obj->next_sibling->prev_sibling = obj->prev_sibling;
+		else
+			parent->last_child = obj->prev_sibling;
+		parent->num_children--;
+
+		if(parent == root)
+			root_lock.unlock();
+
+		//Remove from the indexes
+		/* RAII scope for index lock */ {
+			ScopedLock ilock(index_lock);
+			for(it = objs.begin(); it != objs.end(); ++it) {
+				name_index.erase((*it)->fqn);
+				inst_index.erase((*it)->inst_id);
+				if((*it)->delegates)
+					deleg = true;
+			}
+		} //RAII
 
-	LOG_DBG("Removing object over RIB(%p) instance id: '%" PRId64 "' fqn: '%s'",
-								this,
-								inst_id,
-								fqn.c_str());
-	obj_inst_map.erase(inst_id);
-	inst_name_map.erase(inst_id);
-	name_inst_map.erase(fqn);
-	obj_name_map.erase(fqn);
-	obj_inst_child_map.erase(inst_id);
+		for(it = objs.begin(); it != objs.end(); ++it) {
+			std::stringstream ss;
+
+			LOG_DBG("Object '%s' of class '%s' succesfully removed (id:'%" PRId64 "')",
+								(*it)->fqn.c_str(),
+								(*it)->get_class().c_str(),
+								(*it)->inst_id);
 
-	//Remove ourselves from the parent's children list
-	parent_child_list->erase(it);
+			if (base_file_path != "") {
+				ss << base_file_path << (*it)->fqn;
+				removedir_all(ss.str());
+			}
+		}
+	} //RAII
 
 	//If there Remove from the cache
-	if(obj->delegates){
+	if(deleg){
+		WriteScopedLock clock(cache_rwlock);
 		//Remove cached delegated objs
 		deleg_cache.clear();
-		num_of_deleg--;
+		for(it = objs.begin(); it != objs.end(); ++it)
+			if((*it)->delegates)
+				__atomic_sub_fetch(&num_of_deleg, 1,
+						   __ATOMIC_RELAXED);
 	}
 
-	LOG_DBG("Object '%s' of class '%s' succesfully removed (id:'%" PRId64 "')",
-							fqn.c_str(),
-							obj->get_class().c_str(),
-							inst_id);
-
-	if (base_file_path != "") {
-		ss << base_file_path << fqn;
-		removedir_all(ss.str());
+	//Release the reference held by the RIB once no reader can find the
+	//objects. Grace periods are waited for in place every RIB_RCU_BATCH
+	//removed objects, the reclaimer releases smaller batches after
+	//RIB_RCU_DELAY_MS. Objects still being operated on are deleted when
+	//the operation releases them
+	for(it = objs.begin(); it != objs.end(); ++it)
+		rcu.retire(*it, release_obj);
+
+	if (__atomic_add_fetch(&retired_objs, objs.size(), __ATOMIC_RELAXED)
+			< RIB_RCU_BATCH) {
+		reclaimer.kick();
+		return;
 	}
 
-	rwlock.unlock();
-
-	//Delete object
-	delete obj;
-	delete child_list;
+	__atomic_store_n(&retired_objs, 0, __ATOMIC_RELAXED);
+	rcu.synchronize();
 }
 
 char RIB::get_separator() const {
@@ -1703,9 +1977,7 @@ std::string RIB::get_parent_fqn(const std::string& fqn_child) const {
 
 std::string RIB::get_obj_class(const int64_t inst_id){
 
-
-	//Mutual exclusion
-	ReadScopedLock rlock(rwlock);
+	RCUReadScopedLock rlock(rcu);
 
 	return __get_obj_class(inst_id);
 }
@@ -1732,17 +2004,24 @@ std::list<RIBObjectData> RIB::get_all_rib_objects_data(
 	std::list<RIBObjectData> result;
 	RIBObjectData data;
 	unsigned n = name.size();
+	RIBObj *obj, *next;
+	int depth = 0;
+
+	//Walk the whole tree, holding a reference only to the current and
+	//next objects (get_displayable_value() may take other locks)
+	get_ref(root);
+	for (obj = root; obj; obj = next) {
+		ObjRef ref(this, obj);
 
-	for (std::map<std::string, RIBObj*>::iterator it = obj_name_map.begin();
-			it != obj_name_map.end(); ++it) {
-		data = it->second->get_object_data();
+		next = get_next_in_scope(root, obj, INT_MAX, depth);
+		data = obj->get_object_data();
 		if (class_.size() && class_ != data.class_)
 			continue;
 		if (n && (name[n-1] == '/' ? data.name_.compare(0, n, name)
 					   : data.name_ != name))
 			continue;
-		if (it->first != "/")
-			data.instance_ = __get_obj_inst_id(data.name_);
+		if (obj != root)
+			data.instance_ = obj->inst_id;
 		result.push_back(data);
 	}
 
@@ -22,6 +22,8 @@
 
 #include <iostream>
 #include <math.h>
+#include <set>
+#include <sys/time.h>
 #include <unistd.h>
 
 #include "librina/concurrency.h"
@@ -29,6 +31,11 @@
 #define NUM_THREADS 5
 #define TRIGGER     10
 
+/* Contention benchmarks */
+#define BENCH_THREADS 4
+#define BENCH_ITEMS   50000
+#define BENCH_KEYS    1024
+
 using namespace rina;
 
 void * doWork(void * arg) {
@@ -182,6 +189,11 @@ public:
 	}
 };
 
+static bool isJohn(const Person * person)
+{
+	return person->getName() == "John";
+}
+
 class QueueWithCounter{
 	BlockingFIFOQueue<Person> * queue;
 	ReadWriteLockableCounter * counter;
@@ -233,6 +245,145 @@ void * doWorkConsume(void * arg)
 	return (void *) 0;
 }
 
+long elapsed_us(const struct timeval& start)
+{
+	struct timeval now;
+
+	gettimeofday(&now, 0);
+	return (now.tv_sec - start.tv_sec) * 1000000L +
+		(now.tv_usec - start.tv_usec);
+}
+
+/* Producers put BENCH_ITEMS elements each, consumers take them back */
+template <class Q> struct QueueBench {
+	Q * queue;
+	intptr_t item;
+	long consumed;
+	Lockable lock;
+
+	static void * produce(void * arg)
+	{
+		QueueBench<Q> * bench = (QueueBench<Q> *) arg;
+
+		for (int i = 0; i < BENCH_ITEMS; i++)
+			bench->queue->put((intptr_t *) &bench->item);
+
+		return (void *) 0;
+	}
+
+	static void * consume(void * arg)
+	{
+		QueueBench<Q> * bench = (QueueBench<Q> *) arg;
+		long count = 0;
+
+		for (int i = 0; i < BENCH_ITEMS; i++)
+			if (bench->queue->take() == &bench->item)
+				count++;
+
+		bench->lock.lock();
+		bench->consumed += count;
+		bench->lock.unlock();
+
+		return (void *) 0;
+	}
+
+	static bool run(const std::string& name, Q * q)
+	{
+		Thread * threads[2 * BENCH_THREADS];
+		QueueBench<Q> bench;
+		struct timeval start;
+		void * status;
+		long us;
+
+		bench.queue = q;
+		bench.consumed = 0;
+		gettimeofday(&start, 0);
+		for (int i = 0; i < BENCH_THREADS; i++) {
+			threads[i] = new Thread(&consume, (void *) &bench,
+						"consumer", false);
+			threads[i]->start();
+			threads[BENCH_THREADS + i] = new Thread(&produce,
+								(void *) &bench,
+								"producer", false);
+			threads[BENCH_THREADS + i]->start();
+		}
+
+		for (int i = 0; i < 2 * BENCH_THREADS; i++) {
+			threads[i]->join(&status);
+			delete threads[i];
+		}
+		us = elapsed_us(start);
+
+		std::cout << name << ": " << BENCH_THREADS * BENCH_ITEMS
+			  << " elements, " << BENCH_THREADS << " producers, "
+			  << BENCH_THREADS << " consumers: " << us << " us ("
+			  << (us * 1000.0) / (BENCH_THREADS * BENCH_ITEMS)
+			  << " ns/element)\n";
+
+		return bench.consumed == BENCH_THREADS * BENCH_ITEMS;
+	}
+};
+
+/* Each thread does 90% lookups and 10% updates over BENCH_KEYS keys */
+template <class M> struct MapBench {
+	M * map;
+	int values[BENCH_KEYS];
+
+	static void * work(void * arg)
+	{
+		MapBench<M> * bench = (MapBench<M> *) arg;
+		unsigned int seed = (unsigned int) (intptr_t) &seed;
+		long misses = 0;
+		int key;
+
+		for (int i = 0; i < BENCH_ITEMS; i++) {
+			key = rand_r(&seed) % BENCH_KEYS;
+			if (i % 10 == 0)
+				bench->map->put(key, &bench->values[key]);
+			else if (bench->map->find(key) != &bench->values[key])
+				misses++;
+		}
+
+		return (void *) misses;
+	}
+
+	static bool run(const std::string& name, M * m)
+	{
+		Thread * threads[BENCH_THREADS];
+		MapBench<M> bench;
+		struct timeval start;
+		void * status;
+		bool result = true;
+		long us;
+
+		bench.map = m;
+		for (int i = 0; i < BENCH_KEYS; i++)
+			m->put(i, &bench.values[i]);
+
+		gettimeofday(&start, 0);
+		for (int i = 0; i < BENCH_THREADS; i++) {
+			threads[i] = new Thread(&work, (void *) &bench,
+						"map-bench", false);
+			threads[i]->start();
+		}
+
+		for (int i = 0; i < BENCH_THREADS; i++) {
+			threads[i]->join(&status);
+			if (status != 0)
+				result = false;
+			delete threads[i];
+		}
+		us = elapsed_us(start);
+
+		std::cout << name << ": " << BENCH_THREADS * BENCH_ITEMS
+			  << " operations, " << BENCH_THREADS << " threads: "
+			  << us << " us (" << (us * 1000.0) / (BENCH_THREADS * BENCH_ITEMS)
+			  << " ns/operation)\n";
+
+		return result;
+	}
+};
+
 int main()
 {
 	std::cout << "TESTING CONCURRENCY WRAPPER CLASSES\n";
@@ -380,6 +531,77 @@ int main()
 	delete counter2;
 	delete queueWithCounter;
 
+	/* Test the size of the blocking queue */
+	BlockingFIFOQueue<Person> * fifoQueue = new BlockingFIFOQueue<Person>();
+	Person * person = new Person("John", "Smith");
+	for (int i = 0; i < 4; i++)
+		fifoQueue->put(person);
+	if (fifoQueue->size() != 4) {
+		std::cout << "Error, queue should have 4 elements\n";
+		return -1;
+	}
+	for (int i = 0; i < 4; i++)
+		fifoQueue->take();
+	delete fifoQueue;
+	delete person;
+
+	/* Test concurrent hash map */
+	ConcurrentHashMap<std::string, Person> personMap;
+	personMap.put("john", new Person("John", "Smith"));
+	personMap.put("jane", new Person("Jane", "Doe"));
+	Person copy;
+	if (!personMap.find_copy("jane", copy) || copy.getName() != "Jane" ||
+			personMap.size() != 2 || personMap.find("joe") != 0) {
+		std::cout << "Error, wrong contents of concurrent hash map\n";
+		return -1;
+	}
+	delete personMap.erase("john");
+	if (personMap.getKeys().size() != 1) {
+		std::cout << "Error, element not erased from concurrent hash map\n";
+		return -1;
+	}
+	bool found;
+	if (personMap.erase_if("jane", isJohn, found) != 0 || !found ||
+			personMap.erase_if("john", isJohn, found) != 0 || found ||
+			personMap.size() != 1) {
+		std::cout << "Error, conditional erase of concurrent hash map\n";
+		return -1;
+	}
+	personMap.deleteValues();
+
+	/* Keys that only differ in their high bits must not share a stripe */
+	ConcurrentHash<int> intHash;
+	std::set<uint32_t> usedStripes;
+	for (int i = 0; i < 16; i++)
+		usedStripes.insert(intHash(i << 16) & 15);
+	if (usedStripes.size() < 8) {
+		std::cout << "Error, only " << usedStripes.size()
+			  << " stripes used by 16 keys\n";
+		return -1;
+	}
+
+	/* Contention benchmarks */
+	BlockingFIFOQueue<intptr_t> blockingQueue;
+	if (!QueueBench<BlockingFIFOQueue<intptr_t> >::run("BlockingFIFOQueue",
+							   &blockingQueue)) {
+		std::cout << "Error, elements lost in BlockingFIFOQueue\n";
+		return -1;
+	}
+
+	ThreadSafeMapOfPointers<int, int> safeMap;
+	if (!MapBench<ThreadSafeMapOfPointers<int, int> >::run("ThreadSafeMapOfPointers",
+							      &safeMap)) {
+		std::cout << "Error, wrong lookups in ThreadSafeMapOfPointers\n";
+		return -1;
+	}
+
+	ConcurrentHashMap<int, int> concurrentMap;
+	if (!MapBench<ConcurrentHashMap<int, int> >::run("ConcurrentHashMap",
+							 &concurrentMap)) {
+		std::cout << "Error, wrong lookups in ConcurrentHashMap\n";
+		return -1;
+	}
+
 	/* Test exit */
 	Thread::exit(NULL);
 	/*
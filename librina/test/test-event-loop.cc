@@ -0,0 +1,187 @@
+//
+// Event loop test
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+// MA  02110-1301  USA
+//
+
+#include <iostream>
+#include <stdexcept>
+#include <unistd.h>
+
+#include "librina/event-loop.h"
+
+#define NUM_PIPES 200
+#define NUM_MSGS  5
+
+using namespace rina;
+
+/// Reads from a pipe until EOF, like the SDU readers of flows do
+class PipeReader : public EventHandler {
+public:
+	PipeReader() : bytes(0), eof(false) { };
+
+	bool handle_event(int fd, uint32_t events)
+	{
+		char buffer[64];
+		int n;
+
+		n = read(fd, buffer, sizeof(buffer));
+		if (n <= 0) {
+			eof = true;
+			return false;
+		}
+
+		lock.lock();
+		bytes += n;
+		lock.unlock();
+
+		return true;
+	}
+
+	int get_bytes()
+	{
+		ScopedLock g(lock);
+		return bytes;
+	}
+
+	int bytes;
+	bool eof;
+	Lockable lock;
+};
+
+class CountingHandler : public EventHandler {
+public:
+	CountingHandler() : count(0) { };
+
+	bool handle_event(int fd, uint32_t events)
+	{
+		ScopedLock g(lock);
+		count++;
+		return true;
+	}
+
+	int get_count()
+	{
+		ScopedLock g(lock);
+		return count;
+	}
+
+	int count;
+	Lockable lock;
+};
+
+/// Counts its events, and fails every one of them
+class ThrowingHandler : public CountingHandler {
+public:
+	bool handle_event(int fd, uint32_t events)
+	{
+		CountingHandler::handle_event(fd, events);
+		throw std::runtime_error("handler failed");
+	}
+};
+
+int main()
+{
+	EventLoop loop("test-event-loop", 4);
+	PipeReader readers[NUM_PIPES];
+	CountingHandler timer_handler;
+	CountingHandler notif_handler;
+	ThrowingHandler throwing_handler;
+	int pipes[NUM_PIPES][2];
+	int tfd, efd;
+	int result = 0;
+	Sleep sleep;
+
+	loop.start();
+
+	std::cout << "TEST 1: " << NUM_PIPES << " pipes served by 4 workers"
+		  << std::endl;
+	for (int i = 0; i < NUM_PIPES; i++) {
+		if (pipe(pipes[i])) {
+			std::cout << "Cannot create pipe" << std::endl;
+			return -1;
+		}
+		loop.add_fd(pipes[i][0], &readers[i]);
+	}
+
+	for (int j = 0; j < NUM_MSGS; j++)
+		for (int i = 0; i < NUM_PIPES; i++)
+			if (write(pipes[i][1], "hello", 5) != 5)
+				return -1;
+
+	for (int i = 0; i < NUM_PIPES; i++)
+		close(pipes[i][1]);
+
+	sleep.sleepForMili(500);
+
+	for (int i = 0; i < NUM_PIPES; i++) {
+		if (readers[i].get_bytes() != 5 * NUM_MSGS || !readers[i].eof) {
+			std::cout << "TEST 1 FAILED: reader " << i << " got "
+				  << readers[i].get_bytes() << " bytes" << std::endl;
+			result = -1;
+			break;
+		}
+	}
+
+	if (loop.get_num_fds() != 0) {
+		std::cout << "TEST 1 FAILED: " << loop.get_num_fds()
+			  << " fds still registered" << std::endl;
+		result = -1;
+	}
+
+	for (int i = 0; i < NUM_PIPES; i++)
+		close(pipes[i][0]);
+
+	std::cout << "TEST 2: periodic timer and notifier" << std::endl;
+	tfd = loop.add_timer(&timer_handler, 10, 10);
+	efd = loop.add_notifier(&notif_handler);
+	EventLoop::notify(efd);
+	sleep.sleepForMili(200);
+	loop.remove_and_close(tfd);
+	loop.remove_and_close(efd);
+
+	if (timer_handler.get_count() < 5 || notif_handler.get_count() != 1) {
+		std::cout << "TEST 2 FAILED: timer fired "
+			  << timer_handler.get_count() << " times, notifier "
+			  << notif_handler.get_count() << " times" << std::endl;
+		result = -1;
+	}
+
+	loop.stop();
+
+	std::cout << "TEST 3: restart, with a handler that throws"
+		  << std::endl;
+	loop.start();
+	efd = loop.add_notifier(&throwing_handler);
+	EventLoop::notify(efd);
+	sleep.sleepForMili(100);
+	EventLoop::notify(efd);
+	sleep.sleepForMili(100);
+	loop.remove_and_close(efd);
+	loop.stop();
+
+	if (throwing_handler.get_count() != 2) {
+		std::cout << "TEST 3 FAILED: handler called "
+			  << throwing_handler.get_count() << " times"
+			  << std::endl;
+		result = -1;
+	}
+
+	if (result == 0)
+		std::cout << "EVENT LOOP TESTS PASSED" << std::endl;
+
+	return result;
+}
@@ -3275,6 +3275,9 @@ int main()
 	result = test_irati_kmsg_multi_msg(RINA_C_IPCP_DEALLOCATE_PORT_RESPONSE);
 	if (result < 0) return result;
 
+	result = test_irati_kmsg_multi_msg(RINA_C_IPCP_N1_PORT_LIVENESS_NOTIF);
+	if (result < 0) return result;
+
 	result = test_irati_msg_base(RINA_C_IPCM_FINALIZE_REQUEST);
 	if (result < 0) return result;
 
@@ -0,0 +1,294 @@
+//
+// RIB tests and benchmarks
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+// MA  02110-1301  USA
+//
+
+#include <iostream>
+#include <sstream>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#include "librina/concurrency.h"
+#include "librina/rib_v2.h"
+
+#define NUM_OBJS      50000
+#define NUM_READERS   4
+#define NUM_LOOKUPS   50000
+#define NUM_UPDATES   5000
+
+using namespace rina;
+
+namespace rina { namespace rib {
+	// Entry point of incoming CDAP requests, not exported in the headers
+	cdap::CDAPCallbackInterface* __get_rib_provider();
+} }
+
+/// Counts the remote reads it receives, and the instances alive
+class CountingObj : public rib::RIBObj {
+public:
+	CountingObj() : rib::RIBObj("Counting") {
+		__atomic_add_fetch(&alive, 1, __ATOMIC_RELAXED);
+	};
+
+	~CountingObj() {
+		__atomic_sub_fetch(&alive, 1, __ATOMIC_RELAXED);
+	};
+
+	void read(const cdap_rib::con_handle_t &con,
+		  const std::string& fqn,
+		  const std::string& class_,
+		  const cdap_rib::filt_info_t &filt,
+		  const int invoke_id,
+		  cdap_rib::obj_info_t &obj_reply,
+		  cdap_rib::res_info_t& res)
+	{
+		__atomic_add_fetch(&reads, 1, __ATOMIC_RELAXED);
+		res.code_ = cdap_rib::CDAP_SUCCESS;
+	};
+
+	static int reads;
+	static int alive;
+};
+
+int CountingObj::reads = 0;
+int CountingObj::alive = 0;
+
+struct BenchContext {
+	rib::RIBDaemonProxy * ribd;
+	rib::rib_handle_t rib;
+	long errors;
+	Lockable lock;
+};
+
+long elapsed_us(const struct timeval& start)
+{
+	struct timeval now;
+
+	gettimeofday(&now, 0);
+	return (now.tv_sec - start.tv_sec) * 1000000L +
+		(now.tv_usec - start.tv_usec);
+}
+
+std::string obj_name(const std::string& subtree, int i)
+{
+	std::stringstream ss;
+
+	ss << "/" << subtree << "/entry-" << i;
+	return ss.str();
+}
+
+void add_object(BenchContext * ctx, const std::string& name)
+{
+	CountingObj * obj = new CountingObj();
+
+	try {
+		ctx->ribd->addObjRIB(ctx->rib, name, &obj);
+	} catch (rib::eObjExists &e) {
+		delete obj;
+		throw;
+	}
+}
+
+void * do_lookups(void * arg)
+{
+	BenchContext * ctx = (BenchContext *) arg;
+	unsigned int seed = (unsigned int) (intptr_t) &seed;
+	long errors = 0;
+
+	for (int i = 0; i < NUM_LOOKUPS; i++) {
+		try {
+			ctx->ribd->getObjInstId(ctx->rib,
+						obj_name("dft",
+							 rand_r(&seed) % NUM_OBJS));
+		} catch (rib::eObjDoesNotExist &e) {
+			errors++;
+		}
+	}
+
+	ctx->lock.lock();
+	ctx->errors += errors;
+	ctx->lock.unlock();
+
+	return (void *) 0;
+}
+
+void * do_updates(void * arg)
+{
+	BenchContext * ctx = (BenchContext *) arg;
+
+	for (int i = 0; i < NUM_UPDATES; i++)
+		add_object(ctx, obj_name("fsodb", i));
+
+	for (int i = 0; i < NUM_UPDATES; i++)
+		ctx->ribd->removeObjRIB(ctx->rib, obj_name("fsodb", i));
+
+	return (void *) 0;
+}
+
+void scoped_read(const std::string& name, int scope)
+{
+	cdap_rib::con_handle_t con;
+	cdap_rib::obj_info_t obj;
+	cdap_rib::filt_info_t filt;
+	cdap_rib::flags_t flags;
+	cdap_rib::auth_policy_t auth;
+
+	obj.name_ = name;
+	obj.class_ = "Counting";
+	filt.scope_ = scope;
+
+	// invoke id 0: no responses are sent
+	rib::__get_rib_provider()->read_request(con, obj, filt, flags, auth, 0);
+}
+
+int main()
+{
+	cdap_rib::cdap_params params;
+	cdap_rib::vers_info_t vers;
+	Thread * threads[NUM_READERS + 1];
+	BenchContext ctx;
+	struct timeval start;
+	void * status;
+	long us;
+
+	params.ipcp = false;
+	rib::init(NULL, params);
+	ctx.ribd = rib::RIBDaemonProxyFactory();
+	ctx.ribd->createSchema(vers);
+	ctx.rib = ctx.ribd->createRIB(vers);
+	ctx.errors = 0;
+
+	add_object(&ctx, "/dft");
+	add_object(&ctx, "/fsodb");
+
+	std::cout << "TEST 1: add " << NUM_OBJS << " objects" << std::endl;
+	gettimeofday(&start, 0);
+	for (int i = 0; i < NUM_OBJS; i++)
+		add_object(&ctx, obj_name("dft", i));
+	us = elapsed_us(start);
+	std::cout << "Added " << NUM_OBJS << " objects in " << us << " us ("
+		  << (us * 1000.0) / NUM_OBJS << " ns/object)" << std::endl;
+
+	try {
+		add_object(&ctx, obj_name("dft", 0));
+		std::cout << "TEST 1 FAILED: duplicated object added" << std::endl;
+		return -1;
+	} catch (rib::eObjExists &e) {
+	}
+
+	std::cout << "TEST 2: " << NUM_READERS << " readers looking up objects "
+		  << "while a writer updates another subtree" << std::endl;
+	gettimeofday(&start, 0);
+	for (int i = 0; i < NUM_READERS; i++) {
+		threads[i] = new Thread(&do_lookups, (void *) &ctx,
+					"rib-reader", false);
+		threads[i]->start();
+	}
+	threads[NUM_READERS] = new Thread(&do_updates, (void *) &ctx,
+					  "rib-writer", false);
+	threads[NUM_READERS]->start();
+
+	for (int i = 0; i <= NUM_READERS; i++) {
+		threads[i]->join(&status);
+		delete threads[i];
+	}
+	us = elapsed_us(start);
+	std::cout << NUM_READERS * NUM_LOOKUPS << " lookups and "
+		  << 2 * NUM_UPDATES << " updates in " << us << " us ("
+		  << (us * 1000.0) / (NUM_READERS * NUM_LOOKUPS)
+		  << " ns/lookup)" << std::endl;
+
+	if (ctx.errors) {
+		std::cout << "TEST 2 FAILED: " << ctx.errors
+			  << " lookups failed" << std::endl;
+		return -1;
+	}
+
+	std::cout << "TEST 3: scoped read of " << NUM_OBJS << " objects"
+		  << std::endl;
+	gettimeofday(&start, 0);
+	scoped_read("/dft", 1);
+	us = elapsed_us(start);
+	std::cout << "Read " << CountingObj::reads << " objects in " << us
+		  << " us" << std::endl;
+
+	if (CountingObj::reads != NUM_OBJS + 1) {
+		std::cout << "TEST 3 FAILED: " << CountingObj::reads
+			  << " objects read" << std::endl;
+		return -1;
+	}
+
+	CountingObj::reads = 0;
+	scoped_read(obj_name("dft", 7), 0);
+	if (CountingObj::reads != 1) {
+		std::cout << "TEST 3 FAILED: scope 0 read " << CountingObj::reads
+			  << " objects" << std::endl;
+		return -1;
+	}
+
+	std::cout << "TEST 4: remove subtree" << std::endl;
+	try {
+		ctx.ribd->removeObjRIB(ctx.rib, "/dft");
+		std::cout << "TEST 4 FAILED: object with children removed"
+			  << std::endl;
+		return -1;
+	} catch (rib::eObjHasChildren &e) {
+	}
+
+	gettimeofday(&start, 0);
+	ctx.ribd->removeObjRIB(ctx.rib, "/dft", true);
+	us = elapsed_us(start);
+	std::cout << "Removed " << NUM_OBJS + 1 << " objects in " << us
+		  << " us" << std::endl;
+
+	if (ctx.ribd->containsObj(ctx.rib, obj_name("dft", 3)) ||
+			ctx.ribd->get_rib_objects_data(ctx.rib).size() != 2) {
+		std::cout << "TEST 4 FAILED: objects left in the RIB" << std::endl;
+		return -1;
+	}
+
+	std::cout << "TEST 5: release of a few removed objects" << std::endl;
+	add_object(&ctx, obj_name("fsodb", 0));
+	ctx.ribd->removeObjRIB(ctx.rib, obj_name("fsodb", 0));
+
+	// Only "/fsodb" is left once the reclaimer waits for a grace period
+	Sleep sleep;
+	for (int i = 0; i < 50 &&
+			__atomic_load_n(&CountingObj::alive, __ATOMIC_RELAXED) > 1; i++)
+		sleep.sleepForMili(20);
+
+	if (CountingObj::alive != 1) {
+		std::cout << "TEST 5 FAILED: " << CountingObj::alive - 1
+			  << " removed objects not released" << std::endl;
+		return -1;
+	}
+
+	std::cout << "TEST 6: destroy RIB" << std::endl;
+	ctx.ribd->destroyRIB(ctx.rib);
+	if (CountingObj::alive) {
+		std::cout << "TEST 6 FAILED: " << CountingObj::alive
+			  << " objects not released" << std::endl;
+		return -1;
+	}
+
+	delete ctx.ribd;
+	rib::fini();
+
+	std::cout << "RIB TESTS PASSED" << std::endl;
+
+	return 0;
+}
@@ -0,0 +1,586 @@
+/*
+ * RMT CoDel PS, sojourn-time based AQM (RFC 8289) with an optional
+ * flow-queue variant (RFC 8290)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include <linux/export.h>
+#include <linux/module.h>
+#include <linux/string.h>
+#include <linux/list.h>
+#include <linux/ktime.h>
+#include <linux/jhash.h>
+#include <linux/math64.h>
+#include <linux/kernel.h>
+
+#define RINA_PREFIX "rmt-codel"
+
+#include "logs.h"
+#include "rds/rmem.h"
+#include "rds/robjects.h"
+#include "rmt-ps.h"
+#include "policies.h"
+
+#define CODEL_TARGET_US_DEFAULT   5000
+#define CODEL_INTERVAL_US_DEFAULT 100000
+#define CODEL_LIMIT_DEFAULT       1000
+#define CODEL_QUANTUM_DEFAULT     1500
+#define CODEL_MAX_FLOWS           1024
+
+struct codel_vars {
+	unsigned int count;
+	unsigned int lastcount;
+	bool         dropping;
+	u64          first_above_time;
+	u64          drop_next;
+};
+
+struct codel_flow {
+	/* PDUs, linked by du->list */
+	struct list_head  pdus;
+	/* Linkage in the new or old flows list, empty when idle */
+	struct list_head  flowchain;
+	int               deficit;
+	struct codel_vars cvars;
+};
+
+struct codel_rmt_queue {
+	port_id_t          port_id;
+	/* Management PDUs bypass the AQM and go first */
+	struct list_head   mgmt;
+	unsigned int       nflows;
+	struct codel_flow * flows;
+	struct list_head   new_flows;
+	struct list_head   old_flows;
+	/* Data PDUs queued in all the flows */
+	unsigned int       qlen;
+
+	unsigned int       codel_drops;
+	unsigned int       codel_marks;
+	unsigned int       overlimit_drops;
+	u64                last_sojourn_ns;
+	struct robject     robj;
+};
+
+struct codel_rmt_ps_data {
+	u64          target_ns;
+	u64          interval_ns;
+	unsigned int limit;
+	/* 0 means a single CoDel queue per N-1 port */
+	unsigned int flows;
+	unsigned int quantum;
+	/* Mark DT PDUs with the congestion flag instead of dropping them */
+	bool         ecn;
+};
+
+static ssize_t codel_queue_attr_show(struct robject *        robj,
+				     struct robj_attribute * attr,
+				     char *                  buf)
+{
+	struct codel_rmt_queue * q;
+
+	q = container_of(robj, struct codel_rmt_queue, robj);
+
+	if (strcmp(robject_attr_name(attr), "flows") == 0)
+		return sprintf(buf, "%u\n", q->nflows);
+	if (strcmp(robject_attr_name(attr), "queued_pdus") == 0)
+		return sprintf(buf, "%u\n", q->qlen);
+	if (strcmp(robject_attr_name(attr), "codel_drops") == 0)
+		return sprintf(buf, "%u\n", q->codel_drops);
+	if (strcmp(robject_attr_name(attr), "codel_marks") == 0)
+		return sprintf(buf, "%u\n", q->codel_marks);
+	if (strcmp(robject_attr_name(attr), "overlimit_drops") == 0)
+		return sprintf(buf, "%u\n", q->overlimit_drops);
+	if (strcmp(robject_attr_name(attr), "last_sojourn_us") == 0)
+		return sprintf(buf, "%llu\n",
+			       div_u64(q->last_sojourn_ns, NSEC_PER_USEC));
+
+	return 0;
+}
+RINA_SYSFS_OPS(codel_queue);
+RINA_ATTRS(codel_queue, flows, queued_pdus, codel_drops, codel_marks,
+	   overlimit_drops, last_sojourn_us);
+RINA_KTYPE(codel_queue);
+
+static void codel_pdus_flush(struct list_head * pdus)
+{
+	struct du * du, * next;
+
+	list_for_each_entry_safe(du, next, pdus, list) {
+		list_del_init(&du->list);
+		du_destroy(du);
+	}
+}
+
+static int codel_queue_destroy(struct codel_rmt_queue * q)
+{
+	unsigned int i;
+
+	if (!q) {
+		LOG_ERR("No RMT CoDel queue to destroy...");
+		return -1;
+	}
+
+	robject_del(&q->robj);
+
+	codel_pdus_flush(&q->mgmt);
+	if (q->flows) {
+		for (i = 0; i < q->nflows; i++)
+			codel_pdus_flush(&q->flows[i].pdus);
+		rkfree(q->flows);
+	}
+
+	rkfree(q);
+
+	return 0;
+}
+
+static struct codel_rmt_queue * codel_queue_create(struct rmt_n1_port * port,
+						   unsigned int         flows)
+{
+	struct codel_rmt_queue * tmp;
+	unsigned int             i;
+
+	tmp = rkzalloc(sizeof(*tmp), GFP_ATOMIC);
+	if (!tmp)
+		return NULL;
+
+	tmp->port_id = port->port_id;
+	tmp->nflows  = flows ? flows : 1;
+	INIT_LIST_HEAD(&tmp->mgmt);
+	INIT_LIST_HEAD(&tmp->new_flows);
+	INIT_LIST_HEAD(&tmp->old_flows);
+
+	tmp->flows = rkzalloc(tmp->nflows * sizeof(*tmp->flows), GFP_ATOMIC);
+	if (!tmp->flows) {
+		rkfree(tmp);
+		return NULL;
+	}
+
+	for (i = 0; i < tmp->nflows; i++) {
+		INIT_LIST_HEAD(&tmp->flows[i].pdus);
+		INIT_LIST_HEAD(&tmp->flows[i].flowchain);
+	}
+
+	if (robject_init_and_add(&tmp->robj, &codel_queue_rtype, &port->robj,
+				 "codel")) {
+		LOG_ERR("Failed to create CoDel sysfs object");
+		rkfree(tmp->flows);
+		rkfree(tmp);
+		return NULL;
+	}
+
+	return tmp;
+}
+
+static unsigned int codel_flow_hash(struct codel_rmt_queue * q,
+				    const struct du *        du)
+{
+	u32 hash;
+
+	if (q->nflows == 1)
+		return 0;
+
+	hash = jhash_3words((u32) pci_destination(&du->pci),
+			    (u32) pci_qos_id(&du->pci),
+			    (u32) pci_cep_destination(&du->pci), 0);
+
+	return reciprocal_scale(hash, q->nflows);
+}
+
+static u64 codel_control_law(u64 t, u64 interval_ns, unsigned int count)
+{ return t + div64_u64(interval_ns, int_sqrt(count)); }
+
+/* Pops the head of the flow and tells if its sojourn time allows a drop */
+static struct du * codel_do_dequeue(struct codel_rmt_ps_data * data,
+				    struct codel_rmt_queue *   q,
+				    struct codel_flow *        f,
+				    u64                        now,
+				    bool *                     ok_to_drop)
+{
+	struct du * du;
+	u64         sojourn;
+
+	*ok_to_drop = false;
+
+	if (list_empty(&f->pdus)) {
+		f->cvars.first_above_time = 0;
+		return NULL;
+	}
+
+	du = list_first_entry(&f->pdus, struct du, list);
+	list_del_init(&du->list);
+	q->qlen--;
+
+	sojourn = now - ktime_to_ns(du->enqueue_time);
+	q->last_sojourn_ns = sojourn;
+
+	/* Do not drop while the queue is about to drain */
+	if (sojourn < data->target_ns || list_empty(&f->pdus)) {
+		f->cvars.first_above_time = 0;
+	} else if (!f->cvars.first_above_time) {
+		f->cvars.first_above_time = now + data->interval_ns;
+	} else if (now >= f->cvars.first_above_time) {
+		*ok_to_drop = true;
+	}
+
+	return du;
+}
+
+/* Returns true if the PDU got marked and has still to be sent */
+static bool codel_signal(struct codel_rmt_ps_data * data,
+			 struct codel_rmt_queue *   q,
+			 struct rmt_n1_port *       port,
+			 struct du *                du)
+{
+	if (data->ecn && pci_type(&du->pci) == PDU_TYPE_DT) {
+		pci_flags_set(&du->pci, pci_flags_get(&du->pci) |
+			      PDU_FLAGS_EXPLICIT_CONGESTION);
+		q->codel_marks++;
+		return true;
+	}
+
+	rmt_n1port_drop_queued(port, du);
+	q->codel_drops++;
+
+	return false;
+}
+
+static struct du * codel_dequeue(struct codel_rmt_ps_data * data,
+				 struct codel_rmt_queue *   q,
+				 struct rmt_n1_port *       port,
+				 struct codel_flow *        f)
+{
+	struct codel_vars * cv = &f->cvars;
+	struct du *         du;
+	u64                 now = ktime_get_ns();
+	unsigned int        delta;
+	bool                ok_to_drop;
+
+	du = codel_do_dequeue(data, q, f, now, &ok_to_drop);
+	if (!du) {
+		cv->dropping = false;
+		return NULL;
+	}
+
+	if (cv->dropping) {
+		if (!ok_to_drop) {
+			cv->dropping = false;
+			return du;
+		}
+
+		while (now >= cv->drop_next && cv->dropping) {
+			cv->count++;
+			if (codel_signal(data, q, port, du)) {
+				cv->drop_next = codel_control_law(cv->drop_next,
+								  data->interval_ns,
+								  cv->count);
+				return du;
+			}
+
+			du = codel_do_dequeue(data, q, f, now, &ok_to_drop);
+			if (!du) {
+				cv->dropping = false;
+				return NULL;
+			}
+			if (!ok_to_drop)
+				cv->dropping = false;
+			else
+				cv->drop_next = codel_control_law(cv->drop_next,
+								  data->interval_ns,
+								  cv->count);
+		}
+	} else if (ok_to_drop) {
+		/* Resume close to the last drop rate if it was recent */
+		delta = cv->count - cv->lastcount;
+		cv->count = 1;
+		if (delta > 1 &&
+		    (s64) (now - cv->drop_next) < 16 * (s64) data->interval_ns)
+			cv->count = delta;
+		cv->lastcount = cv->count;
+		cv->dropping  = true;
+		cv->drop_next = codel_control_law(now, data->interval_ns,
+						  cv->count);
+
+		if (!codel_signal(data, q, port, du))
+			du = codel_do_dequeue(data, q, f, now, &ok_to_drop);
+	}
+
+	return du;
+}
+
+static struct du * codel_rmt_dequeue_policy(struct rmt_ps *      ps,
+					    struct rmt_n1_port * port)
+{
+	struct codel_rmt_ps_data * data = ps->priv;
+	struct codel_rmt_queue *   q;
+	struct codel_flow *        f;
+	struct list_head *         head;
+	struct du *                du;
+
+	/* NOTE: The policy is called with the n1_port lock taken */
+	q = port->rmt_ps_queues;
+	if (!q) {
+		LOG_ERR("Could not find queue for n1_port %u", port->port_id);
+		return NULL;
+	}
+
+	if (!list_empty(&q->mgmt)) {
+		du = list_first_entry(&q->mgmt, struct du, list);
+		list_del_init(&du->list);
+		return du;
+	}
+
+	/* Deficit round robin, new flows first */
+	for (;;) {
+		head = &q->new_flows;
+		if (list_empty(head)) {
+			head = &q->old_flows;
+			if (list_empty(head))
+				return NULL;
+		}
+
+		f = list_first_entry(head, struct codel_flow, flowchain);
+		if (f->deficit <= 0) {
+			f->deficit += data->quantum;
+			list_move_tail(&f->flowchain, &q->old_flows);
+			continue;
+		}
+
+		du = codel_dequeue(data, q, port, f);
+		if (!du) {
+			/* Keep a new flow in the old list so it can't starve
+			 * the others by coming back as new */
+			if (head == &q->new_flows && !list_empty(&q->old_flows))
+				list_move_tail(&f->flowchain, &q->old_flows);
+			else
+				list_del_init(&f->flowchain);
+			continue;
+		}
+
+		f->deficit -= du_len(du);
+		return du;
+	}
+}
+
+static int codel_rmt_enqueue_policy(struct rmt_ps *      ps,
+				    struct rmt_n1_port * port,
+				    struct du *          du,
+				    bool                 must_enqueue)
+{
+	struct codel_rmt_ps_data * data = ps->priv;
+	struct codel_rmt_queue *   q;
+	struct codel_flow *        f;
+
+	q = port->rmt_ps_queues;
+	if (!q) {
+		LOG_ERR("Could not find queue for n1_port %u", port->port_id);
+		du_destroy(du);
+		return RMT_PS_ENQ_ERR;
+	}
+
+	/* Nothing is queued, no sojourn time to account */
+	if (!must_enqueue)
+		return RMT_PS_ENQ_SEND;
+
+	if (pdu_type_is_mgmt(pci_type(&du->pci))) {
+		list_add_tail(&du->list, &q->mgmt);
+		return RMT_PS_ENQ_SCHED;
+	}
+
+	if (q->qlen >= data->limit) {
+		q->overlimit_drops++;
+		du_destroy(du);
+		return RMT_PS_ENQ_DROP;
+	}
+
+	f = &q->flows[codel_flow_hash(q, du)];
+	du->enqueue_time = ktime_get();
+	list_add_tail(&du->list, &f->pdus);
+	q->qlen++;
+
+	if (list_empty(&f->flowchain)) {
+		list_add_tail(&f->flowchain, &q->new_flows);
+		f->deficit = data->quantum;
+	}
+
+	return RMT_PS_ENQ_SCHED;
+}
+
+static void * codel_rmt_q_create_policy(struct rmt_ps *      ps,
+					struct rmt_n1_port * port)
+{
+	struct codel_rmt_ps_data * data = ps->priv;
+	struct codel_rmt_queue *   q;
+
+	q = codel_queue_create(port, data->flows);
+	if (!q) {
+		LOG_ERR("Could not create queue for n1_port %u",
+			port->port_id);
+		return NULL;
+	}
+
+	return q;
+}
+
+static int codel_rmt_q_destroy_policy(struct rmt_ps *      ps,
+				      struct rmt_n1_port * port)
+{
+	struct codel_rmt_queue * q = port->rmt_ps_queues;
+
+	if (!q) {
+		LOG_ERR("Could not find queue for n1_port %u", port->port_id);
+		return -1;
+	}
+
+	return codel_queue_destroy(q);
+}
+
+static int codel_rmt_ps_set_policy_set_param(struct ps_base * bps,
+					     const char *     name,
+					     const char *     value)
+{
+	struct rmt_ps *            ps = container_of(bps, struct rmt_ps, base);
+	struct codel_rmt_ps_data * data = ps->priv;
+	unsigned int               uval;
+
+	if (!name) {
+		LOG_ERR("Null parameter name");
+		return -1;
+	}
+
+	if (!value) {
+		LOG_ERR("Null parameter value");
+		return -1;
+	}
+
+	if (kstrtouint(value, 10, &uval)) {
+		LOG_ERR("Invalid value '%s' for parameter %s", value, name);
+		return -1;
+	}
+
+	if (strcmp(name, "target_us") == 0) {
+		data->target_ns = (u64) uval * NSEC_PER_USEC;
+	} else if (strcmp(name, "interval_us") == 0) {
+		if (!uval) {
+			LOG_ERR("The CoDel interval cannot be 0");
+			return -1;
+		}
+		data->interval_ns = (u64) uval * NSEC_PER_USEC;
+	} else if (strcmp(name, "limit") == 0) {
+		data->limit = uval;
+	} else if (strcmp(name, "flows") == 0) {
+		/* Only taken by the N-1 ports bound from now on */
+		if (uval > CODEL_MAX_FLOWS) {
+			LOG_ERR("At most %d flows per port", CODEL_MAX_FLOWS);
+			return -1;
+		}
+		data->flows = uval;
+	} else if (strcmp(name, "quantum") == 0) {
+		if (!uval) {
+			LOG_ERR("The DRR quantum cannot be 0");
+			return -1;
+		}
+		data->quantum = uval;
+	} else if (strcmp(name, "ecn") == 0) {
+		data->ecn = uval ? true : false;
+	} else {
+		LOG_ERR("Unknown RMT CoDel PS parameter %s", name);
+		return -1;
+	}
+
+	return 0;
+}
+
+static void codel_rmt_ps_load_param(struct rmt_ps * ps,
+				    const char *    param_name)
+{
+	struct rmt_config *  rmt_cfg;
+	struct policy_parm * ps_param;
+
+	/* This is available at assign-to-dif time but it is not
+	 * available at select-policy-set time. */
+	rmt_cfg = rmt_config_get(ps->dm);
+	if (!rmt_cfg)
+		return;
+
+	ps_param = policy_param_find(rmt_cfg->policy_set, param_name);
+	if (!ps_param)
+		return;
+
+	codel_rmt_ps_set_policy_set_param(&ps->base,
+					  policy_param_name(ps_param),
+					  policy_param_value(ps_param));
+}
+
+static struct ps_base * rmt_ps_codel_create(struct rina_component * component)
+{
+	struct rmt *               rmt = rmt_from_component(component);
+	struct rmt_ps *            ps;
+	struct codel_rmt_ps_data * data;
+
+	ps = rkzalloc(sizeof(*ps), GFP_KERNEL);
+	if (!ps)
+		return NULL;
+
+	data = rkzalloc(sizeof(*data), GFP_KERNEL);
+	if (!data) {
+		rkfree(ps);
+		return NULL;
+	}
+
+	data->target_ns   = (u64) CODEL_TARGET_US_DEFAULT * NSEC_PER_USEC;
+	data->interval_ns = (u64) CODEL_INTERVAL_US_DEFAULT * NSEC_PER_USEC;
+	data->limit       = CODEL_LIMIT_DEFAULT;
+	data->flows       = 0;
+	data->quantum     = CODEL_QUANTUM_DEFAULT;
+	data->ecn         = false;
+
+	ps->base.set_policy_set_param = codel_rmt_ps_set_policy_set_param;
+	ps->dm                        = rmt;
+	ps->priv                      = data;
+
+	codel_rmt_ps_load_param(ps, "target_us");
+	codel_rmt_ps_load_param(ps, "interval_us");
+	codel_rmt_ps_load_param(ps, "limit");
+	codel_rmt_ps_load_param(ps, "flows");
+	codel_rmt_ps_load_param(ps, "quantum");
+	codel_rmt_ps_load_param(ps, "ecn");
+
+	ps->rmt_enqueue_policy   = codel_rmt_enqueue_policy;
+	ps->rmt_dequeue_policy   = codel_rmt_dequeue_policy;
+	ps->rmt_q_create_policy  = codel_rmt_q_create_policy;
+	ps->rmt_q_destroy_policy = codel_rmt_q_destroy_policy;
+
+	return &ps->base;
+}
+
+static void rmt_ps_codel_destroy(struct ps_base * bps)
+{
+	struct rmt_ps * ps = container_of(bps, struct rmt_ps, base);
+
+	if (bps) {
+		if (ps->priv)
+			rkfree(ps->priv);
+		rkfree(ps);
+	}
+}
+
+struct ps_factory rmt_factory = {
+	.owner   = THIS_MODULE,
+	.create  = rmt_ps_codel_create,
+	.destroy = rmt_ps_codel_destroy,
+};
@@ -147,7 +147,7 @@ static int dctcp_rmt_enqueue_policy(struct rmt_ps *ps,
 		pci_flags_set(&du->pci, pci_flags |= PDU_FLAGS_EXPLICIT_CONGESTION);
 		LOG_DBG("Queue length is %u, marked PDU with ECN", qlen);
 	} else if (qlen >= data->q_max) {
-		if (pci_type(&du->pci) != PDU_TYPE_MGMT) {
+		if (!pdu_type_is_mgmt(pci_type(&du->pci))) {
 			du_destroy(du);
 			LOG_INFO("DCTCP RMT: PDU dropped, q_max (%u) reached...",
 					data->q_max);
@@ -0,0 +1,451 @@
+/*
+ * Delay-based congestion control DTCP PS
+ *
+ * The sender estimates the minimum RTT and the bottleneck bandwidth from
+ * the DTCP RTT samples and keeps a Vegas-like window of a few PDUs queued
+ * along the path, never above twice the estimated bandwidth-delay product.
+ * No ECN-marking RMT policy is required.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include <linux/export.h>
+#include <linux/module.h>
+#include <linux/string.h>
+#include <linux/jiffies.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+
+#define RINA_PREFIX "delay-dtcp-ps"
+
+#include "rds/rmem.h"
+#include "rds/robjects.h"
+#include "dtcp-ps.h"
+#include "dtcp-ps-default.h"
+#include "dtcp-conf-utils.h"
+#include "dtp-utils.h"
+#include "policies.h"
+#include "logs.h"
+
+/* Rounds (of one min RTT each) the bottleneck bandwidth is the max of */
+#define DELAY_BW_ROUNDS            10
+#define DELAY_MIN_CWND             2U
+/* Slow start ends once more than this many PDUs are queued */
+#define DELAY_GAMMA                1U
+#define DELAY_ALPHA_DEFAULT        2
+#define DELAY_BETA_DEFAULT         4
+#define DELAY_MIN_RTT_WIN_DEFAULT  10000
+
+enum delay_state {
+	DELAY_SLOW_START,
+	DELAY_CONG_AVOID
+};
+
+struct delay_dtcp_ps_data {
+	/* Bounds of the PDUs the flow keeps queued in the path */
+	uint_t           alpha;
+	uint_t           beta;
+	/* How long (ms) a min RTT sample is trusted */
+	uint_t           min_rtt_win_ms;
+
+	enum delay_state state;
+	uint_t           cwnd;
+
+	/* RTTs in us, min_rtt_stamp in jiffies */
+	uint_t           min_rtt_us;
+	unsigned long    min_rtt_stamp;
+	uint_t           last_rtt_us;
+
+	/* Highest SN known to be delivered */
+	bool             delivered_valid;
+	seq_num_t        delivered_sn;
+
+	/* Current round */
+	u64              round_start_ns;
+	uint_t           round_delivered;
+	uint_t           round_min_rtt_us;
+
+	/* Delivery rates in PDUs/s */
+	u64              rate_samples[DELAY_BW_ROUNDS];
+	uint_t           rate_idx;
+	u64              delivery_rate;
+	u64              btl_bw;
+
+	/* Average size (bytes) of the PDUs sent, and the DTP tx counters
+	 * at the start of the round to measure it */
+	uint_t           pdu_size;
+	unsigned int     round_tx_pdus;
+	unsigned int     round_tx_bytes;
+
+	/* Bytes per time unit, for rate-based flows (as sndr_rate) */
+	uint_t           rate;
+	uint_t           peer_rate;
+
+	struct robject   robj;
+};
+
+static ssize_t delay_cc_attr_show(struct robject *        robj,
+				  struct robj_attribute * attr,
+				  char *                  buf)
+{
+	struct delay_dtcp_ps_data * data;
+
+	data = container_of(robj, struct delay_dtcp_ps_data, robj);
+
+	if (strcmp(robject_attr_name(attr), "cwnd") == 0)
+		return sprintf(buf, "%u\n", data->cwnd);
+	if (strcmp(robject_attr_name(attr), "min_rtt_us") == 0)
+		return sprintf(buf, "%u\n", data->min_rtt_us);
+	if (strcmp(robject_attr_name(attr), "last_rtt_us") == 0)
+		return sprintf(buf, "%u\n", data->last_rtt_us);
+	if (strcmp(robject_attr_name(attr), "delivery_rate") == 0)
+		return sprintf(buf, "%llu\n", data->delivery_rate);
+	if (strcmp(robject_attr_name(attr), "btl_bw") == 0)
+		return sprintf(buf, "%llu\n", data->btl_bw);
+
+	return 0;
+}
+RINA_SYSFS_OPS(delay_cc);
+RINA_ATTRS(delay_cc, cwnd, min_rtt_us, last_rtt_us, delivery_rate, btl_bw);
+RINA_KTYPE(delay_cc);
+
+/* Called with the sv_lock held */
+static void delay_round_start(struct dtcp *                dtcp,
+			      struct delay_dtcp_ps_data * data,
+			      u64                         now)
+{
+	data->round_start_ns   = now;
+	data->round_delivered  = 0;
+	data->round_min_rtt_us = 0;
+	data->round_tx_pdus    = dtcp->parent->sv->stats.tx_pdus;
+	data->round_tx_bytes   = dtcp->parent->sv->stats.tx_bytes;
+}
+
+/* Called with the sv_lock held, once per min RTT */
+static void delay_round_end(struct dtcp_ps *            ps,
+			    struct delay_dtcp_ps_data * data,
+			    u64                         now,
+			    u64                         elapsed)
+{
+	struct dtcp * dtcp = ps->dm;
+	uint_t        queued = 0;
+	uint_t        i;
+	unsigned int  tx_pdus;
+	u64           bdp;
+	u64           rate;
+
+	data->delivery_rate = div64_u64((u64) data->round_delivered *
+					NSEC_PER_SEC, elapsed);
+	data->rate_samples[data->rate_idx] = data->delivery_rate;
+	data->rate_idx = (data->rate_idx + 1) % DELAY_BW_ROUNDS;
+	data->btl_bw = 0;
+	for (i = 0; i < DELAY_BW_ROUNDS; i++)
+		data->btl_bw = max(data->btl_bw, data->rate_samples[i]);
+
+	/* Nothing was delivered, the samples carry no information */
+	if (!data->round_delivered)
+		goto out;
+
+	/* The counters may wrap, their differences are still right */
+	tx_pdus = dtcp->parent->sv->stats.tx_pdus - data->round_tx_pdus;
+	if (tx_pdus)
+		data->pdu_size = (dtcp->parent->sv->stats.tx_bytes -
+				  data->round_tx_bytes) / tx_pdus;
+
+	/* PDUs queued in the path = cwnd * (rtt - min_rtt) / rtt */
+	if (data->round_min_rtt_us > data->min_rtt_us)
+		queued = div_u64((u64) data->cwnd *
+				 (data->round_min_rtt_us - data->min_rtt_us),
+				 data->round_min_rtt_us);
+
+	if (data->state == DELAY_SLOW_START) {
+		if (queued > DELAY_GAMMA) {
+			/* Drain what slow start queued */
+			data->state = DELAY_CONG_AVOID;
+			data->cwnd = data->cwnd > queued ?
+				data->cwnd - queued : DELAY_MIN_CWND;
+		} else {
+			data->cwnd <<= 1;
+		}
+	} else if (queued < data->alpha) {
+		data->cwnd++;
+	} else if (queued > data->beta) {
+		data->cwnd--;
+	}
+
+	bdp = div_u64(data->btl_bw * data->min_rtt_us, USEC_PER_SEC);
+	if (data->cwnd > 2 * bdp + data->beta)
+		data->cwnd = 2 * bdp + data->beta;
+	data->cwnd = max(data->cwnd, DELAY_MIN_CWND);
+
+	/* Rate-based flows are paced at the bottleneck rate, probing
+	 * 25% above it while the path queue is short */
+	if (ps->flowctrl.rate_based && dtcp->sv->time_unit && data->pdu_size) {
+		rate = div_u64(data->btl_bw * data->pdu_size *
+			       dtcp->sv->time_unit *
+			       (queued > data->beta ? 4 : 5), 4 * MSEC_PER_SEC);
+		data->rate = clamp_t(u64, rate, 1, UINT_MAX);
+	}
+
+	LOG_DBG("cwnd %u, queued %u, min RTT %u us, btl bw %llu PDUs/s",
+		data->cwnd, queued, data->min_rtt_us, data->btl_bw);
+
+ out:
+	delay_round_start(dtcp, data, now);
+}
+
+/* Called with the sv_lock held */
+static void delay_sample(struct dtcp_ps *            ps,
+			 struct delay_dtcp_ps_data * data,
+			 seq_num_t                   sn,
+			 uint_t                      rtt_us)
+{
+	u64 now = ktime_get_ns();
+	u64 elapsed;
+
+	data->last_rtt_us = rtt_us;
+	if (!data->min_rtt_us || rtt_us <= data->min_rtt_us ||
+	    time_after(jiffies, data->min_rtt_stamp +
+		       msecs_to_jiffies(data->min_rtt_win_ms))) {
+		data->min_rtt_us    = rtt_us;
+		data->min_rtt_stamp = jiffies;
+	}
+	if (!data->round_min_rtt_us || rtt_us < data->round_min_rtt_us)
+		data->round_min_rtt_us = rtt_us;
+
+	if (!data->delivered_valid) {
+		data->delivered_valid = true;
+		data->delivered_sn    = sn;
+		delay_round_start(ps->dm, data, now);
+		return;
+	}
+	if (sn > data->delivered_sn) {
+		data->round_delivered += sn - data->delivered_sn;
+		data->delivered_sn     = sn;
+	}
+
+	elapsed = now - data->round_start_ns;
+	if (elapsed >= (u64) data->min_rtt_us * NSEC_PER_USEC)
+		delay_round_end(ps, data, now, elapsed);
+}
+
+static int delay_rtt_estimator(struct dtcp_ps * ps, seq_num_t sn)
+{
+	struct dtcp *               dtcp = ps->dm;
+	struct delay_dtcp_ps_data * data = ps->priv;
+	unsigned long               start_time;
+	unsigned long               ticks;
+	int                         ret;
+
+	if (ps->rtx_ctrl) {
+		start_time = rtxq_entry_timestamp(dtcp->parent->rtxq, sn);
+		ret = default_rtt_estimator(ps, sn);
+	} else {
+		start_time = rttq_entry_timestamp(dtcp->parent->rttq, sn);
+		ret = default_rtt_estimator_nortx(ps, sn);
+	}
+
+	/* Retransmitted or already gone PDUs give no sample */
+	if (ret || start_time == 0 || start_time == (unsigned long) -1)
+		return ret;
+
+	/* Samples are jiffy-grained, one jiffy is the floor */
+	ticks = jiffies - start_time;
+	ticks = max(ticks, 1UL);
+
+	spin_lock_bh(&dtcp->parent->sv_lock);
+	delay_sample(ps, data, sn, jiffies_to_usecs(ticks));
+	spin_unlock_bh(&dtcp->parent->sv_lock);
+
+	return 0;
+}
+
+/* Caps the window and rate the peer just granted to our own estimates */
+static int delay_sndr_flow_control(struct dtcp_ps * ps, const struct pci * pci)
+{
+	struct dtcp *               dtcp = ps->dm;
+	struct delay_dtcp_ps_data * data = ps->priv;
+	seq_num_t                   rwe;
+
+	spin_lock_bh(&dtcp->parent->sv_lock);
+	if (ps->flowctrl.window_based && data->delivered_valid) {
+		rwe = data->delivered_sn + data->cwnd;
+		if (rwe < dtcp->sv->snd_rt_wind_edge)
+			dtcp->sv->snd_rt_wind_edge = rwe;
+	}
+
+	if (ps->flowctrl.rate_based) {
+		if ((pci_control_sndr_rate(pci) && pci_control_time_frame(pci))
+		    || !data->peer_rate)
+			data->peer_rate = dtcp->sv->sndr_rate;
+		if (data->rate)
+			dtcp->sv->sndr_rate = min(data->rate, data->peer_rate);
+	}
+	spin_unlock_bh(&dtcp->parent->sv_lock);
+
+	return 0;
+}
+
+static int dtcp_ps_delay_set_policy_set_param(struct ps_base * bps,
+					      const char *     name,
+					      const char *     value)
+{
+	struct dtcp_ps *            ps = container_of(bps, struct dtcp_ps, base);
+	struct delay_dtcp_ps_data * data = ps->priv;
+	unsigned int                uval;
+	int                         ret;
+
+	if (!name) {
+		LOG_ERR("Null parameter name");
+		return -1;
+	}
+
+	if (!value) {
+		LOG_ERR("Null parameter value");
+		return -1;
+	}
+
+	ret = kstrtouint(value, 10, &uval);
+	if (ret) {
+		LOG_ERR("Invalid value '%s' for parameter %s", value, name);
+		return -1;
+	}
+
+	if (strcmp(name, "alpha") == 0) {
+		data->alpha = uval;
+	} else if (strcmp(name, "beta") == 0) {
+		data->beta = uval;
+	} else if (strcmp(name, "min_rtt_win_ms") == 0) {
+		data->min_rtt_win_ms = uval;
+	} else {
+		LOG_ERR("Unknown DTCP delay PS parameter %s", name);
+		return -1;
+	}
+
+	if (data->beta < data->alpha) {
+		LOG_WARN("beta (%u) below alpha (%u), raising it",
+			 data->beta, data->alpha);
+		data->beta = data->alpha;
+	}
+
+	return 0;
+}
+
+static void dtcp_ps_delay_param(struct dtcp_ps * ps,
+				struct policy *  ps_conf,
+				const char *     name)
+{
+	struct policy_parm * ps_param;
+
+	ps_param = policy_param_find(ps_conf, name);
+	if (!ps_param)
+		return;
+
+	dtcp_ps_delay_set_policy_set_param(&ps->base,
+					   policy_param_name(ps_param),
+					   policy_param_value(ps_param));
+}
+
+static struct ps_base * dtcp_ps_delay_create(struct rina_component * component)
+{
+	struct dtcp *               dtcp = dtcp_from_component(component);
+	struct dtcp_ps *            ps;
+	struct delay_dtcp_ps_data * data;
+
+	if (!dtcp)
+		return NULL;
+
+	ps = rkzalloc(sizeof(*ps), GFP_KERNEL);
+	if (!ps)
+		return NULL;
+
+	data = rkzalloc(sizeof(*data), GFP_KERNEL);
+	if (!data) {
+		rkfree(ps);
+		return NULL;
+	}
+
+	data->alpha          = DELAY_ALPHA_DEFAULT;
+	data->beta           = DELAY_BETA_DEFAULT;
+	data->min_rtt_win_ms = DELAY_MIN_RTT_WIN_DEFAULT;
+	data->state          = DELAY_SLOW_START;
+	data->cwnd           = max(dtcp_initial_credit(dtcp->cfg),
+				   DELAY_MIN_CWND);
+
+	ps->base.set_policy_set_param   = dtcp_ps_delay_set_policy_set_param;
+	ps->dm                          = dtcp;
+	ps->priv                        = data;
+
+	if (dtcp->cfg->dtcp_ps) {
+		dtcp_ps_delay_param(ps, dtcp->cfg->dtcp_ps, "alpha");
+		dtcp_ps_delay_param(ps, dtcp->cfg->dtcp_ps, "beta");
+		dtcp_ps_delay_param(ps, dtcp->cfg->dtcp_ps, "min_rtt_win_ms");
+	}
+
+	if (robject_init_and_add(&data->robj, &delay_cc_rtype, &dtcp->robj,
+				 "delay_cc")) {
+		LOG_ERR("Failed to create DTCP delay PS sysfs object");
+		rkfree(data);
+		rkfree(ps);
+		return NULL;
+	}
+
+	ps->flow_init                   = NULL;
+	ps->lost_control_pdu            = NULL; /* default */
+	ps->rtt_estimator               = delay_rtt_estimator;
+	ps->retransmission_timer_expiry = NULL;
+	ps->received_retransmission     = NULL;
+	ps->sender_ack                  = NULL; /* default */
+	ps->sending_ack                 = NULL; /* default */
+	ps->receiving_ack_list          = NULL;
+	ps->initial_rate                = NULL;
+	ps->receiving_flow_control      = NULL; /* default */
+	ps->update_credit               = NULL;
+	ps->rcvr_ack                    = NULL; /* default */
+	ps->rcvr_flow_control           = NULL; /* default */
+	ps->sndr_flow_control           = delay_sndr_flow_control;
+	ps->rate_reduction              = NULL; /* default */
+	ps->rcvr_control_ack            = NULL;
+	ps->no_rate_slow_down           = NULL;
+	ps->no_override_default_peak    = NULL;
+	ps->rcvr_rendezvous             = NULL; /* default */
+
+	LOG_INFO("Delay DTCP policy created, alpha %u, beta %u",
+		 data->alpha, data->beta);
+
+	return &ps->base;
+}
+
+static void dtcp_ps_delay_destroy(struct ps_base * bps)
+{
+	struct dtcp_ps *            ps = container_of(bps, struct dtcp_ps, base);
+	struct delay_dtcp_ps_data * data;
+
+	if (!bps)
+		return;
+
+	data = ps->priv;
+	if (data) {
+		robject_del(&data->robj);
+		rkfree(data);
+	}
+	rkfree(ps);
+}
+
+struct ps_factory dtcp_factory = {
+	.owner   = THIS_MODULE,
+	.create  = dtcp_ps_delay_create,
+	.destroy = dtcp_ps_delay_destroy,
+};
@@ -24,12 +24,14 @@
 
 #define RINA_PREFIX "pff-multipath"
 #define RINA_PFF_MULTIPATH_NAME "multipath"
+#define RINA_PFF_WMULTIPATH_NAME "weighted-multipath"
 
 #include "logs.h"
 #include "rds/rmem.h"
 #include "pff-ps.h"
 
 extern struct ps_factory pff_factory;
+extern struct ps_factory pff_wmp_factory;
 
 static int __init mod_init(void)
 {
@@ -43,7 +45,16 @@ static int __init mod_init(void)
                 return -1;
         }
 
-        LOG_INFO("PFF multipath policy set loaded successfully");
+        strcpy(pff_wmp_factory.name, RINA_PFF_WMULTIPATH_NAME);
+
+        ret = pff_ps_publish(&pff_wmp_factory);
+        if (ret) {
+                LOG_ERR("Failed to publish weighted PFT policy set factory");
+                pff_ps_unpublish(RINA_PFF_MULTIPATH_NAME);
+                return -1;
+        }
+
+        LOG_INFO("PFF multipath policy sets loaded successfully");
 
         return 0;
 }
@@ -52,13 +63,19 @@ static void __exit mod_exit(void)
 {
         int ret;
 
+        ret = pff_ps_unpublish(RINA_PFF_WMULTIPATH_NAME);
+        if (ret) {
+                LOG_ERR("Failed to unpublish weighted PFT policy set factory");
+                return;
+        }
+
         ret = pff_ps_unpublish(RINA_PFF_MULTIPATH_NAME);
         if (ret) {
                 LOG_ERR("Failed to unpublish Dummy PFT policy set factory");
                 return;
         }
 
-        LOG_INFO("PFF multipath policy set unloaded successfully");
+        LOG_INFO("PFF multipath policy sets unloaded successfully");
 }
 
 module_init(mod_init);
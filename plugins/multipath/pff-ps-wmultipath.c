@@ -0,0 +1,823 @@
+/*
+ * Weighted multipath PS, switching paths at flowlet boundaries
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include <linux/export.h>
+#include <linux/module.h>
+#include <linux/string.h>
+#include <linux/random.h>
+#include <linux/list.h>
+#include <linux/types.h>
+#include <linux/slab.h>
+#include <linux/hashtable.h>
+#include <linux/jhash.h>
+#include <linux/ktime.h>
+
+#define RINA_PREFIX "pff-wmultipath"
+
+#include "logs.h"
+#include "rds/rmem.h"
+#include "pff-ps.h"
+#include "pff.h"
+#include "debug.h"
+
+/* Max number of alternative ports per destination */
+#define WMP_MAX_PORTS          16
+#define WMP_ENTRIES_HASH_BITS  6
+#define WMP_WEIGHTS_HASH_BITS  4
+/* Direct-mapped cache of the per-connection decisions */
+#define WMP_FLOWLETS           512
+#define WMP_DEFAULT_WEIGHT     1
+#define WMP_DEFAULT_GAP_US     500
+
+struct wmp_entry {
+        address_t         destination;
+        qos_id_t          qos_id;
+        size_t            num_ports;
+        port_id_t         ports[WMP_MAX_PORTS];
+        /* Cumulative weights of ports[0..i] */
+        u32               cum_weights[WMP_MAX_PORTS];
+        struct hlist_node hlist;
+};
+
+struct wmp_port_weight {
+        port_id_t         port_id;
+        u32               weight;
+        struct hlist_node hlist;
+};
+
+struct wmp_flowlet {
+        address_t source;
+        address_t destination;
+        cep_id_t  cep_source;
+        cep_id_t  cep_destination;
+        qos_id_t  qos_id;
+        port_id_t port_id;
+        u32       gen;
+        u64       last_ns;
+};
+
+struct pff_ps_priv {
+        spinlock_t           lock;
+        DECLARE_HASHTABLE(entries, WMP_ENTRIES_HASH_BITS);
+        DECLARE_HASHTABLE(weights, WMP_WEIGHTS_HASH_BITS);
+        /* Bumped on each change of the table, invalidates the flowlets */
+        u32                  gen;
+        u64                  gap_ns;
+        bool                 congestion_aware;
+        struct wmp_flowlet * flowlets;
+};
+
+static bool priv_is_ok(struct pff_ps_priv * priv)
+{ return priv != NULL; }
+
+static u32 wmp_port_weight(struct pff_ps_priv * priv,
+                           port_id_t            port_id)
+{
+        struct wmp_port_weight * pos;
+
+        hash_for_each_possible(priv->weights, pos, hlist, port_id) {
+                if (pos->port_id == port_id)
+                        return pos->weight;
+        }
+
+        return WMP_DEFAULT_WEIGHT;
+}
+
+static void wmp_entry_reweight(struct pff_ps_priv * priv,
+                               struct wmp_entry *   entry)
+{
+        u32    total;
+        size_t i;
+
+        total = 0;
+        for (i = 0; i < entry->num_ports; i++) {
+                total += wmp_port_weight(priv, entry->ports[i]);
+                entry->cum_weights[i] = total;
+        }
+}
+
+static struct wmp_entry * wmp_entry_create_ni(address_t destination,
+                                              qos_id_t  qos_id)
+{
+        struct wmp_entry * tmp;
+
+        tmp = rkzalloc(sizeof(*tmp), GFP_ATOMIC);
+        if (!tmp)
+                return NULL;
+
+        tmp->destination = destination;
+        tmp->qos_id      = qos_id;
+        INIT_HLIST_NODE(&tmp->hlist);
+
+        return tmp;
+}
+
+static void wmp_entry_destroy(struct wmp_entry * entry)
+{
+        hash_del(&entry->hlist);
+        rkfree(entry);
+}
+
+static bool wmp_entry_has_port(struct wmp_entry * entry,
+                               port_id_t          id)
+{
+        size_t i;
+
+        if (!entry)
+                return false;
+
+        for (i = 0; i < entry->num_ports; i++) {
+                if (entry->ports[i] == id)
+                        return true;
+        }
+
+        return false;
+}
+
+static int wmp_entry_port_add(struct pff_ps_priv * priv,
+                              struct wmp_entry *   entry,
+                              port_id_t            id)
+{
+        if (wmp_entry_has_port(entry, id))
+                return 0;
+
+        if (entry->num_ports == WMP_MAX_PORTS) {
+                LOG_ERR("Too many ports for destination %u (max %d)",
+                        entry->destination, WMP_MAX_PORTS);
+                return -1;
+        }
+
+        entry->ports[entry->num_ports++] = id;
+        wmp_entry_reweight(priv, entry);
+
+        return 0;
+}
+
+static void wmp_entry_port_remove(struct pff_ps_priv * priv,
+                                  struct wmp_entry *   entry,
+                                  port_id_t            id)
+{
+        size_t i;
+
+        for (i = 0; i < entry->num_ports; i++) {
+                if (entry->ports[i] == id) {
+                        entry->ports[i] = entry->ports[--entry->num_ports];
+                        wmp_entry_reweight(priv, entry);
+                        return;
+                }
+        }
+}
+
+static struct wmp_entry * wmp_find(struct pff_ps_priv * priv,
+                                   address_t            destination,
+                                   qos_id_t             qos_id)
+{
+        struct wmp_entry * pos;
+
+        ASSERT(priv_is_ok(priv));
+        ASSERT(is_address_ok(destination));
+
+        hash_for_each_possible(priv->entries, pos, hlist, destination) {
+                if ((pos->destination == destination) &&
+                    ((pos->qos_id == 0) || (pos->qos_id == qos_id)))
+                        return pos;
+        }
+
+        return NULL;
+}
+
+/* Ports of the request that the entry does not have yet, counted once */
+static size_t wmp_new_ports(struct wmp_entry *     tmp,
+                            struct mod_pff_entry * entry)
+{
+        struct port_id_altlist * alts;
+        struct port_id_altlist * prev;
+        size_t                   count;
+
+        count = 0;
+        list_for_each_entry(alts, &entry->port_id_altlists, next) {
+                if (alts->num_ports < 1 ||
+                    wmp_entry_has_port(tmp, alts->ports[0]))
+                        continue;
+
+                list_for_each_entry(prev, &entry->port_id_altlists, next) {
+                        if (prev == alts) {
+                                count++;
+                                break;
+                        }
+                        if (prev->num_ports >= 1 &&
+                            prev->ports[0] == alts->ports[0])
+                                break;
+                }
+        }
+
+        return count;
+}
+
+static int __wmp_add(struct pff_ps_priv *   priv,
+                     struct mod_pff_entry * entry)
+{
+        struct wmp_entry *       tmp;
+        struct port_id_altlist * alts;
+        size_t                   num_ports;
+        bool                     created;
+
+        tmp       = wmp_find(priv, entry->fwd_info, entry->qos_id);
+        num_ports = tmp ? tmp->num_ports : 0;
+
+        /* Nothing is changed if the ports do not fit */
+        if (num_ports + wmp_new_ports(tmp, entry) > WMP_MAX_PORTS) {
+                LOG_ERR("Too many ports for destination %u (max %d)",
+                        entry->fwd_info, WMP_MAX_PORTS);
+                return -1;
+        }
+
+        created = false;
+        if (!tmp) {
+                tmp = wmp_entry_create_ni(entry->fwd_info, entry->qos_id);
+                if (!tmp)
+                        return -1;
+
+                hash_add(priv->entries, &tmp->hlist, tmp->destination);
+                created = true;
+        }
+
+        priv->gen++;
+
+        list_for_each_entry(alts, &entry->port_id_altlists, next) {
+                if (alts->num_ports < 1) {
+                        LOG_INFO("Port id alternative set is empty");
+                        continue;
+                }
+
+                if (wmp_entry_port_add(priv, tmp, alts->ports[0])) {
+                        /* An existing entry keeps the ports it had */
+                        if (created)
+                                wmp_entry_destroy(tmp);
+                        return -1;
+                }
+        }
+
+        return 0;
+}
+
+static int wmp_add(struct pff_ps *        ps,
+                   struct mod_pff_entry * entry)
+{
+        struct pff_ps_priv * priv;
+        int                  result;
+
+        priv = (struct pff_ps_priv *) ps->priv;
+        if (!priv_is_ok(priv))
+                return -1;
+
+        if (!entry) {
+                LOG_ERR("Bogus output parameters, won't add");
+                return -1;
+        }
+
+        if (!is_address_ok(entry->fwd_info)) {
+                LOG_ERR("Bogus destination address passed, cannot add");
+                return -1;
+        }
+        if (!is_qos_id_ok(entry->qos_id)) {
+                LOG_ERR("Bogus qos-id passed, cannot add");
+                return -1;
+        }
+
+        spin_lock_bh(&priv->lock);
+        result = __wmp_add(priv, entry);
+        spin_unlock_bh(&priv->lock);
+
+        return result;
+}
+
+static int wmp_remove(struct pff_ps *        ps,
+                      struct mod_pff_entry * entry)
+{
+        struct pff_ps_priv *     priv;
+        struct port_id_altlist * alts;
+        struct wmp_entry *       tmp;
+
+        priv = (struct pff_ps_priv *) ps->priv;
+        if (!priv_is_ok(priv))
+                return -1;
+
+        if (!entry) {
+                LOG_ERR("Bogus output parameters, won't remove");
+                return -1;
+        }
+
+        if (!is_address_ok(entry->fwd_info)) {
+                LOG_ERR("Bogus destination address passed, cannot remove");
+                return -1;
+        }
+        if (!is_qos_id_ok(entry->qos_id)) {
+                LOG_ERR("Bogus qos-id passed, cannot remove");
+                return -1;
+        }
+
+        spin_lock_bh(&priv->lock);
+
+        tmp = wmp_find(priv, entry->fwd_info, entry->qos_id);
+        if (!tmp) {
+                spin_unlock_bh(&priv->lock);
+                return -1;
+        }
+
+        priv->gen++;
+
+        list_for_each_entry(alts, &entry->port_id_altlists, next) {
+                if (alts->num_ports < 1) {
+                        LOG_INFO("Port id alternative set is empty");
+                        continue;
+                }
+
+                wmp_entry_port_remove(priv, tmp, alts->ports[0]);
+        }
+
+        if (!tmp->num_ports)
+                wmp_entry_destroy(tmp);
+
+        spin_unlock_bh(&priv->lock);
+
+        return 0;
+}
+
+static bool wmp_is_empty(struct pff_ps * ps)
+{
+        struct pff_ps_priv * priv;
+        bool                 empty;
+
+        priv = (struct pff_ps_priv *) ps->priv;
+        if (!priv_is_ok(priv))
+                return false;
+
+        spin_lock_bh(&priv->lock);
+        empty = hash_empty(priv->entries);
+        spin_unlock_bh(&priv->lock);
+
+        return empty;
+}
+
+static void __wmp_flush(struct pff_ps_priv * priv)
+{
+        struct wmp_entry *  pos;
+        struct hlist_node * tmp;
+        int                 bucket;
+
+        ASSERT(priv_is_ok(priv));
+
+        hash_for_each_safe(priv->entries, bucket, tmp, pos, hlist) {
+                wmp_entry_destroy(pos);
+        }
+        priv->gen++;
+}
+
+static int wmp_flush(struct pff_ps * ps)
+{
+        struct pff_ps_priv * priv;
+
+        priv = (struct pff_ps_priv *) ps->priv;
+        if (!priv_is_ok(priv))
+                return -1;
+
+        spin_lock_bh(&priv->lock);
+        __wmp_flush(priv);
+        spin_unlock_bh(&priv->lock);
+
+        return 0;
+}
+
+static size_t wmp_weighted_pick(struct wmp_entry * entry)
+{
+        u32    point;
+        size_t i;
+
+        get_random_bytes(&point, sizeof(point));
+        point %= entry->cum_weights[entry->num_ports - 1];
+
+        for (i = 0; i < entry->num_ports - 1; i++) {
+                if (point < entry->cum_weights[i])
+                        break;
+        }
+
+        return i;
+}
+
+static u32 wmp_slot_weight(struct wmp_entry * entry, size_t i)
+{
+        return i ? entry->cum_weights[i] - entry->cum_weights[i - 1] :
+                entry->cum_weights[0];
+}
+
+/*
+ * Picks the port of a new flowlet: a weighted random one or, if the RMT
+ * queues are used as congestion signal, the least loaded (relative to its
+ * weight) of two weighted random ones
+ */
+static port_id_t wmp_select_port(struct pff_ps *    ps,
+                                 struct wmp_entry * entry)
+{
+        struct pff_ps_priv * priv = ps->priv;
+        size_t               a, b;
+        int                  qa, qb;
+
+        a = wmp_weighted_pick(entry);
+        if (!priv->congestion_aware || entry->num_ports == 1)
+                return entry->ports[a];
+
+        b = wmp_weighted_pick(entry);
+        if (a == b)
+                return entry->ports[a];
+
+        qa = pff_port_queue_len(ps->dm, entry->ports[a]);
+        qb = pff_port_queue_len(ps->dm, entry->ports[b]);
+        if (qa < 0 || qb < 0)
+                return entry->ports[qa < 0 ? b : a];
+
+        /* qa / wa > qb / wb */
+        if ((u64) qa * wmp_slot_weight(entry, b) >
+            (u64) qb * wmp_slot_weight(entry, a))
+                return entry->ports[b];
+
+        return entry->ports[a];
+}
+
+static int wmp_next_hop(struct pff_ps * ps,
+                        struct pci *    pci,
+                        port_id_t **    ports,
+                        size_t *        count)
+{
+        struct pff_ps_priv * priv;
+        address_t            destination;
+        qos_id_t             qos_id;
+        struct wmp_entry *   tmp;
+        struct wmp_flowlet * fl;
+        address_t            source;
+        cep_id_t             cep_source, cep_destination;
+        port_id_t            port_id;
+        u64                  now;
+
+        priv = (struct pff_ps_priv *) ps->priv;
+        if (!priv_is_ok(priv))
+                return -1;
+
+        destination = pci_destination(pci);
+        if (!is_address_ok(destination)) {
+                LOG_ERR("Bogus destination address, cannot get NHOP");
+                return -1;
+        }
+
+        qos_id = pci_qos_id(pci);
+        if (!is_qos_id_ok(qos_id)) {
+                LOG_ERR("Bogus qos-id, cannot get NHOP");
+                return -1;
+        }
+
+        if (!ports || !count) {
+                LOG_ERR("Bogus output parameters, won't get NHOP");
+                return -1;
+        }
+
+        source          = pci_source(pci);
+        cep_source      = pci_cep_source(pci);
+        cep_destination = pci_cep_destination(pci);
+        now             = ktime_get_ns();
+
+        spin_lock_bh(&priv->lock);
+
+        tmp = wmp_find(priv, destination, qos_id);
+        if (!tmp || !tmp->num_ports) {
+                LOG_ERR("Could not find any entry for dest address: %u and "
+                        "qos_id %d", destination, qos_id);
+                spin_unlock_bh(&priv->lock);
+                return -1;
+        }
+
+        fl = &priv->flowlets[jhash_3words(source, destination,
+                                          ((u32) cep_source << 16) ^
+                                          (u32) cep_destination,
+                                          qos_id) % WMP_FLOWLETS];
+
+        /* Stay on the path unless the connection idled for a while */
+        if (fl->gen == priv->gen                &&
+            fl->source == source                &&
+            fl->destination == destination      &&
+            fl->cep_source == cep_source        &&
+            fl->cep_destination == cep_destination &&
+            fl->qos_id == qos_id                &&
+            now - fl->last_ns < priv->gap_ns) {
+                port_id = fl->port_id;
+        } else {
+                port_id             = wmp_select_port(ps, tmp);
+                fl->source          = source;
+                fl->destination     = destination;
+                fl->cep_source      = cep_source;
+                fl->cep_destination = cep_destination;
+                fl->qos_id          = qos_id;
+                fl->port_id         = port_id;
+                fl->gen             = priv->gen;
+        }
+        fl->last_ns = now;
+
+        spin_unlock_bh(&priv->lock);
+
+        if (*count != 1) {
+                if (*count > 0)
+                        rkfree(*ports);
+                *ports = rkmalloc(sizeof(**ports), GFP_ATOMIC);
+                if (!*ports) {
+                        *count = 0;
+                        return -1;
+                }
+                *count = 1;
+        }
+        (*ports)[0] = port_id;
+
+        return 0;
+}
+
+static int wmp_port_id_altlists_copy(struct wmp_entry * entry,
+                                     struct list_head * port_id_altlists)
+{
+        struct port_id_altlist * alt;
+        size_t                   i;
+
+        for (i = 0; i < entry->num_ports; i++) {
+                alt = rkmalloc(sizeof(*alt), GFP_ATOMIC);
+                if (!alt)
+                        return -1;
+
+                alt->ports = rkmalloc(sizeof(*(alt->ports)), GFP_ATOMIC);
+                if (!alt->ports) {
+                        rkfree(alt);
+                        return -1;
+                }
+
+                alt->ports[0]  = entry->ports[i];
+                alt->num_ports = 1;
+
+                list_add_tail(&alt->next, port_id_altlists);
+        }
+
+        return 0;
+}
+
+static int wmp_dump(struct pff_ps *    ps,
+                    struct list_head * entries)
+{
+        struct pff_ps_priv *   priv;
+        struct wmp_entry *     pos;
+        struct mod_pff_entry * entry;
+        int                    bucket;
+
+        priv = (struct pff_ps_priv *) ps->priv;
+        if (!priv_is_ok(priv))
+                return -1;
+
+        spin_lock_bh(&priv->lock);
+        hash_for_each(priv->entries, bucket, pos, hlist) {
+                entry = rkmalloc(sizeof(*entry), GFP_ATOMIC);
+                if (!entry) {
+                        spin_unlock_bh(&priv->lock);
+                        return -1;
+                }
+
+                entry->fwd_info = pos->destination;
+                entry->qos_id   = pos->qos_id;
+                INIT_LIST_HEAD(&entry->port_id_altlists);
+                if (wmp_port_id_altlists_copy(pos,
+                                              &entry->port_id_altlists)) {
+                        rkfree(entry);
+                        spin_unlock_bh(&priv->lock);
+                        return -1;
+                }
+
+                list_add(&entry->next, entries);
+        }
+        spin_unlock_bh(&priv->lock);
+
+        return 0;
+}
+
+static int wmp_modify(struct pff_ps *    ps,
+                      struct list_head * entries)
+{
+        struct pff_ps_priv *   priv;
+        struct mod_pff_entry * entry;
+
+        priv = (struct pff_ps_priv *) ps->priv;
+        if (!priv_is_ok(priv))
+                return -1;
+
+        spin_lock_bh(&priv->lock);
+
+        __wmp_flush(priv);
+
+        list_for_each_entry(entry, entries, next) {
+                if (!is_address_ok(entry->fwd_info))
+                        continue;
+
+                if (!is_qos_id_ok(entry->qos_id))
+                        continue;
+
+                __wmp_add(priv, entry);
+        }
+
+        spin_unlock_bh(&priv->lock);
+
+        return 0;
+}
+
+static int wmp_weight_set(struct pff_ps_priv * priv,
+                          port_id_t            port_id,
+                          u32                  weight)
+{
+        struct wmp_port_weight * pw;
+        struct wmp_entry *       pos;
+        int                      bucket;
+
+        spin_lock_bh(&priv->lock);
+
+        pw = NULL;
+        hash_for_each_possible(priv->weights, pw, hlist, port_id) {
+                if (pw->port_id == port_id)
+                        break;
+        }
+
+        if (!pw) {
+                pw = rkzalloc(sizeof(*pw), GFP_ATOMIC);
+                if (!pw) {
+                        spin_unlock_bh(&priv->lock);
+                        return -1;
+                }
+                pw->port_id = port_id;
+                hash_add(priv->weights, &pw->hlist, port_id);
+        }
+        pw->weight = weight;
+
+        hash_for_each(priv->entries, bucket, pos, hlist) {
+                wmp_entry_reweight(priv, pos);
+        }
+        priv->gen++;
+
+        spin_unlock_bh(&priv->lock);
+
+        return 0;
+}
+
+/*
+ * Parameters:
+ *   flowlet_gap_us   : idle time after which a connection may change path
+ *   congestion_aware : 1 to prefer the ports with shorter RMT queues
+ *   weight.<port-id> : relative capacity of the N-1 port (default 1)
+ */
+static int pff_ps_set_policy_set_param(struct ps_base * bps,
+                                       const char *     name,
+                                       const char *     value)
+{
+        struct pff_ps *      ps = container_of(bps, struct pff_ps, base);
+        struct pff_ps_priv * priv = ps->priv;
+        unsigned int         uval;
+        int                  port_id;
+
+        if (!name) {
+                LOG_ERR("Null parameter name");
+                return -1;
+        }
+
+        if (!value) {
+                LOG_ERR("Null parameter value");
+                return -1;
+        }
+
+        if (kstrtouint(value, 10, &uval)) {
+                LOG_ERR("Invalid value '%s' for parameter %s", value, name);
+                return -1;
+        }
+
+        if (strcmp(name, "flowlet_gap_us") == 0) {
+                spin_lock_bh(&priv->lock);
+                priv->gap_ns = (u64) uval * NSEC_PER_USEC;
+                spin_unlock_bh(&priv->lock);
+                return 0;
+        }
+
+        if (strcmp(name, "congestion_aware") == 0) {
+                priv->congestion_aware = uval ? true : false;
+                return 0;
+        }
+
+        if (strncmp(name, "weight.", 7) == 0) {
+                if (kstrtoint(name + 7, 10, &port_id) ||
+                    !is_port_id_ok(port_id) || !uval) {
+                        LOG_ERR("Invalid weight parameter %s = %s",
+                                name, value);
+                        return -1;
+                }
+
+                return wmp_weight_set(priv, port_id, uval);
+        }
+
+        LOG_ERR("No such parameter to set");
+
+        return -1;
+}
+
+static struct ps_base *
+pff_ps_wmultipath_create(struct rina_component * component)
+{
+        struct pff_ps *      ps;
+        struct pff_ps_priv * priv;
+        struct pff *         pff = pff_from_component(component);
+
+        priv = rkzalloc(sizeof(*priv), GFP_KERNEL);
+        if (!priv)
+                return NULL;
+
+        priv->flowlets = rkzalloc(WMP_FLOWLETS * sizeof(*priv->flowlets),
+                                  GFP_KERNEL);
+        if (!priv->flowlets) {
+                rkfree(priv);
+                return NULL;
+        }
+
+        spin_lock_init(&priv->lock);
+        hash_init(priv->entries);
+        hash_init(priv->weights);
+        /* The flowlets start invalid, their gen is 0 */
+        priv->gen              = 1;
+        priv->gap_ns           = WMP_DEFAULT_GAP_US * NSEC_PER_USEC;
+        priv->congestion_aware = true;
+
+        ps = rkzalloc(sizeof(*ps), GFP_KERNEL);
+        if (!ps) {
+                rkfree(priv->flowlets);
+                rkfree(priv);
+                return NULL;
+        }
+
+        ps->base.set_policy_set_param = pff_ps_set_policy_set_param;
+        ps->dm = pff;
+        ps->priv = (void *) priv;
+        ps->pff_add = wmp_add;
+        ps->pff_remove = wmp_remove;
+        ps->pff_port_state_change = NULL;
+        ps->pff_is_empty = wmp_is_empty;
+        ps->pff_flush = wmp_flush;
+        ps->pff_nhop = wmp_next_hop;
+        ps->pff_dump = wmp_dump;
+        ps->pff_modify = wmp_modify;
+
+        return &ps->base;
+}
+
+static void pff_ps_wmultipath_destroy(struct ps_base * bps)
+{
+        struct pff_ps *          ps = container_of(bps, struct pff_ps, base);
+        struct pff_ps_priv *     priv;
+        struct wmp_port_weight * pos;
+        struct hlist_node *      tmp;
+        int                      bucket;
+
+        if (!bps)
+                return;
+
+        priv = (struct pff_ps_priv *) ps->priv;
+        if (!priv_is_ok(priv))
+                return;
+
+        spin_lock_bh(&priv->lock);
+        __wmp_flush(priv);
+        hash_for_each_safe(priv->weights, bucket, tmp, pos, hlist) {
+                hash_del(&pos->hlist);
+                rkfree(pos);
+        }
+        spin_unlock_bh(&priv->lock);
+
+        rkfree(priv->flowlets);
+        rkfree(priv);
+        rkfree(ps);
+}
+
+struct ps_factory pff_wmp_factory = {
+        .owner   = THIS_MODULE,
+        .create  = pff_ps_wmultipath_create,
+        .destroy = pff_ps_wmultipath_destroy,
+};
@@ -24,6 +24,8 @@
 #include <linux/string.h>
 #include <linux/random.h>
 #include <linux/ktime.h>
+#include <linux/bitmap.h>
+#include <linux/math64.h>
 
 #define RINA_PREFIX "qta-mux-plugin"
 
@@ -40,13 +42,11 @@
 
 #define TIMER_T  100
 
-struct pdu_entry {
-	struct list_head list;
-	struct du *      pdu;
-};
+/* Bounds of the arrays indexing TBFs and urgency queues */
+#define QTA_MUX_MAX_QOS_IDS      256
+#define QTA_MUX_MAX_URGENCY      64
 
 struct urgency_queue {
-	struct list_head 	   list;
 	struct list_head 	   queued_pdus;
 	uint_t           	   urgency_level;
 	uint_t           	   length;
@@ -63,7 +63,9 @@ struct urgency_queue {
 };
 
 struct cu_mux {
-	struct list_head      urgency_queues;
+	/* Indexed by urgency level, the lowest level is served first */
+	struct urgency_queue * urgency_queues[QTA_MUX_MAX_URGENCY];
+	DECLARE_BITMAP(non_empty, QTA_MUX_MAX_URGENCY);
 	struct list_head      mgmt_queue;
 	struct robject	      robj;
 	struct rset *         rset;
@@ -121,8 +123,14 @@ struct qta_mux_conf {
 struct qta_mux {
 	struct list_head list;
 	struct list_head token_bucket_filters;
+	struct token_bucket_filter * tbfs[QTA_MUX_MAX_QOS_IDS];
 	struct cu_mux    cu_mux;
 	port_id_t        port_id;
+	/* Time spent in the enqueue and dequeue policies, in ns */
+	u64		 enqueue_ns;
+	u64		 enqueued_pdus;
+	u64		 dequeue_ns;
+	u64		 dequeued_pdus;
 	struct robject   robj;
 	struct rset *    rset;
 };
@@ -145,6 +153,16 @@ static ssize_t qta_mux_attr_show(struct robject * robj,
 	if (strcmp(robject_attr_name(attr), "port_id") == 0) {
 		return sprintf(buf, "%u\n", qta_mux->port_id);
 	}
+	if (strcmp(robject_attr_name(attr), "enqueue_avg_ns") == 0) {
+		return sprintf(buf, "%llu\n", qta_mux->enqueued_pdus ?
+			       div64_u64(qta_mux->enqueue_ns,
+					 qta_mux->enqueued_pdus) : 0);
+	}
+	if (strcmp(robject_attr_name(attr), "dequeue_avg_ns") == 0) {
+		return sprintf(buf, "%llu\n", qta_mux->dequeued_pdus ?
+			       div64_u64(qta_mux->dequeue_ns,
+					 qta_mux->dequeued_pdus) : 0);
+	}
 
 	return 0;
 }
@@ -256,7 +274,7 @@ static ssize_t token_bucket_filter_attr_show(struct robject * robj,
 }
 
 RINA_SYSFS_OPS(qta_mux);
-RINA_ATTRS(qta_mux, port_id);
+RINA_ATTRS(qta_mux, port_id, enqueue_avg_ns, dequeue_avg_ns);
 RINA_KTYPE(qta_mux);
 RINA_SYSFS_OPS(cu_mux);
 RINA_ATTRS(cu_mux, urgency_levels, cherish_levels);
@@ -381,37 +399,24 @@ static struct qta_mux_set * qta_mux_set_create(void)
 	return tmp;
 }
 
-static void pdu_entry_destroy(struct pdu_entry * pdu_entry, bool destroy)
+static void pdu_queue_flush(struct list_head * queue)
 {
-	if (!pdu_entry)
-		return;
-
-	list_del(&pdu_entry->list);
+	struct du *pos, *next;
 
-	if (destroy) {
-		du_destroy(pdu_entry->pdu);
+	list_for_each_entry_safe(pos, next, queue, list) {
+		list_del_init(&pos->list);
+		du_destroy(pos);
 	}
-
-	rkfree(pdu_entry);
-
-	return;
 }
 
 static void urgency_queue_destroy(struct urgency_queue * uq)
 {
-	struct pdu_entry *pos, *next;
-
 	if (!uq)
 		return;
 
-	list_del(&uq->list);
-
 	robject_del(&uq->robj);
 
-	list_for_each_entry_safe(pos, next,
-			&uq->queued_pdus, list) {
-		pdu_entry_destroy(pos, true);
-	}
+	pdu_queue_flush(&uq->queued_pdus);
 
 #if QTA_MUX_DEBUG
 	udebug_info_destroy(uq->debug_info);
@@ -434,29 +439,26 @@ static void token_bucket_filter_destroy(struct token_bucket_filter * sq)
 
 static void qta_mux_destroy(struct qta_mux * qta_mux)
 {
-	struct urgency_queue *pos, *next;
-	struct token_bucket_filter *pos2, *next2;
-	struct pdu_entry *pos3, *next3;
+	struct token_bucket_filter *pos, *next;
+	int i;
 
 	if (!qta_mux)
 		return;
 
 	list_del(&qta_mux->list);
 
-	list_for_each_entry_safe(pos, next,
-			&qta_mux->cu_mux.urgency_queues, list) {
-		urgency_queue_destroy(pos);
+	for (i = 0; i < QTA_MUX_MAX_URGENCY; i++) {
+		urgency_queue_destroy(qta_mux->cu_mux.urgency_queues[i]);
+		qta_mux->cu_mux.urgency_queues[i] = NULL;
 	}
 
-	list_for_each_entry_safe(pos2, next2,
+	list_for_each_entry_safe(pos, next,
 			&qta_mux->token_bucket_filters, list) {
-		token_bucket_filter_destroy(pos2);
+		qta_mux->tbfs[pos->qos_id] = NULL;
+		token_bucket_filter_destroy(pos);
 	}
 
-	list_for_each_entry_safe(pos3, next3,
-			&qta_mux->cu_mux.mgmt_queue, list) {
-		pdu_entry_destroy(pos3, true);
-	}
+	pdu_queue_flush(&qta_mux->cu_mux.mgmt_queue);
 
 	robject_del(&qta_mux->cu_mux.robj);
 	if (qta_mux->cu_mux.rset)
@@ -482,7 +484,7 @@ static struct qta_mux * qta_mux_create(port_id_t port_id,
 
 	INIT_LIST_HEAD(&tmp->list);
 	INIT_LIST_HEAD(&tmp->token_bucket_filters);
-	INIT_LIST_HEAD(&tmp->cu_mux.urgency_queues);
+	bitmap_zero(tmp->cu_mux.non_empty, QTA_MUX_MAX_URGENCY);
 	INIT_LIST_HEAD(&tmp->cu_mux.mgmt_queue);
 	tmp->port_id = port_id;
 
@@ -573,7 +575,6 @@ static struct urgency_queue * urgency_queue_create(uint_t urgency_level,
 		return NULL;
 	}
 
-	INIT_LIST_HEAD(&tmp->list);
 	INIT_LIST_HEAD(&tmp->queued_pdus);
 	tmp->length = 0;
 	tmp->urgency_level = urgency_level;
@@ -598,22 +599,6 @@ static struct urgency_queue * urgency_queue_create(uint_t urgency_level,
 	return tmp;
 }
 
-static struct pdu_entry * pdu_entry_create(struct du* du)
-{
-	struct pdu_entry * tmp;
-
-	tmp = rkzalloc(sizeof(*tmp), GFP_ATOMIC);
-	if (!tmp) {
-		LOG_ERR("Problems creating PDU entry");
-		return NULL;
-	}
-
-	INIT_LIST_HEAD(&tmp->list);
-	tmp->pdu = du;
-
-	return tmp;
-}
-
 static void qta_mux_set_destroy(struct qta_mux_set * qta_mux_set)
 {
 	struct qta_mux *pos, *next;
@@ -637,46 +622,37 @@ static void qta_mux_set_destroy(struct qta_mux_set * qta_mux_set)
 static struct token_bucket_filter * tbf_find(struct qta_mux * qta_mux,
 					     qos_id_t qos_id)
 {
-	struct token_bucket_filter * pos;
-
-	list_for_each_entry(pos, &qta_mux->token_bucket_filters, list) {
-		if (pos->qos_id == qos_id)
-			return pos;
-	}
+	if (qos_id < 0 || qos_id >= QTA_MUX_MAX_QOS_IDS)
+		return NULL;
 
-	return NULL;
+	return qta_mux->tbfs[qos_id];
 }
 
 static struct urgency_queue * urgency_queue_find(struct qta_mux * qta_mux,
 						 uint_t urgency_level)
 {
-	struct urgency_queue * pos;
-
-	list_for_each_entry(pos, &qta_mux->cu_mux.urgency_queues, list) {
-		if (pos->urgency_level == urgency_level)
-			return pos;
-	}
+	if (urgency_level >= QTA_MUX_MAX_URGENCY)
+		return NULL;
 
-	return NULL;
+	return qta_mux->cu_mux.urgency_queues[urgency_level];
 }
 
 static struct du * dequeue_pdu(struct list_head * list)
 {
-	struct pdu_entry * pdu_entry = NULL;
 	struct du * pdu;
 
-	pdu_entry = list_first_entry(list, struct pdu_entry, list);
-	if (!pdu_entry) {
-		return NULL;
-	}
-
-	pdu = pdu_entry->pdu;
-
-	pdu_entry_destroy(pdu_entry, false);
+	pdu = list_first_entry(list, struct du, list);
+	list_del_init(&pdu->list);
 
 	return pdu;
 }
 
+static void qta_mux_account(u64 * total_ns, u64 * pdus, u64 start)
+{
+	*total_ns += ktime_get_ns() - start;
+	(*pdus)++;
+}
+
 struct du * qta_rmt_dequeue_policy(struct rmt_ps	  *ps,
 				   struct rmt_n1_port *n1_port)
 {
@@ -685,6 +661,8 @@ struct du * qta_rmt_dequeue_policy(struct rmt_ps	  *ps,
 	struct urgency_queue * pos;
 	uint_t		       random_bytes;
 	struct urgency_queue * candidate;
+	unsigned long	       level;
+	u64		       start;
 
 	if (!ps || !n1_port || !n1_port->rmt_ps_queues) {
 		LOG_ERR("Wrong input parameters for "
@@ -696,36 +674,47 @@ struct du * qta_rmt_dequeue_policy(struct rmt_ps	  *ps,
 	if (!qta_mux)
 		return NULL;
 
+	start = ktime_get_ns();
+
 	/* Layer management PDUs always have top priority */
-	if (!list_empty(&qta_mux->cu_mux.mgmt_queue))
-		return dequeue_pdu(&qta_mux->cu_mux.mgmt_queue);
+	if (!list_empty(&qta_mux->cu_mux.mgmt_queue)) {
+		ret_pdu = dequeue_pdu(&qta_mux->cu_mux.mgmt_queue);
+		qta_mux_account(&qta_mux->dequeue_ns,
+				&qta_mux->dequeued_pdus, start);
+		return ret_pdu;
+	}
 
-	/* Go through the urgency queues in urgency level: the queues */
-	/* with a higher urgency level are checked first */
+	/* Go through the non-empty urgency queues in urgency level: the */
+	/* queues with a lower urgency level are checked first */
 	candidate = NULL;
-	list_for_each_entry(pos, &qta_mux->cu_mux.urgency_queues, list) {
-		if (!list_empty(&pos->queued_pdus)) {
-			/* This queue is not empty, can be a candidate */
-			get_random_bytes(&random_bytes, sizeof(random_bytes));
-			random_bytes = random_bytes % NORM_PROB;
-			if (pos->dequeue_prob > random_bytes) {
-				/* We can dequeue from this urgency queue */
-				candidate = pos;
-				goto exit;
-			} else if (!candidate) {
-				candidate = pos;
-			}
+	for_each_set_bit(level, qta_mux->cu_mux.non_empty,
+			 QTA_MUX_MAX_URGENCY) {
+		pos = qta_mux->cu_mux.urgency_queues[level];
+		if (!candidate)
+			candidate = pos;
+		if (pos->dequeue_prob >= NORM_PROB) {
+			candidate = pos;
+			break;
+		}
+		get_random_bytes(&random_bytes, sizeof(random_bytes));
+		random_bytes = random_bytes % NORM_PROB;
+		if (pos->dequeue_prob > random_bytes) {
+			/* We can dequeue from this urgency queue */
+			candidate = pos;
+			break;
 		}
 	}
 
-exit:
 	if (!candidate)
 		return NULL;
 
 	ret_pdu = dequeue_pdu(&candidate->queued_pdus);
 	candidate->length--;
+	if (!candidate->length)
+		clear_bit(candidate->urgency_level, qta_mux->cu_mux.non_empty);
 	candidate->tx_pdus++;
 	candidate->tx_bytes += du_len(ret_pdu);
+	qta_mux_account(&qta_mux->dequeue_ns, &qta_mux->dequeued_pdus, start);
 
 #if QTA_MUX_DEBUG
 if (candidate->debug_info->q_index < UQUEUE_DEBUG_SIZE) {
@@ -748,7 +737,6 @@ int qta_rmt_enqueue_policy(struct rmt_ps	  *ps,
 	struct urgency_queue *       urgency_queue;
 	qos_id_t               	     qos_id;
 	pdu_type_t 		     pdu_type;
-	struct pdu_entry * 	     pdu_entry;
 	s64			     now;
 	s64			     delta_tokens;
 	ssize_t			     pdu_length;
@@ -763,6 +751,7 @@ int qta_rmt_enqueue_policy(struct rmt_ps	  *ps,
 	}
 
 	qta_mux = n1_port->rmt_ps_queues;
+	now = ktime_get_ns();
 
 	/*
 	 * If layer management PDU enqueue in dedicated queue, bypass P/S
@@ -770,18 +759,13 @@ int qta_rmt_enqueue_policy(struct rmt_ps	  *ps,
 	 * to avoid (D)DoS
 	 */
 	pdu_type = pci_type(&du->pci);
-	if (pdu_type == PDU_TYPE_MGMT) {
+	if (pdu_type_is_mgmt(pdu_type)) {
 		if (!must_enqueue && list_empty(&qta_mux->cu_mux.mgmt_queue))
 			return RMT_PS_ENQ_SEND;
 
-		pdu_entry = pdu_entry_create(du);
-		if (!pdu_entry) {
-			LOG_ERR("Problems allocating memory for PDU entry");
-			du_destroy(du);
-			return RMT_PS_ENQ_ERR;
-		}
-
-		list_add_tail(&pdu_entry->list, &qta_mux->cu_mux.mgmt_queue);
+		list_add_tail(&du->list, &qta_mux->cu_mux.mgmt_queue);
+		qta_mux_account(&qta_mux->enqueue_ns,
+				&qta_mux->enqueued_pdus, now);
 		return RMT_PS_ENQ_SCHED;
 	}
 
@@ -795,7 +779,6 @@ int qta_rmt_enqueue_policy(struct rmt_ps	  *ps,
 	}
 
 	/* Update num tokens and see if PDU can go through */
-	now = ktime_get_ns();
 	delta_tokens = (now - tbf->last_pdu_time) * tbf->max_rate;
 	do_div(delta_tokens, 1000000000);
 	do_div(delta_tokens, 8);
@@ -858,20 +841,15 @@ int qta_rmt_enqueue_policy(struct rmt_ps	  *ps,
 		}
 	}
 
-	pdu_entry = pdu_entry_create(du);
-	if (!pdu_entry) {
-		LOG_ERR("Problems allocating memory for PDU entry");
-		du_destroy(du);
-		return RMT_PS_ENQ_ERR;
-	}
-
 	if (ecn_mark) {
 		pci_flags = pci_flags_get(&du->pci);
 		pci_flags_set(&du->pci,
 			      pci_flags |= PDU_FLAGS_EXPLICIT_CONGESTION);
 	}
-	list_add_tail(&pdu_entry->list, &urgency_queue->queued_pdus);
-	urgency_queue->length++;
+	list_add_tail(&du->list, &urgency_queue->queued_pdus);
+	if (!urgency_queue->length++)
+		set_bit(urgency_queue->urgency_level,
+			qta_mux->cu_mux.non_empty);
 	if (urgency_queue->length > urgency_queue->max_occupation)
 		urgency_queue->max_occupation = urgency_queue->length;
 
@@ -883,6 +861,8 @@ int qta_rmt_enqueue_policy(struct rmt_ps	  *ps,
 	}
 #endif
 
+	qta_mux_account(&qta_mux->enqueue_ns, &qta_mux->enqueued_pdus, now);
+
 	return RMT_PS_ENQ_SCHED;
 }
 
@@ -912,26 +892,6 @@ static struct token_bucket_conf * tbc_find(struct qta_mux_conf * conf,
 	return NULL;
 }
 
-static void qta_mux_add_uqueue(struct qta_mux *     qta_mux,
-			       struct urgency_queue * uq)
-{
-	struct urgency_queue * pos;
-
-	if (list_empty(&qta_mux->cu_mux.urgency_queues)) {
-		list_add(&uq->list, &qta_mux->cu_mux.urgency_queues);
-		return;
-	}
-
-	list_for_each_entry(pos, &qta_mux->cu_mux.urgency_queues, list) {
-		if (pos->urgency_level > uq->urgency_level) {
-			list_add_tail(&uq->list, &pos->list);
-			return;
-		}
-	}
-
-	list_add_tail(&uq->list, &qta_mux->cu_mux.urgency_queues);
-}
-
 void * qta_rmt_q_create_policy(struct rmt_ps      *ps,
 			       struct rmt_n1_port *n1_port)
 {
@@ -976,6 +936,7 @@ void * qta_rmt_q_create_policy(struct rmt_ps      *ps,
 		}
 
 		list_add_tail(&tbf->list, &qta_mux->token_bucket_filters);
+		qta_mux->tbfs[tbf->qos_id] = tbf;
 		LOG_INFO("Added token bucket filter for QoS id %u", pos->qos_id);
 	}
 
@@ -991,7 +952,8 @@ void * qta_rmt_q_create_policy(struct rmt_ps      *ps,
 			return NULL;
 		}
 
-		qta_mux_add_uqueue(qta_mux, urgency_queue);
+		qta_mux->cu_mux.urgency_queues[uq_conf->urgency_level] =
+			urgency_queue;
 		LOG_INFO("Added urgency queue for urgency level %d",
 			 uq_conf->urgency_level);
 	}
@@ -1113,6 +1075,18 @@ static int qta_mux_ps_set_policy_set_param_priv(struct qta_mux_set * data,
 			 qos_id, urgency_level, cherish_level,
 			 max_burst_size, max_rate);
 
+		if (qos_id < 0 || qos_id >= QTA_MUX_MAX_QOS_IDS) {
+			LOG_ERR("QoS id %d out of range (max %d)",
+				qos_id, QTA_MUX_MAX_QOS_IDS - 1);
+			return -1;
+		}
+
+		if (urgency_level >= QTA_MUX_MAX_URGENCY) {
+			LOG_ERR("Urgency level %u out of range (max %d)",
+				urgency_level, QTA_MUX_MAX_URGENCY - 1);
+			return -1;
+		}
+
 		token_bucket_conf = tbc_find(data->qta_mux_conf, qos_id);
 		if (token_bucket_conf) {
 			LOG_INFO("Overriding token bucket conf config for qos_id %d",
@@ -1166,6 +1140,12 @@ static int qta_mux_ps_set_policy_set_param_priv(struct qta_mux_set * data,
 				    &delta_offset))
 			return -1;
 
+		if (urgency_level >= QTA_MUX_MAX_URGENCY) {
+			LOG_ERR("Urgency level %u out of range (max %d)",
+				urgency_level, QTA_MUX_MAX_URGENCY - 1);
+			return -1;
+		}
+
 		/* Parse # of cherish levels from the parameter value */
 		offset = 0;
 		if (parse_int_value(value, ':', (int *) &cherish_level,
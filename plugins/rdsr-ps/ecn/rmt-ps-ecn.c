@@ -358,7 +358,7 @@ int ecn_enqueue(struct rmt_ps * ps,
 	c = rfifo_length(q->queue);
 
 	/* NOTE: This is a workaround... */
-	if(pci_type(&du->pci) == PDU_TYPE_MGMT) {
+	if (pdu_type_is_mgmt(pci_type(&du->pci))) {
 		if (!must_enqueue && rfifo_is_empty(q->mgmt))
 			return RMT_PS_ENQ_SEND;
 
@@ -490,17 +490,21 @@ rina::IAuthPolicySet::AuthStatus KMSecurityManager::update_crypto_state(const ri
 }
 
 //Class KMIPCResourceManager
+KMIPCResourceManager::KMIPCResourceManager() : sdu_loop("km-sdu-readers", 2)
+{
+	sdu_loop.start();
+}
+
 KMIPCResourceManager::~KMIPCResourceManager()
 {
 	map<int, SDUReader *>::iterator it;
-	void * status;
+
+	sdu_loop.stop();
 
 	rina::ScopedLock g(lock);
 
-	for (it = sdu_readers.begin(); it != sdu_readers.end(); ++it) {
-		it->second->join(&status);
+	for (it = sdu_readers.begin(); it != sdu_readers.end(); ++it)
 		delete it->second;
-	}
 
 	sdu_readers.clear();
 }
@@ -655,23 +659,28 @@ void KMIPCResourceManager::start_flow_reader(int port_id, int fd)
 	rina::ScopedLock g(lock);
 
 	reader = new SDUReader(port_id, fd);
-	reader->start();
-
 	sdu_readers[port_id] = reader;
+	sdu_loop.add_fd(fd, reader);
 }
 
 void KMIPCResourceManager::stop_flow_reader(int port_id)
 {
 	map<int, SDUReader *>::iterator it;
-	void * status;
+	SDUReader * reader;
 
-	ScopedLock g(lock);
+	lock.lock();
 	it = sdu_readers.find(port_id);
-	if (it != sdu_readers.end()) {
-		sdu_readers.erase(it);
-		it->second->join(&status);
-		delete it->second;
+	if (it == sdu_readers.end()) {
+		lock.unlock();
+		return;
 	}
+
+	reader = it->second;
+	sdu_readers.erase(it);
+	lock.unlock();
+
+	sdu_loop.remove_fd(reader->fd);
+	delete reader;
 }
 
 //Class AbstractKM
@@ -794,46 +803,39 @@ AbstractKM * KMFactory::get_instance()
 }
 
 // Class SDUReader
+#define KM_MAX_SDU_SIZE 5000
+
 SDUReader::SDUReader(int port_id, int fd_)
-			: SimpleThread(std::string("sdu-reader"), false)
 {
 	portid = port_id;
 	fd = fd_;
+	message.message_ = new unsigned char[KM_MAX_SDU_SIZE];
 }
 
-int SDUReader::run()
+bool SDUReader::handle_event(int ready_fd, uint32_t events)
 {
-	rina::ser_obj_t message;
-	message.message_ = new unsigned char[5000];
 	int bytes_read = 0;
-	bool keep_going = true;
-
-	LOG_DBG("SDU reader of port-id %d starting", portid);
 
-	while(keep_going) {
-		LOG_INFO("Going to read from file descriptor %d", fd);
-		bytes_read = read(fd, message.message_, 5000);
-		if (bytes_read <= 0) {
-			LOG_INFO("Error reading fd %d or EOF", fd);
-			break;
-		}
+	bytes_read = read(fd, message.message_, KM_MAX_SDU_SIZE);
+	if (bytes_read <= 0) {
+		LOG_INFO("Error reading fd %d or EOF", fd);
+		LOG_DBG("SDU Reader of port-id %d terminating", portid);
+		return false;
+	}
 
-		LOG_INFO("Read %d bytes", bytes_read);
-		message.size_ = bytes_read;
+	LOG_INFO("Read %d bytes", bytes_read);
+	message.size_ = bytes_read;
 
-		//Instruct CDAP provider to process the CACEP message
-		try{
-			rina::cdap::getProvider()->process_message(message,
-								   portid);
-		} catch(rina::Exception &e){
-			LOG_ERR("Problems processing message from port-id %d",
-				portid);
-		}
+	//Instruct CDAP provider to process the CACEP message
+	try{
+		rina::cdap::getProvider()->process_message(message,
+							   portid);
+	} catch(rina::Exception &e){
+		LOG_ERR("Problems processing message from port-id %d",
+			portid);
 	}
 
-	LOG_DBG("SDU Reader of port-id %d terminating", portid);
-
-	return 0;
+	return true;
 }
 
 //Class Key Container Manager
@@ -31,6 +31,7 @@
 #include <string>
 #include <librina/cdap_v2.h>
 #include <librina/concurrency.h>
+#include <librina/event-loop.h>
 #include <librina/irm.h>
 #include <librina/rib_v2.h>
 #include <librina/security-manager.h>
@@ -124,23 +125,25 @@ private:
         KMSDUProtectionHandler * sdup;
 };
 
-class SDUReader : public rina::SimpleThread
+class SDUReader : public rina::EventHandler
 {
 public:
 	SDUReader(int port_id, int fd_);
-	~SDUReader() throw() {};
-	int run();
+	~SDUReader() {};
+	bool handle_event(int fd, uint32_t events);
+
+	int fd;
 
 private:
 	int portid;
-	int fd;
+	rina::ser_obj_t message;
 };
 
 class KMIPCResourceManager: public rina::IPCResourceManager,
 			    public rina::InternalEventListener
 {
 public:
-	KMIPCResourceManager() {};
+	KMIPCResourceManager();
 	~KMIPCResourceManager();
 
 	void set_application_process(rina::ApplicationProcess * ap);
@@ -160,6 +163,7 @@ private:
 
 	rina::Lockable lock;
 	std::map<int, SDUReader *> sdu_readers;
+	rina::EventLoop sdu_loop;
 };
 
 struct key_container
@@ -333,47 +333,41 @@ NMConsole::NMConsole(const std::string& socket_path, NetworkManager * nm) :
 }
 
 //Class SDUReader
+#define NM_MAX_SDU_SIZE 10000
+
 SDUReader::SDUReader(int port_id, int fd_, NetworkManager * nm)
-	: SimpleThread(std::string("sdu-reader"), false)
 {
 	portid = port_id;
 	fd = fd_;
 	netman = nm;
+	message.message_ = new unsigned char[NM_MAX_SDU_SIZE];
 }
 
-int SDUReader::run()
+bool SDUReader::handle_event(int ready_fd, uint32_t events)
 {
-	rina::ser_obj_t message;
-	message.message_ = new unsigned char[10000];
 	int bytes_read = 0;
 
-	LOG_DBG("SDU reader of port-id %d starting", portid);
-
-	while(true) {
-		LOG_DBG("Going to read from file descriptor %d", fd);
-		bytes_read = read(fd, message.message_, 10000);
-		if (bytes_read <= 0) {
-			LOG_ERR("Read error or EOF: %d", bytes_read);
-			break;
-		}
+	bytes_read = read(fd, message.message_, NM_MAX_SDU_SIZE);
+	if (bytes_read <= 0) {
+		LOG_ERR("Read error or EOF: %d", bytes_read);
+		LOG_DBG("SDU Reader of port-id %d terminating", portid);
+		netman->disconnect_from_system_async(fd);
+		return false;
+	}
 
-		LOG_DBG("Read %d bytes", bytes_read);
-		message.size_ = bytes_read;
+	LOG_DBG("Read %d bytes", bytes_read);
+	message.size_ = bytes_read;
 
-		//Instruct CDAP provider to process the CACEP message
-		try{
-			rina::cdap::getProvider()->process_message(message,
-								   portid);
-		} catch(rina::Exception &e){
-			LOG_ERR("Problems processing message from port-id %d",
-				portid);
-		}
+	//Instruct CDAP provider to process the CACEP message
+	try{
+		rina::cdap::getProvider()->process_message(message,
+							   portid);
+	} catch(rina::Exception &e){
+		LOG_ERR("Problems processing message from port-id %d",
+			portid);
 	}
 
-	LOG_DBG("SDU Reader of port-id %d terminating", portid);
-	netman->disconnect_from_system_async(fd);
-
-	return 0;
+	return true;
 }
 
 //Struct ManagedSystem
@@ -581,7 +575,8 @@ NetworkManager::NetworkManager(const std::string& app_name,
 			       const std::string& app_instance,
 			       const std::string& console_path,
 			       const std::string& dif_templates_path) :
-			       	       rina::ApplicationProcess(app_name, app_instance)
+			       	       rina::ApplicationProcess(app_name, app_instance),
+			       	       sdu_loop("nm-sdu-readers", 4)
 {
 	std::stringstream ss;
 	rina::rib::RIBObj * tmp;
@@ -613,11 +608,12 @@ NetworkManager::NetworkManager(const std::string& app_name,
 
 NetworkManager::~NetworkManager()
 {
-	void * status;
 	std::map<int, SDUReader *>::iterator itr;
 	std::map<std::string, TransactionState*>::iterator t_itr;
 	SDUReader * reader;
 
+	sdu_loop.stop();
+
 	if (console)
 		delete console;
 
@@ -638,7 +634,6 @@ NetworkManager::~NetworkManager()
 	while (itr != sdu_readers.end()) {
 		close(itr->first);
 		reader = itr->second;
-		reader->join(&status);
 		sdu_readers.erase(itr++);
 		delete reader;
 	}
@@ -658,6 +653,8 @@ void NetworkManager::event_loop(std::list<std::string>& dif_names)
 	char *incomingapn = NULL;
 	int nfd = 0;
 
+	sdu_loop.start();
+
 	// 1 Open RINA descriptor
 	cfd = rina_open();
 	if (cfd < 0) {
@@ -707,11 +704,10 @@ void NetworkManager::n1_flow_accepted(const char * incoming_apn, int fd)
 
 	// Use fd as port-id
 	reader = new SDUReader(fd, fd, this);
-	reader->start();
-
 	sdu_readers[fd] = reader;
 
 	rina::cdap::add_fd_to_port_id_mapping(fd, fd);
+	sdu_loop.add_fd(fd, reader);
 }
 
 int NetworkManager::assign_system_id(void)
@@ -748,7 +744,6 @@ void NetworkManager::disconnect_from_system_async(int fd)
 
 void NetworkManager::disconnect_from_system(int fd)
 {
-	void * status;
 	std::map<int, SDUReader *>::iterator itr;
 	std::map<std::string, ManagedSystem *>::iterator it;
 	std::stringstream ss;
@@ -782,16 +777,19 @@ void NetworkManager::disconnect_from_system(int fd)
 	}
 
 	// Remove SDU Reader
-	rina::ScopedLock g(lock);
-
+	lock.lock();
 	itr = sdu_readers.find(fd);
-	if (itr == sdu_readers.end())
+	if (itr == sdu_readers.end()) {
+		lock.unlock();
 		return;
+	}
 
-	close(itr->first);
 	reader = itr->second;
-	reader->join(&status);
 	sdu_readers.erase(itr);
+	lock.unlock();
+
+	sdu_loop.remove_fd(fd);
+	close(fd);
 
 	delete reader;
 }
@@ -31,6 +31,7 @@
 #include <string>
 #include <librina/cdap_v2.h>
 #include <librina/concurrency.h>
+#include <librina/event-loop.h>
 #include <librina/console.h>
 #include <librina/irm.h>
 #include <librina/rib_v2.h>
@@ -234,17 +235,18 @@ private:
 };
 
 //Class SDUReader
-class SDUReader : public rina::SimpleThread
+class SDUReader : public rina::EventHandler
 {
 public:
 	SDUReader(int port_id, int fd_, NetworkManager * nm);
-	~SDUReader() throw() {};
-	int run();
+	~SDUReader() {};
+	bool handle_event(int fd, uint32_t events);
 
 private:
 	int portid;
 	int fd;
 	NetworkManager * netman;
+	rina::ser_obj_t message;
 };
 
 typedef enum nm_res{
@@ -426,6 +428,7 @@ private:
 	/// Readers of N-1 flows
 	rina::Lockable lock;
 	std::map<int, SDUReader *> sdu_readers;
+	rina::EventLoop sdu_loop;
 
 	// Variables for handling transactions
 	rina::ReadWriteLockable trans_rwlock;
@@ -0,0 +1,314 @@
+/*
+ * rina-alloc-bench: measures the flow allocation latency and the
+ * sustained flow allocation rate of a DIF
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+
+#include <rina/api.h>
+
+#define DEFAULT_CLI_NAME "rina-alloc-bench|client"
+#define DEFAULT_SRV_NAME "rina-alloc-bench|server"
+#define DEFAULT_NUM_ALLOCS 1000
+#define DEFAULT_WINDOW 1
+#define MAX_WINDOW 1024
+#define MAX_SERVER_FLOWS 4096
+
+struct pending_alloc {
+    int wfd;
+    struct timespec start;
+};
+
+static unsigned long
+elapsed_us(const struct timespec *from, const struct timespec *to)
+{
+    return (to->tv_sec - from->tv_sec) * 1000000UL +
+           (to->tv_nsec - from->tv_nsec) / 1000L;
+}
+
+static int
+cmp_ulong(const void *a, const void *b)
+{
+    unsigned long x = *(const unsigned long *)a;
+    unsigned long y = *(const unsigned long *)b;
+
+    return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+static unsigned long
+percentile(const unsigned long *sorted, unsigned int n, double p)
+{
+    unsigned int i = (unsigned int)(p * (n - 1) + 0.5);
+
+    return sorted[i];
+}
+
+static int
+run_server(const char *dif_name, const char *srv_name)
+{
+    struct pollfd pfds[MAX_SERVER_FLOWS + 1];
+    unsigned int nfds = 1;
+    unsigned long accepted = 0;
+    char buf[64];
+    int rfd;
+
+    rfd = rina_open();
+    if (rfd < 0) {
+        perror("rina_open()");
+        return -1;
+    }
+
+    if (rina_register(rfd, dif_name, srv_name, 0) < 0) {
+        perror("rina_register()");
+        close(rfd);
+        return -1;
+    }
+
+    printf("Accepting flows to %s\n", srv_name);
+
+    pfds[0].fd = rfd;
+    pfds[0].events = POLLIN;
+
+    for (;;) {
+        unsigned int i;
+
+        if (poll(pfds, nfds, -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            perror("poll()");
+            break;
+        }
+
+        /* Flows are kept until the client deallocates them */
+        for (i = 1; i < nfds; i++) {
+            if (!pfds[i].revents)
+                continue;
+
+            if (read(pfds[i].fd, buf, sizeof(buf)) > 0)
+                continue;
+
+            close(pfds[i].fd);
+            pfds[i] = pfds[--nfds];
+            i--;
+        }
+
+        if (!(pfds[0].revents & POLLIN))
+            continue;
+
+        int fd = rina_flow_accept(rfd, NULL, NULL, 0);
+        if (fd < 0) {
+            perror("rina_flow_accept()");
+            continue;
+        }
+
+        if (nfds == MAX_SERVER_FLOWS + 1) {
+            close(fd);
+            continue;
+        }
+
+        pfds[nfds].fd = fd;
+        pfds[nfds].events = POLLIN;
+        pfds[nfds].revents = 0;
+        nfds++;
+
+        if (++accepted % 1000 == 0)
+            printf("%lu flows accepted\n", accepted);
+    }
+
+    close(rfd);
+
+    return 0;
+}
+
+static int
+run_client(const char *dif_name, const char *cli_name, const char *srv_name,
+           unsigned int num_allocs, unsigned int window)
+{
+    struct pending_alloc pending[MAX_WINDOW];
+    struct pollfd pfds[MAX_WINDOW];
+    struct rina_flow_spec spec;
+    struct timespec begin, end, now;
+    unsigned long *latencies;
+    unsigned long sum = 0;
+    unsigned int started = 0;
+    unsigned int completed = 0;
+    unsigned int failed = 0;
+    unsigned int inflight = 0;
+    unsigned int i;
+    double secs;
+
+    latencies = malloc(num_allocs * sizeof(*latencies));
+    if (!latencies) {
+        fprintf(stderr, "Out of memory\n");
+        return -1;
+    }
+
+    rina_flow_spec_unreliable(&spec);
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+
+    while (completed + failed < num_allocs) {
+        /* Keep the window of outstanding allocations full */
+        while (inflight < window && started < num_allocs) {
+            pending[inflight].wfd = rina_flow_alloc(dif_name, cli_name,
+                                                    srv_name, &spec,
+                                                    RINA_F_NOWAIT);
+            started++;
+            if (pending[inflight].wfd < 0) {
+                perror("rina_flow_alloc()");
+                failed++;
+                continue;
+            }
+
+            clock_gettime(CLOCK_MONOTONIC, &pending[inflight].start);
+            pfds[inflight].fd = pending[inflight].wfd;
+            pfds[inflight].events = POLLIN;
+            inflight++;
+        }
+
+        if (inflight == 0)
+            continue;
+
+        if (poll(pfds, inflight, -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            perror("poll()");
+            break;
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &now);
+
+        for (i = 0; i < inflight; i++) {
+            int fd;
+
+            if (!pfds[i].revents)
+                continue;
+
+            fd = rina_flow_alloc_wait(pending[i].wfd);
+            if (fd < 0) {
+                perror("rina_flow_alloc_wait()");
+                failed++;
+            } else {
+                latencies[completed] = elapsed_us(&pending[i].start, &now);
+                sum += latencies[completed];
+                completed++;
+                close(fd);
+            }
+
+            inflight--;
+            pending[i] = pending[inflight];
+            pfds[i] = pfds[inflight];
+            i--;
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    secs = elapsed_us(&begin, &end) / 1000000.0;
+
+    printf("Allocations: %u completed, %u failed, window %u\n", completed,
+           failed, window);
+    printf("Rate: %.1f allocations/s over %.3f s\n",
+           secs > 0 ? completed / secs : 0.0, secs);
+
+    if (completed > 0) {
+        qsort(latencies, completed, sizeof(*latencies), cmp_ulong);
+        printf("Latency (us): min %lu avg %lu p50 %lu p90 %lu p99 %lu "
+               "p99.9 %lu max %lu\n",
+               latencies[0], sum / completed,
+               percentile(latencies, completed, 0.5),
+               percentile(latencies, completed, 0.9),
+               percentile(latencies, completed, 0.99),
+               percentile(latencies, completed, 0.999),
+               latencies[completed - 1]);
+    }
+
+    free(latencies);
+
+    return failed ? -1 : 0;
+}
+
+static void
+usage(void)
+{
+    printf("rina-alloc-bench [OPTIONS]\n"
+           "   -h : show this help\n"
+           "   -l : run as server (accept flows)\n"
+           "   -d DIF : name of the DIF to use\n"
+           "   -a APNAME : name of the client application (default %s)\n"
+           "   -z APNAME : name of the server application (default %s)\n"
+           "   -n NUM : number of flows to allocate (default %d)\n"
+           "   -w NUM : allocations in flight at the same time, "
+           "max %d (default %d)\n",
+           DEFAULT_CLI_NAME, DEFAULT_SRV_NAME, DEFAULT_NUM_ALLOCS,
+           MAX_WINDOW, DEFAULT_WINDOW);
+}
+
+int
+main(int argc, char **argv)
+{
+    const char *cli_name = DEFAULT_CLI_NAME;
+    const char *srv_name = DEFAULT_SRV_NAME;
+    const char *dif_name = NULL;
+    unsigned int num_allocs = DEFAULT_NUM_ALLOCS;
+    unsigned int window = DEFAULT_WINDOW;
+    int listen = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "hld:a:z:n:w:")) != -1) {
+        switch (opt) {
+        case 'h':
+            usage();
+            return 0;
+        case 'l':
+            listen = 1;
+            break;
+        case 'd':
+            dif_name = optarg;
+            break;
+        case 'a':
+            cli_name = optarg;
+            break;
+        case 'z':
+            srv_name = optarg;
+            break;
+        case 'n':
+            num_allocs = atoi(optarg);
+            break;
+        case 'w':
+            window = atoi(optarg);
+            break;
+        default:
+            usage();
+            return -1;
+        }
+    }
+
+    if (num_allocs == 0 || window == 0 || window > MAX_WINDOW) {
+        usage();
+        return -1;
+    }
+
+    if (listen)
+        return run_server(dif_name, srv_name);
+
+    return run_client(dif_name, cli_name, srv_name, num_allocs, window);
+}
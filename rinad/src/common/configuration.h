@@ -38,7 +38,8 @@ class EnrollmentInformationRequest {
  public:
         EnrollmentInformationRequest()
                         : address_(0),
-                          allowed_to_start_early_(false)
+                          allowed_to_start_early_(false),
+                          snapshot_compression_(false)
         {
         }
         ;
@@ -49,6 +50,13 @@ class EnrollmentInformationRequest {
         std::list<rina::ApplicationProcessNamingInformation> supporting_difs_;
         bool allowed_to_start_early_;
         std::string token;
+
+        /// The sections of the RIB the requester can receive in
+        /// an enrollment snapshot
+        std::list<std::string> snapshot_sections_;
+
+        /// The requester can receive a compressed enrollment snapshot
+        bool snapshot_compression_;
 };
 
 /// Encapsulates all the information required to manage a Flow
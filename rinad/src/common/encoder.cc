@@ -267,6 +267,51 @@ void DFTEListEncoder::decode(const rina::ser_obj_t &serobj,
 	}
 }
 
+// CLASS DFTDeltaEncoder
+void DFTDeltaEncoder::encode(const DFTDelta &obj,
+			     rina::ser_obj_t& serobj)
+{
+	rina::messages::directoryForwardingTableEntrySet_t gpb;
+	std::list<rina::DirectoryForwardingTableEntry>::const_iterator it;
+
+	for (it = obj.added.begin(); it != obj.added.end(); ++it) {
+		dft_helpers::toGPB(*it, *gpb.add_directoryforwardingtableentry());
+	}
+
+	for (it = obj.removed.begin(); it != obj.removed.end(); ++it) {
+		dft_helpers::toGPB(*it, *gpb.add_removedentry());
+	}
+
+	if (obj.has_digest)
+		gpb.set_digest(obj.digest);
+
+	serobj.size_ = gpb.ByteSize();
+	serobj.message_ = new unsigned char[serobj.size_];
+	gpb.SerializeToArray(serobj.message_, serobj.size_);
+}
+
+void DFTDeltaEncoder::decode(const rina::ser_obj_t &serobj,
+			     DFTDelta &des_obj)
+{
+	rina::messages::directoryForwardingTableEntrySet_t gpb;
+	gpb.ParseFromArray(serobj.message_, serobj.size_);
+
+	for (int i = 0; i < gpb.directoryforwardingtableentry_size(); i++) {
+		rina::DirectoryForwardingTableEntry dfte;
+		dft_helpers::toModel(gpb.directoryforwardingtableentry(i), dfte);
+		des_obj.added.push_back(dfte);
+	}
+
+	for (int i = 0; i < gpb.removedentry_size(); i++) {
+		rina::DirectoryForwardingTableEntry dfte;
+		dft_helpers::toModel(gpb.removedentry(i), dfte);
+		des_obj.removed.push_back(dfte);
+	}
+
+	des_obj.has_digest = gpb.has_digest();
+	des_obj.digest = gpb.digest();
+}
+
 namespace dif_alloc_helpers {
 void toGPB(const AppToDIFMapping &obj,
            rina::messages::app_name_to_dif_mapping_t &gpb)
@@ -944,6 +989,14 @@ void EnrollmentInformationRequestEncoder::encode(
                 gpb.add_supportingdifs(it->processName);
         }
 
+        for (std::list<std::string>::const_iterator it =
+                        obj.snapshot_sections_.begin();
+                        it != obj.snapshot_sections_.end(); ++it)
+        {
+                gpb.add_snapshotsections(*it);
+        }
+        gpb.set_snapshotcompression(obj.snapshot_compression_);
+
         serobj.size_ = gpb.ByteSize();
         serobj.message_ = new unsigned char[serobj.size_];
         gpb.SerializeToArray(serobj.message_, serobj.size_);
@@ -966,6 +1019,78 @@ void EnrollmentInformationRequestEncoder::decode(
                                 rina::ApplicationProcessNamingInformation(
                                                 gpb.supportingdifs(i), ""));
         }
+
+        for (int i = 0; i < gpb.snapshotsections_size(); ++i)
+        {
+                des_obj.snapshot_sections_.push_back(gpb.snapshotsections(i));
+        }
+        des_obj.snapshot_compression_ = gpb.snapshotcompression();
+}
+
+// CLASS EnrollmentSnapshotEncoder
+void EnrollmentSnapshotEncoder::encode(const EnrollmentSnapshot &obj,
+				       rina::ser_obj_t& serobj)
+{
+	rina::messages::enrollmentSnapshot_t gpb;
+	std::map<std::string, std::string>::const_iterator it;
+
+	gpb.set_version(obj.version);
+	for (it = obj.sections.begin(); it != obj.sections.end(); ++it) {
+		rina::messages::snapshotSection_t * section = gpb.add_sections();
+		section->set_name(it->first);
+		section->set_value(it->second);
+	}
+
+	serobj.size_ = gpb.ByteSize();
+	serobj.message_ = new unsigned char[serobj.size_];
+	gpb.SerializeToArray(serobj.message_, serobj.size_);
+}
+
+void EnrollmentSnapshotEncoder::decode(const rina::ser_obj_t &serobj,
+				       EnrollmentSnapshot &des_obj)
+{
+	rina::messages::enrollmentSnapshot_t gpb;
+	if (!gpb.ParseFromArray(serobj.message_, serobj.size_))
+		throw rina::Exception("Malformed enrollment snapshot");
+
+	des_obj.version = gpb.version();
+	for (int i = 0; i < gpb.sections_size(); i++) {
+		des_obj.sections[gpb.sections(i).name()] =
+				gpb.sections(i).value();
+	}
+}
+
+// CLASS EnrollmentSnapshotChunkEncoder
+void EnrollmentSnapshotChunkEncoder::encode(const EnrollmentSnapshotChunk &obj,
+					    rina::ser_obj_t& serobj)
+{
+	rina::messages::enrollmentSnapshotChunk_t gpb;
+
+	gpb.set_version(obj.version);
+	gpb.set_index(obj.index);
+	gpb.set_count(obj.count);
+	gpb.set_compressed(obj.compressed);
+	gpb.set_imagesize(obj.image_size);
+	gpb.set_data(obj.data);
+
+	serobj.size_ = gpb.ByteSize();
+	serobj.message_ = new unsigned char[serobj.size_];
+	gpb.SerializeToArray(serobj.message_, serobj.size_);
+}
+
+void EnrollmentSnapshotChunkEncoder::decode(const rina::ser_obj_t &serobj,
+					    EnrollmentSnapshotChunk &des_obj)
+{
+	rina::messages::enrollmentSnapshotChunk_t gpb;
+	if (!gpb.ParseFromArray(serobj.message_, serobj.size_))
+		throw rina::Exception("Malformed enrollment snapshot chunk");
+
+	des_obj.version = gpb.version();
+	des_obj.index = gpb.index();
+	des_obj.count = gpb.count();
+	des_obj.compressed = gpb.compressed();
+	des_obj.image_size = gpb.imagesize();
+	des_obj.data = gpb.data();
 }
 
 // CLASS FlowEncoder
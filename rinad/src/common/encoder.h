@@ -31,6 +31,7 @@
 #include "rina-configuration.h"
 
 #include <list>
+#include <map>
 
 namespace rinad {
 namespace encoders {
@@ -64,6 +65,32 @@ public:
                     std::list<rina::DirectoryForwardingTableEntry> &des_obj);
 };
 
+/// A batch of changes of the directory forwarding table. A batch without
+/// changes announces the digest of the DFT of the sender
+struct DFTDelta {
+	DFTDelta() : has_digest(false), digest(0) { };
+
+	/// Entries created or updated
+	std::list<rina::DirectoryForwardingTableEntry> added;
+
+	/// Entries removed
+	std::list<rina::DirectoryForwardingTableEntry> removed;
+
+	/// The digest of the DFT of the sender is included
+	bool has_digest;
+	unsigned long long digest;
+};
+
+/// Encoder of DFTDelta object, uses the same message as the
+/// DirectoryForwardingTableEntryList object
+class DFTDeltaEncoder : public rina::Encoder<DFTDelta> {
+public:
+        void encode(const DFTDelta &obj,
+                    rina::ser_obj_t& serobj);
+        void decode(const rina::ser_obj_t &serobj,
+                    DFTDelta &des_obj);
+};
+
 /// Encoder of AppDIFMapping object
 class AppDIFMappingEncoder : public rina::Encoder<AppToDIFMapping> {
 public:
@@ -149,6 +176,52 @@ public:
                     configs::EnrollmentInformationRequest &des_obj);
 };
 
+/// An image of parts of the RIB, sent to a new member of the DIF
+/// during enrollment so that it does not have to build them object
+/// by object
+struct EnrollmentSnapshot {
+	EnrollmentSnapshot() : version(0) { };
+
+	/// Identifies the image the chunks belong to
+	unsigned long long version;
+
+	/// Encoded contents of each section, by section name
+	std::map<std::string, std::string> sections;
+};
+
+/// Encoder of EnrollmentSnapshot object
+class EnrollmentSnapshotEncoder : public rina::Encoder<EnrollmentSnapshot> {
+public:
+        void encode(const EnrollmentSnapshot &obj,
+                    rina::ser_obj_t& serobj);
+        void decode(const rina::ser_obj_t &serobj,
+                    EnrollmentSnapshot &des_obj);
+};
+
+/// A piece of an encoded EnrollmentSnapshot, which may be compressed
+struct EnrollmentSnapshotChunk {
+	EnrollmentSnapshotChunk() : version(0), index(0), count(0),
+		compressed(false), image_size(0) { };
+
+	unsigned long long version;
+	unsigned int index;
+	unsigned int count;
+	bool compressed;
+
+	/// Size of the encoded image before compression
+	unsigned int image_size;
+	std::string data;
+};
+
+/// Encoder of EnrollmentSnapshotChunk object
+class EnrollmentSnapshotChunkEncoder : public rina::Encoder<EnrollmentSnapshotChunk> {
+public:
+        void encode(const EnrollmentSnapshotChunk &obj,
+                    rina::ser_obj_t& serobj);
+        void decode(const rina::ser_obj_t &serobj,
+                    EnrollmentSnapshotChunk &des_obj);
+};
+
 /// Encoder of the Flow
 class FlowEncoder : public rina::Encoder<configs::Flow> {
 public:
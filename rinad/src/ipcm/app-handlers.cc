@@ -307,6 +307,7 @@ void IPCManager_::app_reg_response_handler(rina::IpcmRegisterApplicationResponse
 		ret = IPCM_SUCCESS;
 	}
 	IPCPTransState* trans = get_transaction_state<IPCPTransState>(e->sequenceNumber);
+	TransactionStateRef ref(trans);
 
 	if(!trans){
 		//Transacion was not found
@@ -334,6 +335,7 @@ void IPCManager_::app_reg_response_handler(rina::IpcmRegisterApplicationResponse
 		//because code is different from IPCP to an APP, but
 		//there is a single event
 		t1 = get_transaction_state<APPregTransState>(trans->tid);
+		TransactionStateRef ref_t1(t1);
 		if(t1){
 			ipcm_register_response_app(e, ipcp, t1->req);
 		}else{
@@ -344,8 +346,7 @@ void IPCManager_::app_reg_response_handler(rina::IpcmRegisterApplicationResponse
 		ret = IPCM_FAILURE;
 	}
 
-	trans->completed(ret);
-	remove_transaction_state(trans->tid);
+	complete_transaction(trans, ret);
 }
 
 void IPCManager_::application_manager_app_unregistered(
@@ -488,6 +489,7 @@ void IPCManager_::unreg_app_response_handler(rina::IpcmUnregisterApplicationResp
 	APPUnregTransState* t1;
 	IPCPregTransState* t2;
 	IPCPTransState* trans = get_transaction_state<IPCPTransState>(e->sequenceNumber);
+	TransactionStateRef ref(trans);
 
 	if(!trans){
 		//Transacion was not found
@@ -514,12 +516,14 @@ void IPCManager_::unreg_app_response_handler(rina::IpcmUnregisterApplicationResp
 		//because code is different from IPCP to an APP, but
 		//there is a single event
 		t1 = get_transaction_state<APPUnregTransState>(trans->tid);
+		TransactionStateRef ref_t1(t1);
 
 		//Application registration
 		if(t1) {
 			ipcm_unregister_response_app(e, ipcp, t1->req);
 		} else {
 			t2 = get_transaction_state<IPCPregTransState>(e->sequenceNumber);
+			TransactionStateRef ref_t2(t2);
 			if (t2){
 				ipcm_unregister_response_ipcp(ipcp, e, t2);
 			}
@@ -533,8 +537,7 @@ void IPCManager_::unreg_app_response_handler(rina::IpcmUnregisterApplicationResp
 		ret = IPCM_FAILURE;
 	}
 
-	trans->completed(ret);
-	remove_transaction_state(trans->tid);
+	complete_transaction(trans, ret);
 }
 
 }//namespace rinad
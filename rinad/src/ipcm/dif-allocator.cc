@@ -946,57 +946,52 @@ int DDAFlowAcceptor::run()
 }
 
 //Class SDUReader
-class SDUReader : public rina::SimpleThread
+#define DA_MAX_SDU_SIZE 5000
+
+class SDUReader : public rina::EventHandler
 {
 public:
 	SDUReader(int port_id, int fd_);
-	~SDUReader() throw() {};
-	int run();
+	~SDUReader() {};
+	bool handle_event(int fd, uint32_t events);
 
 private:
 	int portid;
 	int fd;
+	rina::ser_obj_t message;
 };
 
 SDUReader::SDUReader(int port_id, int fd_)
-	: SimpleThread(std::string("sdu-reader"), false)
 {
 	portid = port_id;
 	fd = fd_;
+	message.message_ = new unsigned char[DA_MAX_SDU_SIZE];
 }
 
-int SDUReader::run()
+bool SDUReader::handle_event(int ready_fd, uint32_t events)
 {
-	rina::ser_obj_t message;
-	message.message_ = new unsigned char[5000];
 	int bytes_read = 0;
 
-	LOG_DBG("SDU reader of port-id %d starting", portid);
-
-	while(true) {
-		LOG_DBG("Going to read from file descriptor %d", fd);
-		bytes_read = read(fd, message.message_, 5000);
-		if (bytes_read <= 0) {
-			LOG_ERR("Read error or EOF: %d", bytes_read);
-			break;
-		}
+	bytes_read = read(fd, message.message_, DA_MAX_SDU_SIZE);
+	if (bytes_read <= 0) {
+		LOG_ERR("Read error or EOF: %d", bytes_read);
+		LOG_DBG("SDU Reader of port-id %d terminating", portid);
+		return false;
+	}
 
-		LOG_DBG("Read %d bytes", bytes_read);
-		message.size_ = bytes_read;
+	LOG_DBG("Read %d bytes", bytes_read);
+	message.size_ = bytes_read;
 
-		//Instruct CDAP provider to process the CACEP message
-		try{
-			rina::cdap::getProvider()->process_message(message,
-								   portid);
-		} catch(rina::Exception &e){
-			LOG_ERR("Problems processing message from port-id %d",
-				portid);
-		}
+	//Instruct CDAP provider to process the CACEP message
+	try{
+		rina::cdap::getProvider()->process_message(message,
+							   portid);
+	} catch(rina::Exception &e){
+		LOG_ERR("Problems processing message from port-id %d",
+			portid);
 	}
 
-	LOG_DBG("SDU Reader of port-id %d terminating", portid);
-
-	return 0;
+	return true;
 }
 
 //Class Dynamic DIF Allocator
@@ -1004,7 +999,8 @@ const std::string DynamicDIFAllocator::TYPE = "dynamic-dif-allocator";
 
 DynamicDIFAllocator::DynamicDIFAllocator(const rina::ApplicationProcessNamingInformation& app_name,
 		                         IPCManager_ * ipc_manager) :
-		DIFAllocator(), rina::ApplicationProcess(app_name.processName, app_name.processInstance)
+		DIFAllocator(), rina::ApplicationProcess(app_name.processName, app_name.processInstance),
+		sdu_loop("da-sdu-readers", 2)
 {
 	ribd = NULL;
 	et = NULL;
@@ -1017,6 +1013,8 @@ DynamicDIFAllocator::DynamicDIFAllocator(const rina::ApplicationProcessNamingInf
 		return;
 	}
 
+	sdu_loop.start();
+
 	facc = new DDAFlowAcceptor(this, cfd);
 	facc->start();
 }
@@ -1038,11 +1036,12 @@ DynamicDIFAllocator::~DynamicDIFAllocator()
 		delete dda_enroller;
 	}
 
+	sdu_loop.stop();
+
 	itr = sdu_readers.begin();
 	while (itr != sdu_readers.end()) {
 		close(itr->first);
 		reader = itr->second;
-		reader->join(&status);
 		sdu_readers.erase(itr++);
 		delete reader;
 	}
@@ -1052,20 +1051,22 @@ DynamicDIFAllocator::~DynamicDIFAllocator()
 
 void DynamicDIFAllocator::disconnect_from_peer(int fd)
 {
-	void * status;
 	std::map<int, SDUReader *>::iterator itr;
 	SDUReader * reader;
 
-	rina::ScopedLock g(lock);
-
+	lock.lock();
 	itr = sdu_readers.find(fd);
-	if (itr == sdu_readers.end())
+	if (itr == sdu_readers.end()) {
+		lock.unlock();
 		return;
+	}
 
-	close(itr->first);
 	reader = itr->second;
-	reader->join(&status);
 	sdu_readers.erase(itr);
+	lock.unlock();
+
+	sdu_loop.remove_fd(fd);
+	close(fd);
 
 	delete reader;
 }
@@ -1120,9 +1121,8 @@ void DynamicDIFAllocator::n1_flow_allocated(const rina::Neighbor& neighbor, int
 
 	// Use fd as port-id
 	reader = new SDUReader(fd, fd);
-	reader->start();
-
 	sdu_readers[fd] = reader;
+	sdu_loop.add_fd(fd, reader);
 
 	rina::cdap::add_fd_to_port_id_mapping(fd, fd);
 	et->initiateEnrollment(neighbor.name_, neighbor.supporting_dif_name_.processName,
@@ -1141,9 +1141,8 @@ void DynamicDIFAllocator::n1_flow_accepted(const char * incoming_apn, int fd)
 	rina::cdap::add_fd_to_port_id_mapping(fd, fd);
 
 	reader = new SDUReader(fd, fd);
-	reader->start();
-
 	sdu_readers[fd] = reader;
+	sdu_loop.add_fd(fd, reader);
 }
 
 void DynamicDIFAllocator::enrollment_completed(const rina::cdap_rib::con_handle_t &con)
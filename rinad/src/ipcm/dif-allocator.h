@@ -25,6 +25,7 @@
 #include <map>
 
 #include <librina/concurrency.h>
+#include <librina/event-loop.h>
 
 #include "rina-configuration.h"
 #include "ipcm.h"
@@ -138,6 +139,7 @@ private:
 	/// Readers of N-1 flows
 	rina::Lockable lock;
 	std::map<int, SDUReader *> sdu_readers;
+	rina::EventLoop sdu_loop;
 
 	DDAFlowAcceptor * facc;
 	std::map<std::string, AppToDIFMapping *> app_dif_mappings;
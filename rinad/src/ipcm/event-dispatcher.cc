@@ -0,0 +1,385 @@
+/*
+ * Dispatches the events received by the IPC Manager to a pool of workers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA  02110-1301  USA
+ */
+
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+#include <time.h>
+
+#define RINA_PREFIX "ipcm.event-dispatcher"
+#include <librina/logs.h>
+
+#include "event-dispatcher.h"
+#include "ipcm.h"
+
+namespace rinad {
+
+/* Class EventDispatcherWorker */
+class EventDispatcherWorker : public rina::SimpleThread {
+public:
+	EventDispatcherWorker(EventDispatcher * ed, unsigned int sh,
+			      const std::string& name) :
+		rina::SimpleThread(name, false), dispatcher(ed), shard(sh) { };
+	~EventDispatcherWorker() throw() { };
+
+	int run()
+	{
+		dispatcher->run_worker(shard);
+		return 0;
+	}
+
+private:
+	EventDispatcher * dispatcher;
+	unsigned int shard;
+};
+
+/* Set by each worker, so that transactions remember their shard */
+static __thread int worker_shard = -1;
+
+static unsigned long elapsed_us(const struct timespec& from,
+				const struct timespec& to)
+{
+	long us;
+
+	us = (to.tv_sec - from.tv_sec) * 1000000L +
+		(to.tv_nsec - from.tv_nsec) / 1000;
+
+	return us > 0 ? us : 0;
+}
+
+/* Bucket i > 0 holds the latencies in [2^(i-1), 2^i) us */
+static unsigned int lat_bucket(unsigned long us)
+{
+	unsigned int bucket = 0;
+
+	while (us && bucket < IPCM_EVENT_LAT_BUCKETS - 1) {
+		us >>= 1;
+		bucket++;
+	}
+
+	return bucket;
+}
+
+static void update_max(unsigned long * max, unsigned long val)
+{
+	unsigned long cur = __atomic_load_n(max, __ATOMIC_RELAXED);
+
+	while (val > cur && !__atomic_compare_exchange_n(max, &cur, val, false,
+							 __ATOMIC_RELAXED,
+							 __ATOMIC_RELAXED));
+}
+
+/* Upper bound (in us) of the bucket where the given percentile falls */
+static unsigned long percentile(const unsigned long * hist,
+				unsigned long count, unsigned int pct)
+{
+	unsigned long target = (count * pct + 99) / 100;
+	unsigned long acc = 0;
+
+	for (unsigned int i = 0; i < IPCM_EVENT_LAT_BUCKETS; i++) {
+		acc += hist[i];
+		if (acc >= target)
+			return 1UL << i;
+	}
+
+	return 1UL << (IPCM_EVENT_LAT_BUCKETS - 1);
+}
+
+static void print_hist(std::ostream& os, const std::string& name,
+		       const unsigned long * hist)
+{
+	os << "      " << name << ":";
+	for (unsigned int i = 0; i < IPCM_EVENT_LAT_BUCKETS; i++) {
+		if (!hist[i])
+			continue;
+		os << " <" << (1UL << i) << "us:" << hist[i];
+	}
+	os << std::endl;
+}
+
+/* Class EventDispatcher */
+EventDispatcher::EventDispatcher(unsigned int nworkers)
+{
+	num_workers = nworkers > 0 ? nworkers : 1;
+	running = false;
+	memset(stats, 0, sizeof(stats));
+}
+
+EventDispatcher::~EventDispatcher() throw()
+{
+	stop();
+}
+
+void EventDispatcher::start()
+{
+	EventDispatcherWorker * worker;
+	std::stringstream ss;
+
+	if (running)
+		return;
+
+	/* All the queues exist before the workers look them up */
+	queues_lock.lock();
+	for (unsigned int i = 0; i < num_workers; i++)
+		queues.push_back(new rina::BlockingFIFOQueue<queued_event>());
+	queues_lock.unlock();
+
+	for (unsigned int i = 0; i < num_workers; i++) {
+		ss.str("");
+		ss << "ipcm-events-" << i;
+		worker = new EventDispatcherWorker(this, i, ss.str());
+		worker->start();
+		workers.push_back(worker);
+	}
+	running = true;
+
+	LOG_DBG("Event dispatcher started with %u workers", num_workers);
+}
+
+void EventDispatcher::stop()
+{
+	queued_event * qe;
+	void * status;
+
+	if (!running)
+		return;
+	running = false;
+
+	/* Events queued before the stop marker are still handled */
+	for (unsigned int i = 0; i < num_workers; i++) {
+		qe = new queued_event();
+		qe->event = NULL;
+		qe->task = NULL;
+		queues[i]->put(qe);
+	}
+
+	for (unsigned int i = 0; i < num_workers; i++) {
+		workers[i]->join(&status);
+		delete workers[i];
+	}
+	workers.clear();
+
+	/* A worker may have queued a task in a shard that had already
+	 * stopped, run it here so that its transaction is completed */
+	queues_lock.lock();
+	for (unsigned int i = 0; i < num_workers; i++) {
+		while ((qe = queues[i]->poll()) != 0) {
+			if (qe->task) {
+				run_task(qe->task);
+			} else {
+				delete qe->event;
+			}
+			delete qe;
+		}
+		delete queues[i];
+	}
+	queues.clear();
+	queues_lock.unlock();
+
+	LOG_DBG("Event dispatcher stopped");
+}
+
+/* Events whose sequence number is the id of an IPCM transaction */
+static bool is_transaction_reply(rina::IPCEventType type)
+{
+	switch (type) {
+	case rina::ALLOCATE_FLOW_RESPONSE_EVENT:
+	case rina::ASSIGN_TO_DIF_RESPONSE_EVENT:
+	case rina::UPDATE_DIF_CONFIG_RESPONSE_EVENT:
+	case rina::ENROLL_TO_DIF_RESPONSE_EVENT:
+	case rina::DISCONNECT_NEIGHBOR_RESPONSE_EVENT:
+	case rina::IPCM_REGISTER_APP_RESPONSE_EVENT:
+	case rina::IPCM_UNREGISTER_APP_RESPONSE_EVENT:
+	case rina::IPCM_ALLOCATE_FLOW_REQUEST_RESULT:
+	case rina::QUERY_RIB_RESPONSE_EVENT:
+	case rina::IPC_PROCESS_SET_POLICY_SET_PARAM_RESPONSE:
+	case rina::IPC_PROCESS_SELECT_POLICY_SET_RESPONSE:
+	case rina::IPC_PROCESS_PLUGIN_LOAD_RESPONSE:
+		return true;
+	default:
+		return false;
+	}
+}
+
+int EventDispatcher::current_shard()
+{
+	return worker_shard;
+}
+
+unsigned int EventDispatcher::get_shard(const rina::IPCEvent * event) const
+{
+	int shard;
+
+	/* The events of an IPCP, replies included, are handled in order */
+	if (event->ipcp_id)
+		return event->ipcp_id % num_workers;
+
+	/* Events of applications do not carry an IPCP id. A reply of an
+	 * application (e.g. accepting a flow) goes to the shard that
+	 * started the transaction */
+	if (is_transaction_reply(event->eventType)) {
+		shard = IPCManager->get_transaction_shard(event->sequenceNumber);
+		if (shard >= 0 && (unsigned int) shard < num_workers)
+			return shard;
+	}
+
+	return event->ctrl_port % num_workers;
+}
+
+void EventDispatcher::dispatch(rina::IPCEvent * event)
+{
+	queued_event * qe;
+
+	qe = new queued_event();
+	qe->event = event;
+	qe->task = NULL;
+	clock_gettime(CLOCK_MONOTONIC, &qe->enqueued);
+
+	queues[get_shard(event)]->put(qe);
+}
+
+void EventDispatcher::dispatch_task(unsigned int shard, rina::TimerTask * task)
+{
+	queued_event * qe;
+
+	qe = new queued_event();
+	qe->event = NULL;
+	qe->task = task;
+	clock_gettime(CLOCK_MONOTONIC, &qe->enqueued);
+
+	queues[shard % num_workers]->put(qe);
+}
+
+void EventDispatcher::run_task(rina::TimerTask * task)
+{
+	try {
+		task->run();
+	} catch (rina::Exception &e) {
+		LOG_ERR("Problems running task %s: %s", task->name().c_str(),
+			e.what());
+	}
+	delete task;
+}
+
+void EventDispatcher::account(rina::IPCEventType type, const queued_event& qe,
+			      const struct timespec& started,
+			      const struct timespec& finished)
+{
+	event_type_stats * st;
+	unsigned long queue_us, handle_us;
+
+	if (type < 0 || type > rina::NO_EVENT)
+		type = rina::NO_EVENT;
+
+	st = &stats[type];
+	queue_us = elapsed_us(qe.enqueued, started);
+	handle_us = elapsed_us(started, finished);
+
+	__atomic_add_fetch(&st->count, 1, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&st->queue_hist[lat_bucket(queue_us)], 1,
+			   __ATOMIC_RELAXED);
+	__atomic_add_fetch(&st->handle_hist[lat_bucket(handle_us)], 1,
+			   __ATOMIC_RELAXED);
+	update_max(&st->queue_max_us, queue_us);
+	update_max(&st->handle_max_us, handle_us);
+}
+
+void EventDispatcher::run_worker(unsigned int shard)
+{
+	rina::BlockingFIFOQueue<queued_event> * queue = queues[shard];
+	struct timespec started, finished;
+	rina::IPCEventType type;
+	queued_event * qe;
+
+	worker_shard = shard;
+
+	for (;;) {
+		qe = queue->take();
+		if (qe->task) {
+			run_task(qe->task);
+			delete qe;
+			continue;
+		}
+		if (!qe->event) {
+			delete qe;
+			break;
+		}
+
+		/* The event is deleted by the handler */
+		type = qe->event->eventType;
+		clock_gettime(CLOCK_MONOTONIC, &started);
+		IPCManager->handle_event(qe->event);
+		clock_gettime(CLOCK_MONOTONIC, &finished);
+
+		account(type, *qe, started, finished);
+		delete qe;
+	}
+}
+
+void EventDispatcher::print_stats(std::ostream& os)
+{
+	event_type_stats st;
+
+	os << "Event dispatcher: " << num_workers << " workers, queue depths:";
+	queues_lock.lock();
+	for (unsigned int i = 0; i < queues.size(); i++)
+		os << " " << queues[i]->size();
+	queues_lock.unlock();
+	os << std::endl;
+
+	os << std::left << std::setw(44) << "Event type" << std::right
+	   << std::setw(10) << "Count"
+	   << std::setw(26) << "Queued p50/p99/max (us)"
+	   << std::setw(26) << "Handled p50/p99/max (us)" << std::endl;
+
+	for (int i = 0; i <= rina::NO_EVENT; i++) {
+		for (unsigned int j = 0; j < IPCM_EVENT_LAT_BUCKETS; j++) {
+			st.queue_hist[j] = __atomic_load_n(
+				&stats[i].queue_hist[j], __ATOMIC_RELAXED);
+			st.handle_hist[j] = __atomic_load_n(
+				&stats[i].handle_hist[j], __ATOMIC_RELAXED);
+		}
+		st.count = __atomic_load_n(&stats[i].count, __ATOMIC_RELAXED);
+		st.queue_max_us = __atomic_load_n(&stats[i].queue_max_us,
+						  __ATOMIC_RELAXED);
+		st.handle_max_us = __atomic_load_n(&stats[i].handle_max_us,
+						   __ATOMIC_RELAXED);
+		if (!st.count)
+			continue;
+
+		std::stringstream queued, handled;
+		queued << percentile(st.queue_hist, st.count, 50) << "/"
+		       << percentile(st.queue_hist, st.count, 99) << "/"
+		       << st.queue_max_us;
+		handled << percentile(st.handle_hist, st.count, 50) << "/"
+			<< percentile(st.handle_hist, st.count, 99) << "/"
+			<< st.handle_max_us;
+
+		os << std::left << std::setw(44)
+		   << rina::IPCEvent::eventTypeToString(
+				   (rina::IPCEventType) i)
+		   << std::right << std::setw(10) << st.count
+		   << std::setw(26) << queued.str()
+		   << std::setw(26) << handled.str() << std::endl;
+		print_hist(os, "queued ", st.queue_hist);
+		print_hist(os, "handled", st.handle_hist);
+	}
+}
+
+} //namespace rinad
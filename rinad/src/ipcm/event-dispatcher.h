@@ -0,0 +1,119 @@
+/*
+ * Dispatches the events received by the IPC Manager to a pool of workers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA  02110-1301  USA
+ */
+
+#ifndef __EVENT_DISPATCHER_H__
+#define __EVENT_DISPATCHER_H__
+
+#include <ostream>
+#include <vector>
+
+#include <librina/common.h>
+#include <librina/concurrency.h>
+#include <librina/timer.h>
+
+namespace rinad {
+
+/// Number of workers of the IPCM event dispatcher
+#define IPCM_EVENT_WORKERS 4
+
+/// Latency histograms have power of two buckets, starting at 1 us
+#define IPCM_EVENT_LAT_BUCKETS 24
+
+class EventDispatcherWorker;
+
+/// Latency statistics of one event type
+struct event_type_stats {
+	unsigned long count;
+	unsigned long queue_hist[IPCM_EVENT_LAT_BUCKETS];
+	unsigned long handle_hist[IPCM_EVENT_LAT_BUCKETS];
+	unsigned long queue_max_us;
+	unsigned long handle_max_us;
+};
+
+/// An event waiting to be handled by a worker, or a task to run in the
+/// worker (e.g. the completion of a transaction). Both NULL stop the worker
+struct queued_event {
+	rina::IPCEvent * event;
+	rina::TimerTask * task;
+	struct timespec enqueued;
+};
+
+/// Spreads the events coming from the kernel, the IPC Process daemons
+/// and the applications over a pool of workers. Events are sharded by the
+/// id of the IPCP that generated them (or by the control port of the
+/// application, for events not generated by an IPCP), so that the events of
+/// each IPCP or application are handled in order, while the ones of
+/// different IPCPs and applications are handled in parallel. The replies
+/// of an IPCP to a transaction stay in the shard of the IPCP, so they are
+/// ordered with the other events of the IPCP, and the transaction is then
+/// completed in the shard that started it (see dispatch_task()).
+/// The events that refer to one IPCP can therefore run in several
+/// workers at once (e.g. the flow requests of two applications), so
+/// the state they update while holding the IPCP rwlock as readers needs
+/// its own lock (see IPCMIPCProcess::flows_lock).
+class EventDispatcher {
+public:
+	EventDispatcher(unsigned int nworkers = IPCM_EVENT_WORKERS);
+	~EventDispatcher() throw();
+
+	/// Start the workers
+	void start();
+
+	/// Wait for the queued events to be handled and stop the workers
+	void stop();
+
+	/// Queue the event in the worker of its shard
+	void dispatch(rina::IPCEvent * event);
+
+	/// Run the task in the worker of a shard, after the events already
+	/// queued there. The dispatcher takes ownership of the task
+	void dispatch_task(unsigned int shard, rina::TimerTask * task);
+
+	/// Write the per event type latency histograms
+	void print_stats(std::ostream& os);
+
+	/// Called by the workers
+	void run_worker(unsigned int shard);
+
+	/// The shard of the calling worker, -1 if not called from a worker
+	static int current_shard();
+
+private:
+	unsigned int get_shard(const rina::IPCEvent * event) const;
+	static void run_task(rina::TimerTask * task);
+	void account(rina::IPCEventType type, const queued_event& qe,
+		     const struct timespec& started,
+		     const struct timespec& finished);
+
+	unsigned int num_workers;
+	bool running;
+	std::vector<EventDispatcherWorker *> workers;
+	std::vector<rina::BlockingFIFOQueue<queued_event> *> queues;
+
+	/// Guards the vector of queues against start() and stop() while
+	/// the statistics are printed
+	rina::Lockable queues_lock;
+
+	/// Updated by the workers with atomic operations
+	event_type_stats stats[rina::NO_EVENT + 1];
+};
+
+} //namespace rinad
+
+#endif  /* __EVENT_DISPATCHER_H__ */
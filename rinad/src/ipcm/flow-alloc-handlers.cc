@@ -533,6 +533,7 @@ void IPCManager_::ipcm_allocate_flow_request_result_handler(rina::IpcmAllocateFl
 	ipcm_res_t ret;
 	FlowAllocTransState* trans =
 		get_transaction_state<FlowAllocTransState>(event->sequenceNumber);
+	TransactionStateRef ref(trans);
 
 	if (!trans){
 		ss  << ": Warning: Flow allocation request result "
@@ -610,8 +611,7 @@ void IPCManager_::ipcm_allocate_flow_request_result_handler(rina::IpcmAllocateFl
 		}
 	}
 
-	trans->completed(ret);
-	remove_transaction_state(trans->tid);
+	complete_transaction(trans, ret);
 }
 
 void IPCManager_::allocate_flow_response_event_handler(rina::AllocateFlowResponseEvent *event)
@@ -622,6 +622,7 @@ void IPCManager_::allocate_flow_response_event_handler(rina::AllocateFlowRespons
 	ipcm_res_t ret;
 	FlowAllocTransState* trans =
 		get_transaction_state<FlowAllocTransState>(event->sequenceNumber);
+	TransactionStateRef ref(trans);
 
 
 	if (!trans){
@@ -671,8 +672,7 @@ void IPCManager_::allocate_flow_response_event_handler(rina::AllocateFlowRespons
 		req_event.portId = -1;
 		ret = IPCM_FAILURE;
 	}
-	trans->completed(ret);
-	remove_transaction_state(trans->tid);
+	complete_transaction(trans, ret);
 }
 
 ipcm_res_t IPCManager_::flow_deallocation_requested_event_handler(Promise * promise,
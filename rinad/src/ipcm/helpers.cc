@@ -171,6 +171,7 @@ IPCManager_::application_has_flow_by_ipcp(pid_t pid, IPCMIPCProcess *slave_ipcp,
 
 	//Prevent any insertion/deletion to happen
 	rina::ReadScopedLock readlock(ipcp_factory_.rwlock);
+	rina::ScopedLock flows_guard(slave_ipcp->flows_lock);
 
 	for (it = slave_ipcp->allocatedFlows.begin();
 				it != slave_ipcp->allocatedFlows.end(); it++) {
@@ -217,6 +218,7 @@ IPCManager_::collect_flows_by_pid(pid_t pid, list<rina::FlowInformation>& result
 	result.clear();
 
 	for (unsigned int i = 0; i < ipcps.size(); i++) {
+		rina::ScopedLock flows_guard(ipcps[i]->flows_lock);
 		const list<rina::FlowInformation>& flows =
 			ipcps[i]->allocatedFlows;
 
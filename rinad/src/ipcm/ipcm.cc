@@ -114,10 +114,8 @@ IPCManager_::~IPCManager_()
 
 	forwarded_calls.clear();
 
-	for (std::map<int, TransactionState*>::iterator
-			it = pend_transactions.begin(); it != pend_transactions.end(); ++it) {
-		delete it->second;
-	}
+	pend_transactions.deleteValues();
+	pend_sys_trans.deleteValues();
 
 	rina::removedir_all("/tmp/rina");
 }
@@ -1925,7 +1923,9 @@ TransactionState::TransactionState(Addon* callee_, Promise* _promise)
         : promise(_promise),
           tid(IPCManager->__tid_gen.next()),
           callee(callee_),
-          finalised(false)
+          shard(-1),
+          finalised(false),
+          refs(1)
 {
     if (promise)
     {
@@ -1939,20 +1939,17 @@ TransactionState::TransactionState(Addon* callee_, Promise* _promise)
 int IPCManager_::add_transaction_state(TransactionState* t)
 {
 
-    //Lock
-    rina::WriteScopedLock writelock(trans_rwlock);
+    //Replies are handled by the shard that started the transaction
+    t->shard = EventDispatcher::current_shard();
 
-    //Check if exists already
-    if (pend_transactions.find(t->tid) != pend_transactions.end())
-    {
-        assert(0);  //Transaction id repeated
-        return -1;
-    }
-
-    //Just add and return
+    //Add unless it exists already
     try
     {
-        pend_transactions[t->tid] = t;
+        if (pend_transactions.put_if_absent(t->tid, t))
+        {
+            assert(0);  //Transaction id repeated
+            return -1;
+        }
     } catch (...)
     {
         LOG_DBG("Could not add transaction %u. Out of memory?", t->tid);
@@ -1967,38 +1964,84 @@ int IPCManager_::remove_transaction_state(int tid)
 {
 
     TransactionState* t;
-    //Lock
-    rina::WriteScopedLock writelock(trans_rwlock);
 
     //Check if it really exists
-    if (pend_transactions.find(tid) == pend_transactions.end())
+    t = pend_transactions.erase(tid);
+    if (!t)
         return -1;
 
-    t = pend_transactions[tid];
-    pend_transactions.erase(tid);
-    delete t;
+    t->put();
 
     return 0;
 }
 
-//Syscall state management routines
-int IPCManager_::add_syscall_transaction_state(SyscallTransState* t)
-{
+//Completes a transaction in the shard that started it
+class CompleteTransactionTask: public rina::TimerTask {
+public:
+    CompleteTransactionTask(TransactionState* t, ipcm_res_t r)
+            : trans(t), ret(r)
+    {
+        trans->get();
+    }
+    ~CompleteTransactionTask() throw()
+    {
+        trans->put();
+    }
+    void run()
+    {
+        trans->completed(ret);
+        IPCManager->remove_transaction_state(trans->tid);
+    }
+    std::string name() const
+    {
+        return "complete-transaction";
+    }
 
-    //Lock
-    rina::WriteScopedLock writelock(trans_rwlock);
+private:
+    TransactionState* trans;
+    ipcm_res_t ret;
+};
 
-    //Check if exists already
-    if (pend_sys_trans.find(t->tid) != pend_sys_trans.end())
+void IPCManager_::complete_transaction(TransactionState* t, ipcm_res_t ret)
+{
+    if (t->shard < 0 || t->shard == EventDispatcher::current_shard())
     {
-        assert(0);  //Transaction id repeated
-        return -1;
+        t->completed(ret);
+        remove_transaction_state(t->tid);
+        return;
     }
 
-    //Just add and return
+    event_dispatcher.dispatch_task(t->shard,
+                                   new CompleteTransactionTask(t, ret));
+}
+
+int IPCManager_::get_transaction_shard(int tid)
+{
+    TransactionState* t;
+    int shard;
+
+    t = pend_transactions.find_get(tid);
+    if (!t)
+        return -1;
+
+    shard = t->shard;
+    t->put();
+
+    return shard;
+}
+
+//Syscall state management routines
+int IPCManager_::add_syscall_transaction_state(SyscallTransState* t)
+{
+
+    //Add unless it exists already
     try
     {
-        pend_sys_trans[t->tid] = t;
+        if (pend_sys_trans.put_if_absent(t->tid, t))
+        {
+            assert(0);  //Transaction id repeated
+            return -1;
+        }
     } catch (...)
     {
         LOG_DBG("Could not add syscall transaction %u. Out of memory?", t->tid);
@@ -2014,16 +2057,12 @@ int IPCManager_::remove_syscall_transaction_state(int tid)
 
     SyscallTransState* t;
 
-    //Lock
-    rina::WriteScopedLock writelock(trans_rwlock);
-
     //Check if it really exists
-    if (pend_sys_trans.find(tid) == pend_sys_trans.end())
+    t = pend_sys_trans.erase(tid);
+    if (!t)
         return -1;
 
-    t = pend_sys_trans[tid];
-    pend_sys_trans.erase(tid);
-    delete t;
+    t->put();
 
     return 0;
 }
@@ -2104,11 +2143,14 @@ void IPCManager_::io_loop()
 
     LOG_DBG("Starting main I/O loop...");
 
+    event_dispatcher.start();
+
     while (true)
     {
         event = rina::ipcEventProducer->eventWait();
         if (!event) {
         	LOG_WARN("Event is NULL");
+        	event_dispatcher.stop();
         	rina::librina_finalize();
         	stop_cond.signal();
         	break;
@@ -2120,6 +2162,9 @@ void IPCManager_::io_loop()
         	//the stop procedure
         	LOG_INFO("IPCM event loop requested to stop");
 
+        	//Handle the events already queued
+        	event_dispatcher.stop();
+
         	void * status;
         	if (osp_monitor) {
         		osp_monitor->do_stop();
@@ -2136,169 +2181,179 @@ void IPCManager_::io_loop()
                 rina::IPCEvent::eventTypeToString(event->eventType).c_str(),
                 event->sequenceNumber);
 
-        try
-        {
-            switch (event->eventType) {
-                case rina::FLOW_ALLOCATION_REQUESTED_EVENT: {
-                    DOWNCAST_DECL(event, rina::FlowRequestEvent, e);
-                    flow_allocation_requested_event_handler(NULL, e);
-                }
-                    break;
+        //Events of different IPCPs are handled in parallel
+        event_dispatcher.dispatch(event);
+    }
 
-                case rina::ALLOCATE_FLOW_RESPONSE_EVENT: {
-                    DOWNCAST_DECL(event, rina::AllocateFlowResponseEvent, e);
-                    allocate_flow_response_event_handler(e);
-                }
-                    break;
+    //TODO: probably move this to a private method if it starts to grow
+    LOG_DBG("Stopping I/O loop...");
+}
 
-                case rina::FLOW_DEALLOCATION_REQUESTED_EVENT: {
-                    DOWNCAST_DECL(event, rina::FlowDeallocateRequestEvent, e);
-                    flow_deallocation_requested_event_handler(NULL, e);
-                }
-                    break;
+void IPCManager_::handle_event(rina::IPCEvent *event)
+{
+    try
+    {
+        switch (event->eventType) {
+            case rina::FLOW_ALLOCATION_REQUESTED_EVENT: {
+                DOWNCAST_DECL(event, rina::FlowRequestEvent, e);
+                flow_allocation_requested_event_handler(NULL, e);
+            }
+                break;
 
-                case rina::FLOW_DEALLOCATED_EVENT: {
-                    DOWNCAST_DECL(event, rina::FlowDeallocatedEvent, e);
-                    IPCManager->flow_deallocated_event_handler(e);
-                }
-                    break;
-                case rina::APPLICATION_REGISTRATION_REQUEST_EVENT: {
-                    DOWNCAST_DECL(event,
-                                  rina::ApplicationRegistrationRequestEvent, e);
-                    app_reg_req_handler(e);
-                }
-                    break;
+            case rina::ALLOCATE_FLOW_RESPONSE_EVENT: {
+                DOWNCAST_DECL(event, rina::AllocateFlowResponseEvent, e);
+                allocate_flow_response_event_handler(e);
+            }
+                break;
 
-                case rina::APPLICATION_UNREGISTRATION_REQUEST_EVENT: {
-                    DOWNCAST_DECL(event,
-                                  rina::ApplicationUnregistrationRequestEvent,
-                                  e);
-                    application_unregistration_request_event_handler(e);
-                }
-                    break;
+            case rina::FLOW_DEALLOCATION_REQUESTED_EVENT: {
+                DOWNCAST_DECL(event, rina::FlowDeallocateRequestEvent, e);
+                flow_deallocation_requested_event_handler(NULL, e);
+            }
+                break;
 
-                case rina::ASSIGN_TO_DIF_RESPONSE_EVENT: {
-                    DOWNCAST_DECL(event, rina::AssignToDIFResponseEvent, e);
-                    assign_to_dif_response_event_handler(e);
-                }
-                    break;
+            case rina::FLOW_DEALLOCATED_EVENT: {
+                DOWNCAST_DECL(event, rina::FlowDeallocatedEvent, e);
+                IPCManager->flow_deallocated_event_handler(e);
+            }
+                break;
+            case rina::APPLICATION_REGISTRATION_REQUEST_EVENT: {
+                DOWNCAST_DECL(event,
+                              rina::ApplicationRegistrationRequestEvent, e);
+                app_reg_req_handler(e);
+            }
+                break;
 
-                case rina::UPDATE_DIF_CONFIG_RESPONSE_EVENT: {
-                    DOWNCAST_DECL(event,
-                                  rina::UpdateDIFConfigurationResponseEvent, e);
-                    update_dif_config_response_event_handler(e);
-                }
-                    break;
+            case rina::APPLICATION_UNREGISTRATION_REQUEST_EVENT: {
+                DOWNCAST_DECL(event,
+                              rina::ApplicationUnregistrationRequestEvent,
+                              e);
+                application_unregistration_request_event_handler(e);
+            }
+                break;
 
-                case rina::ENROLL_TO_DIF_RESPONSE_EVENT: {
-                    DOWNCAST_DECL(event, rina::EnrollToDIFResponseEvent, e);
-                    enroll_to_dif_response_event_handler(e);
-                }
-                    break;
+            case rina::ASSIGN_TO_DIF_RESPONSE_EVENT: {
+                DOWNCAST_DECL(event, rina::AssignToDIFResponseEvent, e);
+                assign_to_dif_response_event_handler(e);
+            }
+                break;
 
-                case rina::DISCONNECT_NEIGHBOR_RESPONSE_EVENT: {
-                    DOWNCAST_DECL(event, rina::DisconnectNeighborResponseEvent, e);
-                    disconnect_neighbor_response_event_handler(e);
-                }
-                    break;
+            case rina::UPDATE_DIF_CONFIG_RESPONSE_EVENT: {
+                DOWNCAST_DECL(event,
+                              rina::UpdateDIFConfigurationResponseEvent, e);
+                update_dif_config_response_event_handler(e);
+            }
+                break;
 
-                case rina::IPCM_REGISTER_APP_RESPONSE_EVENT: {
-                    DOWNCAST_DECL(event,
-                                  rina::IpcmRegisterApplicationResponseEvent, e);
-                    app_reg_response_handler(e);
-                }
-                    break;
+            case rina::ENROLL_TO_DIF_RESPONSE_EVENT: {
+                DOWNCAST_DECL(event, rina::EnrollToDIFResponseEvent, e);
+                enroll_to_dif_response_event_handler(e);
+            }
+                break;
 
-                case rina::IPCM_UNREGISTER_APP_RESPONSE_EVENT: {
-                    DOWNCAST_DECL(event,
-                                  rina::IpcmUnregisterApplicationResponseEvent,
-                                  e);
-                    unreg_app_response_handler(e);
-                }
-                    break;
+            case rina::DISCONNECT_NEIGHBOR_RESPONSE_EVENT: {
+                DOWNCAST_DECL(event, rina::DisconnectNeighborResponseEvent, e);
+                disconnect_neighbor_response_event_handler(e);
+            }
+                break;
 
-                case rina::IPCM_ALLOCATE_FLOW_REQUEST_RESULT: {
-                    DOWNCAST_DECL(event,
-                                  rina::IpcmAllocateFlowRequestResultEvent, e);
-                    ipcm_allocate_flow_request_result_handler(e);
-                }
-                    break;
+            case rina::IPCM_REGISTER_APP_RESPONSE_EVENT: {
+                DOWNCAST_DECL(event,
+                              rina::IpcmRegisterApplicationResponseEvent, e);
+                app_reg_response_handler(e);
+            }
+                break;
 
-                case rina::QUERY_RIB_RESPONSE_EVENT: {
-                    DOWNCAST_DECL(event, rina::QueryRIBResponseEvent, e);
-                    query_rib_response_event_handler(e);
-                }
-                    break;
+            case rina::IPCM_UNREGISTER_APP_RESPONSE_EVENT: {
+                DOWNCAST_DECL(event,
+                              rina::IpcmUnregisterApplicationResponseEvent,
+                              e);
+                unreg_app_response_handler(e);
+            }
+                break;
 
-                case rina::IPC_PROCESS_DAEMON_INITIALIZED_EVENT: {
-                    DOWNCAST_DECL(event,
-                		  rina::IPCProcessDaemonInitializedEvent, e);
-                    ipc_process_daemon_initialized_event_handler(e);
-                }
-                    break;
+            case rina::IPCM_ALLOCATE_FLOW_REQUEST_RESULT: {
+                DOWNCAST_DECL(event,
+                              rina::IpcmAllocateFlowRequestResultEvent, e);
+                ipcm_allocate_flow_request_result_handler(e);
+            }
+                break;
 
-                    //Policies
-                case rina::IPC_PROCESS_SET_POLICY_SET_PARAM_RESPONSE: {
-                    DOWNCAST_DECL(event, rina::SetPolicySetParamResponseEvent,
-                                  e);
-                    ipc_process_set_policy_set_param_response_handler(e);
-                }
-                    break;
-                case rina::IPC_PROCESS_SELECT_POLICY_SET_RESPONSE: {
-                    DOWNCAST_DECL(event, rina::SelectPolicySetResponseEvent, e);
-                    ipc_process_select_policy_set_response_handler(e);
-                }
-                    break;
-                case rina::IPC_PROCESS_PLUGIN_LOAD_RESPONSE: {
-                    DOWNCAST_DECL(event, rina::PluginLoadResponseEvent, e);
-                    ipc_process_plugin_load_response_handler(e);
-                }
-                    break;
+            case rina::QUERY_RIB_RESPONSE_EVENT: {
+                DOWNCAST_DECL(event, rina::QueryRIBResponseEvent, e);
+                query_rib_response_event_handler(e);
+            }
+                break;
 
-                case rina::IPCM_CREATE_IPCP_RESPONSE: {
-                    DOWNCAST_DECL(event, rina::CreateIPCPResponseEvent, e);
-                    ipc_process_create_response_event_handler(e);
-                }
-                    break;
+            case rina::IPC_PROCESS_DAEMON_INITIALIZED_EVENT: {
+                DOWNCAST_DECL(event,
+            		  rina::IPCProcessDaemonInitializedEvent, e);
+                ipc_process_daemon_initialized_event_handler(e);
+            }
+                break;
 
-                case rina::IPCM_DESTROY_IPCP_RESPONSE: {
-                    DOWNCAST_DECL(event, rina::DestroyIPCPResponseEvent, e);
-                    ipc_process_destroy_response_event_handler(e);
-                }
-                    break;
+                //Policies
+            case rina::IPC_PROCESS_SET_POLICY_SET_PARAM_RESPONSE: {
+                DOWNCAST_DECL(event, rina::SetPolicySetParamResponseEvent,
+                              e);
+                ipc_process_set_policy_set_param_response_handler(e);
+            }
+                break;
+            case rina::IPC_PROCESS_SELECT_POLICY_SET_RESPONSE: {
+                DOWNCAST_DECL(event, rina::SelectPolicySetResponseEvent, e);
+                ipc_process_select_policy_set_response_handler(e);
+            }
+                break;
+            case rina::IPC_PROCESS_PLUGIN_LOAD_RESPONSE: {
+                DOWNCAST_DECL(event, rina::PluginLoadResponseEvent, e);
+                ipc_process_plugin_load_response_handler(e);
+            }
+                break;
 
-                    //Addon specific events
-                default:
-                {
-                    TransactionState* trans = get_transaction_state<
-                            TransactionState>(event->sequenceNumber);
+            case rina::IPCM_CREATE_IPCP_RESPONSE: {
+                DOWNCAST_DECL(event, rina::CreateIPCPResponseEvent, e);
+                ipc_process_create_response_event_handler(e);
+            }
+                break;
 
-                    Addon::distribute_flow_event(event);
+            case rina::IPCM_DESTROY_IPCP_RESPONSE: {
+                DOWNCAST_DECL(event, rina::DestroyIPCPResponseEvent, e);
+                ipc_process_destroy_response_event_handler(e);
+            }
+                break;
 
-                    if (trans)
-                    {
-                        //Mark as completed
-                        trans->completed(IPCM_SUCCESS);
-                        remove_transaction_state(trans->tid);
-                    }
+                //Addon specific events
+            default:
+            {
+                TransactionState* trans = get_transaction_state<
+                        TransactionState>(event->sequenceNumber);
+                TransactionStateRef ref(trans);
 
-                    continue;
-                    break;
+                Addon::distribute_flow_event(event);
+
+                if (trans)
+                {
+                    //Mark as completed
+                    complete_transaction(trans, IPCM_SUCCESS);
                 }
-            }
 
-        } catch (rina::Exception &e)
-        {
-            LOG_ERR("ERROR while processing event %d: %s",event->eventType,
-            		e.what());
-            //TODO: move locking to a smaller scope
+                return;
+            }
         }
 
-        delete event;
+    } catch (rina::Exception &e)
+    {
+        LOG_ERR("ERROR while processing event %d: %s",event->eventType,
+        		e.what());
+        //TODO: move locking to a smaller scope
     }
 
-    //TODO: probably move this to a private method if it starts to grow
-    LOG_DBG("Stopping I/O loop...");
+    delete event;
+}
+
+void IPCManager_::dump_event_stats(std::ostream& os)
+{
+    event_dispatcher.print_stats(os);
 }
 
 }  //rinad namespace
@@ -33,12 +33,14 @@
 #include <string>
 
 #include <librina/common.h>
+#include <librina/concurrency.h>
 #include <librina/ipc-manager.h>
 #include <librina/patterns.h>
 #include <librina/timer.h>
 
 #include "dif-template-manager.h"
 #include "catalog.h"
+#include "event-dispatcher.h"
 #include "process-event-listener.h"
 #include "ip-vpn-manager.h"
 
@@ -182,6 +184,22 @@ public:
 		promise->signal();
 	}
 
+	//
+	// Take a reference on the state. The pending transactions table
+	// holds one, and get_transaction_state() returns another one
+	//
+	void get(void){
+		__atomic_add_fetch(&refs, 1, __ATOMIC_RELAXED);
+	}
+
+	//
+	// Drop a reference, the last one deletes the state
+	//
+	void put(void){
+		if (__atomic_sub_fetch(&refs, 1, __ATOMIC_ACQ_REL) == 0)
+			delete this;
+	}
+
 	//Promise
 	Promise* promise;
 
@@ -191,6 +209,11 @@ public:
 	//Callee that generated the transaction
 	Addon* callee;
 
+	//Event dispatcher shard of the handler that started the
+	//transaction (-1 if it was not started by an event handler). The
+	//transaction is completed in the same shard
+	int shard;
+
 protected:
 	//Protect abort call
 	friend class Promise;
@@ -221,7 +244,9 @@ protected:
 							promise(promise_),
 							tid(tid_),
 							callee(callee_),
-							finalised(false){
+							shard(-1),
+							finalised(false),
+							refs(1){
 		if(promise){
 			promise->ret = IPCM_PENDING;
 			promise->trans = this;
@@ -231,10 +256,29 @@ protected:
 	//Completed flag
 	bool finalised;
 
+	//References, see get() and put()
+	int refs;
+
 	// Mutex
 	rina::Lockable mutex;
 };
 
+//
+// Drops the reference returned by get_transaction_state() or
+// get_syscall_transaction_state() when it goes out of scope
+//
+class TransactionStateRef {
+public:
+	TransactionStateRef(TransactionState* t) : trans(t){};
+	~TransactionStateRef(){
+		if (trans)
+			trans->put();
+	};
+
+private:
+	TransactionState* trans;
+};
+
 //
 // Syscall specific transaction state
 //
@@ -290,6 +334,11 @@ public:
 	//
 	void list_da_mappings(std::ostream& os);
 
+	//
+	// Dump the latency histograms of the event dispatcher
+	//
+	void dump_event_stats(std::ostream& os);
+
 	//
 	// List the objects in the MA RIB
 	//
@@ -824,6 +873,11 @@ protected:
 	* Get the transaction state. Template parameter is the type of the
 	* specific state required for the type of transaction
 	*
+	* The state is returned with a reference taken, so that the
+	* handlers running in other shards of the event dispatcher cannot
+	* delete it. The caller drops it with put(), usually through a
+	* TransactionStateRef.
+	*
 	* @ret A pointer to the state or NULL
 	* @warning This method does NOT throw exceptions.
 	*/
@@ -832,23 +886,25 @@ protected:
 		T* t;
 		TransactionState* state;
 
-		//Read lock
-		rina::ReadScopedLock readlock(trans_rwlock);
-
-		if ( pend_transactions.find(tid) != pend_transactions.end() ) {
-			state = pend_transactions[tid];
+		state = pend_transactions.find_get(tid);
+		if (state) {
 			assert(state->tid == tid);
-			try{
-				t = dynamic_cast<T*>(state);
-				return t;
-			}catch(...){
-				assert(0);
-				return NULL;
-			}
+			t = dynamic_cast<T*>(state);
+			if (!t)
+				state->put();
+			return t;
 		}
 		return NULL;
 	}
 
+	/*
+	* Get the dispatcher shard that owns the transaction
+	*
+	* @ret the shard, or -1 if the transaction does not exist or was
+	* not started by an event handler
+	*/
+	int get_transaction_shard(int tid);
+
 	/*
 	* Add the transaction state. Template parameter is the type of the
 	* specific state required for the type of transaction
@@ -860,13 +916,22 @@ protected:
 	/*
 	* @Remove transaction state.
 	*
-	* Remove the transaction state from the pending transactions db. The
-	* method does NOT free (delete) the transaction pointer.
+	* Remove the transaction state from the pending transactions db and
+	* drop the reference of the db. The state is deleted once the
+	* handlers that got it have dropped theirs.
 	*
 	* @ret 0 if success -1 otherwise.
 	*/
 	int remove_transaction_state(int tid);
 
+	/*
+	* Complete the transaction with the result and remove its state.
+	* If it was started by a handler of another shard of the event
+	* dispatcher, this is done by that shard, after the events already
+	* queued there (e.g. the rest of the request).
+	*/
+	void complete_transaction(TransactionState* t, ipcm_res_t ret);
+
 	/*
 	* This map encapsulates the existing transactions and their state
 	*
@@ -874,22 +939,20 @@ protected:
 	* parameters for the specific operation that was started.
 	*
 	* key: transaction_id value: transaction state
+	*
+	* The map is striped, so that the workers of the event dispatcher
+	* only contend when they access transactions in the same stripe
 	*/
-	std::map<int, TransactionState*> pend_transactions;
+	rina::ConcurrentHashMap<int, TransactionState> pend_transactions;
 
 	//TODO unify syscalls and non-syscall state
 
 	/**
-	* Get syscall transaction state (waiting for a notification)
+	* Get syscall transaction state (waiting for a notification), with
+	* a reference taken as in get_transaction_state()
 	*/
 	SyscallTransState* get_syscall_transaction_state(int tid){
-		//Read lock
-		rina::ReadScopedLock readlock(trans_rwlock);
-
-		if ( pend_sys_trans.find(tid) !=  pend_sys_trans.end() )
-			return pend_sys_trans[tid];
-
-		return NULL;
+		return pend_sys_trans.find_get(tid);
 	};
 
 	//If peer discovery is setup, modify enrollment task
@@ -916,10 +979,7 @@ protected:
 	*
 	* key: ipcp ID value: transaction state
 	*/
-	std::map<int, SyscallTransState*> pend_sys_trans;
-
-	//Rwlock for transactions
-	rina::ReadWriteLockable trans_rwlock;
+	rina::ConcurrentHashMap<int, SyscallTransState> pend_sys_trans;
 
 	//Current logging level
 	std::string log_level_;
@@ -956,7 +1016,15 @@ private:
 	//Main I/O loop thread
 	void io_loop(void);
 
+	//Event handling, called by the workers of the event dispatcher
+	void handle_event(rina::IPCEvent *event);
+
+	//Spreads the events read by the I/O loop over a pool of workers
+	EventDispatcher event_dispatcher;
+
 	friend class Singleton<rinad::IPCManager_>;
+	friend class EventDispatcher;
+	friend class CompleteTransactionTask;
 
 	void pre_assign_to_dif(Addon* callee,
 			const rina::ApplicationProcessNamingInformation& dif_name,
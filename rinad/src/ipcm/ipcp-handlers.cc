@@ -61,6 +61,7 @@ void IPCManager_::ipc_process_daemon_initialized_event_handler(rina::IPCProcessD
 			break;
 		sleep.sleepForMili(1);
 	}
+	TransactionStateRef ref(trans);
 
 	if(!trans){
 		ss << ": Warning: IPCP daemon '"<<e->ipcProcessId
@@ -154,6 +155,7 @@ void IPCManager_::ipc_process_create_response_event_handler(rina::CreateIPCPResp
 		if(trans)
 			break;
 	}
+	TransactionStateRef ref(trans);
 
 	if(!trans){
 		ss << ": Warning: IPCP kernel components of '"<< ipcp_id
@@ -244,6 +246,7 @@ void IPCManager_::ipcm_register_response_ipcp(IPCMIPCProcess * ipcp,
 	rina::ApplicationProcessNamingInformation daf_name;
 
 	IPCPregTransState* trans = get_transaction_state<IPCPregTransState>(e->sequenceNumber);
+	TransactionStateRef ref(trans);
 
 	if(!trans){
 		LOG_ERR("Transaction not of valid type");
@@ -380,6 +383,7 @@ IPCManager_::assign_to_dif_response_event_handler(rina::AssignToDIFResponseEvent
 	ipcm_res_t ret;
 
 	IPCPTransState* trans = get_transaction_state<IPCPTransState>(e->sequenceNumber);
+	TransactionStateRef ref(trans);
 
 	if(!trans){
 		ss << ": Warning: unknown assign to DIF response received: "<<e->sequenceNumber<<endl;
@@ -415,8 +419,7 @@ IPCManager_::assign_to_dif_response_event_handler(rina::AssignToDIFResponseEvent
 		ret = IPCM_FAILURE;
 	}
 	//Mark as completed
-	trans->completed(ret);
-	remove_transaction_state(trans->tid);
+	complete_transaction(trans, ret);
 
 	// If there are is a dynamic DIF Allocator in this IPCM,
 	// register it to the DIF
@@ -435,6 +438,7 @@ IPCManager_::update_dif_config_response_event_handler(rina::UpdateDIFConfigurati
 	ipcm_res_t ret;
 
 	IPCPTransState* trans = get_transaction_state<IPCPTransState>(e->sequenceNumber);
+	TransactionStateRef ref(trans);
 
 	if(!trans){
 		ss << ": Warning: unknown DIF config response received: "<<e->sequenceNumber<<endl;
@@ -469,8 +473,7 @@ IPCManager_::update_dif_config_response_event_handler(rina::UpdateDIFConfigurati
 		ret = IPCM_FAILURE;
 	}
 	//Mark as completed
-	trans->completed(ret);
-	remove_transaction_state(trans->tid);
+	complete_transaction(trans, ret);
 }
 
 void
@@ -484,6 +487,7 @@ IPCManager_::enroll_to_dif_response_event_handler(rina::EnrollToDIFResponseEvent
 	std::list<rina::Neighbor> neighbors;
 
 	IPCPTransState* trans = get_transaction_state<IPCPTransState>(event->sequenceNumber);
+	TransactionStateRef ref(trans);
 
 	if(!trans){
 		ss << ": Warning: unknown enrollment to DIF response received: "<<event->sequenceNumber<<endl;
@@ -518,8 +522,7 @@ IPCManager_::enroll_to_dif_response_event_handler(rina::EnrollToDIFResponseEvent
 	}
 
 	//Mark as completed
-	trans->completed(ret);
-	remove_transaction_state(trans->tid);
+	complete_transaction(trans, ret);
 }
 
 void
@@ -532,6 +535,7 @@ IPCManager_::disconnect_neighbor_response_event_handler(rina::DisconnectNeighbor
 	std::list<rina::Neighbor>::iterator it;
 
 	IPCPTransState* trans = get_transaction_state<IPCPTransState>(event->sequenceNumber);
+	TransactionStateRef ref(trans);
 
 	if(!trans){
 		ss << ": Warning: unknown enrollment to DIF response received: "<<event->sequenceNumber<<endl;
@@ -565,8 +569,7 @@ IPCManager_::disconnect_neighbor_response_event_handler(rina::DisconnectNeighbor
 	}
 
 	//Mark as completed
-	trans->completed(ret);
-	remove_transaction_state(trans->tid);
+	complete_transaction(trans, ret);
 }
 
 } //namespace rinad
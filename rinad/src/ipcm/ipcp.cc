@@ -160,6 +160,7 @@ void IPCMIPCProcess::get_description(std::ostream& os) {
 	}
 
 	os << " | ";
+	rina::ScopedLock flows_guard(flows_lock);
 	if (allocatedFlows.size () > 0) {
 		std::list<rina::FlowInformation>::const_iterator it;
 		for (it = allocatedFlows.begin();
@@ -423,6 +424,8 @@ void IPCMIPCProcess::allocateFlow(const rina::FlowRequestEvent& flowRequest,
 	flowInformation.flowSpecification = flowRequest.flowSpecification;
 	flowInformation.portId = flowRequest.portId;
 	flowInformation.pid = flowRequest.pid;
+
+	rina::ScopedLock g(flows_lock);
 	pendingFlowOperations[opaque] = flowInformation;
 }
 
@@ -430,6 +433,8 @@ void IPCMIPCProcess::allocateFlowResult(unsigned int sequenceNumber,
 					bool success, int portId)
 {
 	rina::FlowInformation flowInformation;
+
+	rina::ScopedLock g(flows_lock);
 	try {
 		flowInformation = getPendingFlowOperation(sequenceNumber);
 		flowInformation.portId = portId;
@@ -469,12 +474,19 @@ void IPCMIPCProcess::allocateFlowResponse(const rina::FlowRequestEvent& flowRequ
 		flowInformation.portId = flowRequest.portId;
 		flowInformation.pid = pid;
 
+		rina::ScopedLock g(flows_lock);
 		allocatedFlows.push_back(flowInformation);
 	}
 }
 
 bool IPCMIPCProcess::getFlowInformation(int flowPortId, rina::FlowInformation& result) {
 
+	rina::ScopedLock g(flows_lock);
+	return findFlow(flowPortId, result);
+}
+
+bool IPCMIPCProcess::findFlow(int flowPortId, rina::FlowInformation& result) {
+
 	std::list<rina::FlowInformation>::const_iterator iterator;
 
 	for (iterator = allocatedFlows.begin();
@@ -504,6 +516,7 @@ void IPCMIPCProcess::deallocateFlow(int flowPortId, unsigned int opaque)
 		throw e;
 	}
 
+	rina::ScopedLock g(flows_lock);
 	allocatedFlows.remove(flowInformation);
 }
 
@@ -511,7 +524,8 @@ rina::FlowInformation IPCMIPCProcess::flowDeallocated(int flowPortId)
 {
 	rina::FlowInformation flowInformation;
 
-	if (!getFlowInformation(flowPortId, flowInformation))
+	rina::ScopedLock g(flows_lock);
+	if (!findFlow(flowPortId, flowInformation))
 		throw rina::IpcmDeallocateFlowException(
 						"No flow for such port-id");
 	allocatedFlows.remove(flowInformation);
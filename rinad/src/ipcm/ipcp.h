@@ -68,6 +68,13 @@ public:
 	/** Rwlock */
 	rina::ReadWriteLockable rwlock;
 
+	/**
+	 * Protects allocatedFlows and the pending flow operations. Flow
+	 * handlers running in different dispatcher workers update them
+	 * while holding rwlock only as readers
+	 */
+	rina::Lockable flows_lock;
+
 	/** The IPC Process proxy class */
 	rina::IPCProcessProxy* proxy_;
 
@@ -310,8 +317,8 @@ public:
 
 	/**
 	 * Get the information of the flow identified by portId
-	 * This method is NOT thread safe and must be called with the readlock
-	 * acquired
+	 * This method must be called with the readlock acquired, and takes
+	 * flows_lock
 	 *
          * @result will contain the flow identified by portId, if any
 	 * @return true if the flow is found, false otherwise
@@ -476,6 +483,9 @@ private:
 	rina::FlowInformation
 		getPendingFlowOperation(unsigned int seqNumber);
 
+	/** Same as getFlowInformation, called with flows_lock held */
+	bool findFlow(int portId, rina::FlowInformation& result);
+
 	rina::ApplicationProcessNamingInformation
 		getPendingDisconnection(unsigned int seqNumber);
 };
@@ -49,6 +49,7 @@ void IPCManager_::query_rib_response_event_handler(rina::QueryRIBResponseEvent *
 	list<rina::rib::RIBObjectData>::iterator lit;
 	RIBqTransState* trans =
 		get_transaction_state<RIBqTransState>(e->sequenceNumber);
+	TransactionStateRef ref(trans);
 
 	if(!trans){
 		ss  << ": Warning: IPC process query RIB "
@@ -61,8 +62,7 @@ void IPCManager_::query_rib_response_event_handler(rina::QueryRIBResponseEvent *
 
 	if(e->result < 0){
 		ss  << ": Error: Query RIB operation of failed" << endl;
-		trans->completed(IPCM_FAILURE);
-		remove_transaction_state(trans->tid);
+		complete_transaction(trans, IPCM_FAILURE);
 		return;
 	}
 
@@ -71,8 +71,7 @@ void IPCManager_::query_rib_response_event_handler(rina::QueryRIBResponseEvent *
 		ss << "Could not complete IPCP query RIB. Invalid IPCP id "<< ipcp->get_id();
 		FLUSH_LOG(ERR, ss);
 
-		trans->completed(IPCM_FAILURE);
-		remove_transaction_state(trans->tid);
+		complete_transaction(trans, IPCM_FAILURE);
 		return;
 	}
 
@@ -97,15 +96,13 @@ void IPCManager_::query_rib_response_event_handler(rina::QueryRIBResponseEvent *
 
 	if(!promise){
 		assert(0);
-		trans->completed(IPCM_FAILURE);
-		remove_transaction_state(trans->tid);
+		complete_transaction(trans, IPCM_FAILURE);
 		return;
 	}
 
 	//Mark as completed
 	promise->serialized_rib = ss.str();
-	trans->completed(IPCM_SUCCESS);
-	remove_transaction_state(trans->tid);
+	complete_transaction(trans, IPCM_SUCCESS);
 
 	return;
 }
@@ -49,6 +49,7 @@ void IPCManager_::ipc_process_set_policy_set_param_response_handler(
 	ostringstream ss;
 
 	IPCPTransState* trans = get_transaction_state<IPCPTransState>(event->sequenceNumber);
+	TransactionStateRef ref(trans);
 
 	if(!trans){
 		ss << ": Warning: unknown policy set param response received: "<<event->sequenceNumber<<endl;
@@ -62,8 +63,7 @@ void IPCManager_::ipc_process_set_policy_set_param_response_handler(
 		ss << "Could not complete policy set param. Invalid IPCP id "<< ipcp->get_id();
 		FLUSH_LOG(ERR, ss);
 
-		trans->completed(IPCM_FAILURE);
-		remove_transaction_state(trans->tid);
+		complete_transaction(trans, IPCM_FAILURE);
 		return;
 	}
 
@@ -75,8 +75,7 @@ void IPCManager_::ipc_process_set_policy_set_param_response_handler(
 	FLUSH_LOG(INFO, ss);
 
 	//Mark as completed
-	trans->completed(success ? IPCM_SUCCESS : IPCM_FAILURE);
-	remove_transaction_state(trans->tid);
+	complete_transaction(trans, success ? IPCM_SUCCESS : IPCM_FAILURE);
 }
 
 void IPCManager_::ipc_process_plugin_load_response_handler(rina::PluginLoadResponseEvent *event)
@@ -86,6 +85,7 @@ void IPCManager_::ipc_process_plugin_load_response_handler(rina::PluginLoadRespo
         int ret = -1;
 
         IPCPpluginTransState* trans = get_transaction_state<IPCPpluginTransState>(event->sequenceNumber);
+        TransactionStateRef ref(trans);
 
         if(!trans){
         	ss << ": Warning: unknown plugin load response received: "
@@ -101,8 +101,7 @@ void IPCManager_::ipc_process_plugin_load_response_handler(rina::PluginLoadRespo
         	   << ipcp->get_id();
         	FLUSH_LOG(ERR, ss);
 
-        	trans->completed(IPCM_FAILURE);
-        	remove_transaction_state(trans->tid);
+        	complete_transaction(trans, IPCM_FAILURE);
         	return;
         }
 
@@ -121,8 +120,7 @@ void IPCManager_::ipc_process_plugin_load_response_handler(rina::PluginLoadRespo
 	}
 
 	//Mark as completed
-	trans->completed(success ? IPCM_SUCCESS : IPCM_FAILURE);
-        remove_transaction_state(trans->tid);
+	complete_transaction(trans, success ? IPCM_SUCCESS : IPCM_FAILURE);
 }
 
 void IPCManager_::ipc_process_select_policy_set_response_handler(
@@ -133,6 +131,7 @@ void IPCManager_::ipc_process_select_policy_set_response_handler(
         int ret = -1;
 
 	IPCPSelectPsTransState* trans = get_transaction_state<IPCPSelectPsTransState>(event->sequenceNumber);
+	TransactionStateRef ref(trans);
 
 	if(!trans){
 		ss << ": Warning: unknown select policy response received: "
@@ -146,8 +145,7 @@ void IPCManager_::ipc_process_select_policy_set_response_handler(
 		ss << "Could not complete policy set param. Invalid IPCP id "<< ipcp->get_id();
 		FLUSH_LOG(ERR, ss);
 
-		trans->completed(IPCM_FAILURE);
-		remove_transaction_state(trans->tid);
+		complete_transaction(trans, IPCM_FAILURE);
 		return;
 	}
 
@@ -164,8 +162,7 @@ void IPCManager_::ipc_process_select_policy_set_response_handler(
 	}
 
 	//Mark as completed
-	trans->completed(success ? IPCM_SUCCESS : IPCM_FAILURE);
-	remove_transaction_state(trans->tid);
+	complete_transaction(trans, success ? IPCM_SUCCESS : IPCM_FAILURE);
 }
 
 } //namespace rinad
@@ -34,6 +34,7 @@
 #include <librina/irm.h>
 #include <librina/rib_v2.h>
 #include <librina/security-manager.h>
+#include <librina/timer.h>
 #include "common/encoder.h"
 #include "common/configuration.h"
 
@@ -41,6 +42,20 @@ namespace rinad {
 
 const unsigned int max_sdu_size_in_bytes = 10000;
 
+/// Stages of the processing of the IPCP. Each one has its own executors,
+/// so that a slow task in one stage does not delay the others. The
+/// events of the same (N-1) port-id are always handled by the same
+/// executor of a stage, in the order they arrive
+enum ipcp_stage_t {
+	IPCP_STAGE_MGMT,	///< Management SDUs and N-1 flow events
+	IPCP_STAGE_FLOW_ALLOC,	///< Flow allocator events
+	/// Routing table computations and FSO updates, submitted by the
+	/// routing policy with execute_task, and forwarding table dumps
+	IPCP_STAGE_ROUTING,
+	IPCP_STAGE_KERNEL,	///< Other kernel responses and IPCM requests
+	IPCP_STAGE_MAX
+};
+
 enum IPCProcessOperationalState {
 	NOT_INITIALIZED,
 	INITIALIZED,
@@ -100,6 +115,25 @@ public:
 
 class IEnrollmentStateMachine;
 
+/// A part of the RIB that can be sent to a new member of the DIF
+/// in a single snapshot during enrollment, instead of object by object
+class IEnrollmentSnapshotSection {
+public:
+	virtual ~IEnrollmentSnapshotSection(){};
+
+	/// Encode the contents of the section for the neighbor reachable
+	/// through port_id
+	virtual void get_snapshot(int port_id, rina::ser_obj_t& result) = 0;
+
+	/// The whole snapshot has reached the N-1 flow to the neighbor,
+	/// which will only need the changes from now on
+	virtual void snapshot_sent(int port_id) { };
+
+	/// Apply the contents of the section received from the neighbor
+	/// reachable through port_id, in a single pass
+	virtual void apply_snapshot(int port_id, const rina::ser_obj_t& snapshot) = 0;
+};
+
 /// Interface that must be implementing by classes that provide
 /// the behavior of an enrollment task
 class IPCPEnrollmentTask : public IPCProcessComponent,
@@ -119,6 +153,26 @@ public:
 	virtual int get_neighbor_info(rina::Neighbor& neigh) = 0;
 	virtual void clean_state(unsigned int port_id) = 0;
 
+	/// Register the provider of a section of the enrollment snapshot
+	virtual void add_snapshot_section(const std::string& name,
+					  IEnrollmentSnapshotSection * section) = 0;
+	virtual void remove_snapshot_section(const std::string& name) = 0;
+	virtual std::list<std::string> get_snapshot_section_names() = 0;
+
+	/// Encode/apply a section of the enrollment snapshot, return false
+	/// if there is no provider for the section
+	virtual bool get_snapshot_section(const std::string& name,
+					  int port_id,
+					  rina::ser_obj_t& result) = 0;
+	virtual bool apply_snapshot_section(const std::string& name,
+					    int port_id,
+					    const rina::ser_obj_t& snapshot) = 0;
+
+	/// Tell the providers of the sections that the snapshot has
+	/// been sent through port_id
+	virtual void snapshot_sections_sent(const std::list<std::string>& names,
+					    int port_id) = 0;
+
 	/// The maximum time to wait between steps of the enrollment sequence (in ms)
 	int timeout_;
 
@@ -210,6 +264,30 @@ public:
 	/// @param AllocateFlowResponseEvent - the response from the application
 	virtual void submitAllocateResponse(const rina::AllocateFlowResponseEvent& event) = 0;
 
+	/// Called by the flow allocator instance once it has asked the IPC
+	/// Manager to accept an incoming flow
+	/// @param handle the sequence number of the request, which the
+	/// allocate response will carry
+	/// @param portId the port-id of the flow
+	virtual void addAllocateResponseHandle(unsigned int handle, int portId) = 0;
+
+	/// Get the port-id of the flow an allocate response refers to
+	/// @param handle the sequence number of the allocate response
+	/// @return the port-id, or -1 if no flow is waiting for the response
+	virtual int getAllocateResponsePort(unsigned int handle) = 0;
+
+	/// Get the key of the local flow allocation a port-id belongs to
+	/// (the sequence number of the allocation request), so that the
+	/// events of the allocation are handled by the same executor
+	/// @return false if the port-id is not used by a local allocation
+	virtual bool getAllocationKey(int portId, unsigned int& key) = 0;
+
+	/// Same as getAllocationKey, for a port-id reservation that has not
+	/// been answered yet
+	/// @param handle the sequence number of the reservation
+	virtual bool getPortAllocationKey(unsigned int handle,
+					  unsigned int& key) = 0;
+
 	virtual void processCreateConnectionResultEvent(const rina::CreateConnectionResultEvent& event) = 0;
 
 	virtual void processUpdateConnectionResponseEvent(const rina::UpdateConnectionResponseEvent& event) = 0;
@@ -315,6 +393,15 @@ public:
 
 	virtual std::list<rina::DirectoryForwardingTableEntry> getDFTEntries() = 0;
 
+	/// Update the address of an entry of the directory forwarding table,
+	/// if the update has a higher sequence number than the entry
+	/// @return true if the entry has been updated
+	virtual bool updateDFTEntry(const rina::DirectoryForwardingTableEntry& entry) = 0;
+
+	/// Get the keys of the entries of the directory forwarding table that
+	/// point to an address
+	virtual std::list<std::string> getDFTEntryKeys(unsigned int address) = 0;
+
 	/// Remove an entry from the directory forwarding table
 	/// @param apNamingInfo
 	virtual void removeDFTEntry(const std::string& key,
@@ -427,6 +514,9 @@ public:
 	virtual std::list<rina::PDUForwardingTableEntry> get_pduft_entries() = 0;
 	/// This operation takes ownership of the entries
 	virtual void set_pduft_entries(const std::list<rina::PDUForwardingTableEntry*>& pduft) = 0;
+	/// Account the sizes of a differential update of the kernel PDUFT
+	virtual void pduft_updated(unsigned int added, unsigned int modified,
+				   unsigned int removed) = 0;
 
 	virtual std::list<rina::RoutingTableEntry> get_rt_entries() = 0;
 	/// This operation takes ownership of the entries
@@ -504,6 +594,12 @@ public:
         			  rina::rib::RIBObj** obj) = 0;
         virtual void removeObjRIB(const std::string& fqn) = 0;
         virtual void processReadManagementSDUEvent(rina::ReadMgmtSDUResponseEvent& event) = 0;
+
+        /// Get the N-1 port-id a management SDU write was requested for,
+        /// and forget the request
+        /// @param seq_num the sequence number of the write response
+        /// @return the port-id, or -1 if the request is unknown
+        virtual int take_mgmt_sdu_write_port(unsigned int seq_num) = 0;
 };
 
 /// IPC Process interface
@@ -535,6 +631,13 @@ public:
 	virtual unsigned int get_old_address() = 0;
 	virtual unsigned int get_active_address() = 0;
 	virtual bool check_address_is_mine(unsigned int address) = 0;
+
+	/// Run the task in the executor of a stage, which takes ownership
+	/// of it. By default the task is run in the calling thread
+	virtual void execute_task(ipcp_stage_t stage, rina::TimerTask * task) {
+		task->run();
+		delete task;
+	};
 };
 
 } //namespace rinad
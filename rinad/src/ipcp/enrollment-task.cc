@@ -964,6 +964,78 @@ int EnrollmentTask::get_neighbor_info(rina::Neighbor& neigh)
 	return 0;
 }
 
+void EnrollmentTask::add_snapshot_section(const std::string& name,
+					  IEnrollmentSnapshotSection * section)
+{
+	rina::WriteScopedLock writeLock(snapshot_lock);
+	snapshot_sections[name] = section;
+}
+
+void EnrollmentTask::remove_snapshot_section(const std::string& name)
+{
+	rina::WriteScopedLock writeLock(snapshot_lock);
+	snapshot_sections.erase(name);
+}
+
+std::list<std::string> EnrollmentTask::get_snapshot_section_names()
+{
+	std::list<std::string> result;
+	std::map<std::string, IEnrollmentSnapshotSection *>::iterator it;
+
+	rina::ReadScopedLock readLock(snapshot_lock);
+	for (it = snapshot_sections.begin(); it != snapshot_sections.end(); ++it)
+		result.push_back(it->first);
+
+	return result;
+}
+
+bool EnrollmentTask::get_snapshot_section(const std::string& name,
+					  int port_id,
+					  rina::ser_obj_t& result)
+{
+	std::map<std::string, IEnrollmentSnapshotSection *>::iterator it;
+
+	// Providers cannot go away while they are being used
+	rina::ReadScopedLock readLock(snapshot_lock);
+	it = snapshot_sections.find(name);
+	if (it == snapshot_sections.end())
+		return false;
+
+	it->second->get_snapshot(port_id, result);
+
+	return true;
+}
+
+bool EnrollmentTask::apply_snapshot_section(const std::string& name,
+					    int port_id,
+					    const rina::ser_obj_t& snapshot)
+{
+	std::map<std::string, IEnrollmentSnapshotSection *>::iterator it;
+
+	rina::ReadScopedLock readLock(snapshot_lock);
+	it = snapshot_sections.find(name);
+	if (it == snapshot_sections.end())
+		return false;
+
+	it->second->apply_snapshot(port_id, snapshot);
+
+	return true;
+}
+
+void EnrollmentTask::snapshot_sections_sent(const std::list<std::string>& names,
+					    int port_id)
+{
+	std::map<std::string, IEnrollmentSnapshotSection *>::iterator it;
+	std::list<std::string>::const_iterator name;
+
+	rina::ReadScopedLock readLock(snapshot_lock);
+	for (name = names.begin(); name != names.end(); ++name) {
+		it = snapshot_sections.find(*name);
+		if (it != snapshot_sections.end())
+			it->second->snapshot_sent(port_id);
+	}
+}
+
 void EnrollmentTask::addressChange(rina::AddressChangeEvent * event)
 {
 	encoders::NeighborListEncoder encoder;
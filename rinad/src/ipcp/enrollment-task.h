@@ -389,6 +389,18 @@ public:
 				            rina::cdap_rib::con_handle_t& con);
 	int get_neighbor_info(rina::Neighbor& neigh);
 	void clean_state(unsigned int port_id);
+	void add_snapshot_section(const std::string& name,
+				  IEnrollmentSnapshotSection * section);
+	void remove_snapshot_section(const std::string& name);
+	std::list<std::string> get_snapshot_section_names();
+	bool get_snapshot_section(const std::string& name,
+				  int port_id,
+				  rina::ser_obj_t& result);
+	bool apply_snapshot_section(const std::string& name,
+				    int port_id,
+				    const rina::ser_obj_t& snapshot);
+	void snapshot_sections_sent(const std::list<std::string>& names,
+				    int port_id);
 
 private:
 	void parse_n1flows(const std::string& name,
@@ -447,6 +459,10 @@ private:
 	std::map<std::string, rina::Neighbor *> neighbors;
 	rina::ReadWriteLockable neigh_lock;
 
+	/// Providers of the sections of the enrollment snapshot
+	std::map<std::string, IEnrollmentSnapshotSection *> snapshot_sections;
+	rina::ReadWriteLockable snapshot_lock;
+
 	IPCPEnrollmentTaskPS * ipcp_ps;
 };
 
@@ -22,6 +22,7 @@
 
 #include <climits>
 #include <sstream>
+#include <time.h>
 #include <vector>
 
 #define IPCP_MODULE "flow-allocator"
@@ -225,12 +226,23 @@ const std::string DTCPRIBObject::get_displayable_value() const
 //Class Flow Allocator
 const int FlowAllocator::DEALLOCATE_PORT_DELAY = 0;
 const int FlowAllocator::TEARDOWN_FLOW_DELAY = 0;
+const int FlowAllocator::PORT_ID_POOL_IDLE_TIMEOUT = 60000;
+const std::string FlowAllocator::PORT_ID_POOL_SIZE = "portIdPoolSize";
+
+static long fa_now_ms()
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1000L + now.tv_nsec / 1000000L;
+}
 
 FlowAllocator::FlowAllocator() : IFlowAllocator()
 {
 	ipcp = 0;
 	rib_daemon_ = 0;
 	namespace_manager_ = 0;
+	port_id_pool_size = 0;
 }
 
 FlowAllocator::~FlowAllocator()
@@ -317,10 +329,151 @@ void FAAddressChangeTimerTask::run()
 
 void FlowAllocator::set_dif_configuration(const rina::DIFInformation& dif_information)
 {
-	std::string ps_name = dif_information.dif_configuration_.fa_configuration_.policy_set_.name_;
-	if (select_policy_set(std::string(), ps_name) != 0) {
+	rina::PolicyConfig psconf = dif_information.dif_configuration_.fa_configuration_.policy_set_;
+	if (select_policy_set(std::string(), psconf.name_) != 0) {
 		throw rina::Exception("Cannot create Flow Allocator policy-set");
 	}
+
+	try {
+		port_id_pool_size = psconf.get_param_value_as_uint(PORT_ID_POOL_SIZE);
+	} catch (rina::Exception &e) {
+		LOG_IPCP_DBG("Could not parse port_id_pool_size, using default value: %u",
+			     port_id_pool_size);
+	}
+
+	if (port_id_pool_size > 0) {
+		LOG_IPCP_INFO("Reserving %u port-ids in advance per application",
+			      port_id_pool_size);
+		timer.scheduleTask(new PortIdPoolTimerTask(this),
+				   PORT_ID_POOL_IDLE_TIMEOUT);
+	}
+}
+
+int FlowAllocator::getPooledPortId(const rina::ApplicationProcessNamingInformation& app_name,
+				   const rina::FlowSpecification& flow_spec)
+{
+	std::stringstream ss;
+	int port_id = -1;
+
+	//Flows internal to the IPCP are not frequent enough to be worth it
+	if (port_id_pool_size == 0 || app_name.processName == "")
+		return -1;
+
+	ss << app_name.getEncodedString() << "|" << flow_spec.msg_boundaries;
+
+	rina::ScopedLock g(port_alloc_lock);
+
+	port_id_pool& pool = port_id_pools[ss.str()];
+	if (pool.last_use == 0) {
+		pool.app_name = app_name;
+		pool.flow_spec = flow_spec;
+	}
+	pool.last_use = fa_now_ms();
+
+	if (!pool.port_ids.empty()) {
+		port_id = pool.port_ids.front();
+		pool.port_ids.pop_front();
+	}
+
+	refillPortIdPool(ss.str(), pool);
+
+	return port_id;
+}
+
+void FlowAllocator::refillPortIdPool(const std::string& key, port_id_pool& pool)
+{
+	OngoingFlowAllocState flow_state;
+	unsigned int seq_num;
+
+	flow_state.local_request = false;
+	flow_state.flow = 0;
+	flow_state.invoke_id = 0;
+	flow_state.address = 0;
+	flow_state.pool_key = key;
+
+	while (pool.port_ids.size() + pool.requested < port_id_pool_size) {
+		try {
+			seq_num = rina::extendedIPCManager->allocatePortId(pool.app_name,
+									   pool.flow_spec);
+		} catch (rina::Exception &e) {
+			LOG_IPCP_ERR("Problems requesting an available port-id to the Kernel IPC Manager: %s",
+				     e.what());
+			return;
+		}
+
+		pending_port_allocs[seq_num] = flow_state;
+		pool.requested++;
+	}
+}
+
+void FlowAllocator::addPooledPortId(const std::string& key, bool success, int port_id)
+{
+	std::map<std::string, port_id_pool>::iterator it;
+
+	port_alloc_lock.lock();
+	it = port_id_pools.find(key);
+	if (it != port_id_pools.end()) {
+		if (it->second.requested > 0)
+			it->second.requested--;
+
+		if (success) {
+			it->second.port_ids.push_back(port_id);
+			port_alloc_lock.unlock();
+			return;
+		}
+	}
+	port_alloc_lock.unlock();
+
+	//The pool has been released while the reservation was in flight
+	if (success) {
+		try {
+			rina::extendedIPCManager->deallocatePortId(port_id);
+		} catch (rina::Exception &e) {
+			LOG_IPCP_ERR("Problems releasing port-id %d: %s",
+				     port_id, e.what());
+		}
+	}
+}
+
+void FlowAllocator::releaseIdlePortIdPools()
+{
+	std::map<std::string, port_id_pool>::iterator it;
+	std::list<int> port_ids;
+	long now = fa_now_ms();
+
+	port_alloc_lock.lock();
+	it = port_id_pools.begin();
+	while (it != port_id_pools.end()) {
+		if (now - it->second.last_use < PORT_ID_POOL_IDLE_TIMEOUT) {
+			++it;
+			continue;
+		}
+
+		LOG_IPCP_DBG("Releasing the %zu port-ids reserved for idle application %s",
+			     it->second.port_ids.size(),
+			     it->second.app_name.getEncodedString().c_str());
+		port_ids.splice(port_ids.end(), it->second.port_ids);
+		port_id_pools.erase(it++);
+	}
+	port_alloc_lock.unlock();
+
+	for (std::list<int>::iterator pit = port_ids.begin();
+			pit != port_ids.end(); ++pit) {
+		try {
+			rina::extendedIPCManager->deallocatePortId(*pit);
+		} catch (rina::Exception &e) {
+			LOG_IPCP_ERR("Problems releasing port-id %d: %s",
+				     *pit, e.what());
+		}
+	}
+
+	timer.scheduleTask(new PortIdPoolTimerTask(this),
+			   PORT_ID_POOL_IDLE_TIMEOUT);
+}
+
+void PortIdPoolTimerTask::run()
+{
+	fall->releaseIdlePortIdPools();
 }
 
 void FlowAllocator::populateRIB()
@@ -384,8 +537,6 @@ void FlowAllocator::createFlowRequestMessageReceived(configs::Flow * flow,
 	}
 
 	if (process_flow_request) {
-		rina::ScopedLock g(port_alloc_lock);
-
 		LOG_IPCP_DBG("The destination AP is reachable through me");
 
 		//Reverse flow information
@@ -401,6 +552,17 @@ void FlowAllocator::createFlowRequestMessageReceived(configs::Flow * flow,
 		connection->setDestAddress(address);
 		connection->setDestCepId(connection->getSourceCepId());
 
+		portId = getPooledPortId(app_info, flow->flow_specification);
+		if (portId >= 0) {
+			__createFlowRequestMessageReceived(flow,
+							   object_name,
+							   invoke_id,
+							   portId);
+			return;
+		}
+
+		rina::ScopedLock g(port_alloc_lock);
+
 		try {
 			seq_num = rina::extendedIPCManager->allocatePortId(app_info,
 									   flow->flow_specification);
@@ -439,8 +601,6 @@ void FlowAllocator::__createFlowRequestMessageReceived(configs::Flow * flow,
 	FlowAllocatorInstance * fai;
 	std::stringstream ss;
 
-	rina::ScopedLock g(fai_lock);
-
 	ss << port_id;
 	fai = new FlowAllocatorInstance(ipcp,
 					this,
@@ -448,7 +608,12 @@ void FlowAllocator::__createFlowRequestMessageReceived(configs::Flow * flow,
 					false,
 					ss.str(),
 					&timer);
+
+	//No other event can refer to the port-id until the FAI talks to
+	//the kernel, so other allocations do not wait for this one
+	fai_lock.lock();
 	fa_instances[port_id] = fai;
+	fai_lock.unlock();
 
 	fai->createFlowRequestMessageReceived(flow,
 					      object_name,
@@ -472,6 +637,7 @@ void FlowAllocator::submitAllocateRequest(const rina::FlowRequestEvent& event,
 					  unsigned int address)
 {
 	unsigned int seq_num = 0;
+	int port_id;
 	OngoingFlowAllocState flow_state;
 	rina::ApplicationProcessNamingInformation app_info;
 
@@ -483,6 +649,12 @@ void FlowAllocator::submitAllocateRequest(const rina::FlowRequestEvent& event,
 		app_info = event.localApplicationName;
 	}
 
+	port_id = getPooledPortId(app_info, event.flowSpecification);
+	if (port_id >= 0) {
+		__submitAllocateRequest(event, port_id, address);
+		return;
+	}
+
 	rina::ScopedLock g(port_alloc_lock);
 
 	try {
@@ -525,6 +697,13 @@ void FlowAllocator::processAllocatePortResponse(const rina::AllocatePortResponse
 	pending_port_allocs.erase(it);
 	port_alloc_lock.unlock();
 
+	if (flow_state.pool_key != "") {
+		addPooledPortId(flow_state.pool_key,
+				event.result == 0,
+				event.port_id);
+		return;
+	}
+
 	if (event.result != 0) {
 		LOG_IPCP_ERR("Port-id allocation failed: %d", event.result);
 		if (flow_state.local_request && !flow_state.flow_event.internal) {
@@ -553,8 +732,6 @@ void FlowAllocator::__submitAllocateRequest(const rina::FlowRequestEvent& event,
 	FlowAllocatorInstance * fai;
 	std::stringstream ss;
 
-	rina::ScopedLock g(fai_lock);
-
 	ss << port_id;
 	fai = new FlowAllocatorInstance(ipcp,
 					this,
@@ -562,14 +739,23 @@ void FlowAllocator::__submitAllocateRequest(const rina::FlowRequestEvent& event,
 					true,
 					ss.str(),
 					&timer);
+
+	//No other event can refer to the port-id until the FAI talks to
+	//the kernel, so other allocations do not wait for this one
+	fai_lock.lock();
 	fa_instances[port_id] = fai;
+	allocation_keys[port_id] = event.sequenceNumber;
+	fai_lock.unlock();
 
 	try {
 		fai->submitAllocateRequest(event, address);
 	} catch (rina::Exception &e) {
 		LOG_IPCP_ERR("Problems allocating flow: %s",
 				e.what());
+		fai_lock.lock();
 		fa_instances.erase(port_id);
+		allocation_keys.erase(port_id);
+		fai_lock.unlock();
 		delete fai;
 
 		try {
@@ -615,23 +801,80 @@ void FlowAllocator::processCreateConnectionResponseEvent(const rina::CreateConne
 
 void FlowAllocator::submitAllocateResponse(const rina::AllocateFlowResponseEvent& event)
 {
-	std::map<int, FlowAllocatorInstance *>::iterator it;
+	std::map<unsigned int, int>::iterator it;
+	std::map<int, FlowAllocatorInstance *>::iterator jt;
+	FlowAllocatorInstance * fai = 0;
 
 	LOG_IPCP_DBG("Local application invoked allocate response with seq num %ud and result %d, ",
 		     event.sequenceNumber,
 		     event.result);
 
 	fai_lock.lock();
-	for (it = fa_instances.begin(); it != fa_instances.end(); ++it) {
-		if (it->second->get_allocate_response_message_handle() == event.sequenceNumber) {
-			fai_lock.unlock();
-			it->second->submitAllocateResponse(event);
-			return;
-		}
+	it = allocate_response_ports.find(event.sequenceNumber);
+	if (it != allocate_response_ports.end()) {
+		jt = fa_instances.find(it->second);
+		if (jt != fa_instances.end())
+			fai = jt->second;
+		allocate_response_ports.erase(it);
 	}
 	fai_lock.unlock();
 
-	LOG_IPCP_ERR("Could not find FAI with handle %ud", event.sequenceNumber);
+	if (!fai) {
+		LOG_IPCP_ERR("Could not find FAI with handle %ud", event.sequenceNumber);
+		return;
+	}
+
+	fai->submitAllocateResponse(event);
+}
+
+void FlowAllocator::addAllocateResponseHandle(unsigned int handle, int portId)
+{
+	rina::ScopedLock g(fai_lock);
+
+	allocate_response_ports[handle] = portId;
+}
+
+int FlowAllocator::getAllocateResponsePort(unsigned int handle)
+{
+	std::map<unsigned int, int>::iterator it;
+
+	rina::ScopedLock g(fai_lock);
+
+	it = allocate_response_ports.find(handle);
+	if (it == allocate_response_ports.end())
+		return -1;
+
+	return it->second;
+}
+
+bool FlowAllocator::getAllocationKey(int portId, unsigned int& key)
+{
+	std::map<int, unsigned int>::iterator it;
+
+	rina::ScopedLock g(fai_lock);
+
+	it = allocation_keys.find(portId);
+	if (it == allocation_keys.end())
+		return false;
+
+	key = it->second;
+	return true;
+}
+
+bool FlowAllocator::getPortAllocationKey(unsigned int handle,
+					 unsigned int& key)
+{
+	std::map<unsigned int, OngoingFlowAllocState>::iterator it;
+
+	rina::ScopedLock g(port_alloc_lock);
+
+	it = pending_port_allocs.find(handle);
+	if (it == pending_port_allocs.end() || !it->second.local_request ||
+			it->second.pool_key != "")
+		return false;
+
+	key = it->second.flow_event.sequenceNumber;
+	return true;
 }
 
 void FlowAllocator::processCreateConnectionResultEvent(const rina::CreateConnectionResultEvent& event)
@@ -699,6 +942,7 @@ void FlowAllocator::submitDeallocate(const rina::FlowDeallocateRequestEvent& eve
 void FlowAllocator::removeFlowAllocatorInstance(int portId)
 {
 	std::map<int, FlowAllocatorInstance *>::iterator it;
+	std::map<unsigned int, int>::iterator jt;
 	FlowAllocatorInstance * fai = 0;
 
 	LOG_IPCP_DBG("Removing FAI of port-id %d from Flow Allocator", portId);
@@ -708,6 +952,12 @@ void FlowAllocator::removeFlowAllocatorInstance(int portId)
 	if (it != fa_instances.end()) {
 		fai = it->second;
 		fa_instances.erase(it);
+		allocation_keys.erase(portId);
+
+		//The FAI may be removed before the application replied
+		jt = allocate_response_ports.find(fai->get_allocate_response_message_handle());
+		if (jt != allocate_response_ports.end() && jt->second == portId)
+			allocate_response_ports.erase(jt);
 	}
 	fai_lock.unlock();
 
@@ -794,7 +1044,7 @@ unsigned int FlowAllocatorInstance::get_allocate_response_message_handle() const
 	unsigned int t;
 
 	{
-		rina::ScopedLock g(rina::Lockable lock);
+		rina::ScopedLock g(lock_);
 		t = allocate_response_message_handle_;
 	}
 
@@ -1136,6 +1386,8 @@ void FlowAllocatorInstance::processCreateConnectionResultEvent(const rina::Creat
 						flow_->remote_naming_info,
 						flow_->flow_specification,
 						port_id_);
+		flow_allocator_->addAllocateResponseHandle(allocate_response_message_handle_,
+							   port_id_);
 		LOG_IPCP_DBG("Informed IPC Manager about incoming flow allocation request, got handle: %ud",
 				allocate_response_message_handle_);
 	} catch (rina::Exception &e) {
@@ -268,6 +268,22 @@ struct OngoingFlowAllocState {
 	int invoke_id;
 	bool local_request;
 	unsigned int address;
+	/// Not empty if the port-id is reserved to refill a port-id pool
+	std::string pool_key;
+};
+
+/// Port-ids reserved in advance for the flows of an application, so
+/// that its flow allocations do not wait for the kernel to reserve one
+struct port_id_pool {
+	port_id_pool() : requested(0), last_use(0) {};
+
+	rina::ApplicationProcessNamingInformation app_name;
+	rina::FlowSpecification flow_spec;
+	std::list<int> port_ids;
+	/// Reservations requested to the kernel and not answered yet
+	unsigned int requested;
+	/// Time the pool was last used (ms)
+	long last_use;
 };
 
 class FlowAllocatorInstance;
@@ -289,6 +305,10 @@ public:
 	void processCreateConnectionResponseEvent(
 			const rina::CreateConnectionResponseEvent& event);
 	void submitAllocateResponse(const rina::AllocateFlowResponseEvent& event);
+	void addAllocateResponseHandle(unsigned int handle, int portId);
+	int getAllocateResponsePort(unsigned int handle);
+	bool getAllocationKey(int portId, unsigned int& key);
+	bool getPortAllocationKey(unsigned int handle, unsigned int& key);
 	void processCreateConnectionResultEvent(
 			const rina::CreateConnectionResultEvent& event);
 	void processUpdateConnectionResponseEvent(
@@ -304,9 +324,17 @@ public:
         configs::Flow* createFlow() { return new configs::Flow(); }
         void destroyFlow(configs::Flow* flow) { if (flow) delete flow; }
 
+	/// Release the port-ids of the pools that have not been used
+	/// for PORT_ID_POOL_IDLE_TIMEOUT ms
+	void releaseIdlePortIdPools();
+
         // Constants
         const static int DEALLOCATE_PORT_DELAY;
         const static int TEARDOWN_FLOW_DELAY;
+        const static int PORT_ID_POOL_IDLE_TIMEOUT;
+
+        // Policy parameters
+        const static std::string PORT_ID_POOL_SIZE;
 
 private:
 	IPCPRIBDaemon * rib_daemon_;
@@ -314,8 +342,20 @@ private:
 	rina::Timer timer;
 
 	std::map<unsigned int, OngoingFlowAllocState> pending_port_allocs;
+	/// Pools of port-ids, by application name and message boundaries.
+	/// Protected by port_alloc_lock
+	std::map<std::string, port_id_pool> port_id_pools;
+	/// Number of port-ids reserved in advance per application, 0 if
+	/// port-ids are reserved for every flow allocation
+	unsigned int port_id_pool_size;
 	rina::Lockable port_alloc_lock;
 	std::map<int, FlowAllocatorInstance *> fa_instances;
+	/// Port-id of the FAIs waiting for an allocate response, by the
+	/// handle of the response. Protected by fai_lock
+	std::map<unsigned int, int> allocate_response_ports;
+	/// Sequence number of the allocation request of the FAIs of local
+	/// allocations, by port-id. Protected by fai_lock
+	std::map<int, unsigned int> allocation_keys;
 	rina::Lockable fai_lock;
 
 	/// Create initial RIB objects
@@ -332,6 +372,27 @@ private:
 		             	     	     	const std::string& object_name,
 						int invoke_id,
 						int port_id);
+
+	/// Take a port-id from the pool of the application, and ask the
+	/// kernel to reserve more if the pool is running low. Returns -1 if
+	/// there is no port-id available
+	int getPooledPortId(const rina::ApplicationProcessNamingInformation& app_name,
+			    const rina::FlowSpecification& flow_spec);
+	void refillPortIdPool(const std::string& key, port_id_pool& pool);
+	void addPooledPortId(const std::string& key, bool success, int port_id);
+};
+
+class PortIdPoolTimerTask: public rina::TimerTask {
+public:
+	PortIdPoolTimerTask(FlowAllocator * fa) : fall(fa) {};
+	~PortIdPoolTimerTask() throw() {};
+	void run();
+	std::string name() const {
+		return "port-id-pool";
+	}
+
+private:
+	FlowAllocator * fall;
 };
 
 class FAAddressChangeTimerTask: public rina::TimerTask {
@@ -455,7 +516,7 @@ private:
 	unsigned int allocate_response_message_handle_;
 	int invoke_id_;
 	bool local;
-	rina::Lockable lock_;
+	mutable rina::Lockable lock_;
 };
 
 class TearDownFlowTimerTask: public rina::TimerTask {
@@ -22,6 +22,7 @@
 #include <cstdlib>
 #include <sstream>
 #include <iostream>
+#include <time.h>
 
 #define IPCP_MODULE "ipc-process"
 #include "ipcp-logging.h"
@@ -49,6 +50,276 @@ namespace rinad {
 #define IPCP_EVENT_TIMEOUT_S 0
 #define IPCP_EVENT_TIMEOUT_NS 1000000000 //1 sec
 
+//Name and number of executors of each stage
+static const struct {
+	const char * name;
+	unsigned int executors;
+} ipcp_stages[IPCP_STAGE_MAX] = {
+	{ "mgmt", IPCP_STAGE_SHARDS },
+	{ "flow-alloc", IPCP_STAGE_SHARDS },
+	{ "routing", 1 },
+	{ "kernel", 1 },
+};
+
+//Class IPCPEventTask
+class IPCPEventTask: public rina::TimerTask {
+public:
+	IPCPEventTask(AbstractIPCProcessImpl * ipcp, rina::IPCEvent * e) :
+		ipcp(ipcp), event(e) { };
+	~IPCPEventTask() throw() {};
+	void run() {
+		ipcp->handle_event(event);
+	}
+	std::string name() const {
+		return "ipcp-event";
+	}
+
+private:
+	AbstractIPCProcessImpl * ipcp;
+	rina::IPCEvent * event;
+};
+
+static unsigned long elapsed_us(const struct timespec& from,
+				const struct timespec& to)
+{
+	long us;
+
+	us = (to.tv_sec - from.tv_sec) * 1000000L +
+		(to.tv_nsec - from.tv_nsec) / 1000;
+
+	return us > 0 ? us : 0;
+}
+
+//Stage run by the calling thread, if it is a stage executor
+static __thread IPCPStage * current_stage = 0;
+
+//Class IPCPStage
+IPCPStage::IPCPStage(const std::string& name) :
+		rina::SimpleThread("ipcp-stage-" + name, false),
+		stage_name(name)
+{
+	finished = false;
+	queued = 0;
+	space_waiters = 0;
+	submitted = 0;
+	full_waits = 0;
+	overflows = 0;
+	drain_waiters = 0;
+	processed = 0;
+	queue_us_total = 0;
+	queue_us_max = 0;
+	run_us_total = 0;
+	run_us_max = 0;
+}
+
+IPCPStage::~IPCPStage() throw()
+{
+	stage_entry * entry;
+
+	while ((entry = queue.poll()) != 0) {
+		delete entry->task;
+		delete entry;
+	}
+}
+
+void IPCPStage::submit(rina::TimerTask * task)
+{
+	stage_entry * entry;
+
+	if (__atomic_load_n(&finished, __ATOMIC_ACQUIRE)) {
+		LOG_IPCP_DBG("Stage %s finished, dropping task %s",
+			     stage_name.c_str(), task->name().c_str());
+		delete task;
+		return;
+	}
+
+	if (__atomic_load_n(&queued, __ATOMIC_SEQ_CST) >= IPCP_STAGE_QUEUE_SIZE) {
+		if (current_stage) {
+			__atomic_add_fetch(&overflows, 1, __ATOMIC_RELAXED);
+		} else {
+			__atomic_add_fetch(&full_waits, 1, __ATOMIC_RELAXED);
+
+			space_cv.lock();
+			__atomic_add_fetch(&space_waiters, 1, __ATOMIC_SEQ_CST);
+			while (!__atomic_load_n(&finished, __ATOMIC_SEQ_CST) &&
+					__atomic_load_n(&queued, __ATOMIC_SEQ_CST) >=
+					IPCP_STAGE_QUEUE_SIZE)
+				space_cv.doWait();
+			__atomic_sub_fetch(&space_waiters, 1, __ATOMIC_SEQ_CST);
+			space_cv.unlock();
+
+			if (__atomic_load_n(&finished, __ATOMIC_ACQUIRE)) {
+				LOG_IPCP_DBG("Stage %s finished, dropping task %s",
+					     stage_name.c_str(),
+					     task->name().c_str());
+				delete task;
+				return;
+			}
+		}
+	}
+
+	entry = new stage_entry();
+	entry->task = task;
+	clock_gettime(CLOCK_MONOTONIC, &entry->queued);
+	__atomic_add_fetch(&submitted, 1, __ATOMIC_RELEASE);
+	__atomic_add_fetch(&queued, 1, __ATOMIC_SEQ_CST);
+	queue.put(entry);
+}
+
+void IPCPStage::finish()
+{
+	stage_entry * entry;
+
+	if (__atomic_exchange_n(&finished, true, __ATOMIC_ACQ_REL))
+		return;
+
+	//The NULL task tells the executor to exit
+	entry = new stage_entry();
+	entry->task = 0;
+	queue.put(entry);
+	join(NULL);
+
+	drain_cv.lock();
+	drain_cv.broadcast();
+	drain_cv.unlock();
+
+	space_cv.lock();
+	space_cv.broadcast();
+	space_cv.unlock();
+
+	//Tasks that raced with the finished flag are not run, but they
+	//are deleted now, since they may refer to components that are
+	//about to be destroyed
+	while ((entry = queue.poll()) != 0) {
+		delete entry->task;
+		delete entry;
+	}
+}
+
+void IPCPStage::drain()
+{
+	unsigned long target = __atomic_load_n(&submitted, __ATOMIC_ACQUIRE);
+
+	drain_cv.lock();
+	__atomic_add_fetch(&drain_waiters, 1, __ATOMIC_SEQ_CST);
+	while (!__atomic_load_n(&finished, __ATOMIC_SEQ_CST) &&
+			__atomic_load_n(&processed, __ATOMIC_SEQ_CST) < target)
+		drain_cv.doWait();
+	__atomic_sub_fetch(&drain_waiters, 1, __ATOMIC_SEQ_CST);
+	drain_cv.unlock();
+}
+
+int IPCPStage::run()
+{
+	struct timespec started, ended;
+	stage_entry * entry;
+	unsigned long us;
+
+	current_stage = this;
+
+	for (;;) {
+		entry = queue.take();
+		if (!entry->task) {
+			delete entry;
+			break;
+		}
+
+		//A submit() that checked queued before the decrement has
+		//registered as a waiter, so the lock is only taken then
+		__atomic_sub_fetch(&queued, 1, __ATOMIC_SEQ_CST);
+		if (__atomic_load_n(&space_waiters, __ATOMIC_SEQ_CST)) {
+			space_cv.lock();
+			space_cv.signal();
+			space_cv.unlock();
+		}
+
+		clock_gettime(CLOCK_MONOTONIC, &started);
+		try {
+			entry->task->run();
+		} catch (rina::Exception &e) {
+			LOG_IPCP_ERR("Problems running task %s in stage %s: %s",
+				     entry->task->name().c_str(),
+				     stage_name.c_str(), e.what());
+		} catch (std::exception &e) {
+			LOG_IPCP_ERR("Problems running task %s in stage %s: %s",
+				     entry->task->name().c_str(),
+				     stage_name.c_str(), e.what());
+		} catch (...) {
+			LOG_IPCP_ERR("Unhandled exception in stage %s",
+				     stage_name.c_str());
+		}
+		clock_gettime(CLOCK_MONOTONIC, &ended);
+
+		us = elapsed_us(entry->queued, started);
+		__atomic_add_fetch(&queue_us_total, us, __ATOMIC_RELAXED);
+		if (us > queue_us_max)
+			__atomic_store_n(&queue_us_max, us, __ATOMIC_RELAXED);
+
+		us = elapsed_us(started, ended);
+		__atomic_add_fetch(&run_us_total, us, __ATOMIC_RELAXED);
+		if (us > run_us_max)
+			__atomic_store_n(&run_us_max, us, __ATOMIC_RELAXED);
+
+		__atomic_add_fetch(&processed, 1, __ATOMIC_SEQ_CST);
+
+		//A drain() that checked processed before the increment has
+		//registered as a waiter, so the lock is only taken then
+		if (__atomic_load_n(&drain_waiters, __ATOMIC_SEQ_CST)) {
+			drain_cv.lock();
+			drain_cv.broadcast();
+			drain_cv.unlock();
+		}
+
+		delete entry->task;
+		delete entry;
+	}
+
+	return 0;
+}
+
+const std::string& IPCPStage::get_stage_name() const
+{
+	return stage_name;
+}
+
+const std::string IPCPStage::get_stats() const
+{
+	unsigned long count;
+	std::stringstream ss;
+
+	count = __atomic_load_n(&processed, __ATOMIC_ACQUIRE);
+
+	ss << "Queue depth: " << queue.size() << "/" << IPCP_STAGE_QUEUE_SIZE
+	   << "; Processed tasks: " << count << std::endl;
+	ss << "Queue full: waits " << __atomic_load_n(&full_waits, __ATOMIC_RELAXED)
+	   << ", overflows " << __atomic_load_n(&overflows, __ATOMIC_RELAXED)
+	   << std::endl;
+	ss << "Queue wait (us): avg "
+	   << (count ? __atomic_load_n(&queue_us_total, __ATOMIC_RELAXED) / count : 0)
+	   << ", max " << __atomic_load_n(&queue_us_max, __ATOMIC_RELAXED)
+	   << "; Run time (us): avg "
+	   << (count ? __atomic_load_n(&run_us_total, __ATOMIC_RELAXED) / count : 0)
+	   << ", max " << __atomic_load_n(&run_us_max, __ATOMIC_RELAXED);
+
+	return ss.str();
+}
+
+//Class IPCPStageRIBObj
+const std::string IPCPStageRIBObj::parent_class_name = "Stages";
+const std::string IPCPStageRIBObj::parent_object_name = "/stages";
+const std::string IPCPStageRIBObj::class_name = "Stage";
+const std::string IPCPStageRIBObj::object_name_prefix = "/stages/name=";
+
+IPCPStageRIBObj::IPCPStageRIBObj(IPCPStage * st)
+	: rina::rib::RIBObj(class_name), stage(st)
+{
+}
+
+const std::string IPCPStageRIBObj::get_displayable_value() const
+{
+	return stage->get_stats();
+}
+
 //Class IPCProcessImpl
 AbstractIPCProcessImpl::AbstractIPCProcessImpl(const rina::ApplicationProcessNamingInformation& nm,
 					       unsigned short id,
@@ -73,12 +344,29 @@ AbstractIPCProcessImpl::AbstractIPCProcessImpl(const rina::ApplicationProcessNam
         state = NOT_INITIALIZED;
         lock_ = new rina::Lockable();
         keep_running = true;
+
+        for (int i = 0; i < IPCP_STAGE_MAX; i++) {
+        	for (unsigned int j = 0; j < ipcp_stages[i].executors; j++) {
+        		std::stringstream ss;
+
+        		ss << ipcp_stages[i].name;
+        		if (ipcp_stages[i].executors > 1)
+        			ss << "-" << j;
+        		stages[i].push_back(new IPCPStage(ss.str()));
+        		stages[i].back()->start();
+        	}
+        }
 }
 
 AbstractIPCProcessImpl::~AbstractIPCProcessImpl() {
 
 	LOG_IPCP_INFO("Abstract IPCP Destuctor called");
 
+	stop_stages();
+	for (int i = 0; i < IPCP_STAGE_MAX; i++)
+		for (unsigned int j = 0; j < stages[i].size(); j++)
+			delete stages[i][j];
+
 	if (lock_) {
 		delete lock_;
 	}
@@ -90,9 +378,119 @@ const std::string AbstractIPCProcessImpl::get_type() const
 }
 
 //Event loop handlers
+ipcp_stage_t AbstractIPCProcessImpl::get_event_stage(rina::IPCEvent * e,
+						     unsigned int& key)
+{
+	int port_id = -1;
+
+	key = 0;
+
+	switch(e->eventType) {
+	case rina::IPC_PROCESS_READ_MGMT_SDU_NOTIF:
+		key = dynamic_cast<rina::ReadMgmtSDUResponseEvent*>(e)->port_id;
+		return IPCP_STAGE_MGMT;
+	case rina::IPC_PROCESS_WRITE_MGMT_SDU_RESPONSE:
+		port_id = get_response_port(e);
+		if (port_id >= 0)
+			key = port_id;
+		return IPCP_STAGE_MGMT;
+	//Life cycle of the N-1 flows, ordered with their management SDUs
+	case rina::IPCM_ALLOCATE_FLOW_REQUEST_RESULT:
+		key = dynamic_cast<rina::IpcmAllocateFlowRequestResultEvent*>(e)->portId;
+		return IPCP_STAGE_MGMT;
+	case rina::FLOW_DEALLOCATED_EVENT:
+		key = dynamic_cast<rina::FlowDeallocatedEvent*>(e)->portId;
+		return IPCP_STAGE_MGMT;
+	case rina::IPCP_N1_PORT_LIVENESS_EVENT:
+		key = dynamic_cast<rina::NMinusOnePortLivenessEvent*>(e)->port_id;
+		return IPCP_STAGE_MGMT;
+	//Local requests carry no port-id yet, they are keyed by their
+	//sequence number, and so are the later events of the allocation
+	case rina::FLOW_ALLOCATION_REQUESTED_EVENT:
+		key = e->sequenceNumber;
+		return IPCP_STAGE_FLOW_ALLOC;
+	case rina::ALLOCATE_FLOW_REQUEST_RESULT_EVENT:
+		port_id = dynamic_cast<rina::AllocateFlowRequestResultEvent*>(e)->portId;
+		break;
+	case rina::FLOW_DEALLOCATION_REQUESTED_EVENT:
+		port_id = dynamic_cast<rina::FlowDeallocateRequestEvent*>(e)->portId;
+		break;
+	case rina::ALLOCATE_FLOW_RESPONSE_EVENT:
+		port_id = get_response_port(e);
+		break;
+	case rina::IPC_PROCESS_CREATE_CONNECTION_RESPONSE:
+		port_id = dynamic_cast<rina::CreateConnectionResponseEvent*>(e)->portId;
+		break;
+	case rina::IPC_PROCESS_CREATE_CONNECTION_RESULT:
+		port_id = dynamic_cast<rina::CreateConnectionResultEvent*>(e)->portId;
+		break;
+	case rina::IPC_PROCESS_UPDATE_CONNECTION_RESPONSE:
+		port_id = dynamic_cast<rina::UpdateConnectionResponseEvent*>(e)->portId;
+		break;
+	case rina::IPC_PROCESS_DESTROY_CONNECTION_RESULT:
+		port_id = dynamic_cast<rina::DestroyConnectionResultEvent*>(e)->portId;
+		break;
+	case rina::IPC_PROCESS_ALLOCATE_PORT_RESPONSE:
+		port_id = dynamic_cast<rina::AllocatePortResponseEvent*>(e)->port_id;
+		break;
+	case rina::IPC_PROCESS_DEALLOCATE_PORT_RESPONSE:
+		port_id = dynamic_cast<rina::DeallocatePortResponseEvent*>(e)->port_id;
+		break;
+	//Reads the forwarding table, which the routing stage writes
+	case rina::IPC_PROCESS_DUMP_FT_RESPONSE:
+		return IPCP_STAGE_ROUTING;
+	default:
+		return IPCP_STAGE_KERNEL;
+	}
+
+	//Flow allocator event referring to port_id
+	if (!get_allocation_key(e, port_id, key) && port_id >= 0)
+		key = port_id;
+
+	return IPCP_STAGE_FLOW_ALLOC;
+}
+
+bool AbstractIPCProcessImpl::is_barrier_event(rina::IPCEventType type)
+{
+	switch(type) {
+	case rina::ASSIGN_TO_DIF_RESPONSE_EVENT:
+	case rina::UPDATE_DIF_CONFIG_REQUEST_EVENT:
+	case rina::IPC_PROCESS_SET_POLICY_SET_PARAM:
+	case rina::IPC_PROCESS_SELECT_POLICY_SET:
+	case rina::IPC_PROCESS_PLUGIN_LOAD:
+	case rina::DISCONNECT_NEIGHBOR_REQUEST_EVENT:
+		return true;
+	default:
+		return false;
+	}
+}
+
+void AbstractIPCProcessImpl::submit_to_stage(ipcp_stage_t stage,
+					     rina::TimerTask * task,
+					     unsigned int key)
+{
+	stages[stage][key % stages[stage].size()]->submit(task);
+}
+
+void AbstractIPCProcessImpl::stop_stages(void)
+{
+	for (int i = 0; i < IPCP_STAGE_MAX; i++)
+		for (unsigned int j = 0; j < stages[i].size(); j++)
+			stages[i][j]->finish();
+}
+
+void AbstractIPCProcessImpl::drain_stages(void)
+{
+	for (int i = 0; i < IPCP_STAGE_MAX; i++)
+		for (unsigned int j = 0; j < stages[i].size(); j++)
+			stages[i][j]->drain();
+}
+
 void AbstractIPCProcessImpl::event_loop(void)
 {
 	rina::IPCEvent *e;
+	ipcp_stage_t stage;
+	unsigned int key;
 
 	keep_running = true;
 
@@ -108,247 +506,14 @@ void AbstractIPCProcessImpl::event_loop(void)
 					rina::IPCEvent::eventTypeToString(e->eventType).c_str(),
 					e->sequenceNumber);
 
-			switch(e->eventType){
-			case rina::IPC_PROCESS_DIF_REGISTRATION_NOTIFICATION:
-			{
-				DOWNCAST_DECL(e, rina::IPCProcessDIFRegistrationEvent, event);
-				dif_registration_notification_handler(*event);
-			}
-			break;
-			case rina::ASSIGN_TO_DIF_REQUEST_EVENT:
-			{
-				DOWNCAST_DECL(e, rina::AssignToDIFRequestEvent, event);
-				assign_to_dif_request_handler(*event);
-			}
-			break;
-			case rina::ASSIGN_TO_DIF_RESPONSE_EVENT:
-			{
-				DOWNCAST_DECL(e, rina::AssignToDIFResponseEvent, event);
-				assign_to_dif_response_handler(*event);
-			}
-			break;
-			case rina::ALLOCATE_FLOW_REQUEST_RESULT_EVENT:
-			{
-				DOWNCAST_DECL(e, rina::AllocateFlowRequestResultEvent, event);
-				allocate_flow_request_result_handler(*event);
-			}
-			break;
-			case rina::FLOW_ALLOCATION_REQUESTED_EVENT:
-			{
-				DOWNCAST_DECL(e, rina::FlowRequestEvent, event);
-				flow_allocation_requested_handler(*event);
-			}
-			break;
-			case rina::FLOW_DEALLOCATED_EVENT:
-			{
-				DOWNCAST_DECL(e, rina::FlowDeallocatedEvent, event);
-				flow_deallocated_handler(*event);
-			}
-			break;
-			case rina::FLOW_DEALLOCATION_REQUESTED_EVENT:
-			{
-				DOWNCAST_DECL(e, rina::FlowDeallocateRequestEvent, event);
-				flow_deallocation_requested_handler(*event);
-			}
-			break;
-			case rina::ALLOCATE_FLOW_RESPONSE_EVENT:
-			{
-				DOWNCAST_DECL(e, rina::AllocateFlowResponseEvent, event);
-				allocate_flow_response_handler(*event);
-			}
-			break;
-			case rina::APPLICATION_REGISTRATION_REQUEST_EVENT:
-			{
-				DOWNCAST_DECL(e, rina::ApplicationRegistrationRequestEvent, event);
-				application_registration_request_handler(*event);
-			}
-			break;
-			case rina::APPLICATION_UNREGISTRATION_REQUEST_EVENT:
-			{
-				DOWNCAST_DECL(e, rina::ApplicationUnregistrationRequestEvent, event);
-				application_unregistration_handler(*event);
-			}
-			break;
-			case rina::ENROLL_TO_DIF_REQUEST_EVENT:
-			{
-				DOWNCAST_DECL(e, rina::EnrollToDAFRequestEvent, event);
-				enroll_to_dif_handler(*event);
-			}
-			break;
-			case rina::DISCONNECT_NEIGHBOR_REQUEST_EVENT:
-			{
-				DOWNCAST_DECL(e, rina::DisconnectNeighborRequestEvent, event);
-				disconnet_neighbor_handler(*event);
-			}
-			break;
-			case rina::IPC_PROCESS_QUERY_RIB:
-			{
-				DOWNCAST_DECL(e, rina::QueryRIBRequestEvent, event);
-				query_rib_handler(*event);
-			}
-			break;
-			case rina::IPC_PROCESS_CREATE_CONNECTION_RESPONSE:
-			{
-				DOWNCAST_DECL(e, rina::CreateConnectionResponseEvent, event);
-				create_efcp_connection_response_handler(*event);
-			}
-			break;
-			case rina::IPC_PROCESS_CREATE_CONNECTION_RESULT:
-			{
-				DOWNCAST_DECL(e, rina::CreateConnectionResultEvent, event);
-				create_efcp_connection_result_handler(*event);
-			}
-			break;
-			case rina::IPC_PROCESS_UPDATE_CONNECTION_RESPONSE:
-			{
-				DOWNCAST_DECL(e, rina::UpdateConnectionResponseEvent, event);
-				update_efcp_connection_response_handler(*event);
-			}
-			break;
-			case rina::IPC_PROCESS_DESTROY_CONNECTION_RESULT:
-			{
-				DOWNCAST_DECL(e, rina::DestroyConnectionResultEvent, event);
-				destroy_efcp_connection_result_handler(*event);
-				break;
-			}
-			case rina::IPC_PROCESS_DUMP_FT_RESPONSE:
-			{
-				DOWNCAST_DECL(e, rina::DumpFTResponseEvent, event);
-				dump_ft_response_handler(*event);
-			}
-			break;
-			case rina::IPC_PROCESS_SET_POLICY_SET_PARAM:
-			{
-				DOWNCAST_DECL(e, rina::SetPolicySetParamRequestEvent, event);
-				set_policy_set_param_handler(*event);
-			}
-			break;
-			case rina::IPC_PROCESS_SET_POLICY_SET_PARAM_RESPONSE:
-			{
-				DOWNCAST_DECL(e, rina::SetPolicySetParamResponseEvent, event);
-				set_policy_set_param_response_handler(*event);
-			}
-			break;
-			case rina::IPC_PROCESS_SELECT_POLICY_SET:
-			{
-				DOWNCAST_DECL(e, rina::SelectPolicySetRequestEvent, event);
-				select_policy_set_handler(*event);
-			}
-			break;
-			case rina::IPC_PROCESS_SELECT_POLICY_SET_RESPONSE:
-			{
-				DOWNCAST_DECL(e, rina::SelectPolicySetResponseEvent, event);
-				select_policy_set_response_handler(*event);
-			}
-			break;
-			case rina::IPC_PROCESS_PLUGIN_LOAD:
-			{
-				DOWNCAST_DECL(e, rina::PluginLoadRequestEvent, event);
-				plugin_load_handler(*event);
-			}
-			break;
-			case rina::IPC_PROCESS_UPDATE_CRYPTO_STATE_RESPONSE:
-			{
-				DOWNCAST_DECL(e, rina::UpdateCryptoStateResponseEvent, event);
-				update_crypto_state_response_handler(*event);
-			}
-			break;
-			case rina::IPC_PROCESS_FWD_CDAP_MSG:
-			{
-				DOWNCAST_DECL(e, rina::FwdCDAPMsgRequestEvent, event);
-				fwd_cdap_msg_handler(*event);
-			}
-			break;
-			case rina::APPLICATION_UNREGISTERED_EVENT:
-			{
-				DOWNCAST_DECL(e, rina::ApplicationUnregisteredEvent, event);
-				application_unregistered_handler(*event);
-			}
-			break;
-			case rina::REGISTER_APPLICATION_RESPONSE_EVENT:
-			{
-				DOWNCAST_DECL(e, rina::RegisterApplicationResponseEvent, event);
-				register_application_response_handler(*event);
-			}
-			break;
-			case rina::UNREGISTER_APPLICATION_RESPONSE_EVENT:
-			{
-				DOWNCAST_DECL(e, rina::UnregisterApplicationResponseEvent, event);
-				unregister_application_response_handler(*event);
-			}
-			break;
-			case rina::UPDATE_DIF_CONFIG_REQUEST_EVENT:
-			{
-				DOWNCAST_DECL(e, rina::UpdateDIFConfigurationRequestEvent, event);
-				update_dif_config_handler(*event);
-			}
-			break;
-			case rina::IPCM_REGISTER_APP_RESPONSE_EVENT:
-			{
-				DOWNCAST_DECL(e, rina::IpcmRegisterApplicationResponseEvent, event);
-				app_reg_response_handler(*event);
-			}
-			break;
-			case rina::IPCM_UNREGISTER_APP_RESPONSE_EVENT:
-			{
-				DOWNCAST_DECL(e, rina::IpcmUnregisterApplicationResponseEvent, event);
-				unreg_app_response_handler(*event);
-			}
-			break;
-			case rina::IPCM_ALLOCATE_FLOW_REQUEST_RESULT:
-			{
-				DOWNCAST_DECL(e, rina::IpcmAllocateFlowRequestResultEvent, event);
-				ipcm_allocate_flow_request_result_handler(*event);
-			}
-			break;
-			case rina::IPC_PROCESS_ALLOCATE_PORT_RESPONSE:
-			{
-				DOWNCAST_DECL(e, rina::AllocatePortResponseEvent, event);
-				ipcp_allocate_port_response_event_handler(*event);
-			}
-			break;
-			case rina::IPC_PROCESS_DEALLOCATE_PORT_RESPONSE:
-			{
-				DOWNCAST_DECL(e, rina::DeallocatePortResponseEvent, event);
-				ipcp_deallocate_port_response_event_handler(*event);
-			}
-			break;
-			case rina::IPC_PROCESS_WRITE_MGMT_SDU_RESPONSE:
-			{
-				DOWNCAST_DECL(e, rina::WriteMgmtSDUResponseEvent, event);
-				ipcp_write_mgmt_sdu_response_event_handler(*event);
-			}
-			break;
-			case rina::IPC_PROCESS_READ_MGMT_SDU_NOTIF:
-			{
-				DOWNCAST_DECL(e, rina::ReadMgmtSDUResponseEvent, event);
-				ipcp_read_mgmt_sdu_notif_event_handler(*event);
-			}
-			break;
-			case rina::IPCP_SCAN_MEDIA_REQUEST_EVENT:
-			{
-				DOWNCAST_DECL(e, rina::ScanMediaRequestEvent, event);
-				ipcp_scan_media_request_event_handler(*event);
-			}
-			break;
-
-			//Unsupported events (they belong to the IPC Manager)
-			case rina::APPLICATION_REGISTRATION_CANCELED_EVENT:
-			case rina::UPDATE_DIF_CONFIG_RESPONSE_EVENT:
-			case rina::ENROLL_TO_DIF_RESPONSE_EVENT:
-			case rina::GET_DIF_PROPERTIES:
-			case rina::GET_DIF_PROPERTIES_RESPONSE_EVENT:
-			case rina::QUERY_RIB_RESPONSE_EVENT:
-			case rina::IPC_PROCESS_DAEMON_INITIALIZED_EVENT:
-			case rina::TIMER_EXPIRED_EVENT:
-			case rina::IPC_PROCESS_PLUGIN_LOAD_RESPONSE:
-			case rina::IPCM_CREATE_IPCP_RESPONSE:
-			case rina::IPCM_DESTROY_IPCP_RESPONSE:
-			default:
-				break;
+			if (is_barrier_event(e->eventType)) {
+				drain_stages();
+				handle_event(e);
+				continue;
 			}
 
-			delete e;
+			stage = get_event_stage(e, key);
+			submit_to_stage(stage, new IPCPEventTask(this, e), key);
 		} catch (rina::Exception &ex) {
 			LOG_IPCP_ERR("Problems running event loop: %s", ex.what());
 		} catch (std::exception &ex1) {
@@ -357,6 +522,267 @@ void AbstractIPCProcessImpl::event_loop(void)
 			LOG_IPCP_ERR("Unhandled exception!!!");
 		}
 	}
+
+	stop_stages();
+}
+
+void AbstractIPCProcessImpl::handle_event(rina::IPCEvent * e)
+{
+	try {
+		switch(e->eventType){
+		case rina::IPC_PROCESS_DIF_REGISTRATION_NOTIFICATION:
+		{
+			DOWNCAST_DECL(e, rina::IPCProcessDIFRegistrationEvent, event);
+			dif_registration_notification_handler(*event);
+		}
+		break;
+		case rina::ASSIGN_TO_DIF_REQUEST_EVENT:
+		{
+			DOWNCAST_DECL(e, rina::AssignToDIFRequestEvent, event);
+			assign_to_dif_request_handler(*event);
+		}
+		break;
+		case rina::ASSIGN_TO_DIF_RESPONSE_EVENT:
+		{
+			DOWNCAST_DECL(e, rina::AssignToDIFResponseEvent, event);
+			assign_to_dif_response_handler(*event);
+		}
+		break;
+		case rina::ALLOCATE_FLOW_REQUEST_RESULT_EVENT:
+		{
+			DOWNCAST_DECL(e, rina::AllocateFlowRequestResultEvent, event);
+			allocate_flow_request_result_handler(*event);
+		}
+		break;
+		case rina::FLOW_ALLOCATION_REQUESTED_EVENT:
+		{
+			DOWNCAST_DECL(e, rina::FlowRequestEvent, event);
+			flow_allocation_requested_handler(*event);
+		}
+		break;
+		case rina::FLOW_DEALLOCATED_EVENT:
+		{
+			DOWNCAST_DECL(e, rina::FlowDeallocatedEvent, event);
+			flow_deallocated_handler(*event);
+		}
+		break;
+		case rina::FLOW_DEALLOCATION_REQUESTED_EVENT:
+		{
+			DOWNCAST_DECL(e, rina::FlowDeallocateRequestEvent, event);
+			flow_deallocation_requested_handler(*event);
+		}
+		break;
+		case rina::ALLOCATE_FLOW_RESPONSE_EVENT:
+		{
+			DOWNCAST_DECL(e, rina::AllocateFlowResponseEvent, event);
+			allocate_flow_response_handler(*event);
+		}
+		break;
+		case rina::APPLICATION_REGISTRATION_REQUEST_EVENT:
+		{
+			DOWNCAST_DECL(e, rina::ApplicationRegistrationRequestEvent, event);
+			application_registration_request_handler(*event);
+		}
+		break;
+		case rina::APPLICATION_UNREGISTRATION_REQUEST_EVENT:
+		{
+			DOWNCAST_DECL(e, rina::ApplicationUnregistrationRequestEvent, event);
+			application_unregistration_handler(*event);
+		}
+		break;
+		case rina::ENROLL_TO_DIF_REQUEST_EVENT:
+		{
+			DOWNCAST_DECL(e, rina::EnrollToDAFRequestEvent, event);
+			enroll_to_dif_handler(*event);
+		}
+		break;
+		case rina::DISCONNECT_NEIGHBOR_REQUEST_EVENT:
+		{
+			DOWNCAST_DECL(e, rina::DisconnectNeighborRequestEvent, event);
+			disconnet_neighbor_handler(*event);
+		}
+		break;
+		case rina::IPC_PROCESS_QUERY_RIB:
+		{
+			DOWNCAST_DECL(e, rina::QueryRIBRequestEvent, event);
+			query_rib_handler(*event);
+		}
+		break;
+		case rina::IPC_PROCESS_CREATE_CONNECTION_RESPONSE:
+		{
+			DOWNCAST_DECL(e, rina::CreateConnectionResponseEvent, event);
+			create_efcp_connection_response_handler(*event);
+		}
+		break;
+		case rina::IPC_PROCESS_CREATE_CONNECTION_RESULT:
+		{
+			DOWNCAST_DECL(e, rina::CreateConnectionResultEvent, event);
+			create_efcp_connection_result_handler(*event);
+		}
+		break;
+		case rina::IPC_PROCESS_UPDATE_CONNECTION_RESPONSE:
+		{
+			DOWNCAST_DECL(e, rina::UpdateConnectionResponseEvent, event);
+			update_efcp_connection_response_handler(*event);
+		}
+		break;
+		case rina::IPC_PROCESS_DESTROY_CONNECTION_RESULT:
+		{
+			DOWNCAST_DECL(e, rina::DestroyConnectionResultEvent, event);
+			destroy_efcp_connection_result_handler(*event);
+			break;
+		}
+		case rina::IPC_PROCESS_DUMP_FT_RESPONSE:
+		{
+			DOWNCAST_DECL(e, rina::DumpFTResponseEvent, event);
+			dump_ft_response_handler(*event);
+		}
+		break;
+		case rina::IPC_PROCESS_SET_POLICY_SET_PARAM:
+		{
+			DOWNCAST_DECL(e, rina::SetPolicySetParamRequestEvent, event);
+			set_policy_set_param_handler(*event);
+		}
+		break;
+		case rina::IPC_PROCESS_SET_POLICY_SET_PARAM_RESPONSE:
+		{
+			DOWNCAST_DECL(e, rina::SetPolicySetParamResponseEvent, event);
+			set_policy_set_param_response_handler(*event);
+		}
+		break;
+		case rina::IPC_PROCESS_SELECT_POLICY_SET:
+		{
+			DOWNCAST_DECL(e, rina::SelectPolicySetRequestEvent, event);
+			select_policy_set_handler(*event);
+		}
+		break;
+		case rina::IPC_PROCESS_SELECT_POLICY_SET_RESPONSE:
+		{
+			DOWNCAST_DECL(e, rina::SelectPolicySetResponseEvent, event);
+			select_policy_set_response_handler(*event);
+		}
+		break;
+		case rina::IPC_PROCESS_PLUGIN_LOAD:
+		{
+			DOWNCAST_DECL(e, rina::PluginLoadRequestEvent, event);
+			plugin_load_handler(*event);
+		}
+		break;
+		case rina::IPC_PROCESS_UPDATE_CRYPTO_STATE_RESPONSE:
+		{
+			DOWNCAST_DECL(e, rina::UpdateCryptoStateResponseEvent, event);
+			update_crypto_state_response_handler(*event);
+		}
+		break;
+		case rina::IPC_PROCESS_FWD_CDAP_MSG:
+		{
+			DOWNCAST_DECL(e, rina::FwdCDAPMsgRequestEvent, event);
+			fwd_cdap_msg_handler(*event);
+		}
+		break;
+		case rina::APPLICATION_UNREGISTERED_EVENT:
+		{
+			DOWNCAST_DECL(e, rina::ApplicationUnregisteredEvent, event);
+			application_unregistered_handler(*event);
+		}
+		break;
+		case rina::REGISTER_APPLICATION_RESPONSE_EVENT:
+		{
+			DOWNCAST_DECL(e, rina::RegisterApplicationResponseEvent, event);
+			register_application_response_handler(*event);
+		}
+		break;
+		case rina::UNREGISTER_APPLICATION_RESPONSE_EVENT:
+		{
+			DOWNCAST_DECL(e, rina::UnregisterApplicationResponseEvent, event);
+			unregister_application_response_handler(*event);
+		}
+		break;
+		case rina::UPDATE_DIF_CONFIG_REQUEST_EVENT:
+		{
+			DOWNCAST_DECL(e, rina::UpdateDIFConfigurationRequestEvent, event);
+			update_dif_config_handler(*event);
+		}
+		break;
+		case rina::IPCM_REGISTER_APP_RESPONSE_EVENT:
+		{
+			DOWNCAST_DECL(e, rina::IpcmRegisterApplicationResponseEvent, event);
+			app_reg_response_handler(*event);
+		}
+		break;
+		case rina::IPCM_UNREGISTER_APP_RESPONSE_EVENT:
+		{
+			DOWNCAST_DECL(e, rina::IpcmUnregisterApplicationResponseEvent, event);
+			unreg_app_response_handler(*event);
+		}
+		break;
+		case rina::IPCM_ALLOCATE_FLOW_REQUEST_RESULT:
+		{
+			DOWNCAST_DECL(e, rina::IpcmAllocateFlowRequestResultEvent, event);
+			ipcm_allocate_flow_request_result_handler(*event);
+		}
+		break;
+		case rina::IPC_PROCESS_ALLOCATE_PORT_RESPONSE:
+		{
+			DOWNCAST_DECL(e, rina::AllocatePortResponseEvent, event);
+			ipcp_allocate_port_response_event_handler(*event);
+		}
+		break;
+		case rina::IPC_PROCESS_DEALLOCATE_PORT_RESPONSE:
+		{
+			DOWNCAST_DECL(e, rina::DeallocatePortResponseEvent, event);
+			ipcp_deallocate_port_response_event_handler(*event);
+		}
+		break;
+		case rina::IPC_PROCESS_WRITE_MGMT_SDU_RESPONSE:
+		{
+			DOWNCAST_DECL(e, rina::WriteMgmtSDUResponseEvent, event);
+			ipcp_write_mgmt_sdu_response_event_handler(*event);
+		}
+		break;
+		case rina::IPC_PROCESS_READ_MGMT_SDU_NOTIF:
+		{
+			DOWNCAST_DECL(e, rina::ReadMgmtSDUResponseEvent, event);
+			ipcp_read_mgmt_sdu_notif_event_handler(*event);
+		}
+		break;
+		case rina::IPCP_SCAN_MEDIA_REQUEST_EVENT:
+		{
+			DOWNCAST_DECL(e, rina::ScanMediaRequestEvent, event);
+			ipcp_scan_media_request_event_handler(*event);
+		}
+		break;
+		case rina::IPCP_N1_PORT_LIVENESS_EVENT:
+		{
+			DOWNCAST_DECL(e, rina::NMinusOnePortLivenessEvent, event);
+			ipcp_n1_port_liveness_event_handler(*event);
+		}
+		break;
+
+		//Unsupported events (they belong to the IPC Manager)
+		case rina::APPLICATION_REGISTRATION_CANCELED_EVENT:
+		case rina::UPDATE_DIF_CONFIG_RESPONSE_EVENT:
+		case rina::ENROLL_TO_DIF_RESPONSE_EVENT:
+		case rina::GET_DIF_PROPERTIES:
+		case rina::GET_DIF_PROPERTIES_RESPONSE_EVENT:
+		case rina::QUERY_RIB_RESPONSE_EVENT:
+		case rina::IPC_PROCESS_DAEMON_INITIALIZED_EVENT:
+		case rina::TIMER_EXPIRED_EVENT:
+		case rina::IPC_PROCESS_PLUGIN_LOAD_RESPONSE:
+		case rina::IPCM_CREATE_IPCP_RESPONSE:
+		case rina::IPCM_DESTROY_IPCP_RESPONSE:
+		default:
+			break;
+		}
+	} catch (rina::Exception &ex) {
+		LOG_IPCP_ERR("Problems handling event: %s", ex.what());
+	} catch (std::exception &ex1) {
+		LOG_IPCP_ERR("Problems handling event: %s", ex1.what());
+	} catch (...) {
+		LOG_IPCP_ERR("Unhandled exception!!!");
+	}
+
+	delete e;
 }
 
 //Class LazyIPCPProcessImpl
@@ -553,6 +979,11 @@ void LazyIPCProcessImpl::ipcp_scan_media_request_event_handler(rina::ScanMediaRe
 	LOG_IPCP_WARN("Ignoring event of type %d", event.eventType);
 }
 
+void LazyIPCProcessImpl::ipcp_n1_port_liveness_event_handler(const rina::NMinusOnePortLivenessEvent& event)
+{
+	LOG_IPCP_WARN("Ignoring event of type %d", event.eventType);
+}
+
 void LazyIPCProcessImpl::sync_with_kernel(void)
 {
 	LOG_IPCP_WARN("Ignoring call to sync_with_kernel");
@@ -23,6 +23,7 @@
 #define IPCP_IPC_PROCESS_HH
 
 #include <map>
+#include <vector>
 
 #include <librina/ipc-manager.h>
 #include "ipcp/components.h"
@@ -32,6 +33,92 @@ namespace rinad {
 class IPCPFactory;
 class IPCProcessImpl;
 
+/// Number of executors of the management and flow allocation stages
+#define IPCP_STAGE_SHARDS 4
+
+/// Maximum number of tasks queued in a stage executor
+#define IPCP_STAGE_QUEUE_SIZE 1024
+
+/// Executor of one stage of the IPCP. Runs the tasks submitted to it in
+/// order, in its own thread, and keeps track of how long they wait in the
+/// queue and how long they take to run
+class IPCPStage : public rina::SimpleThread {
+public:
+	IPCPStage(const std::string& name);
+	~IPCPStage() throw();
+
+	/// Queue the task. The stage takes ownership of the task. If the
+	/// queue is full the caller waits until there is room for it,
+	/// unless it is a stage executor: waiting there could deadlock two
+	/// stages feeding each other, so the task is queued over the
+	/// capacity and counted as an overflow
+	void submit(rina::TimerTask * task);
+
+	/// Run the queued tasks and stop the executor
+	void finish();
+
+	/// Wait until the tasks queued so far have been run. Must not be
+	/// called by the executor itself
+	void drain();
+
+	int run();
+
+	const std::string& get_stage_name() const;
+	const std::string get_stats() const;
+
+private:
+	struct stage_entry {
+		rina::TimerTask * task;
+		struct timespec queued;
+	};
+
+	std::string stage_name;
+	mutable rina::BlockingFIFOQueue<stage_entry> queue;
+	bool finished;
+
+	//Tasks in the queue, and producers blocked in submit() because it
+	//was full, woken up by the executor when it takes a task
+	unsigned int queued;
+	rina::ConditionVariable space_cv;
+	int space_waiters;
+
+	//Updated by the producers
+	unsigned long submitted;
+	unsigned long full_waits;
+	unsigned long overflows;
+
+	//Threads blocked in drain(), woken up by the executor when it has
+	//run a task
+	rina::ConditionVariable drain_cv;
+	int drain_waiters;
+
+	//Updated by the executor thread, read by the RIB objects
+	unsigned long processed;
+	unsigned long queue_us_total;
+	unsigned long queue_us_max;
+	unsigned long run_us_total;
+	unsigned long run_us_max;
+};
+
+/// Exports the queue depth, latencies and full queue counters of a stage
+class IPCPStageRIBObj: public rina::rib::RIBObj {
+public:
+	IPCPStageRIBObj(IPCPStage * stage);
+	const std::string get_displayable_value() const;
+
+	const std::string& get_class() const {
+		return class_name;
+	};
+
+	const static std::string parent_class_name;
+	const static std::string parent_object_name;
+	const static std::string class_name;
+	const static std::string object_name_prefix;
+
+private:
+	IPCPStage * stage;
+};
+
 /// Base class for the implementation of the user-space components
 /// of an IPC Process. Contains the getters/setters for generic fields as
 /// well as code to deal with the events coming from the IPC Manager
@@ -46,10 +133,13 @@ public:
         virtual ~AbstractIPCProcessImpl();
         const std::string get_type() const;
 
-	//Event loop (run)
+	//Event loop (run), hands the events to the stage executors
 	void event_loop(void);
 	bool keep_running;
 
+	//Handle an event, called by the stage executors
+	void handle_event(rina::IPCEvent * e);
+
 	//Event handlers to be implemented by each particular IPCP
         virtual void dif_registration_notification_handler(const rina::IPCProcessDIFRegistrationEvent& event) = 0;
         virtual void assign_to_dif_request_handler(const rina::AssignToDIFRequestEvent& event) = 0;
@@ -88,6 +178,7 @@ public:
         virtual void ipcp_write_mgmt_sdu_response_event_handler(const rina::WriteMgmtSDUResponseEvent& event) = 0;
         virtual void ipcp_read_mgmt_sdu_notif_event_handler(rina::ReadMgmtSDUResponseEvent& event) = 0;
         virtual void ipcp_scan_media_request_event_handler(rina::ScanMediaRequestEvent& event) = 0;
+        virtual void ipcp_n1_port_liveness_event_handler(const rina::NMinusOnePortLivenessEvent& event) = 0;
         // Cause relevant IPCP components to sync with information
         // exported by the kernel via sysfs
         virtual void sync_with_kernel() = 0;
@@ -103,6 +194,32 @@ protected:
         rina::Lockable * lock_;
 	rina::DIFInformation dif_information_;
 	std::string type;
+
+	//Queue the task in the executor of a stage. Tasks with the same
+	//key are run by the same executor, in the order they are queued
+	void submit_to_stage(ipcp_stage_t stage, rina::TimerTask * task,
+			     unsigned int key = 0);
+	void stop_stages(void);
+	void drain_stages(void);
+
+	//Stage and key of an event: the (N-1) port-id it refers to, or
+	//the key of the flow allocation it belongs to
+	ipcp_stage_t get_event_stage(rina::IPCEvent * e, unsigned int& key);
+
+	//Port-id a response that only carries the sequence number of its
+	//request refers to, -1 if unknown
+	virtual int get_response_port(rina::IPCEvent * e) { return -1; };
+
+	//Key of the local flow allocation a flow allocator event refers
+	//to, false if it does not belong to one
+	virtual bool get_allocation_key(rina::IPCEvent * e, int port_id,
+					unsigned int& key) { return false; };
+
+	//Events that reconfigure the components the stages use, handled
+	//once the stages have run the events received before them
+	static bool is_barrier_event(rina::IPCEventType type);
+
+	std::vector<IPCPStage *> stages[IPCP_STAGE_MAX];
 };
 
 /// An IPC Process that does nothing regardless of the event that
@@ -156,6 +273,7 @@ public:
         virtual void ipcp_write_mgmt_sdu_response_event_handler(const rina::WriteMgmtSDUResponseEvent& event);
         virtual void ipcp_read_mgmt_sdu_notif_event_handler(rina::ReadMgmtSDUResponseEvent& event);
         virtual void ipcp_scan_media_request_event_handler(rina::ScanMediaRequestEvent& event);
+        virtual void ipcp_n1_port_liveness_event_handler(const rina::NMinusOnePortLivenessEvent& event);
 	virtual void sync_with_kernel(void);
 };
 
@@ -200,6 +318,7 @@ public:
         unsigned int get_active_address();
         void activate_new_address(void);
         bool check_address_is_mine(unsigned int address);
+        void execute_task(ipcp_stage_t stage, rina::TimerTask * task);
         void eventHappened(rina::InternalEvent * event);
         unsigned int getAdressByname(const rina::ApplicationProcessNamingInformation& name);
         int dispatchSelectPolicySet(const std::string& path,
@@ -236,11 +355,18 @@ public:
         void ipcp_deallocate_port_response_event_handler(const rina::DeallocatePortResponseEvent& event);
         void ipcp_write_mgmt_sdu_response_event_handler(const rina::WriteMgmtSDUResponseEvent& event);
         void ipcp_read_mgmt_sdu_notif_event_handler(rina::ReadMgmtSDUResponseEvent& event);
+        void ipcp_n1_port_liveness_event_handler(const rina::NMinusOnePortLivenessEvent& event);
         void sync_with_kernel(void);
 
+protected:
+        int get_response_port(rina::IPCEvent * e);
+        bool get_allocation_key(rina::IPCEvent * e, int port_id,
+                                unsigned int& key);
+
 private:
         void subscribeToEvents();
         void addressChange(rina::AddressChangeEvent * event);
+        void populate_stages_rib(void);
 
         KernelSyncTrigger * kernel_sync;
         unsigned int old_address;
@@ -20,6 +20,7 @@
 // MA  02110-1301  USA
 //
 
+#include <algorithm>
 #include <assert.h>
 #include <sstream>
 
@@ -159,15 +160,36 @@ void DFTEntryRIBObj::read(const rina::cdap_rib::con_handle_t &con,
 // Class DirectoryForwardingTableEntry Set RIB Object
 const std::string DFTRIBObj::class_name = "DirectoryForwardingTable";
 const std::string DFTRIBObj::object_name = "/difm/nsm/dft";
+const std::string DFTRIBObj::snapshot_section = "dft";
 
-DFTRIBObj::DFTRIBObj(IPCProcess * ipc_process):
+DFTRIBObj::DFTRIBObj(IPCProcess * ipc_process,
+		     NamespaceManager * nsm,
+		     dft_propagation_stats * stats):
 		IPCPRIBObj(ipc_process, class_name)
 {
-	namespace_manager_ = ipc_process_->namespace_manager_;
+	namespace_manager_ = nsm;
+	stats_ = stats;
 	ipc_process->internal_event_manager_->subscribeToEvent(rina::InternalEvent::APP_CONNECTIVITY_TO_NEIGHBOR_LOST,
 							       this);
 }
 
+const std::string DFTRIBObj::get_displayable_value() const
+{
+	std::stringstream ss;
+	ss << "Updates sent: " << stats_->updates_sent
+	   << "; Entries sent: " << stats_->entries_sent
+	   << "; Bytes sent: " << stats_->bytes_sent << std::endl;
+	ss << "Updates received: " << stats_->updates_received
+	   << "; Entries received: " << stats_->entries_received
+	   << "; Stale entries dropped: " << stats_->stale_dropped << std::endl;
+	ss << "Digests sent: " << stats_->digests_sent
+	   << "; Digest mismatches: " << stats_->digest_mismatches
+	   << "; Full syncs sent: " << stats_->full_syncs_sent
+	   << "; Full syncs received: " << stats_->full_syncs_received;
+
+	return ss.str();
+}
+
 void DFTRIBObj::eventHappened(rina::InternalEvent * event)
 {
 	if (event->type != rina::InternalEvent::APP_CONNECTIVITY_TO_NEIGHBOR_LOST)
@@ -198,12 +220,7 @@ void DFTRIBObj::checkDFTEntriesToRemove(unsigned int address,
 	}
 
 	//2 If not, remove entries
-	std::list<rina::DirectoryForwardingTableEntry> entries = namespace_manager_->getDFTEntries();
-	std::list<rina::DirectoryForwardingTableEntry>::const_iterator iterator;
-	for (iterator = entries.begin(); iterator != entries.end(); ++iterator) {
-		if (iterator->get_address() == address)
-			entriesToDelete.push_back(iterator->getKey());
-	}
+	entriesToDelete = namespace_manager_->getDFTEntryKeys(address);
 
 	if (entriesToDelete.size() == 0)
 		return;
@@ -229,34 +246,148 @@ void DFTRIBObj::create(const rina::cdap_rib::con_handle_t &con_handle,
 		       rina::cdap_rib::res_info_t& res)
 {
 	rina::ScopedLock g(lock);
+	encoders::DFTDeltaEncoder encoder;
+	encoders::DFTDelta delta;
+
+	encoder.decode(obj_req, delta);
+	applyUpdate(delta, con_handle.port_id);
+}
+
+void DFTRIBObj::read(const rina::cdap_rib::con_handle_t &con,
+		     const std::string& fqn,
+		     const std::string& class_,
+		     const rina::cdap_rib::filt_info_t &filt,
+		     const int invoke_id,
+		     rina::cdap_rib::obj_info_t &obj_reply,
+		     rina::cdap_rib::res_info_t& res)
+{
+	encoders::DFTDeltaEncoder encoder;
+	encoders::DFTDelta delta;
+
+	delta.added = namespace_manager_->getDFTEntries();
+	delta.removed = namespace_manager_->getDFTTombstones();
+	delta.has_digest = true;
+	delta.digest = namespace_manager_->getDFTDigest();
+	encoder.encode(delta, obj_reply.value_);
+	__atomic_add_fetch(&stats_->full_syncs_sent, 1, __ATOMIC_RELAXED);
+
+	res.code_ = rina::cdap_rib::CDAP_SUCCESS;
+}
+
+void DFTRIBObj::remoteReadResult(const rina::cdap_rib::con_handle_t &con,
+				 const rina::cdap_rib::obj_info_t &obj,
+				 const rina::cdap_rib::res_info_t &res,
+				 const rina::cdap_rib::flags_t & flags)
+{
+	rina::ScopedLock g(lock);
+	encoders::DFTDeltaEncoder encoder;
+	encoders::DFTDelta delta;
 
-	std::list<rina::DirectoryForwardingTableEntry> entriesToCreateOrUpdate;
+	if (res.code_ != rina::cdap_rib::CDAP_SUCCESS) {
+		LOG_IPCP_WARN("Could not read the DFT of the neighbor at port-id %d",
+			      con.port_id);
+		return;
+	}
+
+	try {
+		encoder.decode(obj.value_, delta);
+	} catch (rina::Exception &e) {
+		LOG_IPCP_ERR("Problems decoding DFT: %s", e.what());
+		return;
+	}
+
+	__atomic_add_fetch(&stats_->full_syncs_received, 1, __ATOMIC_RELAXED);
+
+	//Only merge the entries, the digest of a full copy does not trigger
+	//another read
+	delta.has_digest = false;
+	applyUpdate(delta, con.port_id);
+}
+
+void DFTRIBObj::get_snapshot(int port_id, rina::ser_obj_t& result)
+{
+	encoders::DFTDeltaEncoder encoder;
+	encoders::DFTDelta delta;
+
+	delta.added = namespace_manager_->getDFTEntries();
+	encoder.encode(delta, result);
+	__atomic_add_fetch(&stats_->full_syncs_sent, 1, __ATOMIC_RELAXED);
+}
+
+void DFTRIBObj::apply_snapshot(int port_id, const rina::ser_obj_t& snapshot)
+{
+	rina::ScopedLock g(lock);
+	encoders::DFTDeltaEncoder encoder;
+	encoders::DFTDelta delta;
+
+	encoder.decode(snapshot, delta);
+	__atomic_add_fetch(&stats_->full_syncs_received, 1, __ATOMIC_RELAXED);
+	applyUpdate(delta, port_id);
+}
+
+void DFTRIBObj::applyUpdate(const encoders::DFTDelta& delta, int port_id)
+{
 	std::list<rina::DirectoryForwardingTableEntry> entriesToCreate;
 	std::list<rina::DirectoryForwardingTableEntry> entriesToUpdate;
-	rina::DirectoryForwardingTableEntry * entry;
-	encoders::DFTEListEncoder encoder;
+	std::list<rina::DirectoryForwardingTableEntry>::const_iterator it;
+	std::list<int> exc_neighs;
+	unsigned int stale = 0;
 
-	//1 Decode list of names
-	encoder.decode(obj_req, entriesToCreateOrUpdate);
+	__atomic_add_fetch(&stats_->updates_received, 1, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&stats_->entries_received,
+			   delta.added.size() + delta.removed.size(),
+			   __ATOMIC_RELAXED);
 
-	//2 Iterate list and create or update entries
-	std::list<rina::DirectoryForwardingTableEntry>::iterator it;
-	for (it = entriesToCreateOrUpdate.begin(); it != entriesToCreateOrUpdate.end(); ++it) {
-		entry = namespace_manager_->getDFTEntry(it->getKey());
-		if (!entry) {
-			entriesToCreate.push_back(*it);
-		} else if (it->seqnum_ > entry->seqnum_){
-			entry->address_ = it->address_;
-			entry->seqnum_ = it->seqnum_;
+	if (delta.added.empty() && delta.removed.empty()) {
+		if (!delta.has_digest ||
+				delta.digest == namespace_manager_->getDFTDigest())
+			return;
+
+		//Our DFT differs from the one of the neighbor, read it
+		__atomic_add_fetch(&stats_->digest_mismatches, 1, __ATOMIC_RELAXED);
+		LOG_IPCP_DBG("DFT digest mismatch with neighbor at port-id %d, reading its DFT",
+			     port_id);
+
+		rina::cdap_rib::con_handle_t con;
+		rina::cdap_rib::obj_info_t obj;
+		rina::cdap_rib::flags_t flags;
+		rina::cdap_rib::filt_info_t filt;
+		con.port_id = port_id;
+		obj.class_ = class_name;
+		obj.name_ = object_name;
+		try {
+			ipc_process_->rib_daemon_->getProxy()->remote_read(con,
+									   obj,
+									   flags,
+									   filt,
+									   this);
+		} catch (rina::Exception &e) {
+			LOG_IPCP_WARN("Problems sending read CDAP message: %s",
+				      e.what());
+		}
+
+		return;
+	}
+
+	//Create or update the entries, unless ours are newer or we have
+	//removed them since
+	for (it = delta.added.begin(); it != delta.added.end(); ++it) {
+		if (!namespace_manager_->getDFTEntry(it->getKey())) {
+			if (namespace_manager_->isDFTEntryRemoved(*it))
+				stale++;
+			else
+				entriesToCreate.push_back(*it);
+		} else if (namespace_manager_->updateDFTEntry(*it)) {
 			LOG_IPCP_INFO("Updated application %s IPCP address to %d",
 				       it->getKey().c_str(),
 				       it->address_);
 			entriesToUpdate.push_back(*it);
+		} else {
+			stale++;
 		}
 	}
 
-	std::list<int> exc_neighs;
-	exc_neighs.push_back(con_handle.port_id);
+	exc_neighs.push_back(port_id);
 
 	if (entriesToCreate.size() > 0) {
 		namespace_manager_->addDFTEntries(entriesToCreate,
@@ -268,6 +399,13 @@ void DFTRIBObj::create(const rina::cdap_rib::con_handle_t &con_handle,
 		namespace_manager_->notify_neighbors_add(entriesToUpdate,
 							 exc_neighs);
 	}
+
+	if (delta.removed.size() > 0)
+		stale += namespace_manager_->removeDFTEntries(delta.removed,
+							      exc_neighs);
+
+	if (stale > 0)
+		__atomic_add_fetch(&stats_->stale_dropped, stale, __ATOMIC_RELAXED);
 }
 
 //Class AddressChangeTimerTask
@@ -286,15 +424,151 @@ void AddressChangeTimerTask::run()
 						  old_address);
 }
 
+//Class PropagateDFTChangesTimerTask
+PropagateDFTChangesTimerTask::PropagateDFTChangesTimerTask(NamespaceManager * nsm)
+{
+	namespace_manager = nsm;
+}
+
+void PropagateDFTChangesTimerTask::run()
+{
+	namespace_manager->propagateDFTChanges();
+}
+
+//Class DFTDigestTimerTask
+DFTDigestTimerTask::DFTDigestTimerTask(NamespaceManager * nsm)
+{
+	namespace_manager = nsm;
+}
+
+void DFTDigestTimerTask::run()
+{
+	namespace_manager->sendDFTDigest();
+}
+
+/// FNV-1a hash of the contents of an entry, the digest of the DFT is
+/// the XOR of the hashes of all its entries
+static unsigned long long dft_entry_hash(const rina::DirectoryForwardingTableEntry& entry)
+{
+	unsigned long long hash = 14695981039346656037ULL;
+	std::stringstream ss;
+	std::string value;
+
+	ss << entry.getKey() << "|" << entry.address_ << "|" << entry.seqnum_;
+	value = ss.str();
+	for (std::string::size_type i = 0; i < value.size(); i++) {
+		hash ^= (unsigned char) value[i];
+		hash *= 1099511628211ULL;
+	}
+
+	return hash;
+}
+
+//Class DFTIndex
+void DFTIndex::addEntry(rina::DirectoryForwardingTableEntry * entry)
+{
+	by_process_[entry->ap_naming_info_.processName].entries.push_back(entry);
+	by_address_[entry->address_].insert(entry->getKey());
+}
+
+void DFTIndex::removeEntry(rina::DirectoryForwardingTableEntry * entry)
+{
+	std::map<std::string, daf_members>::iterator pit;
+	std::map<unsigned int, std::set<std::string> >::iterator ait;
+	std::vector<rina::DirectoryForwardingTableEntry *>::iterator eit;
+
+	pit = by_process_.find(entry->ap_naming_info_.processName);
+	if (pit != by_process_.end()) {
+		eit = std::find(pit->second.entries.begin(),
+				pit->second.entries.end(),
+				entry);
+		if (eit != pit->second.entries.end())
+			pit->second.entries.erase(eit);
+
+		if (pit->second.entries.empty())
+			by_process_.erase(pit);
+		else if (pit->second.next >= pit->second.entries.size())
+			pit->second.next = 0;
+	}
+
+	ait = by_address_.find(entry->address_);
+	if (ait != by_address_.end()) {
+		ait->second.erase(entry->getKey());
+		if (ait->second.empty())
+			by_address_.erase(ait);
+	}
+}
+
+void DFTIndex::setEntryAddress(rina::DirectoryForwardingTableEntry * entry,
+			       unsigned int address)
+{
+	std::map<unsigned int, std::set<std::string> >::iterator ait;
+
+	if (entry->address_ == address)
+		return;
+
+	ait = by_address_.find(entry->address_);
+	if (ait != by_address_.end()) {
+		ait->second.erase(entry->getKey());
+		if (ait->second.empty())
+			by_address_.erase(ait);
+	}
+
+	entry->address_ = address;
+	by_address_[address].insert(entry->getKey());
+}
+
+rina::DirectoryForwardingTableEntry * DFTIndex::getNextMember(const std::string& process_name,
+							      unsigned int excluded_address)
+{
+	std::map<std::string, daf_members>::iterator it;
+	rina::DirectoryForwardingTableEntry * member;
+	unsigned int num_members;
+	unsigned int index;
+
+	it = by_process_.find(process_name);
+	if (it == by_process_.end())
+		return 0;
+
+	num_members = it->second.entries.size();
+	for (unsigned int i = 0; i < num_members; i++) {
+		index = (it->second.next + i) % num_members;
+		member = it->second.entries[index];
+		if (member->address_ == excluded_address)
+			continue;
+
+		it->second.next = (index + 1) % num_members;
+		return member;
+	}
+
+	return 0;
+}
+
+std::list<std::string> DFTIndex::getKeys(unsigned int address) const
+{
+	std::map<unsigned int, std::set<std::string> >::const_iterator it;
+
+	it = by_address_.find(address);
+	if (it == by_address_.end())
+		return std::list<std::string>();
+
+	return std::list<std::string>(it->second.begin(), it->second.end());
+}
+
 //Class Namespace Manager
 NamespaceManager::NamespaceManager() : INamespaceManager()
 {
 	rib_daemon_ = 0;
 	event_manager_ = 0;
+	dft_flush_scheduled_ = false;
+	dft_digest_ = 0;
 }
 
 NamespaceManager::~NamespaceManager()
 {
+	if (ipcp && ipcp->enrollment_task_)
+		ipcp->enrollment_task_->remove_snapshot_section(DFTRIBObj::snapshot_section);
+
 	delete ps;
 }
 
@@ -315,6 +589,8 @@ void NamespaceManager::set_application_process(rina::ApplicationProcess * ap)
 	event_manager_ = ipcp->internal_event_manager_;
 	subscribeToEvents();
 	populateRIB();
+
+	timer.scheduleTask(new DFTDigestTimerTask(this), DFT_DIGEST_PERIOD);
 }
 
 void NamespaceManager::set_dif_configuration(const rina::DIFInformation& dif_information)
@@ -340,8 +616,12 @@ void NamespaceManager::populateRIB()
 		tmp = new WhateverCastNamesRIBObj(ipcp);
 		rib_daemon_->addObjRIB(WhateverCastNamesRIBObj::object_name, &tmp);
 
-		tmp = new DFTRIBObj(ipcp);
+		DFTRIBObj * dft_obj = new DFTRIBObj(ipcp, this, &dft_stats_);
+		tmp = dft_obj;
 		rib_daemon_->addObjRIB(DFTRIBObj::object_name, &tmp);
+		if (ipcp->enrollment_task_)
+			ipcp->enrollment_task_->add_snapshot_section(DFTRIBObj::snapshot_section,
+								     dft_obj);
 	} catch (rina::Exception &e) {
 		LOG_ERR("Problems adding object to the RIB : %s", e.what());
 	}
@@ -375,36 +655,217 @@ void NamespaceManager::addressChange(rina::AddressChangeEvent * event)
 void NamespaceManager::addressChangeUpdateDFT(unsigned int new_address,
 			    	    	      unsigned int old_address)
 {
-	std::list<rina::DirectoryForwardingTableEntry> mod_entries;
 	rina::DirectoryForwardingTableEntry * entry;
-	std::vector<int> session_ids;
+	std::list<std::string> keys;
+	std::list<int> exc_neighs;
 
 	rina::ScopedLock g(lock);
 
-	std::list<std::string> keys = dft_.getKeys();
+	//Only the entries pointing to the old address are visited
+	keys = dft_index_.getKeys(old_address);
+
 	for(std::list<std::string>::iterator it = keys.begin();
 			it != keys.end(); ++it) {
 		entry = dft_.find(*it);
-		if (entry->address_ == old_address) {
-			entry->address_ = new_address;
-			entry->seqnum_ = entry->seqnum_ + 1;
-			mod_entries.push_back(*entry);
+		if (!entry)
+			continue;
+
+		setDFTEntryAddress(entry, new_address, entry->seqnum_ + 1);
+		queueDFTChange(*entry, false, exc_neighs);
+	}
+}
+
+void NamespaceManager::indexDFTEntry(rina::DirectoryForwardingTableEntry * entry)
+{
+	dft_index_.addEntry(entry);
+	dft_digest_ ^= dft_entry_hash(*entry);
+}
+
+void NamespaceManager::unindexDFTEntry(rina::DirectoryForwardingTableEntry * entry)
+{
+	dft_index_.removeEntry(entry);
+	dft_digest_ ^= dft_entry_hash(*entry);
+}
+
+void NamespaceManager::setDFTEntryAddress(rina::DirectoryForwardingTableEntry * entry,
+					  unsigned int address,
+					  unsigned int seqnum)
+{
+	if (entry->address_ == address && entry->seqnum_ == seqnum)
+		return;
+
+	dft_digest_ ^= dft_entry_hash(*entry);
+	dft_index_.setEntryAddress(entry, address);
+	entry->seqnum_ = seqnum;
+	dft_digest_ ^= dft_entry_hash(*entry);
+}
+
+void NamespaceManager::queueDFTChange(const rina::DirectoryForwardingTableEntry& entry,
+				      bool removed,
+				      const std::list<int>& neighs_to_exclude)
+{
+	std::map<std::list<int>, dft_pending_changes>::iterator it;
+	std::list<int> group = neighs_to_exclude;
+	const std::string key = entry.getKey();
+
+	group.sort();
+
+	//Only the latest change of an entry is propagated
+	for (it = dft_changes_.begin(); it != dft_changes_.end(); ++it) {
+		it->second.added.erase(key);
+		it->second.removed.erase(key);
+	}
+
+	if (removed)
+		dft_changes_[group].removed[key] = entry;
+	else
+		dft_changes_[group].added[key] = entry;
+
+	if (dft_flush_scheduled_)
+		return;
+
+	dft_flush_scheduled_ = true;
+	timer.scheduleTask(new PropagateDFTChangesTimerTask(this),
+			   DFT_PROPAGATION_DELAY);
+}
+
+void NamespaceManager::propagateDFTChanges()
+{
+	std::map<std::list<int>, dft_pending_changes> changes;
+	std::map<std::list<int>, dft_pending_changes>::iterator it;
+	std::map<std::string, rina::DirectoryForwardingTableEntry>::iterator eit;
+	encoders::DFTDelta delta;
+
+	lock.lock();
+	changes.swap(dft_changes_);
+	dft_flush_scheduled_ = false;
+	lock.unlock();
+
+	for (it = changes.begin(); it != changes.end(); ++it) {
+		for (eit = it->second.added.begin();
+				eit != it->second.added.end(); ++eit) {
+			delta.added.push_back(eit->second);
+			if (delta.added.size() + delta.removed.size() >=
+					DFT_MAX_ENTRIES_PER_UPDATE) {
+				sendDFTUpdate(delta, it->first);
+				delta = encoders::DFTDelta();
+			}
+		}
+
+		for (eit = it->second.removed.begin();
+				eit != it->second.removed.end(); ++eit) {
+			delta.removed.push_back(eit->second);
+			if (delta.added.size() + delta.removed.size() >=
+					DFT_MAX_ENTRIES_PER_UPDATE) {
+				sendDFTUpdate(delta, it->first);
+				delta = encoders::DFTDelta();
+			}
+		}
+
+		if (delta.added.size() + delta.removed.size() > 0) {
+			sendDFTUpdate(delta, it->first);
+			delta = encoders::DFTDelta();
 		}
 	}
+}
+
+void NamespaceManager::sendDFTDigest()
+{
+	encoders::DFTDelta delta;
+	std::list<int> exc_neighs;
+	unsigned int sent;
+
+	delta.has_digest = true;
+	delta.digest = getDFTDigest();
+	sent = sendDFTUpdate(delta, exc_neighs);
 
-	if (mod_entries.size() == 0)
+	lock.lock();
+	expireDFTTombstones();
+	lock.unlock();
+	__atomic_add_fetch(&dft_stats_.digests_sent, sent, __ATOMIC_RELAXED);
+
+	timer.scheduleTask(new DFTDigestTimerTask(this), DFT_DIGEST_PERIOD);
+}
+
+unsigned long long NamespaceManager::getDFTDigest()
+{
+	rina::ScopedLock g(lock);
+
+	return dft_digest_;
+}
+
+std::list<rina::DirectoryForwardingTableEntry> NamespaceManager::getDFTTombstones()
+{
+	std::list<rina::DirectoryForwardingTableEntry> result;
+	std::map<std::string, dft_tombstone>::iterator it;
+
+	rina::ScopedLock g(lock);
+
+	for (it = dft_tombstones_.begin(); it != dft_tombstones_.end(); ++it)
+		result.push_back(it->second.entry);
+
+	return result;
+}
+
+bool NamespaceManager::isDFTEntryRemoved(const rina::DirectoryForwardingTableEntry& entry)
+{
+	std::map<std::string, dft_tombstone>::iterator it;
+
+	rina::ScopedLock g(lock);
+
+	it = dft_tombstones_.find(entry.getKey());
+
+	return it != dft_tombstones_.end() &&
+			entry.seqnum_ < it->second.entry.seqnum_;
+}
+
+void NamespaceManager::addDFTTombstone(const rina::DirectoryForwardingTableEntry& entry)
+{
+	std::map<std::string, dft_tombstone>::iterator it;
+
+	//The same removal received again does not extend its lifetime
+	it = dft_tombstones_.find(entry.getKey());
+	if (it != dft_tombstones_.end() &&
+			it->second.entry.seqnum_ >= entry.seqnum_)
 		return;
 
-	rina::cdap::getProvider()->get_session_manager()->getAllCDAPSessionIds(session_ids);
-	encoders::DFTEListEncoder encoder;
+	dft_tombstone& tombstone = dft_tombstones_[entry.getKey()];
+	tombstone.entry = entry;
+	tombstone.periods = DFT_TOMBSTONE_PERIODS;
+}
+
+void NamespaceManager::expireDFTTombstones()
+{
+	std::map<std::string, dft_tombstone>::iterator it;
+
+	for (it = dft_tombstones_.begin(); it != dft_tombstones_.end();) {
+		if (--it->second.periods == 0)
+			dft_tombstones_.erase(it++);
+		else
+			++it;
+	}
+}
+
+unsigned int NamespaceManager::sendDFTUpdate(const encoders::DFTDelta& delta,
+					     const std::list<int>& neighs_to_exclude)
+{
+	std::vector<int> session_ids;
+	encoders::DFTDeltaEncoder encoder;
 	rina::cdap_rib::obj_info_t obj;
-	obj.class_ = DFTRIBObj::class_name;
-	obj.name_ = DFTRIBObj::object_name;
-	encoder.encode(mod_entries, obj.value_);
 	rina::cdap_rib::flags_t flags;
 	rina::cdap_rib::filt_info_t filt;
 	rina::cdap_rib::con_handle_t con;
-	for (int i = 0; i < session_ids.size(); i++) {
+	unsigned int sent = 0;
+
+	rina::cdap::getProvider()->get_session_manager()->getAllCDAPSessionIds(session_ids);
+	obj.class_ = DFTRIBObj::class_name;
+	obj.name_ = DFTRIBObj::object_name;
+	encoder.encode(delta, obj.value_);
+
+	for (unsigned int i = 0; i < session_ids.size(); i++) {
+		if (contains_entry(session_ids[i], neighs_to_exclude))
+			continue;
+
 		try {
 			con.port_id = session_ids[i];
 			ipcp->rib_daemon_->getProxy()->remote_create(con,
@@ -412,19 +873,30 @@ void NamespaceManager::addressChangeUpdateDFT(unsigned int new_address,
 								     flags,
 								     filt,
 								     NULL);
+			sent++;
 		} catch (rina::Exception &e) {
 			LOG_WARN("Problems sending create CDAP message: %s",
 					e.what());
 		}
 	}
+
+	if (sent == 0)
+		return 0;
+
+	__atomic_add_fetch(&dft_stats_.updates_sent, sent, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&dft_stats_.entries_sent,
+			   sent * (delta.added.size() + delta.removed.size()),
+			   __ATOMIC_RELAXED);
+	__atomic_add_fetch(&dft_stats_.bytes_sent,
+			   sent * obj.value_.size_,
+			   __ATOMIC_RELAXED);
+
+	return sent;
 }
 
 unsigned int NamespaceManager::getDFTNextHop(rina::ApplicationProcessNamingInformation& apNamingInfo)
 {
 	rina::DirectoryForwardingTableEntry * nextHop = 0;
-	std::list<rina::DirectoryForwardingTableEntry *> entries;
-	std::list<rina::DirectoryForwardingTableEntry *>::iterator it;
-	unsigned int my_address = 0;
 
 	rina::ScopedLock g(lock);
 
@@ -437,18 +909,15 @@ unsigned int NamespaceManager::getDFTNextHop(rina::ApplicationProcessNamingInfor
 	if (apNamingInfo.processInstance == "" &&
 			apNamingInfo.entityName == "" &&
 			apNamingInfo.entityInstance == "") {
-		//Searching for a DAF name
-		my_address = ipcp->get_active_address();
-		entries = dft_.getEntries();
-		for (it = entries.begin(); it != entries.end(); ++it) {
-			if ((*it)->ap_naming_info_.processName == apNamingInfo.processName &&
-					(*it)->address_ != my_address) {
-				apNamingInfo.processInstance = (*it)->ap_naming_info_.processInstance;
-				return (*it)->address_;
-			}
-		}
-
-		return 0;
+		//Searching for a DAF name, the members are selected in
+		//round robin
+		nextHop = dft_index_.getNextMember(apNamingInfo.processName,
+						   ipcp->get_active_address());
+		if (!nextHop)
+			return 0;
+
+		apNamingInfo.processInstance = nextHop->ap_naming_info_.processInstance;
+		return nextHop->address_;
 	}
 
 	return 0;
@@ -460,6 +929,7 @@ void NamespaceManager::addDFTEntries(const std::list<rina::DirectoryForwardingTa
 {
 	rina::ScopedLock g(lock);
 	rina::DirectoryForwardingTableEntry * entry;
+	std::map<std::string, dft_tombstone>::iterator tit;
 
 	std::list<rina::DirectoryForwardingTableEntry>::const_iterator it;
 	for (it = entries.begin(); it != entries.end(); ++it) {
@@ -471,6 +941,16 @@ void NamespaceManager::addDFTEntries(const std::list<rina::DirectoryForwardingTa
 		entry->ap_naming_info_ = it->ap_naming_info_;
 		entry->seqnum_ = it->seqnum_;
 
+		//Our entries must be newer than their last removal, or
+		//the neighbors that remember it would drop them
+		tit = dft_tombstones_.find(it->getKey());
+		if (tit != dft_tombstones_.end()) {
+			if (ipcp->check_address_is_mine(entry->address_) &&
+					entry->seqnum_ <= tit->second.entry.seqnum_)
+				entry->seqnum_ = tit->second.entry.seqnum_ + 1;
+			dft_tombstones_.erase(tit);
+		}
+
 		try {
 			std::stringstream ss;
 			ss << DFTEntryRIBObj::object_name_prefix
@@ -484,43 +964,23 @@ void NamespaceManager::addDFTEntries(const std::list<rina::DirectoryForwardingTa
 		}
 
 		dft_.put(entry->getKey(), entry);
+		indexDFTEntry(entry);
 		LOG_IPCP_DBG("Added entry to DFT: %s",
 			     entry->toString().c_str());
-	}
 
-	notify_neighbors_add(entries, neighs_to_exclude);
+		if (notify_neighs)
+			queueDFTChange(*entry, false, neighs_to_exclude);
+	}
 }
 
 void NamespaceManager::notify_neighbors_add(const std::list<rina::DirectoryForwardingTableEntry>& entries,
 		          	  	    std::list<int>& neighs_to_exclude)
 {
-	std::vector<int> session_ids;
-	rina::cdap::getProvider()->get_session_manager()->getAllCDAPSessionIds(session_ids);
-	encoders::DFTEListEncoder encoder;
-	rina::cdap_rib::obj_info_t obj;
-	obj.class_ = DFTRIBObj::class_name;
-	obj.name_ = DFTRIBObj::object_name;
-	encoder.encode(entries, obj.value_);
-	rina::cdap_rib::flags_t flags;
-	rina::cdap_rib::filt_info_t filt;
-	rina::cdap_rib::con_handle_t con;
-	for (int i = 0; i < session_ids.size(); i++) {
-		if (contains_entry(session_ids[i],
-				neighs_to_exclude))
-			continue;
+	rina::ScopedLock g(lock);
 
-		try {
-			con.port_id = session_ids[i];
-			ipcp->rib_daemon_->getProxy()->remote_create(con,
-								     obj,
-								     flags,
-								     filt,
-								     NULL);
-		} catch (rina::Exception &e) {
-			LOG_WARN("Problems sending create CDAP message: %s",
-					e.what());
-		}
-	}
+	std::list<rina::DirectoryForwardingTableEntry>::const_iterator it;
+	for (it = entries.begin(); it != entries.end(); ++it)
+		queueDFTChange(*it, false, neighs_to_exclude);
 }
 
 rina::DirectoryForwardingTableEntry * NamespaceManager::getDFTEntry(const std::string& key)
@@ -533,29 +993,128 @@ std::list<rina::DirectoryForwardingTableEntry> NamespaceManager::getDFTEntries()
 	return dft_.getCopyofentries();
 }
 
+bool NamespaceManager::updateDFTEntry(const rina::DirectoryForwardingTableEntry& update)
+{
+	rina::ScopedLock g(lock);
+	rina::DirectoryForwardingTableEntry * entry;
+
+	entry = dft_.find(update.getKey());
+	if (!entry || update.seqnum_ <= entry->seqnum_)
+		return false;
+
+	setDFTEntryAddress(entry, update.address_, update.seqnum_);
+
+	return true;
+}
+
+std::list<std::string> NamespaceManager::getDFTEntryKeys(unsigned int address)
+{
+	rina::ScopedLock g(lock);
+
+	return dft_index_.getKeys(address);
+}
+
 void NamespaceManager::removeDFTEntry(const std::string& key,
 			 	      bool notify_neighs,
 			 	      bool remove_from_rib,
 			 	      std::list<int>& neighs_to_exclude)
 {
 	rina::ScopedLock g(lock);
-	std::string obj_name;
 
-	rina::DirectoryForwardingTableEntry * entry = dft_.erase(key);
+	rina::DirectoryForwardingTableEntry * entry = dft_.find(key);
 	if (!entry) {
 		LOG_IPCP_WARN("Could not find DFT for key: %s",
 			      key.c_str());
 		return;
 	}
 
-	std::stringstream ss;
-	ss << DFTEntryRIBObj::object_name_prefix
-	   << key;
-	obj_name = ss.str();
+	if (notify_neighs)
+		queueDFTChange(*entry, true, neighs_to_exclude);
+
+	eraseDFTEntry(entry, remove_from_rib);
+}
+
+void NamespaceManager::unregisterDFTEntry(const std::string& key)
+{
+	rina::ScopedLock g(lock);
+	rina::DirectoryForwardingTableEntry removal;
+	std::list<int> exc_neighs;
+
+	rina::DirectoryForwardingTableEntry * entry = dft_.find(key);
+	if (!entry) {
+		LOG_IPCP_WARN("Could not find DFT for key: %s",
+			      key.c_str());
+		return;
+	}
+
+	//The removal is newer than the entry, so that the neighbors drop
+	//the copies of the entry they receive later
+	removal = *entry;
+	removal.seqnum_++;
+	addDFTTombstone(removal);
+	queueDFTChange(removal, true, exc_neighs);
+
+	eraseDFTEntry(entry, true);
+}
+
+unsigned int NamespaceManager::removeDFTEntries(const std::list<rina::DirectoryForwardingTableEntry>& entries,
+						std::list<int>& neighs_to_exclude)
+{
+	rina::ScopedLock g(lock);
+	rina::DirectoryForwardingTableEntry * entry;
+	unsigned int stale = 0;
+
+	std::list<rina::DirectoryForwardingTableEntry>::const_iterator it;
+	for (it = entries.begin(); it != entries.end(); ++it) {
+		//Our entries are only removed by us
+		if (ipcp->check_address_is_mine(it->address_)) {
+			stale++;
+			continue;
+		}
+
+		entry = dft_.find(it->getKey());
+		if (!entry) {
+			//Drop the entry if an older copy arrives later
+			addDFTTombstone(*it);
+			continue;
+		}
+
+		//The entry has been updated after the neighbor removed it
+		if (ipcp->check_address_is_mine(entry->address_) ||
+				entry->seqnum_ > it->seqnum_) {
+			stale++;
+			continue;
+		}
+
+		//Only the owner unregistering the entry makes the removal
+		//newer than the entry. Removals because a neighbor was lost
+		//are not remembered, the owner advertises the entry again
+		//with the same sequence number when it comes back
+		if (it->seqnum_ > entry->seqnum_)
+			addDFTTombstone(*it);
+
+		queueDFTChange(*it, true, neighs_to_exclude);
+		eraseDFTEntry(entry, true);
+	}
+
+	return stale;
+}
+
+void NamespaceManager::eraseDFTEntry(rina::DirectoryForwardingTableEntry * entry,
+				     bool remove_from_rib)
+{
+	const std::string key = entry->getKey();
+
+	dft_.erase(key);
+	unindexDFTEntry(entry);
 
 	if (remove_from_rib) {
+		std::stringstream ss;
+		ss << DFTEntryRIBObj::object_name_prefix
+		   << key;
+
 		try {
-			rib_daemon_->removeObjRIB(obj_name);
+			rib_daemon_->removeObjRIB(ss.str());
 		} catch (rina::Exception &e){
 			LOG_IPCP_ERR("Error removing object from RIB %s",
 					e.what());
@@ -565,32 +1124,6 @@ void NamespaceManager::removeDFTEntry(const std::string& key,
 	LOG_IPCP_DBG("Removed entry from DFT: %s",
 		     entry->toString().c_str());
 
-	std::vector<int> session_ids;
-	rina::cdap::getProvider()->get_session_manager()->getAllCDAPSessionIds(session_ids);
-	rina::cdap_rib::obj_info_t obj;
-	obj.class_ = DFTEntryRIBObj::class_name;
-	obj.name_ = obj_name;
-	rina::cdap_rib::flags_t flags;
-	rina::cdap_rib::filt_info_t filt;
-	rina::cdap_rib::con_handle_t con;
-	for (int i = 0; i < session_ids.size(); i++) {
-		if (contains_entry(session_ids[i],
-				   neighs_to_exclude))
-			continue;
-
-		try {
-			con.port_id = session_ids[i];
-			ipcp->rib_daemon_->getProxy()->remote_delete(con,
-								     obj,
-								     flags,
-								     filt,
-								     NULL);
-		} catch (rina::Exception &e) {
-			LOG_WARN("Problems sending delete CDAP message: %s",
-					e.what());
-		}
-	}
-
 	delete entry;
 }
 
@@ -787,7 +1320,6 @@ void NamespaceManager::processApplicationUnregistrationRequestEvent(
 {
 	rina::ApplicationRegistrationInformation * unregisteredApp = 0;
 	rina::ApplicationProcessNamingInformation dafToUnregister;
-	std::list<int> exc_neighs;
 	int result = 0;
 
 	unregisteredApp = registrations_.erase(event.applicationName.getEncodedString());
@@ -808,19 +1340,13 @@ void NamespaceManager::processApplicationUnregistrationRequestEvent(
 		return;
 	}
 
-	removeDFTEntry(unregisteredApp->appName.getEncodedString(),
-		       true,
-		       true,
-		       exc_neighs);
+	unregisterDFTEntry(unregisteredApp->appName.getEncodedString());
 
 	if (unregisteredApp->dafName.processName != "") {
 		//Remove DFT entry corresponding to DAF name
 		dafToUnregister.processName = unregisteredApp->dafName.processName;
 		dafToUnregister.processInstance = unregisteredApp->appName.processName;
-		removeDFTEntry(dafToUnregister.getEncodedString(),
-			       true,
-			       true,
-			       exc_neighs);
+		unregisterDFTEntry(dafToUnregister.getEncodedString());
 	}
 
 	delete unregisteredApp;
@@ -23,6 +23,10 @@
 #ifndef IPCP_NAMESPACE_MANAGER_HH
 #define IPCP_NAMESPACE_MANAGER_HH
 
+#include <map>
+#include <set>
+#include <vector>
+
 #include <librina/ipc-process.h>
 #include <librina/internal-events.h>
 
@@ -31,6 +35,23 @@
 
 namespace rinad {
 
+namespace encoders {
+struct DFTDelta;
+}
+
+/// Time the changes of the DFT are held, to be propagated together (ms)
+#define DFT_PROPAGATION_DELAY 100
+
+/// Maximum number of entries in a DFT update
+#define DFT_MAX_ENTRIES_PER_UPDATE 500
+
+/// Period of the announcements of the DFT digest to the neighbors (ms)
+#define DFT_DIGEST_PERIOD 30000
+
+/// Number of digest periods a removed entry is remembered, so that a full
+/// sync with a neighbor that missed the removal does not bring it back
+#define DFT_TOMBSTONE_PERIODS 3
+
 class WhateverCastNameRIBObj: public rina::rib::RIBObj {
 public:
 	WhateverCastNameRIBObj(rina::WhatevercastName* name);
@@ -112,18 +133,83 @@ private:
 	INamespaceManager * nsm;
 };
 
-class DFTRIBObj: public IPCPRIBObj, public rina::InternalEventListener {
+/// Counters of the propagation of the DFT, updated with atomic operations
+struct dft_propagation_stats {
+	dft_propagation_stats() : updates_sent(0), entries_sent(0),
+		bytes_sent(0), updates_received(0), entries_received(0),
+		stale_dropped(0), digests_sent(0), digest_mismatches(0),
+		full_syncs_sent(0), full_syncs_received(0) { };
+
+	unsigned long updates_sent;
+	unsigned long entries_sent;
+	unsigned long bytes_sent;
+	unsigned long updates_received;
+	unsigned long entries_received;
+	unsigned long stale_dropped;
+	unsigned long digests_sent;
+	unsigned long digest_mismatches;
+	unsigned long full_syncs_sent;
+	unsigned long full_syncs_received;
+};
+
+/// Indexes of the directory forwarding table by process name, to look
+/// DAF names up, and by address. It does not own the entries, and it is
+/// protected by the lock of the namespace manager
+class DFTIndex {
 public:
-	DFTRIBObj(IPCProcess * ipc_process);
+	void addEntry(rina::DirectoryForwardingTableEntry * entry);
+	void removeEntry(rina::DirectoryForwardingTableEntry * entry);
+
+	/// Change the address of an indexed entry
+	void setEntryAddress(rina::DirectoryForwardingTableEntry * entry,
+			     unsigned int address);
+
+	/// The next member of a DAF (round robin) that is not at the
+	/// excluded address, 0 if there is none
+	rina::DirectoryForwardingTableEntry * getNextMember(const std::string& process_name,
+							     unsigned int excluded_address);
+
+	/// The keys of the entries pointing to an address
+	std::list<std::string> getKeys(unsigned int address) const;
+
+private:
+	/// The members of a DAF in the directory forwarding table
+	struct daf_members {
+		daf_members() : next(0) { };
+
+		std::vector<rina::DirectoryForwardingTableEntry *> entries;
+
+		/// The member to try first in the next lookup (round robin)
+		unsigned int next;
+	};
+
+	std::map<std::string, daf_members> by_process_;
+
+	/// Keys of the entries, by address
+	std::map<unsigned int, std::set<std::string> > by_address_;
+};
+
+class NamespaceManager;
+class DFTRIBObj: public IPCPRIBObj, public rina::InternalEventListener,
+		 public rina::rib::RIBOpsRespHandler,
+		 public IEnrollmentSnapshotSection {
+public:
+	DFTRIBObj(IPCProcess * ipc_process,
+		  NamespaceManager * nsm,
+		  dft_propagation_stats * stats);
 
 	/// Called when the connectivity to a neighbor has been lost. All the
 	/// applications registered from that neighbor have to be removed from the directory
 	void eventHappened(rina::InternalEvent * event);
 
-	/// A routing update with new and/or updated entries has been received -or
-	/// during enrollment-. See what parts of the update we didn't now, and tell the
-	/// RIB Daemon about them (will create/update the objects and notify my neighbors
-	/// except for the one that has sent me the update)
+	/// A routing update with new, updated and/or removed entries has been
+	/// received -or during enrollment-. See what parts of the update we didn't
+	/// now, and tell the RIB Daemon about them (will create/update/remove the
+	/// objects and notify my neighbors except for the one that has sent me the
+	/// update). Entries that are not newer than the ones in the DFT are dropped.
+	/// An update without entries announces the digest of the DFT of the
+	/// neighbor: if it is different from ours, a full copy of the DFT of the
+	/// neighbor is read.
 	void create(const rina::cdap_rib::con_handle_t &con,
 		    const std::string& fqn,
 		    const std::string& class_,
@@ -133,6 +219,33 @@ public:
 		    rina::ser_obj_t &obj_reply,
 		    rina::cdap_rib::res_info_t& res);
 
+	/// A neighbor reads the full DFT when its digest does not match ours.
+	/// The entries removed recently are sent as removals
+	void read(const rina::cdap_rib::con_handle_t &con,
+		  const std::string& fqn,
+		  const std::string& class_,
+		  const rina::cdap_rib::filt_info_t &filt,
+		  const int invoke_id,
+		  rina::cdap_rib::obj_info_t &obj_reply,
+		  rina::cdap_rib::res_info_t& res);
+
+	/// The full DFT of a neighbor, merged as an update
+	void remoteReadResult(const rina::cdap_rib::con_handle_t &con,
+			      const rina::cdap_rib::obj_info_t &obj,
+			      const rina::cdap_rib::res_info_t &res,
+			      const rina::cdap_rib::flags_t & flags);
+
+	/// The full DFT, sent to a new member in the enrollment snapshot.
+	/// The recent removals are not sent: the new member may own some
+	/// of the entries, and the removals it missed reach it with the
+	/// full DFT read when the digests differ
+	void get_snapshot(int port_id, rina::ser_obj_t& result);
+
+	/// The full DFT of the enroller, merged as an update
+	void apply_snapshot(int port_id, const rina::ser_obj_t& snapshot);
+
+	const std::string get_displayable_value() const;
+
 	const std::string& get_class() const {
 		return class_name;
 	};
@@ -142,11 +255,15 @@ public:
 
 	const static std::string class_name;
 	const static std::string object_name;
+	const static std::string snapshot_section;
 
 private:
+	void applyUpdate(const encoders::DFTDelta& delta, int port_id);
+
 	rina::Lockable lock;
 	rina::Timer timer;
-	INamespaceManager * namespace_manager_;
+	NamespaceManager * namespace_manager_;
+	dft_propagation_stats * stats_;
 };
 
 class AddressChangeTimerTask: public rina::TimerTask {
@@ -165,6 +282,32 @@ public:
 	unsigned int old_address;
 };
 
+class PropagateDFTChangesTimerTask: public rina::TimerTask {
+public:
+	PropagateDFTChangesTimerTask(NamespaceManager * nsm);
+	~PropagateDFTChangesTimerTask() throw() {};
+	void run();
+	std::string name() const {
+		return "propagate-dft-changes";
+	}
+
+private:
+	NamespaceManager * namespace_manager;
+};
+
+class DFTDigestTimerTask: public rina::TimerTask {
+public:
+	DFTDigestTimerTask(NamespaceManager * nsm);
+	~DFTDigestTimerTask() throw() {};
+	void run();
+	std::string name() const {
+		return "dft-digest";
+	}
+
+private:
+	NamespaceManager * namespace_manager;
+};
+
 class NamespaceManager: public INamespaceManager, public rina::InternalEventListener {
 public:
 	NamespaceManager();
@@ -178,6 +321,8 @@ public:
 			   std::list<int>& neighs_to_exclude);
 	rina::DirectoryForwardingTableEntry * getDFTEntry(const std::string& key);
 	std::list<rina::DirectoryForwardingTableEntry> getDFTEntries();
+	bool updateDFTEntry(const rina::DirectoryForwardingTableEntry& entry);
+	std::list<std::string> getDFTEntryKeys(unsigned int address);
 	void removeDFTEntry(const std::string& key,
 			    bool notify_neighs,
 			    bool remove_from_rib,
@@ -196,15 +341,73 @@ public:
 	void remove_whatevercast_name(const std::string& name_key);
 	void addressChangeUpdateDFT(unsigned int new_address,
 				    unsigned int old_address);
+	/// Queue new or updated entries to be propagated to the neighbors,
+	/// the queued changes are sent in batches
 	void notify_neighbors_add(const std::list<rina::DirectoryForwardingTableEntry>& entries,
 			          std::list<int>& neighs_to_exclude);
 
+	/// Remove the entries removed by a neighbor, unless our copy is newer
+	/// or they are ours. Returns the number of removals dropped
+	unsigned int removeDFTEntries(const std::list<rina::DirectoryForwardingTableEntry>& entries,
+				      std::list<int>& neighs_to_exclude);
+
+	/// Send the queued changes of the DFT to the neighbors
+	void propagateDFTChanges();
+
+	/// Announce the digest of the DFT to the neighbors
+	void sendDFTDigest();
+
+	/// Order independent digest of the entries of the DFT
+	unsigned long long getDFTDigest();
+
+	/// The entries removed recently, sent with the full DFT
+	std::list<rina::DirectoryForwardingTableEntry> getDFTTombstones();
+
+	/// True if the entry is older than a removal of it remembered
+	bool isDFTEntryRemoved(const rina::DirectoryForwardingTableEntry& entry);
+
+	/// Send an update to all neighbors but the excluded ones, returns
+	/// the number of neighbors it has been sent to
+	unsigned int sendDFTUpdate(const encoders::DFTDelta& delta,
+				   const std::list<int>& neighs_to_exclude);
+
 private:
+	/// Changes of the DFT waiting to be propagated
+	struct dft_pending_changes {
+		std::map<std::string, rina::DirectoryForwardingTableEntry> added;
+		std::map<std::string, rina::DirectoryForwardingTableEntry> removed;
+	};
+
+	/// An entry removed from the DFT, and the digest periods it is
+	/// still remembered for
+	struct dft_tombstone {
+		rina::DirectoryForwardingTableEntry entry;
+		unsigned int periods;
+	};
+
 	rina::Lockable lock;
 
 	/// The directory forwarding table
 	rina::ThreadSafeMapOfPointers<std::string, rina::DirectoryForwardingTableEntry> dft_;
 
+	/// Indexes of the DFT by process name and by address. Protected
+	/// by lock
+	DFTIndex dft_index_;
+
+	/// Changes waiting to be propagated, by the (sorted) list of
+	/// neighbors they must not be sent to
+	std::map<std::list<int>, dft_pending_changes> dft_changes_;
+
+	/// A PropagateDFTChangesTimerTask is scheduled
+	bool dft_flush_scheduled_;
+
+	unsigned long long dft_digest_;
+
+	/// Entries removed recently, by key. Protected by lock
+	std::map<std::string, dft_tombstone> dft_tombstones_;
+
+	dft_propagation_stats dft_stats_;
+
 	/// Applications registered in this IPC Process
 	rina::ThreadSafeMapOfPointers<std::string, rina::ApplicationRegistrationInformation> registrations_;
 
@@ -224,6 +427,22 @@ private:
 			int result);
 
 	bool contains_entry(int candidate, const std::list<int>& elements);
+
+	void indexDFTEntry(rina::DirectoryForwardingTableEntry * entry);
+	void unindexDFTEntry(rina::DirectoryForwardingTableEntry * entry);
+	void setDFTEntryAddress(rina::DirectoryForwardingTableEntry * entry,
+				unsigned int address,
+				unsigned int seqnum);
+	void queueDFTChange(const rina::DirectoryForwardingTableEntry& entry,
+			    bool removed,
+			    const std::list<int>& neighs_to_exclude);
+	void eraseDFTEntry(rina::DirectoryForwardingTableEntry * entry,
+			   bool remove_from_rib);
+	/// Remove the entry of an application unregistered from this IPCP,
+	/// remembering the removal
+	void unregisterDFTEntry(const std::string& key);
+	void addDFTTombstone(const rina::DirectoryForwardingTableEntry& entry);
+	void expireDFTTombstones();
 };
 
 class CheckDFTEntriesToRemoveTimerTask : public rina::TimerTask {
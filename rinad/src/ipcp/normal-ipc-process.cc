@@ -133,6 +133,7 @@ IPCProcessImpl::IPCProcessImpl(const rina::ApplicationProcessNamingInformation&
         add_entity(security_manager_);
 
         subscribeToEvents();
+        populate_stages_rib();
 
         try {
                 rina::ApplicationProcessNamingInformation naming_info(name_, instance_);
@@ -169,6 +170,59 @@ IPCProcessImpl::~IPCProcessImpl()
 	delete dynamic_cast<EnrollmentTask*>(enrollment_task_);
 }
 
+void IPCProcessImpl::populate_stages_rib(void)
+{
+	rina::rib::RIBObj* tmp;
+	std::stringstream ss;
+
+	try {
+		tmp = new rina::rib::RIBObj(IPCPStageRIBObj::parent_class_name);
+		rib_daemon_->addObjRIB(IPCPStageRIBObj::parent_object_name, &tmp);
+
+		for (int i = 0; i < IPCP_STAGE_MAX; i++) {
+			for (unsigned int j = 0; j < stages[i].size(); j++) {
+				ss.str(std::string());
+				ss << IPCPStageRIBObj::object_name_prefix
+				   << stages[i][j]->get_stage_name();
+				tmp = new IPCPStageRIBObj(stages[i][j]);
+				rib_daemon_->addObjRIB(ss.str(), &tmp);
+			}
+		}
+	} catch (rina::Exception &e) {
+		LOG_IPCP_ERR("Problems adding object to the RIB : %s", e.what());
+	}
+}
+
+void IPCProcessImpl::execute_task(ipcp_stage_t stage, rina::TimerTask * task)
+{
+	submit_to_stage(stage, task);
+}
+
+int IPCProcessImpl::get_response_port(rina::IPCEvent * e)
+{
+	switch(e->eventType) {
+	case rina::ALLOCATE_FLOW_RESPONSE_EVENT:
+		return flow_allocator_->getAllocateResponsePort(e->sequenceNumber);
+	case rina::IPC_PROCESS_WRITE_MGMT_SDU_RESPONSE:
+		return rib_daemon_->take_mgmt_sdu_write_port(e->sequenceNumber);
+	default:
+		return -1;
+	}
+}
+
+bool IPCProcessImpl::get_allocation_key(rina::IPCEvent * e, int port_id,
+					unsigned int& key)
+{
+	if (e->eventType == rina::IPC_PROCESS_ALLOCATE_PORT_RESPONSE)
+		return flow_allocator_->getPortAllocationKey(e->sequenceNumber,
+							     key);
+
+	if (port_id < 0)
+		return false;
+
+	return flow_allocator_->getAllocationKey(port_id, key);
+}
+
 void IPCProcessImpl::subscribeToEvents()
 {
 	internal_event_manager_->subscribeToEvent(rina::InternalEvent::ADDRESS_CHANGE,
@@ -793,5 +847,35 @@ void IPCProcessImpl::ipcp_read_mgmt_sdu_notif_event_handler(rina::ReadMgmtSDURes
 	rib_daemon_->processReadManagementSDUEvent(event);
 }
 
+void IPCProcessImpl::ipcp_n1_port_liveness_event_handler(const rina::NMinusOnePortLivenessEvent& event)
+{
+	std::list<rina::Neighbor> neighbors;
+	std::list<rina::Neighbor>::iterator it;
+
+	if (event.alive) {
+		LOG_IPCP_INFO("N-1 port %u is receiving PDUs again",
+			      event.port_id);
+		return;
+	}
+
+	// The kernel already took the port out of the PFF, tear down the
+	// adjacency the same way the watchdog would
+	neighbors = enrollment_task_->get_neighbors();
+	for (it = neighbors.begin(); it != neighbors.end(); ++it) {
+		if (it->underlying_port_id_ != (int) event.port_id)
+			continue;
+
+		LOG_IPCP_WARN("Neighbor %s declared dead by the keepalive monitor of N-1 port %u",
+			      it->name_.getProcessNamePlusInstance().c_str(),
+			      event.port_id);
+		internal_event_manager_->deliverEvent(
+				new rina::NeighborDeclaredDeadEvent(*it));
+		return;
+	}
+
+	LOG_IPCP_DBG("No neighbor reachable through dead N-1 port %u",
+		     event.port_id);
+}
+
 
 } //namespace rinad
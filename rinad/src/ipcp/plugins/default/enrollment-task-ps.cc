@@ -24,7 +24,13 @@
 #include "../../ipcp-logging.h"
 #include <string>
 #include <climits>
+#include <cstring>
+#include <vector>
 #include <assert.h>
+#include <time.h>
+#ifdef HAVE_LIBZ
+#include <zlib.h>
+#endif
 
 #include "ipcp/ipc-process.h"
 #include "ipcp/enrollment-task.h"
@@ -34,6 +40,76 @@
 
 namespace rinad {
 
+/// Size of the pieces the enrollment snapshot is sent in, below the
+/// maximum size of the layer management SDUs
+static const unsigned int SNAPSHOT_CHUNK_SIZE = 8000;
+
+/// Duration of the enrollments and size of the enrollment snapshots
+struct enrollment_stats {
+	enrollment_stats() : enrollee_enrollments(0), enroller_enrollments(0),
+		last_duration_ms(0), total_duration_ms(0), snapshots_sent(0),
+		snapshot_chunks_sent(0), snapshot_bytes_sent(0),
+		snapshots_received(0), snapshot_chunks_received(0),
+		snapshot_bytes_received(0), snapshot_image_bytes(0),
+		last_apply_ms(0), snapshot_version(0) { };
+
+	// Enrollments completed as enrollee/enroller
+	unsigned long enrollee_enrollments;
+	unsigned long enroller_enrollments;
+
+	// Duration of the enrollments as enrollee, from the
+	// M_CONNECT to the end of the enrollment
+	long last_duration_ms;
+	long total_duration_ms;
+
+	// Enrollment snapshots sent, and their (maybe compressed) size
+	unsigned long snapshots_sent;
+	unsigned long snapshot_chunks_sent;
+	unsigned long snapshot_bytes_sent;
+
+	// Enrollment snapshots received and applied
+	unsigned long snapshots_received;
+	unsigned long snapshot_chunks_received;
+	unsigned long snapshot_bytes_received;
+	unsigned long snapshot_image_bytes;
+	long last_apply_ms;
+
+	// Version of the last snapshot sent
+	unsigned long long snapshot_version;
+};
+
+static long enr_now_ms()
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+/// Receives the pieces of the enrollment snapshot sent by the enroller
+class EnrollmentSnapshotRIBObject: public IPCPRIBObj {
+public:
+	EnrollmentSnapshotRIBObject(IPCProcess * ipc_process);
+	const std::string& get_class() const {
+		return class_name;
+	};
+
+	void create(const rina::cdap_rib::con_handle_t &con,
+		    const std::string& fqn,
+		    const std::string& class_,
+		    const rina::cdap_rib::filt_info_t &filt,
+		    const int invoke_id,
+		    const rina::ser_obj_t &obj_req,
+		    rina::ser_obj_t &obj_reply,
+		    rina::cdap_rib::res_info_t& res);
+
+	const static std::string class_name;
+	const static std::string object_name;
+
+private:
+	IPCPEnrollmentTask * enrollment_task_;
+};
+
 /// The base class that contains the common aspects of both
 /// enrollment state machines: the enroller side and the enrolle
 /// side
@@ -79,17 +155,26 @@ protected:
 				   const rina::ApplicationProcessNamingInformation& remote_naming_info,
 				   int timeout,
 				   const rina::ApplicationProcessNamingInformation& supporting_dif_name,
-				   rina::Timer * timer);
+				   rina::Timer * timer,
+				   enrollment_stats * stats);
+
+	/// Sends all the DIF dynamic information, in a snapshot for the
+	/// sections of the RIB the remote IPC Process can get in one
+	void sendDIFDynamicInformation(const configs::EnrollmentInformationRequest& eiRequest);
 
-	/// Sends all the DIF dynamic information
-	void sendDIFDynamicInformation();
+	/// Send the entries in the DFT (if any), or only the ones of this
+	/// IPC Process if the neighbor has the rest
+	void sendDFTEntries(bool local_only = false);
 
-	/// Send the entries in the DFT (if any)
-	void sendDFTEntries();
+	/// Send the sections of the RIB requested by the remote IPC Process
+	/// in a versioned snapshot, compressed if possible and split into
+	/// pieces. Returns true if the DFT is part of the snapshot
+	bool sendSnapshot(const configs::EnrollmentInformationRequest& eiRequest);
 
 	IPCProcess * ipc_process_;
 	IPCPSecurityManager * sec_man_;
 	std::string token;
+	enrollment_stats * stats_;
 };
 
 //Class BaseEnrollmentStateMachine
@@ -159,12 +244,14 @@ BaseEnrollmentStateMachine::BaseEnrollmentStateMachine(IPCProcess * ipc_process,
 						       const rina::ApplicationProcessNamingInformation& remote_naming_info,
 						       int timeout,
 						       const rina::ApplicationProcessNamingInformation& supporting_dif_name,
-						       rina::Timer * timer) :
+						       rina::Timer * timer,
+						       enrollment_stats * stats) :
 				IEnrollmentStateMachine(ipc_process, remote_naming_info,
 						timeout, supporting_dif_name, timer)
 {
 	ipc_process_ = ipc_process;
 	sec_man_ = ipc_process->security_manager_;
+	stats_ = stats;
 }
 
 void BaseEnrollmentStateMachine::operational_status_start(int invoke_id,
@@ -172,20 +259,34 @@ void BaseEnrollmentStateMachine::operational_status_start(int invoke_id,
 {
 }
 
-void BaseEnrollmentStateMachine::sendDIFDynamicInformation()
+void BaseEnrollmentStateMachine::sendDIFDynamicInformation(const configs::EnrollmentInformationRequest& eiRequest)
 {
-	//Send DirectoryForwardingTableEntries
-	sendDFTEntries();
+	//Send the snapshot, or DirectoryForwardingTableEntries if the
+	//DFT is not part of it
+	if (!sendSnapshot(eiRequest))
+		sendDFTEntries();
 
 	//Send neighbors (including myself)
 	sendNeighbors();
 }
 
-void BaseEnrollmentStateMachine::sendDFTEntries()
+void BaseEnrollmentStateMachine::sendDFTEntries(bool local_only)
 {
 	std::list<rina::DirectoryForwardingTableEntry> dftEntries =
 			ipc_process_->namespace_manager_->getDFTEntries();
 
+	if (local_only) {
+		std::list<rina::DirectoryForwardingTableEntry>::iterator it;
+		unsigned int address = ipc_process_->get_address();
+
+		for (it = dftEntries.begin(); it != dftEntries.end();) {
+			if (it->address_ != address)
+				it = dftEntries.erase(it);
+			else
+				++it;
+		}
+	}
+
 	if (dftEntries.size() == 0) {
 		LOG_IPCP_DBG("No DFT entries to be sent");
 		return;
@@ -211,14 +312,115 @@ void BaseEnrollmentStateMachine::sendDFTEntries()
 	}
 }
 
+bool BaseEnrollmentStateMachine::sendSnapshot(const configs::EnrollmentInformationRequest& eiRequest)
+{
+	encoders::EnrollmentSnapshotEncoder encoder;
+	encoders::EnrollmentSnapshotChunkEncoder chunk_encoder;
+	encoders::EnrollmentSnapshot snapshot;
+	encoders::EnrollmentSnapshotChunk chunk;
+	std::list<std::string>::const_iterator it;
+	rina::ser_obj_t image;
+	std::string data;
+
+	for (it = eiRequest.snapshot_sections_.begin();
+			it != eiRequest.snapshot_sections_.end(); ++it) {
+		rina::ser_obj_t section;
+
+		try {
+			if (!enrollment_task_->get_snapshot_section(*it,
+								    con.port_id,
+								    section))
+				continue;
+		} catch (rina::Exception &e) {
+			LOG_IPCP_ERR("Problems getting section %s of the snapshot: %s",
+				     it->c_str(), e.what());
+			continue;
+		}
+
+		snapshot.sections[*it] = std::string((const char *) section.message_,
+						     section.size_);
+	}
+
+	if (snapshot.sections.empty())
+		return false;
+
+	snapshot.version = __atomic_add_fetch(&stats_->snapshot_version, 1,
+					      __ATOMIC_RELAXED);
+	encoder.encode(snapshot, image);
+
+	chunk.version = snapshot.version;
+	chunk.image_size = image.size_;
+#ifdef HAVE_LIBZ
+	if (eiRequest.snapshot_compression_) {
+		uLongf size = compressBound(image.size_);
+		std::vector<Bytef> buffer(size);
+
+		if (compress2(&buffer[0], &size, image.message_, image.size_,
+			      Z_BEST_SPEED) == Z_OK && size < (uLongf) image.size_) {
+			chunk.compressed = true;
+			data.assign((const char *) &buffer[0], size);
+		}
+	}
+#endif
+	if (!chunk.compressed)
+		data.assign((const char *) image.message_, image.size_);
+
+	chunk.count = (data.size() + SNAPSHOT_CHUNK_SIZE - 1) / SNAPSHOT_CHUNK_SIZE;
+	for (chunk.index = 0; chunk.index < chunk.count; chunk.index++) {
+		rina::cdap_rib::obj_info_t obj;
+		rina::cdap_rib::flags_t flags;
+		rina::cdap_rib::filt_info_t filt;
+
+		obj.class_ = EnrollmentSnapshotRIBObject::class_name;
+		obj.name_ = EnrollmentSnapshotRIBObject::object_name;
+		chunk.data = data.substr(chunk.index * SNAPSHOT_CHUNK_SIZE,
+					 SNAPSHOT_CHUNK_SIZE);
+		try {
+			chunk_encoder.encode(chunk, obj.value_);
+			rib_daemon_->getProxy()->remote_create(con,
+							       obj,
+							       flags,
+							       filt,
+							       NULL);
+		} catch (rina::Exception &e) {
+			LOG_IPCP_ERR("Problems sending the enrollment snapshot: %s",
+				     e.what());
+			return false;
+		}
+	}
+
+	//Only now the neighbor can skip the usual dumps of the sections
+	std::list<std::string> names;
+	std::map<std::string, std::string>::const_iterator sit;
+	for (sit = snapshot.sections.begin(); sit != snapshot.sections.end(); ++sit)
+		names.push_back(sit->first);
+	enrollment_task_->snapshot_sections_sent(names, con.port_id);
+
+	__atomic_add_fetch(&stats_->snapshots_sent, 1, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&stats_->snapshot_chunks_sent, chunk.count,
+			   __ATOMIC_RELAXED);
+	__atomic_add_fetch(&stats_->snapshot_bytes_sent, data.size(),
+			   __ATOMIC_RELAXED);
+
+	LOG_IPCP_DBG("Sent enrollment snapshot %llu with %d sections: %d bytes, %d compressed, in %u pieces",
+		     snapshot.version, (int) snapshot.sections.size(), image.size_,
+		     (int) data.size(), chunk.count);
+
+	return snapshot.sections.count(DFTRIBObj::snapshot_section) > 0;
+}
+
 /// Handles the operations related to the "daf.management.enrollment" objects
 class EnrollmentRIBObject: public IPCPRIBObj {
 public:
-	EnrollmentRIBObject(IPCProcess * ipc_process);
+	EnrollmentRIBObject(IPCProcess * ipc_process,
+			    const enrollment_stats * stats);
 	const std::string& get_class() const {
 		return class_name;
 	};
 
+	/// Duration of the enrollments and size of the enrollment snapshots
+	const std::string get_displayable_value() const;
+
 	void start(const rina::cdap_rib::con_handle_t &con,
 		   const std::string& fqn,
 		   const std::string& class_,
@@ -244,6 +446,7 @@ private:
 	void sendErrorMessage(unsigned int port_id);
 
 	IPCPEnrollmentTask * enrollment_task_;
+	const enrollment_stats * stats_;
 };
 
 /// The state machine of the party that wants to
@@ -253,7 +456,8 @@ public:
 	EnrolleeStateMachine(IPCProcess * ipc_process,
 			    const rina::ApplicationProcessNamingInformation& remote_naming_info,
 			    int timeout,
-			    rina::Timer * timer);
+			    rina::Timer * timer,
+			    enrollment_stats * stats);
 	~EnrolleeStateMachine() { };
 
 	/// Called by the DIFMembersSetObject to initiate the enrollment sequence
@@ -303,7 +507,16 @@ public:
 					   int fd,
 					   const std::string& result_reason);
 
+	/// A piece of the enrollment snapshot has been received, the
+	/// snapshot is applied when all the pieces are there
+	void snapshotChunkReceived(const encoders::EnrollmentSnapshotChunk& chunk,
+				   const rina::cdap_rib::con_handle_t &con);
+
 private:
+	/// Decompress and decode the reassembled snapshot, and apply all
+	/// its sections. Returns false if any of them could not be applied
+	bool applySnapshot(bool compressed, unsigned int image_size);
+
 	/// See if more information is required for enrollment, or if we can
 	/// start or if we have to wait for the start message
 	void requestMoreInformationOrStart();
@@ -324,22 +537,38 @@ private:
 	bool allowed_to_start_early_;
 	int stop_request_invoke_id_;
 	int start_request_invoke_id;
+
+	/// Reassembly of the enrollment snapshot
+	unsigned long long snapshot_version_;
+	unsigned int snapshot_next_chunk_;
+	std::string snapshot_image_;
+
+	/// The DFT has been received in the enrollment snapshot
+	bool dft_from_snapshot_;
+
+	long enroll_start_ms_;
 };
 
 // Class EnrolleeStateMachine
 EnrolleeStateMachine::EnrolleeStateMachine(IPCProcess * ipc_process,
 					   const rina::ApplicationProcessNamingInformation& remote_naming_info,
-					   int timeout, rina::Timer * timer):
+					   int timeout, rina::Timer * timer,
+					   enrollment_stats * stats):
 		BaseEnrollmentStateMachine(ipc_process,
 					   remote_naming_info,
 					   timeout,
-					   rina::ApplicationProcessNamingInformation(), timer)
+					   rina::ApplicationProcessNamingInformation(), timer,
+					   stats)
 {
 	was_dif_member_before_enrollment_ = false;
 	last_scheduled_task_ = 0;
 	allowed_to_start_early_ = false;
 	stop_request_invoke_id_ = 0;
 	start_request_invoke_id = 0;
+	snapshot_version_ = 0;
+	snapshot_next_chunk_ = 0;
+	dft_from_snapshot_ = false;
+	enroll_start_ms_ = enr_now_ms();
 }
 
 void EnrolleeStateMachine::initiateEnrollment(const rina::EnrollmentRequest& enrollmentRequest,
@@ -347,6 +576,7 @@ void EnrolleeStateMachine::initiateEnrollment(const rina::EnrollmentRequest& enr
 {
 	rina::ScopedLock g(lock_);
 
+	enroll_start_ms_ = enr_now_ms();
 	enr_request = enrollmentRequest;
 	remote_peer_.address_ = enr_request.neighbor_.address_;
 	remote_peer_.name_ = enr_request.neighbor_.name_;
@@ -496,6 +726,12 @@ void EnrolleeStateMachine::connectResponse(int result,
 			}
 		}
 
+		//Get the DFT, FSDB... in a snapshot
+		eiRequest.snapshot_sections_ = enrollment_task_->get_snapshot_section_names();
+#ifdef HAVE_LIBZ
+		eiRequest.snapshot_compression_ = true;
+#endif
+
 		if (ipc_process_->get_address() != 0) {
 			was_dif_member_before_enrollment_ = true;
 			eiRequest.address_ = ipc_process_->get_address();
@@ -597,6 +833,14 @@ void EnrolleeStateMachine::stop(const configs::EnrollmentInformationRequest& eiR
 
 	timer->cancelTask(last_scheduled_task_);
 
+	//The snapshot is sent before the M_STOP, all of it must be here
+	if (snapshot_next_chunk_ != 0) {
+		snapshot_next_chunk_ = 0;
+		snapshot_image_.clear();
+		abortEnrollment("Incomplete enrollment snapshot", true);
+		return;
+	}
+
 	allowed_to_start_early_ = eiRequest.allowed_to_start_early_;
 	stop_request_invoke_id_ = invoke_id;
 	token = eiRequest.token;
@@ -743,8 +987,16 @@ void EnrolleeStateMachine::enrollmentCompleted()
 	//Create or update the neighbor information in the RIB
 	createOrUpdateNeighborInformation(true);;
 
-	//Send DirectoryForwardingTableEntries
-	sendDFTEntries();
+	//Send DirectoryForwardingTableEntries, the enroller only lacks ours
+	//if it has sent its DFT in the snapshot
+	sendDFTEntries(dft_from_snapshot_);
+
+	long duration = enr_now_ms() - enroll_start_ms_;
+	__atomic_add_fetch(&stats_->enrollee_enrollments, 1, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&stats_->total_duration_ms, duration, __ATOMIC_RELAXED);
+	__atomic_store_n(&stats_->last_duration_ms, duration, __ATOMIC_RELAXED);
+	LOG_IPCP_INFO("Enrolled to %s in %ld ms",
+		      remote_peer_.name_.getEncodedString().c_str(), duration);
 
 	enrollment_task_->enrollmentCompleted(remote_peer_, true,
 					      enr_request.event_.prepare_for_handover,
@@ -777,6 +1029,155 @@ void EnrolleeStateMachine::enrollmentCompleted()
 	}
 }
 
+void EnrolleeStateMachine::snapshotChunkReceived(const encoders::EnrollmentSnapshotChunk& chunk,
+						 const rina::cdap_rib::con_handle_t &con_handle)
+{
+	rina::ScopedLock g(lock_);
+
+	if (!isValidPortId(con_handle.port_id)){
+		return;
+	}
+
+	if (state_ != STATE_WAIT_STOP_ENROLLMENT_RESPONSE) {
+		LOG_IPCP_WARN("Enrollment snapshot received in state %s, ignoring it",
+			      state_.c_str());
+		return;
+	}
+
+	if (chunk.index == 0 || chunk.version != snapshot_version_) {
+		snapshot_version_ = chunk.version;
+		snapshot_next_chunk_ = 0;
+		snapshot_image_.clear();
+	}
+
+	//The DFT and FSDB are only in the snapshot, do not enroll without them
+	if (chunk.index != snapshot_next_chunk_) {
+		LOG_IPCP_ERR("Missing pieces of enrollment snapshot %llu",
+			     chunk.version);
+		snapshot_next_chunk_ = 0;
+		snapshot_image_.clear();
+		abortEnrollment("Incomplete enrollment snapshot", true);
+		return;
+	}
+
+	snapshot_image_.append(chunk.data);
+	snapshot_next_chunk_++;
+	__atomic_add_fetch(&stats_->snapshot_chunks_received, 1, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&stats_->snapshot_bytes_received, chunk.data.size(),
+			   __ATOMIC_RELAXED);
+
+	//The enroller is still working, wait for the M_STOP again
+	timer->cancelTask(last_scheduled_task_);
+	last_scheduled_task_ = new AbortEnrollmentTimerTask(enrollment_task_,
+							    remote_peer_.name_,
+							    con.port_id,
+							    remote_peer_.internal_port_id,
+							    STOP_ENROLLMENT_TIMEOUT,
+							    true);
+	timer->scheduleTask(last_scheduled_task_, timeout_);
+
+	if (snapshot_next_chunk_ < chunk.count)
+		return;
+
+	if (!applySnapshot(chunk.compressed, chunk.image_size)) {
+		snapshot_next_chunk_ = 0;
+		snapshot_image_.clear();
+		abortEnrollment("Could not apply the enrollment snapshot", true);
+		return;
+	}
+
+	snapshot_next_chunk_ = 0;
+	snapshot_image_.clear();
+}
+
+bool EnrolleeStateMachine::applySnapshot(bool compressed, unsigned int image_size)
+{
+	encoders::EnrollmentSnapshotEncoder encoder;
+	encoders::EnrollmentSnapshot snapshot;
+	std::map<std::string, std::string>::iterator it;
+	rina::ser_obj_t image;
+	long start = enr_now_ms();
+
+	if (compressed) {
+#ifdef HAVE_LIBZ
+		uLongf size = image_size;
+
+		//No valid deflate stream expands that much
+		if (image_size / 1024 > snapshot_image_.size()) {
+			LOG_IPCP_ERR("Bogus size of the enrollment snapshot: %u",
+				     image_size);
+			return false;
+		}
+
+		image.message_ = new unsigned char[image_size];
+		image.size_ = image_size;
+		if (uncompress(image.message_, &size,
+			       (const Bytef *) snapshot_image_.data(),
+			       snapshot_image_.size()) != Z_OK ||
+				size != image_size) {
+			LOG_IPCP_ERR("Could not decompress the enrollment snapshot");
+			return false;
+		}
+#else
+		LOG_IPCP_ERR("Cannot decompress the enrollment snapshot");
+		return false;
+#endif
+	} else {
+		if (snapshot_image_.size() != image_size) {
+			LOG_IPCP_ERR("Bogus size of the enrollment snapshot: %u",
+				     image_size);
+			return false;
+		}
+
+		image.message_ = new unsigned char[image_size];
+		image.size_ = image_size;
+		memcpy(image.message_, snapshot_image_.data(), image_size);
+	}
+
+	try {
+		encoder.decode(image, snapshot);
+	} catch (rina::Exception &e) {
+		LOG_IPCP_ERR("Problems decoding the enrollment snapshot: %s",
+			     e.what());
+		return false;
+	}
+
+	for (it = snapshot.sections.begin(); it != snapshot.sections.end(); ++it) {
+		rina::ser_obj_t section;
+
+		section.size_ = it->second.size();
+		section.message_ = new unsigned char[section.size_];
+		memcpy(section.message_, it->second.data(), section.size_);
+		try {
+			if (!enrollment_task_->apply_snapshot_section(it->first,
+								      con.port_id,
+								      section)) {
+				LOG_IPCP_ERR("Section %s of the enrollment snapshot is unknown",
+					     it->first.c_str());
+				return false;
+			}
+		} catch (rina::Exception &e) {
+			LOG_IPCP_ERR("Problems applying section %s of the enrollment snapshot: %s",
+				     it->first.c_str(), e.what());
+			return false;
+		}
+
+		if (it->first == DFTRIBObj::snapshot_section)
+			dft_from_snapshot_ = true;
+	}
+
+	long duration = enr_now_ms() - start;
+	__atomic_add_fetch(&stats_->snapshots_received, 1, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&stats_->snapshot_image_bytes, image_size,
+			   __ATOMIC_RELAXED);
+	__atomic_store_n(&stats_->last_apply_ms, duration, __ATOMIC_RELAXED);
+
+	LOG_IPCP_INFO("Applied enrollment snapshot %llu (%u bytes) in %ld ms",
+		      snapshot.version, image_size, duration);
+
+	return true;
+}
+
 void EnrolleeStateMachine::remoteReadResult(const rina::cdap_rib::con_handle_t &con_handle,
 		      	      	      	    const rina::cdap_rib::obj_info_t &obj,
 		      	      	      	    const rina::cdap_rib::res_info_t &res)
@@ -979,7 +1380,8 @@ public:
 			     const rina::ApplicationProcessNamingInformation& remote_naming_info,
 			     int timeout,
 			     const rina::ApplicationProcessNamingInformation& supporting_dif_name,
-			     rina::Timer * timer);
+			     rina::Timer * timer,
+			     enrollment_stats * stats);
 	~EnrollerStateMachine() { };
 
 	/// An M_CONNECT message has been received.  Handle the transition from the
@@ -1055,12 +1457,14 @@ EnrollerStateMachine::EnrollerStateMachine(IPCProcess * ipc_process,
 					   const rina::ApplicationProcessNamingInformation& remote_naming_info,
 					   int timeout,
 					   const rina::ApplicationProcessNamingInformation& supporting_dif_name,
-					   rina::Timer * timer):
+					   rina::Timer * timer,
+					   enrollment_stats * stats):
 		BaseEnrollmentStateMachine(ipc_process,
 					   remote_naming_info,
 					   timeout,
 					   supporting_dif_name,
-					   timer)
+					   timer,
+					   stats)
 {
 	namespace_manager_ = ipc_process->namespace_manager_;
 	enroller_ = true;
@@ -1401,7 +1805,7 @@ void EnrollerStateMachine::start(configs::EnrollmentInformationRequest& eiReques
 		sendDIFStaticInformation();
 	}
 
-	sendDIFDynamicInformation();
+	sendDIFDynamicInformation(eiRequest);
 
 	int temp = std::rand();
 	ss << temp;
@@ -1596,6 +2000,8 @@ void EnrollerStateMachine::enrollmentCompleted()
 
 	createOrUpdateNeighborInformation(true);
 
+	__atomic_add_fetch(&stats_->enroller_enrollments, 1, __ATOMIC_RELAXED);
+
 	enrollment_task_->enrollmentCompleted(remote_peer_, false, false,
 					      rina::ApplicationProcessNamingInformation());
 }
@@ -1604,10 +2010,34 @@ void EnrollerStateMachine::enrollmentCompleted()
 const std::string EnrollmentRIBObject::class_name = "Enrollment";
 const std::string EnrollmentRIBObject::object_name = "/difm/enr";
 
-EnrollmentRIBObject::EnrollmentRIBObject(IPCProcess * ipc_process) :
+EnrollmentRIBObject::EnrollmentRIBObject(IPCProcess * ipc_process,
+					 const enrollment_stats * stats) :
 	IPCPRIBObj(ipc_process, class_name)
 {
 	enrollment_task_ = (IPCPEnrollmentTask *) ipc_process->enrollment_task_;
+	stats_ = stats;
+}
+
+const std::string EnrollmentRIBObject::get_displayable_value() const
+{
+	std::stringstream ss;
+	unsigned long enrollments = stats_->enrollee_enrollments;
+
+	ss << "Enrollments as enrollee: " << enrollments
+	   << "; Enrollments as enroller: " << stats_->enroller_enrollments << std::endl;
+	ss << "Last enrollment duration (ms): " << stats_->last_duration_ms
+	   << "; Average enrollment duration (ms): "
+	   << (enrollments ? stats_->total_duration_ms / (long) enrollments : 0) << std::endl;
+	ss << "Snapshots sent: " << stats_->snapshots_sent
+	   << "; Pieces sent: " << stats_->snapshot_chunks_sent
+	   << "; Bytes sent: " << stats_->snapshot_bytes_sent << std::endl;
+	ss << "Snapshots received: " << stats_->snapshots_received
+	   << "; Pieces received: " << stats_->snapshot_chunks_received
+	   << "; Bytes received: " << stats_->snapshot_bytes_received
+	   << "; Uncompressed bytes: " << stats_->snapshot_image_bytes
+	   << "; Last apply time (ms): " << stats_->last_apply_ms;
+
+	return ss.str();
 }
 
 void EnrollmentRIBObject::start(const rina::cdap_rib::con_handle_t &con_handle,
@@ -1681,6 +2111,48 @@ void EnrollmentRIBObject::sendErrorMessage(unsigned int port_id)
 	}
 }
 
+//Class EnrollmentSnapshotRIBObject
+const std::string EnrollmentSnapshotRIBObject::class_name = "EnrollmentSnapshot";
+const std::string EnrollmentSnapshotRIBObject::object_name = "/difm/enr/snapshot";
+
+EnrollmentSnapshotRIBObject::EnrollmentSnapshotRIBObject(IPCProcess * ipc_process) :
+	IPCPRIBObj(ipc_process, class_name)
+{
+	enrollment_task_ = ipc_process->enrollment_task_;
+}
+
+void EnrollmentSnapshotRIBObject::create(const rina::cdap_rib::con_handle_t &con_handle,
+					 const std::string& fqn,
+					 const std::string& class_,
+					 const rina::cdap_rib::filt_info_t &filt,
+					 const int invoke_id,
+					 const rina::ser_obj_t &obj_req,
+					 rina::ser_obj_t &obj_reply,
+					 rina::cdap_rib::res_info_t& res)
+{
+	encoders::EnrollmentSnapshotChunkEncoder encoder;
+	encoders::EnrollmentSnapshotChunk chunk;
+	EnrolleeStateMachine * stateMachine;
+
+	stateMachine = dynamic_cast<EnrolleeStateMachine *>(
+			enrollment_task_->getEnrollmentStateMachine(con_handle.port_id,
+								    false));
+	if (!stateMachine) {
+		LOG_IPCP_ERR("Got a CDAP message that is not for me");
+		return;
+	}
+
+	try {
+		encoder.decode(obj_req, chunk);
+	} catch (rina::Exception &e) {
+		LOG_IPCP_ERR("Problems decoding enrollment snapshot: %s",
+			     e.what());
+		return;
+	}
+
+	stateMachine->snapshotChunkReceived(chunk, con_handle);
+}
+
 class EnrollmentTaskPs: public IPCPEnrollmentTaskPS {
 public:
 	EnrollmentTaskPs(IPCProcess * ipcp_);
@@ -1716,6 +2188,7 @@ private:
         rina::IPCResourceManager * irm;
         IPCPRIBDaemon * rib_daemon;
         rina::Timer timer;
+        enrollment_stats stats;
 };
 
 EnrollmentTaskPs::EnrollmentTaskPs(IPCProcess * ipcp_) :
@@ -1733,9 +2206,12 @@ void EnrollmentTaskPs::populate_rib()
 	vers.version_ = 0x1ULL;
 
 	try {
-		tmp = new EnrollmentRIBObject(ipcp);
+		tmp = new EnrollmentRIBObject(ipcp, &stats);
 		rib_daemon->addObjRIB(EnrollmentRIBObject::object_name, &tmp);
 
+		tmp = new EnrollmentSnapshotRIBObject(ipcp);
+		rib_daemon->addObjRIB(EnrollmentSnapshotRIBObject::object_name, &tmp);
+
 		tmp = new NeighborsRIBObj(ipcp);
 		rib_daemon->addObjRIB(NeighborsRIBObj::object_name, &tmp);
 		rib_daemon->getProxy()->addCreateCallbackSchema(vers,
@@ -1930,12 +2406,14 @@ IEnrollmentStateMachine * EnrollmentTaskPs::createEnrollmentStateMachine(const r
 		if (enrollee){
 			stateMachine = new EnrolleeStateMachine(ipcp,
 								apNamingInfo,
-								timeout, &timer);
+								timeout, &timer,
+								&stats);
 		}else{
 			stateMachine = new EnrollerStateMachine(ipcp,
 								apNamingInfo,
 								timeout,
-								supportingDifName, &timer);
+								supportingDifName, &timer,
+								&stats);
 		}
 
 		et->add_enrollment_state_machine(portId, stateMachine);
@@ -25,29 +25,31 @@
 #include <string>
 
 #include "ipcp/components.h"
+#include "resource-allocator-ps.h"
+#include "routing-ps.h"
 
 namespace rinad {
 
-class DefaultPDUFTGeneratorPs: public IPDUFTGeneratorPs {
-public:
-	DefaultPDUFTGeneratorPs(IResourceAllocator * ra);
-	void routingTableUpdated(const std::list<rina::RoutingTableEntry*>& routing_table);
-	int set_policy_set_param(const std::string& name, const std::string& value);
-	void set_dif_configuration(const rina::DIFConfiguration& dif_configuration);
-	virtual ~DefaultPDUFTGeneratorPs() {}
+DefaultPDUFTGeneratorPs::DefaultPDUFTGeneratorPs(IResourceAllocator * ra) :
+		res_alloc(ra), kernel_pduft_stale(false)
+{ }
 
-private:
-	void parse_qosid_map_entry(const rina::PolicyParameter& param);
+static bool same_port_ids(const rina::PDUForwardingTableEntry& a,
+			  const rina::PDUForwardingTableEntry& b)
+{
+	std::list<rina::PortIdAltlist>::const_iterator it, jt;
 
-        // Data model of the resource allocator component.
-        IResourceAllocator * res_alloc;
+	if (a.portIdAltlists.size() != b.portIdAltlists.size())
+		return false;
 
-        // Stores qos-id to N-1 flow characteristics mappings
-        std::map<int, rina::FlowSpecification> qosid_map;
-};
+	for (it = a.portIdAltlists.begin(), jt = b.portIdAltlists.begin();
+			it != a.portIdAltlists.end(); ++it, ++jt) {
+		if (it->alts != jt->alts)
+			return false;
+	}
 
-DefaultPDUFTGeneratorPs::DefaultPDUFTGeneratorPs(IResourceAllocator * ra) : res_alloc(ra)
-{ }
+	return true;
+}
 
 void DefaultPDUFTGeneratorPs::parse_qosid_map_entry(const rina::PolicyParameter& param)
 {
@@ -86,6 +88,9 @@ void DefaultPDUFTGeneratorPs::set_dif_configuration(const rina::DIFConfiguration
 	std::list<rina::PolicyParameter>::const_iterator it;
 	rina::PolicyConfig psconf;
 
+	std::map<int, link_metric_t> metrics;
+	std::map<int, link_metric_t>::iterator mit;
+
 	psconf = dif_configuration.ra_configuration_.pduftg_conf_.policy_set_;
 	for (it = psconf.parameters_.begin();
 			it != psconf.parameters_.end(); ++it) {
@@ -93,6 +98,95 @@ void DefaultPDUFTGeneratorPs::set_dif_configuration(const rina::DIFConfiguration
 			parse_qosid_map_entry(*it);
 		}
 	}
+
+	LinkStateRoutingPolicy::parseCubeMetrics(
+			dif_configuration.routing_configuration_.policy_set_,
+			metrics);
+	for (mit = metrics.begin(); mit != metrics.end(); ++mit) {
+		routed_cubes.insert(mit->first);
+	}
+}
+
+int DefaultPDUFTGeneratorPs::lookup_port(const rina::IPCPNameAddresses& nhop,
+					 int qos_id,
+					 port_index_t& index)
+{
+	INMinusOneFlowManager * n1fm = res_alloc->get_n_minus_one_flow_manager();
+	std::map<int, rina::FlowSpecification>::iterator qosmap_it;
+	port_index_t::iterator pit;
+	int port_id = -1;
+
+	if (nhop.name == "") {
+		if (nhop.addresses.empty())
+			return -1;
+
+		return n1fm->getManagementFlowToNeighbour(nhop.addresses.front());
+	}
+
+	pit = index.find(std::make_pair(qos_id, nhop.name));
+	if (pit != index.end())
+		return pit->second;
+
+	if (qos_id == -1) {
+		port_id = n1fm->getManagementFlowToNeighbour(nhop.name);
+	} else {
+		qosmap_it = qosid_map.find(qos_id);
+		if (qosmap_it != qosid_map.end())
+			port_id = n1fm->get_n1flow_to_neighbor(qosmap_it->second,
+							       nhop.name);
+		/* Fall back to the management flow to the neighbor */
+		if (port_id == -1)
+			port_id = lookup_port(nhop, -1, index);
+	}
+
+	index[std::make_pair(qos_id, nhop.name)] = port_id;
+
+	return port_id;
+}
+
+void DefaultPDUFTGeneratorPs::add_pduft_entry(std::list<rina::PDUForwardingTableEntry *>& pduft,
+					      const rina::RoutingTableEntry& rt_entry,
+					      unsigned int address,
+					      unsigned int qos_id,
+					      int nhop_qos_id,
+					      port_index_t& index)
+{
+	std::list<rina::NHopAltList>::const_iterator jt;
+	std::list<rina::IPCPNameAddresses>::const_iterator kt;
+	rina::PDUForwardingTableEntry * entry;
+	int port_id;
+
+	entry = new rina::PDUForwardingTableEntry();
+	entry->address = address;
+	entry->qosId = qos_id;
+	entry->cost = rt_entry.cost;
+
+	LOG_IPCP_DBG("Processing entry for destination %u and qos-id %u", address, qos_id);
+
+	for (jt = rt_entry.nextHopNames.begin();
+			jt != rt_entry.nextHopNames.end(); jt++) {
+		rina::PortIdAltlist portid_altlist;
+
+		for (kt = jt->alts.begin(); kt != jt->alts.end(); kt++) {
+			port_id = lookup_port(*kt, nhop_qos_id, index);
+			if (port_id == -1)
+				continue;
+
+			LOG_IPCP_DBG("NHOP %s qos-id %u --> N-1 port-id: %u",
+					kt->name.c_str(), qos_id, port_id);
+			portid_altlist.add_alt(port_id);
+		}
+
+		if (portid_altlist.alts.size()) {
+			entry->portIdAltlists.push_back(portid_altlist);
+		}
+	}
+
+	if (entry->portIdAltlists.size()) {
+		pduft.push_back(entry);
+	} else {
+		delete entry;
+	}
 }
 
 void DefaultPDUFTGeneratorPs::routingTableUpdated(const std::list<rina::RoutingTableEntry*>& rt)
@@ -100,111 +194,116 @@ void DefaultPDUFTGeneratorPs::routingTableUpdated(const std::list<rina::RoutingT
 	LOG_IPCP_DBG("Got %d entries in the routing table", rt.size());
 	//Compute PDU Forwarding Table
 	std::list<rina::PDUForwardingTableEntry *> pduft;
-	std::list<rina::PDUForwardingTableEntry *>::iterator pfit;
-	std::list<rina::PDUForwardingTableEntry *>::iterator pfjt;
 	std::list<rina::RoutingTableEntry *>::const_iterator it;
-	std::list<rina::NHopAltList>::const_iterator jt;
-	std::list<rina::IPCPNameAddresses>::const_iterator kt;
 	std::map<int, rina::FlowSpecification>::iterator qosmap_it;
 	std::list<unsigned int>::iterator at;
-	rina::PDUForwardingTableEntry * entry;
-	rina::PDUForwardingTableEntry * candidate;
-	bool increment = true;
-	INMinusOneFlowManager * n1fm;
-	int port_id = 0;
-
-	n1fm = res_alloc->get_n_minus_one_flow_manager();
+	port_index_t index;
 
 	for (it = rt.begin(); it!= rt.end(); it++) {
 		for (at = (*it)->destination.addresses.begin(); at != (*it)->destination.addresses.end(); ++at) {
-			if (qosid_map.size() == 0) {
-				entry = new rina::PDUForwardingTableEntry();
-				entry->address = *at;
-				entry->qosId = (*it)->qosId;
-				entry->cost = (*it)->cost;
-
-				LOG_IPCP_DBG("Processing entry for destination %u and qos-id %u", *at, entry->qosId);
-
-				for (jt = (*it)->nextHopNames.begin();
-						jt != (*it)->nextHopNames.end(); jt++) {
-					rina::PortIdAltlist portid_altlist;
-
-					for (kt = jt->alts.begin();
-							kt != jt->alts.end(); kt++) {
-						if (kt->name != "") {
-							port_id = n1fm->getManagementFlowToNeighbour(kt->name);
-						} else {
-							port_id = n1fm->getManagementFlowToNeighbour(kt->addresses.front());
-						}
-						if (port_id == -1)
-							continue;
-
-						LOG_IPCP_DBG("NHOP %s qos-id %u --> N-1 port-id: %u",
-								kt->name.c_str(), entry->qosId, port_id);
-						portid_altlist.add_alt(port_id);
-					}
-
-					if (portid_altlist.alts.size()) {
-						entry->portIdAltlists.push_back(portid_altlist);
-					}
-				}
-
-				if (entry->portIdAltlists.size()) {
-					pduft.push_back(entry);
-				} else {
-					delete entry;
-				}
+			if (routed_cubes.count((*it)->qosId)) {
+				// Entry of the routing table of a QoS cube
+				add_pduft_entry(pduft, **it, *at, (*it)->qosId,
+						(*it)->qosId, index);
+			} else if (qosid_map.size() == 0) {
+				add_pduft_entry(pduft, **it, *at, (*it)->qosId,
+						-1, index);
 			} else {
 				for (qosmap_it = qosid_map.begin(); qosmap_it != qosid_map.end(); qosmap_it ++) {
-					entry = new rina::PDUForwardingTableEntry();
-					entry->address = *at;
-					entry->qosId = qosmap_it->first;
-					entry->cost = (*it)->cost;
-
-					LOG_IPCP_DBG("Processing entry for destination %u and qos-id %u", *at, entry->qosId);
-
-					for (jt = (*it)->nextHopNames.begin();
-							jt != (*it)->nextHopNames.end(); jt++) {
-						rina::PortIdAltlist portid_altlist;
-
-						for (kt = jt->alts.begin();
-								kt != jt->alts.end(); kt++) {
-							port_id = n1fm->get_n1flow_to_neighbor(qosmap_it->second, kt->name);
-							if (port_id == -1)
-								port_id = n1fm->getManagementFlowToNeighbour(kt->name);
-
-							LOG_IPCP_DBG("NHOP %s qos-id %u --> N-1 port-id: %u",
-									kt->name.c_str(), entry->qosId, port_id);
-							portid_altlist.add_alt(port_id);
-						}
-
-						if (portid_altlist.alts.size()) {
-							entry->portIdAltlists.push_back(portid_altlist);
-						}
-					}
-
-					if (entry->portIdAltlists.size()) {
-						pduft.push_back(entry);
-					} else {
-						delete entry;
-					}
+					if (routed_cubes.count(qosmap_it->first))
+						continue;
+
+					add_pduft_entry(pduft, **it, *at, qosmap_it->first,
+							qosmap_it->first, index);
 				}
 			}
 		}
 	}
 
-	try {
-		rina::kernelIPCProcess->modifyPDUForwardingTableEntries(pduft, 2);
-	} catch (rina::Exception & e) {
-		LOG_IPCP_ERR("Error setting PDU Forwarding Table in the kernel: %s",
-				e.what());
-	}
+	update_kernel_pduft(pduft);
 
 	//Update resource allocator
 	res_alloc->set_rt_entries(rt);
 	res_alloc->set_pduft_entries(pduft);
 }
 
+void DefaultPDUFTGeneratorPs::update_kernel_pduft(const std::list<rina::PDUForwardingTableEntry *>& pduft)
+{
+	typedef std::pair<unsigned int, unsigned int> pduft_key_t;
+	std::map<pduft_key_t, rina::PDUForwardingTableEntry> current;
+	std::map<pduft_key_t, rina::PDUForwardingTableEntry>::iterator cit;
+	std::list<rina::PDUForwardingTableEntry> current_list;
+	std::list<rina::PDUForwardingTableEntry>::iterator lit;
+	std::list<rina::PDUForwardingTableEntry *>::const_iterator it;
+	std::list<rina::PDUForwardingTableEntry *> delta;
+	std::list<rina::PDUForwardingTableEntry *> removed;
+	rina::PDUForwardingTableEntry * entry;
+	unsigned int added = 0;
+	unsigned int modified = 0;
+
+	current_list = res_alloc->get_pduft_entries();
+	for (lit = current_list.begin(); lit != current_list.end(); ++lit) {
+		current[pduft_key_t(lit->address, lit->qosId)] = *lit;
+	}
+
+	for (it = pduft.begin(); it != pduft.end(); ++it) {
+		cit = current.find(pduft_key_t((*it)->address, (*it)->qosId));
+		if (cit == current.end()) {
+			delta.push_back(*it);
+			added++;
+			continue;
+		}
+
+		if (!same_port_ids(cit->second, **it)) {
+			delta.push_back(*it);
+			modified++;
+		}
+
+		current.erase(cit);
+	}
+
+	//What is left in the current table is not reachable anymore
+	for (cit = current.begin(); cit != current.end(); ++cit) {
+		entry = new rina::PDUForwardingTableEntry();
+		entry->address = cit->second.address;
+		entry->qosId = cit->second.qosId;
+		removed.push_back(entry);
+		delta.push_back(entry);
+	}
+
+	LOG_IPCP_DBG("PDU Forwarding Table delta: %u added, %u modified, %zu removed",
+		     added, modified, removed.size());
+
+	if (kernel_pduft_stale) {
+		//A previous write failed, the kernel does not have the
+		//current table
+		kernel_pduft_stale = write_kernel_pduft(pduft, 2) != 0;
+	} else if (delta.size() && write_kernel_pduft(delta, 3)) {
+		LOG_IPCP_WARN("Replacing the whole PDU Forwarding Table in the kernel");
+		kernel_pduft_stale = write_kernel_pduft(pduft, 2) != 0;
+	}
+
+	res_alloc->pduft_updated(added, modified, removed.size());
+
+	for (it = removed.begin(); it != removed.end(); ++it) {
+		delete *it;
+	}
+}
+
+int DefaultPDUFTGeneratorPs::write_kernel_pduft(const std::list<rina::PDUForwardingTableEntry *>& entries,
+						int mode)
+{
+	try {
+		rina::kernelIPCProcess->modifyPDUForwardingTableEntries(entries, mode);
+	} catch (rina::Exception & e) {
+		LOG_IPCP_ERR("Error updating PDU Forwarding Table in the kernel: %s",
+			     e.what());
+		return -1;
+	}
+
+	return 0;
+}
+
 int DefaultPDUFTGeneratorPs::set_policy_set_param(const std::string& name,
                                             	  const std::string& value)
 {
@@ -0,0 +1,91 @@
+/*
+ * Default policy set for Resource Allocator
+ *
+ *    Eduard Grasa <eduard.grasa@i2cat.net>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA  02110-1301  USA
+ */
+
+#ifndef IPCP_RESOURCE_ALLOCATOR_PS_DEFAULT_HH
+#define IPCP_RESOURCE_ALLOCATOR_PS_DEFAULT_HH
+
+#include <map>
+#include <set>
+#include <string>
+
+#include "ipcp/components.h"
+
+namespace rinad {
+
+class DefaultPDUFTGeneratorPs: public IPDUFTGeneratorPs {
+public:
+	DefaultPDUFTGeneratorPs(IResourceAllocator * ra);
+	void routingTableUpdated(const std::list<rina::RoutingTableEntry*>& routing_table);
+	int set_policy_set_param(const std::string& name, const std::string& value);
+	void set_dif_configuration(const rina::DIFConfiguration& dif_configuration);
+	virtual ~DefaultPDUFTGeneratorPs() {}
+
+protected:
+	/// Write entries of the PDU Forwarding Table to the kernel, either
+	/// the changed (or removed, without port-ids) ones with mode 3 or
+	/// the whole table with mode 2. Returns -1 if the kernel failed
+	virtual int write_kernel_pduft(const std::list<rina::PDUForwardingTableEntry *>& entries,
+				       int mode);
+
+private:
+	/// N-1 port-ids towards the next hops, indexed by qos-id (-1 for
+	/// the management flow) and next hop name
+	typedef std::map<std::pair<int, std::string>, int> port_index_t;
+
+	void parse_qosid_map_entry(const rina::PolicyParameter& param);
+
+	/// Resolve the N-1 port-id towards a next hop, for a qos-id of the
+	/// qosid_map (or the management flow if qos_id is -1)
+	int lookup_port(const rina::IPCPNameAddresses& nhop,
+			int qos_id,
+			port_index_t& index);
+
+	/// Add the PDU Forwarding Table entry of one destination address
+	/// of the routing table entry for a qos-id
+	void add_pduft_entry(std::list<rina::PDUForwardingTableEntry *>& pduft,
+			     const rina::RoutingTableEntry& rt_entry,
+			     unsigned int address,
+			     unsigned int qos_id,
+			     int nhop_qos_id,
+			     port_index_t& index);
+
+	/// Send to the kernel only the entries that differ from the current
+	/// PDU Forwarding Table, instead of flushing and replacing it. If
+	/// the kernel rejects them the whole table is replaced
+	void update_kernel_pduft(const std::list<rina::PDUForwardingTableEntry *>& pduft);
+
+        // Data model of the resource allocator component.
+        IResourceAllocator * res_alloc;
+
+        // Stores qos-id to N-1 flow characteristics mappings
+        std::map<int, rina::FlowSpecification> qosid_map;
+
+        // QoS cubes with their own routing table
+        std::set<int> routed_cubes;
+
+        // The last write to the kernel failed, so the next update has to
+        // replace the whole table instead of sending a delta
+        bool kernel_pduft_stale;
+};
+
+}
+
+#endif
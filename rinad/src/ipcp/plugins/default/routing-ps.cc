@@ -22,11 +22,16 @@
 // MA  02110-1301  USA
 //
 
+#include <algorithm>
 #include <assert.h>
 #include <climits>
+#include <functional>
+#include <queue>
 #include <set>
 #include <sstream>
 #include <string>
+#include <time.h>
+#include <unistd.h>
 
 #define IPCP_MODULE "routing-ps-link-state"
 #include "../../ipcp-logging.h"
@@ -161,13 +166,44 @@ const std::string Edge::toString() const
 	return ss.str();
 }
 
+// 1 Gbps
+const unsigned int Graph::REFERENCE_BANDWIDTH = 125000000;
+
 Graph::Graph(const std::list<FlowStateObject>& flow_state_objects)
 {
+	metric_ = LINK_METRIC_COST;
+	set_flow_state_objects(flow_state_objects);
+}
+
+Graph::Graph(const std::list<FlowStateObject>& flow_state_objects,
+	     link_metric_t metric)
+{
+	metric_ = metric;
 	set_flow_state_objects(flow_state_objects);
 }
 
 Graph::Graph()
 {
+	metric_ = LINK_METRIC_COST;
+}
+
+int Graph::edge_weight(const FlowStateObject& fso, link_metric_t metric)
+{
+	switch (metric) {
+	case LINK_METRIC_DELAY:
+		if (fso.delay > 0)
+			return fso.delay;
+		break;
+	case LINK_METRIC_BANDWIDTH:
+		if (fso.bandwidth > 0)
+			return std::max<unsigned int>(1,
+					REFERENCE_BANDWIDTH / fso.bandwidth);
+		break;
+	default:
+		break;
+	}
+
+	return fso.cost;
 }
 
 void Graph::set_flow_state_objects(const std::list<FlowStateObject>& flow_state_objects)
@@ -268,7 +304,7 @@ void Graph::init_edges()
 				&& dest->connection_contains_name(origin->name_)) {
 			edges_.push_back(new Edge(origin->name_,
 						  dest->name_,
-						  flowIt->cost));
+						  edge_weight(*flowIt, metric_)));
 			origin->connections.remove(dest->name_);
 			dest->connections.remove(origin->name_);
 		} else {
@@ -359,9 +395,23 @@ void DijkstraAlgorithm::computeRoutingTable(const Graph& graph,
 		}
 	}
 
+	last_source_ = source_name;
+	last_distances_.swap(distances_);
+
 	clear();
 }
 
+bool DijkstraAlgorithm::getLastShortestDistances(const std::string& source_name,
+						 std::map<std::string, int>& distances) const
+{
+	if (last_source_ != source_name)
+		return false;
+
+	distances = last_distances_;
+
+	return true;
+}
+
 void DijkstraAlgorithm::execute(const Graph& graph, const std::string& source)
 {
 	distances_[source] = 0;
@@ -442,15 +492,7 @@ bool DijkstraAlgorithm::isNeighbor(Edge * edge, const std::string& node) const
 
 bool DijkstraAlgorithm::isSettled(const std::string& node) const
 {
-	std::set<std::string>::iterator it;
-
-	for (it = settled_nodes_.begin(); it != settled_nodes_.end(); ++it) {
-		if ((*it) == node) {
-			return true;
-		}
-	}
-
-	return false;
+	return settled_nodes_.find(node) != settled_nodes_.end();
 }
 
 std::string DijkstraAlgorithm::getNextHop(const std::string& target,
@@ -548,9 +590,24 @@ void ECMPDijkstraAlgorithm::computeRoutingTable(const Graph& graph,
 		}
 		addRecursive(rt, 1, (*it)->name, *it);
 	}
+
+	last_source_ = source_name;
+	last_distances_.swap(distances_);
+
 	clear();
 }
 
+bool ECMPDijkstraAlgorithm::getLastShortestDistances(const std::string& source_name,
+						     std::map<std::string, int>& distances) const
+{
+	if (last_source_ != source_name)
+		return false;
+
+	distances = last_distances_;
+
+	return true;
+}
+
 void ECMPDijkstraAlgorithm::addRecursive(std::list<rina::RoutingTableEntry *> &table,
 					 int qos,
 					 const std::string& next,
@@ -717,55 +774,268 @@ bool ECMPDijkstraAlgorithm::isNeighbor(Edge * edge,
 
 bool ECMPDijkstraAlgorithm::isSettled(const std::string& node) const
 {
-	std::set<std::string>::iterator it;
+	return settled_nodes_.find(node) != settled_nodes_.end();
+}
 
-	for (it = settled_nodes_.begin();
-			it != settled_nodes_.end(); ++it) {
-		if ((*it) == node) {
-			return true;
+//Class IResiliencyAlgorithm
+IResiliencyAlgorithm::IResiliencyAlgorithm(IRoutingAlgorithm& ra)
+						: routing_algorithm(ra)
+{
+}
+
+// Class DenseGraph
+const int DenseGraph::UNREACHABLE = INT_MAX;
+
+void DenseGraph::computeShortestDistances(unsigned int root,
+					  std::vector<int>& distances) const
+{
+	typedef std::pair<int, unsigned int> heap_entry_t;
+	std::priority_queue<heap_entry_t, std::vector<heap_entry_t>,
+			    std::greater<heap_entry_t> > heap;
+	std::vector<DenseEdge>::const_iterator it;
+	heap_entry_t top;
+	int dist;
+
+	distances.assign(adjacency.size(), UNREACHABLE);
+	if (root >= adjacency.size())
+		return;
+
+	distances[root] = 0;
+	heap.push(heap_entry_t(0, root));
+	while (!heap.empty()) {
+		top = heap.top();
+		heap.pop();
+		if (top.first > distances[top.second])
+			continue;
+
+		for (it = adjacency[top.second].begin();
+				it != adjacency[top.second].end(); ++it) {
+			dist = top.first + it->weight;
+			if (dist < distances[it->to]) {
+				distances[it->to] = dist;
+				heap.push(heap_entry_t(dist, it->to));
+			}
 		}
 	}
+}
 
-	return false;
+// Class SPFWorkerPool
+class SPFWorker : public rina::SimpleThread {
+public:
+	SPFWorker(SPFWorkerPool * p, const std::string& name)
+		: rina::SimpleThread(name, false), pool(p) { };
+	~SPFWorker() throw() { };
+
+	int run()
+	{
+		pool->run_worker();
+		return 0;
+	}
+
+private:
+	SPFWorkerPool * pool;
+};
+
+SPFWorkerPool::SPFWorkerPool(unsigned int nworkers,
+			     const std::string& name_prefix)
+{
+	SPFWorker * worker;
+	std::stringstream ss;
+
+	pending = 0;
+	for (unsigned int i = 0; i < nworkers; i++) {
+		ss.str("");
+		ss << name_prefix << "-" << i;
+		worker = new SPFWorker(this, ss.str());
+		worker->start();
+		workers.push_back(worker);
+	}
 }
 
-//Class IResiliencyAlgorithm
-IResiliencyAlgorithm::IResiliencyAlgorithm(IRoutingAlgorithm& ra)
-						: routing_algorithm(ra)
+SPFWorkerPool::~SPFWorkerPool()
+{
+	spf_job * job;
+	void * status;
+
+	for (unsigned int i = 0; i < workers.size(); i++) {
+		job = new spf_job();
+		job->type = SPF_JOB_STOP;
+		jobs.put(job);
+	}
+
+	for (unsigned int i = 0; i < workers.size(); i++) {
+		workers[i]->join(&status);
+		delete workers[i];
+	}
+}
+
+unsigned int SPFWorkerPool::default_workers()
+{
+	long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+	if (ncpus <= 1)
+		return 0;
+
+	return std::min<long>(ncpus - 1, SPF_MAX_WORKERS);
+}
+
+void SPFWorkerPool::run_job(spf_job * job)
+{
+	if (job->type == SPF_JOB_DISTANCES) {
+		job->graph->computeShortestDistances(job->root, *job->distances);
+	} else {
+		Graph graph(*job->fsos, job->request->metric);
+
+		job->request->algorithm->computeRoutingTable(graph,
+							     *job->fsos,
+							     *job->source_name,
+							     job->request->rt);
+	}
+	delete job;
+
+	done_cv.lock();
+	if (--pending == 0)
+		done_cv.broadcast();
+	done_cv.unlock();
+}
+
+void SPFWorkerPool::run_worker()
+{
+	spf_job * job;
+
+	for (;;) {
+		job = jobs.take();
+		if (job->type == SPF_JOB_STOP) {
+			delete job;
+			return;
+		}
+
+		run_job(job);
+	}
+}
+
+void SPFWorkerPool::computeShortestDistances(const DenseGraph& graph,
+					     const std::vector<unsigned int>& roots,
+					     const std::vector<std::vector<int> *>& distances)
+{
+	spf_job * job;
+
+	if (roots.empty())
+		return;
+
+	done_cv.lock();
+	pending = roots.size();
+	done_cv.unlock();
+
+	for (unsigned int i = 0; i < roots.size(); i++) {
+		job = new spf_job();
+		job->type = SPF_JOB_DISTANCES;
+		job->graph = &graph;
+		job->root = roots[i];
+		job->distances = distances[i];
+		jobs.put(job);
+	}
+
+	wait_jobs();
+}
+
+void SPFWorkerPool::computeRoutingTables(const std::list<FlowStateObject>& fsos,
+					 const std::string& source_name,
+					 std::vector<spf_routing_request *>& requests)
+{
+	spf_job * job;
+
+	if (requests.empty())
+		return;
+
+	done_cv.lock();
+	pending = requests.size();
+	done_cv.unlock();
+
+	for (unsigned int i = 0; i < requests.size(); i++) {
+		job = new spf_job();
+		job->type = SPF_JOB_ROUTING_TABLE;
+		job->fsos = &fsos;
+		job->source_name = &source_name;
+		job->request = requests[i];
+		jobs.put(job);
+	}
+
+	wait_jobs();
+}
+
+void SPFWorkerPool::wait_jobs()
 {
+	spf_job * job;
+
+	while ((job = jobs.poll()) != 0)
+		run_job(job);
+
+	done_cv.lock();
+	while (pending)
+		done_cv.doWait();
+	done_cv.unlock();
 }
 
 //Class LoopFreeAlternateAlgorithm
 LoopFreeAlternateAlgorithm::LoopFreeAlternateAlgorithm(IRoutingAlgorithm& ra)
 						: IResiliencyAlgorithm(ra)
 {
+	// The thread invoking fortifyRoutingTable() computes trees too
+	pool_ = new SPFWorkerPool(SPFWorkerPool::default_workers(), "lfa-spf");
+}
+
+LoopFreeAlternateAlgorithm::~LoopFreeAlternateAlgorithm()
+{
+	delete pool_;
+}
+
+unsigned int LoopFreeAlternateAlgorithm::getVertexId(const std::string& name)
+{
+	std::map<std::string, unsigned int>::iterator it;
+
+	it = vertex_ids_.find(name);
+	if (it != vertex_ids_.end())
+		return it->second;
+
+	vertex_ids_[name] = vertex_names_.size();
+	vertex_names_.push_back(name);
+
+	return vertex_names_.size() - 1;
+}
+
+// Without trees to reuse, or once most of the ids belong to vertices
+// that left the graph, start over with the vertices of the graph. All
+// the trees are computed again
+void LoopFreeAlternateAlgorithm::compactVertexIds(const Graph& graph)
+{
+	if (vertex_names_.empty())
+		return;
+
+	if (!neighbor_trees_.empty() &&
+			vertex_names_.size() <= 2 * graph.vertices_.size())
+		return;
+
+	vertex_ids_.clear();
+	vertex_names_.clear();
+	edges_.clear();
+	neighbor_trees_.clear();
+
+	for (std::list<std::string>::const_iterator it = graph.vertices_.begin();
+					it != graph.vertices_.end(); ++it)
+		getVertexId(*it);
 }
 
 void LoopFreeAlternateAlgorithm::extendRoutingTableEntry(
-			std::list<rina::RoutingTableEntry *>& rt,
-			const std::string& target_name,
+			rina::RoutingTableEntry * entry,
 			const std::string& nexthop)
 {
-	std::list<rina::RoutingTableEntry *>::iterator rit;
 	bool found = false;
 	rina::IPCPNameAddresses ipcpna;
 
-	// Find the involved routing table entry
-	for (rit = rt.begin(); rit != rt.end(); rit++) {
-		if ((*rit)->destination.name == target_name) {
-			break;
-		}
-	}
-
-	if (rit == rt.end()) {
-		LOG_WARN("LFA: Couldn't find routing table entry for "
-			 "target name %s", target_name.c_str());
-		return;
-	}
-
 	// Assume unicast and try to extend the routing table entry
 	// with the new alternative 'nexthop'
-	rina::NHopAltList& altlist = (*rit)->nextHopNames.front();
+	rina::NHopAltList& altlist = entry->nextHopNames.front();
 
 	for (std::list<rina::IPCPNameAddresses>::iterator
 			hit = altlist.alts.begin();
@@ -781,57 +1051,206 @@ void LoopFreeAlternateAlgorithm::extendRoutingTableEntry(
 		ipcpna.name = nexthop;
 		altlist.alts.push_back(ipcpna);
 		LOG_DBG("Node %s selected as LFA node towards the "
-			 "destination node %s", nexthop.c_str(), target_name.c_str());
+			 "destination node %s", nexthop.c_str(),
+			 entry->destination.name.c_str());
+	}
+}
+
+// The tree is still valid if no edge on a shortest path got worse or
+// disappeared, and no edge got better enough to shorten a path
+bool LoopFreeAlternateAlgorithm::isTreeAffected(const std::vector<int>& dist,
+						const std::vector<edge_change>& changes) const
+{
+	std::vector<edge_change>::const_iterator it;
+	long d1, d2;
+
+	for (it = changes.begin(); it != changes.end(); ++it) {
+		d1 = dist[it->v1];
+		d2 = dist[it->v2];
+
+		if (it->old_weight >= 0 &&
+				(it->new_weight < 0 || it->new_weight > it->old_weight)) {
+			if ((d1 != DenseGraph::UNREACHABLE &&
+					d1 + it->old_weight == d2) ||
+			    (d2 != DenseGraph::UNREACHABLE &&
+					d2 + it->old_weight == d1))
+				return true;
+		}
+
+		if (it->new_weight >= 0 &&
+				(it->old_weight < 0 || it->new_weight < it->old_weight)) {
+			if ((d1 != DenseGraph::UNREACHABLE &&
+					d1 + it->new_weight < d2) ||
+			    (d2 != DenseGraph::UNREACHABLE &&
+					d2 + it->new_weight < d1))
+				return true;
+		}
 	}
+
+	return false;
 }
 
 void LoopFreeAlternateAlgorithm::fortifyRoutingTable(const Graph& graph,
 						     const std::string& source_name,
 						     std::list<rina::RoutingTableEntry *>& rt)
 {
-	std::map<std::string, std::map< std::string, int > > neighbors_dist_trees;
-	std::map<std::string, int> src_dist_tree;
+	std::map<edge_key_t, int> edges;
+	std::map<edge_key_t, int>::iterator eit, oit;
+	std::vector<edge_change> changes;
+	edge_change change;
+	std::map<std::string, int> src_dist_map;
+	std::map<std::string, int>::iterator dit;
+	std::map<std::string, rina::RoutingTableEntry *> entries;
+	std::map<std::string, rina::RoutingTableEntry *>::iterator rit;
+	std::map<std::string, unsigned int> neighbors;
+	std::map<std::string, unsigned int>::iterator nit;
+	std::map<unsigned int, std::vector<int> > trees;
+	std::vector<unsigned int> to_compute;
+	std::vector<std::vector<int> *> results;
+	std::vector<int> src_dist;
+	DenseGraph dense;
+	unsigned int source, v1, v2;
+	long dist_n_t, dist_s_n, dist_s_t;
+
+	if (!graph.contains_vertex(source_name))
+		return;
+
+	compactVertexIds(graph);
+	source = getVertexId(source_name);
+	for (std::list<Edge *>::const_iterator it = graph.edges_.begin();
+				it != graph.edges_.end(); ++it) {
+		v1 = getVertexId((*it)->name1_);
+		v2 = getVertexId((*it)->name2_);
+		if (v1 == v2)
+			continue;
+		if (v1 > v2)
+			std::swap(v1, v2);
+
+		eit = edges.find(edge_key_t(v1, v2));
+		if (eit == edges.end() || eit->second > (*it)->weight_)
+			edges[edge_key_t(v1, v2)] = (*it)->weight_;
+	}
+
+	dense.adjacency.resize(vertex_names_.size());
+	for (eit = edges.begin(); eit != edges.end(); ++eit) {
+		v1 = eit->first.first;
+		v2 = eit->first.second;
+		dense.adjacency[v1].push_back(DenseGraph::DenseEdge(v2, eit->second));
+		dense.adjacency[v2].push_back(DenseGraph::DenseEdge(v1, eit->second));
+		if (v1 == source)
+			neighbors[vertex_names_[v2]] = v2;
+		else if (v2 == source)
+			neighbors[vertex_names_[v1]] = v1;
+	}
+
+	// Find what changed since the last invocation
+	for (eit = edges.begin(), oit = edges_.begin();
+			eit != edges.end() || oit != edges_.end();) {
+		change.old_weight = -1;
+		change.new_weight = -1;
+		if (oit == edges_.end() ||
+				(eit != edges.end() && eit->first < oit->first)) {
+			change.v1 = eit->first.first;
+			change.v2 = eit->first.second;
+			change.new_weight = eit->second;
+			++eit;
+		} else if (eit == edges.end() || oit->first < eit->first) {
+			change.v1 = oit->first.first;
+			change.v2 = oit->first.second;
+			change.old_weight = oit->second;
+			++oit;
+		} else {
+			change.v1 = eit->first.first;
+			change.v2 = eit->first.second;
+			change.old_weight = oit->second;
+			change.new_weight = eit->second;
+			++eit;
+			++oit;
+			if (change.old_weight == change.new_weight)
+				continue;
+		}
+		changes.push_back(change);
+	}
+	edges_.swap(edges);
 
-	// TODO avoid this, can be computed when invoke computeRoutingTable()
-	routing_algorithm.computeShortestDistances(graph, source_name, src_dist_tree);
+	// Reuse the shortest distances from the source computed by the
+	// routing algorithm
+	if (routing_algorithm.getLastShortestDistances(source_name,
+						       src_dist_map)) {
+		src_dist.assign(vertex_names_.size(), DenseGraph::UNREACHABLE);
+		for (dit = src_dist_map.begin(); dit != src_dist_map.end(); ++dit)
+			src_dist[getVertexId(dit->first)] = dit->second;
+	} else {
+		dense.computeShortestDistances(source, src_dist);
+	}
 
-	// Collect all the neighbors, and for each one use the routing algorithm to
-	// compute the shortest distance map rooted at that neighbor
-	for (std::list<std::string>::const_iterator it = graph.vertices_.begin();
-						it != graph.vertices_.end(); ++it) {
-		if ((*it) != source_name && graph.contains_edge(source_name, *it)) {
-			neighbors_dist_trees[*it] = std::map<std::string, int>();
-			routing_algorithm.computeShortestDistances(graph,
-						*it, neighbors_dist_trees[*it]);
+	// Reuse the trees of the neighbors that are not affected by the
+	// changes, compute the rest in parallel
+	for (nit = neighbors.begin(); nit != neighbors.end(); ++nit) {
+		std::map<unsigned int, std::vector<int> >::iterator tit;
+		std::vector<int>& tree = trees[nit->second];
+
+		tit = neighbor_trees_.find(nit->second);
+		if (tit != neighbor_trees_.end()) {
+			tree.swap(tit->second);
+			tree.resize(vertex_names_.size(), DenseGraph::UNREACHABLE);
+			if (!isTreeAffected(tree, changes))
+				continue;
 		}
+
+		to_compute.push_back(nit->second);
+		results.push_back(&tree);
+	}
+	pool_->computeShortestDistances(dense, to_compute, results);
+	neighbor_trees_.swap(trees);
+
+	LOG_IPCP_DBG("LFA: %zu neighbors, %zu trees computed, %zu edges changed",
+		     neighbors.size(), to_compute.size(), changes.size());
+
+	for (std::list<rina::RoutingTableEntry *>::iterator it = rt.begin();
+				it != rt.end(); ++it) {
+		if (!(*it)->nextHopNames.empty())
+			entries[(*it)->destination.name] = *it;
 	}
 
 	// For each node X other than than the source node
 	for (std::list<std::string>::const_iterator it = graph.vertices_.begin();
 						it != graph.vertices_.end(); ++it) {
+		unsigned int target;
+
 		if ((*it) == source_name) {
 			continue;
 		}
 
+		target = getVertexId(*it);
+		dist_s_t = src_dist[target];
+		if (dist_s_t == DenseGraph::UNREACHABLE)
+			continue;
+
+		rit = entries.find(*it);
+
 		// For each neighbor of the source node, excluding X
-		for (std::map<std::string, std::map<std::string, int> >::iterator
-			nit = neighbors_dist_trees.begin();
-				nit != neighbors_dist_trees.end(); nit++) {
-			// If this neighbor is a LFA node for the current
-			// destination (*it) extend the routing table to take it
-			// into account
-			std::map< std::string, int>& neigh_dist_map = nit->second;
-			std::string neigh = nit->first;
-
-			if (neigh == *it) {
+		for (nit = neighbors.begin(); nit != neighbors.end(); ++nit) {
+			const std::vector<int>& neigh_dist = neighbor_trees_[nit->second];
+
+			if (nit->second == target) {
 				continue;
 			}
 
+			dist_n_t = neigh_dist[target];
+			dist_s_n = src_dist[nit->second];
+			if (dist_n_t == DenseGraph::UNREACHABLE ||
+					dist_s_n == DenseGraph::UNREACHABLE)
+				continue;
+
 			// dist(neigh, target) < dist(neigh, source) + dist(source, target)
-			if (neigh_dist_map[*it] < src_dist_tree[neigh] + src_dist_tree[*it]) {
-				//LOG_DBG("Node %u is a possible LFA for destination %u",
-				//	neigh, *it);
-				extendRoutingTableEntry(rt, *it, neigh);
+			if (dist_n_t < dist_s_n + dist_s_t) {
+				if (rit == entries.end()) {
+					LOG_WARN("LFA: Couldn't find routing table entry for "
+						 "target name %s", it->c_str());
+					break;
+				}
+				extendRoutingTableEntry(rit->second, nit->first);
 			}
 		}
 	}
@@ -841,12 +1260,18 @@ void LoopFreeAlternateAlgorithm::fortifyRoutingTable(const Graph& graph,
 FlowStateObject::FlowStateObject()
 {
 	cost = 0;
+	delay = 0;
+	bandwidth = 0;
 	state_up = false;
 	seq_num = 0;
 	age = 0;
 	modified = false;
 	avoid_port = 0;
 	being_erased = true;
+	erase_due = 0;
+	refreshed = 0;
+	expiry_queued = false;
+	queued_expiry = 0;
 }
 
 FlowStateObject::FlowStateObject(const std::string& name_,
@@ -859,6 +1284,8 @@ FlowStateObject::FlowStateObject(const std::string& name_,
 	name = name_;
 	neighbor_name = neighbor_name_;
 	cost = cost_;
+	delay = 0;
+	bandwidth = 0;
 	state_up = up;
 	seq_num = sequence_number;
 	age = age_;
@@ -868,7 +1295,11 @@ FlowStateObject::FlowStateObject(const std::string& name_,
 	object_name = ss.str();
 	modified = true;
 	being_erased = false;
+	erase_due = 0;
 	avoid_port = 0;
+	refreshed = 0;
+	expiry_queued = false;
+	queued_expiry = 0;
 }
 
 FlowStateObject::~FlowStateObject()
@@ -995,10 +1426,12 @@ const std::string FlowStateObject::getKey() const
 const std::string FlowStateRIBObject::clazz_name = "FlowStateObject";
 const std::string FlowStateRIBObject::object_name_prefix = "/ra/fsos/key=";
 
-FlowStateRIBObject::FlowStateRIBObject(FlowStateObject* new_obj):
+FlowStateRIBObject::FlowStateRIBObject(FlowStateObject* new_obj,
+				       FlowStateObjects* fsdb):
 rina::rib::RIBObj(clazz_name)
 {
 	obj = new_obj;
+	fsdb_ = fsdb;
 }
 
 void FlowStateRIBObject::read(const rina::cdap_rib::con_handle_t &con, 
@@ -1007,25 +1440,41 @@ void FlowStateRIBObject::read(const rina::cdap_rib::con_handle_t &con,
 	rina::ser_obj_t &obj_reply, rina::cdap_rib::res_info_t& res)
 {
 	FlowStateObjectEncoder encoder;
-	encoder.encode(*obj, obj_reply);
+	FlowStateObject fso(*obj);
+
+	fso.age = fsdb_->getAge(*obj);
+	encoder.encode(fso, obj_reply);
 
 	res.code_ = rina::cdap_rib::CDAP_SUCCESS;
 }
 
 const std::string FlowStateRIBObject::get_displayable_value() const
 {
-	return obj->toString();
+	FlowStateObject fso(*obj);
+
+	fso.age = fsdb_->getAge(*obj);
+	return fso.toString();
 }
 
 // CLASS FlowStateObjects
-FlowStateObjects::FlowStateObjects(LinkStateRoutingPolicy * ps)
+static long fso_now_ms()
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1000L + now.tv_nsec / 1000000L;
+}
+
+FlowStateObjects::FlowStateObjects(LinkStateRoutingPolicy * ps,
+				   IPCPRIBDaemon * rib_daemon)
 {
 	modified_ = false;
 	ps_ = ps;
+	rib_daemon_ = rib_daemon;
+	maximum_age = UINT_MAX;
+	age_increment = LinkStateRoutingPolicy::WAIT_UNTIL_AGE_INCREMENT_DEFAULT;
 	rina::rib::RIBObj *rib_objects = new FlowStateRIBObjects(this, ps);
-	IPCPRIBDaemon* rib_daemon = (IPCPRIBDaemon*)IPCPFactory::getIPCP()
-		->get_rib_daemon();
-	rib_daemon->addObjRIB(FlowStateRIBObjects::object_name, &rib_objects);
+	rib_daemon_->addObjRIB(FlowStateRIBObjects::object_name, &rib_objects);
 	wait_until_remove_object = 0;
 }
 
@@ -1037,9 +1486,7 @@ FlowStateObjects::~FlowStateObjects()
 		delete it->second;
 	}
 	objects.clear();
-	IPCPRIBDaemon* rib_daemon = (IPCPRIBDaemon*)IPCPFactory::getIPCP()
-		->get_rib_daemon();
-	rib_daemon->removeObjRIB(FlowStateRIBObjects::object_name);
+	rib_daemon_->removeObjRIB(FlowStateRIBObjects::object_name);
 }
 
 void FlowStateObjects::set_wait_until_remove_object(unsigned int wait_object)
@@ -1047,6 +1494,29 @@ void FlowStateObjects::set_wait_until_remove_object(unsigned int wait_object)
 	wait_until_remove_object = wait_object;
 }
 
+void FlowStateObjects::set_maximum_age(unsigned int max_age)
+{
+	rina::ScopedLock g(lock);
+	std::map<std::string, FlowStateObject *>::iterator it;
+	long now = fso_now_ms();
+
+	//Expiry times depend on the maximum age
+	for (it = objects.begin(); it != objects.end(); ++it)
+		it->second->age = getAge(*it->second);
+
+	maximum_age = max_age;
+
+	for (it = objects.begin(); it != objects.end(); ++it) {
+		it->second->expiry_queued = false;
+		refresh(it->second, now);
+	}
+}
+
+void FlowStateObjects::set_age_increment(unsigned int period)
+{
+	age_increment = period > 0 ? period : 1;
+}
+
 bool FlowStateObjects::addObject(const FlowStateObject& object)
 {
 	rina::ScopedLock g(lock);
@@ -1071,6 +1541,7 @@ void FlowStateObjects::addAddressToFSOs(const std::string& name,
 	rina::ScopedLock g(lock);
 	std::map<std::string, FlowStateObject *>::iterator it;
 	std::string my_name = IPCPFactory::getIPCP()->get_name();
+	long now = fso_now_ms();
 
 	for (it = objects.begin(); it != objects.end(); ++it) {
 		if (neighbor) {
@@ -1080,12 +1551,14 @@ void FlowStateObjects::addAddressToFSOs(const std::string& name,
 				it->second->modified = true;
 				it->second->age = 0;
 				it->second->seq_num = it->second->seq_num + 1;
+				refresh(it->second, now);
 			}
 		} else if (it->second->name == name) {
 			it->second->add_address(address);
 			it->second->modified = true;
 			it->second->age = 0;
 			it->second->seq_num = it->second->seq_num + 1;
+			refresh(it->second, now);
 		}
 	}
 
@@ -1099,6 +1572,7 @@ void FlowStateObjects::removeAddressFromFSOs(const std::string& name,
 	rina::ScopedLock g(lock);
 	std::map<std::string, FlowStateObject *>::iterator it;
 	std::string my_name = IPCPFactory::getIPCP()->get_name();
+	long now = fso_now_ms();
 
 	for (it = objects.begin(); it != objects.end(); ++it) {
 		if (neighbor) {
@@ -1108,12 +1582,14 @@ void FlowStateObjects::removeAddressFromFSOs(const std::string& name,
 				it->second->modified = true;
 				it->second->age = 0;
 				it->second->seq_num = it->second->seq_num + 1;
+				refresh(it->second, now);
 			}
 		} else if (it->second->name == name) {
 			it->second->remove_address(address);
 			it->second->modified = true;
 			it->second->age = 0;
 			it->second->seq_num = it->second->seq_num + 1;
+			refresh(it->second, now);
 		}
 	}
 
@@ -1129,13 +1605,15 @@ void FlowStateObjects::addCheckedObject(const FlowStateObject& object)
 						    object.seq_num,
 						    object.age);
 
+	fso->delay = object.delay;
+	fso->bandwidth = object.bandwidth;
 	fso->set_addresses(object.addresses);
 	fso->set_neighboraddresses(object.neighbor_addresses);
 
 	objects[object.object_name] = fso;
-	rina::rib::RIBObj* rib_obj = new FlowStateRIBObject(fso);
-	IPCPRIBDaemon* rib_daemon = (IPCPRIBDaemon*)IPCPFactory::getIPCP()->get_rib_daemon();
-	rib_daemon->addObjRIB(fso->object_name, &rib_obj);
+	refresh(fso, fso_now_ms());
+	rina::rib::RIBObj* rib_obj = new FlowStateRIBObject(fso, this);
+	rib_daemon_->addObjRIB(fso->object_name, &rib_obj);
 	modified_ = true;
 }
 
@@ -1149,6 +1627,7 @@ void FlowStateObjects::deprecateObject(const std::string& fqn,
 	if(it != objects.end())
 	{
 		it->second->deprecateObject(max_age);
+		refresh(it->second, fso_now_ms());
 	}
 }
 
@@ -1164,6 +1643,7 @@ void FlowStateObjects::deprecateObjects(const std::string& neigh_name,
 		if (it->second->neighbor_name == neigh_name &&
 				it->second->name == name) {
 			it->second->deprecateObject(max_age);
+			refresh(it->second, fso_now_ms());
 			modified_ = true;
 		}
 	}
@@ -1200,10 +1680,12 @@ void FlowStateObjects::deprecateObjectsWithName(const std::string& name,
 			++it) {
 		if (!neighbor && it->second->name == name) {
 			it->second->deprecateObject(max_age);
+			refresh(it->second, fso_now_ms());
 			modified_ = true;
 		} else if (neighbor && it->second->neighbor_name == name &&
 				it->second->name == my_name) {
 			it->second->deprecateObject(max_age);
+			refresh(it->second, fso_now_ms());
 			modified_ = true;
 		}
 	}
@@ -1221,11 +1703,10 @@ void FlowStateObjects::removeObject(const std::string& fqn)
 	if (it == objects.end())
 		return;
 
-	IPCPRIBDaemon* rib_daemon = (IPCPRIBDaemon*) IPCPFactory::getIPCP()->get_rib_daemon();
-	rib_daemon->removeObjRIB(it->second->object_name);
+	rib_daemon_->removeObjRIB(it->second->object_name);
 
-	objects.erase(it);
 	delete it->second;
+	objects.erase(it);
 }
 
 FlowStateObject* FlowStateObjects::getObject(const std::string& fqn)
@@ -1267,28 +1748,126 @@ void FlowStateObjects::getAllFSOs(std::list<FlowStateObject>& result)
 			= objects.begin(); it != objects.end();++it)
 	{
 		result.push_back(*(it->second));
+		result.back().age = getAge(*it->second);
 	}
 }
 
-void FlowStateObjects::incrementAge(unsigned int max_age, rina::Timer* timer)
+unsigned int FlowStateObjects::getAge(const FlowStateObject& obj) const
+{
+	unsigned long age;
+
+	if (obj.age >= maximum_age)
+		return obj.age;
+
+	age = obj.age + (fso_now_ms() - obj.refreshed) / age_increment;
+
+	return age < UINT_MAX ? age : UINT_MAX;
+}
+
+void FlowStateObjects::queueExpiry(const std::string& fqn, long when,
+				   bool removal)
+{
+	fso_expiry entry;
+
+	entry.when = when;
+	entry.fqn = fqn;
+	entry.removal = removal;
+	expiry_queue.push(entry);
+}
+
+void FlowStateObjects::refresh(FlowStateObject * obj, long now)
+{
+	long expiry;
+
+	obj->refreshed = now;
+	if (obj->age >= maximum_age) {
+		expiry = now;
+	} else {
+		//Alive again, cancel a pending removal
+		obj->being_erased = false;
+		expiry = now + (long)(maximum_age - obj->age) * age_increment;
+	}
+
+	//An entry due before the new expiry time is checked again when it
+	//is processed, so a new one is only needed if the object expires
+	//earlier
+	if (obj->expiry_queued && obj->queued_expiry <= expiry)
+		return;
+
+	obj->expiry_queued = true;
+	obj->queued_expiry = expiry;
+	queueExpiry(obj->object_name, expiry, false);
+}
+
+void FlowStateObjects::refreshObject(FlowStateObject * obj)
 {
 	rina::ScopedLock g(lock);
 
-	for (std::map<std::string, FlowStateObject *>::iterator
-		it = objects.begin(); it != objects.end(); ++it) 
+	refresh(obj, fso_now_ms());
+}
+
+void FlowStateObjects::expireObjects()
+{
+	std::map<std::string, FlowStateObject *>::iterator it;
+	std::list<std::string> to_remove;
+	std::list<std::string>::iterator rit;
+	FlowStateObject * obj;
+	fso_expiry entry;
+	long now = fso_now_ms();
+	long expiry;
+
 	{
-		if (it->second->age < UINT_MAX)
-			it->second->age = it->second->age + 1;
+		rina::ScopedLock g(lock);
+
+		while (!expiry_queue.empty() && expiry_queue.top().when <= now) {
+			entry = expiry_queue.top();
+			expiry_queue.pop();
 
-		if (it->second->age >= max_age && !it->second->being_erased) {
-			LOG_IPCP_DBG("Object to erase age: %d", it->second->age);
-			it->second->being_erased = true;
-			KillFlowStateObjectTimerTask* ksttask =
-				new KillFlowStateObjectTimerTask(ps_, it->second->object_name);
+			it = objects.find(entry.fqn);
+			if (it == objects.end())
+				continue;
+			obj = it->second;
+
+			if (entry.removal) {
+				//Unless the object has been refreshed since,
+				//and maybe marked again
+				if (obj->being_erased &&
+						obj->erase_due == entry.when)
+					to_remove.push_back(entry.fqn);
+				continue;
+			}
 
-			timer->scheduleTask(ksttask, wait_until_remove_object);
+			//Superseded by an entry with an earlier expiry time
+			if (!obj->expiry_queued || obj->queued_expiry != entry.when)
+				continue;
+			obj->expiry_queued = false;
+
+			if (obj->being_erased)
+				continue;
+
+			if (obj->age < maximum_age) {
+				expiry = obj->refreshed +
+					(long)(maximum_age - obj->age) * age_increment;
+				if (expiry > now) {
+					obj->expiry_queued = true;
+					obj->queued_expiry = expiry;
+					queueExpiry(entry.fqn, expiry, false);
+					continue;
+				}
+			}
+
+			LOG_IPCP_DBG("Object to erase age: %u", getAge(*obj));
+			obj->being_erased = true;
+			obj->erase_due = now + wait_until_remove_object;
+			queueExpiry(entry.fqn, obj->erase_due, true);
 		}
 	}
+
+	for (rit = to_remove.begin(); rit != to_remove.end(); ++rit)
+		removeObject(*rit);
+
+	if (!to_remove.empty())
+		modified_ = true;
 }
 
 void FlowStateObjects::updateObject(const std::string& fqn, 
@@ -1307,6 +1886,7 @@ void FlowStateObjects::updateObject(const std::string& fqn,
 	obj->state_up = true;
 	obj->seq_num = 1;
 	obj->modified = true;
+	refresh(obj, fso_now_ms());
 }
 
 void FlowStateObjects::encodeAllFSOs(rina::ser_obj_t& obj)
@@ -1321,6 +1901,7 @@ void FlowStateObjects::encodeAllFSOs(rina::ser_obj_t& obj)
 			= objects.begin(); it != objects.end();++it)
 		{
 			result.push_back(*(it->second));
+			result.back().age = getAge(*it->second);
 		}
 		encoder.encode(result, obj);
 	}
@@ -1349,6 +1930,7 @@ void FlowStateObjects::getAllFSOsForPropagation(std::list< std::list<FlowStateOb
 		}
 
 		fsolist.push_back(*(it->second));
+		fsolist.back().age = getAge(*it->second);
 	}
 
 	if (fsolist.size() != 0) {
@@ -1361,6 +1943,20 @@ bool FlowStateObjects::is_modified() const
 	return modified_;
 }
 
+bool FlowStateObjects::isStale(const std::string& fqn,
+			       unsigned int seq_num,
+			       bool self_generated)
+{
+	rina::ScopedLock g(lock);
+	std::map<std::string, FlowStateObject*>::iterator it =
+		objects.find(fqn);
+
+	if (it == objects.end())
+		return self_generated;
+
+	return seq_num <= it->second->seq_num;
+}
+
 //Class FlowStateRIBObjects
 const std::string FlowStateRIBObjects::clazz_name = "FlowStateObjects";
 const std::string FlowStateRIBObjects::object_name= "/ra/fsos";
@@ -1395,9 +1991,46 @@ void FlowStateRIBObjects::write(const rina::cdap_rib::con_handle_t &con,
 {
 	FlowStateObjectListEncoder encoder;
 	std::list<FlowStateObject> new_objects;
-	encoder.decode(obj_req, new_objects);
-	ps_->updateObjects(new_objects,
-			   con.port_id);
+	unsigned int dropped;
+
+	//Neighbors flood the same FSOs, only the newer ones are applied
+	dropped = encoder.decodeNewObjects(obj_req, *objs,
+					   IPCPFactory::getIPCP()->get_name(),
+					   new_objects);
+	ps_->accountReceivedFSOs(new_objects.size() + dropped, dropped);
+	if (new_objects.empty())
+		return;
+
+	ps_->scheduleUpdateObjects(new_objects,
+				   con.port_id);
+}
+
+//Class FSOPropagationStatsRIBObj
+const std::string FSOPropagationStatsRIBObj::class_name = "FlowStateObjectPropagation";
+const std::string FSOPropagationStatsRIBObj::object_name = "/ra/fsopropagation";
+
+FSOPropagationStatsRIBObj::FSOPropagationStatsRIBObj(const fso_propagation_stats * st)
+	: rina::rib::RIBObj(class_name), stats(st)
+{
+}
+
+const std::string FSOPropagationStatsRIBObj::get_displayable_value() const
+{
+	std::stringstream ss;
+
+	ss << "Sent: " << __atomic_load_n(&stats->messages, __ATOMIC_RELAXED)
+	   << " messages, "
+	   << __atomic_load_n(&stats->bytes, __ATOMIC_RELAXED)
+	   << " bytes, from "
+	   << __atomic_load_n(&stats->encoded_groups, __ATOMIC_RELAXED)
+	   << " encoded groups" << std::endl;
+	ss << "Received: "
+	   << __atomic_load_n(&stats->received, __ATOMIC_RELAXED)
+	   << " FSOs, "
+	   << __atomic_load_n(&stats->dropped, __ATOMIC_RELAXED)
+	   << " stale duplicates dropped";
+
+	return ss.str();
 }
 
 // CLASS FlowStateManager
@@ -1409,7 +2042,8 @@ FlowStateManager::FlowStateManager(rina::Timer *new_timer,
 				   LinkStateRoutingPolicy * ps)
 {
 	maximum_age = max_age;
-	fsos = new FlowStateObjects(ps);
+	fsos = new FlowStateObjects(ps, (IPCPRIBDaemon*)IPCPFactory::getIPCP()
+					->get_rib_daemon());
 	timer = new_timer;
 }
 
@@ -1430,6 +2064,8 @@ bool FlowStateManager::addNewFSO(const std::string& name,
 				 const std::string& neighbor_name,
 				 std::list<unsigned int>& neighbor_addresses,
 				 unsigned int cost,
+				 unsigned int delay,
+				 unsigned int bandwidth,
 				 int avoid_port)
 {
 	FlowStateObject newObject(name,
@@ -1439,6 +2075,9 @@ bool FlowStateManager::addNewFSO(const std::string& name,
 				  1,
 				  0);
 
+	newObject.delay = delay;
+	newObject.bandwidth = bandwidth;
+
 	newObject.set_addresses(addresses);
 	newObject.set_neighboraddresses(neighbor_addresses);
 
@@ -1457,9 +2096,9 @@ void FlowStateManager::removeAddressFromFSOs(const std::string& name,
 	fsos->removeAddressFromFSOs(name, address, neighbor);
 }
 
-void FlowStateManager::incrementAge()
+void FlowStateManager::expireObjects()
 {
-	fsos->incrementAge(maximum_age, timer);
+	fsos->expireObjects();
 }
 
 void FlowStateManager::updateObjects(const std::list<FlowStateObject>& newObjects,
@@ -1497,6 +2136,9 @@ void FlowStateManager::updateObjects(const std::list<FlowStateObject>& newObject
 					obj_to_up->avoid_port = NO_AVOID_PORT;
 					obj_to_up->age = 0;
 					obj_to_up->cost = newIt->cost;
+					obj_to_up->delay = newIt->delay;
+					obj_to_up->bandwidth = newIt->bandwidth;
+					fsos->refreshObject(obj_to_up);
 				} else {
 					obj_to_up->avoid_port = avoidPort;
 					if (newIt->age >= maximum_age) {
@@ -1507,7 +2149,10 @@ void FlowStateManager::updateObjects(const std::list<FlowStateObject>& newObject
 						obj_to_up->set_addresses(newIt->addresses);
 						obj_to_up->set_neighboraddresses(newIt->neighbor_addresses);
 						obj_to_up->cost = newIt->cost;
+						obj_to_up->delay = newIt->delay;
+						obj_to_up->bandwidth = newIt->bandwidth;
 					}
+					fsos->refreshObject(obj_to_up);
 				}
 
 				obj_to_up->modified = true;
@@ -1530,49 +2175,40 @@ void FlowStateManager::updateObjects(const std::list<FlowStateObject>& newObject
 	}
 }
 
-void FlowStateManager::prepareForPropagation(std::map<int, std::list< std::list<FlowStateObject> > >&  to_propagate,
+void FlowStateManager::prepareForPropagation(std::list<FSOPropagationBatch>& batches,
 					     unsigned int max_objects) const
 {
-	std::list<FlowStateObject> newfsolist;
-	bool added = false;
+	std::map<int, FSOPropagationBatch *> open_batches;
+	std::map<int, FSOPropagationBatch *>::iterator it2;
+	FSOPropagationBatch * batch;
 
 	//1 Get the FSOs to propagate
 	std::list<FlowStateObject *> modifiedFSOs;
 	fsos->getModifiedFSOs(modifiedFSOs);
 
-	//2 add each modified object to its port list
+	//2 add each modified object to a batch with the same avoid port
 	for (std::list<FlowStateObject*>::iterator it = modifiedFSOs.begin();
 			it != modifiedFSOs.end(); ++it)
 	{
-		LOG_DBG("Propagation: Check modified object %s with age %d and status %d",
+		LOG_DBG("Propagation: Check modified object %s with age %u and status %d",
 			(*it)->object_name.c_str(),
-			(*it)->age,
+			fsos->getAge(**it),
 			(*it)->state_up);
 
-		for(std::map<int, std::list< std::list<FlowStateObject> > >::iterator it2 =
-				to_propagate.begin(); it2 != to_propagate.end(); ++it2)
-		{
-			if(it2->first != (*it)->avoid_port)
-			{
-				added = false;
-				newfsolist.clear();
-
-				for(std::list< std::list<FlowStateObject> >::iterator it3 = it2->second.begin();
-						it3 != it2->second.end(); ++it3) {
-					if (it3->size() < max_objects) {
-						it3->push_back(**it);
-						added = true;
-						break;
-					}
-				}
-
-				if (!added) {
-					newfsolist.push_back(**it);
-					it2->second.push_back(newfsolist);
-				}
-			}
+		it2 = open_batches.find((*it)->avoid_port);
+		if (it2 == open_batches.end() ||
+				it2->second->objects.size() >= max_objects) {
+			batches.push_back(FSOPropagationBatch());
+			batch = &batches.back();
+			batch->avoid_port = (*it)->avoid_port;
+			open_batches[batch->avoid_port] = batch;
+		} else {
+			batch = it2->second;
 		}
 
+		batch->objects.push_back(**it);
+		batch->objects.back().age = fsos->getAge(**it);
+
 		(*it)->modified = false;
 		(*it)->avoid_port = NO_AVOID_PORT;
 	}
@@ -1591,6 +2227,12 @@ void FlowStateManager::encodeAllFSOs(rina::ser_obj_t& obj) const
 void FlowStateManager::set_maximum_age(unsigned int max_age)
 {
 	maximum_age = max_age;
+	fsos->set_maximum_age(max_age);
+}
+
+void FlowStateManager::set_age_increment(unsigned int period)
+{
+	fsos->set_age_increment(period);
 }
 
 void FlowStateManager::set_wait_until_remove_object(unsigned int wait_object)
@@ -1651,7 +2293,9 @@ ComputeRoutingTimerTask::ComputeRoutingTimerTask(
 
 void ComputeRoutingTimerTask::run()
 {
-	lsr_policy_->routingTableUpdate();
+	//The computation itself runs in the routing stage, so that it
+	//does not delay the rest of the timer tasks
+	lsr_policy_->scheduleRoutingTableUpdate();
 
 	if (delay_ < 0) {
 		return;
@@ -1664,15 +2308,51 @@ void ComputeRoutingTimerTask::run()
 	lsr_policy_->timer_->scheduleTask(task, delay_);
 }
 
-KillFlowStateObjectTimerTask::KillFlowStateObjectTimerTask(LinkStateRoutingPolicy *ps, std::string fqn)
+// RoutingTableUpdateTask
+RoutingTableUpdateTask::RoutingTableUpdateTask(LinkStateRoutingPolicy * lsr_policy)
 {
-	ps_ = ps;
-	fqn_ = fqn;
+	lsr_policy_ = lsr_policy;
+	__atomic_add_fetch(&lsr_policy_->stage_tasks_, 1, __ATOMIC_RELAXED);
+}
+
+RoutingTableUpdateTask::~RoutingTableUpdateTask() throw()
+{
+	__atomic_sub_fetch(&lsr_policy_->stage_tasks_, 1, __ATOMIC_RELEASE);
+}
+
+void RoutingTableUpdateTask::run()
+{
+	if (__atomic_load_n(&lsr_policy_->stopping_, __ATOMIC_ACQUIRE))
+		return;
+
+	//Requests arriving from now on need another computation
+	__atomic_store_n(&lsr_policy_->rt_update_pending_, false,
+			 __ATOMIC_RELEASE);
+	lsr_policy_->routingTableUpdate();
+}
+
+// UpdateFSOsTask
+UpdateFSOsTask::UpdateFSOsTask(LinkStateRoutingPolicy * lsr_policy,
+			       const std::list<FlowStateObject>& objects,
+			       unsigned int avoid_port)
+{
+	lsr_policy_ = lsr_policy;
+	objects_ = objects;
+	avoid_port_ = avoid_port;
+	__atomic_add_fetch(&lsr_policy_->stage_tasks_, 1, __ATOMIC_RELAXED);
+}
+
+UpdateFSOsTask::~UpdateFSOsTask() throw()
+{
+	__atomic_sub_fetch(&lsr_policy_->stage_tasks_, 1, __ATOMIC_RELEASE);
 }
 
-void KillFlowStateObjectTimerTask::run()
+void UpdateFSOsTask::run()
 {
-	ps_->removeFlowStateObject(fqn_);
+	if (__atomic_load_n(&lsr_policy_->stopping_, __ATOMIC_ACQUIRE))
+		return;
+
+	lsr_policy_->updateObjects(objects_, avoid_port_);
 }
 
 PropagateFSODBTimerTask::PropagateFSODBTimerTask(
@@ -1739,14 +2419,20 @@ const int LinkStateRoutingPolicy::MAXIMUM_BUFFER_SIZE = 4096;
 const std::string LinkStateRoutingPolicy::DIJKSTRA_ALG = "Dijkstra";
 const std::string LinkStateRoutingPolicy::ECMP_DIJKSTRA_ALG = "ECMPDijkstra";
 const std::string LinkStateRoutingPolicy::MAXIMUM_OBJECTS_PER_ROUTING_UPDATE = "maxObjectsPerUpdate";
+const std::string LinkStateRoutingPolicy::SNAPSHOT_SECTION = "fsdb";
+const std::string LinkStateRoutingPolicy::CUBE_METRIC = "metric";
 
 LinkStateRoutingPolicy::LinkStateRoutingPolicy(IPCProcess * ipcp)
 {
 	test_ = false;
+	rt_update_pending_ = false;
+	stage_tasks_ = 0;
+	stopping_ = false;
 	ipc_process_ = ipcp;
 	rib_daemon_ = ipc_process_->rib_daemon_;
 	routing_algorithm_ = 0;
 	resiliency_algorithm_ = 0;
+	spf_pool_ = 0;
 	db_ = 0;
 	wait_until_deprecate_address_ = 0;
 	max_objects_per_rupdate_ = MAX_OBJECTS_PER_ROUTING_UPDATE_DEFAULT;
@@ -1754,14 +2440,48 @@ LinkStateRoutingPolicy::LinkStateRoutingPolicy(IPCProcess * ipcp)
 	subscribeToEvents();
 	timer_ = new rina::Timer();
 	db_ = new FlowStateManager(timer_, UINT_MAX, this);
+
+	try {
+		rina::rib::RIBObj * tmp =
+			new FSOPropagationStatsRIBObj(&prop_stats_);
+		rib_daemon_->addObjRIB(FSOPropagationStatsRIBObj::object_name,
+				       &tmp);
+	} catch (rina::Exception &e) {
+		LOG_IPCP_ERR("Problems adding object to the RIB : %s",
+			     e.what());
+	}
+
+	ipc_process_->enrollment_task_->add_snapshot_section(SNAPSHOT_SECTION,
+							     this);
 }
 
 LinkStateRoutingPolicy::~LinkStateRoutingPolicy()
 {
+	rina::Sleep sleep;
+
+	__atomic_store_n(&stopping_, true, __ATOMIC_RELEASE);
+
+	ipc_process_->enrollment_task_->remove_snapshot_section(SNAPSHOT_SECTION);
+
 	delete timer_;
+
+	//The routing stage may still hold tasks that refer to the policy
+	//(e.g. when the policy set is replaced), wait until they are gone
+	while (__atomic_load_n(&stage_tasks_, __ATOMIC_ACQUIRE) > 0)
+		sleep.sleepForMili(1);
+	delete spf_pool_;
 	delete routing_algorithm_;
 	delete resiliency_algorithm_;
+	for (std::list<cube_routing>::iterator it = cube_routing_.begin();
+			it != cube_routing_.end(); ++it) {
+		delete it->request.algorithm;
+	}
 	delete db_;
+
+	try {
+		rib_daemon_->removeObjRIB(FSOPropagationStatsRIBObj::object_name);
+	} catch (rina::Exception &e) {
+	}
 }
 
 void LinkStateRoutingPolicy::subscribeToEvents()
@@ -1780,11 +2500,61 @@ void LinkStateRoutingPolicy::subscribeToEvents()
 		subscribeToEvent(rina::InternalEvent::NEIGHBOR_ADDRESS_CHANGE, this);
 }
 
+IRoutingAlgorithm * LinkStateRoutingPolicy::createRoutingAlgorithm(const std::string& name) const
+{
+        if (name == DIJKSTRA_ALG) {
+                LOG_IPCP_DBG("Using Dijkstra as routing algorithm");
+        	return new DijkstraAlgorithm();
+        } else if (name == ECMP_DIJKSTRA_ALG)  {
+                LOG_IPCP_DBG("Using ECMP Dijkstra as routing algorithm");
+                return new ECMPDijkstraAlgorithm();
+        }
+
+        throw rina::Exception("Unsupported routing algorithm");
+}
+
+void LinkStateRoutingPolicy::parseCubeMetrics(const rina::PolicyConfig& psconf,
+					      std::map<int, link_metric_t>& metrics)
+{
+	std::list<rina::PolicyParameter>::const_iterator it;
+	std::string suffix = "." + CUBE_METRIC;
+	std::string eqos_id;
+	int qos_id;
+
+	for (it = psconf.parameters_.begin();
+			it != psconf.parameters_.end(); ++it) {
+		if (it->name_.size() <= suffix.size() ||
+				it->name_.compare(it->name_.size() - suffix.size(),
+						  suffix.size(), suffix) != 0) {
+			continue;
+		}
+
+		eqos_id = it->name_.substr(0, it->name_.size() - suffix.size());
+		if (rina::string2int(eqos_id, qos_id) || qos_id <= 0) {
+			LOG_WARN("Could not parse qos_id: %s", eqos_id.c_str());
+			continue;
+		}
+
+		if (it->value_ == "cost") {
+			metrics[qos_id] = LINK_METRIC_COST;
+		} else if (it->value_ == "delay") {
+			metrics[qos_id] = LINK_METRIC_DELAY;
+		} else if (it->value_ == "bandwidth") {
+			metrics[qos_id] = LINK_METRIC_BANDWIDTH;
+		} else {
+			LOG_WARN("Unknown link metric %s for qos-id %d",
+				 it->value_.c_str(), qos_id);
+		}
+	}
+}
+
 void LinkStateRoutingPolicy::set_dif_configuration(
 		const rina::DIFConfiguration& dif_configuration)
 {
 	std::string routing_alg;
         rina::PolicyConfig psconf;
+        std::map<int, link_metric_t> metrics;
+        std::map<int, link_metric_t>::iterator mit;
         long delay;
 
         psconf = dif_configuration.routing_configuration_.policy_set_;
@@ -1796,19 +2566,31 @@ void LinkStateRoutingPolicy::set_dif_configuration(
         	routing_alg = DIJKSTRA_ALG;
         }
 
-        if (routing_alg == DIJKSTRA_ALG) {
-        	routing_algorithm_ = new DijkstraAlgorithm();
-                LOG_IPCP_DBG("Using Dijkstra as routing algorithm");
-        } else if (routing_alg == ECMP_DIJKSTRA_ALG)  {
-                routing_algorithm_ = new ECMPDijkstraAlgorithm();
-                LOG_IPCP_DBG("Using ECMP Dijkstra as routing algorithm");
-        } else {
-        	throw rina::Exception("Unsupported routing algorithm");
-        }
+        routing_algorithm_ = createRoutingAlgorithm(routing_alg);
 #if 0
 	resiliency_algorithm_ = new LoopFreeAlternateAlgorithm(*routing_algorithm_);
 #endif
 
+	// QoS cubes with their own link metric get their own instance of
+	// the routing algorithm, so that they can be run in parallel
+	parseCubeMetrics(psconf, metrics);
+	for (mit = metrics.begin(); mit != metrics.end(); ++mit) {
+		cube_routing cube;
+
+		cube.qos_id = mit->first;
+		cube.request.metric = mit->second;
+		cube.request.algorithm = createRoutingAlgorithm(routing_alg);
+		cube_routing_.push_back(cube);
+		LOG_IPCP_INFO("QoS cube %d routed with link metric %d",
+			      mit->first, mit->second);
+	}
+
+	if (!cube_routing_.empty()) {
+		spf_pool_ = new SPFWorkerPool(std::min<unsigned int>(
+				SPFWorkerPool::default_workers(),
+				cube_routing_.size()), "routing-spf");
+	}
+
 
 	if (!test_) {
 		try {
@@ -1845,6 +2627,7 @@ void LinkStateRoutingPolicy::set_dif_configuration(
 		} catch (rina::Exception &e) {
 			delay = WAIT_UNTIL_AGE_INCREMENT_DEFAULT;
 		}
+		db_->set_age_increment(delay);
 		UpdateAgeTimerTask * uattask = new UpdateAgeTimerTask(this, delay);
 		timer_->scheduleTask(uattask, delay);
 
@@ -1873,32 +2656,39 @@ void LinkStateRoutingPolicy::eventHappened(rina::InternalEvent * event)
 	if (!event)
 		return;
 
-	rina::ScopedLock g(lock_);
-
-	if (event->type == rina::InternalEvent::APP_N_MINUS_1_FLOW_DEALLOCATED) {
-			rina::NMinusOneFlowDeallocatedEvent * flowEvent =
-				(rina::NMinusOneFlowDeallocatedEvent *) event;
-			processFlowDeallocatedEvent(flowEvent);
-	} else if (event->type == rina::InternalEvent::APP_N_MINUS_1_FLOW_ALLOCATED) {
-			rina::NMinusOneFlowAllocatedEvent * flowEvent =
-				(rina::NMinusOneFlowAllocatedEvent *) event;
-			processFlowAllocatedEvent(flowEvent);
-	} else if (event->type == rina::InternalEvent::APP_NEIGHBOR_ADDED) {
-			rina::NeighborAddedEvent * neighEvent = (rina::NeighborAddedEvent *) event;
-			processNeighborAddedEvent(neighEvent);
-	} else if (event->type == rina::InternalEvent::APP_CONNECTIVITY_TO_NEIGHBOR_LOST) {
-			rina::ConnectiviyToNeighborLostEvent * neighEvent =
-					(rina::ConnectiviyToNeighborLostEvent *) event;
-			processNeighborLostEvent(neighEvent);
-	} else if (event->type == rina::InternalEvent::ADDRESS_CHANGE) {
-		rina::AddressChangeEvent * addrEvent =
-			(rina::AddressChangeEvent *) event;
-		processAddressChangeEvent(addrEvent);
-	} else if (event->type == rina::InternalEvent::NEIGHBOR_ADDRESS_CHANGE) {
-		rina::NeighborAddressChangeEvent * addrEvent =
-			(rina::NeighborAddressChangeEvent *) event;
-		processNeighborAddressChangeEvent(addrEvent);
+	{
+		rina::ScopedLock g(lock_);
+
+		if (event->type == rina::InternalEvent::APP_N_MINUS_1_FLOW_DEALLOCATED) {
+				rina::NMinusOneFlowDeallocatedEvent * flowEvent =
+					(rina::NMinusOneFlowDeallocatedEvent *) event;
+				processFlowDeallocatedEvent(flowEvent);
+		} else if (event->type == rina::InternalEvent::APP_N_MINUS_1_FLOW_ALLOCATED) {
+				rina::NMinusOneFlowAllocatedEvent * flowEvent =
+					(rina::NMinusOneFlowAllocatedEvent *) event;
+				processFlowAllocatedEvent(flowEvent);
+		} else if (event->type == rina::InternalEvent::APP_NEIGHBOR_ADDED) {
+				rina::NeighborAddedEvent * neighEvent = (rina::NeighborAddedEvent *) event;
+				processNeighborAddedEvent(neighEvent);
+		} else if (event->type == rina::InternalEvent::APP_CONNECTIVITY_TO_NEIGHBOR_LOST) {
+				rina::ConnectiviyToNeighborLostEvent * neighEvent =
+						(rina::ConnectiviyToNeighborLostEvent *) event;
+				processNeighborLostEvent(neighEvent);
+		} else if (event->type == rina::InternalEvent::ADDRESS_CHANGE) {
+			rina::AddressChangeEvent * addrEvent =
+				(rina::AddressChangeEvent *) event;
+			processAddressChangeEvent(addrEvent);
+		} else if (event->type == rina::InternalEvent::NEIGHBOR_ADDRESS_CHANGE) {
+			rina::NeighborAddressChangeEvent * addrEvent =
+				(rina::NeighborAddressChangeEvent *) event;
+			processNeighborAddressChangeEvent(addrEvent);
+		}
 	}
+
+	//The routing table towards the new neighbor is computed by
+	//the routing stage, which takes the lock
+	if (event->type == rina::InternalEvent::APP_NEIGHBOR_ADDED)
+		scheduleRoutingTableUpdate();
 }
 
 void LinkStateRoutingPolicy::processAddressChangeEvent(rina::AddressChangeEvent * event)
@@ -1949,6 +2739,10 @@ void LinkStateRoutingPolicy::processFlowDeallocatedEvent(
 	LOG_IPCP_DBG("N-1 Flow with neighbor lost");
 	//TODO update cost
 
+	lock_.lock();
+	snapshot_ports_.erase(event->port_id_);
+	lock_.unlock();
+
 	//Force a routing table update
 	db_->force_table_update();
 }
@@ -1978,6 +2772,16 @@ void LinkStateRoutingPolicy::processNeighborAddedEvent(rina::NeighborAddedEvent
 	int portId = event->neighbor_.get_underlying_port_id();
 	std::list<unsigned int> addresses;
 	std::list<unsigned int> neigh_addresses;
+	rina::FlowSpecification fspec;
+
+	//Advertise the delay and bandwidth of the N-1 flow, so that the QoS
+	//cubes routed by them can use it
+	try {
+		fspec = ipc_process_->resource_allocator_->get_n_minus_one_flow_manager()->
+				getNMinus1FlowInformation(portId).flowSpecification;
+	} catch (rina::Exception &e) {
+		LOG_IPCP_DBG("No N-1 flow information for port-id %d", portId);
+	}
 
 	LOG_IPCP_DBG("Adding new FSO to neighbor");
 	try {
@@ -1991,6 +2795,8 @@ void LinkStateRoutingPolicy::processNeighborAddedEvent(rina::NeighborAddedEvent
 				event->neighbor_.get_name().processName,
 				neigh_addresses,
 				1,
+				fspec.delay,
+				fspec.averageBandwidth,
 				portId);
 	} catch (rina::Exception &e) {
 		LOG_IPCP_ERR("Could not allocate the flow, no neighbor found");
@@ -2001,97 +2807,161 @@ void LinkStateRoutingPolicy::processNeighborAddedEvent(rina::NeighborAddedEvent
 				ipc_process_->get_name(), 10000);
 	}
 
+	//Neighbors that got the FSDB in the enrollment snapshot only need
+	//the changes from now on
+	lock_.lock();
+	bool has_snapshot = snapshot_ports_.erase(portId) > 0;
+	lock_.unlock();
+	if (has_snapshot) {
+		LOG_IPCP_DBG("Neighbor at port-id %d has the FSDB already", portId);
+		db_->force_table_update();
+		return;
+	}
+
 	std::list< std::list<FlowStateObject> > all_fsos;
 	FlowStateObjectListEncoder encoder;
 	db_->getAllFSOsForPropagation(all_fsos, max_objects_per_rupdate_);
 	for (std::list< std::list<FlowStateObject> >::iterator it = all_fsos.begin();
 			it != all_fsos.end(); ++it) {
+		rina::cdap_rib::obj_info_t obj;
+		obj.class_ = FlowStateRIBObjects::clazz_name;
+		obj.name_ = FlowStateRIBObjects::object_name;
+		obj.inst_ = 0;
 		try {
-			rina::cdap_rib::obj_info_t obj;
-			rina::cdap_rib::con_handle_t con;
-			obj.class_ = FlowStateRIBObjects::clazz_name;
-			obj.name_ = FlowStateRIBObjects::object_name;
 			encoder.encode(*it, obj.value_);
-			obj.inst_ = 0;
-			rina::cdap_rib::flags_t flags;
-			rina::cdap_rib::filt_info_t filt;
-			con.port_id = portId;
-			if (obj.value_.size_ != 0)
-				rib_daemon_->getProxy()->remote_write(con,
-						obj,
-						flags,
-						filt,
-						0);
 		} catch (rina::Exception &e) {
-			LOG_IPCP_ERR("Problems encoding and sending CDAP message: %s", e.what());
+			LOG_IPCP_ERR("Problems encoding CDAP message: %s", e.what());
+			continue;
 		}
+		__atomic_add_fetch(&prop_stats_.encoded_groups, 1,
+				   __ATOMIC_RELAXED);
+		writeFSOGroup(obj, portId);
 	}
 
 	//Force a routing table update
 	db_->force_table_update();
-	_routingTableUpdate();
+}
+
+void LinkStateRoutingPolicy::get_snapshot(int port_id, rina::ser_obj_t& result)
+{
+	std::list< std::list<FlowStateObject> > all_fsos;
+	FlowStateObjectListEncoder encoder;
+
+	db_->getAllFSOsForPropagation(all_fsos, UINT_MAX);
+	if (all_fsos.empty())
+		all_fsos.push_back(std::list<FlowStateObject>());
+	encoder.encode(all_fsos.front(), result);
+}
+
+void LinkStateRoutingPolicy::snapshot_sent(int port_id)
+{
+	rina::ScopedLock g(lock_);
+	snapshot_ports_.insert(port_id);
+}
+
+void LinkStateRoutingPolicy::apply_snapshot(int port_id,
+					    const rina::ser_obj_t& snapshot)
+{
+	std::list<FlowStateObject> objects;
+	FlowStateObjectListEncoder encoder;
+
+	encoder.decode(snapshot, objects);
+	accountReceivedFSOs(objects.size(), 0);
+	updateObjects(objects, port_id);
+
+	rina::ScopedLock g(lock_);
+	snapshot_ports_.insert(port_id);
+}
+
+void LinkStateRoutingPolicy::writeFSOGroup(const rina::cdap_rib::obj_info_t& obj,
+					   int port_id)
+{
+	rina::cdap_rib::con_handle_t con;
+	rina::cdap_rib::flags_t flags;
+	rina::cdap_rib::filt_info_t filter;
+
+	if (obj.value_.size_ == 0)
+		return;
+
+	con.port_id = port_id;
+	try {
+		rib_daemon_->getProxy()->remote_write(con,
+						      obj,
+						      flags,
+						      filter,
+						      0);
+	} catch (rina::Exception &e) {
+		LOG_IPCP_ERR("Errors sending message: %s", e.what());
+		return;
+	}
+
+	__atomic_add_fetch(&prop_stats_.messages, 1, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&prop_stats_.bytes, obj.value_.size_,
+			   __ATOMIC_RELAXED);
 }
 
 void LinkStateRoutingPolicy::propagateFSDB()
 {
 	rina::ScopedLock g(lock_);
+	std::list<FSOPropagationBatch> batches;
 
 	//1 Get the active N-1 flows
 	std::list<int> n1_ports =
 			ipc_process_->resource_allocator_->get_n_minus_one_flow_manager()->getManagementFlowsToAllNeighbors();
-	//2 Initialize the map
-	std::map <int, std::list< std::list<FlowStateObject> > > objectsToSend;
-	for(std::list<int>::iterator it = n1_ports.begin();
-		it != n1_ports.end(); ++it)
-	{
-		objectsToSend[*it] = std::list< std::list<FlowStateObject> >();
-	}
 
-	//3 Get the objects to send
-	db_->prepareForPropagation(objectsToSend, max_objects_per_rupdate_);
+	//2 Get the objects to send
+	db_->prepareForPropagation(batches, max_objects_per_rupdate_);
 
-	if (objectsToSend.size() == 0) {
+	if (batches.empty() || n1_ports.empty()) {
 		return;
 	}
 
+	//3 Encode each batch once, and write it to the N-1 flows
+	writeFSOBatches(batches, n1_ports, *this, prop_stats_);
+}
+
+void LinkStateRoutingPolicy::writeFSOBatches(const std::list<FSOPropagationBatch>& batches,
+					     const std::list<int>& n1_ports,
+					     FSOGroupWriter& writer,
+					     fso_propagation_stats& stats)
+{
 	FlowStateObjectListEncoder encoder;
-	rina::cdap_rib::con_handle_t con;
-	for (std::map<int, std::list< std::list<FlowStateObject> > >::iterator it = objectsToSend.begin();
-		it != objectsToSend.end(); ++it)
 
-	{
-		if (it->second.size() == 0)
+	for (std::list<FSOPropagationBatch>::const_iterator it = batches.begin();
+			it != batches.end(); ++it) {
+		rina::cdap_rib::obj_info_t obj;
+		obj.class_ = FlowStateRIBObjects::clazz_name;
+		obj.name_ = FlowStateRIBObjects::object_name;
+		obj.inst_ = 0;
+		try {
+			encoder.encode(it->objects, obj.value_);
+		} catch (rina::Exception &e) {
+			LOG_IPCP_ERR("Errors encoding message: %s", e.what());
 			continue;
+		}
+		__atomic_add_fetch(&stats.encoded_groups, 1,
+				   __ATOMIC_RELAXED);
 
-		for (std::list< std::list<FlowStateObject> >::iterator it2 = it->second.begin();
-				it2 != it->second.end(); ++it2) {
-			rina::cdap_rib::flags flags;
-			rina::cdap_rib::filt_info_t filter;
-			try
-			{
-				rina::cdap_rib::object_info obj;
-				obj.class_ = FlowStateRIBObjects::clazz_name;
-				obj.name_ = FlowStateRIBObjects::object_name;
-				encoder.encode(*it2, obj.value_);
-				con.port_id = it->first;
-				rib_daemon_->getProxy()->remote_write(con,
-						obj,
-						flags,
-						filter,
-						0);
-			}
-			catch (rina::Exception &e)
-			{
-				LOG_IPCP_ERR("Errors sending message: %s", e.what());
-			}
+		for (std::list<int>::const_iterator it2 = n1_ports.begin();
+				it2 != n1_ports.end(); ++it2) {
+			if (*it2 == it->avoid_port)
+				continue;
+
+			writer.writeFSOGroup(obj, *it2);
 		}
 	}
 }
 
+void LinkStateRoutingPolicy::accountReceivedFSOs(unsigned int received,
+						 unsigned int dropped)
+{
+	prop_stats_.account_received(received, dropped);
+}
+
 void LinkStateRoutingPolicy::updateAge()
 {
 	rina::ScopedLock g(lock_);
-	db_->incrementAge();
+	db_->expireObjects();
 }
 
 void LinkStateRoutingPolicy::printNhopTable(std::list<rina::RoutingTableEntry *>& rt)
@@ -2166,6 +3036,18 @@ void LinkStateRoutingPolicy::routingTableUpdate()
 	_routingTableUpdate();
 }
 
+void LinkStateRoutingPolicy::scheduleRoutingTableUpdate()
+{
+	if (__atomic_load_n(&stopping_, __ATOMIC_ACQUIRE))
+		return;
+
+	if (__atomic_exchange_n(&rt_update_pending_, true, __ATOMIC_ACQ_REL))
+		return;
+
+	ipc_process_->execute_task(IPCP_STAGE_ROUTING,
+				   new RoutingTableUpdateTask(this));
+}
+
 void LinkStateRoutingPolicy::_routingTableUpdate()
 {
 	std::list<rina::RoutingTableEntry *> rt;
@@ -2178,24 +3060,28 @@ void LinkStateRoutingPolicy::_routingTableUpdate()
 
 	db_->getAllFSOs(flow_state_objects);
 
-	// Build a graph out of the FSO database
-	Graph graph(flow_state_objects);
-
-	// Invoke the routing algorithm to compute the routing table
-	// Main arguments are the graph and the source vertex.
-	// The list of FSOs may be useless, but has been left there
-	// for the moment (and it is currently unused by the Dijkstra
-	// algorithm).
-	routing_algorithm_->computeRoutingTable(graph,
-						flow_state_objects,
-						my_name,
-						rt);
-
-	// Run the resiliency algorithm, if any, to extend the routing table
-	if (resiliency_algorithm_) {
-		resiliency_algorithm_->fortifyRoutingTable(graph,
-							   my_name,
-							   rt);
+	if (cube_routing_.empty()) {
+		// Build a graph out of the FSO database
+		Graph graph(flow_state_objects);
+
+		// Invoke the routing algorithm to compute the routing table
+		// Main arguments are the graph and the source vertex.
+		// The list of FSOs may be useless, but has been left there
+		// for the moment (and it is currently unused by the Dijkstra
+		// algorithm).
+		routing_algorithm_->computeRoutingTable(graph,
+							flow_state_objects,
+							my_name,
+							rt);
+
+		// Run the resiliency algorithm, if any, to extend the routing table
+		if (resiliency_algorithm_) {
+			resiliency_algorithm_->fortifyRoutingTable(graph,
+								   my_name,
+								   rt);
+		}
+	} else {
+		computeCubeRoutingTables(flow_state_objects, my_name, rt);
 	}
 
 
@@ -2209,6 +3095,44 @@ void LinkStateRoutingPolicy::_routingTableUpdate()
 	ipc_process_->resource_allocator_->pduft_gen_ps->routingTableUpdated(rt);
 }
 
+void LinkStateRoutingPolicy::computeCubeRoutingTables(const std::list<FlowStateObject>& fsos,
+						      const std::string& my_name,
+						      std::list<rina::RoutingTableEntry *>& rt)
+{
+	std::vector<spf_routing_request *> requests;
+	std::list<cube_routing>::iterator it;
+	std::list<rina::RoutingTableEntry *>::iterator rit;
+	spf_routing_request def;
+
+	def.algorithm = routing_algorithm_;
+	def.metric = LINK_METRIC_COST;
+	requests.push_back(&def);
+	for (it = cube_routing_.begin(); it != cube_routing_.end(); ++it) {
+		requests.push_back(&it->request);
+	}
+
+	spf_pool_->computeRoutingTables(fsos, my_name, requests);
+
+	rt.swap(def.rt);
+	if (resiliency_algorithm_) {
+		Graph graph(fsos);
+
+		resiliency_algorithm_->fortifyRoutingTable(graph, my_name, rt);
+	}
+
+	// The default routing table applies to the QoS cubes without one
+	for (rit = rt.begin(); rit != rt.end(); ++rit) {
+		(*rit)->qosId = 0;
+	}
+
+	for (it = cube_routing_.begin(); it != cube_routing_.end(); ++it) {
+		for (rit = it->request.rt.begin(); rit != it->request.rt.end(); ++rit) {
+			(*rit)->qosId = it->qos_id;
+		}
+		rt.splice(rt.end(), it->request.rt);
+	}
+}
+
 void LinkStateRoutingPolicy::expireOldAddress(const std::string& name,
 					      unsigned int address,
 					      bool neighbor)
@@ -2225,6 +3149,16 @@ void LinkStateRoutingPolicy::updateObjects(const std::list<FlowStateObject>& new
 			   avoidPort);
 }
 
+void LinkStateRoutingPolicy::scheduleUpdateObjects(const std::list<FlowStateObject>& newObjects,
+						   unsigned int avoidPort)
+{
+	if (__atomic_load_n(&stopping_, __ATOMIC_ACQUIRE))
+		return;
+
+	ipc_process_->execute_task(IPCP_STAGE_ROUTING,
+				   new UpdateFSOsTask(this, newObjects, avoidPort));
+}
+
 void LinkStateRoutingPolicy::removeFlowStateObject(const std::string& fqn)
 {
 	rina::ScopedLock g(lock_);
@@ -2240,6 +3174,8 @@ void toGPB(const FlowStateObject &fso,
 	gpb_fso.set_age(fso.age);
 	gpb_fso.set_neighbor_name(fso.neighbor_name);
 	gpb_fso.set_cost(fso.cost);
+	gpb_fso.set_delay(fso.delay);
+	gpb_fso.set_bandwidth(fso.bandwidth);
 	gpb_fso.set_state(fso.state_up);
 	gpb_fso.set_sequence_number(fso.seq_num);
 
@@ -2262,6 +3198,8 @@ void toModel(
 	fso.name = gpb_fso.name();
 	fso.neighbor_name = gpb_fso.neighbor_name();
 	fso.cost = gpb_fso.cost();
+	fso.delay = gpb_fso.delay();
+	fso.bandwidth = gpb_fso.bandwidth();
 	fso.state_up = gpb_fso.state();
 	fso.seq_num = gpb_fso.sequence_number();
 	fso.age = gpb_fso.age();
@@ -2332,4 +3270,37 @@ void FlowStateObjectListEncoder::decode(const rina::ser_obj_t &serobj,
 	}
 }
 
+unsigned int FlowStateObjectListEncoder::decodeNewObjects(const rina::ser_obj_t &serobj,
+							  FlowStateObjects& fsdb,
+							  const std::string& my_name,
+							  std::list<FlowStateObject> &des_obj)
+{
+	rina::messages::flowStateObjectGroup_t gpb;
+	unsigned int dropped = 0;
+	std::stringstream ss;
+
+	gpb.ParseFromArray(serobj.message_, serobj.size_);
+	for(int i=0; i<gpb.flow_state_objects_size(); i++)
+	{
+		const rina::messages::flowStateObject_t& gpb_fso =
+			gpb.flow_state_objects(i);
+
+		ss.str(std::string());
+		ss << FlowStateRIBObject::object_name_prefix
+		   << gpb_fso.name() << "-" << gpb_fso.neighbor_name();
+		if (fsdb.isStale(ss.str(), gpb_fso.sequence_number(),
+				 gpb_fso.name() == my_name)) {
+			dropped++;
+			continue;
+		}
+
+		FlowStateObject fso;
+		fso_helpers::toModel(gpb_fso, fso);
+		fso.object_name = ss.str();
+		des_obj.push_back(fso);
+	}
+
+	return dropped;
+}
+
 }// namespace rinad
@@ -23,8 +23,12 @@
 #ifndef IPCP_LINK_STATE_ROUTING_HH
 #define IPCP_LINK_STATE_ROUTING_HH
 
+#include <functional>
+#include <queue>
 #include <set>
 #include <stdint.h>
+#include <vector>
+#include <librina/concurrency.h>
 #include <librina/internal-events.h>
 #include <librina/timer.h>
 
@@ -97,10 +101,22 @@ public:
 	int weight_;
 };
 
+/// The property of the N-1 flows used as the weight of the edges
+enum link_metric_t {
+	LINK_METRIC_COST,
+	LINK_METRIC_DELAY,
+	LINK_METRIC_BANDWIDTH
+};
+
 class FlowStateObject;
 class Graph {
 public:
+	/// Bandwidth (bytes/s) of an edge of weight 1 with the bandwidth metric
+	static const unsigned int REFERENCE_BANDWIDTH;
+
 	Graph(const std::list<FlowStateObject>& flow_state_objects);
+	Graph(const std::list<FlowStateObject>& flow_state_objects,
+	      link_metric_t metric);
 	Graph();
 	~Graph();
 
@@ -108,6 +124,10 @@ public:
 	std::list<std::string> vertices_;
 
 	void set_flow_state_objects(const std::list<FlowStateObject>& flow_state_objects);
+
+	/// Weight of the edge of an N-1 flow. Falls back to the cost if the
+	/// flow does not advertise the property used by the metric
+	static int edge_weight(const FlowStateObject& fso, link_metric_t metric);
 	bool contains_vertex(const std::string& name) const;
 	bool contains_edge(const std::string& name1,
 			   const std::string& name2) const;
@@ -139,6 +159,7 @@ private:
 
 	std::list<FlowStateObject> flow_state_objects_;
 	std::list<CheckedVertex *> checked_vertices_;
+	link_metric_t metric_;
 
 	void init_vertices();
 	CheckedVertex * get_checked_vertex(const std::string& name) const;
@@ -161,6 +182,14 @@ public:
 	virtual void computeShortestDistances(const Graph& graph,
 					      const std::string& source_name,
 				              std::map<std::string, int>& distances) = 0;
+
+	//Get the shortest distances from source_name computed by the last
+	//invocation of computeRoutingTable(), so that they don't have to be
+	//computed again. Returns false if they are not available
+	virtual bool getLastShortestDistances(const std::string& source_name,
+					      std::map<std::string, int>& distances) const {
+		return false;
+	}
 };
 
 /// Contains the information of a predecessor, needed by the Dijkstra Algorithm
@@ -185,11 +214,15 @@ public:
 	void computeShortestDistances(const Graph& graph,
 				      const std::string& source_name,
 				      std::map<std::string, int>& distances);
+	bool getLastShortestDistances(const std::string& source_name,
+				      std::map<std::string, int>& distances) const;
 private:
 	std::set<std::string> settled_nodes_;
 	std::set<std::string> unsettled_nodes_;
 	std::map<std::string, PredecessorInfo *> predecessors_;
 	std::map<std::string, int> distances_;
+	std::string last_source_;
+	std::map<std::string, int> last_distances_;
 
 	void execute(const Graph& graph, const std::string& source);
 	std::string getMinimum() const;
@@ -215,6 +248,8 @@ public:
 	void computeShortestDistances(const Graph& graph,
 				      const std::string& source_name,
 				      std::map<std::string, int>& distances);
+	bool getLastShortestDistances(const std::string& source_name,
+				      std::map<std::string, int>& distances) const;
 
 private:
 	std::set<std::string> settled_nodes_;
@@ -222,6 +257,8 @@ private:
 	std::set<std::string> minimum_nodes_;
 	std::map<std::string, std::list<TreeNode *> > predecessors_;
 	std::map<std::string, int> distances_;
+	std::string last_source_;
+	std::map<std::string, int> last_distances_;
 	TreeNode* t;
 	void execute(const Graph& graph,
 		     const std::string& source);
@@ -255,16 +292,136 @@ protected:
 	IRoutingAlgorithm& routing_algorithm;
 };
 
+/// A graph whose vertices are identified by dense ids, so that the
+/// shortest distances can be stored in arrays instead of maps
+class DenseGraph {
+public:
+	/// Distance to the vertices that can't be reached
+	static const int UNREACHABLE;
+
+	struct DenseEdge {
+		unsigned int to;
+		int weight;
+		DenseEdge(unsigned int t, int w) : to(t), weight(w) { };
+	};
+
+	/// Adjacency lists, indexed by vertex id
+	std::vector<std::vector<DenseEdge> > adjacency;
+
+	/// Compute the shortest distances from root to all the vertices
+	void computeShortestDistances(unsigned int root,
+				      std::vector<int>& distances) const;
+};
+
+/// Maximum number of threads of a pool computing shortest path trees
+#define SPF_MAX_WORKERS 4
+
+class SPFWorker;
+
+/// A routing table to be computed by an SPFWorkerPool, for a graph
+/// built out of the FSOs with the given link metric
+struct spf_routing_request {
+	IRoutingAlgorithm * algorithm;
+	link_metric_t metric;
+	std::list<rina::RoutingTableEntry *> rt;
+};
+
+/// A pool of threads computing shortest path trees in parallel
+class SPFWorkerPool {
+public:
+	/// Workers are named name_prefix-N
+	SPFWorkerPool(unsigned int nworkers, const std::string& name_prefix);
+	~SPFWorkerPool();
+
+	/// Number of workers for a pool used by a thread that computes
+	/// trees as well: one per additional CPU, up to SPF_MAX_WORKERS
+	static unsigned int default_workers();
+
+	/// Compute the trees rooted at each of the roots, blocks until
+	/// all of them are available. The calling thread computes trees
+	/// as well
+	void computeShortestDistances(const DenseGraph& graph,
+				      const std::vector<unsigned int>& roots,
+				      const std::vector<std::vector<int> *>& distances);
+
+	/// Compute the routing table of each of the requests from
+	/// source_name, blocks until all of them are available. The
+	/// algorithms of the requests must be different instances. The
+	/// calling thread computes routing tables as well
+	void computeRoutingTables(const std::list<FlowStateObject>& fsos,
+				  const std::string& source_name,
+				  std::vector<spf_routing_request *>& requests);
+
+	/// Called by the workers
+	void run_worker();
+
+private:
+	enum spf_job_type {
+		SPF_JOB_DISTANCES,
+		SPF_JOB_ROUTING_TABLE,
+		SPF_JOB_STOP
+	};
+
+	struct spf_job {
+		spf_job_type type;
+		const DenseGraph * graph;
+		unsigned int root;
+		std::vector<int> * distances;
+		const std::list<FlowStateObject> * fsos;
+		const std::string * source_name;
+		spf_routing_request * request;
+	};
+
+	void run_job(spf_job * job);
+	void wait_jobs();
+
+	std::vector<SPFWorker *> workers;
+	rina::BlockingFIFOQueue<spf_job> jobs;
+	rina::ConditionVariable done_cv;
+	unsigned int pending;
+};
+
 class LoopFreeAlternateAlgorithm : public IResiliencyAlgorithm {
 public:
 	LoopFreeAlternateAlgorithm(IRoutingAlgorithm& ra);
+	~LoopFreeAlternateAlgorithm();
 	void fortifyRoutingTable(const Graph& graph,
 				 const std::string& source_name,
 				 std::list<rina::RoutingTableEntry *>& rt);
 private:
-	void extendRoutingTableEntry(std::list<rina::RoutingTableEntry *>& rt,
-				     const std::string& target_name,
+	typedef std::pair<unsigned int, unsigned int> edge_key_t;
+
+	struct edge_change {
+		unsigned int v1;
+		unsigned int v2;
+		// -1 if the edge was not there before/is not there anymore
+		int old_weight;
+		int new_weight;
+	};
+
+	unsigned int getVertexId(const std::string& name);
+	void compactVertexIds(const Graph& graph);
+	bool isTreeAffected(const std::vector<int>& distances,
+			    const std::vector<edge_change>& changes) const;
+	void extendRoutingTableEntry(rina::RoutingTableEntry * entry,
 				     const std::string& nexthop);
+
+	// Vertex ids are kept across invocations, so that the trees of
+	// the neighbors computed before can be reused. The ids of the
+	// vertices that left the graph are reclaimed when all the trees
+	// have to be computed anyway
+	std::map<std::string, unsigned int> vertex_ids_;
+	std::vector<std::string> vertex_names_;
+
+	// Edges of the graph of the last invocation, indexed by the
+	// ids of their vertices (lowest first)
+	std::map<edge_key_t, int> edges_;
+
+	// Shortest distances from each neighbor of the source, computed
+	// in the last invocations
+	std::map<unsigned int, std::vector<int> > neighbor_trees_;
+
+	SPFWorkerPool * pool_;
 };
 
 /// The object exchanged between IPC Processes to disseminate the state of
@@ -304,15 +461,33 @@ public:
 	// The object is being erased
 	bool being_erased;
 
+	// When the removal of the object is due, if being_erased (ms,
+	// monotonic clock). Removal entries due at another time are stale
+	long erase_due;
+
 	// Flow up (true) or down (false)
 	bool state_up;
 
-	// Age of this FSO (in seconds)
+	// Age of this FSO (in age increment periods) when it was last
+	// refreshed. The FSDB computes the current age on demand
 	unsigned int age;
 
+	// Time of the last refresh (ms, monotonic clock)
+	long refreshed;
+
+	// The FSO has an entry in the expiry queue of the FSDB
+	bool expiry_queued;
+
+	// Expiry time of that entry (ms, monotonic clock)
+	long queued_expiry;
+
 	// The port_id assigned by the neighbor IPC Process to the N-1 flow
 	unsigned int cost;
 
+	// Delay (ms) and bandwidth (bytes/s) of the N-1 flow, 0 if unknown
+	unsigned int delay;
+	unsigned int bandwidth;
+
 	// The object has been marked for propagation
 	bool modified;
 
@@ -333,10 +508,12 @@ public:
 };
 
 class FlowStateManager;
+class FlowStateObjects;
 /// A single flow state object
 class FlowStateRIBObject: public rina::rib::RIBObj {
 public:
-	FlowStateRIBObject(FlowStateObject* new_obj);
+	FlowStateRIBObject(FlowStateObject* new_obj,
+			   FlowStateObjects* fsdb);
 	void read(const rina::cdap_rib::con_handle_t &con, const std::string& fqn,
 		const std::string& clas, const rina::cdap_rib::filt_info_t &filt,
 		const int invoke_id, rina::ser_obj_t &obj_reply, 
@@ -347,28 +524,33 @@ public:
 
 	const static std::string clazz_name;
 	const static std::string object_name_prefix;
+
+private:
+	FlowStateObjects* fsdb_;
 };
 
-class FlowStateObjects;
-class KillFlowStateObjectTimerTask : public rina::TimerTask {
-public:
-	KillFlowStateObjectTimerTask(LinkStateRoutingPolicy *ps, std::string fqn);
-	~KillFlowStateObjectTimerTask() throw(){};
-	void run();
-	std::string name() const {
-		return "kill-flow-state-object";
-	}
+/// An entry of the expiry queue of the FSDB
+struct fso_expiry {
+	// When the entry is due (ms, monotonic clock)
+	long when;
 
-private:
-	std::string fqn_;
-	LinkStateRoutingPolicy* ps_;
+	// The name of the object in the RIB
+	std::string fqn;
+
+	// The object has to be removed (true), or checked for expiration
+	bool removal;
+
+	bool operator>(const fso_expiry& other) const {
+		return when > other.when;
+	}
 };
 
 class FlowStateRIBObjects;
 class FlowStateObjects
 {
 public:
-	FlowStateObjects(LinkStateRoutingPolicy * ps);
+	FlowStateObjects(LinkStateRoutingPolicy * ps,
+			 IPCPRIBDaemon * rib_daemon);
 	~FlowStateObjects();
 	void addAddressToFSOs(const std::string& name,
 			      unsigned int address,
@@ -391,8 +573,18 @@ public:
 	FlowStateObject * getObject(const std::string& fqn);
 	void getModifiedFSOs(std::list<FlowStateObject *>& result);
 	void getAllFSOs(std::list<FlowStateObject>& result);
-	void incrementAge(unsigned int max_age,
-			  rina::Timer* timer);
+
+	/// Process the due entries of the expiry queue: mark the FSOs that
+	/// reached the maximum age for removal, and remove the ones marked
+	/// for long enough. The cost depends on the number of FSOs expiring,
+	/// not on the size of the FSDB
+	void expireObjects();
+
+	/// The current age of an FSO in the FSDB
+	unsigned int getAge(const FlowStateObject& obj) const;
+
+	/// Restart the age count of an FSO after its age has been set
+	void refreshObject(FlowStateObject * obj);
 	void updateObject(const std::string& fqn, 
 			  unsigned int avoid_port);
 	void encodeAllFSOs(rina::ser_obj_t& obj);
@@ -401,15 +593,32 @@ public:
 	bool is_modified() const;
 	void has_modified(bool modified);
 	void set_wait_until_remove_object(unsigned int wait_object);
+	void set_maximum_age(unsigned int max_age);
+	void set_age_increment(unsigned int period);
 	void removeObject(const std::string& fqn);
 
+	/// True if the FSDB already has the object with the same or a
+	/// higher sequence number, or if it is a self generated object
+	/// that no longer exists
+	bool isStale(const std::string& fqn,
+		     unsigned int seq_num,
+		     bool self_generated);
+
 private:
 	void addCheckedObject(const FlowStateObject& object);
+	void refresh(FlowStateObject * obj, long now);
+	void queueExpiry(const std::string& fqn, long when, bool removal);
 	std::map<std::string,FlowStateObject*> objects;
 	//Signals a modification in the FlowStateDB
 	bool modified_;
 	LinkStateRoutingPolicy * ps_;
+	IPCPRIBDaemon * rib_daemon_;
 	unsigned int wait_until_remove_object;
+	unsigned int maximum_age;
+	// Length of an age increment (ms)
+	unsigned int age_increment;
+	std::priority_queue<fso_expiry, std::vector<fso_expiry>,
+			    std::greater<fso_expiry> > expiry_queue;
 	rina::Lockable lock;
 };
 
@@ -445,6 +654,64 @@ private:
 	LinkStateRoutingPolicy * ps_;
 };
 
+/// A group of modified FSOs that is encoded once and written to all the
+/// N-1 management flows except the one the FSOs were learnt from
+struct FSOPropagationBatch {
+	int avoid_port;
+	std::list<FlowStateObject> objects;
+};
+
+/// Counters of the FSO propagation, updated with atomic operations
+struct fso_propagation_stats {
+	fso_propagation_stats() : encoded_groups(0), messages(0), bytes(0),
+		received(0), dropped(0) { };
+
+	// FSO groups encoded
+	unsigned long encoded_groups;
+
+	// M_WRITE messages sent
+	unsigned long messages;
+
+	// Encoded bytes sent
+	unsigned long bytes;
+
+	// FSOs received from the neighbors
+	unsigned long received;
+
+	// Stale FSOs dropped before being applied to the FSDB
+	unsigned long dropped;
+
+	/// Account the FSOs received in a group, of which dropped were stale
+	void account_received(unsigned int fsos, unsigned int stale) {
+		__atomic_add_fetch(&received, fsos, __ATOMIC_RELAXED);
+		__atomic_add_fetch(&dropped, stale, __ATOMIC_RELAXED);
+	}
+};
+
+/// Writes encoded FSO groups to the N-1 management flows
+class FSOGroupWriter {
+public:
+	virtual ~FSOGroupWriter() { };
+	virtual void writeFSOGroup(const rina::cdap_rib::obj_info_t& obj,
+				   int port_id) = 0;
+};
+
+class FSOPropagationStatsRIBObj: public rina::rib::RIBObj {
+public:
+	FSOPropagationStatsRIBObj(const fso_propagation_stats * stats);
+	const std::string get_displayable_value() const;
+
+	const std::string& get_class() const {
+		return class_name;
+	};
+
+	const static std::string class_name;
+	const static std::string object_name;
+
+private:
+	const fso_propagation_stats * stats;
+};
+
 /// The subset of the RIB that contains all the Flow State objects known by the IPC Process.
 /// It exists only in the PDU forwarding table generator. It is used as an input to calculate
 /// the routing and forwarding tables. The FSDB is generated by the operations on FSOs received
@@ -473,6 +740,8 @@ public:
 		       const std::string& neighbor_name,
 		       std::list<unsigned int>& neighbor_addresses,
 		       unsigned int cost,
+		       unsigned int delay,
+		       unsigned int bandwidth,
 		       int avoid_port);
 	/// Set a FSO ready for removal
 	void deprecateObject(std::string fqn);
@@ -487,10 +756,12 @@ public:
 			unsigned int cost);
 	std::map <int, std::list<FlowStateObject*> > prepareForPropagation
 	        (const std::list<rina::FlowInformation>& flows);
-	void incrementAge();
+	void expireObjects();
 	void updateObjects(const std::list<FlowStateObject>& newObjects,
 			   unsigned int avoidPort);
-	void prepareForPropagation(std::map<int, std::list< std::list<FlowStateObject> > >& to_propagate,
+	/// Group the modified FSOs by the port they must not be sent to,
+	/// in batches of at most max_objects FSOs
+	void prepareForPropagation(std::list<FSOPropagationBatch>& batches,
 				   unsigned int max_objects) const;
 	void encodeAllFSOs(rina::ser_obj_t& obj) const;
 	void getAllFSOs(std::list<FlowStateObject>& list) const;
@@ -505,6 +776,7 @@ public:
 	// accessors
 	void set_maximum_age(unsigned int max_age);
 	void set_wait_until_remove_object(unsigned int wait_object);
+	void set_age_increment(unsigned int period);
 private:
 	FlowStateObjects* fsos;
 	unsigned int maximum_age;
@@ -526,6 +798,40 @@ private:
 	long delay_;
 };
 
+/// Recomputes the routing table, run by the routing stage of the IPCP.
+/// The policy is not destroyed while the task exists
+class RoutingTableUpdateTask : public rina::TimerTask {
+public:
+	RoutingTableUpdateTask(LinkStateRoutingPolicy * lsr_policy);
+	~RoutingTableUpdateTask() throw();
+	void run();
+	std::string name() const {
+		return "routing-table-update";
+	}
+
+private:
+	LinkStateRoutingPolicy* lsr_policy_;
+};
+
+/// Applies the FSOs received from a neighbor, run by the routing stage
+/// of the IPCP. The policy is not destroyed while the task exists
+class UpdateFSOsTask : public rina::TimerTask {
+public:
+	UpdateFSOsTask(LinkStateRoutingPolicy * lsr_policy,
+		       const std::list<FlowStateObject>& objects,
+		       unsigned int avoid_port);
+	~UpdateFSOsTask() throw();
+	void run();
+	std::string name() const {
+		return "update-fsos";
+	}
+
+private:
+	LinkStateRoutingPolicy* lsr_policy_;
+	std::list<FlowStateObject> objects_;
+	unsigned int avoid_port_;
+};
+
 class PropagateFSODBTimerTask : public rina::TimerTask {
 public:
 	PropagateFSODBTimerTask(LinkStateRoutingPolicy * lsr_policy,
@@ -593,7 +899,9 @@ private:
 /// leads to the next hop. This selection of the most appropriate N-1 flow can be
 /// performed more frequently in order to perform load-balancing or to quickly route
 /// around failed N-1 flows
-class LinkStateRoutingPolicy: public rina::InternalEventListener {
+class LinkStateRoutingPolicy: public rina::InternalEventListener,
+			      public IEnrollmentSnapshotSection,
+			      public FSOGroupWriter {
 public:
 	static const std::string OBJECT_MAXIMUM_AGE;
 	static const std::string WAIT_UNTIL_READ_CDAP;
@@ -605,6 +913,7 @@ public:
 	static const std::string WAIT_UNTIL_DEPRECATE_OLD_ADDRESS;
 	static const std::string ROUTING_ALGORITHM;
 	static const std::string MAXIMUM_OBJECTS_PER_ROUTING_UPDATE;
+	static const std::string CUBE_METRIC;
 
         static const int PULSES_UNTIL_FSO_EXPIRATION_DEFAULT = 100000;
         static const int WAIT_UNTIL_READ_CDAP_DEFAULT = 5001;
@@ -617,12 +926,19 @@ public:
         static const unsigned int MAX_OBJECTS_PER_ROUTING_UPDATE_DEFAULT = 15;
         static const std::string DIJKSTRA_ALG;
         static const std::string ECMP_DIJKSTRA_ALG;
+        static const std::string SNAPSHOT_SECTION;
 
 	LinkStateRoutingPolicy(IPCProcess * ipcp);
 	~LinkStateRoutingPolicy();
 	void set_ipc_process(IPCProcess * ipc_process);
 	void set_dif_configuration(const rina::DIFConfiguration& dif_configuration);
 
+	/// Parse the <qos_id>.metric parameters of the routing policy. Each
+	/// of them gives a QoS cube its own routing table, computed with
+	/// the cost, delay or bandwidth of the N-1 flows as link metric
+	static void parseCubeMetrics(const rina::PolicyConfig& psconf,
+				     std::map<int, link_metric_t>& metrics);
+
 	/// N-1 Flow allocated, N-1 Flow deallocated or enrollment to neighbor completed
 	void eventHappened(rina::InternalEvent * event);
 
@@ -637,10 +953,18 @@ public:
 	/// all FSOs is cleared.
 	void propagateFSDB();
 
-	/// Invoked periodically by a timer. The age of every Flow State Object is incremented
-	/// with one. If an FSO reaches the maximum age - which is set by DIF policy -, it is
-	/// removed from the FSDB. The FSDB is marked as ÒmodifiedÓ if it wasnÕt already and one
-	/// or more FSOs are removed from the FSDB during the processing of this event.
+	/// Encode each batch once, and write the same encoded group to all
+	/// the N-1 management flows but the one the FSOs were learnt from
+	static void writeFSOBatches(const std::list<FSOPropagationBatch>& batches,
+				    const std::list<int>& n1_ports,
+				    FSOGroupWriter& writer,
+				    fso_propagation_stats& stats);
+
+	/// Invoked periodically by a timer. The age of the Flow State Objects is computed
+	/// on demand from the time of their last refresh, so only the FSOs that reach the
+	/// maximum age - which is set by DIF policy - are processed: they are marked for
+	/// removal, and removed from the FSDB some time later. The FSDB is marked as
+	/// modified if one or more FSOs are removed.
 	void updateAge();
 
 	/// Invoked periodically by a timer. If the FSDB is marked as ÒmodifiedÓ, the PDU
@@ -653,6 +977,10 @@ public:
 	/// ÒmodifiedÓ nothing happens.
 	void routingTableUpdate();
 
+	/// Ask the routing stage of the IPCP to recompute the routing table.
+	/// Requests made while one is pending are coalesced
+	void scheduleRoutingTableUpdate();
+
 	/// Deprecate all LSOs containing the address passed to the method
 	void expireOldAddress(const std::string& name,
 			      unsigned int address,
@@ -661,8 +989,28 @@ public:
 	void updateObjects(const std::list<FlowStateObject>& newObjects,
 			   unsigned int avoidPort);
 
+	/// Apply the FSOs in the routing stage of the IPCP, off the path
+	/// of the layer management SDUs
+	void scheduleUpdateObjects(const std::list<FlowStateObject>& newObjects,
+				   unsigned int avoidPort);
+
 	void removeFlowStateObject(const std::string& fqn);
 
+	/// Account the FSOs received in a group, of which dropped were stale
+	void accountReceivedFSOs(unsigned int received, unsigned int dropped);
+
+	/// The full FSDB, sent to a new member in the enrollment snapshot
+	void get_snapshot(int port_id, rina::ser_obj_t& result);
+
+	/// The neighbor will not get the FSDB again when it is added
+	void snapshot_sent(int port_id);
+
+	/// The full FSDB of the enroller, applied in a single update
+	void apply_snapshot(int port_id, const rina::ser_obj_t& snapshot);
+
+	/// Write an encoded FSO group to an N-1 management flow
+	void writeFSOGroup(const rina::cdap_rib::obj_info_t& obj, int port_id);
+
 	rina::Timer *timer_;
 private:
 	static const int MAXIMUM_BUFFER_SIZE;
@@ -670,6 +1018,17 @@ private:
 	IPCPRIBDaemon * rib_daemon_;
 	IRoutingAlgorithm * routing_algorithm_;
 	IResiliencyAlgorithm * resiliency_algorithm_;
+
+	/// A QoS cube with its own routing table
+	struct cube_routing {
+		int qos_id;
+		spf_routing_request request;
+	};
+
+	/// The routing tables of the QoS cubes are computed in parallel
+	/// with the default one
+	std::list<cube_routing> cube_routing_;
+	SPFWorkerPool * spf_pool_;
 	unsigned int wait_until_deprecate_address_;
 	unsigned int maximum_age_;
 	unsigned int max_objects_per_rupdate_;
@@ -677,6 +1036,23 @@ private:
 	FlowStateManager *db_;
 	rina::Lockable lock_;
 
+	//A routing table update is queued in the routing stage
+	bool rt_update_pending_;
+
+	//Tasks of the routing stage that refer to the policy, the
+	//destructor waits for them. Once stopping_ is set they do nothing
+	int stage_tasks_;
+	bool stopping_;
+
+	fso_propagation_stats prop_stats_;
+
+	/// N-1 management flows to neighbors that already have the FSDB
+	/// from the enrollment snapshot, protected by lock_
+	std::set<int> snapshot_ports_;
+
+	friend class RoutingTableUpdateTask;
+	friend class UpdateFSOsTask;
+
 	void subscribeToEvents();
 
 	/// The Resource Allocator has deallocated an existing N-1 flow dedicated to data
@@ -716,10 +1092,19 @@ private:
 
 	void printNhopTable(std::list<rina::RoutingTableEntry *>& rt);
 
+	IRoutingAlgorithm * createRoutingAlgorithm(const std::string& name) const;
+
 	void populateAddresses(std::list<rina::RoutingTableEntry *>& rt,
 			       const std::list<FlowStateObject>& fsos);
 
+
 	void _routingTableUpdate();
+
+	/// Compute the default routing table and the ones of the QoS cubes
+	/// with their own link metric, in parallel
+	void computeCubeRoutingTables(const std::list<FlowStateObject>& fsos,
+				      const std::string& my_name,
+				      std::list<rina::RoutingTableEntry *>& rt);
 };
 
 /// Encoder of Flow State object
@@ -736,6 +1121,14 @@ public:
 		rina::ser_obj_t& serobj);
 	void decode(const rina::ser_obj_t &serobj, 
 		std::list<FlowStateObject> &des_obj);
+
+	/// Decode only the FSOs that are newer than the ones in the FSDB,
+	/// without building the stale ones. Returns the number of FSOs
+	/// dropped
+	unsigned int decodeNewObjects(const rina::ser_obj_t &serobj,
+				      FlowStateObjects& fsdb,
+				      const std::string& my_name,
+				      std::list<FlowStateObject> &des_obj);
 };
 
 }
@@ -0,0 +1,512 @@
+//
+// test-pduftg
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+// MA  02110-1301  USA
+//
+
+#include <iostream>
+#include <set>
+
+#define IPCP_MODULE "pduftg-tests"
+#include "../../ipcp-logging.h"
+
+#include "resource-allocator-ps.h"
+
+int ipcp_id = 1;
+
+class FakeNMinusOneFlowManager: public rinad::INMinusOneFlowManager {
+public:
+	void set_application_process(rina::ApplicationProcess * ap) { (void)ap; }
+	void set_ipc_process(rinad::IPCProcess * ipc_process) { (void)ipc_process; }
+	void set_dif_configuration(const rina::DIFInformation& dif_information) {
+		(void)dif_information;
+	}
+	void processRegistrationNotification(const rina::IPCProcessDIFRegistrationEvent& event) {
+		(void)event;
+	}
+	std::list<int> getNMinusOneFlowsToNeighbour(unsigned int address) {
+		(void)address;
+		return std::list<int>();
+	}
+	std::list<int> getNMinusOneFlowsToNeighbour(const std::string& name) {
+		(void)name;
+		return std::list<int>();
+	}
+	int getManagementFlowToNeighbour(const std::string& name) {
+		std::map<std::string, int>::iterator it = mgmt_flows.find(name);
+
+		return it == mgmt_flows.end() ? -1 : it->second;
+	}
+	int getManagementFlowToNeighbour(unsigned int address) {
+		(void)address;
+		return -1;
+	}
+	int get_n1flow_to_neighbor(const rina::FlowSpecification& fspec,
+				   const std::string& name) {
+		(void)fspec;
+		(void)name;
+		return -1;
+	}
+	std::list<int> getManagementFlowsToAllNeighbors(void) {
+		return std::list<int>();
+	}
+	unsigned int numberOfFlowsToNeighbour(const std::string& apn,
+					      const std::string& api) {
+		(void)apn;
+		(void)api;
+		return 0;
+	}
+
+	std::map<std::string, int> mgmt_flows;
+};
+
+class FakeResourceAllocator: public rinad::IResourceAllocator {
+public:
+	FakeResourceAllocator() : added(0), modified(0), removed(0) { }
+	~FakeResourceAllocator() { clear(); }
+	void set_application_process(rina::ApplicationProcess * ap) { (void)ap; }
+	void set_dif_configuration(const rina::DIFInformation& dif_information) {
+		(void)dif_information;
+	}
+	rinad::INMinusOneFlowManager * get_n_minus_one_flow_manager() const {
+		return const_cast<FakeNMinusOneFlowManager *>(&n1fm);
+	}
+	std::list<rina::QoSCube*> getQoSCubes() {
+		return std::list<rina::QoSCube*>();
+	}
+	void addQoSCube(const rina::QoSCube& cube) { (void)cube; }
+	std::list<rina::PDUForwardingTableEntry> get_pduft_entries() {
+		return current;
+	}
+	void set_pduft_entries(const std::list<rina::PDUForwardingTableEntry*>& pduft) {
+		clear();
+		pduft_entries = pduft;
+	}
+	void pduft_updated(unsigned int a, unsigned int m, unsigned int r) {
+		added = a;
+		modified = m;
+		removed = r;
+	}
+	std::list<rina::RoutingTableEntry> get_rt_entries() {
+		return std::list<rina::RoutingTableEntry>();
+	}
+	void set_rt_entries(const std::list<rina::RoutingTableEntry*>& rt) {
+		std::list<rina::RoutingTableEntry*>::const_iterator it;
+
+		for (it = rt.begin(); it != rt.end(); ++it)
+			delete *it;
+	}
+	int get_next_hop_addresses(unsigned int dest_address,
+				   std::list<unsigned int>& addresses) {
+		(void)dest_address;
+		(void)addresses;
+		return -1;
+	}
+	int get_next_hop_name(const std::string& dest_name, std::string& name) {
+		(void)dest_name;
+		(void)name;
+		return -1;
+	}
+	unsigned int get_n1_port_to_address(unsigned int dest_address) {
+		(void)dest_address;
+		return 0;
+	}
+	void add_temp_pduft_entry(unsigned int dest_address, int port_id) {
+		(void)dest_address;
+		(void)port_id;
+	}
+	void remove_temp_pduft_entry(unsigned int dest_address) {
+		(void)dest_address;
+	}
+	void clear() {
+		std::list<rina::PDUForwardingTableEntry*>::iterator it;
+
+		for (it = pduft_entries.begin(); it != pduft_entries.end(); ++it)
+			delete *it;
+		pduft_entries.clear();
+	}
+
+	FakeNMinusOneFlowManager n1fm;
+	std::list<rina::PDUForwardingTableEntry> current;
+	std::list<rina::PDUForwardingTableEntry*> pduft_entries;
+	unsigned int added;
+	unsigned int modified;
+	unsigned int removed;
+};
+
+/// PDU Forwarding Table generator that records the entries it would
+/// write to the kernel, as a delta (mode 3) or a whole table (mode 2)
+class TestPDUFTGeneratorPs: public rinad::DefaultPDUFTGeneratorPs {
+public:
+	TestPDUFTGeneratorPs(rinad::IResourceAllocator * ra)
+		: rinad::DefaultPDUFTGeneratorPs(ra) { }
+
+	std::list<rina::PDUForwardingTableEntry> sent;
+	std::list<rina::PDUForwardingTableEntry> replaced;
+
+	// Writes with these modes are rejected by the "kernel"
+	std::set<int> failing_modes;
+
+protected:
+	int write_kernel_pduft(const std::list<rina::PDUForwardingTableEntry *>& entries,
+			       int mode) {
+		std::list<rina::PDUForwardingTableEntry *>::const_iterator it;
+
+		if (failing_modes.count(mode))
+			return -1;
+
+		for (it = entries.begin(); it != entries.end(); ++it)
+			(mode == 2 ? replaced : sent).push_back(**it);
+
+		return 0;
+	}
+};
+
+/// Routing table with a single entry towards address 17 for qos-id 1,
+/// via the next hop B
+void populateRoutingTable(std::list<rina::RoutingTableEntry *>& rt)
+{
+	rina::RoutingTableEntry * entry;
+	rina::IPCPNameAddresses nhop;
+
+	nhop.name = "B";
+	nhop.addresses.push_back(2);
+
+	entry = new rina::RoutingTableEntry();
+	entry->destination.name = "C";
+	entry->destination.addresses.push_back(17);
+	entry->qosId = 1;
+	entry->cost = 2;
+	entry->nextHopNames.push_back(rina::NHopAltList(nhop));
+	rt.push_back(entry);
+}
+
+/// The PDU Forwarding Table expected for the routing table above, when
+/// the N-1 management flow towards B is port-id 5
+void populateExpectedPDUFT(std::list<rina::PDUForwardingTableEntry>& pduft)
+{
+	rina::PDUForwardingTableEntry entry;
+	rina::PortIdAltlist alts;
+
+	alts.add_alt(5);
+	entry.address = 17;
+	entry.qosId = 1;
+	entry.cost = 2;
+	entry.portIdAltlists.push_back(alts);
+	pduft.push_back(entry);
+}
+
+bool hasExpectedPDUFT(const FakeResourceAllocator& ra)
+{
+	const rina::PDUForwardingTableEntry * entry;
+
+	if (ra.pduft_entries.size() != 1)
+		return false;
+
+	entry = ra.pduft_entries.front();
+	if (entry->address != 17 || entry->qosId != 1)
+		return false;
+
+	if (entry->portIdAltlists.size() != 1)
+		return false;
+
+	if (entry->portIdAltlists.front().alts.size() != 1 ||
+			entry->portIdAltlists.front().alts.front() != 5)
+		return false;
+
+	/* Same as the current table, nothing sent to the kernel */
+	return ra.added == 0 && ra.modified == 0 && ra.removed == 0;
+}
+
+/// A routing table entry towards address for qos-id 1, via the next hop
+void addRoutingTableEntry(std::list<rina::RoutingTableEntry *>& rt,
+			  unsigned int address,
+			  const std::string& next_hop)
+{
+	rina::RoutingTableEntry * entry;
+	rina::IPCPNameAddresses nhop;
+
+	nhop.name = next_hop;
+
+	entry = new rina::RoutingTableEntry();
+	entry->destination.addresses.push_back(address);
+	entry->qosId = 1;
+	entry->cost = 1;
+	entry->nextHopNames.push_back(rina::NHopAltList(nhop));
+	rt.push_back(entry);
+}
+
+/// A PDU Forwarding Table entry towards address for qos-id 1
+void addPDUFTEntry(std::list<rina::PDUForwardingTableEntry>& pduft,
+		   unsigned int address,
+		   int port_id)
+{
+	rina::PDUForwardingTableEntry entry;
+	rina::PortIdAltlist alts;
+
+	alts.add_alt(port_id);
+	entry.address = address;
+	entry.qosId = 1;
+	entry.cost = 1;
+	entry.portIdAltlists.push_back(alts);
+	pduft.push_back(entry);
+}
+
+const rina::PDUForwardingTableEntry *
+findPDUFTEntry(const std::list<rina::PDUForwardingTableEntry>& pduft,
+	       unsigned int address)
+{
+	std::list<rina::PDUForwardingTableEntry>::const_iterator it;
+
+	for (it = pduft.begin(); it != pduft.end(); ++it) {
+		if (it->address == address)
+			return &(*it);
+	}
+
+	return 0;
+}
+
+/// True if the entry goes through a single N-1 port-id (or none, if
+/// port_id is -1)
+bool hasPortId(const rina::PDUForwardingTableEntry * entry, int port_id)
+{
+	if (!entry)
+		return false;
+
+	if (port_id == -1)
+		return entry->portIdAltlists.empty();
+
+	return entry->portIdAltlists.size() == 1 &&
+		entry->portIdAltlists.front().alts.size() == 1 &&
+		(int) entry->portIdAltlists.front().alts.front() == port_id;
+}
+
+int routingTableUpdated_NoQoSIdMap_ManagementFlow()
+{
+	FakeResourceAllocator ra;
+	TestPDUFTGeneratorPs ps(&ra);
+	std::list<rina::RoutingTableEntry *> rt;
+
+	ra.n1fm.mgmt_flows["B"] = 5;
+	populateExpectedPDUFT(ra.current);
+	populateRoutingTable(rt);
+
+	ps.routingTableUpdated(rt);
+
+	return hasExpectedPDUFT(ra) && ps.sent.empty() ? 0 : -1;
+}
+
+int routingTableUpdated_EntriesAddedModifiedRemoved()
+{
+	FakeResourceAllocator ra;
+	TestPDUFTGeneratorPs ps(&ra);
+	std::list<rina::RoutingTableEntry *> rt;
+
+	ra.n1fm.mgmt_flows["B"] = 5;
+	ra.n1fm.mgmt_flows["C"] = 8;
+	ra.n1fm.mgmt_flows["D"] = 9;
+
+	/* 17 stays via port-id 5, 18 moves from port-id 6 to 8, 19 is not
+	 * reachable anymore and 20 is new */
+	addPDUFTEntry(ra.current, 17, 5);
+	addPDUFTEntry(ra.current, 18, 6);
+	addPDUFTEntry(ra.current, 19, 7);
+	addRoutingTableEntry(rt, 17, "B");
+	addRoutingTableEntry(rt, 18, "C");
+	addRoutingTableEntry(rt, 20, "D");
+
+	ps.routingTableUpdated(rt);
+
+	if (ra.added != 1 || ra.modified != 1 || ra.removed != 1) {
+		LOG_IPCP_ERR("Wrong delta: %u added, %u modified, %u removed",
+			     ra.added, ra.modified, ra.removed);
+		return -1;
+	}
+
+	if (ps.sent.size() != 3) {
+		LOG_IPCP_ERR("Wrong number of entries sent: %zu",
+			     ps.sent.size());
+		return -1;
+	}
+
+	if (findPDUFTEntry(ps.sent, 17) ||
+			!hasPortId(findPDUFTEntry(ps.sent, 18), 8) ||
+			!hasPortId(findPDUFTEntry(ps.sent, 19), -1) ||
+			!hasPortId(findPDUFTEntry(ps.sent, 20), 9)) {
+		LOG_IPCP_ERR("Wrong entries sent");
+		return -1;
+	}
+
+	/* The whole table is kept in the resource allocator */
+	return ra.pduft_entries.size() == 3 ? 0 : -1;
+}
+
+int routingTableUpdated_EmptyRoutingTable()
+{
+	FakeResourceAllocator ra;
+	TestPDUFTGeneratorPs ps(&ra);
+	std::list<rina::RoutingTableEntry *> rt;
+
+	addPDUFTEntry(ra.current, 17, 5);
+	addPDUFTEntry(ra.current, 18, 6);
+
+	ps.routingTableUpdated(rt);
+
+	if (ra.added != 0 || ra.modified != 0 || ra.removed != 2)
+		return -1;
+
+	if (ps.sent.size() != 2 ||
+			!hasPortId(findPDUFTEntry(ps.sent, 17), -1) ||
+			!hasPortId(findPDUFTEntry(ps.sent, 18), -1))
+		return -1;
+
+	return ra.pduft_entries.empty() ? 0 : -1;
+}
+
+int routingTableUpdated_DeltaRejected()
+{
+	FakeResourceAllocator ra;
+	TestPDUFTGeneratorPs ps(&ra);
+	std::list<rina::RoutingTableEntry *> rt;
+
+	ra.n1fm.mgmt_flows["B"] = 5;
+	ra.n1fm.mgmt_flows["C"] = 8;
+
+	/* 18 moves from port-id 6 to 8, but the kernel rejects the delta */
+	addPDUFTEntry(ra.current, 17, 5);
+	addPDUFTEntry(ra.current, 18, 6);
+	addRoutingTableEntry(rt, 17, "B");
+	addRoutingTableEntry(rt, 18, "C");
+	ps.failing_modes.insert(3);
+
+	ps.routingTableUpdated(rt);
+
+	/* The whole table replaces the one of the kernel */
+	if (!ps.sent.empty() || ps.replaced.size() != 2 ||
+			!hasPortId(findPDUFTEntry(ps.replaced, 17), 5) ||
+			!hasPortId(findPDUFTEntry(ps.replaced, 18), 8))
+		return -1;
+
+	return ra.pduft_entries.size() == 2 ? 0 : -1;
+}
+
+int routingTableUpdated_KernelRejected()
+{
+	FakeResourceAllocator ra;
+	TestPDUFTGeneratorPs ps(&ra);
+	std::list<rina::RoutingTableEntry *> rt;
+
+	ra.n1fm.mgmt_flows["B"] = 5;
+	addPDUFTEntry(ra.current, 17, 6);
+	addRoutingTableEntry(rt, 17, "B");
+	ps.failing_modes.insert(2);
+	ps.failing_modes.insert(3);
+
+	ps.routingTableUpdated(rt);
+	if (!ps.sent.empty() || !ps.replaced.empty())
+		return -1;
+
+	/* The routing table does not change, but the kernel still has
+	 * the old table, so the next update replaces it */
+	ra.current.clear();
+	addPDUFTEntry(ra.current, 17, 5);
+	rt.clear();
+	addRoutingTableEntry(rt, 17, "B");
+	ps.failing_modes.clear();
+
+	ps.routingTableUpdated(rt);
+	if (!ps.sent.empty() || ps.replaced.size() != 1 ||
+			!hasPortId(findPDUFTEntry(ps.replaced, 17), 5))
+		return -1;
+
+	/* And the one after that goes back to deltas */
+	rt.clear();
+	addRoutingTableEntry(rt, 17, "B");
+	ps.replaced.clear();
+
+	ps.routingTableUpdated(rt);
+
+	return ps.sent.empty() && ps.replaced.empty() ? 0 : -1;
+}
+
+int routingTableUpdated_NoN1FlowForQoSId_ManagementFlow()
+{
+	FakeResourceAllocator ra;
+	TestPDUFTGeneratorPs ps(&ra);
+	std::list<rina::RoutingTableEntry *> rt;
+	rina::DIFConfiguration dif_configuration;
+
+	dif_configuration.ra_configuration_.pduftg_conf_.policy_set_.parameters_
+		.push_back(rina::PolicyParameter("1.qosid", "100/0"));
+	ps.set_dif_configuration(dif_configuration);
+
+	ra.n1fm.mgmt_flows["B"] = 5;
+	populateExpectedPDUFT(ra.current);
+	populateRoutingTable(rt);
+
+	ps.routingTableUpdated(rt);
+
+	return hasExpectedPDUFT(ra) && ps.sent.empty() ? 0 : -1;
+}
+
+int main()
+{
+	int result = 0;
+
+	result = routingTableUpdated_NoQoSIdMap_ManagementFlow();
+	if (result < 0) {
+		LOG_IPCP_ERR("routingTableUpdated_NoQoSIdMap_ManagementFlow test failed");
+		return result;
+	}
+	LOG_IPCP_INFO("routingTableUpdated_NoQoSIdMap_ManagementFlow test passed");
+
+	result = routingTableUpdated_NoN1FlowForQoSId_ManagementFlow();
+	if (result < 0) {
+		LOG_IPCP_ERR("routingTableUpdated_NoN1FlowForQoSId_ManagementFlow test failed");
+		return result;
+	}
+	LOG_IPCP_INFO("routingTableUpdated_NoN1FlowForQoSId_ManagementFlow test passed");
+
+	result = routingTableUpdated_EntriesAddedModifiedRemoved();
+	if (result < 0) {
+		LOG_IPCP_ERR("routingTableUpdated_EntriesAddedModifiedRemoved test failed");
+		return result;
+	}
+	LOG_IPCP_INFO("routingTableUpdated_EntriesAddedModifiedRemoved test passed");
+
+	result = routingTableUpdated_EmptyRoutingTable();
+	if (result < 0) {
+		LOG_IPCP_ERR("routingTableUpdated_EmptyRoutingTable test failed");
+		return result;
+	}
+	LOG_IPCP_INFO("routingTableUpdated_EmptyRoutingTable test passed");
+
+	result = routingTableUpdated_DeltaRejected();
+	if (result < 0) {
+		LOG_IPCP_ERR("routingTableUpdated_DeltaRejected test failed");
+		return result;
+	}
+	LOG_IPCP_INFO("routingTableUpdated_DeltaRejected test passed");
+
+	result = routingTableUpdated_KernelRejected();
+	if (result < 0) {
+		LOG_IPCP_ERR("routingTableUpdated_KernelRejected test failed");
+		return result;
+	}
+	LOG_IPCP_INFO("routingTableUpdated_KernelRejected test passed");
+
+	return 0;
+}
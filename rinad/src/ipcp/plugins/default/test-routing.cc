@@ -21,6 +21,8 @@
 //
 
 #include <iostream>
+#include <sstream>
+#include <time.h>
 
 #define IPCP_MODULE "lsr-tests"
 #include "../../ipcp-logging.h"
@@ -388,6 +390,384 @@ int test_flow_state_object_db () {
 	return result;
 }*/
 
+/// RIB Daemon that only keeps the objects added by the FSDB
+class FakeRIBDaemon: public rinad::IPCPRIBDaemon {
+public:
+	~FakeRIBDaemon() {
+		std::map<std::string, rina::rib::RIBObj *>::iterator it;
+
+		for (it = objects.begin(); it != objects.end(); ++it)
+			delete it->second;
+	}
+	rina::rib::RIBDaemonProxy * getProxy() {
+		return 0;
+	}
+	void set_dif_configuration(const rina::DIFInformation& dif_information) {
+		(void)dif_information;
+	}
+	void processQueryRIBRequestEvent(const rina::QueryRIBRequestEvent& event) {
+		(void)event;
+	}
+	const rina::rib::rib_handle_t & get_rib_handle() {
+		return handle;
+	}
+	int64_t addObjRIB(const std::string& fqn, rina::rib::RIBObj** obj) {
+		removeObjRIB(fqn);
+		objects[fqn] = *obj;
+		*obj = 0;
+		return objects.size();
+	}
+	void removeObjRIB(const std::string& fqn) {
+		std::map<std::string, rina::rib::RIBObj *>::iterator it;
+
+		it = objects.find(fqn);
+		if (it == objects.end())
+			return;
+
+		delete it->second;
+		objects.erase(it);
+	}
+	void processReadManagementSDUEvent(rina::ReadMgmtSDUResponseEvent& event) {
+		(void)event;
+	}
+	int take_mgmt_sdu_write_port(unsigned int seq_num) {
+		(void)seq_num;
+		return -1;
+	}
+
+	rina::rib::rib_handle_t handle;
+	std::map<std::string, rina::rib::RIBObj *> objects;
+};
+
+void sleepMs(long ms)
+{
+	struct timespec ts;
+
+	ts.tv_sec = ms / 1000;
+	ts.tv_nsec = (ms % 1000) * 1000000L;
+	nanosleep(&ts, 0);
+}
+
+/// Age increment (ms) of the FSDB tests
+const unsigned int FSDB_AGE_INCREMENT = 40;
+
+/// Maximum age (in age increments) of the FSDB tests
+const unsigned int FSDB_MAX_AGE = 5;
+
+void setupFSDB(rinad::FlowStateObjects& fsdb, unsigned int wait_remove)
+{
+	fsdb.set_age_increment(FSDB_AGE_INCREMENT);
+	fsdb.set_maximum_age(FSDB_MAX_AGE);
+	fsdb.set_wait_until_remove_object(wait_remove);
+}
+
+int expireObjects_MaxAgeReached_Removed() {
+	FakeRIBDaemon rib_daemon;
+	rinad::FlowStateObjects fsdb(0, &rib_daemon);
+	rinad::FlowStateObject fso("A", "B", 1, true, 1, 0);
+
+	setupFSDB(fsdb, 0);
+	fsdb.addObject(fso);
+	if (!rib_daemon.objects.count(fso.object_name))
+		return -1;
+
+	/* Not expired yet */
+	fsdb.expireObjects();
+	if (!fsdb.getObject(fso.object_name))
+		return -1;
+
+	sleepMs(FSDB_MAX_AGE * FSDB_AGE_INCREMENT + FSDB_AGE_INCREMENT);
+	fsdb.expireObjects();
+	if (fsdb.getObject(fso.object_name))
+		return -1;
+
+	/* Removed from the RIB as well */
+	return rib_daemon.objects.count(fso.object_name) ? -1 : 0;
+}
+
+int expireObjects_RefreshedBeforeRemoval_NotRemoved() {
+	FakeRIBDaemon rib_daemon;
+	rinad::FlowStateObjects fsdb(0, &rib_daemon);
+	rinad::FlowStateObject fso("A", "B", 1, true, 1, 0);
+	const unsigned int wait_remove = FSDB_AGE_INCREMENT;
+	rinad::FlowStateObject * obj;
+
+	setupFSDB(fsdb, wait_remove);
+	fsdb.addObject(fso);
+
+	/* Expired, the removal is queued */
+	sleepMs(FSDB_MAX_AGE * FSDB_AGE_INCREMENT + FSDB_AGE_INCREMENT / 2);
+	fsdb.expireObjects();
+	obj = fsdb.getObject(fso.object_name);
+	if (!obj || !obj->being_erased)
+		return -1;
+
+	/* Refreshed before the removal is due */
+	fsdb.updateObject(fso.object_name, 0);
+	if (obj->being_erased)
+		return -1;
+
+	/* The removal entry is now due, but the object is alive again and
+	 * expires FSDB_MAX_AGE increments after the refresh */
+	sleepMs(wait_remove + 2 * FSDB_AGE_INCREMENT);
+	fsdb.expireObjects();
+	obj = fsdb.getObject(fso.object_name);
+	if (!obj || obj->being_erased)
+		return -1;
+
+	return rib_daemon.objects.count(fso.object_name) ? 0 : -1;
+}
+
+int expireObjects_ExpiredAgainBeforeRemoval_RemovedLater() {
+	FakeRIBDaemon rib_daemon;
+	rinad::FlowStateObjects fsdb(0, &rib_daemon);
+	rinad::FlowStateObject fso("A", "B", 1, true, 1, 0);
+	const unsigned int wait_remove = 4 * FSDB_AGE_INCREMENT;
+	rinad::FlowStateObject * obj;
+
+	setupFSDB(fsdb, wait_remove);
+	fsdb.addObject(fso);
+
+	/* Expired, the removal is queued */
+	sleepMs(FSDB_MAX_AGE * FSDB_AGE_INCREMENT + FSDB_AGE_INCREMENT / 2);
+	fsdb.expireObjects();
+	obj = fsdb.getObject(fso.object_name);
+	if (!obj || !obj->being_erased)
+		return -1;
+
+	/* Refreshed, and expired again one increment later */
+	sleepMs(FSDB_AGE_INCREMENT);
+	fsdb.updateObject(fso.object_name, 0);
+	obj->age = FSDB_MAX_AGE;
+	fsdb.refreshObject(obj);
+	fsdb.expireObjects();
+	if (!obj->being_erased)
+		return -1;
+
+	/* The first removal is due, but not the one of the last expiry */
+	sleepMs(wait_remove - FSDB_AGE_INCREMENT / 2);
+	fsdb.expireObjects();
+	if (!fsdb.getObject(fso.object_name))
+		return -1;
+
+	sleepMs(FSDB_AGE_INCREMENT);
+	fsdb.expireObjects();
+
+	return fsdb.getObject(fso.object_name) ? -1 : 0;
+}
+
+int getAge_TimeElapsed_AgeIncreased() {
+	FakeRIBDaemon rib_daemon;
+	rinad::FlowStateObjects fsdb(0, &rib_daemon);
+	rinad::FlowStateObject fso("A", "B", 1, true, 1, 1);
+	rinad::FlowStateObject * obj;
+	std::list<rinad::FlowStateObject> all;
+	unsigned int age;
+
+	fsdb.set_age_increment(FSDB_AGE_INCREMENT);
+	fsdb.addObject(fso);
+	obj = fsdb.getObject(fso.object_name);
+	if (!obj || fsdb.getAge(*obj) != 1)
+		return -1;
+
+	sleepMs(3 * FSDB_AGE_INCREMENT + FSDB_AGE_INCREMENT / 2);
+
+	/* The age is derived from the time of the last refresh, the stored
+	 * one does not change */
+	age = fsdb.getAge(*obj);
+	if (age < 4 || obj->age != 1) {
+		LOG_IPCP_ERR("Wrong age: %u (stored %u)", age, obj->age);
+		return -1;
+	}
+
+	/* The FSOs handed out carry the current age */
+	fsdb.getAllFSOs(all);
+	if (all.size() != 1 || all.front().age < age)
+		return -1;
+
+	/* A refresh restarts the count from the stored age */
+	obj->age = 0;
+	fsdb.refreshObject(obj);
+
+	return fsdb.getAge(*obj) == 0 ? 0 : -1;
+}
+
+int test_flow_state_objects() {
+	int result = 0;
+
+	result = expireObjects_MaxAgeReached_Removed();
+	if (result < 0) {
+		LOG_IPCP_ERR("expireObjects_MaxAgeReached_Removed test failed");
+		return result;
+	}
+	LOG_IPCP_INFO("expireObjects_MaxAgeReached_Removed test passed");
+
+	result = expireObjects_RefreshedBeforeRemoval_NotRemoved();
+	if (result < 0) {
+		LOG_IPCP_ERR("expireObjects_RefreshedBeforeRemoval_NotRemoved test failed");
+		return result;
+	}
+	LOG_IPCP_INFO("expireObjects_RefreshedBeforeRemoval_NotRemoved test passed");
+
+	result = expireObjects_ExpiredAgainBeforeRemoval_RemovedLater();
+	if (result < 0) {
+		LOG_IPCP_ERR("expireObjects_ExpiredAgainBeforeRemoval_RemovedLater test failed");
+		return result;
+	}
+	LOG_IPCP_INFO("expireObjects_ExpiredAgainBeforeRemoval_RemovedLater test passed");
+
+	result = getAge_TimeElapsed_AgeIncreased();
+	if (result < 0) {
+		LOG_IPCP_ERR("getAge_TimeElapsed_AgeIncreased test failed");
+		return result;
+	}
+	LOG_IPCP_INFO("getAge_TimeElapsed_AgeIncreased test passed");
+
+	return result;
+}
+
+/// Records the encoded FSO groups written to each N-1 management flow
+class FakeFSOGroupWriter: public rinad::FSOGroupWriter {
+public:
+	struct write {
+		int port_id;
+		const unsigned char * buffer;
+		std::string value;
+	};
+
+	void writeFSOGroup(const rina::cdap_rib::obj_info_t& obj,
+			   int port_id) {
+		struct write w;
+
+		w.port_id = port_id;
+		w.buffer = obj.value_.message_;
+		w.value = std::string((const char *) obj.value_.message_,
+				      obj.value_.size_);
+		writes.push_back(w);
+	}
+
+	std::list<struct write> writes;
+};
+
+int writeFSOBatches_ThreeNeighbors_EncodedOnce() {
+	std::list<rinad::FSOPropagationBatch> batches;
+	std::list<FakeFSOGroupWriter::write>::iterator it;
+	rinad::fso_propagation_stats stats;
+	rinad::FlowStateObjectListEncoder encoder;
+	std::list<rinad::FlowStateObject> objects;
+	FakeFSOGroupWriter writer;
+	std::list<int> ports;
+	rina::ser_obj_t value;
+
+	ports.push_back(1);
+	ports.push_back(2);
+	ports.push_back(3);
+
+	/* Learnt from the neighbor at port-id 2 */
+	batches.push_back(rinad::FSOPropagationBatch());
+	batches.back().avoid_port = 2;
+	batches.back().objects.push_back(rinad::FlowStateObject("A", "B", 1, true, 1, 0));
+	batches.back().objects.push_back(rinad::FlowStateObject("B", "A", 1, true, 1, 0));
+
+	/* Generated locally */
+	batches.push_back(rinad::FSOPropagationBatch());
+	batches.back().avoid_port = rinad::FlowStateManager::NO_AVOID_PORT;
+	batches.back().objects.push_back(rinad::FlowStateObject("C", "D", 1, true, 1, 0));
+
+	rinad::LinkStateRoutingPolicy::writeFSOBatches(batches, ports,
+						       writer, stats);
+
+	if (stats.encoded_groups != 2 || writer.writes.size() != 5) {
+		LOG_IPCP_ERR("Wrong propagation: %lu groups encoded, %zu writes",
+			     stats.encoded_groups, writer.writes.size());
+		return -1;
+	}
+
+	/* The first batch goes to all neighbors but the one at port-id 2,
+	 * with a single encoded group */
+	it = writer.writes.begin();
+	if (it->port_id != 1 || (++it)->port_id != 3)
+		return -1;
+	if (it->buffer != writer.writes.front().buffer ||
+			it->value != writer.writes.front().value)
+		return -1;
+
+	value.size_ = it->value.size();
+	value.message_ = new unsigned char[value.size_];
+	memcpy(value.message_, it->value.data(), value.size_);
+	encoder.decode(value, objects);
+	if (objects.size() != 2)
+		return -1;
+
+	/* The second batch goes to all of them */
+	const unsigned char * buffer = (++it)->buffer;
+	for (int port_id = 1; port_id <= 3; ++port_id, ++it) {
+		if (it == writer.writes.end() || it->port_id != port_id ||
+				it->buffer != buffer)
+			return -1;
+	}
+
+	return 0;
+}
+
+int decodeNewObjects_OlderSequenceNumber_Dropped() {
+	FakeRIBDaemon rib_daemon;
+	rinad::FlowStateObjects fsdb(0, &rib_daemon);
+	rinad::fso_propagation_stats stats;
+	rinad::FlowStateObjectListEncoder encoder;
+	std::list<rinad::FlowStateObject> received;
+	std::list<rinad::FlowStateObject> new_objects;
+	rina::ser_obj_t value;
+	unsigned int dropped;
+
+	fsdb.addObject(rinad::FlowStateObject("A", "B", 1, true, 5, 0));
+
+	/* Older and same sequence number as the FSDB, newer, unknown,
+	 * and self generated (by X) but no longer in the FSDB */
+	received.push_back(rinad::FlowStateObject("A", "B", 2, true, 4, 0));
+	received.push_back(rinad::FlowStateObject("A", "B", 2, true, 5, 0));
+	received.push_back(rinad::FlowStateObject("A", "B", 3, true, 6, 0));
+	received.push_back(rinad::FlowStateObject("C", "D", 1, true, 1, 0));
+	received.push_back(rinad::FlowStateObject("X", "A", 1, true, 9, 0));
+	encoder.encode(received, value);
+
+	dropped = encoder.decodeNewObjects(value, fsdb, "X", new_objects);
+	stats.account_received(new_objects.size() + dropped, dropped);
+
+	if (dropped != 3 || new_objects.size() != 2) {
+		LOG_IPCP_ERR("Wrong decoding: %u dropped, %zu new", dropped,
+			     new_objects.size());
+		return -1;
+	}
+
+	if (new_objects.front().seq_num != 6 ||
+			new_objects.front().cost != 3 ||
+			new_objects.back().name != "C")
+		return -1;
+
+	return stats.received == 5 && stats.dropped == 3 ? 0 : -1;
+}
+
+int test_fso_propagation() {
+	int result = 0;
+
+	result = writeFSOBatches_ThreeNeighbors_EncodedOnce();
+	if (result < 0) {
+		LOG_IPCP_ERR("writeFSOBatches_ThreeNeighbors_EncodedOnce test failed");
+		return result;
+	}
+	LOG_IPCP_INFO("writeFSOBatches_ThreeNeighbors_EncodedOnce test passed");
+
+	result = decodeNewObjects_OlderSequenceNumber_Dropped();
+	if (result < 0) {
+		LOG_IPCP_ERR("decodeNewObjects_OlderSequenceNumber_Dropped test failed");
+		return result;
+	}
+	LOG_IPCP_INFO("decodeNewObjects_OlderSequenceNumber_Dropped test passed");
+
+	return result;
+}
+
 int Graph_EmptyGraph_Empty() {
 	std::list<rinad::FlowStateObject> objects;
 	rinad::Graph g = rinad::Graph(objects);
@@ -879,6 +1259,315 @@ int getRoutingTable_Addresses_True() {
 	return result;
 }
 
+// LFA as it was computed before: shortest distances of the source and
+// of every neighbor computed from scratch with the routing algorithm
+void referenceLFA(rinad::IRoutingAlgorithm * routingAlgorithm,
+		  const rinad::Graph& graph,
+		  const std::string& source,
+		  std::list<rina::RoutingTableEntry *>& rtable)
+{
+	std::map<std::string, std::map<std::string, int> > neigh_trees;
+	std::map<std::string, std::map<std::string, int> >::iterator nit;
+	std::map<std::string, int> src_tree;
+	std::list<std::string>::const_iterator it;
+	std::list<rina::RoutingTableEntry *>::iterator rit;
+	std::list<rina::IPCPNameAddresses>::iterator hit;
+	rina::IPCPNameAddresses ipcpna;
+
+	routingAlgorithm->computeShortestDistances(graph, source, src_tree);
+	for (it = graph.vertices_.begin(); it != graph.vertices_.end(); ++it) {
+		if (*it != source && graph.contains_edge(source, *it))
+			routingAlgorithm->computeShortestDistances(graph, *it,
+								   neigh_trees[*it]);
+	}
+
+	for (it = graph.vertices_.begin(); it != graph.vertices_.end(); ++it) {
+		if (*it == source)
+			continue;
+
+		for (nit = neigh_trees.begin(); nit != neigh_trees.end(); ++nit) {
+			if (nit->first == *it ||
+			    nit->second[*it] >= src_tree[nit->first] + src_tree[*it])
+				continue;
+
+			for (rit = rtable.begin(); rit != rtable.end(); ++rit) {
+				if ((*rit)->destination.name == *it)
+					break;
+			}
+			if (rit == rtable.end())
+				continue;
+
+			rina::NHopAltList& altlist = (*rit)->nextHopNames.front();
+			for (hit = altlist.alts.begin(); hit != altlist.alts.end(); ++hit) {
+				if (hit->name == nit->first)
+					break;
+			}
+			if (hit == altlist.alts.end()) {
+				ipcpna.name = nit->first;
+				altlist.alts.push_back(ipcpna);
+			}
+		}
+	}
+}
+
+// Grid of rows x cols nodes, with the first one connected to a number of
+// other nodes as well
+void buildLFATopology(unsigned int rows, unsigned int cols,
+		      unsigned int hub_links, unsigned int changed_cost,
+		      std::list<rinad::FlowStateObject>& objects)
+{
+	std::stringstream n1, n2;
+	unsigned int i, j, node, cost;
+
+	objects.clear();
+	for (i = 0; i < rows; i++) {
+		for (j = 0; j < cols; j++) {
+			node = i * cols + j;
+			n1.str("");
+			n1 << "n" << node;
+			cost = (i * 7 + j * 3) % 5 + 1;
+			if (j + 1 < cols) {
+				n2.str("");
+				n2 << "n" << node + 1;
+				objects.push_back(rinad::FlowStateObject(n1.str(), n2.str(),
+									 cost, true, 1, 1));
+				objects.push_back(rinad::FlowStateObject(n2.str(), n1.str(),
+									 cost, true, 1, 1));
+			}
+			if (i + 1 < rows) {
+				n2.str("");
+				n2 << "n" << node + cols;
+				// The link that changes between runs
+				if (node == rows * cols - cols - 1 && changed_cost)
+					cost = changed_cost;
+				objects.push_back(rinad::FlowStateObject(n1.str(), n2.str(),
+									 cost, true, 1, 1));
+				objects.push_back(rinad::FlowStateObject(n2.str(), n1.str(),
+									 cost, true, 1, 1));
+			}
+		}
+	}
+
+	for (i = 1; i <= hub_links; i++) {
+		n2.str("");
+		n2 << "n" << (i * 37) % (rows * cols);
+		objects.push_back(rinad::FlowStateObject("n0", n2.str(), 3, true, 1, 1));
+		objects.push_back(rinad::FlowStateObject(n2.str(), "n0", 3, true, 1, 1));
+	}
+}
+
+bool sameRoutingTables(const std::list<rina::RoutingTableEntry *>& rt1,
+		       const std::list<rina::RoutingTableEntry *>& rt2)
+{
+	std::list<rina::RoutingTableEntry *>::const_iterator it, jt;
+	std::list<rina::IPCPNameAddresses>::const_iterator hit, hjt;
+
+	if (rt1.size() != rt2.size())
+		return false;
+
+	for (it = rt1.begin(), jt = rt2.begin(); it != rt1.end(); ++it, ++jt) {
+		const rina::NHopAltList& alts1 = (*it)->nextHopNames.front();
+		const rina::NHopAltList& alts2 = (*jt)->nextHopNames.front();
+
+		if ((*it)->destination.name != (*jt)->destination.name ||
+				alts1.alts.size() != alts2.alts.size())
+			return false;
+
+		for (hit = alts1.alts.begin(), hjt = alts2.alts.begin();
+				hit != alts1.alts.end(); ++hit, ++hjt) {
+			if (hit->name != hjt->name)
+				return false;
+		}
+	}
+
+	return true;
+}
+
+void freeRoutingTable(std::list<rina::RoutingTableEntry *>& rtable)
+{
+	std::list<rina::RoutingTableEntry *>::iterator it;
+
+	for (it = rtable.begin(); it != rtable.end(); ++it)
+		delete *it;
+	rtable.clear();
+}
+
+double elapsedUs(const struct timespec& from)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (now.tv_sec - from.tv_sec) * 1e6 +
+		(now.tv_nsec - from.tv_nsec) / 1e3;
+}
+
+// Computes the routing table of a well connected node with and without
+// LFA, checking that the LFAs found match the ones of the reference
+// algorithm
+int benchmark_lfa() {
+	const unsigned int iterations = 5;
+	std::list<rinad::FlowStateObject> objects;
+	std::list<rina::RoutingTableEntry *> rtable, reftable;
+	rinad::DijkstraAlgorithm routingAlgorithm;
+	rinad::LoopFreeAlternateAlgorithm lfa(routingAlgorithm);
+	struct timespec start;
+	double spf_us = 0, lfa_us = 0, lfa_inc_us = 0, ref_us = 0;
+	unsigned int i;
+
+	for (i = 0; i < iterations; i++) {
+		// Alternate the cost of one link, so that only the trees
+		// using it have to be computed again
+		buildLFATopology(10, 12, 12, i % 2 ? 9 : 0, objects);
+		rinad::Graph graph(objects);
+
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		routingAlgorithm.computeRoutingTable(graph, objects, "n0", rtable);
+		spf_us += elapsedUs(start);
+
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		lfa.fortifyRoutingTable(graph, "n0", rtable);
+		if (i == 0)
+			lfa_us = elapsedUs(start);
+		else
+			lfa_inc_us += elapsedUs(start);
+
+		routingAlgorithm.computeRoutingTable(graph, objects, "n0", reftable);
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		referenceLFA(&routingAlgorithm, graph, "n0", reftable);
+		ref_us += elapsedUs(start);
+
+		if (!sameRoutingTables(rtable, reftable)) {
+			LOG_IPCP_ERR("LFA routing table differs from the reference one");
+			freeRoutingTable(rtable);
+			freeRoutingTable(reftable);
+			return -1;
+		}
+
+		freeRoutingTable(rtable);
+		freeRoutingTable(reftable);
+	}
+
+	std::cout << "LFA benchmark, " << objects.size() / 2 << " links, "
+		  << iterations << " iterations:" << std::endl
+		  << "  SPF (no LFA): " << spf_us / iterations << " us" << std::endl
+		  << "  LFA, all trees: " << lfa_us << " us" << std::endl
+		  << "  LFA, incremental: " << lfa_inc_us / (iterations - 1)
+		  << " us" << std::endl
+		  << "  LFA, reference (per-neighbor SPF): " << ref_us / iterations
+		  << " us" << std::endl;
+
+	return 0;
+}
+
+void addLink(std::list<rinad::FlowStateObject>& objects,
+	     const std::string& name1, const std::string& name2,
+	     unsigned int delay, unsigned int bandwidth)
+{
+	rinad::FlowStateObject fso1(name1, name2, 1, true, 1, 1);
+	rinad::FlowStateObject fso2(name2, name1, 1, true, 1, 1);
+
+	fso1.delay = fso2.delay = delay;
+	fso1.bandwidth = fso2.bandwidth = bandwidth;
+	objects.push_back(fso1);
+	objects.push_back(fso2);
+}
+
+std::string getNextHop(const std::list<rina::RoutingTableEntry *>& rt,
+		       const std::string& dest)
+{
+	std::list<rina::RoutingTableEntry *>::const_iterator it;
+
+	for (it = rt.begin(); it != rt.end(); ++it) {
+		if ((*it)->destination.name == dest &&
+				!(*it)->nextHopNames.empty() &&
+				!(*it)->nextHopNames.front().alts.empty()) {
+			return (*it)->nextHopNames.front().alts.front().name;
+		}
+	}
+
+	return "";
+}
+
+int getRoutingTable_CubeMetrics_True() {
+	std::list<rinad::FlowStateObject> objects;
+	std::vector<rinad::spf_routing_request *> requests;
+	rinad::spf_routing_request cost, delay, bandwidth;
+	rinad::SPFWorkerPool pool(2, "test-spf");
+	int result = 0;
+
+	// The direct link to c is the cheapest one, but the path
+	// through b has less delay and more bandwidth
+	addLink(objects, "a", "b", 50, 125000000);
+	addLink(objects, "b", "c", 5, 125000000);
+	addLink(objects, "a", "c", 100, 1250000);
+
+	cost.algorithm = new rinad::DijkstraAlgorithm();
+	cost.metric = rinad::LINK_METRIC_COST;
+	delay.algorithm = new rinad::DijkstraAlgorithm();
+	delay.metric = rinad::LINK_METRIC_DELAY;
+	bandwidth.algorithm = new rinad::DijkstraAlgorithm();
+	bandwidth.metric = rinad::LINK_METRIC_BANDWIDTH;
+	requests.push_back(&cost);
+	requests.push_back(&delay);
+	requests.push_back(&bandwidth);
+
+	pool.computeRoutingTables(objects, "a", requests);
+
+	std::cout << "Next hop to c - cost: " << getNextHop(cost.rt, "c")
+		  << ", delay: " << getNextHop(delay.rt, "c")
+		  << ", bandwidth: " << getNextHop(bandwidth.rt, "c")
+		  << std::endl;
+
+	if (getNextHop(cost.rt, "c") != "c" ||
+			getNextHop(delay.rt, "c") != "b" ||
+			getNextHop(bandwidth.rt, "c") != "b") {
+		result = -1;
+	}
+
+	for (unsigned int i = 0; i < requests.size(); i++) {
+		delete requests[i]->algorithm;
+		for (std::list<rina::RoutingTableEntry *>::iterator
+				it = requests[i]->rt.begin();
+					it != requests[i]->rt.end(); ++it) {
+			delete *it;
+		}
+	}
+
+	return result;
+}
+
+int computeShortestDistances_NoWorkersManyRoots_True() {
+	rinad::DenseGraph graph;
+	rinad::SPFWorkerPool pool(0, "test-spf");
+	std::vector<unsigned int> roots;
+	std::vector<std::vector<int> *> distances;
+	unsigned int nvertices = 2000;
+	int result = 0;
+
+	// A line graph, all the trees computed by the calling thread
+	graph.adjacency.resize(nvertices);
+	for (unsigned int i = 0; i + 1 < nvertices; i++) {
+		graph.adjacency[i].push_back(rinad::DenseGraph::DenseEdge(i + 1, 1));
+		graph.adjacency[i + 1].push_back(rinad::DenseGraph::DenseEdge(i, 1));
+	}
+
+	for (unsigned int i = 0; i < nvertices; i++) {
+		roots.push_back(i);
+		distances.push_back(new std::vector<int>());
+	}
+
+	pool.computeShortestDistances(graph, roots, distances);
+
+	for (unsigned int i = 0; i < nvertices; i++) {
+		if ((*distances[i])[0] != (int) i)
+			result = -1;
+		delete distances[i];
+	}
+
+	return result;
+}
+
 int test_dijkstra() {
 	int result = 0;
 
@@ -932,6 +1621,27 @@ int test_dijkstra() {
 	}
 	LOG_IPCP_INFO("getRoutingTable_Addresses_True test passed");
 
+	result = benchmark_lfa();
+	if (result < 0) {
+		LOG_IPCP_ERR("benchmark_lfa test failed");
+		return result;
+	}
+	LOG_IPCP_INFO("benchmark_lfa test passed");
+
+	result = getRoutingTable_CubeMetrics_True();
+	if (result < 0) {
+		LOG_IPCP_ERR("getRoutingTable_CubeMetrics_True test failed");
+		return result;
+	}
+	LOG_IPCP_INFO("getRoutingTable_CubeMetrics_True test passed");
+
+	result = computeShortestDistances_NoWorkersManyRoots_True();
+	if (result < 0) {
+		LOG_IPCP_ERR("computeShortestDistances_NoWorkersManyRoots_True test failed");
+		return result;
+	}
+	LOG_IPCP_INFO("computeShortestDistances_NoWorkersManyRoots_True test passed");
+
 	return result;
 }
 
@@ -1131,6 +1841,20 @@ int main()
 	}
 	LOG_IPCP_INFO("test_flow_state_object_db tests passed");*/
 
+	result = test_flow_state_objects();
+	if (result < 0) {
+		LOG_IPCP_ERR("test_flow_state_objects tests failed");
+		return result;
+	}
+	LOG_IPCP_INFO("test_flow_state_objects tests passed");
+
+	result = test_fso_propagation();
+	if (result < 0) {
+		LOG_IPCP_ERR("test_fso_propagation tests failed");
+		return result;
+	}
+	LOG_IPCP_INFO("test_fso_propagation tests passed");
+
 	result = test_graph();
 	if (result < 0) {
 		LOG_IPCP_ERR("test_graph tests failed");
@@ -235,6 +235,32 @@ void PDUFTEntryRIBObj::read(const rina::cdap_rib::con_handle_t &con,
 	res.code_ = rina::cdap_rib::CDAP_SUCCESS;
 }
 
+// Class PDUFTUpdateStatsRIBObj
+const std::string PDUFTUpdateStatsRIBObj::class_name = "PDUForwardingTableUpdates";
+const std::string PDUFTUpdateStatsRIBObj::object_name = "/ra/pduftupdates";
+
+PDUFTUpdateStatsRIBObj::PDUFTUpdateStatsRIBObj(const pduft_update_stats * st,
+					       rina::ReadWriteLockable * lk)
+	: rina::rib::RIBObj(class_name), stats(st), lock(lk)
+{
+}
+
+const std::string PDUFTUpdateStatsRIBObj::get_displayable_value() const
+{
+	std::stringstream ss;
+
+	rina::ReadScopedLock g(*lock);
+
+	ss << "Updates: " << stats->updates << " (" << stats->unchanged
+	   << " without changes); Last update (entries): added "
+	   << stats->last_added << ", modified " << stats->last_modified
+	   << ", removed " << stats->last_removed << std::endl;
+	ss << "Total (entries): added " << stats->added << ", modified "
+	   << stats->modified << ", removed " << stats->removed;
+
+	return ss.str();
+}
+
 //Class NMinusOneFlowManager
 NMinusOneFlowManager::NMinusOneFlowManager()
 {
@@ -481,6 +507,9 @@ void ResourceAllocator::populateRIB()
 		tmp = new rina::rib::RIBObj(PDUFTEntryRIBObj::parent_class_name);
 		rib_daemon_->addObjRIB(PDUFTEntryRIBObj::parent_object_name, &tmp);
 
+		tmp = new PDUFTUpdateStatsRIBObj(&pduft_stats, &pduft_lock);
+		rib_daemon_->addObjRIB(PDUFTUpdateStatsRIBObj::object_name, &tmp);
+
 		tmp = new rina::rib::RIBObj("RMT");
 		rib_daemon_->addObjRIB("/rmt", &tmp);
 
@@ -715,25 +744,55 @@ void ResourceAllocator::set_pduft_entries(const std::list<rina::PDUForwardingTab
 	update_temp_entries();
 }
 
+void ResourceAllocator::pduft_updated(unsigned int added,
+				      unsigned int modified,
+				      unsigned int removed)
+{
+	rina::WriteScopedLock g(pduft_lock);
+
+	pduft_stats.updates++;
+	if (!added && !modified && !removed)
+		pduft_stats.unchanged++;
+	pduft_stats.last_added = added;
+	pduft_stats.last_modified = modified;
+	pduft_stats.last_removed = removed;
+	pduft_stats.added += added;
+	pduft_stats.modified += modified;
+	pduft_stats.removed += removed;
+}
+
+/// The kernel PDU Forwarding Table is updated differentially, so temp
+/// entries are installed while their destination is not in the PDUFT and
+/// removed from the kernel once the routed entries supersede them
 void ResourceAllocator::update_temp_entries()
 {
 	std::list<rina::PDUForwardingTableEntry*>::iterator it;
 	std::list<rina::PDUForwardingTableEntry*> to_add;
+	std::list<rina::PDUForwardingTableEntry*> to_remove;
+	bool in_pduft, in_kernel;
 
 	for(it = temp_entries.begin(); it != temp_entries.end(); ++it) {
-		if (!entry_is_in_pduft((*it)->address)) {
+		in_pduft = entry_is_in_pduft((*it)->address);
+		in_kernel = temp_entries_in_kernel.count((*it)->address);
+
+		if (!in_pduft && !in_kernel) {
 			to_add.push_back(*it);
+			temp_entries_in_kernel.insert((*it)->address);
+		} else if (in_pduft && in_kernel) {
+			temp_entries_in_kernel.erase((*it)->address);
+			//Otherwise the update has replaced its port-ids already
+			if (!entry_is_in_pduft((*it)->address, (*it)->qosId))
+				to_remove.push_back(*it);
 		}
 	}
 
-	if (to_add.size() == 0) {
-		return;
-	}
-
 	try {
-		rina::kernelIPCProcess->modifyPDUForwardingTableEntries(to_add, 0);
+		if (to_add.size())
+			rina::kernelIPCProcess->modifyPDUForwardingTableEntries(to_add, 0);
+		if (to_remove.size())
+			rina::kernelIPCProcess->modifyPDUForwardingTableEntries(to_remove, 1);
 	} catch (rina::Exception & e) {
-		LOG_IPCP_ERR("Error adding entries to PDU Forwarding Table in the kernel: %s",
+		LOG_IPCP_ERR("Error updating temp entries of PDU Forwarding Table in the kernel: %s",
 				e.what());
 	}
 }
@@ -878,6 +937,21 @@ bool ResourceAllocator::entry_is_in_pduft(unsigned int dest_address)
 	return false;
 }
 
+bool ResourceAllocator::entry_is_in_pduft(unsigned int dest_address,
+					  unsigned int qos_id)
+{
+	std::map<std::string, rina::PDUForwardingTableEntry*>::iterator it;
+
+	for (it = pduft.begin(); it != pduft.end(); ++it) {
+		if (it->second->address == dest_address &&
+				it->second->qosId == qos_id) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
 void ResourceAllocator::add_temp_pduft_entry(unsigned int dest_address, int port_id)
 {
 	std::list<unsigned int>::iterator it2;
@@ -898,6 +972,7 @@ void ResourceAllocator::add_temp_pduft_entry(unsigned int dest_address, int port
 	entry->portIdAltlists.push_back(pid_list);
 	to_add.push_back(entry);
 	temp_entries.push_back(entry);
+	temp_entries_in_kernel.insert(dest_address);
 
 	try {
 		rina::kernelIPCProcess->modifyPDUForwardingTableEntries(to_add, 0);
@@ -907,6 +982,19 @@ void ResourceAllocator::add_temp_pduft_entry(unsigned int dest_address, int port
 	}
 }
 
+void ResourceAllocator::remove_temp_entry_from_kernel(rina::PDUForwardingTableEntry * entry)
+{
+	std::list<rina::PDUForwardingTableEntry*> to_remove;
+
+	to_remove.push_back(entry);
+	try {
+		rina::kernelIPCProcess->modifyPDUForwardingTableEntries(to_remove, 1);
+	} catch (rina::Exception & e) {
+		LOG_IPCP_ERR("Error removing entry from PDU Forwarding Table in the kernel: %s",
+				e.what());
+	}
+}
+
 void ResourceAllocator::remove_temp_pduft_entry(unsigned int dest_address)
 {
 	std::list<rina::PDUForwardingTableEntry*>::iterator it;
@@ -920,6 +1008,9 @@ void ResourceAllocator::remove_temp_pduft_entry(unsigned int dest_address)
 	    if (entry->address == dest_address) {
 		    it = temp_entries.erase(it);
 		    LOG_IPCP_DBG("Deleting temp entry %s", entry->toString().c_str());
+		    //There is no flush of the kernel PDUFT that would remove it
+		    if (temp_entries_in_kernel.erase(dest_address))
+			    remove_temp_entry_from_kernel(entry);
 		    delete entry;
 		    entry = 0;
 	    } else {
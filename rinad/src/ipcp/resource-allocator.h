@@ -23,6 +23,8 @@
 #ifndef IPCP_RESOURCE_ALLOCATOR_HH
 #define IPCP_RESOURCE_ALLOCATOR_HH
 
+#include <set>
+
 #include "ipcp/components.h"
 
 namespace rinad {
@@ -170,6 +172,40 @@ private:
 	rina::PDUForwardingTableEntry * ft_entry;
 };
 
+/// Sizes of the differential updates of the PDU Forwarding Table
+struct pduft_update_stats {
+	pduft_update_stats() : updates(0), unchanged(0), last_added(0),
+		last_modified(0), last_removed(0), added(0), modified(0),
+		removed(0) { };
+
+	unsigned long updates;
+	unsigned long unchanged;
+	unsigned int last_added;
+	unsigned int last_modified;
+	unsigned int last_removed;
+	unsigned long added;
+	unsigned long modified;
+	unsigned long removed;
+};
+
+class PDUFTUpdateStatsRIBObj: public rina::rib::RIBObj {
+public:
+	PDUFTUpdateStatsRIBObj(const pduft_update_stats * stats,
+			       rina::ReadWriteLockable * lock);
+	const std::string get_displayable_value() const;
+
+	const std::string& get_class() const {
+		return class_name;
+	};
+
+	const static std::string class_name;
+	const static std::string object_name;
+
+private:
+	const pduft_update_stats * stats;
+	rina::ReadWriteLockable * lock;
+};
+
 class NMinusOneFlowManager: public INMinusOneFlowManager {
 public:
 	NMinusOneFlowManager();
@@ -214,6 +250,8 @@ public:
 	std::list<rina::PDUForwardingTableEntry> get_pduft_entries();
 	/// This operation takes ownership of the entries
 	void set_pduft_entries(const std::list<rina::PDUForwardingTableEntry*>& pduft);
+	void pduft_updated(unsigned int added, unsigned int modified,
+			   unsigned int removed);
 
 	std::list<rina::RoutingTableEntry> get_rt_entries();
 	/// This operation takes ownership of the entries
@@ -250,14 +288,19 @@ private:
 
 	bool contains_temp_entry(unsigned int dest_address);
 	bool entry_is_in_pduft(unsigned int dest_address);
+	bool entry_is_in_pduft(unsigned int dest_address, unsigned int qos_id);
 	void update_temp_entries(void);
+	void remove_temp_entry_from_kernel(rina::PDUForwardingTableEntry * entry);
 
 	INMinusOneFlowManager * n_minus_one_flow_manager_;
 	IPCPRIBDaemon * rib_daemon_;
 	rina::Lockable lock;
 
 	std::list<rina::PDUForwardingTableEntry*> temp_entries;
+	/// Addresses of the temp entries that are installed in the kernel
+	std::set<unsigned int> temp_entries_in_kernel;
 	std::map<std::string, rina::PDUForwardingTableEntry *> pduft;
+	pduft_update_stats pduft_stats;
 	rina::ReadWriteLockable pduft_lock;
 
 	std::map<std::string, rina::RoutingTableEntry *> rt;
@@ -75,6 +75,7 @@ void IPCPCDAPIOHandler::__send_message(const rina::cdap_rib::con_handle_t & con_
 {
 	int fd = 0;
 	int ret;
+	unsigned int seq_num;
 
 	fd = rib_daemon->get_fd(con_handle.port_id);
 	if (fd > 0) {
@@ -88,9 +89,10 @@ void IPCPCDAPIOHandler::__send_message(const rina::cdap_rib::con_handle_t & con_
 		}
 	}else {
 		//Write to N-1 flow
-		rina::kernelIPCProcess->writeMgmgtSDUToPortId(sdu.message_,
+		seq_num = rina::kernelIPCProcess->writeMgmgtSDUToPortId(sdu.message_,
 				sdu.size_,
 				con_handle.port_id);
+		rib_daemon->add_mgmt_sdu_write(seq_num, con_handle.port_id);
 	}
 }
 
@@ -465,70 +467,72 @@ void RIBDaemonRO::read(const rina::cdap_rib::con_handle_t &con,
 }
 
 // Class InternalFlowSDUReader
+#define IFLOW_MAX_SDU_SIZE 5000
+
 InternalFlowSDUReader::InternalFlowSDUReader(int port_id,
 					     int fd_,
 					     int cdaps)
-		: rina::SimpleThread(std::string("internal-flow-sdu-reader"), false)
 {
 	portid = port_id;
 	fd = fd_;
 	cdap_session = cdaps;
+	message.message_ = new unsigned char[IFLOW_MAX_SDU_SIZE];
 }
 
-int InternalFlowSDUReader::run()
+bool InternalFlowSDUReader::handle_event(int ready_fd, uint32_t events)
 {
-	rina::ser_obj_t message;
 	rina::cdap_rib::con_handle_t con_handle;
-
-	message.message_ = new unsigned char[5000];
 	int bytes_read = 0;
-	bool keep_going = true;
-
-	LOG_IPCP_DBG("Internal flow SDU reader of port-id %d starting. "
-		     "Attached to CDAP session %d",
-		     portid, cdap_session);
 
-	while(keep_going) {
-		bytes_read = read(fd, message.message_, 5000);
-		LOG_IPCP_DBG("Got message %d bytes of port-id %d, "
-				"handling to CDAP Provider",
-				bytes_read,
-				portid);
+	bytes_read = read(fd, message.message_, IFLOW_MAX_SDU_SIZE);
+	LOG_IPCP_DBG("Got message %d bytes of port-id %d, "
+			"handling to CDAP Provider",
+			bytes_read,
+			portid);
 
-		if (bytes_read <= 0) {
-			break;
-		}
+	if (bytes_read <= 0) {
+		LOG_DBG("Internal flow SDU Reader of port-id %d terminating",
+			portid);
+		return false;
+	}
 
-		//Instruct CDAP provider to process the CACEP message
-		try{
-			message.size_ = bytes_read;
-			rina::cdap::getProvider()->process_message(message,
-								   cdap_session);
-		} catch(rina::Exception &e){
-			LOG_ERR("Problems processing message from port-id %d and CDAP session id %d: %s",
-				portid, cdap_session, e.what());
-			if (std::string(e.what()).find("M_CONNECT received on an") != std::string::npos) {
-				LOG_IPCP_WARN("Closing CDAP session on port-id %u", cdap_session);
-				con_handle.port_id = cdap_session;
-				rinad::IPCPFactory::getIPCP()->enrollment_task_->release(0, con_handle);
-			}
+	//Instruct CDAP provider to process the CACEP message
+	try{
+		message.size_ = bytes_read;
+		rina::cdap::getProvider()->process_message(message,
+							   cdap_session);
+	} catch(rina::Exception &e){
+		LOG_ERR("Problems processing message from port-id %d and CDAP session id %d: %s",
+			portid, cdap_session, e.what());
+		if (std::string(e.what()).find("M_CONNECT received on an") != std::string::npos) {
+			LOG_IPCP_WARN("Closing CDAP session on port-id %u", cdap_session);
+			con_handle.port_id = cdap_session;
+			rinad::IPCPFactory::getIPCP()->enrollment_task_->release(0, con_handle);
 		}
 	}
 
-	LOG_DBG("Internal flow SDU Reader of port-id %d terminating", portid);
-
-	return 0;
+	return true;
 }
 
 //Class IPCPRIBDaemonImpl
 IPCPRIBDaemonImpl::IPCPRIBDaemonImpl(rina::cacep::AppConHandlerInterface *app_con_callback)
+		: iflow_loop("iflow-sdu-readers", 2)
 {
 	n_minus_one_flow_manager_ = 0;
 	aconcback = app_con_callback;
+	iflow_loop.start();
 }
 
 IPCPRIBDaemonImpl::~IPCPRIBDaemonImpl()
 {
+	std::map<int, InternalFlowSDUReader *>::iterator it;
+
+	iflow_loop.stop();
+	for (it = iflow_sdu_readers.begin();
+			it != iflow_sdu_readers.end(); ++it)
+		delete it->second;
+	iflow_sdu_readers.clear();
+
 	rina::rib::fini();
 }
 
@@ -681,9 +685,14 @@ void IPCPRIBDaemonImpl::start_internal_flow_sdu_reader(int port_id,
 	fds[cdap_session] = fd;
 
 	reader = new InternalFlowSDUReader(port_id, fd, cdap_session);
-	reader->start();
-
 	iflow_sdu_readers[port_id] = reader;
+
+	try {
+		iflow_loop.add_fd(fd, reader);
+	} catch (rina::Exception &e) {
+		LOG_IPCP_ERR("Problems starting SDU reader of port-id %d: %s",
+			     port_id, e.what());
+	}
 }
 
 void IPCPRIBDaemonImpl::stop_internal_flow_sdu_reader(int port_id)
@@ -706,22 +715,62 @@ int IPCPRIBDaemonImpl::get_fd(unsigned int cdap_session)
 	return -1;
 }
 
+void IPCPRIBDaemonImpl::add_mgmt_sdu_write(unsigned int seq_num, int port_id)
+{
+	std::map<unsigned int, int>::iterator it;
+
+	rina::ScopedLock g(mgmt_sdu_writes_lock);
+
+	//The response may have been looked up before the request was added
+	it = mgmt_sdu_writes.find(seq_num);
+	if (it != mgmt_sdu_writes.end()) {
+		mgmt_sdu_writes.erase(it);
+		return;
+	}
+
+	mgmt_sdu_writes[seq_num] = port_id;
+}
+
+int IPCPRIBDaemonImpl::take_mgmt_sdu_write_port(unsigned int seq_num)
+{
+	std::map<unsigned int, int>::iterator it;
+	int port_id;
+
+	rina::ScopedLock g(mgmt_sdu_writes_lock);
+
+	it = mgmt_sdu_writes.find(seq_num);
+	if (it == mgmt_sdu_writes.end()) {
+		//Tell add_mgmt_sdu_write() that the response is gone
+		mgmt_sdu_writes[seq_num] = -1;
+		return -1;
+	}
+
+	port_id = it->second;
+	mgmt_sdu_writes.erase(it);
+
+	return port_id;
+}
+
 void IPCPRIBDaemonImpl::__stop_internal_flow_sdu_reader(int port_id)
 {
 	std::map<int, InternalFlowSDUReader *>::iterator it;
-	void * status;
 	InternalFlowSDUReader * reader;
 
-	rina::ScopedLock g(iflow_readers_lock);
-
+	iflow_readers_lock.lock();
 	it = iflow_sdu_readers.find(port_id);
-	if (it != iflow_sdu_readers.end()) {
-		reader = it->second;
-		iflow_sdu_readers.erase(it);
-		fds.erase(reader->cdap_session);
-		reader->join(&status);
-		delete reader;
+	if (it == iflow_sdu_readers.end()) {
+		iflow_readers_lock.unlock();
+		return;
 	}
+
+	reader = it->second;
+	iflow_sdu_readers.erase(it);
+	fds.erase(reader->cdap_session);
+	iflow_readers_lock.unlock();
+
+	// Do not hold the lock, the reader may be using get_fd()
+	iflow_loop.remove_fd(reader->fd);
+	delete reader;
 }
 
 // Class StopInternalFlowReaderTimerTask
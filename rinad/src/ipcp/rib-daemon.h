@@ -25,6 +25,7 @@
 
 #include <librina/cdap_v2.h>
 #include <librina/concurrency.h>
+#include <librina/event-loop.h>
 
 #include "common/concurrency.h"
 #include "ipcp/components.h"
@@ -56,19 +57,23 @@ private:
         rina::rib::rib_handle_t rib;
 };
 
-/// Reads layer management SDUs from internal flows
-class InternalFlowSDUReader : public rina::SimpleThread
+/// Reads layer management SDUs from internal flows, invoked by the
+/// event loop of the RIB Daemon when the flow is readable
+class InternalFlowSDUReader : public rina::EventHandler
 {
 public:
 	InternalFlowSDUReader(int port_id,
 			      int fd_,
 			      int cdap_session);
-	~InternalFlowSDUReader() throw() {};
-	int run();
+	~InternalFlowSDUReader() {};
+	bool handle_event(int fd, uint32_t events);
 
 	int portid;
 	int cdap_session;
 	int fd;
+
+private:
+	rina::ser_obj_t message;
 };
 
 class StopInternalFlowReaderTimerTask;
@@ -93,6 +98,8 @@ public:
         void stop_internal_flow_sdu_reader(int port_id);
         void processReadManagementSDUEvent(rina::ReadMgmtSDUResponseEvent& event);
         int get_fd(unsigned int cdap_session);
+        void add_mgmt_sdu_write(unsigned int seq_num, int port_id);
+        int take_mgmt_sdu_write_port(unsigned int seq_num);
 
 private:
         friend class StopInternalFlowReaderTimerTask;
@@ -109,10 +116,19 @@ private:
         /// CDAP Session manager has been updated before receiving the response message
         rina::Lockable atomic_send_lock_;
 
+        /// N-1 port-id of the management SDU writes waiting for the
+        /// response of the kernel, by sequence number. Holds -1 for a
+        /// response that was looked up before its write was added
+        std::map<unsigned int, int> mgmt_sdu_writes;
+        rina::Lockable mgmt_sdu_writes_lock;
+
         std::map<int, InternalFlowSDUReader *> iflow_sdu_readers;
         std::map<int, int> fds;
         rina::Lockable iflow_readers_lock;
 
+        /// Serves the readers of all internal flows
+        rina::EventLoop iflow_loop;
+
         void initialize_rib_daemon(rina::cacep::AppConHandlerInterface *app_con_callback);
 
         void subscribeToEvents();
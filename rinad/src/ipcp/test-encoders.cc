@@ -320,6 +320,49 @@ bool test_directory_forwarding_table_entry_list() {
 	return true;
 }
 
+bool test_dft_delta() {
+	rinad::encoders::DFTDeltaEncoder encoder;
+	rinad::encoders::DFTEListEncoder list_encoder;
+	rina::ser_obj_t encoded_obj;
+	rinad::encoders::DFTDelta delta;
+	rinad::encoders::DFTDelta recovered_obj;
+	std::list<rina::DirectoryForwardingTableEntry> recovered_list;
+	rina::DirectoryForwardingTableEntry dfte;
+
+	dfte.address_ = 232;
+	dfte.seqnum_ = 3;
+	dfte.ap_naming_info_.processName = "test";
+	dfte.ap_naming_info_.processInstance = "1";
+	delta.added.push_back(dfte);
+	dfte.ap_naming_info_.processInstance = "2";
+	dfte.seqnum_ = 7;
+	delta.removed.push_back(dfte);
+	delta.has_digest = true;
+	delta.digest = 0x8000000000000001ULL;
+
+	encoder.encode(delta, encoded_obj);
+	encoder.decode(encoded_obj, recovered_obj);
+
+	if (recovered_obj.added.size() != 1 ||
+			recovered_obj.removed.size() != 1 ||
+			recovered_obj.removed.front().seqnum_ != 7 ||
+			recovered_obj.removed.front().ap_naming_info_.processInstance != "2" ||
+			!recovered_obj.has_digest ||
+			recovered_obj.digest != delta.digest) {
+		return false;
+	}
+
+	//Receivers that only know about entry lists get the added entries
+	list_encoder.decode(encoded_obj, recovered_list);
+	if (recovered_list.size() != 1 ||
+			recovered_list.front().ap_naming_info_.processInstance != "1") {
+		return false;
+	}
+
+	LOG_IPCP_INFO("Directory Forwarding Table Delta Encoder tested successfully");
+	return true;
+}
+
 bool test_enrollment_information_request() {
 	rinad::encoders::EnrollmentInformationRequestEncoder encoder;
 	rina::ser_obj_t encoded_obj;
@@ -334,6 +377,7 @@ bool test_enrollment_information_request() {
 	request.supporting_difs_.push_back(name1);
 	request.supporting_difs_.push_back(name2);
 	request.address_ = 141234;
+	request.snapshot_sections_.push_back("dft");
 
 	encoder.encode(request, encoded_obj);
 	encoder.decode(encoded_obj, recovered_obj);
@@ -346,10 +390,60 @@ bool test_enrollment_information_request() {
 		return false;
 	}
 
+	if (request.snapshot_sections_ != recovered_obj.snapshot_sections_) {
+		return false;
+	}
+
 	LOG_IPCP_INFO("Enrollment Information Request Encoder tested successfully");
 	return true;
 }
 
+bool test_enrollment_snapshot() {
+	rinad::encoders::EnrollmentSnapshotEncoder encoder;
+	rinad::encoders::EnrollmentSnapshotChunkEncoder chunk_encoder;
+	rina::ser_obj_t encoded_obj;
+	rina::ser_obj_t encoded_chunk;
+	rinad::encoders::EnrollmentSnapshot snapshot;
+	rinad::encoders::EnrollmentSnapshot recovered_obj;
+	rinad::encoders::EnrollmentSnapshotChunk chunk;
+	rinad::encoders::EnrollmentSnapshotChunk recovered_chunk;
+
+	snapshot.version = 0x100000002ULL;
+	snapshot.sections["dft"] = std::string("\0\1\2", 3);
+	snapshot.sections["fsdb"] = "flow state";
+
+	encoder.encode(snapshot, encoded_obj);
+	encoder.decode(encoded_obj, recovered_obj);
+
+	if (recovered_obj.version != snapshot.version ||
+			recovered_obj.sections != snapshot.sections) {
+		return false;
+	}
+
+	chunk.version = snapshot.version;
+	chunk.index = 1;
+	chunk.count = 3;
+	chunk.compressed = true;
+	chunk.image_size = encoded_obj.size_;
+	chunk.data = std::string((const char *) encoded_obj.message_,
+				 encoded_obj.size_);
+
+	chunk_encoder.encode(chunk, encoded_chunk);
+	chunk_encoder.decode(encoded_chunk, recovered_chunk);
+
+	if (recovered_chunk.version != chunk.version ||
+			recovered_chunk.index != 1 ||
+			recovered_chunk.count != 3 ||
+			!recovered_chunk.compressed ||
+			recovered_chunk.image_size != chunk.image_size ||
+			recovered_chunk.data != chunk.data) {
+		return false;
+	}
+
+	LOG_IPCP_INFO("Enrollment Snapshot Encoder tested successfully");
+	return true;
+}
+
 bool test_qos_cube() {
 	rinad::encoders::QoSCubeEncoder encoder;
 	rina::ser_obj_t encoded_obj;
@@ -742,12 +836,24 @@ int main()
 		return -1;
 	}
 
+	result = test_dft_delta();
+	if (!result) {
+		LOG_IPCP_ERR("Problems testing Directory Forwarding Table Delta Encoder");
+		return -1;
+	}
+
 	result = test_enrollment_information_request();
 	if (!result) {
 		LOG_IPCP_ERR("Problems testing Enrollment Information Request Encoder");
 		return -1;
 	}
 
+	result = test_enrollment_snapshot();
+	if (!result) {
+		LOG_IPCP_ERR("Problems testing Enrollment Snapshot Encoder");
+		return -1;
+	}
+
 	result = test_flow();
 	if (!result) {
 		LOG_IPCP_ERR("Problems testing Flow Encoder");
@@ -0,0 +1,562 @@
+//
+// Namespace Manager tests and benchmarks
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+// MA  02110-1301  USA
+//
+
+#include <list>
+#include <map>
+#include <sstream>
+#include <vector>
+#include <sys/time.h>
+
+#define IPCP_MODULE "namespace-manager-tests"
+
+#include "ipcp-logging.h"
+
+#include <librina/cdap_v2.h>
+
+#include "common/encoder.h"
+#include "ipcp/namespace-manager.h"
+
+#define NUM_ENTRIES      100000
+#define NUM_ADDRESSES    1000
+#define NUM_SCAN_LOOKUPS 100
+
+int ipcp_id = 1;
+
+/// The entries created by a test, deleted when it ends
+class DFTEntries {
+public:
+	~DFTEntries() {
+		for (unsigned int i = 0; i < entries.size(); i++)
+			delete entries[i];
+	}
+
+	rina::DirectoryForwardingTableEntry * add(rinad::DFTIndex& index,
+						  const std::string& process_name,
+						  const std::string& process_instance,
+						  unsigned int address) {
+		rina::DirectoryForwardingTableEntry * entry;
+
+		entry = new rina::DirectoryForwardingTableEntry();
+		entry->ap_naming_info_.processName = process_name;
+		entry->ap_naming_info_.processInstance = process_instance;
+		entry->address_ = address;
+		entry->seqnum_ = 1;
+		entries.push_back(entry);
+		index.addEntry(entry);
+
+		return entry;
+	}
+
+	std::vector<rina::DirectoryForwardingTableEntry *> entries;
+};
+
+/// RIB Daemon that only keeps the objects added to it
+class FakeRIBDaemon: public rinad::IPCPRIBDaemon {
+public:
+	~FakeRIBDaemon() {
+		std::map<std::string, rina::rib::RIBObj *>::iterator it;
+
+		for (it = objects.begin(); it != objects.end(); ++it)
+			delete it->second;
+	}
+	rina::rib::RIBDaemonProxy * getProxy() {
+		return 0;
+	}
+	void set_dif_configuration(const rina::DIFInformation& dif_information) {
+		(void)dif_information;
+	}
+	void processQueryRIBRequestEvent(const rina::QueryRIBRequestEvent& event) {
+		(void)event;
+	}
+	const rina::rib::rib_handle_t & get_rib_handle() {
+		return handle;
+	}
+	int64_t addObjRIB(const std::string& fqn, rina::rib::RIBObj** obj) {
+		removeObjRIB(fqn);
+		objects[fqn] = *obj;
+		*obj = 0;
+		return objects.size();
+	}
+	void removeObjRIB(const std::string& fqn) {
+		std::map<std::string, rina::rib::RIBObj *>::iterator it;
+
+		it = objects.find(fqn);
+		if (it == objects.end())
+			return;
+
+		delete it->second;
+		objects.erase(it);
+	}
+	void processReadManagementSDUEvent(rina::ReadMgmtSDUResponseEvent& event) {
+		(void)event;
+	}
+	int take_mgmt_sdu_write_port(unsigned int seq_num) {
+		(void)seq_num;
+		return -1;
+	}
+
+	rina::rib::rib_handle_t handle;
+	std::map<std::string, rina::rib::RIBObj *> objects;
+};
+
+/// IPC Process at a single address, with only an event manager and a
+/// RIB Daemon
+class FakeIPCProcess: public rinad::IPCProcess {
+public:
+	FakeIPCProcess(unsigned int address) : IPCProcess("test", "1"),
+			address_(address), state_(rinad::ASSIGNED_TO_DIF) {
+		internal_event_manager_ = &event_manager_;
+		rib_daemon_ = &rib_daemon;
+	}
+	unsigned short get_id() {
+		return 1;
+	}
+	unsigned int get_address() const {
+		return address_;
+	}
+	void set_address(unsigned int address) {
+		address_ = address;
+	}
+	const rinad::IPCProcessOperationalState& get_operational_state() const {
+		return state_;
+	}
+	void set_operational_state(const rinad::IPCProcessOperationalState& operational_state) {
+		state_ = operational_state;
+	}
+	rina::DIFInformation& get_dif_information() {
+		return dif_information_;
+	}
+	void set_dif_information(const rina::DIFInformation& dif_information) {
+		dif_information_ = dif_information;
+	}
+	const std::list<rina::Neighbor> get_neighbors() const {
+		return std::list<rina::Neighbor>();
+	}
+	unsigned int get_old_address() {
+		return 0;
+	}
+	unsigned int get_active_address() {
+		return address_;
+	}
+	bool check_address_is_mine(unsigned int address) {
+		return address == address_;
+	}
+
+	FakeRIBDaemon rib_daemon;
+
+private:
+	rina::SimpleInternalEventManager event_manager_;
+	unsigned int address_;
+	rinad::IPCProcessOperationalState state_;
+	rina::DIFInformation dif_information_;
+};
+
+long elapsed_us(const struct timeval& start)
+{
+	struct timeval now;
+
+	gettimeofday(&now, 0);
+	return (now.tv_sec - start.tv_sec) * 1000000L +
+		(now.tv_usec - start.tv_usec);
+}
+
+/// True if the next members of the DAF are at the expected addresses
+bool next_members_are(rinad::DFTIndex& index,
+		      const std::string& process_name,
+		      unsigned int excluded_address,
+		      const std::list<unsigned int>& addresses)
+{
+	std::list<unsigned int>::const_iterator it;
+	rina::DirectoryForwardingTableEntry * member;
+
+	for (it = addresses.begin(); it != addresses.end(); ++it) {
+		member = index.getNextMember(process_name, excluded_address);
+		if (!member || member->address_ != *it) {
+			LOG_IPCP_ERR("Expected member at address %u, got %u",
+				     *it, member ? member->address_ : 0);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool contains_key(const std::list<std::string>& keys, const std::string& key)
+{
+	std::list<std::string>::const_iterator it;
+
+	for (it = keys.begin(); it != keys.end(); ++it) {
+		if (*it == key)
+			return true;
+	}
+
+	return false;
+}
+
+bool test_anycast_round_robin()
+{
+	rinad::DFTIndex index;
+	DFTEntries entries;
+	std::list<unsigned int> expected;
+
+	entries.add(index, "app", "1", 10);
+	entries.add(index, "app", "2", 5);
+	entries.add(index, "app", "3", 11);
+	entries.add(index, "app", "4", 12);
+	entries.add(index, "other", "1", 10);
+
+	/* The member at our address (5) is skipped */
+	for (int i = 0; i < 2; i++) {
+		expected.push_back(10);
+		expected.push_back(11);
+		expected.push_back(12);
+	}
+	if (!next_members_are(index, "app", 5, expected))
+		return false;
+
+	if (index.getNextMember("unknown", 5))
+		return false;
+
+	/* The only member is at our address */
+	entries.add(index, "local", "1", 5);
+	if (index.getNextMember("local", 5))
+		return false;
+
+	return index.getNextMember("other", 5) == entries.entries[4];
+}
+
+bool test_remove_entry()
+{
+	rinad::DFTIndex index;
+	DFTEntries entries;
+	std::list<unsigned int> expected;
+	rina::DirectoryForwardingTableEntry * removed;
+
+	entries.add(index, "app", "1", 10);
+	removed = entries.add(index, "app", "2", 11);
+	entries.add(index, "app", "3", 12);
+	entries.add(index, "other", "1", 11);
+
+	/* The next member is the one removed */
+	expected.push_back(10);
+	if (!next_members_are(index, "app", 5, expected))
+		return false;
+	index.removeEntry(removed);
+
+	expected.clear();
+	expected.push_back(12);
+	expected.push_back(10);
+	if (!next_members_are(index, "app", 5, expected))
+		return false;
+
+	/* The other entry at the address is still indexed */
+	if (index.getKeys(11).size() != 1 ||
+			contains_key(index.getKeys(11), removed->getKey()))
+		return false;
+
+	/* The next member is the last one, the round restarts */
+	index.removeEntry(entries.entries[2]);
+	expected.clear();
+	expected.push_back(10);
+	expected.push_back(10);
+	if (!next_members_are(index, "app", 5, expected))
+		return false;
+
+	/* Without members, the DAF is not found */
+	index.removeEntry(entries.entries[0]);
+	if (index.getNextMember("app", 5))
+		return false;
+
+	return index.getKeys(10).empty() && index.getKeys(12).empty();
+}
+
+bool test_address_change()
+{
+	rinad::DFTIndex index;
+	DFTEntries entries;
+	std::list<unsigned int> expected;
+	rina::DirectoryForwardingTableEntry * moved;
+
+	entries.add(index, "app", "1", 10);
+	moved = entries.add(index, "app", "2", 10);
+
+	index.setEntryAddress(moved, 20);
+	if (moved->address_ != 20)
+		return false;
+
+	if (index.getKeys(10).size() != 1 ||
+			contains_key(index.getKeys(10), moved->getKey()))
+		return false;
+
+	if (index.getKeys(20).size() != 1 ||
+			!contains_key(index.getKeys(20), moved->getKey()))
+		return false;
+
+	/* The moved entry is now at our address */
+	expected.push_back(10);
+	expected.push_back(10);
+	if (!next_members_are(index, "app", 20, expected))
+		return false;
+
+	/* Moving the last entry out of an address drops it */
+	index.setEntryAddress(entries.entries[0], 30);
+	if (!index.getKeys(10).empty())
+		return false;
+
+	/* Entries that go through an address change are removed from the
+	 * new address */
+	index.removeEntry(moved);
+
+	return index.getKeys(20).empty() && index.getKeys(30).size() == 1;
+}
+
+rina::DirectoryForwardingTableEntry dft_entry(const std::string& process_name,
+					      unsigned int address,
+					      unsigned int seqnum)
+{
+	rina::DirectoryForwardingTableEntry entry;
+
+	entry.ap_naming_info_.processName = process_name;
+	entry.ap_naming_info_.processInstance = "1";
+	entry.address_ = address;
+	entry.seqnum_ = seqnum;
+
+	return entry;
+}
+
+/// Apply a DFT snapshot sent by the neighbor at port_id, as an enrollment
+/// does
+void apply_dft_snapshot(rinad::DFTRIBObj * dft_obj,
+			int port_id,
+			const std::list<rina::DirectoryForwardingTableEntry>& added,
+			const std::list<rina::DirectoryForwardingTableEntry>& removed)
+{
+	rinad::encoders::DFTDeltaEncoder encoder;
+	rinad::encoders::DFTDelta delta;
+	rina::ser_obj_t snapshot;
+
+	delta.added = added;
+	delta.removed = removed;
+	encoder.encode(delta, snapshot);
+	dft_obj->apply_snapshot(port_id, snapshot);
+}
+
+/// Address the DFT resolves the application to, 0 if not found
+unsigned int resolve(rinad::NamespaceManager& nsm, const std::string& process_name)
+{
+	rina::ApplicationProcessNamingInformation name;
+
+	name.processName = process_name;
+	name.processInstance = "1";
+
+	return nsm.getDFTNextHop(name);
+}
+
+bool test_neighbor_lost_and_reenrolled()
+{
+	FakeIPCProcess ipcp(2);
+	rinad::NamespaceManager nsm;
+	rinad::DFTRIBObj * dft_obj;
+	std::list<rina::DirectoryForwardingTableEntry> entries;
+	std::list<rina::DirectoryForwardingTableEntry> removed;
+	std::list<std::string> keys;
+	std::list<std::string>::iterator it;
+	std::list<int> exc_neighs;
+
+	nsm.set_application_process(&ipcp);
+	dft_obj = dynamic_cast<rinad::DFTRIBObj *>(
+			ipcp.rib_daemon.objects[rinad::DFTRIBObj::object_name]);
+	if (!dft_obj)
+		return false;
+
+	/* Our application, and the ones of the neighbor at address 1 */
+	entries.push_back(dft_entry("local", 2, 1));
+	nsm.addDFTEntries(entries, false, exc_neighs);
+
+	entries.clear();
+	entries.push_back(dft_entry("remote-1", 1, 1));
+	entries.push_back(dft_entry("remote-2", 1, 3));
+	apply_dft_snapshot(dft_obj, 10, entries, removed);
+	if (resolve(nsm, "remote-1") != 1 || resolve(nsm, "remote-2") != 1)
+		return false;
+
+	/* The neighbor is lost, its entries are removed as
+	 * checkDFTEntriesToRemove does, and another neighbor propagates
+	 * the same removals */
+	keys = nsm.getDFTEntryKeys(1);
+	for (it = keys.begin(); it != keys.end(); ++it)
+		nsm.removeDFTEntry(*it, true, true, exc_neighs);
+	nsm.removeDFTEntries(entries, exc_neighs);
+	if (resolve(nsm, "remote-1") != 0 || resolve(nsm, "remote-2") != 0)
+		return false;
+
+	/* The neighbor enrolls again and sends the same entries, its DFT
+	 * also had lost our entry */
+	removed.push_back(dft_entry("local", 2, 1));
+	apply_dft_snapshot(dft_obj, 11, entries, removed);
+	if (resolve(nsm, "remote-1") != 1 || resolve(nsm, "remote-2") != 1) {
+		LOG_IPCP_ERR("The entries of the neighbor did not come back");
+		return false;
+	}
+
+	if (resolve(nsm, "local") != 2) {
+		LOG_IPCP_ERR("Our entry has been removed by a neighbor");
+		return false;
+	}
+
+	/* The owner unregisters an application, a copy older than the
+	 * removal is dropped */
+	removed.clear();
+	removed.push_back(dft_entry("remote-1", 1, 2));
+	entries.clear();
+	apply_dft_snapshot(dft_obj, 11, entries, removed);
+	entries.push_back(dft_entry("remote-1", 1, 1));
+	apply_dft_snapshot(dft_obj, 12, entries, std::list<rina::DirectoryForwardingTableEntry>());
+
+	return resolve(nsm, "remote-1") == 0 && resolve(nsm, "remote-2") == 1;
+}
+
+std::string process_name(int i)
+{
+	std::stringstream ss;
+
+	ss << "app-" << i;
+	return ss.str();
+}
+
+bool benchmark_lookups()
+{
+	rinad::DFTIndex index;
+	DFTEntries entries;
+	rina::DirectoryForwardingTableEntry * member;
+	std::vector<std::string> names;
+	struct timeval start;
+	unsigned long keys = 0;
+	long us;
+	int found = 0;
+
+	for (int i = 0; i < NUM_ENTRIES; i++)
+		names.push_back(process_name(i));
+
+	gettimeofday(&start, 0);
+	for (int i = 0; i < NUM_ENTRIES; i++)
+		entries.add(index, names[i], "1", 1 + i % NUM_ADDRESSES);
+	us = elapsed_us(start);
+	LOG_IPCP_INFO("Indexed %d entries in %ld us (%.1f ns/entry)",
+		      NUM_ENTRIES, us, (us * 1000.0) / NUM_ENTRIES);
+
+	gettimeofday(&start, 0);
+	for (int i = 0; i < NUM_ENTRIES; i++) {
+		if (index.getNextMember(names[i], 0))
+			found++;
+	}
+	us = elapsed_us(start);
+	LOG_IPCP_INFO("%d DAF name lookups in %ld us (%.1f ns/lookup)",
+		      NUM_ENTRIES, us, (us * 1000.0) / NUM_ENTRIES);
+
+	if (found != NUM_ENTRIES) {
+		LOG_IPCP_ERR("Only %d DAF names found", found);
+		return false;
+	}
+
+	/* What the lookup costs without the index by process name */
+	found = 0;
+	gettimeofday(&start, 0);
+	for (int i = 0; i < NUM_SCAN_LOOKUPS; i++) {
+		const std::string& name = names[NUM_ENTRIES - 1 - i];
+
+		for (unsigned int j = 0; j < entries.entries.size(); j++) {
+			member = entries.entries[j];
+			if (member->ap_naming_info_.processName == name) {
+				found++;
+				break;
+			}
+		}
+	}
+	us = elapsed_us(start);
+	LOG_IPCP_INFO("%d DAF name lookups scanning the DFT in %ld us (%.1f ns/lookup)",
+		      NUM_SCAN_LOOKUPS, us, (us * 1000.0) / NUM_SCAN_LOOKUPS);
+
+	if (found != NUM_SCAN_LOOKUPS)
+		return false;
+
+	gettimeofday(&start, 0);
+	for (unsigned int address = 1; address <= NUM_ADDRESSES; address++)
+		keys += index.getKeys(address).size();
+	us = elapsed_us(start);
+	LOG_IPCP_INFO("%d address lookups (%lu keys) in %ld us (%.1f ns/lookup)",
+		      NUM_ADDRESSES, keys, us, (us * 1000.0) / NUM_ADDRESSES);
+
+	if (keys != NUM_ENTRIES)
+		return false;
+
+	gettimeofday(&start, 0);
+	for (int i = 0; i < NUM_ENTRIES; i++)
+		index.removeEntry(entries.entries[i]);
+	us = elapsed_us(start);
+	LOG_IPCP_INFO("Removed %d entries in %ld us (%.1f ns/entry)",
+		      NUM_ENTRIES, us, (us * 1000.0) / NUM_ENTRIES);
+
+	return index.getKeys(1).empty() && !index.getNextMember(names[0], 0);
+}
+
+int main()
+{
+	rina::cdap_rib::concrete_syntax_t syntax;
+
+	//The DFT changes are propagated to the (no) CDAP sessions
+	rina::cdap::init(0, syntax, true);
+
+	bool result = test_anycast_round_robin();
+	if (!result) {
+		LOG_IPCP_ERR("Problems testing the anycast round robin of the DFT");
+		return -1;
+	}
+	LOG_IPCP_INFO("Anycast round robin test passed");
+
+	result = test_remove_entry();
+	if (!result) {
+		LOG_IPCP_ERR("Problems testing the removal of DFT entries");
+		return -1;
+	}
+	LOG_IPCP_INFO("DFT entry removal test passed");
+
+	result = test_address_change();
+	if (!result) {
+		LOG_IPCP_ERR("Problems testing the address change of DFT entries");
+		return -1;
+	}
+	LOG_IPCP_INFO("DFT entry address change test passed");
+
+	result = test_neighbor_lost_and_reenrolled();
+	if (!result) {
+		LOG_IPCP_ERR("Problems testing the DFT after losing a neighbor");
+		return -1;
+	}
+	LOG_IPCP_INFO("DFT neighbor loss and re-enrollment test passed");
+
+	result = benchmark_lookups();
+	if (!result) {
+		LOG_IPCP_ERR("Problems benchmarking the DFT lookups");
+		return -1;
+	}
+	LOG_IPCP_INFO("DFT lookup benchmark passed");
+
+	return 0;
+}